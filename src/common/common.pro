@@ -57,18 +57,25 @@ HEADERS += 	\
 	ml_document/helpers/mesh_model_state_data.h \
 	ml_document/base_types.h \
 	ml_document/cmesh.h \
+	ml_document/knn_graph.h \
 	ml_document/mesh_model.h \
 	ml_document/mesh_model_state.h \
+	ml_document/mesh_rasterizer.h \
+	ml_document/mesh_ray_bvh.h \
+	ml_document/poisson_disk.h \
 	ml_document/mesh_document.h \
 	ml_document/raster_model.h \
 	ml_document/render_raster.h \
+	utilities/ascii_chunk_reader.h \
 	utilities/file_format.h \
 	pluginmanager.h \
 	mlexception.h \
 	mlapplication.h \
 	meshlabdocumentxml.h \
+	meshlabdocumentpack.h \
 	ml_shared_data_context.h \
 	ml_selection_buffers.h \
+	ml_lod_streaming_renderer.h \
 	meshlabdocumentxml.h
 
 SOURCES += \
@@ -83,18 +90,25 @@ SOURCES += \
 	interfaces/plugin_interface.cpp \
 	ml_document/helpers/mesh_document_state_data.cpp \
 	ml_document/cmesh.cpp \
+	ml_document/knn_graph.cpp \
 	ml_document/mesh_model.cpp \
 	ml_document/mesh_model_state.cpp \
+	ml_document/mesh_rasterizer.cpp \
+	ml_document/mesh_ray_bvh.cpp \
+	ml_document/poisson_disk.cpp \
 	ml_document/mesh_document.cpp \
 	ml_document/raster_model.cpp \
 	ml_document/render_raster.cpp \
+	utilities/ascii_chunk_reader.cpp \
 	pluginmanager.cpp \
 	mlapplication.cpp \
 	searcher.cpp \
 	meshlabdocumentxml.cpp \
 	meshlabdocumentbundler.cpp \
+	meshlabdocumentpack.cpp \
 	ml_shared_data_context.cpp \
 	ml_selection_buffers.cpp \
+	ml_lod_streaming_renderer.cpp \
 	$$MESHLAB_EXTERNAL_DIRECTORY/easyexif/exif.cpp
 
 macx:QMAKE_POST_LINK = "\
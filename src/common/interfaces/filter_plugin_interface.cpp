@@ -8,6 +8,9 @@ bool FilterPluginInterface::isFilterApplicable(const QAction* act, const MeshMod
 	if (preMask == MeshModel::MM_NONE) // no precondition specified.
 		return true;
 
+	// the pending attributes are decoded before applying the filter
+	preMask &= ~m.pendingDataMask();
+
 	if (preMask & MeshModel::MM_VERTCOLOR && !m.hasDataMask(MeshModel::MM_VERTCOLOR))
 		MissingItems.push_back("Vertex Color");
 
@@ -39,6 +42,21 @@ bool FilterPluginInterface::isFilterApplicable(const QAction* act, const MeshMod
 	return MissingItems.isEmpty();
 }
 
+void FilterPluginInterface::decodePendingAttributes(const QAction* act, MeshDocument& md)
+{
+	const int topologyMask = MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_FACEVERT;
+	const bool topologyChange = (postCondition(act) & topologyMask) != 0;
+	const int needed = getPreConditions(act) | getRequirements(act);
+	for (MeshModel* mm : md.meshList)
+	{
+		int pending = mm->pendingDataMask();
+		if (!topologyChange)
+			pending &= needed;
+		if (pending != MeshModel::MM_NONE)
+			mm->updateDataMask(pending);
+	}
+}
+
 PluginInterface::FilterIDType FilterPluginInterface::ID(const QAction* a) const
 {
 	QString aa=a->text();
@@ -144,6 +144,13 @@ public:
 	*/
 	bool isFilterApplicable(const QAction* act, const MeshModel& m, QStringList &MissingItems) const;
 
+	/** \brief decodes the pending attributes (see MeshModel::PendingAttributes) of the meshes of the document
+	that the filter may use: the ones in its preconditions and requirements, or all of them if its postconditions
+	say that it can change the vertices or the faces of the meshes.
+	It is called by the framework before applying the filter.
+	*/
+	void decodePendingAttributes(const QAction* act, MeshDocument& md);
+
 
 	enum FILTER_ARITY { NONE = 0, SINGLE_MESH = 1, FIXED = 2, VARIABLE = 3, UNKNOWN_ARITY = 4 };
 
@@ -155,6 +162,12 @@ public:
 	*/
 	virtual FILTER_ARITY filterArity(const QAction *act) const = 0;
 
+	/** \brief tells the framework if the filter cannot work without a valid OpenGL context.
+	When no context can be created (e.g. meshlabserver on a machine without display) the filters
+	that do not require it are applied anyway, with glContext set to NULL.
+	*/
+	virtual bool requiresGLContext(const QAction*) const { return false; }
+
 	// This function is called to initialized the list of parameters.
 	// it is always called. If a filter does not need parameter it leave it empty and the framework
 	// will not create a dialog (unless for previewing)
@@ -0,0 +1,1043 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtXml>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "meshlabdocumentpack.h"
+#include "meshlabdocumentxml.h"
+
+using namespace vcg;
+
+/*
+Layout of the file (all the integers are little endian):
+
+	header    magic (8 bytes), version, byte order of the data (1: little endian),
+	          size of the scalars of the data (4 or 8), reserved (quint32 each), offset of the table of contents (quint64)
+	chunks    the data of the chunks, each one compressed with qCompress
+	toc       number of chunks (quint32), then the description of each chunk (see operator<<(QDataStream&, const Chunk&))
+
+The data of a chunk is a plain array of elements, in the byte order of the machine that saved it.
+*/
+
+namespace {
+
+const char packMagic[8] = { 'M', 'L', 'Z', 'P', 'A', 'C', 'K', '\0' };
+const quint32 packVersion = 1;
+const qint64 packHeaderSize = 32;
+
+// elements of a block, the unit of compression and of parallel decoding
+const quint64 blockElements = quint64(1) << 18;
+
+// fast compression: the pack is meant to be saved and opened often
+const int compressionLevel = 1;
+
+enum ChunkKind
+{
+	CK_DOCUMENT = 0,   // the xml of the project
+	CK_MESHINFO,       // element numbers, data mask, color and textures of a mesh
+	CK_VERTCOORD,
+	CK_VERTNORMAL,
+	CK_VERTFLAGS,
+	CK_VERTCOLOR,
+	CK_VERTQUALITY,
+	CK_VERTTEXCOORD,
+	CK_VERTRADIUS,
+	CK_FACEVERT,
+	CK_FACENORMAL,
+	CK_FACEFLAGS,
+	CK_FACECOLOR,
+	CK_FACEQUALITY,
+	CK_WEDGTEXCOORD,
+	CK_EDGEVERT,
+	CK_VERTATTRIBUTE,  // custom per vertex attribute, with its name and type
+	CK_FACEATTRIBUTE   // custom per face attribute, with its name and type
+};
+
+// types of the custom attributes that are saved
+enum AttributeType
+{
+	AT_NONE = 0,
+	AT_FLOAT,
+	AT_DOUBLE,
+	AT_INT,
+	AT_POINT3F,
+	AT_POINT3D,
+	AT_COLOR4B
+};
+
+struct Chunk
+{
+	quint32 kind;
+	qint32 mesh;      // index of the mesh in the MeshGroup of the document (-1 for the document)
+	quint32 type;     // AttributeType of the custom attributes
+	QByteArray name;  // name of the custom attributes
+	quint64 first;    // the range of elements of the chunk
+	quint64 count;
+	quint64 offset;   // the compressed data in the file
+	quint64 size;
+	quint64 rawSize;
+	Chunk() : kind(CK_DOCUMENT), mesh(-1), type(AT_NONE), first(0), count(0), offset(0), size(0), rawSize(0) {}
+};
+
+QDataStream& operator<<(QDataStream& out, const Chunk& c)
+{
+	return out << c.kind << c.mesh << c.type << c.name << c.first << c.count << c.offset << c.size << c.rawSize;
+}
+
+QDataStream& operator>>(QDataStream& in, Chunk& c)
+{
+	return in >> c.kind >> c.mesh >> c.type >> c.name >> c.first >> c.count >> c.offset >> c.size >> c.rawSize;
+}
+
+// the component of the data mask stored by a chunk; MM_NONE for the ones that are always present
+int chunkComponent(quint32 kind)
+{
+	switch (kind)
+	{
+	case CK_VERTCOLOR:     return MeshModel::MM_VERTCOLOR;
+	case CK_VERTQUALITY:   return MeshModel::MM_VERTQUALITY;
+	case CK_VERTTEXCOORD:  return MeshModel::MM_VERTTEXCOORD;
+	case CK_VERTRADIUS:    return MeshModel::MM_VERTRADIUS;
+	case CK_FACECOLOR:     return MeshModel::MM_FACECOLOR;
+	case CK_FACEQUALITY:   return MeshModel::MM_FACEQUALITY;
+	case CK_WEDGTEXCOORD:  return MeshModel::MM_WEDGTEXCOORD;
+	default:               return MeshModel::MM_NONE;
+	}
+}
+
+size_t attributeSize(quint32 type)
+{
+	switch (type)
+	{
+	case AT_FLOAT:   return sizeof(float);
+	case AT_DOUBLE:  return sizeof(double);
+	case AT_INT:     return sizeof(int);
+	case AT_POINT3F: return sizeof(Point3f);
+	case AT_POINT3D: return sizeof(Point3d);
+	case AT_COLOR4B: return sizeof(Color4b);
+	default:         return 0;
+	}
+}
+
+const size_t texCoordSize = 2 * sizeof(float) + sizeof(qint16);
+
+size_t elementSize(const Chunk& c, size_t scalarSize)
+{
+	switch (c.kind)
+	{
+	case CK_VERTCOORD:
+	case CK_VERTNORMAL:
+	case CK_FACENORMAL:     return 3 * scalarSize;
+	case CK_VERTQUALITY:
+	case CK_FACEQUALITY:
+	case CK_VERTRADIUS:     return scalarSize;
+	case CK_VERTFLAGS:
+	case CK_FACEFLAGS:      return sizeof(qint32);
+	case CK_VERTCOLOR:
+	case CK_FACECOLOR:      return 4;
+	case CK_VERTTEXCOORD:   return texCoordSize;
+	case CK_WEDGTEXCOORD:   return 3 * texCoordSize;
+	case CK_FACEVERT:       return 3 * sizeof(quint32);
+	case CK_EDGEVERT:       return 2 * sizeof(quint32);
+	case CK_VERTATTRIBUTE:
+	case CK_FACEATTRIBUTE:  return attributeSize(c.type);
+	default:                return 0;
+	}
+}
+
+class ElementWriter
+{
+public:
+	ElementWriter(QByteArray& raw) : p(raw.data()) {}
+
+	template <class T>
+	void put(const T& v) { memcpy(p, &v, sizeof(T)); p += sizeof(T); }
+
+	void putPoint(const Point3m& v) { put(v[0]); put(v[1]); put(v[2]); }
+	void putColor(const Color4b& c) { for (int i = 0; i < 4; ++i) put(c[i]); }
+
+	template <class TexCoordType>
+	void putTexCoord(const TexCoordType& t) { put(float(t.U())); put(float(t.V())); put(qint16(t.N())); }
+
+private:
+	char* p;
+};
+
+class ElementReader
+{
+public:
+	ElementReader(const QByteArray& raw, size_t scalarSize) : p(raw.constData()), scalarSize(scalarSize) {}
+
+	template <class T>
+	T get() { T v; memcpy(&v, p, sizeof(T)); p += sizeof(T); return v; }
+
+	// the scalars are converted if the pack has been saved with a different precision
+	Scalarm getScalar() { return (scalarSize == sizeof(float)) ? Scalarm(get<float>()) : Scalarm(get<double>()); }
+	Point3m getPoint() { Scalarm x = getScalar(); Scalarm y = getScalar(); Scalarm z = getScalar(); return Point3m(x, y, z); }
+	Color4b getColor() { Color4b c; for (int i = 0; i < 4; ++i) c[i] = get<unsigned char>(); return c; }
+
+	template <class TexCoordType>
+	void getTexCoord(TexCoordType& t) { t.U() = get<float>(); t.V() = get<float>(); t.N() = get<qint16>(); }
+
+private:
+	const char* p;
+	size_t scalarSize;
+};
+
+// copies a custom attribute from the mesh to the writer, or from the reader to the mesh;
+// the elements of the chunk are the ones listed in index (all the elements, in order, if it is null)
+template <class T, class Handle>
+void transferElements(Handle& h, const Chunk& c, ElementWriter* w, ElementReader* r, const std::vector<size_t>* index)
+{
+	for (size_t k = c.first; k < c.first + c.count; ++k)
+	{
+		const size_t i = (index != nullptr) ? (*index)[k] : k;
+		if (w != nullptr)
+			w->put(h[i]);
+		else
+			h[i] = r->get<T>();
+	}
+}
+
+template <class T>
+bool transferAttribute(CMeshO& m, const Chunk& c, ElementWriter* w, ElementReader* r, const std::vector<size_t>* index)
+{
+	const std::string name = c.name.toStdString();
+	if (c.kind == CK_VERTATTRIBUTE)
+	{
+		CMeshO::PerVertexAttributeHandle<T> h = tri::Allocator<CMeshO>::FindPerVertexAttribute<T>(m, name);
+		if (!tri::Allocator<CMeshO>::IsValidHandle<T>(m, h))
+			return false;
+		transferElements<T>(h, c, w, r, index);
+	}
+	else
+	{
+		CMeshO::PerFaceAttributeHandle<T> h = tri::Allocator<CMeshO>::FindPerFaceAttribute<T>(m, name);
+		if (!tri::Allocator<CMeshO>::IsValidHandle<T>(m, h))
+			return false;
+		transferElements<T>(h, c, w, r, index);
+	}
+	return true;
+}
+
+bool transferAttribute(CMeshO& m, const Chunk& c, ElementWriter* w, ElementReader* r, const std::vector<size_t>* index = nullptr)
+{
+	switch (c.type)
+	{
+	case AT_FLOAT:   return transferAttribute<float>(m, c, w, r, index);
+	case AT_DOUBLE:  return transferAttribute<double>(m, c, w, r, index);
+	case AT_INT:     return transferAttribute<int>(m, c, w, r, index);
+	case AT_POINT3F: return transferAttribute<Point3f>(m, c, w, r, index);
+	case AT_POINT3D: return transferAttribute<Point3d>(m, c, w, r, index);
+	case AT_COLOR4B: return transferAttribute<Color4b>(m, c, w, r, index);
+	default:         return false;
+	}
+}
+
+// adds to the mesh the custom attribute of a chunk; it must be done before decoding the chunks in parallel
+template <class T>
+void addAttribute(CMeshO& m, const Chunk& c)
+{
+	const std::string name = c.name.toStdString();
+	if (c.kind == CK_VERTATTRIBUTE)
+		tri::Allocator<CMeshO>::GetPerVertexAttribute<T>(m, name);
+	else
+		tri::Allocator<CMeshO>::GetPerFaceAttribute<T>(m, name);
+}
+
+void addAttribute(CMeshO& m, const Chunk& c)
+{
+	switch (c.type)
+	{
+	case AT_FLOAT:   addAttribute<float>(m, c); break;
+	case AT_DOUBLE:  addAttribute<double>(m, c); break;
+	case AT_INT:     addAttribute<int>(m, c); break;
+	case AT_POINT3F: addAttribute<Point3f>(m, c); break;
+	case AT_POINT3D: addAttribute<Point3d>(m, c); break;
+	case AT_COLOR4B: addAttribute<Color4b>(m, c); break;
+	}
+}
+
+inline quint64 finalizeHash(quint64 h)
+{
+	h ^= h >> 33;
+	h *= Q_UINT64_C(0xff51afd7ed558ccd);
+	h ^= h >> 33;
+	h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+	h ^= h >> 33;
+	return h;
+}
+
+inline quint64 hashWord(quint64 h, quint64 w)
+{
+	return (h ^ w) * Q_UINT64_C(0x100000001b3);
+}
+
+// FNV-1a of the words given by hashElement for each element, computed by blocks in parallel
+template <class HashElement>
+quint64 hashElements(size_t n, HashElement hashElement)
+{
+	const int blocks = int((n + blockElements - 1) / blockElements);
+	std::vector<quint64> blockHash(blocks);
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < blocks; ++b)
+	{
+		quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+		const size_t last = std::min(n, size_t(b + 1) * size_t(blockElements));
+		for (size_t i = size_t(b) * size_t(blockElements); i < last; ++i)
+			h = hashElement(h, i);
+		blockHash[b] = h;
+	}
+	quint64 h = finalizeHash(quint64(n));
+	for (int b = 0; b < blocks; ++b)
+		h = finalizeHash(h ^ blockHash[b]);
+	return h;
+}
+
+// a version of the elements of a mesh: their number, the deleted ones and the vertices of faces and edges.
+// Editing the attributes of the elements keeps it, deleting, adding or reordering them changes it.
+quint64 elementsVersion(const CMeshO& m)
+{
+	const quint64 deleted = ~quint64(0);
+	quint64 h = hashElements(m.vert.size(), [&m, deleted](quint64 h, size_t i) -> quint64 {
+		return hashWord(h, m.vert[i].IsD() ? deleted : 0);
+	});
+	h = finalizeHash(h ^ hashElements(m.face.size(), [&m, deleted](quint64 h, size_t i) -> quint64 {
+		const CFaceO& f = m.face[i];
+		if (f.IsD())
+			return hashWord(h, deleted);
+		for (int j = 0; j < 3; ++j)
+			h = hashWord(h, quint64(tri::Index(m, f.cV(j))));
+		return h;
+	}));
+	h = finalizeHash(h ^ hashElements(m.edge.size(), [&m, deleted](quint64 h, size_t i) -> quint64 {
+		const CEdgeO& e = m.edge[i];
+		if (e.IsD())
+			return hashWord(h, deleted);
+		for (int j = 0; j < 2; ++j)
+			h = hashWord(h, quint64(tri::Index(m, e.cV(j))));
+		return h;
+	}));
+	return h;
+}
+
+/*
+The elements of a mesh that are saved. The mesh is not modified: the deleted elements are skipped
+and the others are renumbered in order through these tables.
+The pending components still valid are saved too, from their decompressed data.
+*/
+struct SavedElements
+{
+	std::vector<size_t> vert, face, edge; // the indexes in the mesh of the saved elements
+	std::vector<quint32> vertIndex;       // the saved index of each vertex of the mesh
+	int mask;                             // the components of the data mask that are saved
+	std::map<quint32, QByteArray> pending; // chunk kind -> pending data, indexed as the elements of the mesh
+	size_t pendingScalarSize;
+
+	SavedElements() : mask(MeshModel::MM_NONE), pendingScalarSize(sizeof(Scalarm)) {}
+
+	void build(const CMeshO& m)
+	{
+		vertIndex.assign(m.vert.size(), 0);
+		for (size_t i = 0; i < m.vert.size(); ++i)
+		{
+			if (m.vert[i].IsD())
+				continue;
+			vertIndex[i] = quint32(vert.size());
+			vert.push_back(i);
+		}
+		for (size_t i = 0; i < m.face.size(); ++i)
+			if (!m.face[i].IsD())
+				face.push_back(i);
+		for (size_t i = 0; i < m.edge.size(); ++i)
+			if (!m.edge[i].IsD())
+				edge.push_back(i);
+	}
+};
+
+// appends the chunks of an attribute, one per block of elements
+void addChunks(std::vector<Chunk>& chunks, quint32 kind, qint32 mesh, size_t elementNum,
+	quint32 type = AT_NONE, const std::string& name = std::string())
+{
+	for (quint64 first = 0; first < elementNum; first += blockElements)
+	{
+		Chunk c;
+		c.kind = kind;
+		c.mesh = mesh;
+		c.type = type;
+		c.name = QByteArray(name.c_str());
+		c.first = first;
+		c.count = std::min(blockElements, quint64(elementNum) - first);
+		chunks.push_back(c);
+	}
+}
+
+// the custom attributes of type T not yet listed (the attributes of the same size may be found by more types)
+template <class T>
+void addAttributeChunks(CMeshO& m, const SavedElements& e, quint32 type, qint32 mesh, std::vector<Chunk>& chunks, std::set<std::string>& vertNames, std::set<std::string>& faceNames)
+{
+	std::vector<std::string> names;
+	tri::Allocator<CMeshO>::GetAllPerVertexAttribute<T>(m, names);
+	for (const std::string& name : names)
+		if (vertNames.insert(name).second)
+			addChunks(chunks, CK_VERTATTRIBUTE, mesh, e.vert.size(), type, name);
+	names.clear();
+	tri::Allocator<CMeshO>::GetAllPerFaceAttribute<T>(m, names);
+	for (const std::string& name : names)
+		if (faceNames.insert(name).second)
+			addChunks(chunks, CK_FACEATTRIBUTE, mesh, e.face.size(), type, name);
+}
+
+void addMeshChunks(MeshModel& mm, const SavedElements& e, qint32 mesh, std::vector<Chunk>& chunks)
+{
+	CMeshO& m = mm.cm;
+	const size_t vn = e.vert.size();
+	const size_t fn = e.face.size();
+	addChunks(chunks, CK_VERTCOORD, mesh, vn);
+	addChunks(chunks, CK_VERTNORMAL, mesh, vn);
+	addChunks(chunks, CK_VERTFLAGS, mesh, vn);
+	if (e.mask & MeshModel::MM_VERTCOLOR)
+		addChunks(chunks, CK_VERTCOLOR, mesh, vn);
+	if (e.mask & MeshModel::MM_VERTQUALITY)
+		addChunks(chunks, CK_VERTQUALITY, mesh, vn);
+	if (e.mask & MeshModel::MM_VERTTEXCOORD)
+		addChunks(chunks, CK_VERTTEXCOORD, mesh, vn);
+	if (e.mask & MeshModel::MM_VERTRADIUS)
+		addChunks(chunks, CK_VERTRADIUS, mesh, vn);
+	addChunks(chunks, CK_FACEVERT, mesh, fn);
+	addChunks(chunks, CK_FACENORMAL, mesh, fn);
+	addChunks(chunks, CK_FACEFLAGS, mesh, fn);
+	if (e.mask & MeshModel::MM_FACECOLOR)
+		addChunks(chunks, CK_FACECOLOR, mesh, fn);
+	if (e.mask & MeshModel::MM_FACEQUALITY)
+		addChunks(chunks, CK_FACEQUALITY, mesh, fn);
+	if (e.mask & MeshModel::MM_WEDGTEXCOORD)
+		addChunks(chunks, CK_WEDGTEXCOORD, mesh, fn);
+	addChunks(chunks, CK_EDGEVERT, mesh, e.edge.size());
+
+	std::set<std::string> vertNames, faceNames;
+	addAttributeChunks<float>(m, e, AT_FLOAT, mesh, chunks, vertNames, faceNames);
+	addAttributeChunks<double>(m, e, AT_DOUBLE, mesh, chunks, vertNames, faceNames);
+	addAttributeChunks<Point3f>(m, e, AT_POINT3F, mesh, chunks, vertNames, faceNames);
+	addAttributeChunks<Point3d>(m, e, AT_POINT3D, mesh, chunks, vertNames, faceNames);
+	addAttributeChunks<int>(m, e, AT_INT, mesh, chunks, vertNames, faceNames);
+	addAttributeChunks<Color4b>(m, e, AT_COLOR4B, mesh, chunks, vertNames, faceNames);
+}
+
+// encodes the pending data of a chunk, converting the scalars to the precision of the pack being saved
+void encodePending(const SavedElements& e, const std::vector<size_t>& index, const Chunk& c, const QByteArray& data, ElementWriter& w)
+{
+	const size_t size = elementSize(c, e.pendingScalarSize);
+	for (size_t k = size_t(c.first); k < size_t(c.first + c.count); ++k)
+	{
+		const char* src = data.constData() + index[k] * size;
+		if ((c.kind == CK_VERTRADIUS) || (c.kind == CK_VERTQUALITY) || (c.kind == CK_FACEQUALITY))
+		{
+			if (e.pendingScalarSize == sizeof(float))
+			{
+				float v;
+				memcpy(&v, src, sizeof(float));
+				w.put(Scalarm(v));
+			}
+			else
+			{
+				double v;
+				memcpy(&v, src, sizeof(double));
+				w.put(Scalarm(v));
+			}
+		}
+		else
+		{
+			for (size_t b = 0; b < size; ++b)
+				w.put(src[b]);
+		}
+	}
+}
+
+QByteArray encodeChunk(CMeshO& m, const SavedElements& e, const Chunk& c)
+{
+	QByteArray raw(int(c.count * elementSize(c, sizeof(Scalarm))), Qt::Uninitialized);
+	ElementWriter w(raw);
+	const size_t first = size_t(c.first);
+	const size_t last = size_t(c.first + c.count);
+	const bool perFace = ((c.kind >= CK_FACEVERT) && (c.kind <= CK_WEDGTEXCOORD)) || (c.kind == CK_FACEATTRIBUTE);
+	const std::vector<size_t>& index = perFace ? e.face : ((c.kind == CK_EDGEVERT) ? e.edge : e.vert);
+	std::map<quint32, QByteArray>::const_iterator pending = e.pending.find(c.kind);
+	if (pending != e.pending.end())
+	{
+		encodePending(e, index, c, pending->second, w);
+		return raw;
+	}
+	switch (c.kind)
+	{
+	case CK_VERTCOORD:
+		for (size_t k = first; k < last; ++k) w.putPoint(m.vert[index[k]].cP());
+		break;
+	case CK_VERTNORMAL:
+		for (size_t k = first; k < last; ++k) w.putPoint(m.vert[index[k]].cN());
+		break;
+	case CK_VERTFLAGS:
+		for (size_t k = first; k < last; ++k) w.put(qint32(m.vert[index[k]].cFlags()));
+		break;
+	case CK_VERTCOLOR:
+		for (size_t k = first; k < last; ++k) w.putColor(m.vert[index[k]].cC());
+		break;
+	case CK_VERTQUALITY:
+		for (size_t k = first; k < last; ++k) w.put(Scalarm(m.vert[index[k]].cQ()));
+		break;
+	case CK_VERTTEXCOORD:
+		for (size_t k = first; k < last; ++k) w.putTexCoord(m.vert[index[k]].cT());
+		break;
+	case CK_VERTRADIUS:
+		for (size_t k = first; k < last; ++k) w.put(Scalarm(m.vert[index[k]].cR()));
+		break;
+	case CK_FACEVERT:
+		for (size_t k = first; k < last; ++k)
+			for (int j = 0; j < 3; ++j)
+				w.put(e.vertIndex[tri::Index(m, m.face[index[k]].cV(j))]);
+		break;
+	case CK_FACENORMAL:
+		for (size_t k = first; k < last; ++k) w.putPoint(m.face[index[k]].cN());
+		break;
+	case CK_FACEFLAGS:
+		for (size_t k = first; k < last; ++k) w.put(qint32(m.face[index[k]].cFlags()));
+		break;
+	case CK_FACECOLOR:
+		for (size_t k = first; k < last; ++k) w.putColor(m.face[index[k]].cC());
+		break;
+	case CK_FACEQUALITY:
+		for (size_t k = first; k < last; ++k) w.put(Scalarm(m.face[index[k]].cQ()));
+		break;
+	case CK_WEDGTEXCOORD:
+		for (size_t k = first; k < last; ++k)
+			for (int j = 0; j < 3; ++j)
+				w.putTexCoord(m.face[index[k]].cWT(j));
+		break;
+	case CK_EDGEVERT:
+		for (size_t k = first; k < last; ++k)
+			for (int j = 0; j < 2; ++j)
+				w.put(e.vertIndex[tri::Index(m, m.edge[index[k]].cV(j))]);
+		break;
+	case CK_VERTATTRIBUTE:
+	case CK_FACEATTRIBUTE:
+		transferAttribute(m, c, &w, nullptr, &index);
+		break;
+	}
+	return raw;
+}
+
+// decodes a chunk in its range of elements, that must be already allocated;
+// chunks of different ranges or attributes can be decoded in parallel
+bool decodeChunk(CMeshO& m, const Chunk& c, const QByteArray& raw, size_t scalarSize)
+{
+	const size_t first = size_t(c.first);
+	const size_t last = size_t(c.first + c.count);
+	const size_t size = elementSize(c, scalarSize);
+	if ((size == 0) || (quint64(raw.size()) != c.count * size))
+		return false;
+
+	const bool perFace = ((c.kind >= CK_FACEVERT) && (c.kind <= CK_WEDGTEXCOORD)) || (c.kind == CK_FACEATTRIBUTE);
+	const size_t elementNum = perFace ? m.face.size() : ((c.kind == CK_EDGEVERT) ? m.edge.size() : m.vert.size());
+	if (c.first > elementNum || c.count > elementNum - c.first)
+		return false;
+
+	ElementReader r(raw, scalarSize);
+	const quint32 vertNum = quint32(m.vert.size());
+	switch (c.kind)
+	{
+	case CK_VERTCOORD:
+		for (size_t i = first; i < last; ++i) m.vert[i].P() = r.getPoint();
+		break;
+	case CK_VERTNORMAL:
+		for (size_t i = first; i < last; ++i) m.vert[i].N() = r.getPoint();
+		break;
+	case CK_VERTFLAGS:
+		for (size_t i = first; i < last; ++i) m.vert[i].Flags() = r.get<qint32>();
+		break;
+	case CK_VERTCOLOR:
+		for (size_t i = first; i < last; ++i) m.vert[i].C() = r.getColor();
+		break;
+	case CK_VERTQUALITY:
+		for (size_t i = first; i < last; ++i) m.vert[i].Q() = r.getScalar();
+		break;
+	case CK_VERTTEXCOORD:
+		for (size_t i = first; i < last; ++i) r.getTexCoord(m.vert[i].T());
+		break;
+	case CK_VERTRADIUS:
+		for (size_t i = first; i < last; ++i) m.vert[i].R() = r.getScalar();
+		break;
+	case CK_FACEVERT:
+		for (size_t i = first; i < last; ++i)
+			for (int j = 0; j < 3; ++j)
+			{
+				const quint32 v = r.get<quint32>();
+				if (v >= vertNum)
+					return false;
+				m.face[i].V(j) = &m.vert[v];
+			}
+		break;
+	case CK_FACENORMAL:
+		for (size_t i = first; i < last; ++i) m.face[i].N() = r.getPoint();
+		break;
+	case CK_FACEFLAGS:
+		for (size_t i = first; i < last; ++i) m.face[i].Flags() = r.get<qint32>();
+		break;
+	case CK_FACECOLOR:
+		for (size_t i = first; i < last; ++i) m.face[i].C() = r.getColor();
+		break;
+	case CK_FACEQUALITY:
+		for (size_t i = first; i < last; ++i) m.face[i].Q() = r.getScalar();
+		break;
+	case CK_WEDGTEXCOORD:
+		for (size_t i = first; i < last; ++i)
+			for (int j = 0; j < 3; ++j)
+				r.getTexCoord(m.face[i].WT(j));
+		break;
+	case CK_EDGEVERT:
+		for (size_t i = first; i < last; ++i)
+			for (int j = 0; j < 2; ++j)
+			{
+				const quint32 v = r.get<quint32>();
+				if (v >= vertNum)
+					return false;
+				m.edge[i].V(j) = &m.vert[v];
+			}
+		break;
+	case CK_VERTATTRIBUTE:
+	case CK_FACEATTRIBUTE:
+		return transferAttribute(m, c, nullptr, &r);
+	default:
+		return false;
+	}
+	return true;
+}
+
+// the chunks are processed in parallel in rounds of a few chunks per thread, the progress is reported between them
+int chunksPerRound()
+{
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	return 4 * threads;
+}
+
+// decompresses and decodes the listed chunks in parallel
+bool decodeChunks(const std::vector<MeshModel*>& meshes, const std::vector<Chunk>& chunks, const std::vector<QByteArray>& data,
+	const std::vector<size_t>& jobs, size_t scalarSize, vcg::CallBackPos* cb)
+{
+	std::vector<char> decoded(jobs.size(), 0);
+	const int jobNum = int(jobs.size());
+	for (int round = 0; round < jobNum; round += chunksPerRound())
+	{
+		const int roundEnd = std::min(jobNum, round + chunksPerRound());
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int j = round; j < roundEnd; ++j)
+		{
+			const Chunk& c = chunks[jobs[j]];
+			decoded[j] = decodeChunk(meshes[c.mesh]->cm, c, qUncompress(data[jobs[j]]), scalarSize) ? 1 : 0;
+		}
+		if (cb != nullptr)
+			cb(100 * roundEnd / jobNum, "Decoding chunks");
+	}
+	return std::find(decoded.begin(), decoded.end(), 0) == decoded.end();
+}
+
+/*
+The chunks of a mesh that have not been decoded on loading, with their compressed data.
+*/
+class PackPendingAttributes : public MeshModel::PendingAttributes
+{
+public:
+	PackPendingAttributes(size_t scalarSize) : scalarSize(scalarSize), version(0), mask(MeshModel::MM_NONE) {}
+
+	void add(const Chunk& c, const QByteArray& compressed)
+	{
+		chunks.push_back(c);
+		chunks.back().mesh = 0; // the index in the meshes given to decodeChunks
+		data.push_back(compressed);
+		mask |= chunkComponent(c.kind);
+	}
+
+	// the elementsVersion of the mesh the chunks refer to
+	void setVersion(quint64 v) { version = v; }
+
+	int dataMask() const { return mask; }
+
+	size_t scalarSizeOfData() const { return scalarSize; }
+
+	// the chunks refer to the elements of the mesh only while they are not deleted, added or reordered
+	bool matches(const CMeshO& m) const { return elementsVersion(m) == version; }
+
+	// the decompressed data of a pending component, for all the elements of the mesh; empty if it is not pending
+	QByteArray component(quint32 kind) const
+	{
+		std::vector<const Chunk*> parts;
+		std::vector<const QByteArray*> partData;
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			if (chunks[i].kind != kind)
+				continue;
+			parts.push_back(&chunks[i]);
+			partData.push_back(&data[i]);
+		}
+		// the blocks are stored in order, one after the other
+		QByteArray raw;
+		quint64 next = 0;
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			if (parts[i]->first != next)
+				return QByteArray();
+			next += parts[i]->count;
+			raw.append(qUncompress(*partData[i]));
+		}
+		return raw;
+	}
+
+	void decode(MeshModel& m, int neededMask)
+	{
+		const int decoding = mask & neededMask;
+		if (!matches(m.cm))
+		{
+			qDebug("The mesh %s has changed since it has been loaded: its pending attributes are discarded", qUtf8Printable(m.label()));
+			discard(decoding);
+			return;
+		}
+
+		std::vector<size_t> jobs;
+		for (size_t i = 0; i < chunks.size(); ++i)
+			if ((chunkComponent(chunks[i].kind) & decoding) != 0)
+				jobs.push_back(i);
+		std::vector<MeshModel*> meshes(1, &m);
+		if (!decodeChunks(meshes, chunks, data, jobs, scalarSize, nullptr))
+			qDebug("Unable to decode the pending attributes of the mesh %s", qUtf8Printable(m.label()));
+		discard(decoding);
+	}
+
+	void discard(int discardMask)
+	{
+		size_t k = 0;
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			if ((chunkComponent(chunks[i].kind) & discardMask) != 0)
+				continue;
+			chunks[k] = chunks[i];
+			data[k] = data[i];
+			++k;
+		}
+		chunks.resize(k);
+		data.resize(k);
+		mask &= ~discardMask;
+	}
+
+private:
+	size_t scalarSize;
+	quint64 version;
+	int mask;
+	std::vector<Chunk> chunks;
+	std::vector<QByteArray> data;
+};
+
+// the components of the data mask restored on loading
+const int packDataMask = MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTTEXCOORD | MeshModel::MM_VERTRADIUS |
+	MeshModel::MM_FACECOLOR | MeshModel::MM_FACEQUALITY | MeshModel::MM_WEDGTEXCOORD | MeshModel::MM_POLYGONAL | MeshModel::MM_COLOR;
+const int packTopologyMask = MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTFACETOPO;
+
+// the per element components that can be pending
+const quint32 pendingKinds[] = { CK_VERTCOLOR, CK_VERTQUALITY, CK_VERTTEXCOORD, CK_VERTRADIUS, CK_FACECOLOR, CK_FACEQUALITY, CK_WEDGTEXCOORD };
+
+// the pending components not yet decoded are saved only if their data still refers to the elements of the mesh
+// and the same component has not been enabled on the mesh in the meantime (the data of the mesh is newer)
+void addPendingComponents(const MeshModel& mm, SavedElements& e)
+{
+	std::shared_ptr<const MeshModel::PendingAttributes> pending = mm.getPendingAttributes();
+	const PackPendingAttributes* packPending = dynamic_cast<const PackPendingAttributes*>(pending.get());
+	if ((packPending == nullptr) || !packPending->matches(mm.cm))
+		return;
+	e.pendingScalarSize = packPending->scalarSizeOfData();
+	for (quint32 kind : pendingKinds)
+	{
+		const int component = chunkComponent(kind);
+		if (((packPending->dataMask() & component) == 0) || ((mm.decodedDataMask() & component) != 0))
+			continue;
+		const bool perFace = (kind >= CK_FACEVERT);
+		const size_t elementNum = perFace ? mm.cm.face.size() : mm.cm.vert.size();
+		Chunk c;
+		c.kind = kind;
+		QByteArray raw = packPending->component(kind);
+		if (quint64(raw.size()) != quint64(elementNum) * elementSize(c, e.pendingScalarSize))
+			continue;
+		e.pending[kind] = raw;
+		e.mask |= component;
+	}
+}
+
+}
+
+bool MeshDocumentToPackFile(MeshDocument &md, const QString& filename, bool onlyVisibleLayers, bool saveViewState,
+	const std::map<int, MLRenderingData>& rendOpt, vcg::CallBackPos* cb)
+{
+	md.setFileName(filename);
+	QFileInfo fi(filename);
+	QDir tmpDir = QDir::current();
+	QDir::setCurrent(fi.absoluteDir().absolutePath());
+	QDomDocument doc = MeshDocumentToXML(md, onlyVisibleLayers, saveViewState, true, rendOpt);
+	QDir::setCurrent(tmpDir.absolutePath());
+
+	// the meshes in the order of the MeshGroup of the xml
+	std::vector<MeshModel*> meshes;
+	foreach(MeshModel *mmp, md.meshList)
+		if ((!onlyVisibleLayers) || (mmp->visible))
+			meshes.push_back(mmp);
+
+	// the document is not modified: the deleted elements are skipped through the saved elements tables
+	// and the pending components are saved from their data
+	std::vector<SavedElements> saved(meshes.size());
+	std::vector<Chunk> chunks;
+	std::vector<QByteArray> raw;
+	chunks.push_back(Chunk());
+	raw.push_back(doc.toByteArray(1));
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		MeshModel& mm = *meshes[i];
+		SavedElements& e = saved[i];
+		e.build(mm.cm);
+		e.mask = mm.decodedDataMask();
+		addPendingComponents(mm, e);
+
+		Chunk info;
+		info.kind = CK_MESHINFO;
+		info.mesh = qint32(i);
+		QByteArray infoData;
+		QDataStream stream(&infoData, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_0);
+		stream.setByteOrder(QDataStream::LittleEndian);
+		QStringList textures;
+		for (const std::string& t : mm.cm.textures)
+			textures.push_back(QString::fromStdString(t));
+		stream << quint64(e.vert.size()) << quint64(e.face.size()) << quint64(e.edge.size())
+			<< qint32(e.mask) << quint8(mm.cm.C()[0]) << quint8(mm.cm.C()[1]) << quint8(mm.cm.C()[2]) << quint8(mm.cm.C()[3])
+			<< textures;
+		// the data of the other chunks is encoded later, in parallel
+		raw.resize(chunks.size());
+		chunks.push_back(info);
+		raw.push_back(infoData);
+
+		addMeshChunks(mm, e, qint32(i), chunks);
+	}
+	raw.resize(chunks.size());
+
+	std::vector<QByteArray> data(chunks.size());
+	const int chunkNum = int(chunks.size());
+	for (int round = 0; round < chunkNum; round += chunksPerRound())
+	{
+		const int roundEnd = std::min(chunkNum, round + chunksPerRound());
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int k = round; k < roundEnd; ++k)
+		{
+			Chunk& c = chunks[k];
+			if (c.kind != CK_DOCUMENT && c.kind != CK_MESHINFO)
+				raw[k] = encodeChunk(meshes[c.mesh]->cm, saved[c.mesh], c);
+			c.rawSize = quint64(raw[k].size());
+			data[k] = qCompress(raw[k], compressionLevel);
+			raw[k] = QByteArray();
+		}
+		if (cb != nullptr)
+			cb(100 * roundEnd / chunkNum, "Compressing chunks");
+	}
+
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out.writeRawData(packMagic, sizeof(packMagic));
+	out << packVersion << quint32(QSysInfo::ByteOrder == QSysInfo::LittleEndian ? 1 : 0) << quint32(sizeof(Scalarm)) << quint32(0) << quint64(0);
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		chunks[k].offset = quint64(file.pos());
+		chunks[k].size = quint64(data[k].size());
+		if (out.writeRawData(data[k].constData(), data[k].size()) != data[k].size())
+			return false;
+		data[k] = QByteArray();
+	}
+	const quint64 tocOffset = quint64(file.pos());
+	out << quint32(chunks.size());
+	for (const Chunk& c : chunks)
+		out << c;
+	file.seek(packHeaderSize - qint64(sizeof(quint64)));
+	out << tocOffset;
+	const bool ret = (out.status() == QDataStream::Ok);
+	file.close();
+	return ret;
+}
+
+bool MeshDocumentFromPackFile(MeshDocument &md, const QString& filename, std::map<int, MLRenderingData>& rendOpt,
+	int lazyMask, vcg::CallBackPos* cb)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	in.setByteOrder(QDataStream::LittleEndian);
+
+	char magic[sizeof(packMagic)];
+	quint32 version, littleEndian, scalarSize, reserved;
+	quint64 tocOffset;
+	if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) || memcmp(magic, packMagic, sizeof(magic)) != 0)
+		return false;
+	in >> version >> littleEndian >> scalarSize >> reserved >> tocOffset;
+	if ((in.status() != QDataStream::Ok) || (version != packVersion) ||
+		((littleEndian == 1) != (QSysInfo::ByteOrder == QSysInfo::LittleEndian)) ||
+		((scalarSize != sizeof(float)) && (scalarSize != sizeof(double))) ||
+		(tocOffset < quint64(packHeaderSize)) || (tocOffset > quint64(file.size())))
+		return false;
+
+	// the table of contents, then the compressed data of all the chunks, read sequentially
+	file.seek(qint64(tocOffset));
+	quint32 chunkNum = 0;
+	in >> chunkNum;
+	std::vector<Chunk> chunks;
+	for (quint32 k = 0; k < chunkNum && in.status() == QDataStream::Ok; ++k)
+	{
+		Chunk c;
+		in >> c;
+		if ((c.offset + c.size > tocOffset) || (c.offset < quint64(packHeaderSize)) || (c.mesh < -1))
+			return false;
+		chunks.push_back(c);
+	}
+	if ((in.status() != QDataStream::Ok) || chunks.empty() || (chunks[0].kind != CK_DOCUMENT))
+		return false;
+	std::vector<QByteArray> data(chunks.size());
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		file.seek(qint64(chunks[k].offset));
+		data[k] = file.read(qint64(chunks[k].size));
+		if (quint64(data[k].size()) != chunks[k].size)
+			return false;
+	}
+	file.close();
+
+	// the layers and the rasters, as in a binary project
+	QDomDocument doc("MeshLabDocument");
+	if (!doc.setContent(qUncompress(data[0])))
+		return false;
+	QFileInfo fi(filename);
+	QDir tmpDir = QDir::current();
+	QDir::setCurrent(fi.absoluteDir().absolutePath());
+	const int firstMesh = md.meshList.size();
+	const bool ret = MeshDocumentFromXML(md, doc, true, rendOpt);
+	QDir::setCurrent(tmpDir.absolutePath());
+	if (!ret)
+		return false;
+	std::vector<MeshModel*> meshes;
+	for (int i = firstMesh; i < md.meshList.size(); ++i)
+	{
+		MeshModel* mm = md.meshList[i];
+		mm->setFileName(fi.absoluteDir().absoluteFilePath(mm->fullName()));
+		meshes.push_back(mm);
+	}
+
+	// the meshes are allocated, then all their chunks are decoded together
+	std::vector<int> meshMask(meshes.size(), MeshModel::MM_NONE);
+	std::vector<std::shared_ptr<PackPendingAttributes> > pending(meshes.size());
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		const Chunk& c = chunks[k];
+		if (c.kind != CK_MESHINFO)
+			continue;
+		if (c.mesh < 0 || size_t(c.mesh) >= meshes.size())
+			return false;
+		QByteArray infoData = qUncompress(data[k]);
+		QDataStream stream(infoData);
+		stream.setVersion(QDataStream::Qt_5_0);
+		stream.setByteOrder(QDataStream::LittleEndian);
+		quint64 vn, fn, en;
+		qint32 mask;
+		quint8 color[4];
+		QStringList textures;
+		stream >> vn >> fn >> en >> mask >> color[0] >> color[1] >> color[2] >> color[3] >> textures;
+		if (stream.status() != QDataStream::Ok)
+			return false;
+
+		MeshModel& mm = *meshes[c.mesh];
+		tri::Allocator<CMeshO>::AddVertices(mm.cm, size_t(vn));
+		tri::Allocator<CMeshO>::AddFaces(mm.cm, size_t(fn));
+		tri::Allocator<CMeshO>::AddEdges(mm.cm, size_t(en));
+		mm.cm.C() = Color4b(color[0], color[1], color[2], color[3]);
+		foreach(const QString& t, textures)
+			mm.cm.textures.push_back(t.toStdString());
+		meshMask[c.mesh] = mask;
+		mm.updateDataMask(mask & packDataMask & ~lazyMask);
+		pending[c.mesh] = std::make_shared<PackPendingAttributes>(scalarSize);
+	}
+
+	std::vector<size_t> jobs;
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		const Chunk& c = chunks[k];
+		if (c.kind == CK_DOCUMENT || c.kind == CK_MESHINFO)
+			continue;
+		if (c.mesh < 0 || size_t(c.mesh) >= meshes.size() || pending[c.mesh] == nullptr)
+			return false;
+		const int component = chunkComponent(c.kind);
+		if ((component & ~meshMask[c.mesh]) != 0)
+			continue;
+		if ((component & lazyMask) != 0)
+			pending[c.mesh]->add(c, data[k]);
+		else
+		{
+			if (((c.kind == CK_VERTATTRIBUTE) || (c.kind == CK_FACEATTRIBUTE)) && (c.first == 0))
+				addAttribute(meshes[c.mesh]->cm, c);
+			jobs.push_back(k);
+		}
+	}
+	if (!decodeChunks(meshes, chunks, data, jobs, scalarSize, cb))
+		return false;
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		MeshModel& mm = *meshes[i];
+		mm.updateDataMask(meshMask[i] & packTopologyMask);
+		if (pending[i]->dataMask() != MeshModel::MM_NONE)
+			pending[i]->setVersion(elementsVersion(mm.cm));
+		mm.setPendingAttributes(pending[i]);
+		tri::UpdateBounding<CMeshO>::Box(mm.cm);
+		mm.cm.svn = int(tri::UpdateSelection<CMeshO>::VertexCount(mm.cm));
+		mm.cm.sfn = int(tri::UpdateSelection<CMeshO>::FaceCount(mm.cm));
+	}
+	return true;
+}
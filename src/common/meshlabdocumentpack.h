@@ -0,0 +1,63 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __MESHLABDOC_PACK_H
+#define __MESHLABDOC_PACK_H
+
+#include <map>
+
+#include <wrap/callback.h>
+
+#include "ml_shared_data_context.h"
+#include "ml_document/mesh_document.h"
+
+/*
+MeshLab Document Pack (.mlz)
+A single file with a whole document: the project description (the same xml of a .mlb project,
+with layers, transforms, rendering options and raster metadata) and the data of all the meshes.
+
+Every attribute of a mesh (coordinates, normals, colors, face indices, wedge texture coordinates,
+custom per vertex and per face attributes...) is stored in its own chunks, each one compressed
+on its own (zlib, through qCompress); the attributes of big meshes are split in blocks of
+elements. The chunks are listed in a table of contents at the end of the file, so that any of
+them can be read without decoding the others:
+- on saving, the chunks are compressed in parallel; the document is not modified: the deleted
+  elements are skipped and the others renumbered on the fly, and the components still pending
+  (see below) are saved from their data;
+- on loading, all the meshes are allocated from their element counts and then the chunks
+  are decompressed and decoded in parallel, each one in its range of elements.
+
+The components in lazyMask (e.g. MM_WEDGTEXCOORD, MM_VERTQUALITY) are not decoded on loading:
+their compressed chunks are kept in memory as the pending attributes of the mesh
+(see MeshModel::PendingAttributes) and decoded when they are first requested or queried on the mesh.
+*/
+
+// returns false if the file could not be written
+bool MeshDocumentToPackFile(MeshDocument &md, const QString& filename, bool onlyVisibleLayers, bool saveViewState,
+	const std::map<int, MLRenderingData>& rendOpt = std::map<int, MLRenderingData>(), vcg::CallBackPos* cb = nullptr);
+
+// adds the layers and the rasters of the pack to the document, with their meshes already loaded
+bool MeshDocumentFromPackFile(MeshDocument &md, const QString& filename, std::map<int, MLRenderingData>& rendOpt,
+	int lazyMask = MeshModel::MM_NONE, vcg::CallBackPos* cb = nullptr);
+
+#endif // __MESHLABDOC_PACK_H
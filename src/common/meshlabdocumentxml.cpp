@@ -59,6 +59,16 @@ bool MeshDocumentFromXML(MeshDocument &md, QString filename, bool binary, std::m
 	if (!doc.setContent(&qf))
 		return false;
 
+	bool ret = MeshDocumentFromXML(md, doc, binary, rendOpt);
+
+	QDir::setCurrent(tmpDir.absolutePath());
+	qf.close();
+	return ret;
+}
+
+// the relative paths of the document are resolved with respect to the current directory
+bool MeshDocumentFromXML(MeshDocument &md, const QDomDocument& doc, bool binary, std::map<int, MLRenderingData>& rendOpt)
+{
 	QDomElement root = doc.documentElement();
 
 	QDomNode node;
@@ -171,8 +181,6 @@ bool MeshDocumentFromXML(MeshDocument &md, QString filename, bool binary, std::m
 		node = node.nextSibling();
 	}
 
-	QDir::setCurrent(tmpDir.absolutePath());
-	qf.close();
 	return true;
 }
 
@@ -11,6 +11,7 @@
 QDomDocument MeshDocumentToXML(MeshDocument &md, bool onlyVisibleLayers, bool saveViewState, bool binary, const std::map<int, MLRenderingData>& rendOpt = std::map<int, MLRenderingData>());
 bool MeshDocumentToXMLFile(MeshDocument &md, QString filename, bool onlyVisibleLayers, bool saveViewState, bool binary, const std::map<int, MLRenderingData>& rendOpt = std::map<int, MLRenderingData>());
 bool MeshDocumentFromXML(MeshDocument &md, QString filename, bool binary, std::map<int, MLRenderingData>& rendOpt);
+bool MeshDocumentFromXML(MeshDocument &md, const QDomDocument& doc, bool binary, std::map<int, MLRenderingData>& rendOpt);
 QDomElement RasterModelToXML(RasterModel *mp,QDomDocument &doc, bool binary);
 QDomElement PlaneToXML(RasterPlane* pl,const QString& basePath,QDomDocument& doc);
 #endif // __MESHLABDOC_XML_H
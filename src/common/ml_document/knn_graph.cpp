@@ -0,0 +1,182 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "knn_graph.h"
+
+#include <cstring>
+#include <utility>
+
+#include <vcg/space/index/kdtree/kdtree.h>
+
+static const char* KNN_GRAPH_ATTRIBUTE = "KnnGraphCache";
+
+// a freshly built graph has not been checked against any generation yet
+static const quint64 noGeneration = ~Q_UINT64_C(0);
+
+static inline quint64 finalizeHash(quint64 h)
+{
+	h ^= h >> 33;
+	h *= Q_UINT64_C(0xff51afd7ed558ccd);
+	h ^= h >> 33;
+	h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+	h ^= h >> 33;
+	return h;
+}
+
+KnnGraph::KnnGraph()
+	: kn(0), version(0), generation(noGeneration), vertnum(0)
+{
+}
+
+const KnnGraph& KnnGraph::get(CMeshO& m, int k, vcg::CallBackPos* cb)
+{
+	CMeshO::PerMeshAttributeHandle<KnnGraph> handle =
+		vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<KnnGraph>(m, KNN_GRAPH_ATTRIBUTE);
+	KnnGraph& graph = handle();
+	k = std::max(k, 1);
+	quint64 currentversion = pointSetVersion(m);
+	if ((graph.kn < k) || (graph.vertnum != m.vert.size()) || (graph.version != currentversion))
+	{
+		graph.version = currentversion;
+		graph.generation = noGeneration;
+		graph.build(m, k, cb);
+	}
+	return graph;
+}
+
+void KnnGraph::deleteCache(CMeshO& m)
+{
+	if (vcg::tri::HasPerMeshAttribute(m, KNN_GRAPH_ATTRIBUTE))
+		vcg::tri::Allocator<CMeshO>::DeletePerMeshAttribute(m, KNN_GRAPH_ATTRIBUTE);
+}
+
+void KnnGraph::releaseStaleCache(CMeshO& m, quint64 generation)
+{
+	if (!vcg::tri::HasPerMeshAttribute(m, KNN_GRAPH_ATTRIBUTE))
+		return;
+	CMeshO::PerMeshAttributeHandle<KnnGraph> handle =
+		vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<KnnGraph>(m, KNN_GRAPH_ATTRIBUTE);
+	KnnGraph& graph = handle();
+	//nothing has declared a change of the point set since the last check
+	if (graph.generation == generation)
+		return;
+	if ((graph.vertnum != m.vert.size()) || (graph.version != pointSetVersion(m)))
+		deleteCache(m);
+	else
+		graph.generation = generation;
+}
+
+//FNV-1a on the bit patterns of the positions of each block of vertices, the blocks are then combined in order
+quint64 KnnGraph::pointSetVersion(const CMeshO& m)
+{
+	const int n = int(m.vert.size());
+	const int blocksize = 1 << 16;
+	const int blocks = (n + blocksize - 1) / blocksize;
+	std::vector<quint64> blockhash(blocks);
+
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < blocks; ++b)
+	{
+		quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+		const int last = std::min(n, (b + 1) * blocksize);
+		for (int i = b * blocksize; i < last; ++i)
+		{
+			const CVertexO& v = m.vert[i];
+			if (v.IsD())
+			{
+				h = (h ^ Q_UINT64_C(0xffffffff)) * Q_UINT64_C(0x100000001b3);
+				continue;
+			}
+			quint32 words[sizeof(Point3m) / sizeof(quint32)];
+			memcpy(words, &v.cP(), sizeof(words));
+			for (size_t w = 0; w < sizeof(words) / sizeof(quint32); ++w)
+				h = (h ^ words[w]) * Q_UINT64_C(0x100000001b3);
+		}
+		blockhash[b] = h;
+	}
+
+	quint64 version = finalizeHash(quint64(n));
+	for (int b = 0; b < blocks; ++b)
+		version = finalizeHash(version ^ blockhash[b]);
+	return version;
+}
+
+void KnnGraph::build(const CMeshO& m, int k, vcg::CallBackPos* cb)
+{
+	kn = k;
+	vertnum = m.vert.size();
+	adj.assign(vertnum * size_t(kn), -1);
+	count.assign(vertnum, 0);
+
+	//the kd-tree is built only on the alive vertices
+	std::vector<Point3m> points;
+	std::vector<int> pointvert;
+	points.reserve(m.vn);
+	pointvert.reserve(m.vn);
+	for (size_t i = 0; i < vertnum; ++i)
+	{
+		if (!m.vert[i].IsD())
+		{
+			points.push_back(m.vert[i].cP());
+			pointvert.push_back(int(i));
+		}
+	}
+	if (points.empty())
+		return;
+
+	if (cb)
+		cb(10, "Building the kd-tree");
+	vcg::ConstDataWrapper<Point3m> wrapper(points.data(), int(points.size()));
+	vcg::KdTree<Scalarm> tree(wrapper);
+
+	if (cb)
+		cb(30, "Searching the nearest neighbours");
+	const int pn = int(points.size());
+	//the query point itself is always found, so one more neighbour is asked
+	const int querysize = std::min(kn + 1, pn);
+
+	//the kd-tree is only read by the queries, each thread owns its priority queue
+#pragma omp parallel
+	{
+		vcg::KdTree<Scalarm>::PriorityQueue queue;
+		std::vector<std::pair<Scalarm, int> > found;
+#pragma omp for schedule(dynamic, 1024)
+		for (int p = 0; p < pn; ++p)
+		{
+			tree.doQueryK(points[p], querysize, queue);
+			found.clear();
+			for (int j = 0; j < queue.getNofElements(); ++j)
+			{
+				if (queue.getIndex(j) != p)
+					found.push_back(std::make_pair(queue.getWeight(j), int(queue.getIndex(j))));
+			}
+			std::sort(found.begin(), found.end());
+
+			const size_t v = size_t(pointvert[p]);
+			int c = 0;
+			for (size_t j = 0; (j < found.size()) && (c < kn); ++j, ++c)
+				adj[v * size_t(kn) + c] = pointvert[found[j].second];
+			count[v] = c;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __ML_KNN_GRAPH_H
+#define __ML_KNN_GRAPH_H
+
+#include <algorithm>
+#include <vector>
+#include <QtGlobal>
+
+#include "cmesh.h"
+#include <wrap/callback.h>
+
+/*
+KnnGraph
+The k-nearest neighbours graph of the vertices of a CMeshO.
+
+The graph is built in parallel (one kd-tree, concurrent queries) and it is cached
+as a per mesh attribute of the CMeshO, together with the number of neighbours and
+a version of the point set (a hash of the vertex positions). Every filter asking for
+at most the same number of neighbours on an unchanged point set reuses it.
+After each filter the framework calls releaseStaleCache with the point set generation
+of the MeshModel, so that a graph no longer matching its point set does not keep its
+memory until the next request; the vertices are hashed again only when the generation
+differs from the one the graph has been last checked against.
+
+Neighbours are indexes in m.vert, sorted by increasing distance; the vertex itself
+is never listed and deleted vertices are neither queried nor returned.
+*/
+class KnnGraph
+{
+public:
+	KnnGraph();
+
+	// returns the cached graph of m, (re)building it when it is missing, stale,
+	// or it stores less than k neighbours per vertex.
+	static const KnnGraph& get(CMeshO& m, int k, vcg::CallBackPos* cb = nullptr);
+	static void deleteCache(CMeshO& m);
+	// frees the cached graph of m if its point set has been modified since it was built;
+	// generation is the MeshModel::pointSetGeneration of m
+	static void releaseStaleCache(CMeshO& m, quint64 generation);
+
+	// number of neighbours stored per vertex (it can be greater than the requested one)
+	int k() const { return kn; }
+
+	// the first min(k, available) neighbours of vertex v
+	int neighbourNum(size_t v, int k) const { return std::min(k, count[v]); }
+	const int* neighbours(size_t v) const { return adj.data() + v * size_t(kn); }
+
+	static quint64 pointSetVersion(const CMeshO& m);
+
+private:
+	void build(const CMeshO& m, int k, vcg::CallBackPos* cb);
+
+	int kn;
+	quint64 version;
+	quint64 generation; // the point set generation the graph is known to be valid for
+	size_t vertnum;
+	std::vector<int> adj;
+	std::vector<int> count;
+};
+
+#endif
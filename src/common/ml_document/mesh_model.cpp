@@ -32,6 +32,7 @@
 #include <wrap/gl/math.h>
 
 #include <QDir>
+#include <algorithm>
 #include <utility>
 
 using namespace vcg;
@@ -48,6 +49,9 @@ void MeshModel::Clear()
     cm.Tr.SetIdentity();
     cm.sfn=0;
     cm.svn=0;
+    clearDirtyRanges();
+    pendingAttributes.reset();
+    ++pointGeneration;
 }
 
 void MeshModel::UpdateBoxAndNormals()
@@ -62,6 +66,7 @@ void MeshModel::UpdateBoxAndNormals()
 MeshModel::MeshModel(MeshDocument *_parent, unsigned int id, const QString& fullFileName, const QString& labelName)
 {
     /*glw.m = &(cm);*/
+    pointGeneration = 0;
     Clear();
     parent=_parent;
     _id=id;
@@ -128,11 +133,26 @@ void MeshDocument::setVisible(int meshId, bool val)
 
 bool MeshModel::hasDataMask(const int maskToBeTested) const
 {
+    decodePendingAttributes(maskToBeTested);
     return ((currentDataMask & maskToBeTested)!= 0);
 }
+
+int MeshModel::decodedDataMask() const
+{
+    return currentDataMask;
+}
+
+// the pending components are decoded as soon as someone asks for them, so that they look
+// as any other component of the mesh to the decorators, the editing tools, the renderer...
+void MeshModel::decodePendingAttributes(int mask) const
+{
+    if((pendingAttributes != nullptr) && ((mask & pendingAttributes->dataMask())!=0))
+        const_cast<MeshModel*>(this)->updateDataMask(mask & pendingAttributes->dataMask());
+}
+
 void MeshModel::updateDataMask(MeshModel *m)
 {
-    updateDataMask(m->currentDataMask);
+    updateDataMask(m->dataMask());
 }
 
 void MeshModel::updateDataMask(int neededDataMask)
@@ -171,10 +191,27 @@ void MeshModel::updateDataMask(int neededDataMask)
         cm.vert.EnableTexCoord();
 
     currentDataMask |= neededDataMask;
+
+    if((pendingAttributes != nullptr) && ((neededDataMask & pendingAttributes->dataMask())!=0))
+    {
+        // decode() does not call updateDataMask: the components are already enabled
+        std::shared_ptr<PendingAttributes> pending = pendingAttributes;
+        pending->decode(*this, neededDataMask);
+        if(pending->dataMask() == MM_NONE)
+            pendingAttributes.reset();
+    }
 }
 
 void MeshModel::clearDataMask(int unneededDataMask)
 {
+    // dropped first, so that the tests below do not decode them
+    if(pendingAttributes != nullptr)
+    {
+        pendingAttributes->discard(unneededDataMask);
+        if(pendingAttributes->dataMask() == MM_NONE)
+            pendingAttributes.reset();
+    }
+
     if( ( (unneededDataMask & MM_VERTFACETOPO)!=0)	&& hasDataMask(MM_VERTFACETOPO)) {cm.face.DisableVFAdjacency();
     cm.vert.DisableVFAdjacency(); }
     if( ( (unneededDataMask & MM_FACEFACETOPO)!=0)	&& hasDataMask(MM_FACEFACETOPO))	cm.face.DisableFFAdjacency();
@@ -221,5 +258,115 @@ void MeshModel::setMeshModified(bool b)
 
 int MeshModel::dataMask() const
 {
+    decodePendingAttributes(pendingDataMask());
     return currentDataMask;
 }
+
+void MeshModel::setPendingAttributes(const std::shared_ptr<PendingAttributes>& attributes)
+{
+    pendingAttributes = attributes;
+    if((pendingAttributes != nullptr) && (pendingAttributes->dataMask() == MM_NONE))
+        pendingAttributes.reset();
+}
+
+int MeshModel::pendingDataMask() const
+{
+    return (pendingAttributes != nullptr) ? pendingAttributes->dataMask() : int(MM_NONE);
+}
+
+void MeshModel::markVertDirty(size_t first, size_t last)
+{
+    addDirtyRange(vertDirty, first, last);
+}
+
+void MeshModel::markVertDirty(const CVertexO* v)
+{
+    size_t ind = tri::Index(cm, v);
+    addDirtyRange(vertDirty, ind, ind + 1);
+}
+
+void MeshModel::markFaceDirty(size_t first, size_t last)
+{
+    addDirtyRange(faceDirty, first, last);
+}
+
+void MeshModel::markFaceDirty(const CFaceO* f)
+{
+    size_t ind = tri::Index(cm, f);
+    addDirtyRange(faceDirty, ind, ind + 1);
+}
+
+void MeshModel::markSelectedVertDirty()
+{
+    // consecutive selected vertices are declared as a single range
+    size_t first = 0;
+    bool inrange = false;
+    for (size_t i = 0; i < cm.vert.size(); ++i)
+    {
+        bool sel = !cm.vert[i].IsD() && cm.vert[i].IsS();
+        if (sel && !inrange)
+            first = i;
+        else if (!sel && inrange)
+            addDirtyRange(vertDirty, first, i);
+        inrange = sel;
+    }
+    if (inrange)
+        addDirtyRange(vertDirty, first, cm.vert.size());
+}
+
+void MeshModel::markSelectedFaceDirty()
+{
+    size_t first = 0;
+    bool inrange = false;
+    for (size_t i = 0; i < cm.face.size(); ++i)
+    {
+        bool sel = !cm.face[i].IsD() && cm.face[i].IsS();
+        if (sel && !inrange)
+            first = i;
+        else if (!sel && inrange)
+            addDirtyRange(faceDirty, first, i);
+        inrange = sel;
+    }
+    if (inrange)
+        addDirtyRange(faceDirty, first, cm.face.size());
+}
+
+bool MeshModel::hasDirtyRanges() const
+{
+    return !vertDirty.empty() || !faceDirty.empty();
+}
+
+void MeshModel::clearDirtyRanges()
+{
+    vertDirty.clear();
+    faceDirty.clear();
+}
+
+// The ranges are kept sorted and disjoint: overlapping or adjacent intervals are merged.
+// When they become too fragmented they are collapsed in their bounding interval,
+// refreshing a bit more is always cheaper than tracking an unbounded list.
+void MeshModel::addDirtyRange(std::vector<ElementRange>& ranges, size_t first, size_t last)
+{
+    static const size_t maxRanges = 1024;
+    if (first >= last)
+        return;
+    std::vector<ElementRange>::iterator it = std::lower_bound(ranges.begin(), ranges.end(), ElementRange(first, last));
+    if ((it != ranges.begin()) && ((it - 1)->second >= first))
+        --it;
+    std::vector<ElementRange>::iterator endmerge = it;
+    while ((endmerge != ranges.end()) && (endmerge->first <= last))
+    {
+        first = std::min(first, endmerge->first);
+        last = std::max(last, endmerge->second);
+        ++endmerge;
+    }
+    it = ranges.erase(it, endmerge);
+    ranges.insert(it, ElementRange(first, last));
+
+    if (ranges.size() > maxRanges)
+    {
+        ElementRange all(ranges.front().first, ranges.back().second);
+        ranges.clear();
+        ranges.push_back(all);
+    }
+}
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <map>
+#include <memory>
 
 #include "cmesh.h"
 
@@ -217,11 +218,77 @@ public:
     void updateDataMask(int neededDataMask);
     void clearDataMask(int unneededDataMask);
     int dataMask() const;
+    // the dataMask without the pending components, that are not decoded
+    int decodedDataMask() const;
+
+    /*
+    Pending attributes: per element components that have been read from a file but not decoded yet
+    (e.g. the compressed chunks of a document pack, see meshlabdocumentpack.h).
+    They are decoded as soon as one of their components is requested or queried (updateDataMask(),
+    hasDataMask(), dataMask()), so they are hidden to the rest of MeshLab; only decodedDataMask()
+    does not decode them. clearDataMask() and Clear() drop them.
+    They refer to the vertices and faces of the mesh as it was loaded, so they should be decoded
+    (updateDataMask(pendingDataMask())) before deleting, adding or reordering its elements;
+    the implementations discard them when they detect that the elements have changed.
+    */
+    class PendingAttributes
+    {
+    public:
+        virtual ~PendingAttributes() {}
+        // the components still to be decoded
+        virtual int dataMask() const = 0;
+        // decodes the pending components in mask, already enabled on the mesh
+        virtual void decode(MeshModel& m, int mask) = 0;
+        virtual void discard(int mask) = 0;
+    };
+    void setPendingAttributes(const std::shared_ptr<PendingAttributes>& attributes);
+    std::shared_ptr<const PendingAttributes> getPendingAttributes() const { return pendingAttributes; }
+    int pendingDataMask() const;
 
 
 	bool meshModified() const;
 	void setMeshModified(bool b = true);
+
+    /*
+    Point set generation: a counter increased every time the vertex positions or the number of
+    vertices may have changed (e.g. after a filter whose postConditions contain MM_VERTCOORD or
+    MM_VERTNUMBER). Caches built on the point set (e.g. KnnGraph) compare it with the one they
+    have been checked against, instead of hashing all the vertices again.
+    */
+    quint64 pointSetGeneration() const { return pointGeneration; }
+    void pointSetChanged() { ++pointGeneration; }
     static int io2mm(int single_iobit);
+
+    /*
+    Dirty ranges: half open intervals [first,last) of indexes in cm.vert and cm.face whose
+    attributes have been modified WITHOUT changing the connectivity of the mesh.
+    Interactive tools and filters touching only a small portion of a big mesh can declare it,
+    so that the level of detail streaming renderer (MLLodStreamingRenderer) streams again just the
+    chunks containing them; the buffer objects of the default rendering are updated as a whole.
+    The ranges are consumed (and cleared) by MLSceneGLSharedDataContext::meshAttributesUpdated,
+    together with the attributes updated (e.g. the postConditions of a filter);
+    if no range has been declared the whole mesh is considered modified.
+    */
+    typedef std::pair<size_t, size_t> ElementRange;
+    void markVertDirty(size_t first, size_t last);
+    void markVertDirty(const CVertexO* v);
+    void markFaceDirty(size_t first, size_t last);
+    void markFaceDirty(const CFaceO* f);
+    //declare as modified all the currently selected (and not deleted) vertices/faces
+    void markSelectedVertDirty();
+    void markSelectedFaceDirty();
+    bool hasDirtyRanges() const;
+    const std::vector<ElementRange>& vertDirtyRanges() const { return vertDirty; }
+    const std::vector<ElementRange>& faceDirtyRanges() const { return faceDirty; }
+    void clearDirtyRanges();
+
+private:
+    static void addDirtyRange(std::vector<ElementRange>& ranges, size_t first, size_t last);
+    std::vector<ElementRange> vertDirty;
+    std::vector<ElementRange> faceDirty;
+    void decodePendingAttributes(int mask) const;
+    std::shared_ptr<PendingAttributes> pendingAttributes;
+    quint64 pointGeneration;
 };// end class MeshModel
 
 
@@ -0,0 +1,271 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "mesh_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+MeshRasterizer::MeshRasterizer() :
+	w(0), h(0), points(false), tilesX(0), tilesY(0), sx(1), sy(1)
+{
+}
+
+Point3m MeshRasterizer::barycentric(int x, int y) const
+{
+	const size_t i = size_t(y) * w + x;
+	return Point3m(1 - bary[2 * i] - bary[2 * i + 1], bary[2 * i], bary[2 * i + 1]);
+}
+
+bool MeshRasterizer::project(const Point3m& c, float b1, float b2, Vertex& v) const
+{
+	const vcg::Point2<MESHLAB_SCALAR> pp = shot.Intrinsics.LocalToViewportPx(shot.Intrinsics.Project(c));
+	v.x = float(pp[0]) * sx;
+	v.y = float(pp[1]) * sy;
+	v.invz = 1.0f / float(c[2]);
+	v.b1 = b1;
+	v.b2 = b2;
+	return std::isfinite(v.x) && std::isfinite(v.y);
+}
+
+/*
+The face is clipped on the plane z = zNear of the camera (Sutherland-Hodgman on a single
+plane: at most a quad, split in two triangles); the clipped vertices carry the barycentric
+coords of the original face, so the pixels always refer to it.
+*/
+void MeshRasterizer::setupFace(const CFaceO& f, int index, float zNear, std::vector<Triangle>& out) const
+{
+	Point3m c[3];
+	for (int k = 0; k < 3; ++k)
+		c[k] = shot.ConvertWorldToCameraCoordinates(f.cP(k));
+	const float b[3][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+
+	Vertex poly[4];
+	int n = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		const int k1 = (k + 1) % 3;
+		const bool in0 = c[k][2] >= zNear;
+		const bool in1 = c[k1][2] >= zNear;
+		if (in0 && !project(c[k], b[k][0], b[k][1], poly[n++]))
+			return;
+		if (in0 != in1)
+		{
+			const MESHLAB_SCALAR t = (zNear - c[k][2]) / (c[k1][2] - c[k][2]);
+			const Point3m ci = c[k] + (c[k1] - c[k]) * t;
+			const float b1 = b[k][0] + float(t) * (b[k1][0] - b[k][0]);
+			const float b2 = b[k][1] + float(t) * (b[k1][1] - b[k][1]);
+			if (!project(ci, b1, b2, poly[n++]))
+				return;
+		}
+	}
+
+	for (int i = 1; i + 1 < n; ++i)
+	{
+		Triangle t;
+		t.v[0] = poly[0];
+		t.v[1] = poly[i];
+		t.v[2] = poly[i + 1];
+		t.elem = index;
+		const float area = (t.v[1].x - t.v[0].x) * (t.v[2].y - t.v[0].y) - (t.v[2].x - t.v[0].x) * (t.v[1].y - t.v[0].y);
+		if (area == 0)
+			continue;
+		const float minx = std::min(t.v[0].x, std::min(t.v[1].x, t.v[2].x));
+		const float maxx = std::max(t.v[0].x, std::max(t.v[1].x, t.v[2].x));
+		const float miny = std::min(t.v[0].y, std::min(t.v[1].y, t.v[2].y));
+		const float maxy = std::max(t.v[0].y, std::max(t.v[1].y, t.v[2].y));
+		if (maxx < 0 || maxy < 0 || minx > w || miny > h)
+			continue;
+		out.push_back(t);
+	}
+}
+
+void MeshRasterizer::render(const CMeshO& m, const Shotm& view, int width, int height)
+{
+	shot = view;
+	w = width;
+	h = height;
+	points = (m.fn == 0);
+	sx = float(w) / float(shot.Intrinsics.ViewportPx[0]);
+	sy = float(h) / float(shot.Intrinsics.ViewportPx[1]);
+	tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+	zbuf.assign(size_t(w) * h, std::numeric_limits<float>::max());
+	elem.assign(size_t(w) * h, -1);
+	bary.assign(2 * size_t(w) * h, 0.0f);
+
+	//the near plane of GlShot::GetNearFarPlanes, halved as in the OpenGL rendering
+	float zNear = std::numeric_limits<float>::max();
+	for (int i = 0; i < 8; ++i)
+	{
+		const Point3m corner(
+			(i & 1) ? m.bbox.max[0] : m.bbox.min[0],
+			(i & 2) ? m.bbox.max[1] : m.bbox.min[1],
+			(i & 4) ? m.bbox.max[2] : m.bbox.min[2]);
+		zNear = std::min(zNear, float(shot.Depth(corner)));
+	}
+	if (zNear <= 0)
+		zNear = 0.1f;
+	zNear *= 0.5f;
+
+	const int n = points ? int(m.vert.size()) : int(m.face.size());
+	const int chunkNum = std::max(1, std::min(256, n / 4096));
+	chunkTri.resize(chunkNum);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < chunkNum; ++c)
+	{
+		std::vector<Triangle>& out = chunkTri[c];
+		out.clear();
+		const int begin = int((long long)n * c / chunkNum);
+		const int end = int((long long)n * (c + 1) / chunkNum);
+		for (int i = begin; i < end; ++i)
+		{
+			if (!points)
+			{
+				if (!m.face[i].IsD())
+					setupFace(m.face[i], i, zNear, out);
+				continue;
+			}
+			if (m.vert[i].IsD())
+				continue;
+			const Point3m cp = shot.ConvertWorldToCameraCoordinates(m.vert[i].cP());
+			Triangle t;
+			if (cp[2] < zNear || !project(cp, 0, 0, t.v[0]))
+				continue;
+			if (t.v[0].x < 0 || t.v[0].y < 0 || t.v[0].x >= w || t.v[0].y >= h)
+				continue;
+			t.v[1] = t.v[2] = t.v[0];
+			t.elem = i;
+			out.push_back(t);
+		}
+	}
+	tri.clear();
+	for (int c = 0; c < chunkNum; ++c)
+		tri.insert(tri.end(), chunkTri[c].begin(), chunkTri[c].end());
+
+	//binning: counting sort of the (triangle, tile) pairs on the tile
+	const int tn = int(tri.size());
+	std::vector<int> range(4 * size_t(tn));
+	tileFirst.assign(tilesX * tilesY + 1, 0);
+	for (int i = 0; i < tn; ++i)
+	{
+		const Triangle& t = tri[i];
+		const float minx = std::min(t.v[0].x, std::min(t.v[1].x, t.v[2].x));
+		const float maxx = std::max(t.v[0].x, std::max(t.v[1].x, t.v[2].x));
+		const float miny = std::min(t.v[0].y, std::min(t.v[1].y, t.v[2].y));
+		const float maxy = std::max(t.v[0].y, std::max(t.v[1].y, t.v[2].y));
+		int* r = &range[4 * i];
+		r[0] = std::max(0, int(std::floor(minx))) / TILE_SIZE;
+		r[1] = std::min(w - 1, int(std::floor(maxx))) / TILE_SIZE;
+		r[2] = std::max(0, int(std::floor(miny))) / TILE_SIZE;
+		r[3] = std::min(h - 1, int(std::floor(maxy))) / TILE_SIZE;
+		for (int ty = r[2]; ty <= r[3]; ++ty)
+			for (int tx = r[0]; tx <= r[1]; ++tx)
+				++tileFirst[ty * tilesX + tx + 1];
+	}
+	for (int t = 0; t < tilesX * tilesY; ++t)
+		tileFirst[t + 1] += tileFirst[t];
+	tileTri.resize(tileFirst[tilesX * tilesY]);
+	std::vector<int> next(tileFirst.begin(), tileFirst.end() - 1);
+	for (int i = 0; i < tn; ++i)
+	{
+		const int* r = &range[4 * i];
+		for (int ty = r[2]; ty <= r[3]; ++ty)
+			for (int tx = r[0]; tx <= r[1]; ++tx)
+				tileTri[next[ty * tilesX + tx]++] = i;
+	}
+
+	const int tileNum = tilesX * tilesY;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < tileNum; ++t)
+		rasterizeTile(t);
+}
+
+/*
+Each tile is owned by one thread, that draws its triangles in order with the depth test;
+the pixel centers are sampled, the attributes interpolated with 1/z (perspective correct).
+*/
+void MeshRasterizer::rasterizeTile(int t)
+{
+	const int x0 = (t % tilesX) * TILE_SIZE;
+	const int y0 = (t / tilesX) * TILE_SIZE;
+	const int x1 = std::min(w, x0 + TILE_SIZE);
+	const int y1 = std::min(h, y0 + TILE_SIZE);
+
+	for (int j = tileFirst[t]; j < tileFirst[t + 1]; ++j)
+	{
+		const Triangle& tr = tri[tileTri[j]];
+		const Vertex& a = tr.v[0];
+		const Vertex& b = tr.v[1];
+		const Vertex& c = tr.v[2];
+
+		if (points)
+		{
+			const int px = int(a.x);
+			const int py = int(a.y);
+			if (px < x0 || px >= x1 || py < y0 || py >= y1)
+				continue;
+			const size_t i = size_t(py) * w + px;
+			const float z = 1.0f / a.invz;
+			if (z < zbuf[i])
+			{
+				zbuf[i] = z;
+				elem[i] = tr.elem;
+			}
+			continue;
+		}
+
+		const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		const float invArea = 1.0f / area;
+		const int minx = std::max(x0, int(std::ceil(std::min(a.x, std::min(b.x, c.x)) - 0.5f)));
+		const int maxx = std::min(x1 - 1, int(std::floor(std::max(a.x, std::max(b.x, c.x)) - 0.5f)));
+		const int miny = std::max(y0, int(std::ceil(std::min(a.y, std::min(b.y, c.y)) - 0.5f)));
+		const int maxy = std::min(y1 - 1, int(std::floor(std::max(a.y, std::max(b.y, c.y)) - 0.5f)));
+		for (int py = miny; py <= maxy; ++py)
+		{
+			const float cy = py + 0.5f;
+			for (int px = minx; px <= maxx; ++px)
+			{
+				const float cx = px + 0.5f;
+				const float w0 = ((b.x - cx) * (c.y - cy) - (c.x - cx) * (b.y - cy)) * invArea;
+				const float w1 = ((c.x - cx) * (a.y - cy) - (a.x - cx) * (c.y - cy)) * invArea;
+				const float w2 = 1.0f - w0 - w1;
+				if (w0 < 0 || w1 < 0 || w2 < 0)
+					continue;
+				const float invz = w0 * a.invz + w1 * b.invz + w2 * c.invz;
+				const float z = 1.0f / invz;
+				const size_t i = size_t(py) * w + px;
+				if (z >= zbuf[i])
+					continue;
+				zbuf[i] = z;
+				elem[i] = tr.elem;
+				const float l0 = w0 * a.invz * z;
+				const float l1 = w1 * b.invz * z;
+				const float l2 = w2 * c.invz * z;
+				bary[2 * i] = l0 * a.b1 + l1 * b.b1 + l2 * c.b1;
+				bary[2 * i + 1] = l0 * a.b2 + l1 * b.b2 + l2 * c.b2;
+			}
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __ML_MESH_RASTERIZER_H
+#define __ML_MESH_RASTERIZER_H
+
+#include <vector>
+
+#include "cmesh.h"
+
+/*
+MeshRasterizer
+A tile based software rasterizer of a CMeshO seen from a Shot, used to render the mesh on
+the CPU when there is no OpenGL context (or when many views are rendered at once).
+
+The image is the viewport of the shot scaled to width x height, with the row 0 at the
+bottom as read by glReadPixels. Each pixel stores the visible face, its camera space depth
+and the perspective correct barycentric coordinates of the pixel center on the face: the
+clients shade the pixels from them (a visibility buffer).
+The faces are clipped on the near plane (the one GlShot would use for the bounding box of
+the mesh) and binned into square tiles, then the tiles are rasterized in parallel, one per
+thread; as in the default OpenGL state there is no backface culling.
+Point clouds are drawn as one pixel points, and the buffer stores the vertices.
+The buffers are kept between the calls, so rendering many views of the same size does
+not allocate memory; a rasterizer is not meant to be shared among threads.
+*/
+class MeshRasterizer
+{
+public:
+	MeshRasterizer();
+
+	void render(const CMeshO& m, const Shotm& shot, int width, int height);
+
+	int width() const { return w; }
+	int height() const { return h; }
+	bool pointCloud() const { return points; }
+
+	// index in m.face (m.vert for point clouds) of the element visible in the pixel, -1 if none
+	int element(int x, int y) const { return elem[size_t(y) * w + x]; }
+	// camera space depth of the visible element
+	float depth(int x, int y) const { return zbuf[size_t(y) * w + x]; }
+	// barycentric coords of the pixel center w.r.t. the vertices 0, 1 and 2 of the visible face
+	Point3m barycentric(int x, int y) const;
+
+private:
+	static const int TILE_SIZE = 32;
+
+	// a vertex of a clipped face: screen position, 1/depth and barycentric coords on the face
+	struct Vertex
+	{
+		float x, y;
+		float invz;
+		float b1, b2;
+	};
+
+	struct Triangle
+	{
+		Vertex v[3];
+		int elem;
+	};
+
+	void setupFace(const CFaceO& f, int index, float zNear, std::vector<Triangle>& out) const;
+	bool project(const Point3m& c, float b1, float b2, Vertex& v) const;
+	void rasterizeTile(int t);
+
+	int w;
+	int h;
+	bool points;
+	int tilesX;
+	int tilesY;
+	float sx;
+	float sy;
+	Shotm shot;
+
+	std::vector<float> zbuf;
+	std::vector<int> elem;
+	std::vector<float> bary;   // b1 and b2 of each pixel
+
+	std::vector<std::vector<Triangle> > chunkTri;
+	std::vector<Triangle> tri;
+	// the triangles overlapping tile t are tileTri[tileFirst[t]] ... tileTri[tileFirst[t+1]-1]
+	std::vector<int> tileFirst;
+	std::vector<int> tileTri;
+};
+
+#endif
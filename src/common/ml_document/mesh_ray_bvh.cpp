@@ -0,0 +1,450 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "mesh_ray_bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+MeshRayBVH::MeshRayBVH(const CMeshO& m, vcg::CallBackPos* cb)
+{
+	build(m, cb);
+}
+
+void MeshRayBVH::build(const CMeshO& m, vcg::CallBackPos* cb)
+{
+	std::vector<int> faces;
+	faces.reserve(m.fn);
+	for (size_t i = 0; i < m.face.size(); ++i)
+		if (!m.face[i].IsD())
+			faces.push_back(int(i));
+	const int fn = int(faces.size());
+	if (fn == 0)
+		return;
+
+	if (cb)
+		cb(0, "Building the bounding volume hierarchy");
+
+	std::vector<Box3m> faceBox(fn);
+	std::vector<Point3m> center(fn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i)
+	{
+		const CFaceO& f = m.face[faces[i]];
+		faceBox[i].Set(f.cP(0));
+		faceBox[i].Add(f.cP(1));
+		faceBox[i].Add(f.cP(2));
+		center[i] = faceBox[i].Center();
+	}
+
+	//order[] is partitioned in place: each node owns the range [first, first + count)
+	std::vector<int> order(fn);
+	for (int i = 0; i < fn; ++i)
+		order[i] = i;
+
+	nodes.clear();
+	nodes.reserve(size_t(fn));
+	Node root;
+	root.first = 0;
+	root.count = fn;
+	root.axis = 0;
+	nodes.push_back(root);
+
+	std::vector<int> level(1, 0);
+	std::vector<int> next;
+	std::vector<char> split;
+	while (!level.empty())
+	{
+		const int ln = int(level.size());
+		split.assign(ln, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int l = 0; l < ln; ++l)
+		{
+			Node& n = nodes[level[l]];
+			Box3m centerBox;
+			n.box.SetNull();
+			for (int i = n.first; i < n.first + n.count; ++i)
+			{
+				n.box.Add(faceBox[order[i]]);
+				centerBox.Add(center[order[i]]);
+			}
+			if (n.count <= LEAF_SIZE)
+				continue;
+			const int axis = centerBox.MaxDim();
+			//all the barycenters in the same point: the faces cannot be separated
+			if (centerBox.Dim()[axis] <= 0)
+				continue;
+			const int mid = n.first + n.count / 2;
+			std::nth_element(order.begin() + n.first, order.begin() + mid, order.begin() + n.first + n.count,
+				[&center, axis](int a, int b) { return center[a][axis] < center[b][axis]; });
+			n.axis = axis;
+			split[l] = 1;
+		}
+
+		next.clear();
+		for (int l = 0; l < ln; ++l)
+		{
+			if (!split[l])
+				continue;
+			const int parent = level[l];
+			const int first = nodes[parent].first;
+			const int count = nodes[parent].count;
+			Node child;
+			child.axis = 0;
+			child.first = first;
+			child.count = count / 2;
+			nodes.push_back(child);
+			child.first = first + count / 2;
+			child.count = count - count / 2;
+			nodes.push_back(child);
+			nodes[parent].first = int(nodes.size()) - 2;
+			nodes[parent].count = 0;
+			next.push_back(int(nodes.size()) - 2);
+			next.push_back(int(nodes.size()) - 1);
+		}
+		level.swap(next);
+	}
+
+	if (cb)
+		cb(50, "Building the bounding volume hierarchy");
+
+	tri.resize(fn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i)
+	{
+		const CFaceO& f = m.face[faces[order[i]]];
+		Triangle& t = tri[i];
+		t.p0 = f.cP(0);
+		t.e1 = f.cP(1) - f.cP(0);
+		t.e2 = f.cP(2) - f.cP(0);
+		t.face = faces[order[i]];
+	}
+}
+
+MeshRayBVH::Ray MeshRayBVH::makeRay(const Point3m& origin, const Point3m& dir)
+{
+	Ray r;
+	r.origin = origin;
+	r.dir = dir;
+	for (int k = 0; k < 3; ++k)
+		r.invdir[k] = (dir[k] != 0) ? Scalarm(1) / dir[k] : std::numeric_limits<Scalarm>::max();
+	return r;
+}
+
+bool MeshRayBVH::intersectBox(const Box3m& b, const Ray& r, Scalarm tmin, Scalarm tmax)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		Scalarm t0 = (b.min[k] - r.origin[k]) * r.invdir[k];
+		Scalarm t1 = (b.max[k] - r.origin[k]) * r.invdir[k];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin > tmax)
+			return false;
+	}
+	return true;
+}
+
+bool MeshRayBVH::intersectTriangle(const Triangle& tr, const Ray& r, Scalarm tmin, Scalarm tmax, Scalarm& t, Scalarm& u, Scalarm& v)
+{
+	const Point3m p = r.dir ^ tr.e2;
+	const Scalarm det = tr.e1 * p;
+	if (det == 0)
+		return false;
+	const Scalarm invdet = Scalarm(1) / det;
+	const Point3m s = r.origin - tr.p0;
+	u = (s * p) * invdet;
+	if (u < 0 || u > 1)
+		return false;
+	const Point3m q = s ^ tr.e1;
+	v = (r.dir * q) * invdet;
+	if (v < 0 || u + v > 1)
+		return false;
+	t = (tr.e2 * q) * invdet;
+	return t > tmin && t < tmax;
+}
+
+bool MeshRayBVH::closestHit(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, Hit& hit, int ignoredFace) const
+{
+	if (nodes.empty())
+		return false;
+	const Ray r = makeRay(origin, dir);
+	bool found = false;
+	int stack[STACK_SIZE];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0)
+	{
+		const Node& n = nodes[stack[--sp]];
+		if (!intersectBox(n.box, r, tmin, tmax))
+			continue;
+		if (n.count > 0)
+		{
+			for (int i = n.first; i < n.first + n.count; ++i)
+			{
+				Scalarm t, u, v;
+				if (tri[i].face != ignoredFace && intersectTriangle(tri[i], r, tmin, tmax, t, u, v))
+				{
+					tmax = t;
+					hit.t = t;
+					hit.face = tri[i].face;
+					hit.u = u;
+					hit.v = v;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			//the near child is pushed last to be visited first
+			const bool leftFirst = r.dir[n.axis] >= 0;
+			stack[sp++] = leftFirst ? n.first + 1 : n.first;
+			stack[sp++] = leftFirst ? n.first : n.first + 1;
+		}
+	}
+	return found;
+}
+
+void MeshRayBVH::closestHits(int n, const Point3m* origin, const Point3m* dir, Scalarm tmin, Scalarm tmax, Hit* hit, bool* found) const
+{
+	assert(n <= PACKET_SIZE);
+	Ray r[PACKET_SIZE];
+	Scalarm rayMax[PACKET_SIZE];
+	for (int i = 0; i < n; ++i)
+	{
+		r[i] = makeRay(origin[i], dir[i]);
+		rayMax[i] = tmax;
+		found[i] = false;
+	}
+	if (nodes.empty() || n == 0)
+		return;
+
+	//each entry of the stack carries the rays that reached the parent node (a bit per ray)
+	int stack[STACK_SIZE];
+	unsigned int stackRays[STACK_SIZE];
+	int sp = 0;
+	stack[sp] = 0;
+	stackRays[sp++] = (1u << n) - 1;
+	while (sp > 0)
+	{
+		--sp;
+		const Node& nd = nodes[stack[sp]];
+		unsigned int active = 0;
+		for (int i = 0; i < n; ++i)
+			if ((stackRays[sp] >> i & 1) && intersectBox(nd.box, r[i], tmin, rayMax[i]))
+				active |= 1u << i;
+		if (active == 0)
+			continue;
+		if (nd.count > 0)
+		{
+			for (int j = nd.first; j < nd.first + nd.count; ++j)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					Scalarm t, u, v;
+					if ((active >> i & 1) && intersectTriangle(tri[j], r[i], tmin, rayMax[i], t, u, v))
+					{
+						rayMax[i] = t;
+						hit[i].t = t;
+						hit[i].face = tri[j].face;
+						hit[i].u = u;
+						hit[i].v = v;
+						found[i] = true;
+					}
+				}
+			}
+		}
+		else
+		{
+			//the near child (for the first active ray) is pushed last to be visited first
+			int first = 0;
+			while (!(active >> first & 1))
+				++first;
+			const bool leftFirst = r[first].dir[nd.axis] >= 0;
+			stack[sp] = leftFirst ? nd.first + 1 : nd.first;
+			stackRays[sp++] = active;
+			stack[sp] = leftFirst ? nd.first : nd.first + 1;
+			stackRays[sp++] = active;
+		}
+	}
+}
+
+bool MeshRayBVH::anyHit(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, int ignoredFace) const
+{
+	if (nodes.empty())
+		return false;
+	const Ray r = makeRay(origin, dir);
+	int stack[STACK_SIZE];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0)
+	{
+		const Node& n = nodes[stack[--sp]];
+		if (!intersectBox(n.box, r, tmin, tmax))
+			continue;
+		if (n.count > 0)
+		{
+			for (int i = n.first; i < n.first + n.count; ++i)
+			{
+				Scalarm t, u, v;
+				if (tri[i].face != ignoredFace && intersectTriangle(tri[i], r, tmin, tmax, t, u, v))
+					return true;
+			}
+		}
+		else
+		{
+			stack[sp++] = n.first + 1;
+			stack[sp++] = n.first;
+		}
+	}
+	return false;
+}
+
+void MeshRayBVH::allHits(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, std::vector<Scalarm>& ts) const
+{
+	ts.clear();
+	if (nodes.empty())
+		return;
+	const Ray r = makeRay(origin, dir);
+	int stack[STACK_SIZE];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0)
+	{
+		const Node& n = nodes[stack[--sp]];
+		if (!intersectBox(n.box, r, tmin, tmax))
+			continue;
+		if (n.count > 0)
+		{
+			for (int i = n.first; i < n.first + n.count; ++i)
+			{
+				Scalarm t, u, v;
+				if (intersectTriangle(tri[i], r, tmin, tmax, t, u, v))
+					ts.push_back(t);
+			}
+		}
+		else
+		{
+			stack[sp++] = n.first + 1;
+			stack[sp++] = n.first;
+		}
+	}
+}
+
+Scalarm MeshRayBVH::squaredBoxDistance(const Box3m& b, const Point3m& p)
+{
+	Scalarm d2 = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		const Scalarm d = std::max(Scalarm(0), std::max(b.min[k] - p[k], p[k] - b.max[k]));
+		d2 += d * d;
+	}
+	return d2;
+}
+
+//the region tests of Ericson, "Real-Time Collision Detection", 5.1.5
+Point3m MeshRayBVH::closestTrianglePoint(const Triangle& tr, const Point3m& p)
+{
+	const Point3m& a = tr.p0;
+	const Point3m& ab = tr.e1;
+	const Point3m& ac = tr.e2;
+	const Point3m ap = p - a;
+	const Scalarm d1 = ab * ap;
+	const Scalarm d2 = ac * ap;
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+
+	const Point3m bp = ap - ab;
+	const Scalarm d3 = ab * bp;
+	const Scalarm d4 = ac * bp;
+	if (d3 >= 0 && d4 <= d3)
+		return a + ab;
+
+	const Scalarm vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + ab * (d1 / (d1 - d3));
+
+	const Point3m cp = ap - ac;
+	const Scalarm d5 = ab * cp;
+	const Scalarm d6 = ac * cp;
+	if (d6 >= 0 && d5 <= d6)
+		return a + ac;
+
+	const Scalarm vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + ac * (d2 / (d2 - d6));
+
+	const Scalarm va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	const Scalarm denom = va + vb + vc;
+	//degenerate triangle: all the regions tests failed only for numerical noise
+	if (denom <= 0)
+		return a;
+	return a + ab * (vb / denom) + ac * (vc / denom);
+}
+
+bool MeshRayBVH::closestPoint(const Point3m& p, Scalarm maxDist, Point3m& closest, int& face) const
+{
+	if (nodes.empty())
+		return false;
+	Scalarm best2 = maxDist * maxDist;
+	bool found = false;
+	int stack[STACK_SIZE];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0)
+	{
+		const Node& n = nodes[stack[--sp]];
+		if (squaredBoxDistance(n.box, p) >= best2)
+			continue;
+		if (n.count > 0)
+		{
+			for (int i = n.first; i < n.first + n.count; ++i)
+			{
+				const Point3m q = closestTrianglePoint(tri[i], p);
+				const Scalarm d2 = (q - p).SquaredNorm();
+				if (d2 < best2)
+				{
+					best2 = d2;
+					closest = q;
+					face = tri[i].face;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			//the near child is pushed last to be visited first
+			const bool leftFirst = squaredBoxDistance(nodes[n.first].box, p) <= squaredBoxDistance(nodes[n.first + 1].box, p);
+			stack[sp++] = leftFirst ? n.first + 1 : n.first;
+			stack[sp++] = leftFirst ? n.first : n.first + 1;
+		}
+	}
+	return found;
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __ML_MESH_RAY_BVH_H
+#define __ML_MESH_RAY_BVH_H
+
+#include <vector>
+
+#include "cmesh.h"
+#include <wrap/callback.h>
+
+/*
+MeshRayBVH
+A bounding volume hierarchy on the faces of a CMeshO, used to cast rays on the CPU
+(e.g. by the filters that otherwise need an OpenGL context to render the mesh) and to
+find the closest point of the mesh to a point.
+
+The tree is a binary tree of boxes split at the median of the face barycenters;
+it is built level by level, with the nodes of each level processed in parallel.
+After the construction the queries are read only, so any number of threads can
+cast rays at the same time.
+The tree is a snapshot: it must be rebuilt when the mesh changes.
+*/
+class MeshRayBVH
+{
+public:
+	struct Hit
+	{
+		Scalarm t;   // ray parameter: the hit point is origin + t * dir
+		int face;    // index in m.face
+		Scalarm u;   // barycentric coords of the hit point w.r.t. the vertices 1 and 2 of the face
+		Scalarm v;
+	};
+
+	MeshRayBVH(const CMeshO& m, vcg::CallBackPos* cb = nullptr);
+
+	bool empty() const { return tri.empty(); }
+
+	// the nearest hit with t in (tmin, tmax); the face ignoredFace (if any) is never hit.
+	bool closestHit(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, Hit& hit, int ignoredFace = -1) const;
+
+	static const int PACKET_SIZE = 8;
+
+	// closestHit for a packet of n <= PACKET_SIZE rays, traversed together: each node is
+	// visited once for all the rays that reach it, so coherent rays (near origins, similar
+	// directions) share the walk of the tree. found[i] is false if the ray i hits nothing.
+	void closestHits(int n, const Point3m* origin, const Point3m* dir, Scalarm tmin, Scalarm tmax, Hit* hit, bool* found) const;
+
+	// true if any face is hit with t in (tmin, tmax)
+	bool anyHit(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, int ignoredFace = -1) const;
+
+	// the t of all the hits in (tmin, tmax), in no particular order
+	void allHits(const Point3m& origin, const Point3m& dir, Scalarm tmin, Scalarm tmax, std::vector<Scalarm>& ts) const;
+
+	// the closest point of the mesh to p, if it is nearer than maxDist; unlike the vcg grids
+	// it does not use the marks of the mesh, so it can be called by many threads at once
+	bool closestPoint(const Point3m& p, Scalarm maxDist, Point3m& closest, int& face) const;
+
+private:
+	static const int LEAF_SIZE = 4;
+	static const int STACK_SIZE = 96;
+
+	struct Node
+	{
+		Box3m box;
+		int first;   // leaf: first triangle; inner node: index of the left child (the right one follows)
+		int count;   // leaf: number of triangles; inner node: 0
+		int axis;    // split axis of an inner node
+	};
+
+	// a triangle ready for the Moller-Trumbore test
+	struct Triangle
+	{
+		Point3m p0;
+		Point3m e1;
+		Point3m e2;
+		int face;
+	};
+
+	struct Ray
+	{
+		Point3m origin;
+		Point3m dir;
+		Point3m invdir;
+	};
+
+	void build(const CMeshO& m, vcg::CallBackPos* cb);
+
+	static bool intersectBox(const Box3m& b, const Ray& r, Scalarm tmin, Scalarm tmax);
+	static bool intersectTriangle(const Triangle& tr, const Ray& r, Scalarm tmin, Scalarm tmax, Scalarm& t, Scalarm& u, Scalarm& v);
+	static Ray makeRay(const Point3m& origin, const Point3m& dir);
+	static Scalarm squaredBoxDistance(const Box3m& b, const Point3m& p);
+	static Point3m closestTrianglePoint(const Triangle& tr, const Point3m& p);
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> tri;
+};
+
+#endif
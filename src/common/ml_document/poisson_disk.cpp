@@ -0,0 +1,482 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "poisson_disk.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <vcg/complex/algorithms/point_sampling.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+const unsigned long long EMPTY_KEY = ~0ull;
+
+// faces of each chunk of the montecarlo sampling, that has its own random generator
+const int CHUNK_SIZE = 4096;
+
+//sorts independent chunks in parallel and then merges them pairwise
+template <class T>
+void parallelSort(std::vector<T>& v)
+{
+	int chunks = 1;
+#ifdef _OPENMP
+	chunks = omp_get_max_threads();
+#endif
+	if (chunks < 2 || v.size() < 65536)
+	{
+		std::sort(v.begin(), v.end());
+		return;
+	}
+	std::vector<size_t> bound(chunks + 1);
+	for (int c = 0; c <= chunks; ++c)
+		bound[c] = (v.size() * c) / chunks;
+
+#pragma omp parallel for schedule(static, 1)
+	for (int c = 0; c < chunks; ++c)
+		std::sort(v.begin() + bound[c], v.begin() + bound[c + 1]);
+
+	for (int width = 1; width < chunks; width *= 2)
+	{
+#pragma omp parallel for schedule(static, 1)
+		for (int c = 0; c < chunks; c += 2 * width)
+		{
+			if (c + width < chunks)
+				std::inplace_merge(v.begin() + bound[c], v.begin() + bound[c + width], v.begin() + bound[std::min(c + 2 * width, chunks)]);
+		}
+	}
+}
+
+inline size_t hashSlot(unsigned long long k, size_t mask)
+{
+	return size_t((k * 0x9E3779B97F4A7C15ull) >> 17) & mask;
+}
+
+// per vertex radius over the base one, from the quality (vcg InitRadiusHandleFromQuality)
+void radiusFromQuality(const CMeshO& m, Scalarm variance, bool invert, std::vector<Scalarm>& r)
+{
+	Scalarm minQ = std::numeric_limits<Scalarm>::max();
+	Scalarm maxQ = -std::numeric_limits<Scalarm>::max();
+	for (const CVertexO& v : m.vert)
+	{
+		if (v.IsD())
+			continue;
+		minQ = std::min(minQ, v.cQ());
+		maxQ = std::max(maxQ, v.cQ());
+	}
+	const Scalarm deltaQ = maxQ - minQ;
+	r.assign(m.vert.size(), 1);
+	if (!(deltaQ > 0))
+		return;
+#pragma omp parallel for
+	for (int i = 0; i < int(m.vert.size()); ++i)
+	{
+		const Scalarm t = invert ? (maxQ - m.vert[i].cQ()) / deltaQ : (m.vert[i].cQ() - minQ) / deltaQ;
+		r[i] = 1 + (variance - 1) * t;
+	}
+}
+
+} // namespace
+
+PoissonDiskSampler::Params::Params() :
+	adaptiveRadius(false),
+	radiusVariance(1),
+	invertQuality(false),
+	geodesicDistance(false),
+	bestSample(false),
+	bestSamplePool(10),
+	preGen(nullptr),
+	randomSeed(0)
+{
+}
+
+void PoissonDiskSampler::montecarlo(const CMeshO& m, CMeshO& pool, int n, unsigned int seed, Scalarm weightedVariance)
+{
+	std::vector<int> faces;
+	for (int i = 0; i < int(m.face.size()); ++i)
+		if (!m.face[i].IsD())
+			faces.push_back(i);
+	if (faces.empty() || n <= 0)
+		return;
+
+	std::vector<Scalarm> vertRadius;
+	if (weightedVariance != 1)
+		radiusFromQuality(m, weightedVariance, true, vertRadius);
+
+	// the weight of a face is its area (times the squared mean radius of its vertices)
+	const int fn = int(faces.size());
+	std::vector<double> weight(fn);
+#pragma omp parallel for
+	for (int i = 0; i < fn; ++i)
+	{
+		const CFaceO& f = m.face[faces[i]];
+		double w = vcg::DoubleArea(f) / 2;
+		if (!vertRadius.empty())
+		{
+			const double r = (vertRadius[vcg::tri::Index(m, f.cV(0))] + vertRadius[vcg::tri::Index(m, f.cV(1))] + vertRadius[vcg::tri::Index(m, f.cV(2))]) / 3;
+			w *= r * r;
+		}
+		weight[i] = w;
+	}
+
+	const int chunkNum = (fn + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::vector<double> chunkWeight(chunkNum + 1, 0);
+#pragma omp parallel for
+	for (int c = 0; c < chunkNum; ++c)
+	{
+		double w = 0;
+		for (int i = c * CHUNK_SIZE; i < std::min(fn, (c + 1) * CHUNK_SIZE); ++i)
+			w += weight[i];
+		chunkWeight[c + 1] = w;
+	}
+	for (int c = 0; c < chunkNum; ++c)
+		chunkWeight[c + 1] += chunkWeight[c];
+	const double total = chunkWeight[chunkNum];
+	if (!(total > 0))
+		return;
+
+	// the samples of chunk c are the ones in [first[c], first[c+1]), proportional to its weight
+	std::vector<int> first(chunkNum + 1);
+	for (int c = 0; c < chunkNum; ++c)
+		first[c] = int(std::floor(double(n) * chunkWeight[c] / total));
+	first[chunkNum] = n;
+	const size_t base = pool.vert.size();
+	vcg::tri::Allocator<CMeshO>::AddVertices(pool, n);
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < chunkNum; ++c)
+	{
+		const int fBegin = c * CHUNK_SIZE;
+		const int fEnd = std::min(fn, (c + 1) * CHUNK_SIZE);
+		std::vector<double> cumulative(fEnd - fBegin);
+		double w = 0;
+		for (int i = fBegin; i < fEnd; ++i)
+		{
+			w += weight[i];
+			cumulative[i - fBegin] = w;
+		}
+		std::seed_seq seq{ seed, unsigned(c) };
+		std::mt19937 rng(seq);
+		std::uniform_real_distribution<double> unit(0, 1);
+		for (int s = first[c]; s < first[c + 1]; ++s)
+		{
+			const double u = unit(rng) * w;
+			const int i = std::min(int(std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin()), fEnd - fBegin - 1);
+			const CFaceO& f = m.face[faces[fBegin + i]];
+			Scalarm b1 = Scalarm(unit(rng));
+			Scalarm b2 = Scalarm(unit(rng));
+			if (b1 + b2 > 1)
+			{
+				b1 = 1 - b1;
+				b2 = 1 - b2;
+			}
+			const Scalarm b0 = 1 - b1 - b2;
+			CVertexO& v = pool.vert[base + s];
+			v.P() = f.cP(0) * b0 + f.cP(1) * b1 + f.cP(2) * b2;
+			v.N() = (f.cV(0)->cN() * b0 + f.cV(1)->cN() * b1 + f.cV(2)->cN() * b2).Normalize();
+			v.Q() = f.cV(0)->cQ() * b0 + f.cV(1)->cQ() * b1 + f.cV(2)->cQ() * b2;
+		}
+	}
+}
+
+PoissonDiskSampler::PoissonDiskSampler(const CMeshO& pool, const Params& par) :
+	pool(pool), par(par), minScale(1), maxScale(1), side(0), gsize(0, 0, 0)
+{
+	for (int i = 0; i < int(pool.vert.size()); ++i)
+		if (!pool.vert[i].IsD())
+			live.push_back(i);
+	const int n = int(live.size());
+	pos.resize(n);
+	nrm.resize(n);
+	scale.assign(n, 1);
+
+	std::vector<Scalarm> vertRadius;
+	if (par.adaptiveRadius && par.radiusVariance != 1)
+	{
+		radiusFromQuality(pool, par.radiusVariance, par.invertQuality, vertRadius);
+		minScale = std::min(Scalarm(1), par.radiusVariance);
+		maxScale = std::max(Scalarm(1), par.radiusVariance);
+	}
+#pragma omp parallel for
+	for (int i = 0; i < n; ++i)
+	{
+		pos[i] = pool.vert[live[i]].cP();
+		nrm[i] = pool.vert[live[i]].cN();
+		if (!vertRadius.empty())
+			scale[i] = vertRadius[live[i]];
+	}
+
+	for (int i = 0; i < n; ++i)
+		box.Add(pos[i]);
+	if (par.preGen)
+		for (const CVertexO& v : par.preGen->vert)
+			if (!v.IsD())
+				box.Add(v.cP());
+}
+
+PoissonDiskSampler::Key PoissonDiskSampler::cellOf(const Point3m& p) const
+{
+	Key k[3];
+	for (int i = 0; i < 3; ++i)
+		k[i] = Key(std::min(gsize[i] - 1, std::max(0, int((p[i] - box.min[i]) / side))));
+	return k[0] + Key(gsize[0]) * (k[1] + Key(gsize[1]) * k[2]);
+}
+
+void PoissonDiskSampler::buildGrid(Scalarm cellSide)
+{
+	//at most 2^20 cells per side, so that the keys fit in 64 bits
+	side = std::max(cellSide, box.MaxDim() / Scalarm(1 << 20));
+	if (!(side > 0))
+		side = 1;
+	for (int i = 0; i < 3; ++i)
+		gsize[i] = int(box.Dim()[i] / side) + 1;
+
+	const int n = int(pos.size());
+	std::vector<std::pair<Key, int> > keyed(n);
+#pragma omp parallel for
+	for (int i = 0; i < n; ++i)
+		keyed[i] = std::make_pair(cellOf(pos[i]), i);
+	parallelSort(keyed);
+
+	cellKey.clear();
+	cellFirst.clear();
+	cellSample.resize(n);
+	for (int i = 0; i < n; ++i)
+	{
+		if (i == 0 || keyed[i].first != keyed[i - 1].first)
+		{
+			cellKey.push_back(keyed[i].first);
+			cellFirst.push_back(i);
+		}
+		cellSample[i] = keyed[i].second;
+	}
+	cellFirst.push_back(n);
+	const int cn = int(cellKey.size());
+
+	size_t hashSize = 1;
+	while (hashSize < 2 * size_t(cn))
+		hashSize *= 2;
+	hash.assign(hashSize, std::make_pair(EMPTY_KEY, -1));
+	for (int c = 0; c < cn; ++c)
+	{
+		size_t h = hashSlot(cellKey[c], hashSize - 1);
+		while (hash[h].first != EMPTY_KEY)
+			h = (h + 1) & (hashSize - 1);
+		hash[h] = std::make_pair(cellKey[c], c);
+	}
+
+	alive.assign(n, 1);
+	cellLeft.resize(cn);
+	for (int c = 0; c < cn; ++c)
+		cellLeft[c] = cellFirst[c + 1] - cellFirst[c];
+}
+
+int PoissonDiskSampler::findCell(Key k) const
+{
+	const size_t mask = hash.size() - 1;
+	for (size_t h = hashSlot(k, mask); hash[h].first != EMPTY_KEY; h = (h + 1) & mask)
+		if (hash[h].first == k)
+			return hash[h].second;
+	return -1;
+}
+
+Scalarm PoissonDiskSampler::distance(const Point3m& p0, const Point3m& n0, int s) const
+{
+	if (par.geodesicDistance)
+		return vcg::ApproximateGeodesicDistance(p0, n0, pos[s], nrm[s]);
+	return vcg::Distance(p0, pos[s]);
+}
+
+// calls fn(s) for every alive sample s in the disk of radius r around p
+template <class Fn>
+void PoissonDiskSampler::forDisk(const Point3m& p, const Point3m& n, Scalarm r, int reach, Fn fn) const
+{
+	const Key k = cellOf(p);
+	const int cx = int(k % Key(gsize[0]));
+	const int cy = int((k / Key(gsize[0])) % Key(gsize[1]));
+	const int cz = int(k / (Key(gsize[0]) * Key(gsize[1])));
+	for (int z = std::max(0, cz - reach); z <= std::min(gsize[2] - 1, cz + reach); ++z)
+		for (int y = std::max(0, cy - reach); y <= std::min(gsize[1] - 1, cy + reach); ++y)
+			for (int x = std::max(0, cx - reach); x <= std::min(gsize[0] - 1, cx + reach); ++x)
+			{
+				const int c = findCell(Key(x) + Key(gsize[0]) * (Key(y) + Key(gsize[1]) * Key(z)));
+				if (c < 0 || cellLeft[c] == 0)
+					continue;
+				for (int j = cellFirst[c]; j < cellFirst[c + 1]; ++j)
+				{
+					const int s = cellSample[j];
+					if (alive[s] && distance(p, n, s) < r)
+						fn(c, s);
+				}
+			}
+}
+
+void PoissonDiskSampler::removeDisk(const Point3m& p, const Point3m& n, Scalarm r, int reach)
+{
+	forDisk(p, n, r, reach, [this](int c, int s) {
+		alive[s] = 0;
+		--cellLeft[c];
+	});
+}
+
+// the first alive sample of the cell or, with the best sample heuristic, the one with the fewest samples in its disk
+int PoissonDiskSampler::chooseSample(int c, Scalarm radius, int reach) const
+{
+	int best = -1;
+	int bestCount = std::numeric_limits<int>::max();
+	int tried = 0;
+	for (int j = cellFirst[c]; j < cellFirst[c + 1]; ++j)
+	{
+		const int s = cellSample[j];
+		if (!alive[s])
+			continue;
+		if (!par.bestSample)
+			return s;
+		int count = 0;
+		forDisk(pos[s], nrm[s], radius * scale[s], reach, [&count](int, int) { ++count; });
+		if (count < bestCount)
+		{
+			best = s;
+			bestCount = count;
+		}
+		if (++tried >= par.bestSamplePool)
+			break;
+	}
+	return best;
+}
+
+void PoissonDiskSampler::prune(Scalarm radius, std::vector<int>& samples)
+{
+	samples.clear();
+	if (pos.empty())
+		return;
+	buildGrid(radius * minScale / std::sqrt(Scalarm(3)));
+	const int reach = std::max(1, int(std::ceil(radius * maxScale / side)));
+
+	if (par.preGen)
+	{
+		for (const CVertexO& v : par.preGen->vert)
+			if (!v.IsD())
+				removeDisk(v.cP(), v.cN(), radius, reach);
+	}
+
+	//phase groups: the cells whose indices are congruent modulo 2*reach+1, in a random order
+	const int period = 2 * reach + 1;
+	const int phaseNum = period * period * period;
+	const int cn = int(cellKey.size());
+	std::vector<int> phaseFirst(phaseNum + 1, 0);
+	std::vector<int> cellPhase(cn);
+	for (int c = 0; c < cn; ++c)
+	{
+		const Key k = cellKey[c];
+		const int x = int(k % Key(gsize[0])) % period;
+		const int y = int((k / Key(gsize[0])) % Key(gsize[1])) % period;
+		const int z = int(k / (Key(gsize[0]) * Key(gsize[1]))) % period;
+		cellPhase[c] = x + period * (y + period * z);
+		++phaseFirst[cellPhase[c] + 1];
+	}
+	for (int p = 0; p < phaseNum; ++p)
+		phaseFirst[p + 1] += phaseFirst[p];
+	std::vector<int> phaseCell(cn);
+	std::vector<int> next(phaseFirst.begin(), phaseFirst.end() - 1);
+	for (int c = 0; c < cn; ++c)
+		phaseCell[next[cellPhase[c]]++] = c;
+	std::vector<int> order(phaseNum);
+	for (int p = 0; p < phaseNum; ++p)
+		order[p] = p;
+	std::mt19937 rng(par.randomSeed);
+	std::shuffle(order.begin(), order.end(), rng);
+
+	std::vector<int> pick(cn, -1);
+	for (;;)
+	{
+		size_t before = samples.size();
+		for (int p : order)
+		{
+			const int begin = phaseFirst[p];
+			const int end = phaseFirst[p + 1];
+#pragma omp parallel for schedule(dynamic, 64)
+			for (int i = begin; i < end; ++i)
+			{
+				const int c = phaseCell[i];
+				pick[c] = -1;
+				if (cellLeft[c] == 0)
+					continue;
+				const int s = chooseSample(c, radius, reach);
+				pick[c] = s;
+				removeDisk(pos[s], nrm[s], radius * scale[s], reach);
+				if (alive[s])
+				{
+					alive[s] = 0;
+					--cellLeft[c];
+				}
+			}
+			for (int i = begin; i < end; ++i)
+				if (pick[phaseCell[i]] >= 0)
+					samples.push_back(live[pick[phaseCell[i]]]);
+		}
+		if (samples.size() == before)
+			break;
+	}
+}
+
+Scalarm PoissonDiskSampler::pruneByNumber(int sampleNum, Scalarm tolerance, std::vector<int>& samples)
+{
+	const size_t sampleNumMin = size_t(sampleNum * (1 - tolerance));
+	const size_t sampleNumMax = size_t(sampleNum * (1 + tolerance));
+	const int maxIter = 20;
+
+	//a radius giving too many samples and one giving too few
+	Scalarm minRad = box.Diag() / 50;
+	Scalarm maxRad = box.Diag() / 50;
+	int iter = 0;
+	do
+	{
+		minRad /= 2;
+		prune(minRad, samples);
+	} while (samples.size() < size_t(sampleNum) && ++iter < maxIter);
+	iter = 0;
+	do
+	{
+		maxRad *= 2;
+		prune(maxRad, samples);
+	} while (samples.size() > size_t(sampleNum) && ++iter < maxIter);
+
+	Scalarm radius = maxRad;
+	for (iter = 0; iter < maxIter && (samples.size() < sampleNumMin || samples.size() > sampleNumMax); ++iter)
+	{
+		radius = (minRad + maxRad) / 2;
+		prune(radius, samples);
+		if (samples.size() > size_t(sampleNum))
+			minRad = radius;
+		if (samples.size() < size_t(sampleNum))
+			maxRad = radius;
+	}
+	return radius;
+}
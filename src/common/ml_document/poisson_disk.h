@@ -0,0 +1,113 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __ML_POISSON_DISK_H
+#define __ML_POISSON_DISK_H
+
+#include <vector>
+
+#include "cmesh.h"
+
+/*
+PoissonDiskSampler
+The Poisson-disk sampling of vcg::tri::SurfaceSampling (a montecarlo pool of points on the
+surface, pruned so that no two samples are nearer than the disk radius) run by many threads.
+
+The montecarlo pool is generated in chunks of faces, each one with its own random generator
+and a number of samples proportional to its area.
+The pruning buckets the pool in a grid whose cells have the radius as diagonal, so a sample
+clears its own cell. The cells whose indices are congruent modulo 2*reach+1 (reach: the
+cells covered by the largest disk) never read or remove the same samples: each of these
+phase groups is processed in parallel, every cell choosing one of its samples and removing
+the disk around it, and the phases are repeated until no sample is left.
+The result depends on the random seed only, not on the number of threads.
+*/
+class PoissonDiskSampler
+{
+public:
+	struct Params
+	{
+		bool adaptiveRadius;     // the radius varies between r and r*radiusVariance with the quality of the pool
+		Scalarm radiusVariance;
+		bool invertQuality;
+		bool geodesicDistance;   // vcg::ApproximateGeodesicDistance instead of the euclidean distance
+		bool bestSample;         // the sample removing fewer samples among the first bestSamplePool of a cell
+		int bestSamplePool;
+		const CMeshO* preGen;    // samples already chosen: their disks are removed from the pool first
+		unsigned int randomSeed;
+
+		Params();
+	};
+
+	// appends to pool n points uniformly distributed on the faces of m, with the interpolated
+	// normal and quality; with weightedVariance != 1 the density follows the vertex quality
+	// as in vcg::tri::SurfaceSampling::WeightedMontecarlo
+	static void montecarlo(const CMeshO& m, CMeshO& pool, int n, unsigned int seed, Scalarm weightedVariance = 1);
+
+	PoissonDiskSampler(const CMeshO& pool, const Params& par);
+
+	// the indices in pool.vert of the samples kept with disk radius r (the preGen ones excluded)
+	void prune(Scalarm radius, std::vector<int>& samples);
+
+	// bisection on the radius as vcg::tri::SurfaceSampling::PoissonDiskPruningByNumber, until
+	// the samples are sampleNum within the tolerance (a fraction of sampleNum); returns the radius
+	Scalarm pruneByNumber(int sampleNum, Scalarm tolerance, std::vector<int>& samples);
+
+	// size of the grid of the last pruning and number of its non empty cells
+	vcg::Point3i gridSize() const { return gsize; }
+	int gridCellNum() const { return int(cellKey.size()); }
+
+private:
+	typedef unsigned long long Key;
+
+	void buildGrid(Scalarm cellSide);
+	int findCell(Key k) const;
+	Key cellOf(const Point3m& p) const;
+	Scalarm distance(const Point3m& p0, const Point3m& n0, int s) const;
+	int chooseSample(int c, Scalarm radius, int reach) const;
+	template <class Fn>
+	void forDisk(const Point3m& p, const Point3m& n, Scalarm r, int reach, Fn fn) const;
+	void removeDisk(const Point3m& p, const Point3m& n, Scalarm r, int reach);
+
+	const CMeshO& pool;
+	Params par;
+	std::vector<int> live;          // index in pool.vert of each sample
+	std::vector<Point3m> pos;
+	std::vector<Point3m> nrm;
+	std::vector<Scalarm> scale;     // radius of each sample, over the base one
+	Scalarm minScale;
+	Scalarm maxScale;
+
+	Box3m box;
+	Scalarm side;
+	vcg::Point3i gsize;
+	// the samples in cell c are cellSample[cellFirst[c]] ... cellSample[cellFirst[c+1]-1]
+	std::vector<Key> cellKey;
+	std::vector<int> cellFirst;
+	std::vector<int> cellSample;
+	std::vector<std::pair<Key, int> > hash;   // open addressing table from the cell keys to the cells
+	std::vector<char> alive;
+	std::vector<int> cellLeft;
+};
+
+#endif
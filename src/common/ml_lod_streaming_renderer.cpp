@@ -0,0 +1,821 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "ml_lod_streaming_renderer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <QThread>
+#include <QMutexLocker>
+
+class MLLodStreamingWorker : public QThread
+{
+public:
+	MLLodStreamingWorker(MLLodStreamingRenderer& renderer)
+		:QThread(), _renderer(renderer)
+	{
+	}
+
+protected:
+	void run()
+	{
+		_renderer.run();
+	}
+
+private:
+	MLLodStreamingRenderer& _renderer;
+};
+
+//number of cells along the longest side of a node used by the vertex clustering of the inner nodes
+static const int LOD_CLUSTERING_GRID = 48;
+
+//maximum number of bytes moved to the GPU in a single frame, in order to keep the navigation interactive
+static const std::ptrdiff_t LOD_MAX_UPLOAD_PER_FRAME = 64 * 1024 * 1024;
+
+MLLodStreamingRenderer::MLLodStreamingRenderer(CMeshO& mesh, vcg::QtThreadSafeMemoryInfo& gpumeminfo, size_t primsperchunk)
+	:QObject(), _mesh(mesh), _gpumeminfo(gpumeminfo), _primsperchunk(std::max(primsperchunk, size_t(1024))), _pointcloud(false),
+	_worker(NULL), _ready(0), _stale(0), _abort(0), _suspended(false), _meshbusy(false), _residentbytes(0), _frame(0)
+{
+}
+
+MLLodStreamingRenderer::~MLLodStreamingRenderer()
+{
+	_abort.storeRelease(1);
+	{
+		QMutexLocker locker(&_lock);
+		_cond.wakeAll();
+	}
+	if (_worker != NULL)
+	{
+		_worker->wait();
+		delete _worker;
+	}
+}
+
+void MLLodStreamingRenderer::startBuild()
+{
+	if (_worker != NULL)
+		return;
+	_worker = new MLLodStreamingWorker(*this);
+	_worker->start(QThread::LowPriority);
+}
+
+bool MLLodStreamingRenderer::isReady() const
+{
+	return _ready.loadAcquire() != 0;
+}
+
+void MLLodStreamingRenderer::invalidate()
+{
+	_stale.storeRelease(1);
+	_abort.storeRelease(1);
+	QMutexLocker locker(&_lock);
+	_cond.wakeAll();
+}
+
+bool MLLodStreamingRenderer::isStale() const
+{
+	return _stale.loadAcquire() != 0;
+}
+
+void MLLodStreamingRenderer::suspendMeshAccess()
+{
+	QMutexLocker locker(&_lock);
+	_suspended = true;
+	while (_meshbusy)
+		_cond.wait(&_lock);
+}
+
+void MLLodStreamingRenderer::resumeMeshAccess()
+{
+	QMutexLocker locker(&_lock);
+	_suspended = false;
+	_cond.wakeAll();
+}
+
+bool MLLodStreamingRenderer::abortRequested() const
+{
+	return _abort.loadAcquire() != 0;
+}
+
+bool MLLodStreamingRenderer::acquireMeshAccess()
+{
+	QMutexLocker locker(&_lock);
+	while (_suspended && !abortRequested())
+		_cond.wait(&_lock);
+	if (abortRequested())
+		return false;
+	_meshbusy = true;
+	return true;
+}
+
+void MLLodStreamingRenderer::releaseMeshAccess()
+{
+	QMutexLocker locker(&_lock);
+	_meshbusy = false;
+	_cond.wakeAll();
+}
+
+/********************************* WORKER THREAD *********************************/
+
+void MLLodStreamingRenderer::run()
+{
+	if (!buildHierarchy())
+		return;
+	_ready.storeRelease(1);
+	emit chunkStreamed();
+
+	forever
+	{
+		LodResult res;
+		{
+			QMutexLocker locker(&_lock);
+			while (_leafrequests.empty() && _reclusterrequests.empty() && !abortRequested())
+				_cond.wait(&_lock);
+			if (abortRequested())
+				return;
+			//the leaves are needed to draw the current frame, the refreshed simplifications can wait
+			std::deque<int>& queue = _leafrequests.empty() ? _reclusterrequests : _leafrequests;
+			res.id = queue.front();
+			queue.pop_front();
+		}
+
+		if (!acquireMeshAccess())
+			return;
+		//only the immutable part of the node can be read here, the GL thread could be updating the others
+		LodNode node;
+		node.begin = _nodes[res.id].begin;
+		node.end = _nodes[res.id].end;
+		if (_nodes[res.id].isLeaf())
+			extractLeaf(node, res.buf);
+		else
+		{
+			computeNodeBox(node);
+			clusterNode(node, res.buf);
+		}
+		releaseMeshAccess();
+
+		res.box.SetNull();
+		for (size_t ii = 0; ii < res.buf.size(); ++ii)
+			res.box.Add(vcg::Point3f(res.buf[ii].p[0], res.buf[ii].p[1], res.buf[ii].p[2]));
+
+		{
+			QMutexLocker locker(&_lock);
+			_results.push_back(LodResult());
+			_results.back().id = res.id;
+			_results.back().buf.swap(res.buf);
+			_results.back().box = res.box;
+		}
+		emit chunkStreamed();
+	}
+}
+
+vcg::Point3f MLLodStreamingRenderer::primitiveCenter(size_t prim) const
+{
+	if (_pointcloud)
+		return vcg::Point3f::Construct(_mesh.vert[prim].cP());
+	const CFaceO& f = _mesh.face[prim];
+	return vcg::Point3f::Construct((f.cP(0) + f.cP(1) + f.cP(2)) / Scalarm(3.0));
+}
+
+//computes the bounding box of the node and the bounding intervals of its vertex and face indexes
+void MLLodStreamingRenderer::computeNodeBox(LodNode& node) const
+{
+	node.box.SetNull();
+	node.vfirst = node.ffirst = std::numeric_limits<size_t>::max();
+	node.vlast = node.flast = 0;
+	for (size_t ii = node.begin; ii < node.end; ++ii)
+	{
+		if (_pointcloud)
+		{
+			node.box.Add(vcg::Point3f::Construct(_mesh.vert[_prims[ii]].cP()));
+			node.vfirst = std::min(node.vfirst, _prims[ii]);
+			node.vlast = std::max(node.vlast, _prims[ii] + 1);
+		}
+		else
+		{
+			const CFaceO& f = _mesh.face[_prims[ii]];
+			node.ffirst = std::min(node.ffirst, _prims[ii]);
+			node.flast = std::max(node.flast, _prims[ii] + 1);
+			for (int jj = 0; jj < 3; ++jj)
+			{
+				size_t vi = vcg::tri::Index(_mesh, f.cV(jj));
+				node.box.Add(vcg::Point3f::Construct(f.cP(jj)));
+				node.vfirst = std::min(node.vfirst, vi);
+				node.vlast = std::max(node.vlast, vi + 1);
+			}
+		}
+	}
+}
+
+bool MLLodStreamingRenderer::splitNode(int nodeid, std::vector<int>& tobesplit)
+{
+	const size_t begin = _nodes[nodeid].begin;
+	const size_t end = _nodes[nodeid].end;
+	if (end - begin <= _primsperchunk)
+		return false;
+
+	const vcg::Point3f c = _nodes[nodeid].box.Center();
+	std::vector<size_t>::iterator bounds[9];
+	bounds[0] = _prims.begin() + begin;
+	bounds[8] = _prims.begin() + end;
+	bounds[4] = std::partition(bounds[0], bounds[8], [this, &c](size_t p) { return primitiveCenter(p)[0] < c[0]; });
+	bounds[2] = std::partition(bounds[0], bounds[4], [this, &c](size_t p) { return primitiveCenter(p)[1] < c[1]; });
+	bounds[6] = std::partition(bounds[4], bounds[8], [this, &c](size_t p) { return primitiveCenter(p)[1] < c[1]; });
+	for (int ii = 0; ii < 8; ii += 2)
+		bounds[ii + 1] = std::partition(bounds[ii], bounds[ii + 2], [this, &c](size_t p) { return primitiveCenter(p)[2] < c[2]; });
+
+	//all the primitives collapsed in a single octant (e.g. a cloud of coincident points), further subdivision is useless
+	for (int ii = 0; ii < 8; ++ii)
+		if (size_t(bounds[ii + 1] - bounds[ii]) == end - begin)
+			return false;
+
+	std::vector<int> children;
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		if (bounds[ii + 1] == bounds[ii])
+			continue;
+		LodNode child;
+		child.parent = nodeid;
+		child.begin = bounds[ii] - _prims.begin();
+		child.end = bounds[ii + 1] - _prims.begin();
+		computeNodeBox(child);
+		children.push_back(int(_nodes.size()));
+		tobesplit.push_back(int(_nodes.size()));
+		_nodes.push_back(child);
+	}
+	_nodes[nodeid].children = children;
+	return true;
+}
+
+bool MLLodStreamingRenderer::buildHierarchy()
+{
+	if (!acquireMeshAccess())
+		return false;
+	_pointcloud = (_mesh.fn == 0);
+	_prims.clear();
+	if (_pointcloud)
+	{
+		_prims.reserve(_mesh.vn);
+		for (size_t ii = 0; ii < _mesh.vert.size(); ++ii)
+			if (!_mesh.vert[ii].IsD())
+				_prims.push_back(ii);
+	}
+	else
+	{
+		_prims.reserve(_mesh.fn);
+		for (size_t ii = 0; ii < _mesh.face.size(); ++ii)
+			if (!_mesh.face[ii].IsD())
+				_prims.push_back(ii);
+	}
+	_nodes.clear();
+	_nodes.push_back(LodNode());
+	_nodes[0].begin = 0;
+	_nodes[0].end = _prims.size();
+	computeNodeBox(_nodes[0]);
+	releaseMeshAccess();
+
+	std::vector<int> tobesplit(1, 0);
+	while (!tobesplit.empty())
+	{
+		int nodeid = tobesplit.back();
+		tobesplit.pop_back();
+		if (!acquireMeshAccess())
+			return false;
+		splitNode(nodeid, tobesplit);
+		releaseMeshAccess();
+	}
+
+	//children are always stored after their parent, so a reverse visit is a bottom-up visit
+	for (int ii = int(_nodes.size()) - 1; ii >= 0; --ii)
+	{
+		if (_nodes[ii].isLeaf())
+			continue;
+		if (!acquireMeshAccess())
+			return false;
+		_nodes[ii].error = clusterNode(_nodes[ii], _nodes[ii].cpubuf);
+		releaseMeshAccess();
+
+		//the error must grow going toward the root, otherwise the cut selection could be not consistent
+		for (int ch : _nodes[ii].children)
+			_nodes[ii].error = std::max(_nodes[ii].error, _nodes[ch].error * 1.001f);
+	}
+	return true;
+}
+
+//returns the geometric error of the simplification
+float MLLodStreamingRenderer::clusterNode(const LodNode& node, std::vector<LodVertex>& buf) const
+{
+	struct ClusterAccum
+	{
+		vcg::Point3f p;
+		vcg::Point3f n;
+		float c[4];
+		int cnt;
+	};
+
+	const float side = std::max(node.box.Dim()[node.box.MaxDim()], std::numeric_limits<float>::min());
+	const float cellsize = side / float(LOD_CLUSTERING_GRID);
+
+	std::unordered_map<long long, int> cellmap;
+	std::vector<ClusterAccum> clusters;
+	auto cellOf = [&](const CVertexO& v) -> int
+	{
+		const vcg::Point3f p = vcg::Point3f::Construct(v.cP());
+		long long key = 0;
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			int ind = int((p[kk] - node.box.min[kk]) / cellsize);
+			ind = std::min(std::max(ind, 0), LOD_CLUSTERING_GRID - 1);
+			key = key * LOD_CLUSTERING_GRID + ind;
+		}
+		std::unordered_map<long long, int>::iterator it = cellmap.find(key);
+		int id;
+		if (it == cellmap.end())
+		{
+			id = int(clusters.size());
+			cellmap[key] = id;
+			ClusterAccum acc;
+			acc.p = vcg::Point3f(0.0f, 0.0f, 0.0f);
+			acc.n = vcg::Point3f(0.0f, 0.0f, 0.0f);
+			acc.c[0] = acc.c[1] = acc.c[2] = acc.c[3] = 0.0f;
+			acc.cnt = 0;
+			clusters.push_back(acc);
+		}
+		else
+			id = it->second;
+		ClusterAccum& acc = clusters[id];
+		acc.p += p;
+		acc.n += vcg::Point3f::Construct(v.cN());
+		for (int kk = 0; kk < 4; ++kk)
+			acc.c[kk] += float(v.cC()[kk]);
+		++acc.cnt;
+		return id;
+	};
+
+	auto toLodVertex = [&clusters](int id) -> LodVertex
+	{
+		const ClusterAccum& acc = clusters[id];
+		LodVertex lv;
+		vcg::Point3f p = acc.p / float(acc.cnt);
+		vcg::Point3f n = acc.n;
+		if (n.Norm() > 0.0f)
+			n.Normalize();
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			lv.p[kk] = p[kk];
+			lv.n[kk] = n[kk];
+		}
+		for (int kk = 0; kk < 4; ++kk)
+			lv.c[kk] = GLubyte(acc.c[kk] / float(acc.cnt) + 0.5f);
+		return lv;
+	};
+
+	buf.clear();
+	if (_pointcloud)
+	{
+		for (size_t ii = node.begin; ii < node.end; ++ii)
+			cellOf(_mesh.vert[_prims[ii]]);
+		buf.reserve(clusters.size());
+		for (size_t ii = 0; ii < clusters.size(); ++ii)
+			buf.push_back(toLodVertex(int(ii)));
+	}
+	else
+	{
+		std::unordered_set<unsigned long long> tris;
+		std::vector<vcg::Point3i> trilist;
+		for (size_t ii = node.begin; ii < node.end; ++ii)
+		{
+			const CFaceO& f = _mesh.face[_prims[ii]];
+			int ids[3];
+			for (int jj = 0; jj < 3; ++jj)
+				ids[jj] = cellOf(*f.cV(jj));
+			if ((ids[0] == ids[1]) || (ids[1] == ids[2]) || (ids[2] == ids[0]))
+				continue;
+			int sorted[3] = { ids[0], ids[1], ids[2] };
+			std::sort(sorted, sorted + 3);
+			//cluster ids are smaller than LOD_CLUSTERING_GRID^3 < 2^21
+			unsigned long long key = (((unsigned long long) sorted[0]) << 42) | (((unsigned long long) sorted[1]) << 21) | ((unsigned long long) sorted[2]);
+			if (tris.insert(key).second)
+				trilist.push_back(vcg::Point3i(ids[0], ids[1], ids[2]));
+		}
+		buf.reserve(trilist.size() * 3);
+		for (size_t ii = 0; ii < trilist.size(); ++ii)
+			for (int jj = 0; jj < 3; ++jj)
+				buf.push_back(toLodVertex(trilist[ii][jj]));
+	}
+	return cellsize * std::sqrt(3.0f);
+}
+
+void MLLodStreamingRenderer::extractLeaf(const LodNode& node, std::vector<LodVertex>& buf) const
+{
+	auto toLodVertex = [](const CVertexO& v) -> LodVertex
+	{
+		LodVertex lv;
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			lv.p[kk] = GLfloat(v.cP()[kk]);
+			lv.n[kk] = GLfloat(v.cN()[kk]);
+		}
+		for (int kk = 0; kk < 4; ++kk)
+			lv.c[kk] = v.cC()[kk];
+		return lv;
+	};
+
+	buf.clear();
+	if (_pointcloud)
+	{
+		buf.reserve(node.end - node.begin);
+		for (size_t ii = node.begin; ii < node.end; ++ii)
+			buf.push_back(toLodVertex(_mesh.vert[_prims[ii]]));
+	}
+	else
+	{
+		buf.reserve((node.end - node.begin) * 3);
+		for (size_t ii = node.begin; ii < node.end; ++ii)
+		{
+			const CFaceO& f = _mesh.face[_prims[ii]];
+			for (int jj = 0; jj < 3; ++jj)
+				buf.push_back(toLodVertex(*f.cV(jj)));
+		}
+	}
+}
+
+/*********************************** GL THREAD ***********************************/
+
+bool MLLodStreamingRenderer::isVisible(const LodNode& node, const GLfloat* mvp) const
+{
+	if (node.box.IsNull())
+		return false;
+	unsigned int outside = 0x3f;
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		const GLfloat x = (ii & 1) ? node.box.max[0] : node.box.min[0];
+		const GLfloat y = (ii & 2) ? node.box.max[1] : node.box.min[1];
+		const GLfloat z = (ii & 4) ? node.box.max[2] : node.box.min[2];
+		GLfloat clip[4];
+		for (int rr = 0; rr < 4; ++rr)
+			clip[rr] = mvp[rr] * x + mvp[4 + rr] * y + mvp[8 + rr] * z + mvp[12 + rr];
+		unsigned int code = 0;
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			if (clip[kk] < -clip[3]) code |= (1 << (2 * kk));
+			if (clip[kk] > clip[3]) code |= (1 << (2 * kk + 1));
+		}
+		outside &= code;
+		if (outside == 0)
+			return true;
+	}
+	return false;
+}
+
+float MLLodStreamingRenderer::screenSpaceError(const LodNode& node, const GLfloat* mv, const GLfloat* pr, const GLint* vp) const
+{
+	//pixels per unit of distance at unitary depth along the vertical axis
+	const float pixelscale = pr[5] * float(vp[3]) * 0.5f;
+	const bool ortho = (pr[11] == 0.0f) && (pr[15] == 1.0f);
+	if (ortho)
+		return node.error * pixelscale;
+
+	const vcg::Point3f c = node.box.Center();
+	vcg::Point3f eye;
+	for (int rr = 0; rr < 3; ++rr)
+		eye[rr] = mv[rr] * c[0] + mv[4 + rr] * c[1] + mv[8 + rr] * c[2] + mv[12 + rr];
+	//the error is scaled as the node itself by the modelview (the trackball applies a uniform scale)
+	const float scale = vcg::Point3f(mv[0], mv[1], mv[2]).Norm();
+	const float dist = eye.Norm() - node.box.Diag() * 0.5f * scale;
+	if (dist <= 0.0f)
+		return FLT_MAX;
+	return node.error * scale * pixelscale / dist;
+}
+
+bool MLLodStreamingRenderer::isResident(int nodeid)
+{
+	return _nodes[nodeid].state == RESIDENT;
+}
+
+void MLLodStreamingRenderer::requestExtraction(int nodeid)
+{
+	LodNode& node = _nodes[nodeid];
+	++node.pendingextractions;
+	QMutexLocker locker(&_lock);
+	if (node.isLeaf())
+		_leafrequests.push_back(nodeid);
+	else
+		_reclusterrequests.push_back(nodeid);
+	_cond.wakeAll();
+}
+
+void MLLodStreamingRenderer::requestNode(int nodeid)
+{
+	LodNode& node = _nodes[nodeid];
+	if (node.state != NOT_RESIDENT)
+		return;
+	if (node.isLeaf())
+	{
+		node.state = REQUESTED;
+		requestExtraction(nodeid);
+	}
+	else
+		//the simplified geometry of the inner nodes is always kept in memory
+		node.state = READY;
+}
+
+bool MLLodStreamingRenderer::intersects(const LodNode& node, const std::vector<std::pair<size_t, size_t> >& vertranges, const std::vector<std::pair<size_t, size_t> >& faceranges) const
+{
+	auto hit = [](const std::vector<std::pair<size_t, size_t> >& ranges, size_t first, size_t last) -> bool
+	{
+		for (size_t ii = 0; ii < ranges.size(); ++ii)
+			if ((ranges[ii].first < last) && (first < ranges[ii].second))
+				return true;
+		return false;
+	};
+	return hit(vertranges, node.vfirst, node.vlast) || (!_pointcloud && hit(faceranges, node.ffirst, node.flast));
+}
+
+void MLLodStreamingRenderer::refreshRanges(const std::vector<std::pair<size_t, size_t> >& vertranges, const std::vector<std::pair<size_t, size_t> >& faceranges)
+{
+	//the hierarchy is still under construction over the old data
+	if (!isReady() || isStale())
+	{
+		invalidate();
+		return;
+	}
+	for (size_t ii = 0; ii < _nodes.size(); ++ii)
+	{
+		LodNode& node = _nodes[ii];
+		if (!intersects(node, vertranges, faceranges))
+			continue;
+		if (node.isLeaf())
+		{
+			//a not resident leaf will be extracted from the updated mesh when needed
+			if (node.state == NOT_RESIDENT)
+				continue;
+			if (node.state == READY)
+			{
+				std::vector<LodVertex>().swap(node.cpubuf);
+				node.state = REQUESTED;
+			}
+		}
+		//resident nodes continue to be drawn with the old data until the refreshed ones are available
+		requestExtraction(int(ii));
+	}
+}
+
+void MLLodStreamingRenderer::selectCut(int nodeid, const GLfloat* mv, const GLfloat* pr, const GLfloat* mvp, const GLint* vp, float pixelerror, std::vector<int>& cut)
+{
+	LodNode& node = _nodes[nodeid];
+	if (!isVisible(node, mvp))
+		return;
+	node.lastframe = _frame;
+
+	if (!node.isLeaf() && (screenSpaceError(node, mv, pr, vp) > pixelerror))
+	{
+		bool allresident = true;
+		for (int ch : node.children)
+		{
+			if (!isVisible(_nodes[ch], mvp))
+				continue;
+			_nodes[ch].lastframe = _frame;
+			if (!isResident(ch))
+			{
+				requestNode(ch);
+				allresident = false;
+			}
+		}
+		if (allresident)
+		{
+			for (int ch : node.children)
+				selectCut(ch, mv, pr, mvp, vp, pixelerror, cut);
+			return;
+		}
+	}
+
+	if (isResident(nodeid))
+		cut.push_back(nodeid);
+	else
+		requestNode(nodeid);
+}
+
+void MLLodStreamingRenderer::releaseNode(LodNode& node)
+{
+	if (node.state != RESIDENT)
+		return;
+	if (node.bo != 0)
+		glDeleteBuffers(1, &node.bo);
+	node.bo = 0;
+	_gpumeminfo.releasedMemory(node.bytes);
+	_residentbytes -= node.bytes;
+	node.bytes = 0;
+	node.nvert = 0;
+	node.state = NOT_RESIDENT;
+}
+
+bool MLLodStreamingRenderer::evictFor(std::ptrdiff_t bytes, std::ptrdiff_t gpubudget)
+{
+	while (_residentbytes + bytes > gpubudget)
+	{
+		int victim = -1;
+		for (size_t ii = 0; ii < _nodes.size(); ++ii)
+		{
+			const LodNode& node = _nodes[ii];
+			if ((node.state == RESIDENT) && (node.lastframe < _frame) && ((victim == -1) || (node.lastframe < _nodes[victim].lastframe)))
+				victim = int(ii);
+		}
+		if (victim == -1)
+			return false;
+		releaseNode(_nodes[victim]);
+	}
+	return true;
+}
+
+bool MLLodStreamingRenderer::uploadNode(LodNode& node, std::ptrdiff_t gpubudget)
+{
+	const std::ptrdiff_t bytes = std::ptrdiff_t(node.cpubuf.size() * sizeof(LodVertex));
+	if (!evictFor(bytes, gpubudget))
+		return false;
+	node.bo = 0;
+	if (bytes > 0)
+	{
+		glGenBuffers(1, &node.bo);
+		glBindBuffer(GL_ARRAY_BUFFER, node.bo);
+		glBufferData(GL_ARRAY_BUFFER, bytes, node.cpubuf.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	node.nvert = node.cpubuf.size();
+	node.bytes = bytes;
+	_gpumeminfo.acquiredMemory(bytes);
+	_residentbytes += bytes;
+	//the inner nodes keep their (small) simplified copy, the leaves can always be streamed again from the mesh
+	if (node.isLeaf())
+		std::vector<LodVertex>().swap(node.cpubuf);
+	node.state = RESIDENT;
+	return true;
+}
+
+void MLLodStreamingRenderer::collectResults()
+{
+	std::vector<LodResult> results;
+	{
+		QMutexLocker locker(&_lock);
+		results.swap(_results);
+	}
+	for (size_t ii = 0; ii < results.size(); ++ii)
+	{
+		LodResult& res = results[ii];
+		LodNode& node = _nodes[res.id];
+		--node.pendingextractions;
+		//a newer extraction of the same node is on its way
+		if (node.pendingextractions > 0)
+			continue;
+
+		//the refreshed geometry could have been moved outside the previous box
+		if (node.isLeaf())
+			node.box = res.box;
+		else
+			node.box.Add(res.box);
+		for (int pp = node.parent; pp != -1; pp = _nodes[pp].parent)
+			_nodes[pp].box.Add(node.box);
+
+		if (node.isLeaf() && (node.state == NOT_RESIDENT))
+			continue;
+		node.cpubuf.swap(res.buf);
+		if (node.state == RESIDENT)
+		{
+			const std::ptrdiff_t bytes = std::ptrdiff_t(node.cpubuf.size() * sizeof(LodVertex));
+			if ((bytes == node.bytes) && (node.bo != 0))
+			{
+				//same connectivity: only the content of the buffer is replaced
+				glBindBuffer(GL_ARRAY_BUFFER, node.bo);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, node.cpubuf.data());
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				if (node.isLeaf())
+					std::vector<LodVertex>().swap(node.cpubuf);
+			}
+			else
+			{
+				releaseNode(node);
+				node.state = READY;
+			}
+		}
+		else if (node.state == REQUESTED)
+			node.state = READY;
+	}
+}
+
+void MLLodStreamingRenderer::uploadRequested(std::ptrdiff_t gpubudget)
+{
+	collectResults();
+
+	std::ptrdiff_t uploaded = 0;
+	bool somethinguploaded = false;
+	//parents are stored before their children, so the coarser chunks are uploaded first
+	for (size_t ii = 0; ii < _nodes.size(); ++ii)
+	{
+		LodNode& node = _nodes[ii];
+		if (node.state != READY)
+			continue;
+		//the node is not needed anymore by the current point of view
+		if (node.lastframe + 1 < _frame)
+		{
+			if (node.isLeaf())
+				std::vector<LodVertex>().swap(node.cpubuf);
+			node.state = NOT_RESIDENT;
+			continue;
+		}
+		if ((uploaded < LOD_MAX_UPLOAD_PER_FRAME) && uploadNode(node, gpubudget))
+		{
+			uploaded += node.bytes;
+			somethinguploaded = true;
+		}
+	}
+
+	if (somethinguploaded)
+		emit chunkStreamed();
+}
+
+void MLLodStreamingRenderer::draw(std::ptrdiff_t gpubudget, bool pervertexcolor, float pixelerror)
+{
+	if (!isReady() || isStale() || _nodes.empty())
+		return;
+	++_frame;
+
+	GLfloat mv[16];
+	GLfloat pr[16];
+	GLint vp[4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+	glGetFloatv(GL_PROJECTION_MATRIX, pr);
+	glGetIntegerv(GL_VIEWPORT, vp);
+	GLfloat mvp[16];
+	for (int cc = 0; cc < 4; ++cc)
+		for (int rr = 0; rr < 4; ++rr)
+		{
+			mvp[cc * 4 + rr] = 0.0f;
+			for (int kk = 0; kk < 4; ++kk)
+				mvp[cc * 4 + rr] += pr[kk * 4 + rr] * mv[cc * 4 + kk];
+		}
+
+	std::vector<int> cut;
+	selectCut(0, mv, pr, mvp, vp, pixelerror, cut);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LIGHTING_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnable(GL_NORMALIZE);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	if (pervertexcolor)
+	{
+		glEnable(GL_COLOR_MATERIAL);
+		glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+		glEnableClientState(GL_COLOR_ARRAY);
+	}
+	for (int id : cut)
+	{
+		const LodNode& node = _nodes[id];
+		if (node.nvert == 0)
+			continue;
+		glBindBuffer(GL_ARRAY_BUFFER, node.bo);
+		glVertexPointer(3, GL_FLOAT, sizeof(LodVertex), (const GLvoid*) offsetof(LodVertex, p));
+		glNormalPointer(GL_FLOAT, sizeof(LodVertex), (const GLvoid*) offsetof(LodVertex, n));
+		if (pervertexcolor)
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LodVertex), (const GLvoid*) offsetof(LodVertex, c));
+		glDrawArrays(_pointcloud ? GL_POINTS : GL_TRIANGLES, 0, GLsizei(node.nvert));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glPopClientAttrib();
+	glPopAttrib();
+
+	uploadRequested(gpubudget);
+}
+
+void MLLodStreamingRenderer::deAllocateGPUData()
+{
+	for (size_t ii = 0; ii < _nodes.size(); ++ii)
+		releaseNode(_nodes[ii]);
+}
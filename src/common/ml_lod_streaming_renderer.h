@@ -0,0 +1,193 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __ML_LOD_STREAMING_RENDERER_H
+#define __ML_LOD_STREAMING_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include "ml_document/cmesh.h"
+#include <wrap/qt/qt_thread_safe_memory_info.h>
+
+class MLLodStreamingWorker;
+
+/*
+MLLodStreamingRenderer
+Out-of-core level of detail rendering for meshes that do not fit (or do not render
+interactively) in the GPU memory.
+
+The primitives of the mesh (faces, or vertices for point clouds) are organized in an octree of chunks.
+Inner nodes store a vertex-clustered simplification of all the primitives below them,
+leaves reference the full resolution primitives of the original CMeshO.
+The hierarchy is built by a background thread; the same thread then extracts on request the
+leaf chunks, so that the GUI thread only has to upload ready buffers.
+
+Each frame the cut of the hierarchy is selected by screen-space error, refining a node only
+when all its visible children are already resident. Chunks not used in the current frame are
+evicted (least recently used first) when the GPU memory budget would be exceeded.
+The GPU memory is accounted on the same vcg::QtThreadSafeMemoryInfo used by the buffer object managers.
+*/
+class MLLodStreamingRenderer : public QObject
+{
+	Q_OBJECT
+public:
+	MLLodStreamingRenderer(CMeshO& mesh, vcg::QtThreadSafeMemoryInfo& gpumeminfo, size_t primsperchunk);
+
+	// WARNING! the GPU data are NOT deallocated here, call deAllocateGPUData() with a valid GL context before.
+	~MLLodStreamingRenderer();
+
+	void startBuild();
+	bool isReady() const;
+
+	// the mesh changed: the hierarchy is no longer valid and has to be rebuilt by the owner
+	void invalidate();
+	bool isStale() const;
+
+	// while suspended the background thread does not read the CMeshO (e.g. while a filter is running)
+	void suspendMeshAccess();
+	void resumeMeshAccess();
+
+	// only the chunks containing the given vertex/face index ranges (see MeshModel dirty ranges) are streamed again.
+	// The connectivity of the mesh MUST be unchanged.
+	void refreshRanges(const std::vector<std::pair<size_t, size_t> >& vertranges, const std::vector<std::pair<size_t, size_t> >& faceranges);
+
+	// must be called with a current GL context sharing the buffers of the previous calls
+	void draw(std::ptrdiff_t gpubudget, bool pervertexcolor, float pixelerror = 1.5f);
+	void deAllocateGPUData();
+
+	std::ptrdiff_t residentBytes() const { return _residentbytes; }
+
+signals:
+	void chunkStreamed();
+
+private:
+	friend class MLLodStreamingWorker;
+
+	struct LodVertex
+	{
+		GLfloat p[3];
+		GLfloat n[3];
+		GLubyte c[4];
+	};
+
+	enum ChunkState { NOT_RESIDENT, REQUESTED, READY, RESIDENT };
+
+	struct LodNode
+	{
+		vcg::Box3f box;
+		float error;                    // object space geometric error of the node, zero for full resolution leaves
+		size_t begin;                   // range of the primitives of the node in _prims
+		size_t end;
+		size_t vfirst;                  // bounding intervals of the indexes of the vertices and faces referenced by the node
+		size_t vlast;
+		size_t ffirst;
+		size_t flast;
+		int parent;
+		std::vector<int> children;
+		std::vector<LodVertex> cpubuf;  // simplified geometry (inner nodes) or streamed geometry waiting for upload (leaves)
+		GLuint bo;
+		size_t nvert;
+		std::ptrdiff_t bytes;
+		unsigned int lastframe;
+		ChunkState state;
+		int pendingextractions;         // only the result of the last requested extraction is meaningful
+
+		LodNode()
+			:error(0.0f), begin(0), end(0), vfirst(0), vlast(0), ffirst(0), flast(0), parent(-1),
+			bo(0), nvert(0), bytes(0), lastframe(0), state(NOT_RESIDENT), pendingextractions(0)
+		{
+		}
+
+		bool isLeaf() const { return children.empty(); }
+	};
+
+	//geometry produced by the worker thread, moved into the node by the GL thread
+	struct LodResult
+	{
+		int id;
+		std::vector<LodVertex> buf;
+		vcg::Box3f box;
+	};
+
+	//executed by the worker thread
+	bool buildHierarchy();
+	void run();
+	bool acquireMeshAccess();
+	void releaseMeshAccess();
+	bool abortRequested() const;
+	vcg::Point3f primitiveCenter(size_t prim) const;
+	void computeNodeBox(LodNode& node) const;
+	bool splitNode(int nodeid, std::vector<int>& tobesplit);
+	float clusterNode(const LodNode& node, std::vector<LodVertex>& buf) const;
+	void extractLeaf(const LodNode& node, std::vector<LodVertex>& buf) const;
+
+	//executed by the GL thread
+	bool isVisible(const LodNode& node, const GLfloat* mvp) const;
+	float screenSpaceError(const LodNode& node, const GLfloat* mv, const GLfloat* pr, const GLint* vp) const;
+	void selectCut(int nodeid, const GLfloat* mv, const GLfloat* pr, const GLfloat* mvp, const GLint* vp, float pixelerror, std::vector<int>& cut);
+	bool isResident(int nodeid);
+	void requestNode(int nodeid);
+	void requestExtraction(int nodeid);
+	bool intersects(const LodNode& node, const std::vector<std::pair<size_t, size_t> >& vertranges, const std::vector<std::pair<size_t, size_t> >& faceranges) const;
+	void collectResults();
+	void uploadRequested(std::ptrdiff_t gpubudget);
+	bool uploadNode(LodNode& node, std::ptrdiff_t gpubudget);
+	bool evictFor(std::ptrdiff_t bytes, std::ptrdiff_t gpubudget);
+	void releaseNode(LodNode& node);
+
+	CMeshO& _mesh;
+	vcg::QtThreadSafeMemoryInfo& _gpumeminfo;
+	size_t _primsperchunk;
+	bool _pointcloud;
+
+	std::vector<size_t> _prims;
+	std::vector<LodNode> _nodes;
+
+	MLLodStreamingWorker* _worker;
+	QAtomicInt _ready;
+	QAtomicInt _stale;
+	QAtomicInt _abort;
+
+	//protects _leafrequests, _reclusterrequests, _results and the mesh access gate
+	mutable QMutex _lock;
+	QWaitCondition _cond;
+	std::deque<int> _leafrequests;
+	std::deque<int> _reclusterrequests;
+	std::vector<LodResult> _results;
+	bool _suspended;
+	bool _meshbusy;
+
+	std::ptrdiff_t _residentbytes;
+	unsigned int _frame;
+};
+
+#endif
@@ -3,11 +3,12 @@
 #include "mlexception.h"
 #include <vector>
 #include <QThread>
+#include <wrap/gl/math.h>
 
 #include "ml_document/mesh_document.h"
 
 MLSceneGLSharedDataContext::MLSceneGLSharedDataContext(MeshDocument& md,vcg::QtThreadSafeMemoryInfo& gpumeminfo,bool highprecision,size_t perbatchtriangles, size_t minfacespersmoothrendering)
-    :QGLWidget(),_md(md),_gpumeminfo(gpumeminfo),_perbatchtriangles(perbatchtriangles), _minfacessmoothrendering(minfacespersmoothrendering),_highprecision(highprecision)
+    :QGLWidget(),_md(md),_lodminprimitives(0),_nvcurrentavailable(0),_lodsuspended(0),_gpumeminfo(gpumeminfo),_perbatchtriangles(perbatchtriangles), _minfacessmoothrendering(minfacespersmoothrendering),_highprecision(highprecision)
 {
     if (md.size() != 0)
         throw MLException(QString("MLSceneGLSharedDataContext: MeshDocument is not empty when MLSceneGLSharedDataContext is constructed."));
@@ -34,6 +35,10 @@ MLSceneGLSharedDataContext::MLSceneGLSharedDataContext(MeshDocument& md,vcg::QtT
 
 MLSceneGLSharedDataContext::~MLSceneGLSharedDataContext()
 {
+    //the GPU data have been already released by deAllocateGPUSharedData, here only the background threads are stopped
+    for(MeshIDLodMap::iterator it = _meshlod.begin();it != _meshlod.end();++it)
+        delete it.value();
+    _meshlod.clear();
 }
 
 void MLSceneGLSharedDataContext::setMinFacesForSmoothRendering(size_t fcnum)
@@ -41,6 +46,74 @@ void MLSceneGLSharedDataContext::setMinFacesForSmoothRendering(size_t fcnum)
 	_minfacessmoothrendering = fcnum;
 }
 
+void MLSceneGLSharedDataContext::setLodStreamingMinPrimitives(size_t minprims)
+{
+    _lodminprimitives = minprims;
+}
+
+bool MLSceneGLSharedDataContext::isLodStreamingMesh(int mmid) const
+{
+    if (_lodminprimitives == 0)
+        return false;
+    MeshModel* mm = _md.getMesh(mmid);
+    if (mm == NULL)
+        return false;
+    size_t prims = (mm->cm.fn > 0) ? size_t(mm->cm.fn) : size_t(mm->cm.vn);
+    return (prims > 0) && (prims >= _lodminprimitives);
+}
+
+void MLSceneGLSharedDataContext::suspendLodStreaming(bool suspend)
+{
+    //the requests can be nested (e.g. a filter launched while an edit tool is active), only the outermost one is forwarded to the streaming threads
+    if (suspend)
+    {
+        if (_lodsuspended++ > 0)
+            return;
+    }
+    else
+    {
+        if ((_lodsuspended == 0) || (--_lodsuspended > 0))
+            return;
+    }
+    for(MeshIDLodMap::iterator it = _meshlod.begin();it != _meshlod.end();++it)
+    {
+        if (suspend)
+            it.value()->suspendMeshAccess();
+        else
+            it.value()->resumeMeshAccess();
+    }
+}
+
+MLLodStreamingRenderer* MLSceneGLSharedDataContext::lodStreamingRenderer(int mmid) const
+{
+    MeshIDLodMap::const_iterator it = _meshlod.find(mmid);
+    if (it == _meshlod.end())
+        return NULL;
+    return it.value();
+}
+
+void MLSceneGLSharedDataContext::removeLodStreamingRenderer(int mmid)
+{
+    MeshIDLodMap::iterator it = _meshlod.find(mmid);
+    if (it == _meshlod.end())
+        return;
+    QGLContext* ctx = makeCurrentGLContext();
+    it.value()->deAllocateGPUData();
+    doneCurrentGLContext(ctx);
+    delete it.value();
+    _meshlod.erase(it);
+}
+
+std::ptrdiff_t MLSceneGLSharedDataContext::lodStreamingGPUBudget(const MLLodStreamingRenderer& lod) const
+{
+    //the lod chunks are accounted on the same memory info of the buffer object managers
+    std::ptrdiff_t budget = _gpumeminfo.currentFreeMemory() + lod.residentBytes();
+    //if the driver reports the really available video memory (in KB), we never go over it
+    if (_nvcurrentavailable > 0)
+        budget = std::min(budget, lod.residentBytes() + std::ptrdiff_t(_nvcurrentavailable) * 1024);
+    return budget;
+}
+
 MLSceneGLSharedDataContext::PerMeshMultiViewManager* MLSceneGLSharedDataContext::meshAttributesMultiViewerManager( int mmid ) const
 {
     MeshIDManMap::const_iterator it = _meshboman.find(mmid);
@@ -193,6 +266,8 @@ void MLSceneGLSharedDataContext::meshInserted( int mmid )
 
 void MLSceneGLSharedDataContext::meshRemoved(int mmid)
 {
+    removeLodStreamingRenderer(mmid);
+
     MeshIDManMap::iterator it = _meshboman.find(mmid);
     if (it == _meshboman.end())
         return;
@@ -230,6 +305,25 @@ void MLSceneGLSharedDataContext::setGLOptions( int mmid,QGLContext* viewid,const
 void MLSceneGLSharedDataContext::draw( int mmid,QGLContext* viewid ) const
 {
     PerMeshMultiViewManager* man = meshAttributesMultiViewerManager(mmid);
+    MLLodStreamingRenderer* lod = lodStreamingRenderer(mmid);
+    if (lod != NULL)
+    {
+        MeshModel* mm = _md.getMesh(mmid);
+        if ((mm == NULL) || (man == NULL))
+            return;
+        MLRenderingData dt;
+        man->getPerViewInfo(viewid,dt);
+        MLRenderingData::PRIMITIVE_MODALITY pm = (mm->cm.fn > 0) ? MLRenderingData::PR_SOLID : MLRenderingData::PR_POINTS;
+        if (!dt.isPrimitiveActive(pm))
+            return;
+        MLRenderingData::RendAtts atts;
+        dt.get(pm,atts);
+        glPushMatrix();
+        vcg::glMultMatrix(mm->cm.Tr);
+        lod->draw(lodStreamingGPUBudget(*lod),atts[MLRenderingData::ATT_NAMES::ATT_VERTCOLOR]);
+        glPopMatrix();
+        return;
+    }
     if (man != NULL)
         man->draw(viewid);
 }
@@ -293,6 +387,8 @@ void MLSceneGLSharedDataContext::deAllocateGPUSharedData()
         deAllocateTexturesPerMesh(it.key());
         man->removeAllViewsAndDeallocateBO();
     }
+    for(MeshIDLodMap::iterator it = _meshlod.begin();it != _meshlod.end();++it)
+        it.value()->deAllocateGPUData();
     doneCurrentGLContext(ctx);
 }
 
@@ -304,6 +400,19 @@ void MLSceneGLSharedDataContext::meshAttributesUpdated(int mmid,bool conntectivi
     PerMeshMultiViewManager* man = meshAttributesMultiViewerManager(mmid);
     if (man != NULL)
         man->meshAttributesUpdated(conntectivitychanged,atts);
+    MLLodStreamingRenderer* lod = lodStreamingRenderer(mmid);
+    //the chunks store only positions, normals and vertex colors: the other attributes do not concern them
+    bool lodatts = atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] || atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL] || atts[MLRenderingData::ATT_NAMES::ATT_VERTCOLOR];
+    if ((lod != NULL) && (conntectivitychanged || lodatts))
+    {
+        //when the modified portion of the mesh has been declared only the corresponding chunks are streamed again
+        if (!conntectivitychanged && mm->hasDirtyRanges())
+            lod->refreshRanges(mm->vertDirtyRanges(),mm->faceDirtyRanges());
+        else
+            lod->invalidate();
+    }
+    //the buffer objects managers of vcg have no partial update: they upload again the whole updated attributes
+    mm->clearDirtyRanges();
 }
 
 void MLSceneGLSharedDataContext::meshDeallocated( int /*mmid*/ )
@@ -342,6 +451,29 @@ bool MLSceneGLSharedDataContext::manageBuffers( int mmid )
 
     PerMeshMultiViewManager* man = meshAttributesMultiViewerManager(mmid);
 	
+    MLLodStreamingRenderer* lod = lodStreamingRenderer(mmid);
+    if ((lod != NULL) && (lod->isStale() || !isLodStreamingMesh(mmid)))
+    {
+        removeLodStreamingRenderer(mmid);
+        lod = NULL;
+    }
+
+    //the full resolution buffers of a lod streamed mesh are never allocated
+    if (isLodStreamingMesh(mmid))
+    {
+        if (lod == NULL)
+        {
+            lod = new MLLodStreamingRenderer(mm->cm,_gpumeminfo,_perbatchtriangles);
+            connect(lod,SIGNAL(chunkStreamed()),this,SIGNAL(lodStreamingDataAvailable()));
+            _meshlod[mmid] = lod;
+            if (_lodsuspended > 0)
+                lod->suspendMeshAccess();
+            lod->startBuild();
+            didsomething = true;
+        }
+        return didsomething;
+    }
+
     if (man != NULL)
     {
         QGLContext* ctx = makeCurrentGLContext();
@@ -409,6 +541,7 @@ void MLSceneGLSharedDataContext::updateGPUMemInfo()
 	/*GLenum errorATI =*/ glGetError(); // purge errors
 
     doneCurrentGLContext(ctx);
+    _nvcurrentavailable = (int)currentallocated;
 	emit currentAllocatedGPUMem((int)allmem, (int)currentallocated, (int)ATI_tex[0], (int)ATI_vbo[0]);
 }
 
@@ -28,6 +28,7 @@
 #include <QTimer>
 
 #include "ml_document/cmesh.h"
+#include "ml_lod_streaming_renderer.h"
 #include <wrap/qt/qt_thread_safe_mesh_attributes_multi_viewer_bo_manager.h>
 
 
@@ -340,6 +341,12 @@ public:
 
 	void setMinFacesForSmoothRendering(size_t fcnum);
 
+	//meshes with at least minprims faces (vertices for point clouds) are rendered through a MLLodStreamingRenderer. 0 disables the lod streaming.
+	void setLodStreamingMinPrimitives(size_t minprims);
+	bool isLodStreamingMesh(int mmid) const;
+	//every piece of code modifying a CMeshO while it is rendered (filters, edit tools, loading) must be enclosed in a suspendLodStreaming(true)/suspendLodStreaming(false) pair
+	void suspendLodStreaming(bool suspend);
+
 	vcg::QtThreadSafeMemoryInfo& memoryInfoManager() const
 	{
 		return _gpumeminfo;
@@ -410,12 +417,20 @@ public:
 private:
 	typedef vcg::QtThreadSafeGLMeshAttributesMultiViewerBOManager<CMeshO, QGLContext*, MLPerViewGLOptions> PerMeshMultiViewManager;
 	PerMeshMultiViewManager* meshAttributesMultiViewerManager(int mmid) const;
+	MLLodStreamingRenderer* lodStreamingRenderer(int mmid) const;
+	void removeLodStreamingRenderer(int mmid);
+	std::ptrdiff_t lodStreamingGPUBudget(const MLLodStreamingRenderer& lod) const;
 	QGLContext* makeCurrentGLContext();
 	void doneCurrentGLContext(QGLContext* oldone = NULL);
 
 	MeshDocument& _md;
 	typedef QMap<int, PerMeshMultiViewManager*> MeshIDManMap;
 	MeshIDManMap _meshboman;
+	typedef QMap<int, MLLodStreamingRenderer*> MeshIDLodMap;
+	MeshIDLodMap _meshlod;
+	size_t _lodminprimitives;
+	int _nvcurrentavailable;
+	int _lodsuspended;
 	vcg::QtThreadSafeMemoryInfo& _gpumeminfo;
 	size_t _perbatchtriangles;
 	size_t _minfacessmoothrendering;
@@ -426,6 +441,9 @@ signals:
 
 	void currentAllocatedGPUMem(int nv_all, int nv_current, int ati_tex, int ati_vbo);
 
+	//a chunk of a lod streamed mesh is ready to be drawn, the viewers should be updated
+	void lodStreamingDataAvailable();
+
 	///*signals intended for the plugins living in the same thread*/
 	//void initPerMeshViewRequestST(int,QGLContext*,const MLRenderingData&);
 	//void removePerMeshViewRequestST(QGLContext*);
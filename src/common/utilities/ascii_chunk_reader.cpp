@@ -0,0 +1,335 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "ascii_chunk_reader.h"
+
+#include <cstring>
+#include <QByteArray>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// a window of the file: memory mapped or, if the mapping fails, read in a buffer
+class FileWindow
+{
+public:
+	FileWindow(QFile& file, qint64 pos, qint64 len) : data(nullptr), size(0), file(file), mapped(nullptr)
+	{
+		mapped = file.map(pos, len);
+		if (mapped != nullptr)
+		{
+			data = reinterpret_cast<const char*>(mapped);
+			size = len;
+		}
+		else if (file.seek(pos))
+		{
+			buffer = file.read(len);
+			data = buffer.constData();
+			size = buffer.size();
+		}
+	}
+
+	~FileWindow()
+	{
+		if (mapped != nullptr)
+			file.unmap(mapped);
+	}
+
+	const char* data;
+	qint64 size;
+
+private:
+	QFile& file;
+	uchar* mapped;
+	QByteArray buffer;
+};
+
+inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+}
+
+AsciiChunkReader::Tokenizer::Tokenizer(const char* separators)
+{
+	std::fill(separator, separator + 256, false);
+	for (const char* s = separators; *s != 0; ++s)
+		separator[(unsigned char)*s] = true;
+}
+
+int AsciiChunkReader::Tokenizer::split(const char* begin, const char* end, Token* tokens, int maxTokens) const
+{
+	while (begin < end && isBlank(*begin))
+		++begin;
+	while (end > begin && isBlank(end[-1]))
+		--end;
+
+	int n = 0;
+	const char* p = begin;
+	while (p < end)
+	{
+		const char* s = p;
+		while (p < end && !separator[(unsigned char)*p])
+			++p;
+		if (p > s)
+		{
+			if (n < maxTokens)
+			{
+				//blanks between two separators give an empty token, that is not a number
+				const char* e = p;
+				while (s < e && isBlank(*s))
+					++s;
+				while (e > s && isBlank(e[-1]))
+					--e;
+				tokens[n].begin = s;
+				tokens[n].end = e;
+			}
+			++n;
+		}
+		if (p < end)
+			++p;
+	}
+	return n;
+}
+
+AsciiChunkReader::AsciiChunkReader(const QString& fileName) : file(fileName), offset(0)
+{
+	file.open(QIODevice::ReadOnly);
+}
+
+bool AsciiChunkReader::seek(qint64 pos)
+{
+	if (!file.isOpen() || pos < 0 || pos > file.size())
+		return false;
+	offset = pos;
+	return true;
+}
+
+bool AsciiChunkReader::skipLines(int n)
+{
+	if (!file.isOpen() || !file.seek(offset))
+		return false;
+	for (int i = 0; i < n; ++i)
+	{
+		if (file.atEnd())
+			return false;
+		file.readLine();
+	}
+	offset = file.pos();
+	return true;
+}
+
+size_t AsciiChunkReader::parseLines(const GrowFunction& grow, const LineFunction& parse, OnError onError,
+	std::vector<size_t>& invalidLines, vcg::CallBackPos* cb)
+{
+	invalidLines.clear();
+	if (!file.isOpen())
+		return 0;
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	const int chunkNum = threads * 4;
+	const qint64 fileSize = file.size();
+	const qint64 dataSize = fileSize - offset;
+	qint64 windowSize = WINDOW_SIZE * threads;
+
+	std::vector<qint64> bound(chunkNum + 1);
+	std::vector<size_t> firstLine(chunkNum + 1);
+	std::vector<std::vector<size_t> > invalid(chunkNum);
+	size_t lineNum = 0;
+	qint64 pos = offset;
+	while (pos < fileSize)
+	{
+		const qint64 len = std::min(windowSize, fileSize - pos);
+		FileWindow window(file, pos, len);
+		if (window.size != len)
+			break;
+		const char* data = window.data;
+
+		//the window ends with its last complete line (the last line of the file may have no terminator)
+		qint64 used = len;
+		if (pos + len < fileSize)
+		{
+			while (used > 0 && data[used - 1] != '\n')
+				--used;
+			if (used == 0)
+			{
+				//a line longer than the whole window
+				windowSize *= 2;
+				continue;
+			}
+		}
+
+		//each chunk starts at the beginning of a line
+		bound[0] = 0;
+		bound[chunkNum] = used;
+		for (int c = 1; c < chunkNum; ++c)
+		{
+			qint64 b = used * c / chunkNum;
+			if (b <= bound[c - 1])
+				b = bound[c - 1];
+			else if (data[b - 1] != '\n')
+			{
+				const char* nl = static_cast<const char*>(memchr(data + b, '\n', size_t(used - b)));
+				b = (nl != nullptr) ? (nl - data) + 1 : used;
+			}
+			bound[c] = b;
+		}
+
+		firstLine[0] = 0;
+#pragma omp parallel for schedule(static)
+		for (int c = 0; c < chunkNum; ++c)
+		{
+			const char* b = data + bound[c];
+			const char* e = data + bound[c + 1];
+			size_t n = size_t(std::count(b, e, '\n'));
+			if (e > b && e[-1] != '\n')
+				++n;
+			firstLine[c + 1] = n;
+		}
+		for (int c = 0; c < chunkNum; ++c)
+			firstLine[c + 1] += firstLine[c];
+		const size_t windowLines = firstLine[chunkNum];
+		const double parsedFraction = double(pos + used - offset) / double(dataSize);
+		grow(windowLines, size_t(double(lineNum + windowLines) / parsedFraction));
+
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int c = 0; c < chunkNum; ++c)
+		{
+			invalid[c].clear();
+			size_t line = lineNum + firstLine[c];
+			const char* p = data + bound[c];
+			const char* e = data + bound[c + 1];
+			while (p < e)
+			{
+				const char* nl = static_cast<const char*>(memchr(p, '\n', size_t(e - p)));
+				const char* lineEnd = (nl != nullptr) ? nl : e;
+				if (!parse(line, p, (lineEnd > p && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd))
+				{
+					invalid[c].push_back(line);
+					if (onError == STOP)
+						break;
+				}
+				++line;
+				p = (nl != nullptr) ? nl + 1 : e;
+			}
+		}
+
+		for (int c = 0; c < chunkNum; ++c)
+		{
+			if (invalid[c].empty())
+				continue;
+			if (onError == STOP)
+				return invalid[c].front();
+			invalidLines.insert(invalidLines.end(), invalid[c].begin(), invalid[c].end());
+		}
+		lineNum += windowLines;
+		pos += used;
+		if (cb)
+			cb(int(100 * parsedFraction), "Reading lines");
+	}
+	return lineNum;
+}
+
+bool AsciiChunkReader::toDouble(const char* begin, const char* end, double& v)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	static const int MAX_DIGITS = 19;
+
+	while (begin < end && isBlank(*begin))
+		++begin;
+	while (end > begin && isBlank(end[-1]))
+		--end;
+	v = 0;
+	if (begin == end)
+		return false;
+
+	//fast path: decimal numbers whose digits and power of ten are both exact as double,
+	//so that a single multiplication or division gives the correctly rounded value
+	const char* p = begin;
+	const bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		++p;
+	quint64 mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+	for (; p < end && isDigit(*p); ++p)
+	{
+		anyDigit = true;
+		if (mantissa != 0 || *p != '0')
+			++digits;
+		if (digits <= MAX_DIGITS)
+			mantissa = mantissa * 10 + quint64(*p - '0');
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && isDigit(*p); ++p)
+		{
+			anyDigit = true;
+			if (mantissa != 0 || *p != '0')
+				++digits;
+			if (digits <= MAX_DIGITS)
+			{
+				mantissa = mantissa * 10 + quint64(*p - '0');
+				--exponent;
+			}
+		}
+	}
+	if (anyDigit && p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		bool negativeExp = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negativeExp = (*q++ == '-');
+		if (q < end && isDigit(*q))
+		{
+			int e = 0;
+			for (; q < end && isDigit(*q); ++q)
+				if (e < 100000)
+					e = e * 10 + (*q - '0');
+			exponent += negativeExp ? -e : e;
+			p = q;
+		}
+	}
+	if (anyDigit && p == end && digits <= MAX_DIGITS && mantissa <= (quint64(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		const double d = (exponent < 0) ? double(mantissa) / pow10[-exponent] : double(mantissa) * pow10[exponent];
+		v = negative ? -d : d;
+		return true;
+	}
+
+	//everything else (long mantissas, inf, nan...) and the malformed numbers: the slower conversion of Qt
+	bool ok = false;
+	v = QByteArray(begin, int(end - begin)).toDouble(&ok);
+	if (!ok)
+		v = 0;
+	return ok;
+}
@@ -0,0 +1,158 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef MESHLAB_ASCII_CHUNK_READER_H
+#define MESHLAB_ASCII_CHUNK_READER_H
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include <vcg/complex/complex.h>
+#include <wrap/callback.h>
+
+/*
+AsciiChunkReader
+Parses large line based ASCII files (e.g. point lists with one point per line) in parallel.
+
+The file is read in windows of a few tens of MB per thread, memory mapped when possible.
+Each window is cut after its last complete line and split at line boundaries in chunks;
+the lines of the chunks are counted and then parsed in parallel, so that every line
+knows its index in the file (and the element it fills) before being parsed.
+
+Numbers are parsed by toDouble(), that does not depend on the locale and does not
+allocate; the tokens are pointers into the mapped data.
+*/
+class AsciiChunkReader
+{
+public:
+	enum OnError {
+		SKIP_LINE = 0, // invalid lines are skipped
+		STOP = 1       // the lines are read up to the first invalid one
+	};
+
+	struct Token
+	{
+		const char* begin;
+		const char* end;
+	};
+
+	/*
+	Splits a line in tokens delimited by any of the given separator characters.
+	Empty tokens are skipped and the blanks around each token are trimmed.
+	*/
+	class Tokenizer
+	{
+	public:
+		Tokenizer(const char* separators);
+
+		// returns the number of tokens of the line; only the first maxTokens are stored
+		int split(const char* begin, const char* end, Token* tokens, int maxTokens) const;
+
+	private:
+		bool separator[256];
+	};
+
+	AsciiChunkReader(const QString& fileName);
+
+	bool isOpen() const { return file.isOpen(); }
+
+	// the data to parse starts at the given offset of the file
+	bool seek(qint64 offset);
+
+	// skips n lines; returns false if the file ends before
+	bool skipLines(int n);
+
+	// grow(lines, estimatedTotal): called once per window, before parsing it, with the number of its lines
+	// and an estimate of the number of lines of the whole file.
+	typedef std::function<void(size_t lines, size_t estimatedTotal)> GrowFunction;
+
+	// parse(line, begin, end): called in parallel for each line (without the line terminator);
+	// line is the index of the line from the start of the data. Returns false if the line is invalid.
+	typedef std::function<bool(size_t line, const char* begin, const char* end)> LineFunction;
+
+	/*
+	Parses all the remaining lines of the file.
+	Returns the number of lines parsed; with STOP these are the lines before the first invalid one,
+	and the lines of its window after it have been passed to grow(), but must be discarded.
+	With SKIP_LINE the invalid lines are listed in invalidLines.
+	*/
+	size_t parseLines(const GrowFunction& grow, const LineFunction& parse, OnError onError,
+		std::vector<size_t>& invalidLines, vcg::CallBackPos* cb = nullptr);
+
+	/*
+	Appends a vertex to the mesh for each valid line of the file.
+	parseVertex(begin, end, v) fills the vertex v from a line and returns false if the line is invalid;
+	it is called in parallel on different vertices.
+	Returns the number of vertices added.
+	*/
+	template <class MeshType, class VertexParser>
+	size_t appendVertices(MeshType& m, VertexParser parseVertex, OnError onError, vcg::CallBackPos* cb = nullptr);
+
+	// the number in [begin, end), blanks around it are allowed. On failure v is 0.
+	static bool toDouble(const char* begin, const char* end, double& v);
+
+	static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+private:
+	// bytes per thread of a window
+	static const qint64 WINDOW_SIZE = 32 << 20;
+
+	QFile file;
+	qint64 offset;
+};
+
+template <class MeshType, class VertexParser>
+size_t AsciiChunkReader::appendVertices(MeshType& m, VertexParser parseVertex, OnError onError, vcg::CallBackPos* cb)
+{
+	typedef typename MeshType::VertexType VertexType;
+	const size_t base = m.vert.size();
+	std::vector<size_t> invalidLines;
+	const size_t parsed = parseLines(
+		[&m](size_t lines, size_t estimatedTotal)
+		{
+			//a single allocation, unless the estimate made on the first window is too low
+			if (m.vert.empty())
+				m.vert.reserve(std::max(lines, estimatedTotal + estimatedTotal / 64));
+			vcg::tri::Allocator<MeshType>::AddVertices(m, lines);
+		},
+		[&m, base, &parseVertex](size_t line, const char* begin, const char* end)
+		{
+			VertexType& v = m.vert[base + line];
+			return parseVertex(begin, end, v);
+		},
+		onError, invalidLines, cb);
+
+	for (size_t i : invalidLines)
+		vcg::tri::Allocator<MeshType>::DeleteVertex(m, m.vert[base + i]);
+	for (size_t i = base + parsed; i < m.vert.size(); ++i)
+		vcg::tri::Allocator<MeshType>::DeleteVertex(m, m.vert[i]);
+	if (size_t(m.vn) != m.vert.size())
+		vcg::tri::Allocator<MeshType>::CompactVertexVector(m);
+	return parsed - invalidLines.size();
+}
+
+#endif // MESHLAB_ASCII_CHUNK_READER_H
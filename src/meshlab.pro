@@ -247,7 +247,7 @@ filter_mls.depends = common
 filter_mutualglobal.depends = common
 filter_mutualinfo.depends = common
 filter_plymc.depends = common
-filter_qhull.depends = common external
+filter_qhull.depends = common
 filter_quality.depends = common
 filter_sampling.depends = common
 filter_screened_poisson.depends = common
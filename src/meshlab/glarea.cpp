@@ -1120,6 +1120,8 @@ void GLArea::setCurrentEditAction(QAction *editAction)
 	}
 	if (mw() != NULL)
 		mw()->updateLayerDialog();
+	//the edit tools modify the meshes inside the mouse/keyboard events, the lod streaming threads are kept away from them until endEdit
+	parentmultiview->sharedDataContext()->suspendLodStreaming(true);
     if (!iEdit->StartEdit(*this->md(), this,parentmultiview->sharedDataContext()))
     {
         //iEdit->EndEdit(*(this->md()->mm()), this);
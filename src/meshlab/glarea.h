@@ -236,6 +236,10 @@ public slots:
 
 			if (mm() != NULL)
 				iEdit->EndEdit(*mm(), this, parentmultiview->sharedDataContext());
+
+			//the edit tool does not modify the meshes anymore, the lod streaming can read them again
+			if ((parentmultiview != NULL) && (parentmultiview->sharedDataContext() != NULL))
+				parentmultiview->sharedDataContext()->suspendLodStreaming(false);
         }
 		
 		//MLSceneGLSharedDataContext* shared;
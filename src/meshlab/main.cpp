@@ -87,7 +87,7 @@ int main(int argc, char *argv[])
 		std::vector<QString> cameraViews;
 		for (int i = 1; i < argc; ++i) {
 			QString arg = QString::fromLocal8Bit(argv[i]);
-			if(arg.endsWith("mlp",Qt::CaseInsensitive) || arg.endsWith("mlb",Qt::CaseInsensitive) || arg.endsWith("aln",Qt::CaseInsensitive) || arg.endsWith("out",Qt::CaseInsensitive) || arg.endsWith("nvm",Qt::CaseInsensitive))
+			if(arg.endsWith("mlp",Qt::CaseInsensitive) || arg.endsWith("mlb",Qt::CaseInsensitive) || arg.endsWith("mlz",Qt::CaseInsensitive) || arg.endsWith("aln",Qt::CaseInsensitive) || arg.endsWith("out",Qt::CaseInsensitive) || arg.endsWith("nvm",Qt::CaseInsensitive))
 				window->openProject(arg);
 			else if(arg.endsWith("xml",Qt::CaseInsensitive))
 				cameraViews.push_back(arg);
@@ -85,6 +85,12 @@ public:
 	size_t minpolygonpersmoothrendering;
 	inline static QString minPolygonNumberPerSmoothRendering() { return "MeshLab::System::minPolygonNumberPerSmoothRendering"; }
 
+	bool lodstreaming;
+	inline static QString lodStreamingRendering() { return "MeshLab::System::lodStreamingRendering"; }
+
+	size_t lodstreamingminprimitives;
+	inline static QString lodStreamingMinPrimitives() { return "MeshLab::System::lodStreamingMinPrimitives"; }
+
 	std::ptrdiff_t maxTextureMemory;
 	inline static QString maxTextureMemoryParam()  {return "MeshLab::System::maxTextureMemory";}
 };
@@ -155,6 +161,7 @@ public:
 	void computeRenderingDataOnLoading(MeshModel* mm,bool isareload, MLRenderingData* rendOpt = NULL);
 
 	bool loadMeshWithStandardParams(QString& fullPath, MeshModel* mm, const Matrix44m &mtr = Matrix44m::Identity(),bool isareload = false, MLRenderingData* rendOpt = NULL);
+	bool loadDocumentPack(const QString& fileName);
 
 	void defaultPerViewRenderingData(MLRenderingData& dt) const;
 	void getRenderingData(int mid,MLRenderingData& dt) const;
@@ -1189,6 +1189,8 @@ void MainWindowSetting::initGlobalParameterList(RichParameterList* gbllist)
 	gbllist->addParam(RichInt(maximumDedicatedGPUMem(), 350, "Maximum GPU Memory Dedicated to MeshLab (Mb)", "Maximum GPU Memory Dedicated to MeshLab (megabyte) for the storing of the geometry attributes. The dedicated memory must NOT be all the GPU memory presents on the videocard."));
 	gbllist->addParam(RichInt(perBatchPrimitives(), 100000, "Per batch primitives loaded in GPU", "Per batch primitives (vertices and faces) loaded in the GPU memory. It's used in order to do not overwhelm the system memory with an entire temporary copy of a mesh."));
 	gbllist->addParam(RichInt(minPolygonNumberPerSmoothRendering(), 50000, "Default Face number per smooth rendering", "Minimum number of faces in order to automatically render a newly created mesh layer with the per vertex normal attribute activated."));
+	gbllist->addParam(RichBool(lodStreamingRendering(), false, "Level of Detail Streaming Rendering", "If true the meshes bigger than the LOD streaming threshold are rendered out-of-core: a hierarchy of simplified chunks is built in background and only the chunks needed by the current point of view are loaded in the GPU memory."));
+	gbllist->addParam(RichInt(lodStreamingMinPrimitives(), 20000000, "Min primitives per LOD streaming rendering", "Minimum number of faces (vertices for point clouds) of a mesh in order to render it through the level of detail streaming renderer, when it is enabled."));
 
 //	glbset->addParam(RichBool(perMeshRenderingToolBar(), true, "Show Per-Mesh Rendering Side ToolBar", "If true the per-mesh rendering side toolbar will be redendered inside the layerdialog."));
 
@@ -1202,6 +1204,8 @@ void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
 	maxgpumem = (std::ptrdiff_t)rpl.getInt(maximumDedicatedGPUMem()) * (float)(1024 * 1024);
 	perbatchprimitives = (size_t)rpl.getInt(perBatchPrimitives());
 	minpolygonpersmoothrendering = (size_t)rpl.getInt(minPolygonNumberPerSmoothRendering());
+	lodstreaming = rpl.getBool(lodStreamingRendering());
+	lodstreamingminprimitives = (size_t)std::max(rpl.getInt(lodStreamingMinPrimitives()), 1);
 	highprecision = false;
 	if (MeshLabScalarTest<Scalarm>::doublePrecision())
 		highprecision = rpl.getBool(highPrecisionRendering());
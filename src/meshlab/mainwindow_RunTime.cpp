@@ -41,10 +41,12 @@
 #include <QMimeData>
 
 #include "../common/meshlabdocumentxml.h"
+#include "../common/meshlabdocumentpack.h"
 #include "../common/meshlabdocumentbundler.h"
 #include "../common/mlapplication.h"
 #include "../common/filterscript.h"
 #include "../common/mlexception.h"
+#include <common/ml_document/knn_graph.h>
 
 #include "rich_parameter_gui/richparameterlistdialog.h"
 
@@ -135,6 +137,21 @@ void MainWindow::updateStdDialog()
 void MainWindow::updateCustomSettings()
 {
 	mwsettings.updateGlobalParameterList(currentGlobalParams);
+	//the lod streaming threshold is applied also to the documents already open
+	foreach(QMdiSubWindow* w, mdiarea->subWindowList())
+	{
+		MultiViewer_Container* mvc = qobject_cast<MultiViewer_Container*>(w->widget());
+		if ((mvc == NULL) || (mvc->sharedDataContext() == NULL))
+			continue;
+		MLSceneGLSharedDataContext* shared = mvc->sharedDataContext();
+		shared->setLodStreamingMinPrimitives(mwsettings.lodstreaming ? mwsettings.lodstreamingminprimitives : 0);
+		foreach(MeshModel* mm, mvc->meshDoc.meshList)
+		{
+			if (mm != NULL)
+				shared->manageBuffers(mm->id());
+		}
+		mvc->updateAllViewers();
+	}
 	emit dispatchCustomSettings(currentGlobalParams);
 }
 
@@ -721,7 +738,7 @@ void MainWindow::dropEvent ( QDropEvent * event )
 				this->newProject();
 			}
 			
-			if(path.endsWith("mlp",Qt::CaseInsensitive) || path.endsWith("mlb", Qt::CaseInsensitive) || path.endsWith("aln",Qt::CaseInsensitive) || path.endsWith("out",Qt::CaseInsensitive) || path.endsWith("nvm",Qt::CaseInsensitive) )
+			if(path.endsWith("mlp",Qt::CaseInsensitive) || path.endsWith("mlb", Qt::CaseInsensitive) || path.endsWith("mlz", Qt::CaseInsensitive) || path.endsWith("aln",Qt::CaseInsensitive) || path.endsWith("out",Qt::CaseInsensitive) || path.endsWith("nvm",Qt::CaseInsensitive) )
 				openProject(path);
 			else
 			{
@@ -786,6 +803,7 @@ void MainWindow::runFilterScript()
 		int req=iFilter->getRequirements(action);
 		if (meshDoc()->mm() != NULL)
 			meshDoc()->mm()->updateDataMask(req);
+		iFilter->decodePendingAttributes(action, *meshDoc());
 		iFilter->setLog(&meshDoc()->Log);
 		RichParameterList &parameterSet = pair.second;
 		
@@ -807,6 +825,7 @@ void MainWindow::runFilterScript()
 		
 		bool created = false;
 		MLSceneGLSharedDataContext* shar = NULL;
+		iFilter->glContext = NULL;
 		if (currentViewContainer() != NULL)
 		{
 			shar = currentViewContainer()->sharedDataContext();
@@ -846,7 +865,8 @@ void MainWindow::runFilterScript()
 			}
 			
 		}
-		if ((!created) || (!iFilter->glContext->isValid()))
+		//the filters that do not require a context check it by themselves
+		if (iFilter->requiresGLContext(action) && ((!created) || (!iFilter->glContext->isValid())))
 			throw MLException("A valid GLContext is required by the filter to work.\n");
 		meshDoc()->setBusy(true);
 		//WARNING!!!!!!!!!!!!
@@ -861,6 +881,7 @@ void MainWindow::runFilterScript()
 		if (shar != NULL)
 			shar->removeView(iFilter->glContext);
 		delete iFilter->glContext;
+		iFilter->glContext = NULL;
 		classes = int(iFilter->getClass(action));
 		
 		if (meshDoc()->mm() != NULL)
@@ -1030,6 +1051,11 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 						//this operation has been introduced in order to minimize problems with filters that didn't declared properly the postCondition mask
 						updatemask = (existit->_mask ^ mm->dataMask()) | postcondmask;
 						connectivitychanged = false;
+						//the dirty ranges declared by the filter refer to the attributes of its postCondition: a drawn component
+						//enabled or disabled without being declared has changed on the whole mesh
+						const int drawnmask = MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNORMAL | MeshModel::MM_VERTCOLOR;
+						if (((existit->_mask ^ mm->dataMask()) & drawnmask & ~postcondmask) != 0)
+							mm->clearDirtyRanges();
 					}
 					
 					MLRenderingData::RendAtts dttoupdate;
@@ -1104,6 +1130,7 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 				{
 					//A new mesh has been created by the filter. I have to add it in the shared context data structure
 					newmeshcreated = true;
+					mm->clearDirtyRanges();
 					MLPoliciesStandAloneFunctions::suggestedDefaultPerViewRenderingData(mm,dttoberendered,mwsettings.minpolygonpersmoothrendering);
 					if (mm == meshDoc()->mm())
 					{
@@ -1149,6 +1176,7 @@ void MainWindow::executeFilter(const QAction* action, RichParameterList &params,
 	int req=iFilter->getRequirements(action);
 	if (!meshDoc()->meshList.isEmpty())
 		meshDoc()->mm()->updateDataMask(req);
+	iFilter->decodePendingAttributes(action, *meshDoc());
 	qApp->restoreOverrideCursor();
 	
 	// (3) save the current filter and its parameters in the history
@@ -1169,6 +1197,8 @@ void MainWindow::executeFilter(const QAction* action, RichParameterList &params,
 	if (currentViewContainer() != NULL)
 	{
 		shar = currentViewContainer()->sharedDataContext();
+		//the lod streaming threads must not read the meshes while the filter is modifying them
+		shar->suspendLodStreaming(true);
 		//GLA() is only the parent
 		filterWidget = new QGLWidget(NULL,shar);
 		QGLFormat defForm = QGLFormat::defaultFormat();
@@ -1307,6 +1337,10 @@ void MainWindow::executeFilter(const QAction* action, RichParameterList &params,
 				
 				if(iFilter->getClass(action) & FilterPluginInterface::Texture )
 					updateTexture(mm->id());
+				
+				if (postCondMask & (MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNUMBER))
+					mm->pointSetChanged();
+				KnnGraph::releaseStaleCache(mm->cm, mm->pointSetGeneration());
 			}
 		}
 		
@@ -1315,9 +1349,13 @@ void MainWindow::executeFilter(const QAction* action, RichParameterList &params,
 		
 		updateSharedContextDataAfterFilterExecution(postCondMask,fclasses,newmeshcreated);
 		meshDoc()->meshDocStateData().clear();
+		if (shar != NULL)
+			shar->suspendLodStreaming(false);
 	}
 	catch (const std::bad_alloc& bdall)
 	{
+		if (shar != NULL)
+			shar->suspendLodStreaming(false);
 		meshDoc()->setBusy(false);
 		qApp->restoreOverrideCursor();
 		QMessageBox::warning(
@@ -1483,7 +1521,7 @@ void MainWindow::saveProject()
 			}
 		}
 	}
-	QFileDialog* saveDiag = new QFileDialog(this,tr("Save Project File"),lastUsedDirectory.path().append(""), tr("MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;Align Project (*.aln)"));
+	QFileDialog* saveDiag = new QFileDialog(this,tr("Save Project File"),lastUsedDirectory.path().append(""), tr("MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;MeshLab Document Pack (*.mlz);;Align Project (*.aln)"));
 #if defined(Q_OS_WIN)
 	saveDiag->setOption(QFileDialog::DontUseNativeDialog);
 #endif
@@ -1565,7 +1603,14 @@ void MainWindow::saveProject()
 			getRenderingData(mp->id(), ml);
 			rendOpt.insert(std::pair<int, MLRenderingData>(mp->id(), ml));
 		}
-		ret = MeshDocumentToXMLFile(*meshDoc(), fileName, onlyVisibleLayers->isChecked(), saveViewState->isChecked(), QString(fi.suffix()).toLower() == "mlb", rendOpt);
+		if (QString(fi.suffix()).toLower() == "mlz")
+		{
+			qb->show();
+			ret = MeshDocumentToPackFile(*meshDoc(), fileName, onlyVisibleLayers->isChecked(), saveViewState->isChecked(), rendOpt, QCallBack);
+			qb->reset();
+		}
+		else
+			ret = MeshDocumentToXMLFile(*meshDoc(), fileName, onlyVisibleLayers->isChecked(), saveViewState->isChecked(), QString(fi.suffix()).toLower() == "mlb", rendOpt);
 	}
 	
 	if (saveAllFile->isChecked())
@@ -1589,13 +1634,13 @@ bool MainWindow::openProject(QString fileName)
 	//showLayerDlg(false);
 	globrendtoolbar->setEnabled(false);
 	if (fileName.isEmpty())
-		fileName = QFileDialog::getOpenFileName(this,tr("Open Project File"), lastUsedDirectory.path(), tr("All Project Files (*.mlp *.mlb *.aln *.out *.nvm);;MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;Align Project (*.aln);;Bundler Output (*.out);;VisualSFM Output (*.nvm)"));
+		fileName = QFileDialog::getOpenFileName(this,tr("Open Project File"), lastUsedDirectory.path(), tr("All Project Files (*.mlp *.mlb *.mlz *.aln *.out *.nvm);;MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;MeshLab Document Pack (*.mlz);;Align Project (*.aln);;Bundler Output (*.out);;VisualSFM Output (*.nvm)"));
 	
 	if (fileName.isEmpty()) return false;
 	
 	QFileInfo fi(fileName);
 	lastUsedDirectory = fi.absoluteDir();
-	if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp")  && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower()!="out") && (fi.suffix().toLower()!="nvm"))
+	if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp")  && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower() != "mlz") && (fi.suffix().toLower()!="out") && (fi.suffix().toLower()!="nvm"))
 	{
 		QMessageBox::critical(this, tr("Meshlab Opening Error"), "Unknown project file extension");
 		return false;
@@ -1661,6 +1706,15 @@ bool MainWindow::openProject(QString fileName)
 		}
 	}
 	
+	if (QString(fi.suffix()).toLower() == "mlz")
+	{
+		if (!loadDocumentPack(fileName))
+		{
+			QMessageBox::critical(this, tr("Meshlab Opening Error"), "Unable to open MeshLab Document Pack file");
+			return false;
+		}
+	}
+	
 	////// BUNDLER
 	if (QString(fi.suffix()).toLower() == "out"){
 		
@@ -1728,7 +1782,7 @@ bool MainWindow::appendProject(QString fileName)
 	QStringList fileNameList;
 	globrendtoolbar->setEnabled(false);
 	if (fileName.isEmpty())
-		fileNameList = QFileDialog::getOpenFileNames(this, tr("Append Project File"), lastUsedDirectory.path(), "All Project Files (*.mlp *.mlb *.aln *.out *.nvm);;MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;Align Project (*.aln);;Bundler Output (*.out);;VisualSFM Output (*.nvm)");
+		fileNameList = QFileDialog::getOpenFileNames(this, tr("Append Project File"), lastUsedDirectory.path(), "All Project Files (*.mlp *.mlb *.mlz *.aln *.out *.nvm);;MeshLab Project (*.mlp);;MeshLab Binary Project (*.mlb);;MeshLab Document Pack (*.mlz);;Align Project (*.aln);;Bundler Output (*.out);;VisualSFM Output (*.nvm)");
 	else
 		fileNameList.append(fileName);
 	
@@ -1750,7 +1804,7 @@ bool MainWindow::appendProject(QString fileName)
 		QFileInfo fi(fileName);
 		lastUsedDirectory = fi.absoluteDir();
 		
-		if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp") && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower() != "out") && (fi.suffix().toLower() != "nvm"))
+		if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp") && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower() != "mlz") && (fi.suffix().toLower() != "out") && (fi.suffix().toLower() != "nvm"))
 		{
 			QMessageBox::critical(this, tr("Meshlab Opening Error"), "Unknown project file extension");
 			return false;
@@ -1802,6 +1856,15 @@ bool MainWindow::appendProject(QString fileName)
 			}
 		}
 		
+		if (QString(fi.suffix()).toLower() == "mlz")
+		{
+			if (!loadDocumentPack(fileName))
+			{
+				QMessageBox::critical(this, tr("Meshlab Opening Error"), "Unable to open MeshLab Document Pack file");
+				return false;
+			}
+		}
+		
 		if (QString(fi.suffix()).toLower() == "out") {
 			
 			QString cameras_filename = fileName;
@@ -1873,6 +1936,7 @@ void MainWindow::newProject(const QString& projName)
 	if (gpumeminfo == NULL)
 		return;
 	MultiViewer_Container *mvcont = new MultiViewer_Container(*gpumeminfo,mwsettings.highprecision,mwsettings.perbatchprimitives,mwsettings.minpolygonpersmoothrendering,mdiarea);
+	mvcont->sharedDataContext()->setLodStreamingMinPrimitives(mwsettings.lodstreaming ? mwsettings.lodstreamingminprimitives : 0);
 	connect(&mvcont->meshDoc,SIGNAL(meshAdded(int)),this,SLOT(meshAdded(int)));
 	connect(&mvcont->meshDoc,SIGNAL(meshRemoved(int)),this,SLOT(meshRemoved(int)));
 	connect(&mvcont->meshDoc, SIGNAL(documentUpdated()), this, SLOT(documentUpdateRequested()));
@@ -1903,6 +1967,7 @@ void MainWindow::newProject(const QString& projName)
 	updateLayerDialog();
 	mvcont->showMaximized();
 	connect(mvcont->sharedDataContext(),SIGNAL(currentAllocatedGPUMem(int,int,int,int)),this,SLOT(updateGPUMemBar(int,int,int,int)));
+	connect(mvcont->sharedDataContext(),&MLSceneGLSharedDataContext::lodStreamingDataAvailable,mvcont,&MultiViewer_Container::updateAllViewers);
 }
 
 void MainWindow::documentUpdateRequested()
@@ -2083,10 +2148,20 @@ bool MainWindow::loadMesh(const QString& fileName, IOMeshPluginInterface *pCurre
 	meshDoc()->setBusy(true);
 	pCurrentIOPlugin->setLog(&meshDoc()->Log);
 	
+	//on reload the mesh could be already rendered by a lod streaming thread
+	MLSceneGLSharedDataContext* shar = NULL;
+	if (currentViewContainer() != NULL)
+	{
+		shar = currentViewContainer()->sharedDataContext();
+		shar->suspendLodStreaming(true);
+	}
+	
 	if (!pCurrentIOPlugin->open(extension, fileNameSansDir, *mm ,mask,*prePar,QCallBack,this /*gla*/))
 	{
 		QMessageBox::warning(this, tr("Opening Failure"), QString("While opening: '%1'\n\n").arg(fileName)+pCurrentIOPlugin->errorMsg()); // text+
 		pCurrentIOPlugin->clearErrorString();
+		if (shar != NULL)
+			shar->suspendLodStreaming(false);
 		meshDoc()->setBusy(false);
 		QDir::setCurrent(origDir); // undo the change of directory before leaving
 		return false;
@@ -2154,6 +2229,8 @@ bool MainWindow::loadMesh(const QString& fileName, IOMeshPluginInterface *pCurre
 	mm->cm.Tr = mtr;
 	
 	computeRenderingDataOnLoading(mm,isareload, rendOpt);
+	if (shar != NULL)
+		shar->suspendLodStreaming(false);
 	updateLayerDialog();
 	
 	
@@ -2164,6 +2241,30 @@ bool MainWindow::loadMesh(const QString& fileName, IOMeshPluginInterface *pCurre
 	return true;
 }
 
+// the meshes of a pack are loaded together with the document, their textures and rendering data are set up here
+bool MainWindow::loadDocumentPack(const QString& fileName)
+{
+	const int alreadyLoadedNum = meshDoc()->meshList.size();
+	std::map<int, MLRenderingData> rendOpt;
+	// the components that are not displayed are decoded only when a filter needs them
+	const int lazyMask = MeshModel::MM_VERTQUALITY | MeshModel::MM_FACEQUALITY | MeshModel::MM_VERTRADIUS;
+	if (!MeshDocumentFromPackFile(*meshDoc(), fileName, rendOpt, lazyMask, QCallBack))
+		return false;
+	GLA()->updateMeshSetVisibilities();
+	for (int i = alreadyLoadedNum; i < meshDoc()->meshList.size(); i++)
+	{
+		MeshModel* mm = meshDoc()->meshList[i];
+		if (!(mm->cm.textures.empty()))
+			updateTexture(mm->id());
+		MLRenderingData* ptr = NULL;
+		if (rendOpt.find(mm->id()) != rendOpt.end())
+			ptr = &rendOpt[mm->id()];
+		computeRenderingDataOnLoading(mm, false, ptr);
+	}
+	updateLayerDialog();
+	return true;
+}
+
 void MainWindow::computeRenderingDataOnLoading(MeshModel* mm,bool isareload, MLRenderingData* rendOpt)
 {
 	MultiViewer_Container* mv = currentViewContainer();
@@ -2436,6 +2537,8 @@ bool MainWindow::exportMesh(QString fileName,MeshModel* mod,const bool saveAllPo
 		defaultExt = "*.ply";
 	if (mod == NULL)
 		return false;
+	// all the components of the mesh must be available to the exporter
+	mod->updateDataMask(mod->pendingDataMask());
 	mod->setMeshModified(false);
 	QString laylabel = "Save \"" + mod->label() + "\" Layer";
 	QString ss = fi.absoluteFilePath();
@@ -426,6 +426,7 @@ void EditPaintPlugin::Decorate(MeshModel &m, GLArea * gla)
 					if (color_buffer != NULL)
 					{
 						paint(&vertices);
+						markTouchedElementsDirty(m);
 						updateColorBuffer(m, shared);
 					}
 				}
@@ -435,6 +436,7 @@ void EditPaintPlugin::Decorate(MeshModel &m, GLArea * gla)
 				case COLOR_NOISE:
 				{
 					paint(&vertices);
+					markTouchedElementsDirty(m);
 					updateColorBuffer(m, shared);
 				}
 				break;
@@ -461,6 +463,7 @@ void EditPaintPlugin::Decorate(MeshModel &m, GLArea * gla)
 				case MESH_PULL:
 				{
 					sculpt(m, &vertices);
+					markTouchedElementsDirty(m);
 					updateGeometryBuffers(m, shared);
 				}
 				break;
@@ -468,12 +471,14 @@ void EditPaintPlugin::Decorate(MeshModel &m, GLArea * gla)
 				case COLOR_SMOOTH:
 				{
 					smooth(&vertices);
+					markTouchedElementsDirty(m);
 					updateColorBuffer(m, shared);
 				}
 				break;
 				case MESH_SMOOTH:
 				{
 					smooth(&vertices);
+					markTouchedElementsDirty(m);
 					updateGeometryBuffers(m, shared);
 				}
 				break;
@@ -1188,6 +1193,25 @@ void EditPaintPlugin::updateColorBuffer(MeshModel& m, MLSceneGLSharedDataContext
 	}
 }
 
+/**
+ * Declares to the mesh the portion touched by the last brush movement (the vertices under the brush and the
+ * faces around them, whose normals could have been changed) so that only that portion of the buffers is refreshed
+ */
+void EditPaintPlugin::markTouchedElementsDirty(MeshModel& m)
+{
+	for (size_t ii = 0; ii < vertices.size(); ++ii)
+		m.markVertDirty(vertices[ii].first);
+	if (selection != NULL)
+	{
+		for (size_t ii = 0; ii < selection->size(); ++ii)
+		{
+			m.markFaceDirty((*selection)[ii]);
+			for (int jj = 0; jj < 3; ++jj)
+				m.markVertDirty((*selection)[ii]->V(jj));
+		}
+	}
+}
+
 void EditPaintPlugin::updateGeometryBuffers(MeshModel & m, MLSceneGLSharedDataContext* shared)
 {
 	if (shared != NULL)
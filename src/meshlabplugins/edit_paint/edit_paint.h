@@ -84,6 +84,7 @@ private:
 	void updateSelection(MeshModel &m, std::vector< std::pair<CVertexO *, PickingData> > * vertex_result = NULL);
 	void updateColorBuffer(MeshModel& m,MLSceneGLSharedDataContext* shared);
 	void updateGeometryBuffers(MeshModel& m,MLSceneGLSharedDataContext* shared);
+	void markTouchedElementsDirty(MeshModel& m);
 
 	double modelview_matrix[16]; //modelview
 	double projection_matrix[16]; //projection
@@ -4,7 +4,7 @@
 #include <QTime>
 #include <vector>
 #include <vcg/complex/complex.h>
-#include <vcg/space/index/kdtree/kdtree.h>
+#include <common/ml_document/knn_graph.h>
 
 namespace vcg {
 namespace tri {
@@ -21,50 +21,22 @@ typedef typename _MyMeshType::VertexType _MyVertexType;
  */
 static void MakeKNNTree(_MyMeshType& m, int numOfNeighbours)
 {
-    //we search k+1 neighbours in order to exclude the queryPoint from the returned heap
-    int neighboursVectSize = numOfNeighbours + 1;
-
-    int neighbours; //number of neighbours found (no more than neighboursVectSize)
-
     //we have to use the indices of the vertices, and they MUST be continuous
     tri::Allocator<_MyMeshType>::CompactVertexVector(m);
 
-    //the PerVertexAttribute handles is create and each of the vector capacity set to the maximum possible
+    //the neighbours come from the kNN graph cached on the mesh, shared with the filters
+    //working on point clouds and built (in parallel) only when missing or stale
+    const ::KnnGraph& graph = ::KnnGraph::get(m, numOfNeighbours);
+
     typename _MyMeshType::template PerVertexAttributeHandle<std::vector<_MyVertexType*>* > kNeighboursVect;
     kNeighboursVect = tri::Allocator<_MyMeshType>::template AddPerVertexAttribute<std::vector<_MyVertexType*>* >(m, std::string("KNNGraph"));
-    for (typename _MyMeshType::VertexIterator vi = m.vert.begin(); vi != m.vert.end(); vi++) {
-        kNeighboursVect[vi] = new std::vector<_MyVertexType*>();
-        kNeighboursVect[vi]->reserve(neighboursVectSize);
-    }
-
-    //we create and fill the DataWrapper we need to pass the points to the KdTree
-    std::vector<typename _MyMeshType::CoordType> input(m.vn);
-    int i = 0;
-    for (typename _MyMeshType::VertexIterator vi = m.vert.begin(); vi != m.vert.end(); vi++, ++i) {
-        input[i] = vi->cP();
-    }
-    ConstDataWrapper<typename _MyMeshType::CoordType> DW(&(input[0]), input.size());
-
-    KdTree<Scalarm> tree(DW);
-
-    //tree.setMaxNofNeighbors(neighboursVectSize);
-
-    //For each vertex we insert the k-nearest neighbours in the associated vector.
-    //If the number of the found vertices is less than the required we exclude the point with
-    //the highest value (inserted by the doQueryK function of the vcg library). Moreover
-    //we have to exclude the queryPoint!
-
-    int neightId = -1;
-    for (int j = 0; j < m.vn; j++) {
-        vcg::KdTree<Scalarm>::PriorityQueue p;
-        tree.doQueryK(m.vert[j].cP(),neighboursVectSize,p);
-
-        neighbours = p.getNofElements();
-        for (int i = 0; i < neighbours; ++i) {
-            neightId = p.getIndex(i);
-            if (neightId < m.vn && (neightId != j))
-                kNeighboursVect[m.vert[j]]->push_back(&(m.vert[neightId]));
-        }
+    for (size_t i = 0; i < m.vert.size(); ++i) {
+        const int* neighbours = graph.neighbours(i);
+        int neighbourNum = graph.neighbourNum(i, numOfNeighbours);
+        kNeighboursVect[i] = new std::vector<_MyVertexType*>();
+        kNeighboursVect[i]->reserve(neighbourNum);
+        for (int j = 0; j < neighbourNum; ++j)
+            kNeighboursVect[i]->push_back(&(m.vert[neighbours[j]]));
     }
 
     return;
@@ -78,6 +50,10 @@ static void DeleteKNNTree(_MyMeshType& m)
     bool hasKNNGraph = tri::HasPerVertexAttribute(m, "KNNGraph");
 
     if (hasKNNGraph) {
+        typename _MyMeshType::template PerVertexAttributeHandle<std::vector<_MyVertexType*>* > kNeighboursVect;
+        kNeighboursVect = tri::Allocator<_MyMeshType>::template GetPerVertexAttribute<std::vector<_MyVertexType*>* >(m, std::string("KNNGraph"));
+        for (size_t i = 0; i < m.vert.size(); ++i)
+            delete kNeighboursVect[i];
         tri::Allocator<_MyMeshType>::DeletePerVertexAttribute(m, "KNNGraph");
     }
 
@@ -72,6 +72,7 @@ public:
     QString filterName(FilterIDType filter) const;
     QString	filterInfo(FilterIDType filterId) const;
     FILTER_ARITY filterArity(const QAction*) const;
+    bool requiresGLContext(const QAction*) const { return true; }
 	int getRequirements (const QAction* action);
     FilterClass getClass(const QAction* filter) const;
 
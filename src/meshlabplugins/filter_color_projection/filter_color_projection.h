@@ -49,6 +49,7 @@ public:
     virtual bool applyFilter(const QAction* filter, MeshDocument &md, std::map<std::string, QVariant>& outputValues, unsigned int& postConditionMask, const RichParameterList & /*parent*/, vcg::CallBackPos * cb);
 
     FILTER_ARITY filterArity(const QAction *) const {return SINGLE_MESH;}
+    bool requiresGLContext(const QAction *) const {return true;}
 
 private:
 
@@ -0,0 +1,249 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "color_kernels.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <vcg/complex/algorithms/update/color.h>
+#include <vcg/math/histogram.h>
+
+using namespace vcg;
+
+namespace {
+
+const int VERTEX_BLOCK_SIZE = 1 << 16;
+
+inline bool toProcess(const CVertexO& v, bool selected)
+{
+	return !v.IsD() && (!selected || v.IsS());
+}
+
+}
+
+ColorKernels::ChannelTable ColorKernels::channelTable(const VertexRoutine& routine)
+{
+	CMeshO ramp;
+	tri::Allocator<CMeshO>::AddVertices(ramp, 256);
+	for (int i = 0; i < 256; ++i)
+		ramp.vert[i].C() = Color4b(i, i, i, i);
+	routine(ramp);
+
+	ChannelTable table;
+	for (int i = 0; i < 256; ++i)
+		for (int ch = 0; ch < 4; ++ch)
+			table[ch][i] = ramp.vert[i].C()[ch];
+	return table;
+}
+
+ColorKernels::ChannelTable ColorKernels::compose(const ChannelTable& first, const ChannelTable& second)
+{
+	ChannelTable table;
+	for (int ch = 0; ch < 4; ++ch)
+		for (int i = 0; i < 256; ++i)
+			table[ch][i] = second[ch][first[ch][i]];
+	return table;
+}
+
+void ColorKernels::applyTable(CMeshO& m, const ChannelTable& table, bool selected)
+{
+	const int vn = int(m.vert.size());
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+	{
+		CVertexO& v = m.vert[i];
+		if (!toProcess(v, selected))
+			continue;
+		Color4b& c = v.C();
+		c = Color4b(table[0][c[0]], table[1][c[1]], table[2][c[2]], table[3][c[3]]);
+	}
+}
+
+void ColorKernels::forVertexBlocks(CMeshO& m, bool selected, const VertexRoutine& routine)
+{
+	const int vn = int(m.vert.size());
+	const int blockNum = (vn + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int b = 0; b < blockNum; ++b)
+	{
+		const int begin = b * VERTEX_BLOCK_SIZE;
+		const int end = std::min(vn, begin + VERTEX_BLOCK_SIZE);
+		std::vector<int> index;
+		index.reserve(end - begin);
+		for (int i = begin; i < end; ++i)
+			if (toProcess(m.vert[i], selected))
+				index.push_back(i);
+		if (index.empty())
+			continue;
+
+		CMeshO block;
+		tri::Allocator<CMeshO>::AddVertices(block, index.size());
+		for (size_t k = 0; k < index.size(); ++k)
+		{
+			const CVertexO& v = m.vert[index[k]];
+			CVertexO& bv = block.vert[k];
+			bv.P() = v.cP();
+			bv.N() = v.cN();
+			bv.C() = v.cC();
+			bv.Q() = v.cQ();
+		}
+		routine(block);
+		for (size_t k = 0; k < index.size(); ++k)
+			m.vert[index[k]].C() = block.vert[k].cC();
+	}
+}
+
+/*
+The same histograms of PerVertexEqualize (255 bins in [0, 255] for each channel and for the
+rounded lightness); as all the values are 8 bit channels (or half sums of two of them) the
+threads count the occurrences of each value, and each value is added to the histograms once,
+with its count.
+*/
+void ColorKernels::equalize(CMeshO& m, unsigned char rgbMask, bool selected)
+{
+	typedef tri::UpdateColor<CMeshO> UpdateColor;
+	const int vn = int(m.vert.size());
+	// counts of red, green, blue and of max + min channel (the lightness, doubled)
+	std::vector<long long> count(3 * 256 + 511, 0);
+#pragma omp parallel
+	{
+		std::vector<long long> local(count.size(), 0);
+#pragma omp for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			const CVertexO& v = m.vert[i];
+			if (!toProcess(v, selected))
+				continue;
+			const Color4b& c = v.cC();
+			++local[c[0]];
+			++local[256 + c[1]];
+			++local[512 + c[2]];
+			++local[768 + std::max(c[0], std::max(c[1], c[2])) + std::min(c[0], std::min(c[1], c[2]))];
+		}
+#pragma omp critical
+		{
+			for (size_t k = 0; k < count.size(); ++k)
+				count[k] += local[k];
+		}
+	}
+
+	Histogramf Hl, Hr, Hg, Hb;
+	Hl.Clear(); Hr.Clear(); Hg.Clear(); Hb.Clear();
+	Hl.SetRange(0, 255, 255); Hr.SetRange(0, 255, 255); Hg.SetRange(0, 255, 255); Hb.SetRange(0, 255, 255);
+	for (int i = 0; i < 256; ++i)
+	{
+		if (count[i] > 0) Hr.Add(float(i), float(count[i]));
+		if (count[256 + i] > 0) Hg.Add(float(i), float(count[256 + i]));
+		if (count[512 + i] > 0) Hb.Add(float(i), float(count[512 + i]));
+	}
+	for (int s = 0; s < 511; ++s)
+		if (count[768 + s] > 0)
+		{
+			// a color with max + min == s, rounded as in PerVertexEqualize
+			const float l = UpdateColor::ComputeLightness(Color4b(s - s / 2, s / 2, s / 2, 255)) + 0.5;
+			Hl.Add(l, float(count[768 + s]));
+		}
+
+	int cdf_l[256], cdf_r[256], cdf_g[256], cdf_b[256];
+	cdf_l[0] = Hl.BinCount(0);
+	cdf_r[0] = Hr.BinCount(0);
+	cdf_g[0] = Hg.BinCount(0);
+	cdf_b[0] = Hb.BinCount(0);
+	for (int i = 1; i < 256; ++i)
+	{
+		cdf_l[i] = Hl.BinCount(float(i)) + cdf_l[i - 1];
+		cdf_r[i] = Hr.BinCount(float(i)) + cdf_r[i - 1];
+		cdf_g[i] = Hg.BinCount(float(i)) + cdf_g[i - 1];
+		cdf_b[i] = Hb.BinCount(float(i)) + cdf_b[i - 1];
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+	{
+		CVertexO& v = m.vert[i];
+		if (toProcess(v, selected))
+			v.C() = UpdateColor::ColorEqualize(v.cC(), cdf_l, cdf_r, cdf_g, cdf_b, rgbMask);
+	}
+}
+
+void ColorKernels::qualityRamp(CMeshO& m, Scalarm minq, Scalarm maxq, bool selected)
+{
+	// PerVertexQualityRamp takes the range of the whole mesh, not the one of a block
+	if (minq == maxq)
+	{
+		std::pair<Scalarm, Scalarm> range = vertexQualityRange(m);
+		minq = range.first;
+		maxq = range.second;
+	}
+	forVertexBlocks(m, selected, [minq, maxq](CMeshO& block) {
+		tri::UpdateColor<CMeshO>::PerVertexQualityRamp(block, minq, maxq);
+	});
+}
+
+std::pair<Scalarm, Scalarm> ColorKernels::vertexQualityRange(const CMeshO& m)
+{
+	const int vn = int(m.vert.size());
+	std::pair<Scalarm, Scalarm> range(std::numeric_limits<Scalarm>::max(), -std::numeric_limits<Scalarm>::max());
+#pragma omp parallel
+	{
+		std::pair<Scalarm, Scalarm> local = range;
+#pragma omp for schedule(static)
+		for (int i = 0; i < vn; ++i)
+			if (!m.vert[i].IsD())
+			{
+				local.first = std::min<Scalarm>(local.first, m.vert[i].cQ());
+				local.second = std::max<Scalarm>(local.second, m.vert[i].cQ());
+			}
+#pragma omp critical
+		{
+			range.first = std::min(range.first, local.first);
+			range.second = std::max(range.second, local.second);
+		}
+	}
+	return range;
+}
+
+std::pair<Scalarm, Scalarm> ColorKernels::faceQualityRange(const CMeshO& m)
+{
+	const int fn = int(m.face.size());
+	std::pair<Scalarm, Scalarm> range(std::numeric_limits<Scalarm>::max(), -std::numeric_limits<Scalarm>::max());
+#pragma omp parallel
+	{
+		std::pair<Scalarm, Scalarm> local = range;
+#pragma omp for schedule(static)
+		for (int i = 0; i < fn; ++i)
+			if (!m.face[i].IsD())
+			{
+				local.first = std::min<Scalarm>(local.first, m.face[i].cQ());
+				local.second = std::max<Scalarm>(local.second, m.face[i].cQ());
+			}
+#pragma omp critical
+		{
+			range.first = std::min(range.first, local.first);
+			range.second = std::max(range.second, local.second);
+		}
+	}
+	return range;
+}
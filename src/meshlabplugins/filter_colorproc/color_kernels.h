@@ -0,0 +1,77 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_COLORPROC_COLOR_KERNELS_H
+#define FILTER_COLORPROC_COLOR_KERNELS_H
+
+#include <array>
+#include <functional>
+#include <utility>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+ColorKernels
+Parallel application of the per vertex color routines of vcg::tri::UpdateColor.
+
+- The routines where each channel of the new color depends only on the same channel of the
+  old one (levels, gamma, brightness and contrast, invert, colourisation, white balance...)
+  are run once on a ramp of the 256 values of a channel, giving a lookup table per channel
+  that is then applied to all the vertices in parallel.
+- The other ones (thresholding, desaturation, perlin coloring, quality ramp) are run in
+  parallel on copies of blocks of vertices.
+- Equalization builds the histograms of the channels and of the lightness in parallel, with
+  exact counts of each value, and then maps the colors in parallel.
+
+In every case the colors are computed by the same code of the serial routines, so the
+results are the same.
+*/
+class ColorKernels
+{
+public:
+	// new value of each channel (r, g, b, a) for each old value
+	typedef std::array<std::array<unsigned char, 256>, 4> ChannelTable;
+	typedef std::function<void(CMeshO&)> VertexRoutine;
+
+	// the table of a channel separable routine (routine is called on all the vertices of a small mesh)
+	static ChannelTable channelTable(const VertexRoutine& routine);
+	// combines two tables: first, then second
+	static ChannelTable compose(const ChannelTable& first, const ChannelTable& second);
+	static void applyTable(CMeshO& m, const ChannelTable& table, bool selected);
+
+	// runs routine on copies of blocks of the vertices to process (position, normal, color
+	// and quality are copied), then copies back the colors
+	static void forVertexBlocks(CMeshO& m, bool selected, const VertexRoutine& routine);
+
+	// tri::UpdateColor<CMeshO>::PerVertexEqualize
+	static void equalize(CMeshO& m, unsigned char rgbMask, bool selected);
+
+	// tri::UpdateColor<CMeshO>::PerVertexQualityRamp
+	static void qualityRamp(CMeshO& m, Scalarm minq, Scalarm maxq, bool selected = false);
+
+	// tri::Stat<CMeshO>::ComputePerVertexQualityMinMax / ComputePerFaceQualityMinMax
+	static std::pair<Scalarm, Scalarm> vertexQualityRange(const CMeshO& m);
+	static std::pair<Scalarm, Scalarm> faceQualityRange(const CMeshO& m);
+};
+
+#endif // FILTER_COLORPROC_COLOR_KERNELS_H
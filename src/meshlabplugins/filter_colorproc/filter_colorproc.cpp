@@ -23,6 +23,8 @@
 
 #include <vcg/space/colorspace.h>
 #include "filter_colorproc.h"
+#include "color_kernels.h"
+#include "../filter_unsharp/vertex_smoother.h"
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/stat.h>
@@ -374,6 +376,10 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 {
 	MeshModel *m = md.mm();  //get current mesh from document
 
+	//the filters applied only to the selection declare the touched vertices, so that just that portion of a big mesh is refreshed
+	if (par.hasParameter("onSelected") && par.getBool("onSelected"))
+		m->markSelectedVertDirty();
+
 	switch(ID(filter))
 	{
 		case CP_FILLING:
@@ -383,7 +389,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexConstant(m->cm, new_col, selected);
+			ColorKernels::applyTable(m->cm, ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexConstant(ramp, new_col);
+			}), selected);
 			return true;
 		}
 
@@ -396,7 +404,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			Color4b c2 = Color4b(temp.red(), temp.green(), temp.blue(), temp.alpha());
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexThresholding(m->cm, threshold, c1, c2, selected);
+			ColorKernels::forVertexBlocks(m->cm, selected, [&](CMeshO& block) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexThresholding(block, threshold, c1, c2);
+			});
 			return true;
 		}
 
@@ -407,8 +417,13 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			float gamma = math::Clamp(par.getDynamicFloat("gamma"), 0.1f, 5.0f);
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexGamma(m->cm, gamma, selected);
-			vcg::tri::UpdateColor<CMeshO>::PerVertexBrightnessContrast(m->cm, brightness/256.0f,contrast/256.0f , selected);
+			ColorKernels::ChannelTable gammaTable = ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexGamma(ramp, gamma);
+			});
+			ColorKernels::ChannelTable bcTable = ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexBrightnessContrast(ramp, brightness/256.0f, contrast/256.0f);
+			});
+			ColorKernels::applyTable(m->cm, ColorKernels::compose(gammaTable, bcTable), selected);
 			return true;
 		}
 
@@ -416,7 +431,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 		{
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexInvert(m->cm, selected);
+			ColorKernels::applyTable(m->cm, ColorKernels::channelTable([](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexInvert(ramp);
+			}), selected);
 			return true;
 		}
 
@@ -438,15 +455,18 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			//if no channels are checked, we intend to work on all rgb channels, so...
 			if(rgbMask == vcg::tri::UpdateColor<CMeshO>::NO_CHANNELS) rgbMask = vcg::tri::UpdateColor<CMeshO>::ALL_CHANNELS;
 
+			ColorKernels::ChannelTable levels = ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(ramp, gamma, in_min, in_max, out_min, out_max, rgbMask);
+			});
 			if (all_levels)
 			{
 			foreach(MeshModel *mm, md.meshList)
 				if (mm->isVisible())
-				vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(mm->cm, gamma, in_min, in_max, out_min, out_max, rgbMask, selected);
+				ColorKernels::applyTable(mm->cm, levels, selected);
 			}
 			else
 			{
-			vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(m->cm, gamma, in_min, in_max, out_min, out_max, rgbMask, selected);
+			ColorKernels::applyTable(m->cm, levels, selected);
 			}
 			return true;
 		}
@@ -464,7 +484,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			ColorSpace<unsigned char>::HSLtoRGB( (double)hue, (double)saturation, (double)luminance, r, g, b);
 			Color4b color = Color4b((int)(r*255), (int)(g*255), (int)(b*255), 255);
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexColourisation(m->cm, color, intensity, selected);
+			ColorKernels::applyTable(m->cm, ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexColourisation(ramp, color, intensity);
+			}), selected);
 			return true;
 		}
 
@@ -473,7 +495,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			int method = par.getEnum("method");
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexDesaturation(m->cm, method, selected);
+			ColorKernels::forVertexBlocks(m->cm, selected, [method](CMeshO& block) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexDesaturation(block, method);
+			});
 			return true;
 		}
 
@@ -486,7 +510,7 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			if(par.getBool("bCh")) rgbMask = rgbMask | vcg::tri::UpdateColor<CMeshO>::BLUE_CHANNEL;
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexEqualize(m->cm, rgbMask, selected);
+			ColorKernels::equalize(m->cm, rgbMask, selected);
 			return true;
 		}
 
@@ -496,7 +520,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			Color4b color = Color4b(tempColor.red(),tempColor.green(),tempColor.blue(), 255);
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexWhiteBalance(m->cm, color, selected);
+			ColorKernels::applyTable(m->cm, ColorKernels::channelTable([&](CMeshO& ramp) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexWhiteBalance(ramp, color);
+			}), selected);
 			return true;
 		}
 
@@ -528,7 +554,9 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			Point3m offset = par.getPoint3m("offset");
 			bool selected = par.getBool("onSelected");
 
-			tri::UpdateColor<CMeshO>::PerVertexPerlinColoring(m->cm, period, offset, c1, c2, selected);
+			ColorKernels::forVertexBlocks(m->cm, selected, [&](CMeshO& block) {
+				tri::UpdateColor<CMeshO>::PerVertexPerlinColoring(block, period, offset, c1, c2);
+			});
 			return true;
 		}
 
@@ -550,7 +578,7 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 				Histogramm H;
 				tri::Stat<CMeshO>::ComputePerVertexQualityHistogram(m->cm, H);
 				m->updateDataMask(MeshModel::MM_VERTCOLOR);
-				tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, H.Percentile(0.1f), H.Percentile(0.9f));
+				ColorKernels::qualityRamp(m->cm, H.Percentile(0.1f), H.Percentile(0.9f));
 			}
 			log("Saturated Vertex Quality");
 			return true;
@@ -564,11 +592,19 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			float RangeMax = par.getFloat("maxVal");
 			bool usePerc = par.getDynamicFloat("perc")>0;
 
+			// the histogram is needed only for the percentiles
 			Histogramm H;
-			tri::Stat<CMeshO>::ComputePerVertexQualityHistogram(m->cm, H);
-
-			float PercLo = H.Percentile(par.getDynamicFloat("perc") / 100.f);
-			float PercHi = H.Percentile(1.0 - par.getDynamicFloat("perc") / 100.f);
+			std::pair<Scalarm, Scalarm> range;
+			float PercLo = 0, PercHi = 0;
+			if (usePerc)
+			{
+				tri::Stat<CMeshO>::ComputePerVertexQualityHistogram(m->cm, H);
+				range = std::make_pair(H.MinV(), H.MaxV());
+				PercLo = H.Percentile(par.getDynamicFloat("perc") / 100.f);
+				PercHi = H.Percentile(1.0 - par.getDynamicFloat("perc") / 100.f);
+			}
+			else
+				range = ColorKernels::vertexQualityRange(m->cm);
 
 			if (par.getBool("zeroSym"))
 			{
@@ -580,12 +616,12 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 
 			if (usePerc)
 			{
-				tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, PercLo, PercHi);
-				log("Quality Range: %f %f; Used (%f %f) percentile (%f %f) ", H.MinV(), H.MaxV(), PercLo, PercHi, par.getDynamicFloat("perc"), 100 - par.getDynamicFloat("perc"));
+				ColorKernels::qualityRamp(m->cm, PercLo, PercHi);
+				log("Quality Range: %f %f; Used (%f %f) percentile (%f %f) ", range.first, range.second, PercLo, PercHi, par.getDynamicFloat("perc"), 100 - par.getDynamicFloat("perc"));
 			}
 			else {
-				tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, RangeMin, RangeMax);
-				log("Quality Range: %f %f; Used (%f %f)", H.MinV(), H.MaxV(), RangeMin, RangeMax);
+				ColorKernels::qualityRamp(m->cm, RangeMin, RangeMax);
+				log("Quality Range: %f %f; Used (%f %f)", range.first, range.second, RangeMin, RangeMax);
 			}
 			return true;
 		}
@@ -630,10 +666,19 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			float perc = par.getDynamicFloat("perc");
 			bool usePerc = perc>0;
 
+			// the histogram is needed only for the percentiles
 			Histogramm H;
-			tri::Stat<CMeshO>::ComputePerFaceQualityHistogram(m->cm, H);
-			float PercLo = H.Percentile(perc / 100.f);
-			float PercHi = H.Percentile(1.0 - perc / 100.f);
+			std::pair<Scalarm, Scalarm> range;
+			float PercLo = 0, PercHi = 0;
+			if (usePerc)
+			{
+				tri::Stat<CMeshO>::ComputePerFaceQualityHistogram(m->cm, H);
+				range = std::make_pair(H.MinV(), H.MaxV());
+				PercLo = H.Percentile(perc / 100.f);
+				PercHi = H.Percentile(1.0 - perc / 100.f);
+			}
+			else
+				range = ColorKernels::faceQualityRange(m->cm);
 
 			// Make the range and percentile symmetric w.r.t. zero, so that
 			// the value zero is always colored in yellow
@@ -647,11 +692,11 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 			if (usePerc){
 				tri::UpdateColor<CMeshO>::PerFaceQualityRamp(m->cm, PercLo, PercHi);
 				log("Quality Range: %f %f; Used (%f %f) percentile (%f %f) ",
-					H.MinV(), H.MaxV(), PercLo, PercHi, perc, 100 - perc);
+					range.first, range.second, PercLo, PercHi, perc, 100 - perc);
 			}
 			else {
 				tri::UpdateColor<CMeshO>::PerFaceQualityRamp(m->cm, RangeMin, RangeMax);
-				log("Quality Range: %f %f; Used (%f %f)", H.MinV(), H.MaxV(), RangeMin, RangeMax);
+				log("Quality Range: %f %f; Used (%f %f)", range.first, range.second, RangeMin, RangeMax);
 			}
 			return true;
 		}
@@ -684,7 +729,7 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 
 			Histogramm H;
 			tri::Stat<CMeshO>::ComputePerVertexQualityHistogram(m->cm, H);
-			tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, H.Percentile(0.1f), H.Percentile(0.9f));
+			ColorKernels::qualityRamp(m->cm, H.Percentile(0.1f), H.Percentile(0.9f));
 			log("Curvature Range: %f %f (Used 90 percentile %f %f) ", H.MinV(), H.MaxV(), H.Percentile(0.1f), H.Percentile(0.9f));
 			return true;
 		}
@@ -833,7 +878,10 @@ bool FilterColorProc::applyFilter(const QAction *filter, MeshDocument &md, std::
 		case CP_VERTEX_SMOOTH:
 		{
 			int iteration = par.getInt("iteration");
-			tri::Smooth<CMeshO>::VertexColorLaplacian(m->cm, iteration, false, cb);
+			if (VertexSmoother::supports(m->cm))
+				VertexSmoother(m->cm).colorLaplacian(iteration, false, cb);
+			else
+				tri::Smooth<CMeshO>::VertexColorLaplacian(m->cm, iteration, false, cb);
 			return true;
 		}
 
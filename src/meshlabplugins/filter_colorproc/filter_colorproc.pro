@@ -1,9 +1,13 @@
 include (../../shared.pri)
 
 HEADERS += \
-    filter_colorproc.h
+    color_kernels.h \
+    filter_colorproc.h \
+    ../filter_unsharp/vertex_smoother.h
 
 SOURCES += \
-    filter_colorproc.cpp
+    color_kernels.cpp \
+    filter_colorproc.cpp \
+    ../filter_unsharp/vertex_smoother.cpp
 				
 TARGET = filter_colorproc
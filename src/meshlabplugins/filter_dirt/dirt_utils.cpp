@@ -27,9 +27,9 @@
 Return a random direction
 */
 
-CMeshO::CoordType getRandomDirection(){
+CMeshO::CoordType getRandomDirection(math::MarsenneTwisterRNG &rnd){
     CMeshO::CoordType dir;
-    dir = Point3m(rand()/Scalarm(RAND_MAX),rand()/Scalarm(RAND_MAX),rand()/Scalarm(RAND_MAX))-Point3m(0.5f,0.5f,0.5f);
+    dir = Point3m(rnd.generate01(),rnd.generate01(),rnd.generate01())-Point3m(0.5f,0.5f,0.5f);
     dir = dir * 0.3f;
     return dir;
 }
@@ -83,8 +83,12 @@ Scalarm GetVelocity(CMeshO::CoordType o_p,CMeshO::CoordType n_p,CMeshO::FacePoin
 @return a triple of barycentric coordinates
 */
 CMeshO::CoordType RandomBaricentric(){
-    CMeshO::CoordType interp;
     static math::MarsenneTwisterRNG rnd;
+    return RandomBaricentric(rnd);
+}
+
+CMeshO::CoordType RandomBaricentric(math::MarsenneTwisterRNG &rnd){
+    CMeshO::CoordType interp;
     interp[1] = rnd.generate01();
     interp[2] = rnd.generate01();
 
@@ -274,11 +278,12 @@ void ColorizeMesh(MeshModel* m){
 @param Facepointer f - pointer to the face
 @param CoordType int_point - intersection point this is a return parameter for the function.
 @param FacePointer face - pointer to the new face
+@param MarsenneTwisterRNG rnd - random generator of the thread moving the particle
 
 @return the intersection edge index if there is an intersection -1 elsewhere
 Step
 */
-int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point){
+int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point,math::MarsenneTwisterRNG &rnd){
 
     CMeshO::CoordType v0=f->V(0)->P();
     CMeshO::CoordType v1=f->V(1)->P();
@@ -316,7 +321,7 @@ int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::Fa
             n_face++;
         }
         if(n_face!=0){
-            int r=(rand()%(n_face-1))+2;
+            int r=int(rnd.generate(n_face-1))+2;
             for(int i=0;i<r;i++){
                 p.FlipE();
                 p.FlipF();
@@ -360,78 +365,83 @@ void ComputeSurfaceExposure(MeshModel* m, int /*r*/, int n_ray){
 
     CMeshO::PerFaceAttributeHandle<Scalarm> eh=vcg::tri::Allocator<CMeshO>::AddPerFaceAttribute<Scalarm>(m->cm,std::string("exposure"));
 
-	Scalarm dh = Scalarm(1.2);
-	Scalarm exp = Scalarm(0);
-	Scalarm di = Scalarm(0);
-	Scalarm xi = Scalarm(0);
-
-//    CMeshO::FacePointer face;
-    CMeshO::CoordType p_c;
-    MetroMeshFaceGrid f_grid;
-    f_grid.Set(m->cm.face.begin(),m->cm.face.end());
-    MarkerFace markerFunctor;
-    markerFunctor.SetMesh(&(m->cm));
-    RayTriangleIntersectionFunctor<false> RSectFunct;
-    CMeshO::FaceIterator fi;
-    for(fi=m->cm.face.begin();fi!=m->cm.face.end();++fi){
-        xi=0;
-        eh[fi]=0;
-
-        for(int i=0;i<n_ray;i++){
-            //For every f_face  get the central point
-            p_c=fromBarCoords(RandomBaricentric(),&*fi);
-            //Create a ray with p_c as origin and direction N
-            p_c=p_c+TriangleNormal(*fi).Normalize()*0.1f;
-            Ray3<Scalarm> ray=Ray3<Scalarm>(p_c,fi->N());
-            di=0;
-//            face=0;
-            /*face=*/f_grid.DoRay<RayTriangleIntersectionFunctor<false>,MarkerFace>(RSectFunct,markerFunctor,ray,1000,di);
-
-            if(di!=0){
-                xi=xi+(dh/(dh-di));
-
+    Scalarm dh = Scalarm(1.2);
+    MeshRayBVH bvh(m->cm);
+
+    //The faces are split in blocks shared among the threads; the rays of a block are cast
+    //in packets of consecutive rays, that start from near points along similar normals
+    const int faceNum=int(m->cm.face.size());
+    const int blockNum=(faceNum+EXPOSURE_BLOCK-1)/EXPOSURE_BLOCK;
+    const unsigned int seed=rand();
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int b=0;b<blockNum;b++){
+        math::MarsenneTwisterRNG rnd(seed+b);
+        const int first=b*EXPOSURE_BLOCK;
+        const int last=std::min(faceNum,first+EXPOSURE_BLOCK);
+        std::vector<Point3m> origin;
+        std::vector<Point3m> dir;
+        std::vector<int> rayFace;
+        for(int f=first;f<last;f++){
+            CFaceO &face=m->cm.face[f];
+            for(int i=0;i<n_ray;i++){
+                //For every f_face  get the central point
+                Point3m p_c=fromBarCoords(RandomBaricentric(rnd),&face);
+                //Create a ray with p_c as origin and direction N
+                origin.push_back(p_c+TriangleNormal(face).Normalize()*0.1f);
+                dir.push_back(face.N());
+                rayFace.push_back(f);
             }
         }
-        exp=1-(xi/n_ray);
-        eh[fi]=exp;
 
+        std::vector<Scalarm> xi(last-first,0);
+        MeshRayBVH::Hit hit[MeshRayBVH::PACKET_SIZE];
+        bool found[MeshRayBVH::PACKET_SIZE];
+        for(int r=0;r<int(origin.size());r+=MeshRayBVH::PACKET_SIZE){
+            const int n=std::min(int(MeshRayBVH::PACKET_SIZE),int(origin.size())-r);
+            bvh.closestHits(n,&origin[r],&dir[r],0,1000,hit,found);
+            for(int i=0;i<n;i++){
+                Scalarm di=found[i] ? hit[i].t : 0;
+                if(di!=0) xi[rayFace[r+i]-first]+=(dh/(dh-di));
+            }
+        }
+        for(int f=first;f<last;f++)
+            eh[&m->cm.face[f]]=1-(xi[f-first]/n_ray);
     }
 }
 
 
-void ComputeParticlesFallsPosition(MeshModel* base_mesh,MeshModel* cloud_mesh,CMeshO::CoordType dir){
-    CMeshO::VertexIterator vi;
-    MetroMeshFaceGrid f_grid;
-    f_grid.Set(base_mesh->cm.face.begin(),base_mesh->cm.face.end());
-    MarkerFace markerFunctor;
-    markerFunctor.SetMesh(&(base_mesh->cm));
-    RayTriangleIntersectionFunctor<false> RSectFunct;
+void ComputeParticlesFallsPosition(MeshModel* base_mesh,MeshModel* cloud_mesh,const MeshRayBVH &bvh,CMeshO::CoordType dir){
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph= tri::Allocator<CMeshO>::GetPerVertexAttribute<Particle<CMeshO> >(cloud_mesh->cm,"ParticleInfo");
-    std::vector<CMeshO::VertexPointer> ToDelVec;
-    for(vi=cloud_mesh->cm.vert.begin();vi!=cloud_mesh->cm.vert.end();++vi){
-        Particle<CMeshO> info=ph[vi];
-        if((*vi).IsS()){
-            Point3m p_c=vi->P()+info.face->N().normalized()*0.1f;
-            Ray3<Scalarm> ray=Ray3<Scalarm>(p_c,dir);
-            Scalarm di;
-            CMeshO::FacePointer new_f=f_grid.DoRay<RayTriangleIntersectionFunctor<false>,MarkerFace>(RSectFunct,markerFunctor,ray,base_mesh->cm.bbox.Diag(),di);
-            if(new_f!=0){
-                ph[vi].face=new_f;
-                Scalarm u;
-                Scalarm v;
-                Scalarm t;
-                IntersectionRayTriangle<Scalarm>(ray,new_f->P(0),new_f->P(1),new_f->P(2),t,u,v);
-                Point3m bc(1-u-v,u,v);
-                vi->P()=fromBarCoords(bc,new_f);
-                vi->ClearS();
-                new_f->C()=Color4b::Red;
-            }else{
-                ToDelVec.push_back(&*vi);
-            }
+    Point3m ray_dir=dir;
+    ray_dir.Normalize();
+    const Scalarm max_dist=base_mesh->cm.bbox.Diag();
+
+    //The falling particles are independent: every thread casts the rays of its own
+    //particles and moves them, the faces hit are recolored afterwards
+    const int vertNum=int(cloud_mesh->cm.vert.size());
+    std::vector<CMeshO::FacePointer> landing(vertNum,(CMeshO::FacePointer)0);
+    std::vector<char> toDel(vertNum,0);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for(int i=0;i<vertNum;i++){
+        CMeshO::VertexPointer vp=&cloud_mesh->cm.vert[i];
+        if(vp->IsD() || !vp->IsS()) continue;
+        Particle<CMeshO> &info=ph[vp];
+        Point3m p_c=vp->P()+info.face->N().normalized()*0.1f;
+        MeshRayBVH::Hit hit;
+        if(bvh.closestHit(p_c,ray_dir,0,max_dist,hit)){
+            CMeshO::FacePointer new_f=&base_mesh->cm.face[hit.face];
+            info.face=new_f;
+            Point3m bc(1-hit.u-hit.v,hit.u,hit.v);
+            vp->P()=fromBarCoords(bc,new_f);
+            vp->ClearS();
+            landing[i]=new_f;
+        }else{
+            toDel[i]=1;
         }
     }
-    for(unsigned int i=0;i<ToDelVec.size();i++){
-        if(!ToDelVec[i]->IsD()) Allocator<CMeshO>::DeleteVertex(cloud_mesh->cm,*ToDelVec[i]);
+    for(int i=0;i<vertNum;i++){
+        if(landing[i]!=0) landing[i]->C()=Color4b::Red;
+        if(toDel[i] && !cloud_mesh->cm.vert[i].IsD()) Allocator<CMeshO>::DeleteVertex(cloud_mesh->cm,cloud_mesh->cm.vert[i]);
     }
 }
 
@@ -566,16 +576,27 @@ void prepareMesh(MeshModel* m){
     }
 }
 
+void FaceDirtBuffer::clear(){
+    dirt.clear();
+    color.clear();
+}
+
+void FaceDirtBuffer::apply(){
+    for(size_t i=0;i<dirt.size();i++) dirt[i].first->Q()+=dirt[i].second;
+    for(size_t i=0;i<color.size();i++) color[i].first->C()=color[i].second;
+    clear();
+}
+
 /**
-@def This function move a particle over the mesh
+@def This function move a particle over the mesh; the changes to the faces are written in buffer
 */
-void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a){
+void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a,math::MarsenneTwisterRNG &rnd,FaceDirtBuffer &buffer){
     if(CheckFallPosition(info.face,g,a)){
         p->SetS();
         return;
     }
     Scalarm time=t;
-    if(dir.Norm()==0) dir=getRandomDirection();
+    if(dir.Norm()==0) dir=getRandomDirection(rnd);
     Point3m new_pos;
     Point3m current_pos;
     Point3m int_pos;
@@ -585,7 +606,7 @@ void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t
     current_pos=p->P();
     new_pos=StepForward(current_pos,info.v,info.mass,current_face,g+dir,l,time);
     while(!IsOnFace(new_pos,current_face)){
-        int edge=ComputeIntersection(current_pos,new_pos,current_face,new_face,int_pos);
+        int edge=ComputeIntersection(current_pos,new_pos,current_face,new_face,int_pos,rnd);
         if(edge!=-1){
 //            Point3m n = new_face->N();
             if(CheckFallPosition(new_face,g,a))  p->SetS();
@@ -593,14 +614,14 @@ void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t
             info.v=GetNewVelocity(info.v,current_face,new_face,g+dir,g,info.mass,elapsed_time);
             time=time-elapsed_time;
             current_pos=int_pos;
-            current_face->Q()+=elapsed_time*5;
+            buffer.dirt.push_back(std::make_pair(current_face,elapsed_time*5));
             current_face=new_face;
             new_pos=int_pos;
             if(time>0){
                 if(p->IsS()) break;
                 new_pos=StepForward(current_pos,info.v,info.mass,current_face,g+dir,l,time);
             }
-            current_face->C()=Color4b::Green;//Just Debug!!!!
+            buffer.color.push_back(std::make_pair(current_face,Color4b(Color4b::Green)));//Just Debug!!!!
         }else{
             //We are on a border
             new_pos=int_pos;
@@ -631,40 +652,58 @@ void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm /*l*/,Point3m
     std::vector<CMeshO::VertexPointer> vp;
     std::vector<Scalarm> distances;
     v_grid.Set(c_m->cm.vert.begin(),c_m->cm.vert.end(),b_m->cm.bbox);
+    math::MarsenneTwisterRNG rnd(rand());
+    FaceDirtBuffer buffer;
     CMeshO::VertexIterator vi;
     for(vi=c_m->cm.vert.begin();vi!=c_m->cm.vert.end();++vi){
         vcg::tri::GetKClosestVertex(c_m->cm,v_grid,k,vi->P(),EPSILON,vp,distances,v_points);
         for(unsigned int i=0;i<vp.size();i++){CMeshO::VertexPointer v = vp[i];
             if(v->P()!=vi->P() && !v->IsD() && !vi->IsD()){
-                Ray3<Scalarm> ray(vi->P(),fromBarCoords(RandomBaricentric(),ph[vp[i]].face));
+                Ray3<Scalarm> ray(vi->P(),fromBarCoords(RandomBaricentric(rnd),ph[vp[i]].face));
                 ray.Normalize();
                 Point3m dir=ray.Direction();
                 dir.Normalize();
-                MoveParticle(ph[vp[i]],vp[i],0.01,1,dir,g,a);
+                MoveParticle(ph[vp[i]],vp[i],0.01,1,dir,g,a,rnd,buffer);
             }
         }
     }
+    buffer.apply();
 }
 /**
 @def This function simulate the movement of the cloud mesh, it requires that every point is associated with a Particle data structure
 
 @param MeshModel cloud  - Mesh of points
+@param MeshRayBVH bvh   - BVH of the base mesh, used to drop the falling particles
 @param Point3m   force  - Direction of the force
 @param Scalarm     l      - Length of the  movementstep
 @param Scalarm     t   - Time Step
 
 @return nothing
 */
-void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step){
+void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,const MeshRayBVH &bvh,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step){
 
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph = Allocator<CMeshO>::GetPerVertexAttribute<Particle<CMeshO> >(cloud->cm,"ParticleInfo");
-    CMeshO::VertexIterator vi;
-    for(vi=cloud->cm.vert.begin();vi!=cloud->cm.vert.end();++vi)
-        if(!vi->IsD()) MoveParticle(ph[vi],&*vi,l,t,force,g,a);
 
+    //The particles are independent within a step: they are moved in batches by many
+    //threads, each batch with its own random generator and face buffer
+    const int vertNum=int(cloud->cm.vert.size());
+    const int batchNum=(vertNum+PARTICLE_BATCH-1)/PARTICLE_BATCH;
+    const unsigned int seed=rand();
+    std::vector<FaceDirtBuffer> buffers(batchNum);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int b=0;b<batchNum;b++){
+        math::MarsenneTwisterRNG rnd(seed+b);
+        const int last=std::min(vertNum,(b+1)*PARTICLE_BATCH);
+        for(int i=b*PARTICLE_BATCH;i<last;i++){
+            CMeshO::VertexPointer vp=&cloud->cm.vert[i];
+            if(!vp->IsD()) MoveParticle(ph[vp],vp,l,t,force,g,a,rnd,buffers[b]);
+        }
+    }
+    for(int b=0;b<batchNum;b++)
+        buffers[b].apply();
 
     //Handle falls Particle
-    ComputeParticlesFallsPosition(base,cloud,g);
+    ComputeParticlesFallsPosition(base,cloud,bvh,g);
     //Compute Particles Repulsion
     for(int i=0;i<r_step;i++)
         ComputeRepulsion(base,cloud,50,l,g,a);
@@ -31,7 +31,11 @@
 #include <stdlib.h>
 #include <time.h>
 #include <limits>
+#include <vector>
+#include <algorithm>
 #include <common/ml_document/mesh_model.h>
+#include <common/ml_document/mesh_ray_bvh.h>
+#include <vcg/math/random_generator.h>
 #include "particle.h"
 
 using namespace vcg;
@@ -42,16 +46,33 @@ typedef GridStaticPtr<CMeshO::VertexType, CMeshO::ScalarType > MetroMeshVertexGr
 typedef FaceTmark<CMeshO> MarkerFace;
 
 #define EPSILON 0.0001
+#define EXPOSURE_BLOCK 256      //faces whose exposure is computed by a thread at a time
+#define PARTICLE_BATCH 1024     //particles moved by a thread at a time
+
+/**
+Changes to the faces of the base mesh made by a batch of particles: the dirt left
+on each face and the faces to recolor. Each thread moves its batch writing in its
+own buffer, then the buffers are applied to the mesh in the order of the batches,
+so the face quality sums up as if the particles had been moved one by one.
+*/
+struct FaceDirtBuffer{
+    std::vector<std::pair<CMeshO::FacePointer,Scalarm> > dirt;
+    std::vector<std::pair<CMeshO::FacePointer,Color4b> > color;
+
+    void clear();
+    void apply();
+};
 
 CMeshO::CoordType RandomBaricentric();
+CMeshO::CoordType RandomBaricentric(math::MarsenneTwisterRNG &rnd);
 CMeshO::CoordType fromBarCoords(Point3m bc,CMeshO::FacePointer f);
 CMeshO::CoordType GetSafePosition(CMeshO::CoordType p,CMeshO::FacePointer f);
 CMeshO::CoordType StepForward(CMeshO::CoordType p,CMeshO::CoordType v,Scalarm m,CMeshO::FacePointer &face,CMeshO::CoordType force,Scalarm l,Scalarm t=1);
-CMeshO::CoordType getRandomDirection();
+CMeshO::CoordType getRandomDirection(math::MarsenneTwisterRNG &rnd);
 CMeshO::CoordType getVelocityComponent(Scalarm v,CMeshO::FacePointer f,CMeshO::CoordType g);
 CMeshO::CoordType GetNewVelocity(CMeshO::CoordType i_v,CMeshO::FacePointer face,CMeshO::FacePointer new_face,CMeshO::CoordType force,CMeshO::CoordType g,Scalarm m,Scalarm t);
 
-int ComputeIntersection(CMeshO::CoordType p1,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point);
+int ComputeIntersection(CMeshO::CoordType p1,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point,math::MarsenneTwisterRNG &rnd);
 Scalarm GetElapsedTime(CMeshO::CoordType p1,CMeshO::CoordType p2, CMeshO::CoordType p3, Scalarm t,Scalarm l);
 
 bool CheckFallPosition(CMeshO::FacePointer f,Point3m g,Scalarm a);
@@ -63,12 +84,12 @@ void ColorizeMesh(MeshModel* m);
 void DrawDust(MeshModel *base_mesh,MeshModel *cloud_mesh);
 void ComputeNormalDustAmount(MeshModel* m,CMeshO::CoordType u,Scalarm k,Scalarm s);
 void ComputeSurfaceExposure(MeshModel* m,int r,int n_ray);
-void ComputeParticlesFallsPosition(MeshModel* cloud_mesh,MeshModel* base_mesh,CMeshO::CoordType dir);
+void ComputeParticlesFallsPosition(MeshModel* base_mesh,MeshModel* cloud_mesh,const MeshRayBVH &bvh,CMeshO::CoordType dir);
 void associateParticles(MeshModel* b_m,MeshModel* c_m,Scalarm &m,Scalarm &v,CMeshO::CoordType g);
 void prepareMesh(MeshModel* m);
-void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a);
+void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a,math::MarsenneTwisterRNG &rnd,FaceDirtBuffer &buffer);
 void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm l,Point3m g,Scalarm a);
-void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step);
+void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,const MeshRayBVH &bvh,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step);
 
 
 #endif // DIRT_UTILS_H
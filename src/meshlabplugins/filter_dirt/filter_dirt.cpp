@@ -224,9 +224,10 @@ bool FilterDirt::applyFilter(const QAction *filter, MeshDocument &md, std::map<s
         }
 
         //Move Cloud Mesh
+        MeshRayBVH bvh(base_mesh->cm);
         float frac=100/s;
         for(int i=0;i<s;i++){
-            MoveCloudMeshForward(cloud_mesh,base_mesh,g,dir,l,adhesion,1,1);
+            MoveCloudMeshForward(cloud_mesh,base_mesh,bvh,g,dir,l,adhesion,1,1);
             if(cb) (*cb)(i*frac,"Moving...");
         }
         if(colorize) ColorizeMesh(base_mesh);
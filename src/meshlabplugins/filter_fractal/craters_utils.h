@@ -21,6 +21,9 @@ public:
     typedef tri::FaceTmark<MeshType>                MarkerFace;
     typedef typename MeshType::template PerVertexAttributeHandle<ScalarType> PertHandle;
 
+    // number of crater vertices perturbed by a thread at a time
+    enum { CRATER_BLOCK = 1024 };
+
     /* wrapper for FP_CRATERS filter arguments */
     class CratersArgs
     {
@@ -231,44 +234,61 @@ public:
         vcg::tri::UpdateFlags<MeshType>::VertexClearV(*(args.target_mesh));
 
         typename std::vector<FacePointer>::iterator fi;
-        VertexPointer vp;
-        ScalarType perturbation = .0;
-        Point3<ScalarType> p;
+        std::vector<VertexPointer> craterVertices;
+        std::vector<Point3<ScalarType> > points;
 
-        /* for each crater vertex, calculates the associated perturbation
-           and then stores it in the passed per-vertex-attribute handle */
+        // collects the crater vertices and their coords normalized on the crater radius
         for(fi = craterFaces.begin(); fi!=craterFaces.end(); ++fi)
         {
             for(int i=0; i<3; i++)
             {
-                vp = (*fi)->V(i);
+                VertexPointer vp = (*fi)->V(i);
                 if(!vp->IsV())
                 {
                     vp->SetV();
-                    p = (vp->P() - centre->P())/radius;
-                    perturbation = (*(args.craterFunctor))(p) * depth;
+                    craterVertices.push_back(vp);
+                    points.push_back((vp->P() - centre->P())/radius);
+                }
+            }
+        }
 
-                    // stores the perturbation in the passed handle, according to
-                    // the successiveImpacts flag
-                    if(args.successiveImpacts)
+        /* for each crater vertex, calculates the associated perturbation (in blocks
+           of vertices shared among the threads) and then stores it in the passed
+           per-vertex-attribute handle */
+        int vCount = int(points.size());
+        int blockCount = (vCount + CRATER_BLOCK - 1) / CRATER_BLOCK;
+        std::vector<ScalarType> perturbations(vCount);
+#pragma omp parallel for schedule(dynamic, 1) if(blockCount > 1)
+        for(int b=0; b<blockCount; b++)
+        {
+            int begin = b * CRATER_BLOCK, count = std::min(int(CRATER_BLOCK), vCount - begin);
+            args.craterFunctor->evaluate(&points[begin], &perturbations[begin], count);
+        }
+
+        for(int i=0; i<vCount; i++)
+        {
+            VertexPointer vp = craterVertices[i];
+            ScalarType perturbation = perturbations[i] * depth;
+
+            // stores the perturbation in the passed handle, according to
+            // the successiveImpacts flag
+            if(args.successiveImpacts)
+            {
+                if(perturbation < 0)  // we are in the crater "depression"
+                {
+                    pertHandle[vp] = std::min(perturbation, pertHandle[vp]);
+                } else  // crater "elevation" and/or blending portion
+                {
+                    if(pertHandle[vp] == .0)
                     {
-                        if(perturbation < 0)  // we are in the crater "depression"
-                        {
-                            pertHandle[vp] = std::min(perturbation, pertHandle[vp]);
-                        } else  // crater "elevation" and/or blending portion
-                        {
-                            if(pertHandle[vp] == .0)
-                            {
-                                pertHandle[vp] += perturbation;
-                            }
-                        }
-                    } else {
-                        // by adding the perturbation to the one that is already present
-                        // we obtain a "crater intersection", so we cannot recognize
-                        // which crater is created before each other
                         pertHandle[vp] += perturbation;
                     }
                 }
+            } else {
+                // by adding the perturbation to the one that is already present
+                // we obtain a "crater intersection", so we cannot recognize
+                // which crater is created before each other
+                pertHandle[vp] += perturbation;
             }
         }
     }
@@ -4,7 +4,8 @@ HEADERS += \
     filter_fractal.h \
     fractal_utils.h \
     craters_utils.h \
-    filter_functors.h
+    filter_functors.h \
+    noise_batch.h
 
 SOURCES += \
     filter_fractal.cpp
@@ -3,6 +3,9 @@
 
 #include <vcg/space/point3.h>
 #include <vcg/math/perlin_noise.h>
+#include <algorithm>
+#include <vector>
+#include "noise_batch.h"
 
 #define SQRT2 1.42421356
 #define MQCONST 1/(1-SQRT2)
@@ -43,7 +46,7 @@ public:
         ScalarType dist = vcg::Distance(normalizedPoint, *org);
         return (*this)(dist);
     }
-    virtual ScalarType operator()(ScalarType dist) = 0;
+    virtual ScalarType operator()(ScalarType dist) const = 0;
 
 private:
     Point3<ScalarType>* org;
@@ -58,7 +61,7 @@ template<class ScalarType>
 class GaussianBlending: public RadialFunctor<ScalarType>
 {
 public:
-    ScalarType operator()(ScalarType x)
+    ScalarType operator()(ScalarType x) const
     {
         return (ScalarType)(exp(-pow(2*x, 2)));
     }
@@ -69,7 +72,7 @@ template<class ScalarType>
 class MultiquadricBlending: public RadialFunctor<ScalarType>
 {
 public:
-    ScalarType operator()(ScalarType x)
+    ScalarType operator()(ScalarType x) const
     {
         return (ScalarType)((sqrt(1 + pow(x, 2)) - SQRT2) * MQCONST);
     }
@@ -80,7 +83,7 @@ template<class ScalarType>
 class F3Blending: public RadialFunctor<ScalarType>
 {
 public:
-    ScalarType operator()(ScalarType x)
+    ScalarType operator()(ScalarType x) const
     {
         if(x>=1) return ScalarType(.0);
         return (ScalarType)(fabs(1-pow(x, 4)));
@@ -100,7 +103,7 @@ public:
         falloff = _falloff;
     }
 
-    ScalarType operator()(ScalarType x)
+    ScalarType operator()(ScalarType x) const
     {
         if(x >= 1) return ScalarType(.0);
         return (ScalarType)(exp(-falloff*x));
@@ -112,7 +115,7 @@ template<class ScalarType>
 class LinearBlending: public RadialFunctor<ScalarType>
 {
 public:
-    ScalarType operator()(ScalarType x)
+    ScalarType operator()(ScalarType x) const
     {
         if (x>=1) return ScalarType(.0);
         return (ScalarType)(1-x);
@@ -143,6 +146,8 @@ public:
    - update the noise value at each frequency (e.g. fBM algorithm adds the
      noise contributions of each frequency, while standard multifractal
      algorithm multiplies them with each other.)
+   Both have a batched version (initLanes and updateLanes) that does the same
+   on PerlinBatch::LANES points at once, used by evaluate().
 
    Four of the five terrain generation algorithms take other parameters. These algorithms
    are the standard multifractal, heterogeneous multifractal, hybrid multifractal
@@ -201,21 +206,91 @@ public:
         return noise;
     }
 
+    enum { LANES = PerlinBatch<ScalarType>::LANES };
+
+    /* Batched version of the template algorithm: computes the noise of the n points p
+       and stores it in noise, LANES points at a time. The result is the same that
+       operator() gives on each point, but the functor is not modified, so it can be
+       shared among threads working on different parts of the same array. */
+    void evaluate(const Point3<ScalarType>* p, ScalarType* noise, int n) const
+    {
+        Lanes s;
+        for(int b=0; b<n; b+=LANES)
+        {
+            int count = std::min(int(LANES), n - b);
+            for(int k=0; k<LANES; k++)
+            {
+                // the unused lanes of the last batch repeat its last point
+                const Point3<ScalarType>& q = p[b + std::min(k, count - 1)];
+                s.x[k] = q.X(); s.y[k] = q.Y(); s.z[k] = q.Z();
+                s.noise[k] = ScalarType(.0);
+            }
+            initLanes(s);
+
+            for(int i=0; i<octaves; i++)
+            {
+                updateLanes(i, s);
+                scaleLanes(s);
+            }
+
+            if(remainder != ScalarType(0))
+            {
+                updateLanes(octaves, s);
+                for(int k=0; k<LANES; k++)
+                    s.noise[k] *= remainder;
+            }
+
+            for(int k=0; k<count; k++)
+                noise[b + k] = s.noise[k];
+        }
+    }
+
     int octaves;                    // number of octaves
     ScalarType h, l;                // fractal increment and lacunarity
-    ScalarType spectralWeight[21];  // spectral weights
+    ScalarType spectralWeight[22];  // spectral weights
     ScalarType remainder;           // octaves remainder
 
 protected:
+    /* state of the template algorithm on LANES points: the (displaced) coordinates,
+       the noise computed so far and the per-point variables of the algorithms */
+    struct Lanes
+    {
+        enum { SIZE = LANES };
+        ScalarType x[LANES], y[LANES], z[LANES];
+        ScalarType noise[LANES];
+        ScalarType weight[LANES], signal[LANES];
+    };
+
     virtual void init(ScalarType&x, ScalarType& y, ScalarType& z, ScalarType& noise) = 0;
     virtual void update(int oct, ScalarType&x, ScalarType& y, ScalarType& z, ScalarType& noise) = 0;
+    virtual void initLanes(Lanes& s) const = 0;
+    virtual void updateLanes(int oct, Lanes& s) const = 0;
+
+    /* perlin noise of the points of s, as math::Perlin::Noise computes it */
+    static void perlinLanes(const Lanes& s, ScalarType* perlin)
+    {
+        double result[LANES];
+        PerlinBatch<ScalarType>::Noise(s.x, s.y, s.z, result);
+        for(int k=0; k<LANES; k++)
+            perlin[k] = ScalarType(result[k]);
+    }
+
+    /* multiplies the coordinates of the points of s by the lacunarity */
+    void scaleLanes(Lanes& s) const
+    {
+        for(int k=0; k<LANES; k++)
+        {
+            s.x[k] *= l; s.y[k] *= l; s.z[k] *= l;
+        }
+    }
 
 private:
-    /* precomputes spectral weights to be used in noise algorithm */
+    /* precomputes spectral weights to be used in noise algorithm; the one after
+       the last octave is used by the octaves remainder */
     void precomputeSpectralWeights()
     {
         ScalarType frequency = 1.0;
-        for(int i=0; i<=octaves; i++)
+        for(int i=0; i<=octaves+1; i++)
         {
             spectralWeight[i] = pow(frequency, -h); // determines how "heavy" is the i-th octave
             frequency *= l;     // calculates the next octave frequency
@@ -241,6 +316,19 @@ public:
         ScalarType perlin = math::Perlin::Noise(x, y, z);
         noise += (perlin * this->spectralWeight[oct]);
     }
+
+protected:
+    typedef typename NoiseFunctor<ScalarType>::Lanes Lanes;
+
+    void initLanes(Lanes& /*s*/) const {}
+
+    void updateLanes(int oct, Lanes& s) const
+    {
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+            s.noise[k] += (perlin[k] * this->spectralWeight[oct]);
+    }
 };
 
 /* standard multifractal noise functor */
@@ -265,6 +353,25 @@ public:
         noise *=  (offset + perlin * this->spectralWeight[oct]);
     }
 
+protected:
+    typedef typename NoiseFunctor<ScalarType>::Lanes Lanes;
+
+    void initLanes(Lanes& s) const
+    {
+        for(int k=0; k<Lanes::SIZE; k++)
+            s.noise[k] = ScalarType(1.0);
+    }
+
+    void updateLanes(int oct, Lanes& s) const
+    {
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+            s.noise[k] *=  (offset + perlin[k] * this->spectralWeight[oct]);
+    }
+
+public:
+
     ScalarType offset;
 };
 
@@ -295,6 +402,33 @@ public:
         noise += increment;
     }
 
+protected:
+    typedef typename NoiseFunctor<ScalarType>::Lanes Lanes;
+
+    void initLanes(Lanes& s) const
+    {
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+            s.noise[k] = (offset + perlin[k]) * this->spectralWeight[0];
+        this->scaleLanes(s);
+    }
+
+    void updateLanes(int oct, Lanes& s) const
+    {
+        int nextOct = oct + 1;
+        if (nextOct == this->octaves) return;
+        ScalarType perlin[Lanes::SIZE], increment;
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+        {
+            increment = (offset + perlin[k]) * this->spectralWeight[nextOct] * s.noise[k];
+            s.noise[k] += increment;
+        }
+    }
+
+public:
+
     ScalarType offset;
 };
 
@@ -328,6 +462,38 @@ public:
         weight *= signal;
     }
 
+protected:
+    typedef typename NoiseFunctor<ScalarType>::Lanes Lanes;
+
+    void initLanes(Lanes& s) const
+    {
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+        {
+            s.noise[k] = (offset + perlin[k]);
+            s.weight[k] = s.noise[k];
+        }
+        this->scaleLanes(s);
+    }
+
+    void updateLanes(int oct, Lanes& s) const
+    {
+        int nextOct = oct+1;
+        if (nextOct == this->octaves) return;
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+        {
+            if (s.weight[k] > 1.0) s.weight[k] = 1.0;
+            s.signal[k] = (offset + perlin[k]) * this->spectralWeight[nextOct];
+            s.noise[k] += (s.weight[k] * s.signal[k]);
+            s.weight[k] *= s.signal[k];
+        }
+    }
+
+public:
+
     ScalarType offset;
     ScalarType weight, signal, perlin;
 };
@@ -365,6 +531,40 @@ public:
         noise += signal;
     }
 
+protected:
+    typedef typename NoiseFunctor<ScalarType>::Lanes Lanes;
+
+    void initLanes(Lanes& s) const
+    {
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+        {
+            s.signal[k] = pow(offset - fabs(perlin[k]), 2);
+            s.noise[k] = s.signal[k];
+            s.weight[k] = ScalarType(0);
+        }
+        this->scaleLanes(s);
+    }
+
+    void updateLanes(int oct, Lanes& s) const
+    {
+        int nextOct = oct + 1;
+        if(nextOct == this->octaves) return;
+        ScalarType perlin[Lanes::SIZE];
+        this->perlinLanes(s, perlin);
+        for(int k=0; k<Lanes::SIZE; k++)
+        {
+            s.weight[k] = s.signal[k] * gain;
+            if (s.weight[k] > 1.0) s.weight[k] = 1.0;
+            if (s.weight[k] < 0.0) s.weight[k] = 0.0;
+            s.signal[k] = pow(offset - fabs(perlin[k]), 2) * s.weight[k] * this->spectralWeight[nextOct];
+            s.noise[k] += s.signal[k];
+        }
+    }
+
+public:
+
     ScalarType offset, gain;
     ScalarType weight, signal, perlin;
 };
@@ -425,6 +625,42 @@ public:
         }
         return (result * (invert?-1:1));
     }
+
+    /* Batched version of operator(): computes the crater function on the n points p
+       and stores it in result. The noise of the points in the crater depression is
+       computed with NoiseFunctor::evaluate, and the functor is not modified. */
+    void evaluate(const Point3<ScalarType>* p, ScalarType* result, int n) const
+    {
+        std::vector<Point3<ScalarType> > noisePoints;
+        std::vector<int> noiseIndex;
+        for(int i=0; i<n; i++)
+        {
+            ScalarType x = vcg::Distance(p[i], *origin);
+            if (x <= blendingThreshold)
+            {
+                result[i] = -(*radialFunctor)(x) + elevationFactor;
+                if (noiseEnabled)
+                {
+                    noisePoints.push_back(p[i]);
+                    noiseIndex.push_back(i);
+                }
+            } else
+            {
+                result[i] = (*blendingFunctor)((x - blendingThreshold)/blendingRange) * maxRadial;
+            }
+        }
+
+        if (!noisePoints.empty())
+        {
+            std::vector<ScalarType> noise(noisePoints.size());
+            noiseFunctor->evaluate(&noisePoints[0], &noise[0], int(noisePoints.size()));
+            for(size_t j=0; j<noiseIndex.size(); j++)
+                result[noiseIndex[j]] += (noise[j] * ScalarType(0.15));
+        }
+
+        for(int i=0; i<n; i++)
+            result[i] = (result[i] * (invert?-1:1));
+    }
 };
 // ---------------------- end of crater functor -------------------------------------------
 
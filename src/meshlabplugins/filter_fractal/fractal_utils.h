@@ -5,6 +5,7 @@
 #include <common/ml_document/mesh_model.h>
 #include <vcg/complex/algorithms/smooth.h>
 #include "filter_functors.h"
+#include <algorithm>
 #include <vector>
 
 using namespace vcg;
@@ -21,11 +22,13 @@ public:
     typedef typename MeshType::ScalarType               ScalarType;
     typedef typename MeshType::VertexIterator           VertexIterator;
     typedef typename MeshType::VertexPointer            VertexPointer;
-    typedef std::pair<VertexPointer, ScalarType>        PertPair;
-    typedef typename std::vector<PertPair>::iterator    PertIterator;
     typedef typename MeshType::FaceIterator             FaceIterator;
     typedef typename MeshType::CoordType                CoordType;
 
+    // number of vertices perturbed by a thread at a time, and number of
+    // these blocks between two updates of the progress bar
+    enum { PERT_BLOCK = 1024, PERT_BLOCK_STEP = 256 };
+
     /* This class contains the arguments needed for an application of
        fractal perturbation filter. It constructs the right noise functor
        according to the requested noise algorithm. */
@@ -75,10 +78,11 @@ public:
     };
 
 
-    /* This function calculates a fractal perturbation and stores it in a given
-       vector. The perturbation is calculated according to the given parameters
-       (second argument), on the target mesh (first argument). The result is
-       a vector of pairs (vertex_pointer, perturbation) (third parameter).
+    /* This function calculates a fractal perturbation and applies it to the
+       vertices, as a displacement along the normal or as vertex quality.
+       The perturbation is calculated according to the given parameters
+       (second argument), on the target mesh (first argument), by many threads
+       with the batched noise evaluation of NoiseFunctor::evaluate.
        Assumption: if the perturbation has to be saved as vertex quality, the
        quality flags must be enabled. */
     static bool ComputeFractalPerturbation(
@@ -96,56 +100,65 @@ public:
             tri::Smooth<MeshType>::VertexNormalLaplacian(m, args.smoothingSteps, false);
         }
 
-        // some variables to manage the progress bar
-        char buffer[50];
-        int vCount = int(m.vert.size()), i=0;
-
-        // other variables for scaling and normalization of points
-        std::vector<PertPair> pertVector;
+        // variables for scaling and normalization of points
         ScalarType factor = args.scale/m.bbox.Diag(), min = 1000.0, max = -1000.0;
-        ScalarType seedTranslation = args.seed/factor, perturbation = .0;
+        ScalarType seedTranslation = args.seed/factor;
         Point3<ScalarType> seedPoint(seedTranslation, seedTranslation, seedTranslation);
-        Point3<ScalarType> center = m.bbox.Center(), p;
+        Point3<ScalarType> center = m.bbox.Center();
         Point3<ScalarType> trasl = seedPoint - center;
-        PertPair* tmpPair;
 
-        // first loop: calculates the perturbation and create the vector pairs
-        for(VertexIterator vi=m.vert.begin(); vi!=m.vert.end(); ++vi, ++i)
+        // the vertices to be perturbed
+        std::vector<VertexPointer> vertices;
+        vertices.reserve(m.vert.size());
+        for(VertexIterator vi=m.vert.begin(); vi!=m.vert.end(); ++vi)
         {
-            sprintf(buffer, "Calculating perturbation on vertex %d..", i);
-            cb(100*i/vCount, buffer);
-
             if (!(*vi).IsS() && args.displaceSelected) continue;
-            p = ((*vi).P() + trasl) * factor;   // scales and normalizes the point
-            perturbation = (*args.noiseFunctor)(p);
-            tmpPair = new PertPair(&(*vi), perturbation);
-            pertVector.push_back(*tmpPair);
+            vertices.push_back(&(*vi));
+        }
+        int vCount = int(vertices.size());
+        std::vector<ScalarType> pertVector(vCount);
+
+        // first loop: calculates the perturbation. The vertices are split in blocks
+        // shared among the threads, and the noise of each block is computed in batches
+        const NoiseFunctor<ScalarType>& noise = *args.noiseFunctor;
+        int blockCount = (vCount + PERT_BLOCK - 1) / PERT_BLOCK;
+        for(int b0=0; b0<blockCount; b0+=PERT_BLOCK_STEP)
+        {
+            cb(100*b0/blockCount, "Calculating perturbation..");
+            int b1 = std::min(blockCount, b0 + PERT_BLOCK_STEP);
+#pragma omp parallel for schedule(dynamic, 1)
+            for(int b=b0; b<b1; b++)
+            {
+                Point3<ScalarType> p[PERT_BLOCK];
+                int begin = b * PERT_BLOCK, count = std::min(int(PERT_BLOCK), vCount - begin);
+                for(int i=0; i<count; i++)
+                    p[i] = (vertices[begin + i]->P() + trasl) * factor;   // scales and normalizes the point
+                noise.evaluate(p, &pertVector[begin], count);
+            }
+        }
 
-            if (perturbation < min) min = perturbation;
-            if (perturbation > max) max = perturbation;
+        for(int i=0; i<vCount; i++)
+        {
+            if (pertVector[i] < min) min = pertVector[i];
+            if (pertVector[i] > max) max = pertVector[i];
         }
 
         // defines the effective range and the target range of the perturbation
         ScalarType hmax = args.maxHeight, hmin = (min * hmax) / max;
         ScalarType range1 = max - min, range2 = hmax - hmin;
 
-        i = 0;
-        int pairsCount = int(pertVector.size());
-
         // second loop: normalizes and applies the perturbation
-        for(PertIterator pi=pertVector.begin(); pi!=pertVector.end(); ++pi, ++i)
+        cb(99, "Normalizing perturbation..");
+#pragma omp parallel for schedule(static)
+        for(int i=0; i<vCount; i++)
         {
-            sprintf(buffer, "Normalizing perturbation on vertex %d..", i);
-            cb(100*i/pairsCount, buffer);
-
-            tmpPair = &(*pi);
-            tmpPair->second = (((tmpPair->second - min)/range1) * range2) + hmin;
+            ScalarType perturbation = (((pertVector[i] - min)/range1) * range2) + hmin;
 
             if(args.saveAsQuality)
             {
-                tmpPair->first->Q() += tmpPair->second;
+                vertices[i]->Q() += perturbation;
             } else {
-                tmpPair->first->P() += (tmpPair->first->N() * tmpPair->second);
+                vertices[i]->P() += (vertices[i]->N() * perturbation);
             }
         }
 
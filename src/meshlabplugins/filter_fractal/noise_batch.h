@@ -0,0 +1,122 @@
+#ifndef NOISE_BATCH_H
+#define NOISE_BATCH_H
+
+#include <cmath>
+
+/* Perlin noise evaluated on a batch of points at once.
+   This is the same improved noise of vcg::math::Perlin (Ken Perlin's reference
+   implementation, with the same permutation table and the same double precision
+   arithmetic), so that the results do not change, but the points are processed
+   LANES at a time in structure of arrays form: every step of the algorithm is a
+   plain loop over the lanes without branches, that the compiler turns into SIMD
+   instructions; only the lookups in the permutation table are done lane by lane.
+   The class has no state, so it can be used by many threads at once. */
+template<class ScalarType>
+class PerlinBatch
+{
+public:
+    enum { LANES = 8 };
+
+    /* computes the noise of the LANES points (x[k], y[k], z[k]) */
+    static void Noise(const ScalarType* px, const ScalarType* py, const ScalarType* pz, double* out)
+    {
+        int X[LANES], Y[LANES], Z[LANES];
+        double x[LANES], y[LANES], z[LANES];
+        double u[LANES], v[LANES], w[LANES];
+
+        // finds the unit cube that contains the point and the relative coords in it
+        for(int k=0; k<LANES; k++)
+        {
+            const double fx = std::floor(double(px[k]));
+            const double fy = std::floor(double(py[k]));
+            const double fz = std::floor(double(pz[k]));
+            X[k] = int(fx) & 255;
+            Y[k] = int(fy) & 255;
+            Z[k] = int(fz) & 255;
+            x[k] = double(px[k]) - fx;
+            y[k] = double(py[k]) - fy;
+            z[k] = double(pz[k]) - fz;
+        }
+
+        // computes the fade curves
+        for(int k=0; k<LANES; k++)
+        {
+            u[k] = fade(x[k]);
+            v[k] = fade(y[k]);
+            w[k] = fade(z[k]);
+        }
+
+        // hashes the coordinates of the 8 cube corners
+        int h[8][LANES];
+        const int* p = permutation();
+        for(int k=0; k<LANES; k++)
+        {
+            const int A = p[X[k]] + Y[k], AA = p[A] + Z[k], AB = p[A+1] + Z[k];
+            const int B = p[X[k]+1] + Y[k], BA = p[B] + Z[k], BB = p[B+1] + Z[k];
+            h[0][k] = p[AA];   h[1][k] = p[BA];   h[2][k] = p[AB];   h[3][k] = p[BB];
+            h[4][k] = p[AA+1]; h[5][k] = p[BA+1]; h[6][k] = p[AB+1]; h[7][k] = p[BB+1];
+        }
+
+        // adds the blended results from the 8 corners of the cube
+        for(int k=0; k<LANES; k++)
+        {
+            const double x1 = x[k]-1, y1 = y[k]-1, z1 = z[k]-1;
+            out[k] = lerp(w[k], lerp(v[k], lerp(u[k], grad(h[0][k], x[k], y[k], z[k]),
+                                                      grad(h[1][k], x1  , y[k], z[k])),
+                                           lerp(u[k], grad(h[2][k], x[k], y1  , z[k]),
+                                                      grad(h[3][k], x1  , y1  , z[k]))),
+                                lerp(v[k], lerp(u[k], grad(h[4][k], x[k], y[k], z1  ),
+                                                      grad(h[5][k], x1  , y[k], z1  )),
+                                           lerp(u[k], grad(h[6][k], x[k], y1  , z1  ),
+                                                      grad(h[7][k], x1  , y1  , z1  ))));
+        }
+    }
+
+private:
+    static inline double fade(double t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+    static inline double lerp(double t, double a, double b) { return a + t * (b - a); }
+
+    /* converts the low 4 bits of the hash code into 12 gradient directions;
+       written with selects only, so that it is vectorized with the rest of the loop */
+    static inline double grad(int hash, double x, double y, double z)
+    {
+        const int h = hash & 15;
+        const double u = h<8 ? x : y;
+        const double v = h<4 ? y : ((h==12 || h==14) ? x : z);
+        return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
+    }
+
+    /* the reference permutation, repeated twice to avoid the wrapping of the indices */
+    static const int* permutation()
+    {
+        static const int p[512] = {
+            151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,
+            8,99,37,240,21,10,23,190,6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,
+            35,11,32,57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,74,165,71,
+            134,139,48,27,166,77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,
+            55,46,245,40,244,102,143,54,65,25,63,161,1,216,80,73,209,76,132,187,208,89,
+            18,169,200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,52,217,226,
+            250,124,123,5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,
+            189,28,42,223,183,170,213,119,248,152,2,44,154,163,70,221,153,101,155,167,43,
+            172,9,129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,218,246,97,
+            228,251,34,242,193,238,210,144,12,191,179,162,241,81,51,145,235,249,14,239,
+            107,49,192,214,31,181,199,106,157,184,84,204,176,115,121,50,45,127,4,150,254,
+            138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+            151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,
+            8,99,37,240,21,10,23,190,6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,
+            35,11,32,57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,74,165,71,
+            134,139,48,27,166,77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,
+            55,46,245,40,244,102,143,54,65,25,63,161,1,216,80,73,209,76,132,187,208,89,
+            18,169,200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,52,217,226,
+            250,124,123,5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,
+            189,28,42,223,183,170,213,119,248,152,2,44,154,163,70,221,153,101,155,167,43,
+            172,9,129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,218,246,97,
+            228,251,34,242,193,238,210,144,12,191,179,162,241,81,51,145,235,249,14,239,
+            107,49,192,214,31,181,199,106,157,184,84,204,176,115,121,50,45,127,4,150,254,
+            138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
+        };
+        return p;
+    }
+};
+
+#endif // NOISE_BATCH_H
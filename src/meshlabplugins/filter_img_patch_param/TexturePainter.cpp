@@ -22,6 +22,7 @@
 ****************************************************************************/
 
 #include <cmath>
+#include <algorithm>
 #include "TexturePainter.h"
 #include <common/pluginmanager.h>
 
@@ -526,3 +527,327 @@ QImage TexturePainter::getTexture(glw::FramebufferHandle &fbh, glw::Texture2DHan
     delete [] texData;
     return tex;
 }
+
+
+
+
+
+
+// Bilinear lookup of a 32 bit image with the OpenGL conventions: p is in pixel units, texel
+// centers are at half integers, rows are counted from the bottom and the borders are clamped.
+static inline QRgb bilinearRgb( const QImage &img, const vcg::Point2f &p )
+{
+    const int w = img.width(), h = img.height();
+    const float fx = p.X() - 0.5f, fy = p.Y() - 0.5f;
+    const int x0 = (int) std::floor( fx ), y0 = (int) std::floor( fy );
+    const float ax = fx - x0, ay = fy - y0;
+    const int xa = std::max( 0, std::min(w-1,x0) ), xb = std::max( 0, std::min(w-1,x0+1) );
+    const int ya = std::max( 0, std::min(h-1,y0) ), yb = std::max( 0, std::min(h-1,y0+1) );
+
+    const QRgb *r0 = (const QRgb*) img.constScanLine( h-1-ya );
+    const QRgb *r1 = (const QRgb*) img.constScanLine( h-1-yb );
+    const QRgb c00 = r0[xa], c10 = r0[xb], c01 = r1[xa], c11 = r1[xb];
+
+    const float w00 = (1.0f-ax)*(1.0f-ay), w10 = ax*(1.0f-ay), w01 = (1.0f-ax)*ay, w11 = ax*ay;
+    return qRgba( int(w00*qRed  (c00) + w10*qRed  (c10) + w01*qRed  (c01) + w11*qRed  (c11) + 0.5f),
+                  int(w00*qGreen(c00) + w10*qGreen(c10) + w01*qGreen(c01) + w11*qGreen(c11) + 0.5f),
+                  int(w00*qBlue (c00) + w10*qBlue (c10) + w01*qBlue (c01) + w11*qBlue (c11) + 0.5f),
+                  255 );
+}
+
+
+void TexturePainter_CPU::paint( RasterPatchMap &patches )
+{
+    if( !isInitialized() )
+        return;
+
+    const int texSize = m_TexSize;
+    m_TexImg.assign( size_t(texSize)*texSize, qRgba(0,0,0,255) );
+
+
+    // Collects the patch quads in painting order. The rasters are read as 32 bit images, converted
+    // only when they have another format.
+    std::vector<QImage> images;
+    images.reserve( patches.size() );
+    std::vector<PatchQuad> quads;
+
+    for( RasterPatchMap::iterator rp=patches.begin(); rp!=patches.end(); ++rp )
+    {
+        const QImage &rmImg = rp.key()->currentPlane->image;
+        if( rmImg.format()==QImage::Format_RGB32 || rmImg.format()==QImage::Format_ARGB32 )
+            images.push_back( rmImg );
+        else
+            images.push_back( rmImg.convertToFormat(QImage::Format_RGB32) );
+
+        for( PatchVec::const_iterator p=rp->begin(); p!=rp->end(); ++p )
+        {
+            // The inverse of img2tex, that maps the texel centers back to the raster.
+            const float a = p->img2tex[0][0], b = p->img2tex[0][1], tu = p->img2tex[0][3];
+            const float c = p->img2tex[1][0], d = p->img2tex[1][1], tv = p->img2tex[1][3];
+            const float det = a*d - b*c;
+            if( det == 0.0f )
+                continue;
+
+            PatchQuad q;
+            q.patch  = &*p;
+            q.img    = &images.back();
+            q.origin = vcg::Point2f( -d*tu + b*tv, c*tu - a*tv ) / det;
+            q.axisU  = vcg::Point2f(  d, -c ) / (det*texSize);
+            q.axisV  = vcg::Point2f( -b,  a ) / (det*texSize);
+
+            vcg::Box2f texBox;
+            const vcg::Point2f boxCorners[4] = { p->bbox.min,
+                                                 vcg::Point2f( p->bbox.max.X(), p->bbox.min.Y() ),
+                                                 p->bbox.max,
+                                                 vcg::Point2f( p->bbox.min.X(), p->bbox.max.Y() ) };
+            for( int i=0; i<4; ++i )
+                texBox.Add( vcg::Point2f( a*boxCorners[i].X() + b*boxCorners[i].Y() + tu,
+                                          c*boxCorners[i].X() + d*boxCorners[i].Y() + tv ) * texSize );
+
+            q.x0 = std::max( 0, (int) std::floor(texBox.min.X()) );
+            q.y0 = std::max( 0, (int) std::floor(texBox.min.Y()) );
+            q.x1 = std::min( texSize-1, (int) std::ceil(texBox.max.X()) );
+            q.y1 = std::min( texSize-1, (int) std::ceil(texBox.max.Y()) );
+            if( q.x0 <= q.x1 && q.y0 <= q.y1 )
+                quads.push_back( q );
+        }
+    }
+
+
+    // Bins the quads on the tiles (counting sort on the tile, stable w.r.t. the painting order).
+    const int tilesX = (texSize + TILE_SIZE - 1) / TILE_SIZE;
+    const int tileNum = tilesX * tilesX;
+    std::vector<int> tileFirst( tileNum+1, 0 );
+    for( size_t i=0; i<quads.size(); ++i )
+        for( int ty=quads[i].y0/TILE_SIZE; ty<=quads[i].y1/TILE_SIZE; ++ty )
+            for( int tx=quads[i].x0/TILE_SIZE; tx<=quads[i].x1/TILE_SIZE; ++tx )
+                ++ tileFirst[ ty*tilesX + tx + 1 ];
+    for( int t=0; t<tileNum; ++t )
+        tileFirst[t+1] += tileFirst[t];
+
+    std::vector<int> tileQuad( tileFirst[tileNum] );
+    std::vector<int> next( tileFirst.begin(), tileFirst.end()-1 );
+    for( size_t i=0; i<quads.size(); ++i )
+        for( int ty=quads[i].y0/TILE_SIZE; ty<=quads[i].y1/TILE_SIZE; ++ty )
+            for( int tx=quads[i].x0/TILE_SIZE; tx<=quads[i].x1/TILE_SIZE; ++tx )
+                tileQuad[ next[ty*tilesX + tx]++ ] = (int) i;
+
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for( int t=0; t<tileNum; ++t )
+        paintTile( t, tilesX, quads, tileFirst, tileQuad );
+}
+
+
+void TexturePainter_CPU::paintTile( int t,
+                                    int tilesX,
+                                    const std::vector<PatchQuad> &quads,
+                                    const std::vector<int> &tileFirst,
+                                    const std::vector<int> &tileQuad )
+{
+    const int tx0 = (t % tilesX) * TILE_SIZE;
+    const int ty0 = (t / tilesX) * TILE_SIZE;
+    const int tx1 = std::min( m_TexSize, tx0 + TILE_SIZE ) - 1;
+    const int ty1 = std::min( m_TexSize, ty0 + TILE_SIZE ) - 1;
+
+    // Copies the raster area of each patch box, the texel centers being sampled as in the
+    // rasterization of the textured quads.
+    for( int j=tileFirst[t]; j<tileFirst[t+1]; ++j )
+    {
+        const PatchQuad &q = quads[ tileQuad[j] ];
+        const vcg::Box2f &box = q.patch->bbox;
+
+        for( int y=std::max(ty0,q.y0); y<=std::min(ty1,q.y1); ++y )
+        {
+            QRgb *row = &m_TexImg[ size_t(y)*m_TexSize ];
+            for( int x=std::max(tx0,q.x0); x<=std::min(tx1,q.x1); ++x )
+            {
+                const vcg::Point2f p = q.origin + q.axisU*(x+0.5f) + q.axisV*(y+0.5f);
+                if( p.X() >= box.min.X() && p.X() < box.max.X() &&
+                    p.Y() >= box.min.Y() && p.Y() < box.max.Y() )
+                    row[x] = bilinearRgb( *q.img, p );
+            }
+        }
+    }
+}
+
+
+vcg::Point3f TexturePainter_CPU::meanColor( const vcg::Point2f &texCoord,
+                                            int radius ) const
+{
+    const int x0 = (int) std::floor( texCoord.X()*m_TexSize );
+    const int y0 = (int) std::floor( texCoord.Y()*m_TexSize );
+
+    vcg::Point3f sum( 0.0f, 0.0f, 0.0f );
+    for( int y=y0-radius; y<=y0+radius; ++y )
+        for( int x=x0-radius; x<=x0+radius; ++x )
+        {
+            const QRgb c = m_TexImg[ size_t(std::max(0,std::min(m_TexSize-1,y)))*m_TexSize +
+                                            std::max(0,std::min(m_TexSize-1,x)) ];
+            sum += vcg::Point3f( qRed(c), qGreen(c), qBlue(c) );
+        }
+
+    const int diameter = 2*radius + 1;
+    return sum / (255.0f*diameter*diameter);
+}
+
+
+void TexturePainter_CPU::pushPullInit( RasterPatchMap &patches,
+                                       std::vector<Texel> &diffTex,
+                                       int filterSize ) const
+{
+    diffTex.assign( size_t(m_TexSize)*m_TexSize, Texel(0.0f,0.0f,0.0f,0.0f) );
+
+    std::vector<const Patch*> patchList;
+    for( RasterPatchMap::iterator rp=patches.begin(); rp!=patches.end(); ++rp )
+        for( PatchVec::const_iterator p=rp->begin(); p!=rp->end(); ++p )
+            patchList.push_back( &*p );
+
+
+    // At each vertex of the boundary faces, half the difference between the color of the patch on
+    // which the face lies and the one of the patch it borders. The differences are computed in
+    // parallel and written in order, so that the last one wins as for the OpenGL points.
+    std::vector< std::vector< std::pair<size_t,vcg::Point3f> > > points( patchList.size() );
+
+    #pragma omp parallel for schedule(dynamic)
+    for( int k=0; k<(int)patchList.size(); ++k )
+    {
+        const Patch &p = *patchList[k];
+        for( unsigned int n=0; n<p.boundary.size(); ++n )
+            for( int i=0; i<3; ++i )
+            {
+                const vcg::Point2f pos( p.boundaryUV[n].v[i].U(), p.boundaryUV[n].v[i].V() );
+                const vcg::Point2f own( p.boundary[n]->WT(i).U(), p.boundary[n]->WT(i).V() );
+                const int x = (int) std::floor( pos.X()*m_TexSize );
+                const int y = (int) std::floor( pos.Y()*m_TexSize );
+                if( x < 0 || y < 0 || x >= m_TexSize || y >= m_TexSize )
+                    continue;
+
+                const vcg::Point3f diff = (meanColor(own,filterSize) - meanColor(pos,filterSize)) * 0.5f;
+                points[k].push_back( std::make_pair( size_t(y)*m_TexSize + x, diff ) );
+            }
+    }
+
+    for( size_t k=0; k<points.size(); ++k )
+        for( size_t n=0; n<points[k].size(); ++n )
+        {
+            const vcg::Point3f &c = points[k][n].second;
+            diffTex[ points[k][n].first ] = Texel( c[0], c[1], c[2], 1.0f );
+        }
+}
+
+
+void TexturePainter_CPU::push( const std::vector<Texel> &higherLevel,
+                               int higherSize,
+                               std::vector<Texel> &lowerLevel,
+                               int lowerSize )
+{
+    lowerLevel.resize( size_t(lowerSize)*lowerSize );
+
+    #pragma omp parallel for schedule(static)
+    for( int y=0; y<lowerSize; ++y )
+        for( int x=0; x<lowerSize; ++x )
+        {
+            Texel avg( 0.0f, 0.0f, 0.0f, 0.0f );
+            for( int dy=0; dy<2; ++dy )
+                for( int dx=0; dx<2; ++dx )
+                    avg += higherLevel[ size_t(std::min(2*y+dy,higherSize-1))*higherSize + std::min(2*x+dx,higherSize-1) ];
+
+            if( avg[3] < 0.5f )
+                lowerLevel[ size_t(y)*lowerSize + x ] = Texel( 0.0f, 0.0f, 0.0f, 0.0f );
+            else
+                lowerLevel[ size_t(y)*lowerSize + x ] = Texel( avg[0]/avg[3], avg[1]/avg[3], avg[2]/avg[3], 1.0f );
+        }
+}
+
+
+void TexturePainter_CPU::pull( const std::vector<Texel> &lowerLevel,
+                               int lowerSize,
+                               std::vector<Texel> &higherLevel,
+                               int higherSize )
+{
+    // The empty texels of the higher level are filled with the bilinear interpolation of the lower one.
+    const float ratio = float(lowerSize) / higherSize;
+
+    #pragma omp parallel for schedule(static)
+    for( int y=0; y<higherSize; ++y )
+        for( int x=0; x<higherSize; ++x )
+        {
+            Texel &color = higherLevel[ size_t(y)*higherSize + x ];
+            if( color[3] >= 0.5f )
+                continue;
+
+            const float fx = (x+0.5f)*ratio - 0.5f, fy = (y+0.5f)*ratio - 0.5f;
+            const int x0 = (int) std::floor( fx ), y0 = (int) std::floor( fy );
+            const float ax = fx - x0, ay = fy - y0;
+            const int xa = std::max( 0, std::min(lowerSize-1,x0) ), xb = std::max( 0, std::min(lowerSize-1,x0+1) );
+            const int ya = std::max( 0, std::min(lowerSize-1,y0) ), yb = std::max( 0, std::min(lowerSize-1,y0+1) );
+
+            color = lowerLevel[ size_t(ya)*lowerSize + xa ] * ((1.0f-ax)*(1.0f-ay)) +
+                    lowerLevel[ size_t(ya)*lowerSize + xb ] * (ax*(1.0f-ay)) +
+                    lowerLevel[ size_t(yb)*lowerSize + xa ] * ((1.0f-ax)*ay) +
+                    lowerLevel[ size_t(yb)*lowerSize + xb ] * (ax*ay);
+        }
+}
+
+
+void TexturePainter_CPU::apply( const std::vector<Texel> &correction )
+{
+    #pragma omp parallel for schedule(static)
+    for( int y=0; y<m_TexSize; ++y )
+        for( int x=0; x<m_TexSize; ++x )
+        {
+            const size_t n = size_t(y)*m_TexSize + x;
+            const QRgb c = m_TexImg[n];
+            const Texel &corr = correction[n];
+            m_TexImg[n] = qRgba( int(255.0f*std::max(0.0f,std::min(1.0f,qRed  (c)/255.0f+corr[0])) + 0.5f),
+                                 int(255.0f*std::max(0.0f,std::min(1.0f,qGreen(c)/255.0f+corr[1])) + 0.5f),
+                                 int(255.0f*std::max(0.0f,std::min(1.0f,qBlue (c)/255.0f+corr[2])) + 0.5f),
+                                 255 );
+        }
+}
+
+
+void TexturePainter_CPU::rectifyColor( RasterPatchMap &patches, int filterSize )
+{
+    if( !isInitialized() || m_TexImg.empty() )
+        return;
+
+    std::vector< std::vector<Texel> > pushPullStack( 1 );
+    std::vector<int> levelSize( 1, m_TexSize );
+
+    pushPullInit( patches, pushPullStack[0], filterSize );
+
+
+    while( levelSize.back() > 1 )
+    {
+        const int newDim = (levelSize.back()/2) + (levelSize.back()&1);
+
+        pushPullStack.push_back( std::vector<Texel>() );
+        levelSize.push_back( newDim );
+        const size_t n = pushPullStack.size() - 1;
+        push( pushPullStack[n-1], levelSize[n-1], pushPullStack[n], levelSize[n] );
+    }
+
+
+    for( int i=(int)pushPullStack.size()-2; i>=0; --i )
+        pull( pushPullStack[i+1], levelSize[i+1], pushPullStack[i], levelSize[i] );
+
+
+    apply( pushPullStack[0] );
+}
+
+
+QImage TexturePainter_CPU::getTexture() const
+{
+    if( !isInitialized() || m_TexImg.empty() )
+        return QImage();
+
+    // The rows are stored bottom up.
+    QImage tex( m_TexSize, m_TexSize, QImage::Format_ARGB32 );
+    for( int y=0; y<m_TexSize; ++y )
+        std::copy( m_TexImg.begin() + size_t(m_TexSize-1-y)*m_TexSize,
+                   m_TexImg.begin() + size_t(m_TexSize-y)*m_TexSize,
+                   (QRgb*) tex.scanLine(y) );
+    return tex;
+}
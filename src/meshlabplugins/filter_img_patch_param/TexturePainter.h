@@ -29,6 +29,7 @@
 
 #include "Patch.h"
 #include <wrap/glw/glw.h>
+#include <vcg/space/point4.h>
 
 
 class TexturePainter
@@ -69,6 +70,67 @@ public:
 };
 
 
+/*
+TexturePainter_CPU
+The painting and the color correction of TexturePainter done without OpenGL, following its
+shaders. The texture is split in square tiles and the patches are binned on the tiles they
+overlap, in painting order; every tile is drawn by one thread, so where patches overlap the
+last one wins as in the OpenGL rendering. The push-pull pyramid is computed by rows in parallel.
+The texture rows are stored bottom up, as in OpenGL.
+*/
+class TexturePainter_CPU
+{
+protected:
+    static const int        TILE_SIZE = 64;
+
+    typedef vcg::Point4f    Texel;
+
+    struct PatchQuad
+    {
+        const Patch         *patch;
+        const QImage        *img;
+        vcg::Point2f        origin;     // image coords of the texture point (0,0)
+        vcg::Point2f        axisU;      // change of the image coords per texel along U
+        vcg::Point2f        axisV;      // ... and along V
+        int                 x0, y0, x1, y1;
+    };
+
+    int                     m_TexSize;
+    std::vector<QRgb>       m_TexImg;
+
+    void            paintTile( int t,
+                               int tilesX,
+                               const std::vector<PatchQuad> &quads,
+                               const std::vector<int> &tileFirst,
+                               const std::vector<int> &tileQuad );
+
+    vcg::Point3f    meanColor( const vcg::Point2f &texCoord,
+                               int radius ) const;
+    void            pushPullInit( RasterPatchMap &patches,
+                                  std::vector<Texel> &diffTex,
+                                  int filterSize ) const;
+    static void     push( const std::vector<Texel> &higherLevel,
+                          int higherSize,
+                          std::vector<Texel> &lowerLevel,
+                          int lowerSize );
+    static void     pull( const std::vector<Texel> &lowerLevel,
+                          int lowerSize,
+                          std::vector<Texel> &higherLevel,
+                          int higherSize );
+    void            apply( const std::vector<Texel> &correction );
+
+public:
+    inline          TexturePainter_CPU( int texSize ) : m_TexSize(texSize)  {}
+
+    void            paint( RasterPatchMap &patches );
+    void            rectifyColor( RasterPatchMap &patches,
+                                  int filterSize );
+    inline bool     isInitialized() const                           { return m_TexSize > 0; }
+
+    QImage          getTexture() const;
+};
+
+
 
 
 #endif // FILTER_IMG_PATCH_PARAM_PLUGIN__TEXTUREPAINTER_H
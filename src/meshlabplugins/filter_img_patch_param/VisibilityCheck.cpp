@@ -21,9 +21,13 @@
 *                                                                           *
 ****************************************************************************/
 #include <cmath>
+#include <algorithm>
 #include "VisibilityCheck.h"
 #include <wrap/gl/shot.h>
 #include <common/pluginmanager.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 
@@ -590,3 +594,88 @@ void VisibilityCheck_ShadowMap::checkVisibility()
 
     m_Context.unbindReadDrawFramebuffer();
 }
+
+
+
+
+
+
+VisibilityCheck_CPU::VisibilityCheck_CPU( CMeshO *mesh, int rasterCount ) : m_Mesh(mesh)
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    // A rasterizer stores depth, element and barycentric coords of each pixel: 16 bytes.
+    const size_t bufferBytes = size_t(MAX_BUFFER_SIZE) * MAX_BUFFER_SIZE * 16;
+    const int maxPool = int( (size_t(POOL_MEMORY_BUDGET) << 20) / bufferBytes );
+    const int poolSize = std::max( 1, std::min(std::min(threads,rasterCount),maxPool) );
+    m_Pool.resize( poolSize );
+    m_VertFlag.resize( poolSize );
+}
+
+
+void VisibilityCheck_CPU::checkRaster( const RasterModel *rm,
+                                       MeshRasterizer &rasterizer,
+                                       std::vector<unsigned char> &vertFlag ) const
+{
+    // Relative depth difference under which a vertex is considered on the rendered surface
+    // (the polygon offset of the OpenGL checks).
+    const float depthTolerance = 0.001f;
+
+    const Shotm &shot = rm->shot;
+    const vcg::Point2i &vp = shot.Intrinsics.ViewportPx;
+    const float scale = std::min( 1.0f, float(MAX_BUFFER_SIZE) / std::max(vp.X(),vp.Y()) );
+    const int w = std::max( 1, int(vp.X()*scale + 0.5f) );
+    const int h = std::max( 1, int(vp.Y()*scale + 0.5f) );
+    const float sx = float(w) / vp.X();
+    const float sy = float(h) / vp.Y();
+
+    rasterizer.render( *m_Mesh, shot, w, h );
+
+    const Point3m viewpoint = shot.GetViewPoint();
+    const int vn = (int) m_Mesh->vert.size();
+    vertFlag.resize( vn );
+
+    // Nested in the loop on the rasters this runs on one thread.
+    #pragma omp parallel for schedule(static)
+    for( int v=0; v<vn; ++v )
+    {
+        const CVertexO &vert = m_Mesh->vert[v];
+        vertFlag[v] = V_UNDEFINED;
+        if( vert.IsD() )
+            continue;
+
+        const Point3m c = shot.ConvertWorldToCameraCoordinates( vert.cP() );
+        if( (viewpoint-vert.cP()) * vert.cN() < 0.0f || c[2] <= 0.0f )
+        {
+            vertFlag[v] = V_BACKFACE;
+            continue;
+        }
+
+        const vcg::Point2<MESHLAB_SCALAR> pp = shot.Intrinsics.LocalToViewportPx( shot.Intrinsics.Project(c) );
+        const float x = float(pp[0]) * sx;
+        const float y = float(pp[1]) * sy;
+        if( !(x >= 0.0f && y >= 0.0f && x < w && y < h) )
+            continue;
+
+        // The vertex is compared with the farthest of the surfaces drawn in the pixels around it,
+        // at least one of which is usually covered by one of its faces.
+        const int x0 = std::max( 0, int(std::floor(x-0.5f)) ), x1 = std::min( w-1, int(std::floor(x+0.5f)) );
+        const int y0 = std::max( 0, int(std::floor(y-0.5f)) ), y1 = std::min( h-1, int(std::floor(y+0.5f)) );
+        const float zMax = std::max( std::max(rasterizer.depth(x0,y0), rasterizer.depth(x1,y0)),
+                                     std::max(rasterizer.depth(x0,y1), rasterizer.depth(x1,y1)) );
+
+        if( float(c[2]) <= zMax*(1.0f+depthTolerance) )
+            vertFlag[v] = V_VISIBLE;
+    }
+}
+
+
+void VisibilityCheck_CPU::checkVisibility( RasterModel * const *rasters, int n )
+{
+    // A single raster is rendered with all the threads of the rasterizer.
+    #pragma omp parallel for schedule(dynamic, 1) if(n > 1)
+    for( int i=0; i<n; ++i )
+        checkRaster( rasters[i], m_Pool[i], m_VertFlag[i] );
+}
@@ -28,6 +28,7 @@
 
 
 #include <common/ml_document/raster_model.h>
+#include <common/ml_document/mesh_rasterizer.h>
 #include <common/ml_shared_data_context.h>
 #include <wrap/glw/glw.h>
 
@@ -147,6 +148,52 @@ public:
 };
 
 
+/*
+VisibilityCheck_CPU
+The test of VisibilityCheck_ShadowMap done without OpenGL: the mesh is drawn into the depth
+buffer of a MeshRasterizer, and a vertex is visible if it faces the camera, it projects inside
+the image and it is not farther than the surface drawn around it.
+Several rasters are checked at once, one per thread. The rasterizers are a pool shared by the
+successive batches of rasters, so their buffers are allocated only once; the pool is bounded by
+the memory its buffers may take at the maximum size.
+*/
+class VisibilityCheck_CPU
+{
+private:
+    enum VMarker
+    {
+        V_UNDEFINED ,
+        V_BACKFACE  ,
+        V_VISIBLE   ,
+    };
+
+    // longest side of the depth buffers, larger rasters are checked at a lower resolution
+    static const int        MAX_BUFFER_SIZE = 2048;
+    // memory available to the buffers of the pool, in MB
+    static const int        POOL_MEMORY_BUDGET = 256;
+
+    CMeshO                                      *m_Mesh;
+    std::vector<MeshRasterizer>                 m_Pool;
+    std::vector< std::vector<unsigned char> >   m_VertFlag;
+
+    void        checkRaster( const RasterModel *rm,
+                             MeshRasterizer &rasterizer,
+                             std::vector<unsigned char> &vertFlag ) const;
+
+public:
+                VisibilityCheck_CPU( CMeshO *mesh, int rasterCount );
+
+    // number of rasters checked by a call to checkVisibility()
+    inline int  batchSize() const                                                   { return (int) m_Pool.size(); }
+    // checks rasters[0] ... rasters[n-1], with n <= batchSize(); the result of rasters[i] is in the slot i
+    void        checkVisibility( RasterModel * const *rasters, int n );
+
+    inline bool isVertVisible( int slot, const unsigned int n ) const               { return m_VertFlag[slot][n]==V_VISIBLE; }
+    inline bool isVertVisible( int slot, const CVertexO *v ) const                  { return isVertVisible( slot, v - &m_Mesh->vert[0] ); }
+    inline bool isFaceVisible( int slot, const CFaceO *f ) const                    { return isVertVisible(slot,f->cV(0)) || isVertVisible(slot,f->cV(1)) || isVertVisible(slot,f->cV(2)); }
+};
+
+
 
 
 #endif // FILTER_IMG_PATCH_PARAM_PLUGIN__VISIBILITYCHECK_H
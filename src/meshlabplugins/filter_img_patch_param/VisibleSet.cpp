@@ -25,23 +25,19 @@
 #include "VisibilityCheck.h"
 #include <wrap/gl/shot.h>
 #include <cmath>
+#include <algorithm>
 
 
 
 
-VisibleSet::VisibleSet( glw::Context &ctx,MLPluginGLContext* plugctx,int meshid,
+VisibleSet::VisibleSet( glw::Context *ctx,MLPluginGLContext* plugctx,int meshid,
                         CMeshO &mesh,
                         QList<RasterModel*> &rasterList,
                         int weightMask ) :
     m_Mesh(mesh),
-    m_FaceVis(mesh.fn),
+    m_FaceVis(mesh.face.size()),
     m_WeightMask(weightMask)
 {
-    VisibilityCheck &visibility = *VisibilityCheck::GetInstance( ctx );
-    visibility.setMesh(meshid,&mesh );
-    visibility.m_plugcontext = plugctx;
-
-
     float depthMin =  std::numeric_limits<float>::max();
     m_DepthMax = -std::numeric_limits<float>::max();
 
@@ -64,6 +60,20 @@ VisibleSet::VisibleSet( glw::Context &ctx,MLPluginGLContext* plugctx,int meshid,
     m_DepthRangeInv = 1.0f / (m_DepthMax-depthMin);
 
 
+    if( ctx )
+        checkVisibilityGL( *ctx, plugctx, meshid, mesh, rasterList );
+    else
+        checkVisibilityCPU( mesh, rasterList );
+}
+
+
+void VisibleSet::checkVisibilityGL( glw::Context &ctx, MLPluginGLContext* plugctx, int meshid,
+                                    CMeshO &mesh, QList<RasterModel*> &rasterList )
+{
+    VisibilityCheck &visibility = *VisibilityCheck::GetInstance( ctx );
+    visibility.setMesh(meshid,&mesh );
+    visibility.m_plugcontext = plugctx;
+
     foreach( RasterModel *rm, rasterList )
     {
         visibility.setRaster( rm );
@@ -82,6 +92,31 @@ VisibleSet::VisibleSet( glw::Context &ctx,MLPluginGLContext* plugctx,int meshid,
 }
 
 
+void VisibleSet::checkVisibilityCPU( CMeshO &mesh, QList<RasterModel*> &rasterList )
+{
+    std::vector<RasterModel*> rasters( rasterList.begin(), rasterList.end() );
+    VisibilityCheck_CPU visibility( &mesh, (int) rasters.size() );
+
+    for( size_t first=0; first<rasters.size(); first+=visibility.batchSize() )
+    {
+        const int n = std::min( visibility.batchSize(), int(rasters.size()-first) );
+        visibility.checkVisibility( &rasters[first], n );
+
+        // Each face receives the rasters of the batch in order, as in the OpenGL loop.
+        #pragma omp parallel for schedule(static)
+        for( int f=0; f<(int)mesh.face.size(); ++f )
+            if( !mesh.face[f].IsD() )
+                for( int i=0; i<n; ++i )
+                    if( visibility.isFaceVisible(i,&mesh.face[f]) )
+                    {
+                        float w = getWeight( rasters[first+i], mesh.face[f] );
+                        if( w >= 0.0f )
+                            m_FaceVis[f].add( w, rasters[first+i] );
+                    }
+    }
+}
+
+
 float VisibleSet::getWeight( const RasterModel *rm, CFaceO &f )
 {
     Point3m centroid = (f.V(0)->P() +
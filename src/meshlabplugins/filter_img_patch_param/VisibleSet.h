@@ -78,8 +78,13 @@ private:
 
     inline int          id( const CFaceO& f ) const                         { return &f - &m_Mesh.face[0]; }
 
+    void                checkVisibilityGL( glw::Context &ctx, MLPluginGLContext* plugctx, int meshid,
+                                           CMeshO &mesh, QList<RasterModel*> &rasterList );
+    void                checkVisibilityCPU( CMeshO &mesh, QList<RasterModel*> &rasterList );
+
 public:
-    VisibleSet( glw::Context &ctx,MLPluginGLContext* plugctx,int meshid,
+    // Without an OpenGL context (ctx NULL) the visibility is computed on the CPU.
+    VisibleSet( glw::Context *ctx,MLPluginGLContext* plugctx,int meshid,
                 CMeshO &mesh,
                 QList<RasterModel*> &rasterList,
                 int weightMask );
@@ -30,6 +30,7 @@
 #include "VisibilityCheck.h"
 #include "TexturePainter.h"
 #include <cmath>
+#include <algorithm>
 
 
 
@@ -176,6 +177,10 @@ void FilterImgPatchParamPlugin::initParameterList(const QAction *act,
 							   4,
 							   "Texture gutter",
 							   "Extra boundary to add to each patch before packing in texture space (in pixels)" ) );
+		par.addParam( RichBool( "cpuRendering",
+								false,
+								"CPU rendering",
+								"If true, the visibility from the rasters and the texture are computed on the CPU, processing several rasters at once, instead of with OpenGL. The same happens when no OpenGL context is available" ) );
 		break;
 	}
 	case FP_RASTER_VERT_COVERAGE:
@@ -185,6 +190,10 @@ void FilterImgPatchParamPlugin::initParameterList(const QAction *act,
 								false,
 								"Normalize",
 								"Rescale quality values to the range [0,1]" ) );
+		par.addParam( RichBool( "cpuRendering",
+								false,
+								"CPU rendering",
+								"If true, the visibility from the rasters is computed on the CPU, processing several rasters at once, instead of with OpenGL. The same happens when no OpenGL context is available" ) );
 		break;
 	}
 	}
@@ -201,25 +210,36 @@ bool FilterImgPatchParamPlugin::applyFilter(
 {
 	
 	
-	glContext->makeCurrent();
-	if( !GLExtensionsManager::initializeGLextensions_notThrowing() )
-	{
-		this->errorMessage="Failed GLEW initialization";
-		return false;
-	}
-	
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	
+	// Without a working OpenGL context everything is done on the CPU; in that case m_Context is NULL.
 	delete m_Context;
-	m_Context = new glw::Context();
-	m_Context->acquire();
+	m_Context = NULL;
 	
-	if( !VisibilityCheck::GetInstance(*m_Context) )
+	bool useGL = !par.getBool("cpuRendering") && glContext!=NULL && glContext->isValid();
+	if( useGL )
 	{
-		this->errorMessage="VisibilityCheck failed";
-		return false;
+		glContext->makeCurrent();
+		useGL = GLExtensionsManager::initializeGLextensions_notThrowing();
+		if( useGL )
+		{
+			glPushAttrib(GL_ALL_ATTRIB_BITS);
+			
+			m_Context = new glw::Context();
+			m_Context->acquire();
+			
+			useGL = VisibilityCheck::GetInstance(*m_Context) != NULL;
+			VisibilityCheck::ReleaseInstance();
+			if( !useGL )
+			{
+				delete m_Context;
+				m_Context = NULL;
+				glPopAttrib();
+			}
+		}
+		if( !useGL )
+			glContext->doneCurrent();
 	}
-	VisibilityCheck::ReleaseInstance();
+	if( !useGL )
+		log( GLLogStream::SYSTEM, "The rasters are processed on the CPU" );
 	
 	
 	bool retValue = true;
@@ -239,7 +259,8 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	if( activeRasters.empty() )    {
 		this->errorMessage="No active Raster";
 		{
-			glContext->doneCurrent();
+			if( useGL )
+				glContext->doneCurrent();
 			errorMessage = "You need to have at least one valid raster layer in your project, to apply this filter"; // text
 			return false;
 		}
@@ -251,7 +272,8 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	{
 		if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0)
 		{
-			glContext->doneCurrent();
+			if( useGL )
+				glContext->doneCurrent();
 			errorMessage = "Mesh has some not 2-manifold faces, this filter requires manifoldness"; // text
 			return false; // can't continue, mesh can't be processed
 		}
@@ -259,7 +281,8 @@ bool FilterImgPatchParamPlugin::applyFilter(
 		vcg::tri::Allocator<CMeshO>::CompactVertexVector(md.mm()->cm);
 		vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
 		vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
-		glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
+		if( useGL )
+			glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
 		RasterPatchMap patches;
 		PatchVec nullPatches;
 		patchBasedTextureParameterization( patches,
@@ -275,14 +298,16 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	{
 		if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0)
 		{
-			glContext->doneCurrent();
+			if( useGL )
+				glContext->doneCurrent();
 			errorMessage = "Mesh has some not 2-manifold faces, this filter requires manifoldness"; // text
 			return false; // can't continue, mesh can't be processed
 		}
 		vcg::tri::Allocator<CMeshO>::CompactEveryVector(md.mm()->cm);
 		vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
 		vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
-		glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
+		if( useGL )
+			glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
 		QString texName = par.getString( "textureName" ).simplified();
 		int pathEnd = std::max( texName.lastIndexOf('/'), texName.lastIndexOf('\\') );
 		if( pathEnd != -1 )
@@ -299,16 +324,35 @@ bool FilterImgPatchParamPlugin::applyFilter(
 											   activeRasters,
 											   par );
 			
-			TexturePainter painter( *m_Context, par.getInt("textureSize") );
-			if( (retValue = painter.isInitialized()) )
+			QElapsedTimer t; t.start();
+			QImage tex;
+			if( useGL )
+			{
+				TexturePainter painter( *m_Context, par.getInt("textureSize") );
+				if( (retValue = painter.isInitialized()) )
+				{
+					painter.paint( patches );
+					if( par.getBool("colorCorrection") )
+						painter.rectifyColor( patches, par.getInt("colorCorrectionFilterSize") );
+					tex = painter.getTexture();
+				}
+			}
+			else
+			{
+				TexturePainter_CPU painter( par.getInt("textureSize") );
+				if( (retValue = painter.isInitialized()) )
+				{
+					painter.paint( patches );
+					if( par.getBool("colorCorrection") )
+						painter.rectifyColor( patches, par.getInt("colorCorrectionFilterSize") );
+					tex = painter.getTexture();
+				}
+			}
+			
+			if( retValue )
 			{
-				QElapsedTimer t; t.start();
-				painter.paint( patches );
-				if( par.getBool("colorCorrection") )
-					painter.rectifyColor( patches, par.getInt("colorCorrectionFilterSize") );
 				log( "TEXTURE PAINTING: %.3f sec.", 0.001f*t.elapsed() );
 				
-				QImage tex = painter.getTexture();
 				if( tex.save(texName) )
 				{
 					mesh.textures.clear();
@@ -321,19 +365,40 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	}
 	case FP_RASTER_VERT_COVERAGE:
 	{
-		VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
-		visibility.setMesh(md.mm()->id(),&mesh );
-		visibility.m_plugcontext = glContext;
 		for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
 			vi->Q() = 0.0f;
 		
-		foreach( RasterModel *rm, activeRasters )
+		if( useGL )
 		{
-			visibility.setRaster( rm );
-			visibility.checkVisibility();
-			for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
-				if( visibility.isVertVisible(vi) )
-					vi->Q() += 1.0f;
+			VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
+			visibility.setMesh(md.mm()->id(),&mesh );
+			visibility.m_plugcontext = glContext;
+			
+			foreach( RasterModel *rm, activeRasters )
+			{
+				visibility.setRaster( rm );
+				visibility.checkVisibility();
+				for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
+					if( visibility.isVertVisible(vi) )
+						vi->Q() += 1.0f;
+			}
+		}
+		else
+		{
+			std::vector<RasterModel*> rasters( activeRasters.begin(), activeRasters.end() );
+			VisibilityCheck_CPU visibility( &mesh, (int) rasters.size() );
+			
+			for( size_t first=0; first<rasters.size(); first+=visibility.batchSize() )
+			{
+				const int n = std::min( visibility.batchSize(), int(rasters.size()-first) );
+				visibility.checkVisibility( &rasters[first], n );
+				
+				#pragma omp parallel for schedule(static)
+				for( int v=0; v<(int)mesh.vert.size(); ++v )
+					for( int i=0; i<n; ++i )
+						if( visibility.isVertVisible(i,v) )
+							mesh.vert[v].Q() += 1.0f;
+			}
 		}
 		
 		if( par.getBool("normalizeQuality") )
@@ -347,20 +412,41 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	}
 	case FP_RASTER_FACE_COVERAGE:
 	{
-		VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
-		visibility.setMesh(md.mm()->id(),&mesh );
-		visibility.m_plugcontext = glContext;
-		
 		for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
 			fi->Q() = 0.0f;
 		
-		foreach( RasterModel *rm, activeRasters )
+		if( useGL )
 		{
-			visibility.setRaster( rm );
-			visibility.checkVisibility();
-			for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
-				if( visibility.isFaceVisible(fi) )
-					fi->Q() += 1.0f;
+			VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
+			visibility.setMesh(md.mm()->id(),&mesh );
+			visibility.m_plugcontext = glContext;
+			
+			foreach( RasterModel *rm, activeRasters )
+			{
+				visibility.setRaster( rm );
+				visibility.checkVisibility();
+				for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
+					if( visibility.isFaceVisible(fi) )
+						fi->Q() += 1.0f;
+			}
+		}
+		else
+		{
+			std::vector<RasterModel*> rasters( activeRasters.begin(), activeRasters.end() );
+			VisibilityCheck_CPU visibility( &mesh, (int) rasters.size() );
+			
+			for( size_t first=0; first<rasters.size(); first+=visibility.batchSize() )
+			{
+				const int n = std::min( visibility.batchSize(), int(rasters.size()-first) );
+				visibility.checkVisibility( &rasters[first], n );
+				
+				#pragma omp parallel for schedule(static)
+				for( int f=0; f<(int)mesh.face.size(); ++f )
+					if( !mesh.face[f].IsD() )
+						for( int i=0; i<n; ++i )
+							if( visibility.isFaceVisible(i,&mesh.face[f]) )
+								mesh.face[f].Q() += 1.0f;
+			}
 		}
 		
 		if( par.getBool("normalizeQuality") )
@@ -387,8 +473,11 @@ bool FilterImgPatchParamPlugin::applyFilter(
 	delete m_Context;
 	m_Context = NULL;
 	
-	glPopAttrib();
-	glContext->doneCurrent();
+	if( useGL )
+	{
+		glPopAttrib();
+		glContext->doneCurrent();
+	}
 	
 	
 	return retValue;
@@ -663,6 +752,10 @@ int FilterImgPatchParamPlugin::extractPatches( RasterPatchMap &patches,
 void FilterImgPatchParamPlugin::constructPatchBoundary( Patch &p,
 														VisibleSet &faceVis )
 {
+	// The faces already added are kept in a set instead of being marked with the face flags,
+	// so that many patches can be extended at once.
+	NeighbSet added;
+	
 	for( std::vector<CFaceO*>::iterator f=p.faces.begin(); f!=p.faces.end(); ++f )
 	{
 		RasterModel *fRef = faceVis[*f].ref();
@@ -677,19 +770,13 @@ void FilterImgPatchParamPlugin::constructPatchBoundary( Patch &p,
 				getNeighbors( pos.V(), neighb );
 				getNeighbors( pos.VFlip(), neighb );
 				for( NeighbSet::iterator n=neighb.begin(); n!=neighb.end(); ++n )
-					if( !(*n)->IsV() && faceVis[*n].ref()!=fRef && faceVis[*n].contains(fRef))
-					{
+					if( faceVis[*n].ref()!=fRef && faceVis[*n].contains(fRef) && added.insert(*n).second )
 						p.boundary.push_back( *n );
-						(*n)->SetV();
-					}
 			}
 			pos.FlipV();
 			pos.FlipE();
 		}
 	}
-	
-	for( std::vector<CFaceO*>::iterator f=p.boundary.begin(); f!=p.boundary.end(); ++f )
-		(*f)->ClearV();
 }
 
 
@@ -728,8 +815,14 @@ void FilterImgPatchParamPlugin::computePatchUV( CMeshO &mesh,
 	// Computes the full transform that goes from the mesh local space to the camera clipping space.
 	Matrix44m mesh2clip = cam2clip * camProj * rm->shot.GetWorldToExtrinsicsMatrix();
 	
-	for( PatchVec::iterator p=patches.begin(); p!=patches.end(); ++p )
+	// Each face belongs to a single patch, so the patches are processed in parallel.
+	Patch *patchData = patches.data();
+	
+	#pragma omp parallel for schedule(dynamic)
+	for( int n=0; n<patches.size(); ++n )
 	{
+		Patch *p = patchData + n;
+		
 		// Resets the UV bounding box of the patch, and allocate the array containing the UV coordinates
 		// for the boundary faces.
 		p->bbox.SetNull();
@@ -918,7 +1011,7 @@ void FilterImgPatchParamPlugin::patchBasedTextureParameterization( RasterPatchMa
 		weightMask |= VisibleSet::W_IMG_BORDER;
 	if( par.getBool("useAlphaWeight") )
 		weightMask |= VisibleSet::W_IMG_ALPHA;
-	VisibleSet faceVis( *m_Context,glContext,meshid, mesh, rasterList, weightMask );
+	VisibleSet faceVis( m_Context,glContext,meshid, mesh, rasterList, weightMask );
 	log( "VISIBILITY CHECK: %.3f sec.", 0.001f*t.elapsed() );
 	
 	
@@ -950,9 +1043,18 @@ void FilterImgPatchParamPlugin::patchBasedTextureParameterization( RasterPatchMa
 	// Extends each patch so as to include faces that belong to the other side of its boundary.
 	t.start();
 	oldArea = computeTotalPatchArea( patches );
+	std::vector<Patch*> patchList;
+	std::vector<PatchVec*> rasterPatches;
 	for( RasterPatchMap::iterator rp=patches.begin(); rp!=patches.end(); ++rp )
+	{
+		rasterPatches.push_back( &rp.value() );
 		for( PatchVec::iterator p=rp->begin(); p!=rp->end(); ++p )
-			constructPatchBoundary( *p, faceVis );
+			patchList.push_back( &*p );
+	}
+	
+	#pragma omp parallel for schedule(dynamic)
+	for( int i=0; i<(int)patchList.size(); ++i )
+		constructPatchBoundary( *patchList[i], faceVis );
 	log( "PATCH EXTENSION: %.3f sec.", 0.001f*t.elapsed() );
 	
 	
@@ -968,8 +1070,9 @@ void FilterImgPatchParamPlugin::patchBasedTextureParameterization( RasterPatchMa
 	// Merge patches so as to reduce the occupied texture area when their bounding boxes overlap.
 	t.start();
 	oldArea = computeTotalPatchArea( patches );
-	for( RasterPatchMap::iterator rp=patches.begin(); rp!=patches.end(); ++rp )
-		mergeOverlappingPatches( *rp );
+	#pragma omp parallel for schedule(dynamic, 1)
+	for( int i=0; i<(int)rasterPatches.size(); ++i )
+		mergeOverlappingPatches( *rasterPatches[i] );
 	log( "PATCH MERGING: %.3f sec.", 0.001f*t.elapsed() );
 	log( "  * Area reduction: %.1f%%.", 100.0f*computeTotalPatchArea(patches)/oldArea );
 	log( "  * Patches number reduced from %i to %i.", nbPatches, computePatchCount(patches) );
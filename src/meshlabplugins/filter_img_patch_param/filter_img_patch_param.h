@@ -121,6 +121,7 @@ public:
 			vcg::CallBackPos *cb );
 
     FILTER_ARITY filterArity(const QAction *) const {return SINGLE_MESH;}
+    bool requiresGLContext(const QAction *) const {return false;}
 };
 
 
@@ -401,8 +401,14 @@ public:
     {
 
 
-        //Ord_HVert[index]
-        for (unsigned int i=0;i<HRES_meshes.size();i++)
+        ///the sub meshes are independent copies, so they are optimized in parallel;
+        ///the new fathers are stored and assigned afterwards in the order of the meshes
+        int num=HRES_meshes.size();
+        std::vector<std::vector<std::pair<FaceType*,CoordType> > > newFathers(num);
+#ifdef _USE_OMP
+        #pragma omp parallel for schedule(dynamic,1)
+#endif
+        for (int i=0;i<num;i++)
         {
 
             MeshType *currMesh=HRES_meshes[i];
@@ -485,10 +491,10 @@ public:
                         }
                     }
                     //reassing fathers and bary coordinates
+                    newFathers[i].resize(currMesh->vert.size());
                     for (unsigned int j=0;j<currMesh->vert.size();j++)
                     {
                         VertexType *ParamVert=&currMesh->vert[j];
-                        VertexType *OrigVert=Ord_HVert[i][j];
                         ScalarType u=ParamVert->T().U();
                         ScalarType v=ParamVert->T().V();
                         ///then get face falling into and estimate (alpha,beta,gamma)
@@ -519,13 +525,20 @@ public:
                         assert(inside);
                         //OrigVert->father=chosen;
                         //OrigVert->Bary=bary;
-                        AssingFather(*OrigVert,chosen,bary,*domain);
+                        newFathers[i][j]=std::pair<FaceType*,CoordType>(chosen,bary);
                     }
             }
             ///delete current mesh
             delete(HRES_meshes[i]);
         }
 
+        for (int i=0;i<num;i++)
+            for (unsigned int j=0;j<newFathers[i].size();j++)
+            {
+                VertexType *OrigVert=Ord_HVert[i][j];
+                AssingFather(*OrigVert,newFathers[i][j].first,newFathers[i][j].second,*domain);
+            }
+
         ///clear father and bary
         for (unsigned int i=0;i<domain->face.size();i++)
             domain->face[i].vertices_bary.clear();
@@ -1,6 +1,7 @@
 #ifndef _LOCAL_OPTIMIZATION
 #define _LOCAL_OPTIMIZATION
 
+#include <algorithm>
 #include "statistics.h"
 
 enum EnergyType{EN_EXTMips,EN_MeanVal};
@@ -63,18 +64,20 @@ typename MeshType::ScalarType StarDistorsion(typename MeshType::VertexType *v)
 	typedef typename MeshType::CoordType CoordType;
 	typedef typename MeshType::ScalarType ScalarType;
 
+	typedef std::pair<VertexType*,vcg::Point2<ScalarType> > VertUV;
+
 	std::vector<VertexType*> starCenter;
 	starCenter.push_back(v);
 	std::vector<FaceType*> ordered_faces;
-	std::vector<VertexType*> HresVert;
+	std::vector<VertUV> HresUV;
 	MeshType star_domain,hlev_mesh;
 
 	///create star
 	CreateMeshVertexStar(starCenter,ordered_faces,star_domain);
 	ParametrizeStarEquilateral<MeshType>(star_domain);
 
-	///get all the vertices in H definition that should be optimized
-	///and initialize vertices with u,v coordinates
+	///get all the vertices in H definition
+	///and their u,v coordinates
 	for (unsigned int index=0;index<ordered_faces.size();index++)
 	{
 		FaceType *parametric_face=&star_domain.face[index];
@@ -88,17 +91,24 @@ typename MeshType::ScalarType StarDistorsion(typename MeshType::VertexType *v)
 			ScalarType u,v;
       InterpolateUV<MeshType>(parametric_face,bary,u,v);
 			
-			VertexType* to_parametrize=test_face->vertices_bary[i].first;
-			to_parametrize->T().U()=u;
-			to_parametrize->T().V()=v;
-		
-			HresVert.push_back(to_parametrize);
+			HresUV.push_back(VertUV(test_face->vertices_bary[i].first,vcg::Point2<ScalarType>(u,v)));
 		}
 	}
+	auto byVertex=[](const VertUV &a,const VertUV &b){return a.first<b.first;};
+	std::sort(HresUV.begin(),HresUV.end(),byVertex);
 
-	///get a copy of submesh
+	///get a copy of submesh, then parametrize the copy: the original vertices
+	///are only read, so that the stars can be measured in parallel
 	std::vector<typename MeshType::VertexType*> ordered_vertex;
 	CopyHlevMesh(ordered_faces,hlev_mesh,ordered_vertex);
+	for (unsigned int i=0;i<hlev_mesh.vert.size();i++)
+	{
+		typename std::vector<VertUV>::iterator ite=std::lower_bound(HresUV.begin(),HresUV.end(),
+			VertUV(ordered_vertex[i],vcg::Point2<ScalarType>(0,0)),byVertex);
+		assert((ite!=HresUV.end())&&(ite->first==ordered_vertex[i]));
+		hlev_mesh.vert[i].T().U()=ite->second.X();
+		hlev_mesh.vert[i].T().V()=ite->second.Y();
+	}
 	UpdateTopologies<MeshType>(&hlev_mesh);
         ScalarType val0=ApproxAreaDistortion<MeshType>(hlev_mesh,star_domain.fn);
         ScalarType val1=ApproxAngleDistortion<MeshType>(hlev_mesh);
@@ -233,31 +233,49 @@ public:
 		ScalarType &varianceL,
 		ScalarType &varianceA)
 	{
-                typename MeshType::FaceIterator Fi;
-		varianceA=0;
-		varianceL=0;
-		int num_edge=0;
-		for (Fi=base_mesh.face.begin();Fi!=base_mesh.face.end();Fi++)
+		///the terms of each face are computed in parallel
+		///and then summed in face order
+		int nf=base_mesh.face.size();
+		std::vector<ScalarType> faceVarA(nf),edgeVarL(3*nf);
+		std::vector<char> isEdge(3*nf);
+#ifdef _USE_OMP
+		#pragma omp parallel for schedule(dynamic,64)
+#endif
+		for (int f=0;f<nf;f++)
 		{
-			ScalarType area=EstimateAreaByParam<FaceType>(&(*Fi));
-			varianceA+=pow((area-averageArea),(ScalarType)2.0);
+			FaceType *Fi=&base_mesh.face[f];
+			ScalarType area=EstimateAreaByParam<FaceType>(Fi);
+			faceVarA[f]=pow((area-averageArea),(ScalarType)2.0);
 			for (int i=0;i<3;i++)
 			{
-				VertexType *v0=(*Fi).V(i);
-				VertexType *v1=(*Fi).V((i+1)%3);
+				VertexType *v0=Fi->V(i);
+				VertexType *v1=Fi->V((i+1)%3);
 				/*	std::vector<FaceType*> on_edge,faces1,faces2;
 				getSharedFace<MeshType>(v0,v1,on_edge,faces1,faces2);
 				FaceType* edgeF[2];
 				edgeF[0]=on_edge[0];
 				edgeF[1]=on_edge[1];*/
+				isEdge[3*f+i]=(v0>v1);
 				if (v0>v1)
 				{
 					ScalarType length=LengthPath(v0,v1);//EstimateLengthByParam<FaceType>(v0,v1,edgeF);
-					varianceL+=pow((length-averageLength),(ScalarType)2);
-					num_edge++;
+					edgeVarL[3*f+i]=pow((length-averageLength),(ScalarType)2);
 				}
 			}
 		}
+		varianceA=0;
+		varianceL=0;
+		int num_edge=0;
+		for (int f=0;f<nf;f++)
+		{
+			varianceA+=faceVarA[f];
+			for (int i=0;i<3;i++)
+				if (isEdge[3*f+i])
+				{
+					varianceL+=edgeVarL[3*f+i];
+					num_edge++;
+				}
+		}
 		varianceL=sqrt(varianceL/(ScalarType)num_edge);
 		varianceA=sqrt(varianceA/(ScalarType)base_mesh.fn);
 	}
@@ -365,6 +383,9 @@ public:
 		delete[] p;
 	}
 
+	///max number of stars looked at to fill a parallel batch
+	enum { BATCH_LOOKAHEAD = 64 };
+
   struct Elem
 	{
 	public:
@@ -393,6 +414,13 @@ public:
   void Execute(VertexType *center)
 	{
 		OptimizeUV(center,base_mesh);
+		PushNeighbors(center);
+	}
+
+	///update the marks of the neighbors of an optimized star
+	///and push them back to the heap with their new priority
+	void PushNeighbors(VertexType *center)
+	{
 		std::vector<typename MeshType::VertexType*> neigh;
 		getVertexStar<MeshType>(center,neigh);
 
@@ -446,21 +474,63 @@ void OptimizePatches()
 		ScalarType varianceL1;
 		ScalarType varianceA1;
 		bool continue_opt=true;
+		std::vector<VertexType*> batch;
+		std::vector<Elem> deferred;
+		vcg::SimpleTempData<typename MeshType::VertContainer,int> batched(base_mesh.vert,0);
+		int batch_mark=0;
 		while (continue_opt)
 		{
 			int temp_oper=0;
-			while (temp_oper<20)
+			while ((temp_oper<20)&&(!Operations.empty()))
 			{
-				std::pop_heap(Operations.begin(),Operations.end());
-				VertexType* oper=Operations.back().center;
-				int t_mark=Operations.back().t_mark;
-				Operations.pop_back();
-				if (markers[oper]<=t_mark)
+				///pick the best stars whose closed neighborhoods do not overlap:
+				///the optimization of a star writes the UV of its ring too
+				batch.clear();
+				deferred.clear();
+				batch_mark++;
+				int lookahead=0;
+				while ((temp_oper+(int)batch.size()<20)&&(lookahead<BATCH_LOOKAHEAD)&&(!Operations.empty()))
+				{
+					std::pop_heap(Operations.begin(),Operations.end());
+					Elem e=Operations.back();
+					Operations.pop_back();
+					if (markers[e.center]>e.t_mark)
+						continue;
+					lookahead++;
+					std::vector<VertexType*> star;
+					getVertexStar<MeshType>(e.center,star);
+					star.push_back(e.center);
+					bool overlap=false;
+					for (unsigned int i=0;i<star.size();i++)
+						overlap|=(batched[star[i]]==batch_mark);
+					if (overlap)
+					{
+						deferred.push_back(e);
+						continue;
+					}
+					for (unsigned int i=0;i<star.size();i++)
+						batched[star[i]]=batch_mark;
+					batch.push_back(e.center);
+				}
+
+				///optimize them in parallel
+				int num=batch.size();
+#ifdef _USE_OMP
+				#pragma omp parallel for schedule(dynamic,1)
+#endif
+				for (int i=0;i<num;i++)
+					OptimizeUV(batch[i],base_mesh);
+
+				///then update the heap in the order they were picked
+				for (int i=0;i<num;i++)
+					PushNeighbors(batch[i]);
+				for (unsigned int i=0;i<deferred.size();i++)
 				{
-					Execute(oper);
-					n_oper++;
-					temp_oper++;
+					Operations.push_back(deferred[i]);
+					std::push_heap(Operations.begin(),Operations.end());
 				}
+				n_oper+=num;
+				temp_oper+=num;
 			}
 			FindVarianceLenghtArea(base_mesh,averageLength,averageArea,varianceL1,varianceA1);
 			ScalarType percL=(varianceL0-varianceL1)*100/averageLength;
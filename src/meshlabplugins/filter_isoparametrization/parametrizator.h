@@ -350,22 +350,69 @@ private:
         (*cb)(0,ret);
 
         std::vector<vert_para> ord_vertex;
-        ord_vertex.resize(base_mesh.vn);
+        ord_vertex.reserve(base_mesh.vn);
         for (unsigned int i=0;i<base_mesh.vert.size();i++)
             if (!base_mesh.vert[i].IsD())
             {
-                BaseVertex *v=&base_mesh.vert[i];
-                ScalarType val=StarDistorsion<BaseMesh>(&base_mesh.vert[i]);
-                //printf("i: %d\n",i);
-                ord_vertex[i].dist=val;
-                ord_vertex[i].v=v;
+                vert_para vp;
+                vp.dist=0;
+                vp.v=&base_mesh.vert[i];
+                ord_vertex.push_back(vp);
             }
 
+        ///the distortion is measured on a copy of each star
+        int num=ord_vertex.size();
+#ifdef _USE_OMP
+        #pragma omp parallel for schedule(dynamic,1)
+#endif
+        for (int i=0;i<num;i++)
+            ord_vertex[i].dist=StarDistorsion<BaseMesh>(ord_vertex[i].v);
+
         std::sort(ord_vertex.begin(),ord_vertex.end());
-        for (unsigned int i=0;i<ord_vertex.size();i++)
+
+        ///the optimization of a star only modifies its faces, the vertices
+        ///falling in them and its center, so the stars of non adjacent vertices
+        ///are independent. Each star waits for the adjacent ones that come before
+        ///it in the order, so the stars of a level are optimized in parallel
+        ///and the result is the same of the sequential optimization.
+        std::vector<int> rank(base_mesh.vert.size(),-1);
+        for (int i=0;i<num;i++)
+            rank[vcg::tri::Index(base_mesh,ord_vertex[i].v)]=i;
+        std::vector<int> level(num,0);
+        int num_levels=0;
+        for (int i=0;i<num;i++)
         {
-                printf("%3.3f\n",ord_vertex[i].dist);
-        SmartOptimizeStar<BaseMesh>(ord_vertex[i].v,base_mesh,pecp->Accuracy(),EType);
+            std::vector<BaseVertex*> star;
+            getVertexStar<BaseMesh>(ord_vertex[i].v,star);
+            for (unsigned int j=0;j<star.size();j++)
+            {
+                int r=rank[vcg::tri::Index(base_mesh,star[j])];
+                if ((r>=0)&&(r<i))
+                    level[i]=std::max(level[i],level[r]+1);
+            }
+            num_levels=std::max(num_levels,level[i]+1);
+        }
+
+        ///the stars sorted by level, keeping the order inside each level
+        std::vector<int> levelStart(num_levels+1,0);
+        std::vector<int> byLevel(num);
+        for (int i=0;i<num;i++)
+            levelStart[level[i]+1]++;
+        for (int l=0;l<num_levels;l++)
+            levelStart[l+1]+=levelStart[l];
+        std::vector<int> next(levelStart.begin(),levelStart.end()-1);
+        for (int i=0;i<num;i++)
+            byLevel[next[level[i]]++]=i;
+
+        for (int l=0;l<num_levels;l++)
+        {
+            int first=levelStart[l];
+            int last=levelStart[l+1];
+#ifdef _USE_OMP
+            #pragma omp parallel for schedule(dynamic,1)
+#endif
+            for (int k=first;k<last;k++)
+                SmartOptimizeStar<BaseMesh>(ord_vertex[byLevel[k]].v,base_mesh,pecp->Accuracy(),EType);
         }
     }
 
@@ -4,6 +4,8 @@
 #define __VCGLIB__TEXTCOOORD_OPTIMIZATION
 
 
+#include <vector>
+#include <algorithm>
 #include <vcg/container/simple_temporary_data.h>
 #ifdef _USE_OMP
 #include <omp.h>
@@ -41,6 +43,30 @@ class TexCoordOptimization{
 protected:
   MESH_TYPE &m;
   SimpleTempData<typename MESH_TYPE::VertContainer, int > isFixed;
+
+  // the loops over smaller meshes are not worth a parallel region
+  enum { OMP_MIN_SIZE = 2048 };
+
+  // corners (3*face+wedge) of the faces incident on each vertex, in face order:
+  // the ones of vertex i are corners[cornerStart[i]] ... corners[cornerStart[i+1]-1].
+  // The per vertex sums are gathered from them in parallel, adding the terms
+  // in the same order of a sequential scatter over the faces.
+  std::vector<int> cornerStart;
+  std::vector<int> corners;
+
+  void InitVertexCorners(){
+    cornerStart.assign(m.vert.size()+1,0);
+    for (size_t i=0; i<m.face.size(); i++)
+      for (int j=0; j<3; j++)
+        cornerStart[tri::Index(m,m.face[i].V(j))+1]++;
+    for (size_t i=0; i<m.vert.size(); i++)
+      cornerStart[i+1]+=cornerStart[i];
+    corners.resize(cornerStart.back());
+    std::vector<int> next(cornerStart.begin(),cornerStart.end()-1);
+    for (size_t i=0; i<m.face.size(); i++)
+      for (int j=0; j<3; j++)
+        corners[next[tri::Index(m,m.face[i].V(j))]++]=int(3*i+j);
+  }
 public:
 
   /* Tpyes */
@@ -59,6 +85,7 @@ public:
   /* Constructior */
   TexCoordOptimization(MeshType &_m):m(_m),isFixed(_m.vert){
    /* assert(m.HasPerVertexTexture());*/
+    InitVertexCorners();
   }
   
   // initializes on current geometry 
@@ -187,6 +214,7 @@ private:
   
   std::vector<CoordType> sumX;
   std::vector<CoordType> sumY;
+  std::vector<ScalarType> projArea;
 
   SimpleTempData<typename MESH_TYPE::VertContainer, Point2<ScalarType> > lastDir;
   /*SimpleTempData<typename MESH_TYPE::VertContainer,omp_lock_t> lck;*/
@@ -265,53 +293,23 @@ public:
 	 return fabs(val);
   }
 
- void InitSum()
- {
-	 int k;
-         auto n=Super::m.vert.size();
-         auto n1=Super::m.face.size();
-#ifdef _USE_OMP
-	 #pragma omp parallel for default (none) shared(n) private(k)
-#endif
-	 for (k=0;k<n;k++) 
-	 {
-	   sum[k]=Point2<ScalarType>(0,0); 
-	 }
-#ifdef _USE_OMP
-	 #pragma omp parallel for default (none) shared(n1) private(k)
-#endif
-	 for (k=0;k<n1;k++)
-	 {
-	   sumX[k].X()=0;
-	   sumX[k].Y()=0;
-	   sumX[k].Z()=0;
-	   sumY[k].X()=0;
-	   sumY[k].Y()=0;
-	   sumY[k].Z()=0;
-	 }
-#ifdef _USE_OMP
-	 #pragma omp barrier
-#endif
- }
-
 ScalarType getProjArea()
 {
-	  int k;
-          int n=Super::m.face.size();
-	  ScalarType tot_proj_area=0;
-	 //# pragma omp parallel for 
+	  int n=Super::m.face.size();
+	  projArea.resize(n);
+	  // the areas are summed in face order, so that the total does not depend on the threads
 #ifdef _USE_OMP
-	  #pragma omp parallel for default (none) shared(n) private(k) reduction(+: tot_proj_area)
-#endif
-	  for (k=0;k<n; k++) {
-	      tot_proj_area+=Area(k);
-	  }
-#ifdef _USE_OMP
-	  #pragma omp barrier
+	  #pragma omp parallel for if(n>Super::OMP_MIN_SIZE) schedule(static)
 #endif
+	  for (int k=0;k<n; k++)
+	      projArea[k]=Area(k);
+	  ScalarType tot_proj_area=0;
+	  for (int k=0;k<n; k++)
+	      tot_proj_area+=projArea[k];
 	  return (tot_proj_area);
 }
 
+
 vcg::Point2<ScalarType> VertValue(const int &face,const int &vert,const double &scale)
 {
          FaceType *f=&Super::m.face[face];
@@ -358,48 +356,46 @@ vcg::Point2<ScalarType> VertValue(const int &face,const int &vert,const double &
 void UpdateSum(const double &scale)
 {
          int n=Super::m.face.size();
-	 int k;
-	 FaceType *f;
 	 ScalarType myscale=scale;
-	 vcg::Point2<ScalarType> val0,val1,val2;
 #ifdef _USE_OMP
-	  #pragma omp parallel for default (none) shared(n,myscale) private(k,f,val0,val1,val2) 
+	  #pragma omp parallel for if(n>Super::OMP_MIN_SIZE) schedule(static)
 #endif
-	  for (k=0;k<n; k++) {
-                          f=&Super::m.face[k];
-			  val0=VertValue(k,0,myscale);
-			  val1=VertValue(k,1,myscale);
-			  val2=VertValue(k,2,myscale);
-			  sumX[k].V(0)=val0.X();		     
+	  for (int k=0;k<n; k++) {
+			  vcg::Point2<ScalarType> val0=VertValue(k,0,myscale);
+			  vcg::Point2<ScalarType> val1=VertValue(k,1,myscale);
+			  vcg::Point2<ScalarType> val2=VertValue(k,2,myscale);
+			  sumX[k].V(0)=val0.X();
 			  sumX[k].V(1)=val1.X();
 			  sumX[k].V(2)=val2.X();
-			  sumY[k].V(0)=val0.Y();		     
+			  sumY[k].V(0)=val0.Y();
 			  sumY[k].V(1)=val1.Y();
 			  sumY[k].V(2)=val2.Y();
 	  }
-#ifdef _USE_OMP
-	  #pragma omp barrier
-#endif
 }
 
 
 void SumVertex()
 {
-	for (unsigned int j=0; j<Super::m.face.size(); j++) 
+	int n=Super::m.vert.size();
+#ifdef _USE_OMP
+	#pragma omp parallel for if(n>Super::OMP_MIN_SIZE) schedule(static)
+#endif
+	for (int k=0;k<n;k++)
 	{
-		for (int i=0;i<3;i++)
+		Point2<ScalarType> s(0,0);
+		for (int c=Super::cornerStart[k];c<Super::cornerStart[k+1];c++)
 		{
-                        VertexType *v=Super::m.face[j].V(i);
-			sum[v].X()+=sumX[j].V(i);
-			sum[v].Y()+=sumY[j].V(i);
+			int j=Super::corners[c]/3;
+			int i=Super::corners[c]%3;
+			s.X()+=sumX[j].V(i);
+			s.Y()+=sumY[j].V(i);
 		}
+		sum[k]=s;
 	}
 }
 
  ScalarType Iterate(){
 
-	InitSum();
-		
 	ScalarType tot_proj_area=getProjArea();
 
 
@@ -407,32 +403,30 @@ void SumVertex()
 
 	UpdateSum(scale);
 
-
-    ScalarType max=0; // max displacement
-	// #pragma omp parallel for num_threads(4)
- 	 // for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) 
-	/*omp_lock_t lck0;
-	omp_init_lock(&lck0);*/
-	
 	SumVertex();
 
-	//#pragma omp parallel for
-	for (unsigned int j=0; j<Super::m.vert.size(); j++) 
+    ScalarType max=0; // max displacement
+	int nv=Super::m.vert.size();
+#ifdef _USE_OMP
+	#pragma omp parallel if(nv>Super::OMP_MIN_SIZE)
+#endif
+	{
+	ScalarType localMax=0;
+#ifdef _USE_OMP
+	#pragma omp for schedule(static)
+#endif
+	for (int j=0; j<nv; j++) 
 	{
 		VertexType *v=&Super::m.vert[j];
 
     if (  !Super::isFixed[v] ) //if (!v->IsB()) 
     {
 		  ScalarType n=sum[v].Norm();
-		  //printf("N %f \n",n);
 		  if ( n > 1 ) { sum[v]/=n; n=1.0;}
 		  
 		  if (lastDir[v]*sum[v]<0) vSpeed[v]*=(ScalarType)0.85; else vSpeed[v]/=(ScalarType)0.92;
 		  lastDir[v]= sum[v];
 		  
-		 /* if ( n*speed<=0.1 );
-		  {*/
-			
 			vcg::Point2f goal=v->T().P()-(sum[v] * (speed * vSpeed[v]) );
 			bool isOK=testParamCoordsPoint<ScalarType>(goal);
 			if (isOK)
@@ -440,10 +434,14 @@ void SumVertex()
 
 
 			n=n*speed * vSpeed[v];
-			//#pragma omp critical 
-			max=std::max(max,n);
-     /* }*/
+			localMax=std::max(localMax,n);
+	}
 	}
+	// the maximum is the same in any order
+#ifdef _USE_OMP
+	#pragma omp critical
+#endif
+	max=std::max(max,localMax);
 	}
 	return max;
  }
@@ -508,6 +506,8 @@ protected:
   // extra data per face: [0..3] -> cotangents. 
   SimpleTempData<typename MESH_TYPE::FaceContainer, Point3<ScalarType> > data;
   SimpleTempData<typename MESH_TYPE::VertContainer, Point2<ScalarType> > sum;
+  // gradient of the energy of each face w.r.t. its corners (3*face+wedge)
+  std::vector<Point2<ScalarType> > cornerGrad;
   
   ScalarType totArea;
   ScalarType speed;
@@ -547,15 +547,17 @@ public:
     #define vi (f->V(i)->T().P())
     #define vj (f->V(j)->T().P())
     #define vk (f->V(k)->T().P())
-	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) {
-		  //sum[v].Zero();
-		  sum[v]=Point2<ScalarType>(0,0);
-	  }
+    int nf=Super::m.face.size();
+    int nv=Super::m.vert.size();
+    cornerGrad.resize(3*nf);
 
-    ScalarType totProjArea=0;
-	  for (FaceIterator f=Super::m.face.begin(); f!=Super::m.face.end(); f++) {
+    // gradient of each face w.r.t. its corners
+#ifdef _USE_OMP
+    #pragma omp parallel for if(nf>Super::OMP_MIN_SIZE) schedule(static)
+#endif
+	  for (int fi=0; fi<nf; fi++) {
+      FaceType *f=&Super::m.face[fi];
       ScalarType area2 = ((v1-v0) ^ (v2-v0));
-      totProjArea+=area2;
       ScalarType o[3] = { // (opposite edge)^2 
         (   v1-v2).SquaredNorm(),
         (v0   -v2).SquaredNorm(),
@@ -575,25 +577,43 @@ public:
 			  //sum[f->V(i)]+= ( (vj-vi) * gx + (vk-vi) * gy );// / area2; 
 			  
 			  // speed mode:
-        sum[f->V(i)]+= ( (vj-vi) * gx + (vk-vi) * gy ) / area2; 
+        cornerGrad[3*fi+i]= ( (vj-vi) * gx + (vk-vi) * gy ) / area2; 
 		  }
 	  }
  
     ScalarType max=0; // max displacement
 
- 	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) 
-    if (  !Super::isFixed[v] ) 
+    // gathers the gradients of the corners and moves the vertices
+#ifdef _USE_OMP
+    #pragma omp parallel if(nv>Super::OMP_MIN_SIZE)
+#endif
     {
-      // speed free mode: (a try!)
-      //v->T().P()-=speed * sum[v] *totProjArea/totArea;
-      
-      // speed mode:     
-      
-      ScalarType n=sum[v].Norm(); if ( n > 1 ) { sum[v]/=n; n=1.0;}
-		  v->T().P()-=(sum[v] ) * speed ;
-		  if (max<n) max=n;
-		  
+    ScalarType localMax=0;
+#ifdef _USE_OMP
+    #pragma omp for schedule(static)
+#endif
+ 	  for (int iv=0; iv<nv; iv++) {
+      VertexType *v=&Super::m.vert[iv];
+      sum[v]=Point2<ScalarType>(0,0);
+      for (int c=Super::cornerStart[iv]; c<Super::cornerStart[iv+1]; c++)
+        sum[v]+=cornerGrad[Super::corners[c]];
+      if (  !Super::isFixed[v] ) 
+      {
+        // speed free mode: (a try!)
+        //v->T().P()-=speed * sum[v] *totProjArea/totArea;
+        
+        // speed mode:     
+        
+        ScalarType n=sum[v].Norm(); if ( n > 1 ) { sum[v]/=n; n=1.0;}
+		    v->T().P()-=(sum[v] ) * speed ;
+		    if (localMax<n) localMax=n;
+      }
   	}
+#ifdef _USE_OMP
+    #pragma omp critical
+#endif
+    if (max<localMax) max=localMax;
+    }
   	return max;
   	#undef v0
     #undef v1 
@@ -771,22 +791,39 @@ public:
   ScalarType Iterate(){
     
     ScalarType max=0; // max displacement
-  		  
-	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) {
-		  sum[v]=PointType(0,0);
-		  div[v]=0; 
-	  }
+    int nv=Super::m.vert.size();
 
-	  for (FaceIterator f=Super::m.face.begin(); f!=Super::m.face.end(); f++){
-		  for (int i=0; i<3; i++) 
-		  for (int j=1; j<3; j++) {
-			  int d=i, o=(i+3-j)%3;
-			  sum[f->V(d)] += f->V(o)->T().P() * factors[f].data[i][j-1];
-			  div[f->V(d)] += factors[f].data[i][j-1];
+    // gathers the weighted average of the neighbors of each vertex
+    // (all of them before moving any vertex)
+#ifdef _USE_OMP
+    #pragma omp parallel for if(nv>Super::OMP_MIN_SIZE) schedule(static)
+#endif
+	  for (int iv=0; iv<nv; iv++) {
+		  PointType s(0,0);
+		  ScalarType d=0;
+		  for (int c=Super::cornerStart[iv]; c<Super::cornerStart[iv+1]; c++) {
+			  FaceType *f=&Super::m.face[Super::corners[c]/3];
+			  int i=Super::corners[c]%3;
+			  for (int j=1; j<3; j++) {
+				  int o=(i+3-j)%3;
+				  s += f->V(o)->T().P() * factors[f].data[i][j-1];
+				  d += factors[f].data[i][j-1];
+			  }
 		  }
+		  sum[iv]=s;
+		  div[iv]=d;
 	  }
 
-	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) 
+#ifdef _USE_OMP
+    #pragma omp parallel if(nv>Super::OMP_MIN_SIZE)
+#endif
+    {
+    ScalarType localMax=0;
+#ifdef _USE_OMP
+    #pragma omp for schedule(static)
+#endif
+	  for (int iv=0; iv<nv; iv++) {
+    VertexType *v=&Super::m.vert[iv];
     if (  !Super::isFixed[v] )
 	  if (		div[v]>0.000001 ) {
 		  PointType swap=v->T().P();
@@ -796,9 +833,15 @@ public:
 
 		  //v->T().P()=v->RestUV*(1-v->Damp)+(sum[v]/div[v])*(v->Damp);
 		  ScalarType temp=(swap-v->T().P()).SquaredNorm();
-		  if (max<temp)
-			  max=temp;
+		  if (localMax<temp)
+			  localMax=temp;
 	  }
+	  }
+#ifdef _USE_OMP
+    #pragma omp critical
+#endif
+    if (max<localMax) max=localMax;
+    }
     return max; 	
   }
   
@@ -1111,19 +1154,28 @@ public:
     #define vi (f->V(i)->T().P())
     #define vj (f->V(j)->T().P())
     #define vk (f->V(k)->T().P())
-	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) {
-		  //sum[v].Zero();
-		  Super::sum[v]=Point2<ScalarType>(0,0);
-	  }
+    int nf=Super::m.face.size();
+    int nv=Super::m.vert.size();
+    Super::cornerGrad.resize(3*nf);
 
-    ScalarType totProjArea=0;
-    nfolds=0;
-	  for (FaceIterator f=Super::m.face.begin(); f!=Super::m.face.end(); f++) {
+    // gradient of each folded face w.r.t. its corners (zero for the other faces)
+    int folds=0;
+#ifdef _USE_OMP
+    #pragma omp parallel if(nf>Super::OMP_MIN_SIZE)
+#endif
+    {
+    int localFolds=0;
+#ifdef _USE_OMP
+    #pragma omp for schedule(static)
+#endif
+	  for (int fi=0; fi<nf; fi++) {
+      FaceType *f=&Super::m.face[fi];
+      Point2<ScalarType> *grad=&Super::cornerGrad[3*fi];
+      grad[0]=grad[1]=grad[2]=Point2<ScalarType>(0,0);
       if (Super::isFixed[f->V(0)] && Super::isFixed[f->V(1)] && Super::isFixed[f->V(2)]) continue;
       if (!foldf[f]) continue;
       ScalarType area2 = ((v1-v0) ^ (v2-v0));
-      if (area2*sign<0) nfolds++;
-      totProjArea+=area2;
+      if (area2*sign<0) localFolds++;
       ScalarType o[3] = { // (opposite edge)^2 
         (   v1-v2).SquaredNorm(),
         (v0   -v2).SquaredNorm(),
@@ -1143,13 +1195,26 @@ public:
 			  //sum[f->V(i)]+= ( (vj-vi) * gx + (vk-vi) * gy );// / area2; 
 			  
 			  // speed mode:
-        Super::sum[f->V(i)]+= ( (vj-vi) * gx + (vk-vi) * gy ) / area2; 
+        grad[i]= ( (vj-vi) * gx + (vk-vi) * gy ) / area2; 
 		  }
 	  }
+#ifdef _USE_OMP
+    #pragma omp atomic
+#endif
+    folds+=localFolds;
+    }
+    nfolds=folds;
  
     if (nfolds==0) return 0;
     
- 	  for (VertexIterator v=Super::m.vert.begin(); v!=Super::m.vert.end(); v++) 
+#ifdef _USE_OMP
+    #pragma omp parallel for if(nv>Super::OMP_MIN_SIZE) schedule(static)
+#endif
+ 	  for (int iv=0; iv<nv; iv++) {
+    VertexType *v=&Super::m.vert[iv];
+    Super::sum[v]=Point2<ScalarType>(0,0);
+    for (int c=Super::cornerStart[iv]; c<Super::cornerStart[iv+1]; c++)
+      Super::sum[v]+=Super::cornerGrad[Super::corners[c]];
     if (  !Super::isFixed[v] && foldv[v] )
     {
       ScalarType n=Super::sum[v].Norm(); if ( n > 1 ) { Super::sum[v]/=n; n=1.0;}
@@ -1161,6 +1226,7 @@ public:
 		  v->T().P()-=(Super::sum[v] ) * Super::speed;
 #endif
   	}
+    }
   	return (ScalarType)nfolds;
   	#undef v0
     #undef v1 
@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include "filter_layer.h"
+#include "mesh_splitter.h"
 
 #include<vcg/complex/append.h>
 #include <QImageReader>
@@ -259,7 +260,12 @@ bool FilterLayerPlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 
 		numVertSel = (int)tri::UpdateSelection<CMeshO>::VertexCount(currentModel->cm);
 
-		tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, currentModel->cm, true);
+		// the vertices of the selected faces and edges are moved with them
+		tri::UpdateSelection<CMeshO>::VertexFromEdgeLoose(currentModel->cm, true);
+		tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(currentModel->cm, true);
+		MeshSplitter::Labels labels(currentModel->cm);
+		MeshSplitter::labelSelection(currentModel->cm, labels);
+		MeshSplitter::split(currentModel->cm, labels, std::vector<CMeshO*>(1, &destModel->cm), cb);
 
 		if(par.getBool("DeleteOriginal"))	// delete original vert/faces
 		{
@@ -302,7 +308,9 @@ bool FilterLayerPlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 		numFacesSel = (int)tri::UpdateSelection<CMeshO>::FaceCount(currentModel->cm);
 		numVertSel = (int)tri::UpdateSelection<CMeshO>::VertexCount(currentModel->cm);
 
-		tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, currentModel->cm, true);
+		MeshSplitter::Labels labels(currentModel->cm);
+		MeshSplitter::labelSelection(currentModel->cm, labels);
+		MeshSplitter::split(currentModel->cm, labels, std::vector<CMeshO*>(1, &destModel->cm), cb);
 
 		if(par.getBool("DeleteOriginal"))	// delete original faces
 		{
@@ -361,29 +369,20 @@ bool FilterLayerPlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 		MeshModel *destModel = md.addNewMesh("", "Merged Mesh", true);
 
 		QList<MeshModel *> toBeDeletedList;
+		std::vector<const CMeshO *> sourceList;
 
-		int cnt=0;
 		foreach(MeshModel *mmp, md.meshList)
 		{ 
-			++cnt;
-            if(mmp->visible || !mergeVisible)
+            if((mmp->visible || !mergeVisible) && (mmp != destModel))
             {
-				if (mmp != destModel)
-                {
-                    cb(cnt*100/md.meshList.size(), "Merging layers...");
-                    tri::UpdatePosition<CMeshO>::Matrix(mmp->cm,mmp->cm.Tr,true);
-                    toBeDeletedList.push_back(mmp);
-                    if(!alsoUnreferenced)
-                    {
-                        vcg::tri::Clean<CMeshO>::RemoveUnreferencedVertex(mmp->cm);
-                    }
-					destModel->updateDataMask(mmp);
-					tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, mmp->cm);
-                    tri::UpdatePosition<CMeshO>::Matrix(mmp->cm,Inverse(mmp->cm.Tr),true);
-                    
-                }
+                toBeDeletedList.push_back(mmp);
+                sourceList.push_back(&mmp->cm);
+                destModel->updateDataMask(mmp);
             }
 		}
+
+		// the layers are copied with their transformation applied, without modifying them
+		MeshSplitter::merge(sourceList, destModel->cm, alsoUnreferenced, cb);
             
 		if( deleteLayer )
 		{
@@ -408,25 +407,28 @@ bool FilterLayerPlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 		MeshModel *currentModel = md.mm();
 		CMeshO &cm = md.mm()->cm;
 		md.mm()->updateDataMask(MeshModel::MM_FACEFACETOPO);
-		std::vector< std::pair<int,CMeshO::FacePointer> > connectedCompVec;
-		int numCC = tri::Clean<CMeshO>::ConnectedComponents(cm,  connectedCompVec);
+		// the faces are labelled once with their component and all the layers are filled in a single pass
+		MeshSplitter::Labels labels(cm);
+		int numCC = MeshSplitter::connectedComponents(cm, labels.face);
 		log("Found %i Connected Components",numCC);
-		
-		for(size_t i=0; i<connectedCompVec.size();++i)
+
+		std::vector<MeshModel *> destModels(numCC);
+		std::vector<CMeshO *> destMeshes(numCC);
+		for(int i=0; i<numCC; ++i)
+		{
+			destModels[i] = md.addNewMesh("",QString("CC %1").arg(i), true);
+			destModels[i]->updateDataMask(currentModel);
+			destMeshes[i] = &destModels[i]->cm;
+		}
+
+		MeshSplitter::split(cm, labels, destMeshes, cb);
+
+		// init new layers
+#pragma omp parallel for schedule(dynamic, 1)
+		for(int i=0; i<numCC; ++i)
 		{
-			tri::UpdateSelection<CMeshO>::FaceClear(cm);
-			connectedCompVec[i].second->SetS();
-			tri::UpdateSelection<CMeshO>::FaceConnectedFF(cm/*,true*/);
-			tri::UpdateSelection<CMeshO>::VertexClear(cm);
-			tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(cm);
-
-			MeshModel *destModel= md.addNewMesh("",QString("CC %1").arg(i), true);
-			destModel->updateDataMask(currentModel);
-			tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, cm, true);
-
-			// init new layer
-			destModel->UpdateBoxAndNormals();
-			destModel->cm.Tr = currentModel->cm.Tr;
+			destModels[i]->UpdateBoxAndNormals();
+			destModels[i]->cm.Tr = currentModel->cm.Tr;
 		}
 	} break;
 
@@ -1,10 +1,12 @@
 include (../../shared.pri)
 
 HEADERS += \
-    filter_layer.h
+    filter_layer.h \
+    mesh_splitter.h
 
 SOURCES += \
-    filter_layer.cpp
+    filter_layer.cpp \
+    mesh_splitter.cpp
 
 TARGET = \
     filter_layer
@@ -0,0 +1,307 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "mesh_splitter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+using namespace vcg;
+
+MeshSplitter::Labels::Labels(const CMeshO& m)
+	: vert(m.vert.size(), -1), edge(m.edge.size(), -1), face(m.face.size(), -1)
+{
+}
+
+void MeshSplitter::labelSelection(const CMeshO& m, Labels& labels)
+{
+	for (size_t i = 0; i < m.vert.size(); ++i)
+		labels.vert[i] = (!m.vert[i].IsD() && m.vert[i].IsS()) ? 0 : -1;
+	for (size_t i = 0; i < m.edge.size(); ++i)
+		labels.edge[i] = (!m.edge[i].IsD() && m.edge[i].IsS()) ? 0 : -1;
+	for (size_t i = 0; i < m.face.size(); ++i)
+		labels.face[i] = (!m.face[i].IsD() && m.face[i].IsS()) ? 0 : -1;
+}
+
+int MeshSplitter::connectedComponents(const CMeshO& m, std::vector<int>& faceLabel)
+{
+	faceLabel.assign(m.face.size(), -1);
+	int num = 0;
+	std::vector<int> stack;
+	for (size_t i = 0; i < m.face.size(); ++i)
+	{
+		if (m.face[i].IsD() || faceLabel[i] >= 0)
+			continue;
+		faceLabel[i] = num;
+		stack.push_back(int(i));
+		while (!stack.empty())
+		{
+			const CFaceO& f = m.face[stack.back()];
+			stack.pop_back();
+			for (int j = 0; j < 3; ++j)
+			{
+				const CFaceO* adj = f.cFFp(j);
+				if (adj == &f || adj->IsD())
+					continue;
+				const size_t k = tri::Index(m, adj);
+				if (faceLabel[k] < 0)
+				{
+					faceLabel[k] = num;
+					stack.push_back(int(k));
+				}
+			}
+		}
+		++num;
+	}
+	return num;
+}
+
+//counting sort of the element indexes by label: the elements of bucket b are order[start[b] .. start[b+1])
+void MeshSplitter::bucket(const std::vector<int>& label, int bucketNum, std::vector<int>& start, std::vector<int>& order)
+{
+	start.assign(bucketNum + 1, 0);
+	for (size_t i = 0; i < label.size(); ++i)
+		if (label[i] >= 0)
+			++start[label[i] + 1];
+	for (int b = 0; b < bucketNum; ++b)
+		start[b + 1] += start[b];
+	order.resize(start[bucketNum]);
+	std::vector<int> pos(start.begin(), start.end() - 1);
+	for (size_t i = 0; i < label.size(); ++i)
+		if (label[i] >= 0)
+			order[pos[label[i]]++] = int(i);
+}
+
+void MeshSplitter::split(const CMeshO& src, const Labels& labels, const std::vector<CMeshO*>& dest, CallBackPos* cb)
+{
+	const int dn = int(dest.size());
+	std::vector<int> vertStart, vertOrder, edgeStart, edgeOrder, faceStart, faceOrder;
+	bucket(labels.vert, dn, vertStart, vertOrder);
+	bucket(labels.edge, dn, edgeStart, edgeOrder);
+	bucket(labels.face, dn, faceStart, faceOrder);
+
+	if (cb)
+		cb(10, "Copying the elements to the new layers");
+
+	//each destination is built by a single thread, so it can use the vcg allocator
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int d = 0; d < dn; ++d)
+	{
+		CMeshO& dm = *dest[d];
+
+		//the source vertices of this destination, sorted by index: their rank is the new index
+		std::vector<int> verts(vertOrder.begin() + vertStart[d], vertOrder.begin() + vertStart[d + 1]);
+		for (int i = edgeStart[d]; i < edgeStart[d + 1]; ++i)
+			for (int j = 0; j < 2; ++j)
+				verts.push_back(int(tri::Index(src, src.edge[edgeOrder[i]].cV(j))));
+		for (int i = faceStart[d]; i < faceStart[d + 1]; ++i)
+			for (int j = 0; j < 3; ++j)
+				verts.push_back(int(tri::Index(src, src.face[faceOrder[i]].cV(j))));
+		std::sort(verts.begin(), verts.end());
+		verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+		if (verts.empty())
+			continue;
+
+		tri::Allocator<CMeshO>::AddVertices(dm, verts.size());
+		for (size_t k = 0; k < verts.size(); ++k)
+			dm.vert[k].ImportData(src.vert[verts[k]]);
+
+		const int en = edgeStart[d + 1] - edgeStart[d];
+		if (en > 0)
+		{
+			tri::Allocator<CMeshO>::AddEdges(dm, en);
+			for (int k = 0; k < en; ++k)
+			{
+				const CEdgeO& se = src.edge[edgeOrder[edgeStart[d] + k]];
+				dm.edge[k].ImportData(se);
+				for (int j = 0; j < 2; ++j)
+				{
+					const int v = int(tri::Index(src, se.cV(j)));
+					dm.edge[k].V(j) = &dm.vert[std::lower_bound(verts.begin(), verts.end(), v) - verts.begin()];
+				}
+			}
+		}
+
+		const int fn = faceStart[d + 1] - faceStart[d];
+		if (fn > 0)
+		{
+			tri::Allocator<CMeshO>::AddFaces(dm, fn);
+			for (int k = 0; k < fn; ++k)
+			{
+				const CFaceO& sf = src.face[faceOrder[faceStart[d] + k]];
+				dm.face[k].ImportData(sf);
+				for (int j = 0; j < 3; ++j)
+				{
+					const int v = int(tri::Index(src, sf.cV(j)));
+					dm.face[k].V(j) = &dm.vert[std::lower_bound(verts.begin(), verts.end(), v) - verts.begin()];
+				}
+			}
+		}
+
+		//a single source: the texture indexes are still valid
+		dm.textures = src.textures;
+		dm.normalmaps = src.normalmaps;
+	}
+}
+
+static int textureIndex(std::vector<std::string>& textures, const std::string& name)
+{
+	std::vector<std::string>::iterator it = std::find(textures.begin(), textures.end(), name);
+	if (it != textures.end())
+		return int(it - textures.begin());
+	textures.push_back(name);
+	return int(textures.size()) - 1;
+}
+
+void MeshSplitter::merge(const std::vector<const CMeshO*>& src, CMeshO& dest, bool keepUnreferenced, CallBackPos* cb)
+{
+	const int sn = int(src.size());
+
+	//as tri::Append: the textures with the same name are merged and the per source indexes remapped
+	std::vector<std::vector<int> > textureMap(sn);
+	for (int s = 0; s < sn; ++s)
+	{
+		for (size_t t = 0; t < src[s]->textures.size(); ++t)
+			textureMap[s].push_back(textureIndex(dest.textures, src[s]->textures[t]));
+		for (size_t t = 0; t < src[s]->normalmaps.size(); ++t)
+			textureIndex(dest.normalmaps, src[s]->normalmaps[t]);
+	}
+
+	//new index of each source vertex in its block of the destination (-1: not copied)
+	std::vector<std::vector<int> > vertRemap(sn);
+	std::vector<int> vertNum(sn, 0), edgeNum(sn, 0), faceNum(sn, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int s = 0; s < sn; ++s)
+	{
+		const CMeshO& m = *src[s];
+		std::vector<int>& remap = vertRemap[s];
+		remap.assign(m.vert.size(), -1);
+		for (size_t i = 0; i < m.vert.size(); ++i)
+			if (!m.vert[i].IsD() && keepUnreferenced)
+				remap[i] = 0;
+		for (size_t i = 0; i < m.edge.size(); ++i)
+		{
+			if (m.edge[i].IsD())
+				continue;
+			++edgeNum[s];
+			for (int j = 0; j < 2; ++j)
+				remap[tri::Index(m, m.edge[i].cV(j))] = 0;
+		}
+		for (size_t i = 0; i < m.face.size(); ++i)
+		{
+			if (m.face[i].IsD())
+				continue;
+			++faceNum[s];
+			for (int j = 0; j < 3; ++j)
+				remap[tri::Index(m, m.face[i].cV(j))] = 0;
+		}
+		for (size_t i = 0; i < m.vert.size(); ++i)
+			if (remap[i] == 0)
+				remap[i] = vertNum[s]++;
+	}
+
+	std::vector<int> vertOffset(sn + 1, 0), edgeOffset(sn + 1, 0), faceOffset(sn + 1, 0);
+	for (int s = 0; s < sn; ++s)
+	{
+		vertOffset[s + 1] = vertOffset[s] + vertNum[s];
+		edgeOffset[s + 1] = edgeOffset[s] + edgeNum[s];
+		faceOffset[s + 1] = faceOffset[s] + faceNum[s];
+	}
+	if (vertOffset[sn] == 0)
+		return;
+
+	if (cb)
+		cb(10, "Merging layers...");
+
+	tri::Allocator<CMeshO>::AddVertices(dest, vertOffset[sn]);
+	if (edgeOffset[sn] > 0)
+		tri::Allocator<CMeshO>::AddEdges(dest, edgeOffset[sn]);
+	if (faceOffset[sn] > 0)
+		tri::Allocator<CMeshO>::AddFaces(dest, faceOffset[sn]);
+
+	const bool vertTex = tri::HasPerVertexTexCoord(dest);
+	const bool wedgeTex = tri::HasPerWedgeTexCoord(dest);
+
+	//every source writes its own block of the destination
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int s = 0; s < sn; ++s)
+	{
+		const CMeshO& m = *src[s];
+		const std::vector<int>& remap = vertRemap[s];
+		const std::vector<int>& texMap = textureMap[s];
+		const bool identity = (m.Tr == Matrix44m::Identity());
+		//as tri::UpdatePosition::Matrix, normals are rotated and their scale removed
+		Matrix33m mat33(m.Tr, 3);
+		const Scalarm scale = std::pow(std::abs(mat33.Determinant()), Scalarm(1.0 / 3.0));
+		if (scale > 0)
+			mat33 /= scale;
+
+		const bool srcVertTex = vertTex && tri::HasPerVertexTexCoord(m);
+		for (size_t i = 0; i < m.vert.size(); ++i)
+		{
+			if (remap[i] < 0)
+				continue;
+			CVertexO& v = dest.vert[vertOffset[s] + remap[i]];
+			v.ImportData(m.vert[i]);
+			if (!identity)
+			{
+				v.P() = m.Tr * v.cP();
+				v.N() = mat33 * v.cN();
+			}
+			if (srcVertTex && v.T().N() >= 0 && v.T().N() < int(texMap.size()))
+				v.T().N() = texMap[v.T().N()];
+		}
+
+		int e = edgeOffset[s];
+		for (size_t i = 0; i < m.edge.size(); ++i)
+		{
+			if (m.edge[i].IsD())
+				continue;
+			dest.edge[e].ImportData(m.edge[i]);
+			for (int j = 0; j < 2; ++j)
+				dest.edge[e].V(j) = &dest.vert[vertOffset[s] + remap[tri::Index(m, m.edge[i].cV(j))]];
+			++e;
+		}
+
+		const bool srcWedgeTex = wedgeTex && tri::HasPerWedgeTexCoord(m);
+		int f = faceOffset[s];
+		for (size_t i = 0; i < m.face.size(); ++i)
+		{
+			if (m.face[i].IsD())
+				continue;
+			CFaceO& df = dest.face[f];
+			df.ImportData(m.face[i]);
+			for (int j = 0; j < 3; ++j)
+			{
+				df.V(j) = &dest.vert[vertOffset[s] + remap[tri::Index(m, m.face[i].cV(j))]];
+				if (srcWedgeTex && df.WT(j).N() >= 0 && df.WT(j).N() < int(texMap.size()))
+					df.WT(j).N() = texMap[df.WT(j).N()];
+			}
+			if (!identity)
+				df.N() = mat33 * df.cN();
+			++f;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_LAYER_MESH_SPLITTER_H
+#define FILTER_LAYER_MESH_SPLITTER_H
+
+#include <vector>
+#include <common/ml_document/cmesh.h>
+
+/*
+MeshSplitter
+Copies the elements of meshes into other meshes in a single pass over the sources,
+instead of one tri::Append per destination.
+
+split(): each vertex, edge and face of the source has a label, the index of the
+destination that receives it (-1: none). The vertices of the labelled faces and edges
+are always copied with them, so a vertex shared by faces with different labels
+is duplicated in each destination. Elements are bucketed by label once and the
+destinations are then filled in parallel.
+
+merge(): appends several meshes (transformed by their Tr) into a single one;
+the position of each source in the destination is known in advance, so the
+sources are copied in parallel.
+
+The destinations must be empty and have (at least) the optional components of the sources.
+As with tri::Append, user defined attributes and adjacency are not copied.
+*/
+class MeshSplitter
+{
+public:
+	struct Labels
+	{
+		Labels(const CMeshO& m);
+		std::vector<int> vert;
+		std::vector<int> edge;
+		std::vector<int> face;
+	};
+
+	// labels with 0 the selected elements
+	static void labelSelection(const CMeshO& m, Labels& labels);
+
+	// labels the faces with the index of their connected component (faces sharing an edge);
+	// components are numbered in the order of their first face. Requires FF adjacency.
+	static int connectedComponents(const CMeshO& m, std::vector<int>& faceLabel);
+
+	static void split(const CMeshO& src, const Labels& labels, const std::vector<CMeshO*>& dest, vcg::CallBackPos* cb = nullptr);
+
+	static void merge(const std::vector<const CMeshO*>& src, CMeshO& dest, bool keepUnreferenced, vcg::CallBackPos* cb = nullptr);
+
+private:
+	static void bucket(const std::vector<int>& label, int bucketNum, std::vector<int>& start, std::vector<int>& order);
+};
+
+#endif
@@ -22,23 +22,39 @@
 ****************************************************************************/
 
 #include "filter_measure.h"
-#include <math.h>
+#include <cmath>
 #include <stdlib.h>
 #include <time.h>
 #include <vcg/complex/algorithms/clean.h>
-#include <vcg/complex/algorithms/inertia.h>
 #include <vcg/complex/algorithms/stat.h>
 
 #include <vcg/complex/algorithms/update/selection.h>
 #include <vcg/complex/append.h>
 #include <vcg/simplex/face/pos.h>
 #include <vcg/complex/algorithms/bitquad_support.h>
-#include <vcg/complex/algorithms/mesh_to_matrix.h>
 #include <vcg/complex/algorithms/bitquad_optimization.h>
 
 using namespace std;
 using namespace vcg;
 
+namespace {
+
+QVariant toVariant(const Point3m& p)
+{
+	return QVariantList{p[0], p[1], p[2]};
+}
+
+// list of the rows
+QVariant toVariant(const Matrix33m& m)
+{
+	QVariantList rows;
+	for (int i = 0; i < 3; ++i)
+		rows.push_back(QVariantList{m[i][0], m[i][1], m[i][2]});
+	return rows;
+}
+
+}
+
 FilterMeasurePlugin::FilterMeasurePlugin()
 { 
 	typeList << COMPUTE_TOPOLOGICAL_MEASURES
@@ -171,32 +187,32 @@ void FilterMeasurePlugin::initParameterList(const QAction *action, MeshModel &m,
 	}
 }
 
-bool FilterMeasurePlugin::applyFilter(const QAction* filter, MeshDocument& md, std::map<std::string, QVariant>&, unsigned int& /*postConditionMask*/, const RichParameterList& parlst, vcg::CallBackPos*)
+bool FilterMeasurePlugin::applyFilter(const QAction* filter, MeshDocument& md, std::map<std::string, QVariant>& outputValues, unsigned int& /*postConditionMask*/, const RichParameterList& parlst, vcg::CallBackPos*)
 {
 	switch (ID(filter)) {
 	case COMPUTE_TOPOLOGICAL_MEASURES:
-		return computeTopologicalMeasures(md);
+		return computeTopologicalMeasures(md, outputValues);
 		break;
 	case COMPUTE_TOPOLOGICAL_MEASURES_QUAD_MESHES:
 		return computeTopologicalMeasuresForQuadMeshes(md);
 		break;
 	case COMPUTE_GEOMETRIC_MEASURES:
-		return computeGeometricMeasures(md);
+		return computeGeometricMeasures(md, outputValues);
 		break;
 	case COMPUTE_AREA_PERIMETER_SELECTION:
-		return computeAreaPerimeterOfSelection(md);
+		return computeAreaPerimeterOfSelection(md, outputValues);
 		break;
 	case PER_VERTEX_QUALITY_STAT:
-		return perVertexQualityStat(md);
+		return perVertexQualityStat(md, outputValues);
 		break;
 	case PER_FACE_QUALITY_STAT:
-		return perFaceQualityStat(md);
+		return perFaceQualityStat(md, outputValues);
 		break;
 	case PER_VERTEX_QUALITY_HISTOGRAM:
-		return perVertexQualityHistogram(md, parlst.getFloat("HistMin"), parlst.getFloat("HistMax"), parlst.getInt("binNum"), parlst.getBool("areaWeighted"));
+		return perVertexQualityHistogram(md, outputValues, parlst.getFloat("HistMin"), parlst.getFloat("HistMax"), parlst.getInt("binNum"), parlst.getBool("areaWeighted"));
 		break;
 	case PER_FACE_QUALITY_HISTOGRAM:
-		return perFaceQualityHostogram(md, parlst.getFloat("HistMin"), parlst.getFloat("HistMax"), parlst.getInt("binNum"), parlst.getBool("areaWeighted"));
+		return perFaceQualityHostogram(md, outputValues, parlst.getFloat("HistMin"), parlst.getFloat("HistMax"), parlst.getInt("binNum"), parlst.getBool("areaWeighted"));
 		break;
 	default:
 		assert(0);
@@ -209,54 +225,49 @@ int FilterMeasurePlugin::postCondition(const QAction*) const
 	return MeshModel::MM_NONE;
 }
 
-bool FilterMeasurePlugin::computeTopologicalMeasures(MeshDocument& md)
+bool FilterMeasurePlugin::computeTopologicalMeasures(MeshDocument& md, std::map<std::string, QVariant>& outputValues)
 {
 	CMeshO &m = md.mm()->cm;
-	tri::Allocator<CMeshO>::CompactFaceVector(m);
-	tri::Allocator<CMeshO>::CompactVertexVector(m);
-	md.mm()->updateDataMask(MeshModel::MM_FACEFACETOPO);
-	md.mm()->updateDataMask(MeshModel::MM_VERTFACETOPO);
-
-	int edgeNonManifFFNum = tri::Clean<CMeshO>::CountNonManifoldEdgeFF(m, true);
-	int faceEdgeManif = tri::UpdateSelection<CMeshO>::FaceCount(m);
-	tri::UpdateSelection<CMeshO>::VertexClear(m);
-	tri::UpdateSelection<CMeshO>::FaceClear(m);
-
-	int vertManifNum = tri::Clean<CMeshO>::CountNonManifoldVertexFF(m, true);
-	tri::UpdateSelection<CMeshO>::FaceFromVertexLoose(m);
-	int faceVertManif = tri::UpdateSelection<CMeshO>::FaceCount(m);
-	int edgeNum = 0, edgeBorderNum = 0, edgeNonManifNum = 0;
-	tri::Clean<CMeshO>::CountEdgeNum(m, edgeNum, edgeBorderNum, edgeNonManifNum);
-	assert(edgeNonManifFFNum == edgeNonManifNum);
-	int holeNum;
-	log("V: %6i E: %6i F:%6i", m.vn, edgeNum, m.fn);
-	int unrefVertNum = tri::Clean<CMeshO>::CountUnreferencedVertex(m);
-	log("Unreferenced Vertices %i", unrefVertNum);
-	log("Boundary Edges %i", edgeBorderNum);
-
-	int connectedComponentsNum = tri::Clean<CMeshO>::CountConnectedComponents(m);
-	log("Mesh is composed by %i connected component(s)\n", connectedComponentsNum);
-
-	if (edgeNonManifFFNum == 0 && vertManifNum == 0){
+	MeshAnalysis analysis(m);
+	// leaves selected the non manifold vertices and the faces incident on them
+	MeshAnalysis::Topology t = analysis.topology();
+
+	log("V: %6i E: %6i F:%6i", t.vertNum, t.edgeNum, t.faceNum);
+	log("Unreferenced Vertices %i", t.unreferencedVertNum);
+	log("Boundary Edges %i", t.borderEdgeNum);
+	log("Mesh is composed by %i connected component(s)\n", t.componentNum);
+
+	if (t.isTwoManifold()){
 		log("Mesh is two-manifold ");
 	}
 
-	if (edgeNonManifFFNum != 0) log("Mesh has %i non two manifold edges and %i faces are incident on these edges\n", edgeNonManifFFNum, faceEdgeManif);
-	if (vertManifNum != 0) log("Mesh has %i non two manifold vertices and %i faces are incident on these vertices\n", vertManifNum, faceVertManif);
+	if (t.nonManifoldEdgeNum != 0) log("Mesh has %i non two manifold edges and %i faces are incident on these edges\n", t.nonManifoldEdgeNum, t.nonManifoldEdgeFaceNum);
+	if (t.nonManifoldVertNum != 0) log("Mesh has %i non two manifold vertices and %i faces are incident on these vertices\n", t.nonManifoldVertNum, t.nonManifoldVertFaceNum);
 
 	// For Manifold meshes compute some other stuff
-	if (vertManifNum == 0 && edgeNonManifFFNum == 0) {
-		holeNum = tri::Clean<CMeshO>::CountHoles(m);
-		log("Mesh has %i holes", holeNum);
-
-		int genus = tri::Clean<CMeshO>::MeshGenus(m.vn - unrefVertNum, edgeNum, m.fn, holeNum, connectedComponentsNum);
-		log("Genus is %i", genus);
+	if (t.isTwoManifold()) {
+		log("Mesh has %i holes", t.holeNum);
+		log("Genus is %i", t.genus);
 	}
 	else {
 		log("Mesh has a undefined number of holes (non 2-manifold mesh)");
 		log("Genus is undefined (non 2-manifold mesh)");
 	}
 
+	outputValues["vertices_number"] = QVariant(t.vertNum);
+	outputValues["edges_number"] = QVariant(t.edgeNum);
+	outputValues["faces_number"] = QVariant(t.faceNum);
+	outputValues["unref_vertices_number"] = QVariant(t.unreferencedVertNum);
+	outputValues["boundary_edges"] = QVariant(t.borderEdgeNum);
+	outputValues["connected_components_number"] = QVariant(t.componentNum);
+	outputValues["is_mesh_two_manifold"] = QVariant(t.isTwoManifold());
+	outputValues["non_two_manifold_edges"] = QVariant(t.nonManifoldEdgeNum);
+	outputValues["incident_faces_on_non_two_manifold_edges"] = QVariant(t.nonManifoldEdgeFaceNum);
+	outputValues["non_two_manifold_vertices"] = QVariant(t.nonManifoldVertNum);
+	outputValues["incident_faces_on_non_two_manifold_vertices"] = QVariant(t.nonManifoldVertFaceNum);
+	// -1 for non two manifold meshes
+	outputValues["number_holes"] = QVariant(t.holeNum);
+	outputValues["genus"] = QVariant(t.genus);
 	return true;
 }
 
@@ -338,23 +349,26 @@ bool FilterMeasurePlugin::computeTopologicalMeasuresForQuadMeshes(MeshDocument&
 	return true;
 }
 
-bool FilterMeasurePlugin::computeGeometricMeasures(MeshDocument& md)
+bool FilterMeasurePlugin::computeGeometricMeasures(MeshDocument& md, std::map<std::string, QVariant>& outputValues)
 {
 	CMeshO &m = md.mm()->cm;
 	bool watertight = false;
 	bool pointcloud = false;
 
-	// the mesh has to be correctly transformed
-	if (m.Tr != Matrix44m::Identity()) {
+	// the measures are taken on the mesh transformed by its matrix, the mesh is not changed
+	if (m.Tr != Matrix44m::Identity())
 		log("BEWARE: Measures are calculated considering the current transformation matrix");
-		tri::UpdatePosition<CMeshO>::Matrix(m, m.Tr, true);
-	}
+	MeshAnalysis analysis(m, true);
 
 	// bounding box
-	log("Mesh Bounding Box Size %f  %f  %f", m.bbox.DimX(), m.bbox.DimY(), m.bbox.DimZ());
-	log("Mesh Bounding Box Diag %f ", m.bbox.Diag());
-	log("Mesh Bounding Box min %f  %f  %f", m.bbox.min[0], m.bbox.min[1], m.bbox.min[2]);
-	log("Mesh Bounding Box max %f  %f  %f", m.bbox.max[0], m.bbox.max[1], m.bbox.max[2]);
+	Box3m bbox = analysis.boundingBox();
+	log("Mesh Bounding Box Size %f  %f  %f", bbox.DimX(), bbox.DimY(), bbox.DimZ());
+	log("Mesh Bounding Box Diag %f ", bbox.Diag());
+	log("Mesh Bounding Box min %f  %f  %f", bbox.min[0], bbox.min[1], bbox.min[2]);
+	log("Mesh Bounding Box max %f  %f  %f", bbox.max[0], bbox.max[1], bbox.max[2]);
+	outputValues["bbox_min"] = toVariant(bbox.min);
+	outputValues["bbox_max"] = toVariant(bbox.max);
+	outputValues["bbox_diag"] = QVariant(bbox.Diag());
 
 	// is pointcloud?
 	if ((m.fn == 0) && (m.vn != 0))
@@ -362,105 +376,114 @@ bool FilterMeasurePlugin::computeGeometricMeasures(MeshDocument& md)
 
 	if (pointcloud) {
 		// cloud barycenter
-		Point3m bc = tri::Stat<CMeshO>::ComputeCloudBarycenter(m, false);
+		Point3m bc = analysis.cloudBarycenter(false);
 		log("Pointcloud (vertex) barycenter  %9.6f  %9.6f  %9.6f", bc[0], bc[1], bc[2]);
+		outputValues["barycenter"] = toVariant(bc);
 
 		// if there is vertex quality, also provide weighted barycenter
 		if (tri::HasPerVertexQuality(m))
 		{
-			bc = tri::Stat<CMeshO>::ComputeCloudBarycenter(m, true);
+			bc = analysis.cloudBarycenter(true);
 			log("Pointcloud (vertex) barycenter, weighted by verytex quality:");
 			log("  %9.6f  %9.6f  %9.6f", bc[0], bc[1], bc[2]);
+			outputValues["quality_weighted_barycenter"] = toVariant(bc);
 		}
 
 		// principal axis
-		Matrix33m PCA;
-		PCA = computePrincipalAxisCloud(m);
+		Matrix33m PCA = analysis.cloudPrincipalAxes();
 		log("Principal Axes are :");
 		log("    | %9.6f  %9.6f  %9.6f |", PCA[0][0], PCA[0][1], PCA[0][2]);
 		log("    | %9.6f  %9.6f  %9.6f |", PCA[1][0], PCA[1][1], PCA[1][2]);
 		log("    | %9.6f  %9.6f  %9.6f |", PCA[2][0], PCA[2][1], PCA[2][2]);
+		outputValues["principal_axes"] = toVariant(PCA);
 	}
 	else {
 		// area
-		float Area = tri::Stat<CMeshO>::ComputeMeshArea(m);
+		Scalarm Area = analysis.area();
 		log("Mesh Surface Area is %f", Area);
+		outputValues["surface_area"] = QVariant(Area);
 
 		// edges
-		Distribution<MESHLAB_SCALAR> eDist;
-		tri::Stat<CMeshO>::ComputeFaceEdgeLengthDistribution(m, eDist, false);
-		log("Mesh Total Len of %i Edges is %f Avg Len %f", int(eDist.Cnt()), eDist.Sum(), eDist.Avg());
-		tri::Stat<CMeshO>::ComputeFaceEdgeLengthDistribution(m, eDist, true);
-		log("Mesh Total Len of %i Edges is %f Avg Len %f (including faux edges))", int(eDist.Cnt()), eDist.Sum(), eDist.Avg());
+		int edgeCount = 0;
+		Scalarm edgeLen = 0;
+		analysis.edgeLength(false, edgeCount, edgeLen);
+		log("Mesh Total Len of %i Edges is %f Avg Len %f", edgeCount, edgeLen, edgeCount > 0 ? edgeLen / edgeCount : 0);
+		outputValues["total_edge_length"] = QVariant(edgeLen);
+		outputValues["avg_edge_length"] = QVariant(edgeCount > 0 ? edgeLen / edgeCount : 0);
+		analysis.edgeLength(true, edgeCount, edgeLen);
+		log("Mesh Total Len of %i Edges is %f Avg Len %f (including faux edges))", edgeCount, edgeLen, edgeCount > 0 ? edgeLen / edgeCount : 0);
+		outputValues["total_edge_length_incl_faux"] = QVariant(edgeLen);
 
 		// Thin shell barycenter
-		Point3m bc = tri::Stat<CMeshO>::ComputeShellBarycenter(m);
+		Point3m bc = analysis.shellBarycenter();
 		log("Thin shell (faces) barycenter:  %9.6f  %9.6f  %9.6f", bc[0], bc[1], bc[2]);
+		outputValues["shell_barycenter"] = toVariant(bc);
 
 		// cloud barycenter
-		bc = tri::Stat<CMeshO>::ComputeCloudBarycenter(m, false);
+		bc = analysis.cloudBarycenter(false);
 		log("Vertices barycenter  %9.6f  %9.6f  %9.6f", bc[0], bc[1], bc[2]);
+		outputValues["barycenter"] = toVariant(bc);
 
 		// is watertight?
 		int edgeNum = 0, edgeBorderNum = 0, edgeNonManifNum = 0;
-		tri::Clean<CMeshO>::CountEdgeNum(m, edgeNum, edgeBorderNum, edgeNonManifNum);
+		analysis.edgeNum(edgeNum, edgeBorderNum, edgeNonManifNum);
 		watertight = (edgeBorderNum == 0) && (edgeNonManifNum == 0);
 		if (watertight) {
-			tri::Inertia<CMeshO> I(m);
+			MeshAnalysis::VolumeIntegrals I = analysis.volumeIntegrals();
 
 			// volume
-			float Volume = I.Mass();
+			Scalarm Volume = I.mass();
 			log("Mesh Volume  is %f", Volume);
+			outputValues["mesh_volume"] = QVariant(Volume);
 
 			// center of mass
-			log("Center of Mass  is %f %f %f", I.CenterOfMass()[0], I.CenterOfMass()[1], I.CenterOfMass()[2]);
+			Point3m com = I.centerOfMass();
+			log("Center of Mass  is %f %f %f", com[0], com[1], com[2]);
+			outputValues["center_of_mass"] = toVariant(com);
 
 			// inertia tensor
 			Matrix33m IT;
-			I.InertiaTensor(IT);
+			I.inertiaTensor(IT);
 			log("Inertia Tensor is :");
 			log("    | %9.6f  %9.6f  %9.6f |", IT[0][0], IT[0][1], IT[0][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", IT[1][0], IT[1][1], IT[1][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", IT[2][0], IT[2][1], IT[2][2]);
+			outputValues["inertia_tensor"] = toVariant(IT);
 
 			// principal axis
 			Matrix33m PCA;
 			Point3m pcav;
-			I.InertiaTensorEigen(PCA, pcav);
+			I.inertiaTensorEigen(PCA, pcav);
 			log("Principal axes are :");
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[0][0], PCA[0][1], PCA[0][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[1][0], PCA[1][1], PCA[1][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[2][0], PCA[2][1], PCA[2][2]);
+			outputValues["principal_axes"] = toVariant(PCA);
 
 			log("axis momenta are :");
 			log("    | %9.6f  %9.6f  %9.6f |", pcav[0], pcav[1], pcav[2]);
-
+			outputValues["axis_momenta"] = toVariant(pcav);
 		}
 		else {
 			log("Mesh is not 'watertight', no information on volume, barycenter and inertia tensor.");
 
 			// principal axis
-			Matrix33m PCA;
-			PCA = computePrincipalAxisCloud(m);
+			Matrix33m PCA = analysis.cloudPrincipalAxes();
 			log("Principal axes are :");
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[0][0], PCA[0][1], PCA[0][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[1][0], PCA[1][1], PCA[1][2]);
 			log("    | %9.6f  %9.6f  %9.6f |", PCA[2][0], PCA[2][1], PCA[2][2]);
+			outputValues["principal_axes"] = toVariant(PCA);
 		}
-
 	}
 
-	// the mesh has to return to its original position
-	if (m.Tr != Matrix44m::Identity())
-		tri::UpdatePosition<CMeshO>::Matrix(m, Inverse(m.Tr), true);
-
 	return true;
 }
 
-bool FilterMeasurePlugin::computeAreaPerimeterOfSelection(MeshDocument& md)
+bool FilterMeasurePlugin::computeAreaPerimeterOfSelection(MeshDocument& md, std::map<std::string, QVariant>& outputValues)
 {
 	CMeshO &m = md.mm()->cm;
-	if (m.sfn == 0) {// no face selected, fail
+	if (m.sfn == 0) {// no face selection, fail
 		errorMessage = "Cannot apply: there is no face selection";
 		log("Cannot apply: there is no face selection");
 		return false;
@@ -500,154 +523,82 @@ bool FilterMeasurePlugin::computeAreaPerimeterOfSelection(MeshDocument& md)
 	log("Selection border is %i edges", ePerimeter);
 	log("Perimeter is %f", sPerimeter);
 
+	outputValues["selected_surface_area"] = QVariant(sArea);
+	outputValues["selected_perimeter"] = QVariant(sPerimeter);
+	outputValues["selection_border_edges"] = QVariant(ePerimeter);
 	return true;
 }
 
-bool FilterMeasurePlugin::perVertexQualityStat(MeshDocument& md)
+bool FilterMeasurePlugin::perVertexQualityStat(MeshDocument& md, std::map<std::string, QVariant>& outputValues)
 {
-	CMeshO &m = md.mm()->cm;
-	Distribution<MESHLAB_SCALAR> DD;
-	tri::Stat<CMeshO>::ComputePerVertexQualityDistribution(m, DD, false);
-
-	log("   Min %f Max %f", DD.Min(), DD.Max());
-	log("   Avg %f Med %f", DD.Avg(), DD.Percentile(0.5f));
-	log("   StdDev     %f", DD.StandardDeviation());
-	log("   Variance   %f", DD.Variance());
+	MeshAnalysis::QualityStat DD = MeshAnalysis(md.mm()->cm).vertexQualityStat();
+	logQualityStat(DD, outputValues);
 	return true;
 }
 
-bool FilterMeasurePlugin::perFaceQualityStat(MeshDocument& md)
+bool FilterMeasurePlugin::perFaceQualityStat(MeshDocument& md, std::map<std::string, QVariant>& outputValues)
 {
-	CMeshO &m = md.mm()->cm;
-	Distribution<MESHLAB_SCALAR> DD;
-	tri::Stat<CMeshO>::ComputePerFaceQualityDistribution(m, DD, false);
-
-	log("   Min %f Max %f", DD.Min(), DD.Max());
-	log("   Avg %f Med %f", DD.Avg(), DD.Percentile(0.5f));
-	log("   StdDev     %f", DD.StandardDeviation());
-	log("   Variance   %f", DD.Variance());
+	MeshAnalysis::QualityStat DD = MeshAnalysis(md.mm()->cm).faceQualityStat();
+	logQualityStat(DD, outputValues);
 	return true;
 }
 
-bool FilterMeasurePlugin::perVertexQualityHistogram(MeshDocument& md, float RangeMin, float RangeMax, int binNum, bool areaFlag)
+bool FilterMeasurePlugin::perVertexQualityHistogram(MeshDocument& md, std::map<std::string, QVariant>& outputValues, float RangeMin, float RangeMax, int binNum, bool areaFlag)
 {
-	CMeshO &m = md.mm()->cm;
-	tri::Allocator<CMeshO>::CompactEveryVector(m);
-
-	Histogramf H;
-	H.SetRange(RangeMin, RangeMax, binNum);
-	vector<Scalarm> aVec(m.vn, 1.0);
-	if (areaFlag)
-		tri::MeshToMatrix<CMeshO>::PerVertexArea(m, aVec);
-
-	for (int i = 0; i<m.vn; ++i)
-		H.Add(m.vert[i].Q(), aVec[i]);
-
-	if (areaFlag) {
-		log("(         -inf..%15.7f) : %15.7f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %15.7f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %15.7f", RangeMax, H.BinCountInd(binNum + 1));
-	}
-	else {
-		log("(         -inf..%15.7f) : %4.0f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %4.0f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %4.0f", RangeMax, H.BinCountInd(binNum + 1));
-	}
-
-	aVec = vector<Scalarm>(m.vn, 1.0);
-	if (areaFlag)
-		tri::MeshToMatrix<CMeshO>::PerVertexArea(m, aVec);
-
-	for (int i = 0; i<m.vn; ++i)
-		H.Add(m.vert[i].Q(), aVec[i]);
-	if (areaFlag) {
-		log("(         -inf..%15.7f) : %15.7f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %15.7f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %15.7f", RangeMax, H.BinCountInd(binNum + 1));
-	}
-	else {
-		log("(         -inf..%15.7f) : %4.0f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %4.0f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %4.0f", RangeMax, H.BinCountInd(binNum + 1));
-	}
+	std::vector<double> H = MeshAnalysis(md.mm()->cm).vertexQualityHistogram(RangeMin, RangeMax, binNum, areaFlag);
+	logHistogram(H, RangeMin, RangeMax, binNum, areaFlag, outputValues);
 	return true;
 }
 
-bool FilterMeasurePlugin::perFaceQualityHostogram(MeshDocument& md, float RangeMin, float RangeMax, int binNum, bool areaFlag)
+bool FilterMeasurePlugin::perFaceQualityHostogram(MeshDocument& md, std::map<std::string, QVariant>& outputValues, float RangeMin, float RangeMax, int binNum, bool areaFlag)
 {
-	CMeshO &m = md.mm()->cm;
-	tri::Allocator<CMeshO>::CompactEveryVector(m);
-
-	Histogramf H;
-	H.SetRange(RangeMin, RangeMax, binNum);
+	std::vector<double> H = MeshAnalysis(md.mm()->cm).faceQualityHistogram(RangeMin, RangeMax, binNum, areaFlag);
+	logHistogram(H, RangeMin, RangeMax, binNum, areaFlag, outputValues);
+	return true;
+}
 
-	vector<Scalarm> aVec(m.fn, 1.0);
-	if (areaFlag)
-		tri::MeshToMatrix<CMeshO>::PerFaceArea(m, aVec);
+void FilterMeasurePlugin::logQualityStat(const MeshAnalysis::QualityStat& DD, std::map<std::string, QVariant>& outputValues)
+{
+	log("   Min %f Max %f", DD.min, DD.max);
+	log("   Avg %f Med %f", DD.avg, DD.median);
+	log("   StdDev     %f", std::sqrt(DD.variance));
+	log("   Variance   %f", DD.variance);
+
+	outputValues["min"] = QVariant(DD.min);
+	outputValues["max"] = QVariant(DD.max);
+	outputValues["mean"] = QVariant(DD.avg);
+	outputValues["median"] = QVariant(DD.median);
+	outputValues["stddev"] = QVariant(std::sqrt(DD.variance));
+	outputValues["variance"] = QVariant(DD.variance);
+}
 
-	for (int i = 0; i<m.fn; ++i)
-		H.Add(m.face[i].Q(), aVec[i]);
-	if (areaFlag) {
-		log("(         -inf..%15.7f) : %15.7f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %15.7f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %15.7f", RangeMax, H.BinCountInd(binNum + 1));
-	}
-	else {
-		log("(         -inf..%15.7f) : %4.0f", RangeMin, H.BinCountInd(0));
-		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %4.0f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %4.0f", RangeMax, H.BinCountInd(binNum + 1));
+void FilterMeasurePlugin::logHistogram(const std::vector<double>& H, float RangeMin, float RangeMax, int binNum, bool areaFlag, std::map<std::string, QVariant>& outputValues)
+{
+	QVariantList binMin, binMax, count;
+	for (int i = 1; i <= binNum; ++i) {
+		binMin.push_back(RangeMin + (double(RangeMax) - RangeMin) * (i - 1) / binNum);
+		binMax.push_back(RangeMin + (double(RangeMax) - RangeMin) * i / binNum);
+		count.push_back(H[i]);
 	}
 
-	aVec = vector<Scalarm>(m.fn, 1.0);
-	if (areaFlag)
-		tri::MeshToMatrix<CMeshO>::PerFaceArea(m, aVec);
-
-	for (int i = 0; i<m.fn; ++i)
-		H.Add(m.face[i].Q(), aVec[i]);
 	if (areaFlag) {
-		log("(         -inf..%15.7f) : %15.7f", RangeMin, H.BinCountInd(0));
+		log("(         -inf..%15.7f) : %15.7f", RangeMin, H[0]);
 		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %15.7f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %15.7f", RangeMax, H.BinCountInd(binNum + 1));
+			log("[%15.7f..%15.7f) : %15.7f", binMin[i - 1].toDouble(), binMax[i - 1].toDouble(), H[i]);
+		log("[%15.7f..             +inf) : %15.7f", RangeMax, H[binNum + 1]);
 	}
 	else {
-		log("(         -inf..%15.7f) : %4.0f", RangeMin, H.BinCountInd(0));
+		log("(         -inf..%15.7f) : %4.0f", RangeMin, H[0]);
 		for (int i = 1; i <= binNum; ++i)
-			log("[%15.7f..%15.7f) : %4.0f", H.BinLowerBound(i), H.BinUpperBound(i), H.BinCountInd(i));
-		log("[%15.7f..             +inf) : %4.0f", RangeMax, H.BinCountInd(binNum + 1));
+			log("[%15.7f..%15.7f) : %4.0f", binMin[i - 1].toDouble(), binMax[i - 1].toDouble(), H[i]);
+		log("[%15.7f..             +inf) : %4.0f", RangeMax, H[binNum + 1]);
 	}
-	return true;
-}
-
-Matrix33m FilterMeasurePlugin::computePrincipalAxisCloud(CMeshO& m)
-{
-	Matrix33m cov;
-	Point3m bp(0, 0, 0);
-	std::vector<Point3m> PtVec;
-	for (CMeshO::VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-	if (!(*vi).IsD()) {
-		PtVec.push_back((*vi).cP());
-		bp += (*vi).cP();
-	}
-
-	bp /= m.vn;
-
-	cov.Covariance(PtVec, bp);
-
-	Matrix33m eigenvecMatrix;
-	Eigen::Matrix3d em;
-	cov.ToEigenMatrix(em);
-	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(em);
-	Eigen::Matrix3d c_vec = eig.eigenvectors();
-	eigenvecMatrix.FromEigenMatrix(c_vec);
 
-	return eigenvecMatrix;
+	outputValues["hist_bin_min"] = binMin;
+	outputValues["hist_bin_max"] = binMax;
+	outputValues["hist_count"] = count;
+	outputValues["below_range_count"] = QVariant(H[0]);
+	outputValues["above_range_count"] = QVariant(H[binNum + 1]);
 }
 
 MESHLAB_PLUGIN_NAME_EXPORTER(FilterMeasurePlugin)
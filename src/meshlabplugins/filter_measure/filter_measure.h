@@ -26,6 +26,8 @@
 
 #include <common/interfaces/filter_plugin_interface.h>
 
+#include "mesh_analysis.h"
+
 class FilterMeasurePlugin : public QObject, public FilterPluginInterface
 {
 	Q_OBJECT
@@ -58,18 +60,17 @@ public:
 	int postCondition(const QAction* ) const;
 
 private:
-	bool computeTopologicalMeasures(MeshDocument& md);
+	bool computeTopologicalMeasures(MeshDocument& md, std::map<std::string, QVariant>& outputValues);
 	bool computeTopologicalMeasuresForQuadMeshes(MeshDocument& md);
-	bool computeGeometricMeasures(MeshDocument& md);
-	bool computeAreaPerimeterOfSelection(MeshDocument& md);
-	bool perVertexQualityStat(MeshDocument& md);
-	bool perFaceQualityStat(MeshDocument& md);
-	bool perVertexQualityHistogram(MeshDocument& md, float RangeMin, float RangeMax, int binNum, bool areaFlag);
-	bool perFaceQualityHostogram(MeshDocument& md, float RangeMin, float RangeMax, int binNum, bool areaFlag);
-
-
-	Matrix33m computePrincipalAxisCloud(CMeshO & m);
+	bool computeGeometricMeasures(MeshDocument& md, std::map<std::string, QVariant>& outputValues);
+	bool computeAreaPerimeterOfSelection(MeshDocument& md, std::map<std::string, QVariant>& outputValues);
+	bool perVertexQualityStat(MeshDocument& md, std::map<std::string, QVariant>& outputValues);
+	bool perFaceQualityStat(MeshDocument& md, std::map<std::string, QVariant>& outputValues);
+	bool perVertexQualityHistogram(MeshDocument& md, std::map<std::string, QVariant>& outputValues, float RangeMin, float RangeMax, int binNum, bool areaFlag);
+	bool perFaceQualityHostogram(MeshDocument& md, std::map<std::string, QVariant>& outputValues, float RangeMin, float RangeMax, int binNum, bool areaFlag);
 
+	void logQualityStat(const MeshAnalysis::QualityStat& DD, std::map<std::string, QVariant>& outputValues);
+	void logHistogram(const std::vector<double>& H, float RangeMin, float RangeMax, int binNum, bool areaFlag, std::map<std::string, QVariant>& outputValues);
 };
 
 
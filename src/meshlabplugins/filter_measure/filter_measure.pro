@@ -1,9 +1,11 @@
 include (../../shared.pri)
 
 HEADERS += \
-    filter_measure.h
+    filter_measure.h \
+    mesh_analysis.h
 
 SOURCES += \
-    filter_measure.cpp
+    filter_measure.cpp \
+    mesh_analysis.cpp
 		
 TARGET = filter_measure
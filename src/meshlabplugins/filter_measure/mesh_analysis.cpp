@@ -0,0 +1,752 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "mesh_analysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include <Eigen/Eigenvalues>
+#include <vcg/complex/algorithms/clean.h>
+
+using namespace vcg;
+
+namespace {
+
+/*
+Union find that can be shared by the threads: the parents only move towards the roots,
+and a root is always linked under a smaller one, so there are no cycles.
+*/
+class ConcurrentUnionFind
+{
+public:
+	ConcurrentUnionFind(int n) : parent(n)
+	{
+		for (int i = 0; i < n; ++i)
+			parent[i].store(i, std::memory_order_relaxed);
+	}
+
+	int find(int x)
+	{
+		while (true) {
+			int p = parent[x].load();
+			if (p == x)
+				return x;
+			int gp = parent[p].load();
+			if (gp == p)
+				return p;
+			// path halving, a failure only means that someone else moved it
+			parent[x].compare_exchange_weak(p, gp);
+			x = gp;
+		}
+	}
+
+	void unite(int a, int b)
+	{
+		while (true) {
+			a = find(a);
+			b = find(b);
+			if (a == b)
+				return;
+			if (a < b)
+				std::swap(a, b);
+			int expected = a;
+			if (parent[a].compare_exchange_strong(expected, b))
+				return;
+		}
+	}
+
+private:
+	std::vector<std::atomic<int>> parent;
+};
+
+// sum over [0, n) of term(i), reduced per thread
+template <class T, class Term>
+T parallelSum(int n, const T& zero, Term term)
+{
+	T sum = zero;
+#pragma omp parallel
+	{
+		T local = zero;
+#pragma omp for schedule(static)
+		for (int i = 0; i < n; ++i)
+			term(i, local);
+#pragma omp critical
+		{
+			sum += local;
+		}
+	}
+	return sum;
+}
+
+struct Sum3
+{
+	double v[3];
+	double w;
+
+	Sum3() : v{0, 0, 0}, w(0) {}
+	Sum3& operator+=(const Sum3& s)
+	{
+		v[0] += s.v[0]; v[1] += s.v[1]; v[2] += s.v[2];
+		w += s.w;
+		return *this;
+	}
+	void add(const Point3m& p, double weight)
+	{
+		v[0] += p[0] * weight; v[1] += p[1] * weight; v[2] += p[2] * weight;
+		w += weight;
+	}
+	Point3m mean() const
+	{
+		return Point3m(v[0] / w, v[1] / w, v[2] / w);
+	}
+};
+
+struct Count3
+{
+	int c[3];
+
+	Count3() : c{0, 0, 0} {}
+	Count3& operator+=(const Count3& s)
+	{
+		c[0] += s.c[0]; c[1] += s.c[1]; c[2] += s.c[2];
+		return *this;
+	}
+};
+
+}
+
+MeshAnalysis::MeshAnalysis(CMeshO& m, bool applyTransform) :
+	m(m), transform(applyTransform && m.Tr != Matrix44m::Identity()), tr(m.Tr)
+{
+}
+
+/*
+Counting sort of the face edges on their lower vertex, then the edges of each vertex are
+sorted on the other vertex (and on the face, so that the result does not depend on the
+threads). The first face edge of each group is recorded in edgeFirst.
+*/
+void MeshAnalysis::buildEdges()
+{
+	const int vn = int(m.vert.size());
+	const int fn = int(m.face.size());
+	std::vector<size_t> first(vn + 1, 0);
+	for (int f = 0; f < fn; ++f) {
+		const CFaceO& face = m.face[f];
+		if (face.IsD())
+			continue;
+		for (int z = 0; z < 3; ++z)
+			++first[std::min(tri::Index(m, face.cV0(z)), tri::Index(m, face.cV1(z))) + 1];
+	}
+	for (int v = 0; v < vn; ++v)
+		first[v + 1] += first[v];
+
+	faceEdges.resize(first[vn]);
+	std::vector<size_t> pos(first.begin(), first.end() - 1);
+	for (int f = 0; f < fn; ++f) {
+		const CFaceO& face = m.face[f];
+		if (face.IsD())
+			continue;
+		for (int z = 0; z < 3; ++z) {
+			int a = tri::Index(m, face.cV0(z));
+			int b = tri::Index(m, face.cV1(z));
+			if (a > b)
+				std::swap(a, b);
+			faceEdges[pos[a]++] = FaceEdge{a, b, f, z};
+		}
+	}
+
+	std::vector<size_t> edgeCount(vn + 1, 0);
+#pragma omp parallel for schedule(dynamic, 4096)
+	for (int v = 0; v < vn; ++v) {
+		std::vector<FaceEdge>::iterator begin = faceEdges.begin() + first[v];
+		std::vector<FaceEdge>::iterator end = faceEdges.begin() + first[v + 1];
+		std::sort(begin, end, [](const FaceEdge& a, const FaceEdge& b) {
+			return a.v1 < b.v1 || (a.v1 == b.v1 && (a.face < b.face || (a.face == b.face && a.z < b.z)));
+		});
+		size_t count = 0;
+		for (std::vector<FaceEdge>::iterator it = begin; it != end; ++it)
+			if (it == begin || it->v1 != (it - 1)->v1)
+				++count;
+		edgeCount[v + 1] = count;
+	}
+	for (int v = 0; v < vn; ++v)
+		edgeCount[v + 1] += edgeCount[v];
+
+	edgeFirst.resize(edgeCount[vn] + 1);
+#pragma omp parallel for schedule(dynamic, 4096)
+	for (int v = 0; v < vn; ++v) {
+		size_t e = edgeCount[v];
+		for (size_t k = first[v]; k < first[v + 1]; ++k)
+			if (k == first[v] || faceEdges[k].v1 != faceEdges[k - 1].v1)
+				edgeFirst[e++] = k;
+	}
+	edgeFirst.back() = faceEdges.size();
+}
+
+void MeshAnalysis::buildVertexFaces()
+{
+	const int vn = int(m.vert.size());
+	const int fn = int(m.face.size());
+	vertFaceFirst.assign(vn + 1, 0);
+	for (int f = 0; f < fn; ++f)
+		if (!m.face[f].IsD())
+			for (int z = 0; z < 3; ++z)
+				++vertFaceFirst[tri::Index(m, m.face[f].cV(z)) + 1];
+	for (int v = 0; v < vn; ++v)
+		vertFaceFirst[v + 1] += vertFaceFirst[v];
+
+	vertFaces.resize(vertFaceFirst[vn]);
+	std::vector<size_t> pos(vertFaceFirst.begin(), vertFaceFirst.end() - 1);
+	for (int f = 0; f < fn; ++f)
+		if (!m.face[f].IsD())
+			for (int z = 0; z < 3; ++z)
+				vertFaces[pos[tri::Index(m, m.face[f].cV(z))]++] = f;
+}
+
+Point3m MeshAnalysis::P(const CVertexO* v) const
+{
+	return transform ? tr * v->cP() : v->cP();
+}
+
+Scalarm MeshAnalysis::doubleArea(int f) const
+{
+	const CFaceO& face = m.face[f];
+	const Point3m p0 = P(face.cV(0));
+	return ((P(face.cV(1)) - p0) ^ (P(face.cV(2)) - p0)).Norm();
+}
+
+void MeshAnalysis::edgeNum(int& edgeNum, int& borderEdgeNum, int& nonManifoldEdgeNum)
+{
+	if (edgeFirst.empty())
+		buildEdges();
+	const int en = int(edgeFirst.size()) - 1;
+	Count3 count = parallelSum(en, Count3(), [this](int e, Count3& c) {
+		const size_t mult = edgeFirst[e + 1] - edgeFirst[e];
+		++c.c[0];
+		if (mult == 1)
+			++c.c[1];
+		else if (mult > 2)
+			++c.c[2];
+	});
+	edgeNum = count.c[0];
+	borderEdgeNum = count.c[1];
+	nonManifoldEdgeNum = count.c[2];
+}
+
+/*
+A vertex that is not on a non manifold edge is non manifold if its incident faces do not
+form a single fan: the faces are joined when they share an edge of the vertex, and the
+fans are counted with a small union find.
+*/
+MeshAnalysis::Topology MeshAnalysis::topology()
+{
+	if (edgeFirst.empty())
+		buildEdges();
+	if (vertFaceFirst.empty())
+		buildVertexFaces();
+
+	const int vn = int(m.vert.size());
+	const int fn = int(m.face.size());
+	const int en = int(edgeFirst.size()) - 1;
+
+	Topology t;
+	t.vertNum = m.vn;
+	t.faceNum = m.fn;
+	edgeNum(t.edgeNum, t.borderEdgeNum, t.nonManifoldEdgeNum);
+
+	std::vector<char> faceOnNonManifoldEdge(fn, 0);
+	std::vector<char> vertOnNonManifoldEdge(vn, 0);
+	if (t.nonManifoldEdgeNum > 0)
+		for (int e = 0; e < en; ++e) {
+			if (edgeFirst[e + 1] - edgeFirst[e] <= 2)
+				continue;
+			vertOnNonManifoldEdge[faceEdges[edgeFirst[e]].v0] = 1;
+			vertOnNonManifoldEdge[faceEdges[edgeFirst[e]].v1] = 1;
+			for (size_t k = edgeFirst[e]; k < edgeFirst[e + 1]; ++k)
+				faceOnNonManifoldEdge[faceEdges[k].face] = 1;
+		}
+	t.nonManifoldEdgeFaceNum = int(std::count(faceOnNonManifoldEdge.begin(), faceOnNonManifoldEdge.end(), 1));
+
+	std::vector<char> nonManifoldVert(vn, 0);
+#pragma omp parallel
+	{
+		std::vector<std::pair<int, int>> spokes; // other vertex, local face index
+		std::vector<int> parent;
+#pragma omp for schedule(dynamic, 1024)
+		for (int v = 0; v < vn; ++v) {
+			const size_t begin = vertFaceFirst[v];
+			const int n = int(vertFaceFirst[v + 1] - begin);
+			if (n == 0 || m.vert[v].IsD() || vertOnNonManifoldEdge[v])
+				continue;
+			spokes.clear();
+			for (int k = 0; k < n; ++k) {
+				const CFaceO& face = m.face[vertFaces[begin + k]];
+				for (int z = 0; z < 3; ++z) {
+					const int w = tri::Index(m, face.cV(z));
+					if (w != v)
+						spokes.push_back(std::make_pair(w, k));
+				}
+			}
+			std::sort(spokes.begin(), spokes.end());
+			parent.resize(n);
+			std::iota(parent.begin(), parent.end(), 0);
+			auto root = [&parent](int x) {
+				while (parent[x] != x)
+					x = parent[x] = parent[parent[x]];
+				return x;
+			};
+			for (size_t k = 1; k < spokes.size(); ++k)
+				if (spokes[k].first == spokes[k - 1].first)
+					parent[root(spokes[k].second)] = root(spokes[k - 1].second);
+			int fans = 0;
+			for (int k = 0; k < n; ++k)
+				if (root(k) == k)
+					++fans;
+			if (fans > 1)
+				nonManifoldVert[v] = 1;
+		}
+	}
+	t.nonManifoldVertNum = int(std::count(nonManifoldVert.begin(), nonManifoldVert.end(), 1));
+
+	// selection: non manifold vertices and the faces incident on them
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < vn; ++v)
+		if (!m.vert[v].IsD()) {
+			if (nonManifoldVert[v])
+				m.vert[v].SetS();
+			else
+				m.vert[v].ClearS();
+		}
+	Count3 selected = parallelSum(fn, Count3(), [this, &nonManifoldVert](int f, Count3& c) {
+		CFaceO& face = m.face[f];
+		if (face.IsD())
+			return;
+		if (nonManifoldVert[tri::Index(m, face.cV(0))] || nonManifoldVert[tri::Index(m, face.cV(1))] || nonManifoldVert[tri::Index(m, face.cV(2))]) {
+			face.SetS();
+			++c.c[0];
+		}
+		else
+			face.ClearS();
+	});
+	t.nonManifoldVertFaceNum = selected.c[0];
+	m.svn = t.nonManifoldVertNum;
+	m.sfn = t.nonManifoldVertFaceNum;
+
+	// unreferenced vertices: no faces and no edges
+	std::vector<char> onEdge(vn, 0);
+	for (const CEdgeO& e : m.edge)
+		if (!e.IsD()) {
+			onEdge[tri::Index(m, e.cV(0))] = 1;
+			onEdge[tri::Index(m, e.cV(1))] = 1;
+		}
+	t.unreferencedVertNum = parallelSum(vn, 0, [this, &onEdge](int v, int& c) {
+		if (!m.vert[v].IsD() && vertFaceFirst[v] == vertFaceFirst[v + 1] && !onEdge[v])
+			++c;
+	});
+
+	// connected components: the faces are joined through their edges
+	ConcurrentUnionFind faceSets(fn);
+#pragma omp parallel for schedule(dynamic, 4096)
+	for (int e = 0; e < en; ++e)
+		for (size_t k = edgeFirst[e] + 1; k < edgeFirst[e + 1]; ++k)
+			faceSets.unite(faceEdges[edgeFirst[e]].face, faceEdges[k].face);
+	t.componentNum = parallelSum(fn, 0, [this, &faceSets](int f, int& c) {
+		if (!m.face[f].IsD() && faceSets.find(f) == f)
+			++c;
+	});
+
+	t.holeNum = -1;
+	t.genus = -1;
+	if (t.isTwoManifold()) {
+		// holes: the border vertices are joined through the border edges
+		ConcurrentUnionFind vertSets(vn);
+#pragma omp parallel for schedule(dynamic, 4096)
+		for (int e = 0; e < en; ++e)
+			if (edgeFirst[e + 1] - edgeFirst[e] == 1) {
+				const FaceEdge& fe = faceEdges[edgeFirst[e]];
+				vertSets.unite(fe.v0, fe.v1);
+			}
+		// marked serially: the border vertices are shared by the border edges
+		std::vector<char> borderVert(vn, 0);
+		for (int e = 0; e < en; ++e)
+			if (edgeFirst[e + 1] - edgeFirst[e] == 1) {
+				borderVert[faceEdges[edgeFirst[e]].v0] = 1;
+				borderVert[faceEdges[edgeFirst[e]].v1] = 1;
+			}
+		t.holeNum = parallelSum(vn, 0, [&borderVert, &vertSets](int v, int& c) {
+			if (borderVert[v] && vertSets.find(v) == v)
+				++c;
+		});
+		t.genus = tri::Clean<CMeshO>::MeshGenus(m.vn - t.unreferencedVertNum, t.edgeNum, m.fn, t.holeNum, t.componentNum);
+	}
+	return t;
+}
+
+MeshAnalysis::VolumeIntegrals::VolumeIntegrals() :
+	T0(0), T1{0, 0, 0}, T2{0, 0, 0}, TP{0, 0, 0}
+{
+}
+
+MeshAnalysis::VolumeIntegrals& MeshAnalysis::VolumeIntegrals::operator+=(const VolumeIntegrals& v)
+{
+	T0 += v.T0;
+	for (int i = 0; i < 3; ++i) {
+		T1[i] += v.T1[i];
+		T2[i] += v.T2[i];
+		TP[i] += v.TP[i];
+	}
+	return *this;
+}
+
+Scalarm MeshAnalysis::VolumeIntegrals::mass() const
+{
+	return Scalarm(T0);
+}
+
+Point3m MeshAnalysis::VolumeIntegrals::centerOfMass() const
+{
+	return Point3m(T1[0] / T0, T1[1] / T0, T1[2] / T0);
+}
+
+void MeshAnalysis::VolumeIntegrals::inertiaTensor(Matrix33m& J) const
+{
+	const Point3m r = centerOfMass();
+	// inertia with respect to the origin
+	J[0][0] = T2[1] + T2[2];
+	J[1][1] = T2[2] + T2[0];
+	J[2][2] = T2[0] + T2[1];
+	J[0][1] = J[1][0] = -TP[0];
+	J[1][2] = J[2][1] = -TP[1];
+	J[2][0] = J[0][2] = -TP[2];
+
+	// translated to the center of mass
+	J[0][0] -= T0 * (r[1] * r[1] + r[2] * r[2]);
+	J[1][1] -= T0 * (r[2] * r[2] + r[0] * r[0]);
+	J[2][2] -= T0 * (r[0] * r[0] + r[1] * r[1]);
+	J[0][1] = J[1][0] += T0 * r[0] * r[1];
+	J[1][2] = J[2][1] += T0 * r[1] * r[2];
+	J[2][0] = J[0][2] += T0 * r[2] * r[0];
+}
+
+void MeshAnalysis::VolumeIntegrals::inertiaTensorEigen(Matrix33m& EV, Point3m& ev) const
+{
+	Matrix33m J;
+	inertiaTensor(J);
+	Eigen::Matrix3d em;
+	J.ToEigenMatrix(em);
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(em);
+	const Eigen::Matrix3d vec = eig.eigenvectors();
+	const Eigen::Vector3d val = eig.eigenvalues();
+	// the axes are the rows of EV
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+			EV[i][j] = vec(j, i);
+	ev = Point3m(val[0], val[1], val[2]);
+}
+
+Box3m MeshAnalysis::boundingBox() const
+{
+	const int vn = int(m.vert.size());
+	Box3m box;
+#pragma omp parallel
+	{
+		Box3m local;
+#pragma omp for schedule(static)
+		for (int v = 0; v < vn; ++v)
+			if (!m.vert[v].IsD())
+				local.Add(P(&m.vert[v]));
+#pragma omp critical
+		{
+			box.Add(local);
+		}
+	}
+	return box;
+}
+
+Scalarm MeshAnalysis::area() const
+{
+	const double doubleSum = parallelSum(int(m.face.size()), 0.0, [this](int f, double& s) {
+		if (!m.face[f].IsD())
+			s += doubleArea(f);
+	});
+	return Scalarm(doubleSum / 2.0);
+}
+
+void MeshAnalysis::edgeLength(bool includeFaux, int& count, Scalarm& total)
+{
+	if (edgeFirst.empty())
+		buildEdges();
+	const int en = int(edgeFirst.size()) - 1;
+	Sum3 sum = parallelSum(en, Sum3(), [this, includeFaux](int e, Sum3& s) {
+		bool real = includeFaux;
+		for (size_t k = edgeFirst[e]; k < edgeFirst[e + 1] && !real; ++k)
+			real = !m.face[faceEdges[k].face].IsF(faceEdges[k].z);
+		if (!real)
+			return;
+		const FaceEdge& fe = faceEdges[edgeFirst[e]];
+		s.v[0] += Distance(P(&m.vert[fe.v0]), P(&m.vert[fe.v1]));
+		s.w += 1;
+	});
+	count = int(sum.w);
+	total = Scalarm(sum.v[0]);
+}
+
+Point3m MeshAnalysis::shellBarycenter() const
+{
+	Sum3 sum = parallelSum(int(m.face.size()), Sum3(), [this](int f, Sum3& s) {
+		const CFaceO& face = m.face[f];
+		if (!face.IsD())
+			s.add((P(face.cV(0)) + P(face.cV(1)) + P(face.cV(2))) / 3.0, doubleArea(f));
+	});
+	return sum.mean();
+}
+
+Point3m MeshAnalysis::cloudBarycenter(bool qualityWeighted) const
+{
+	Sum3 sum = parallelSum(int(m.vert.size()), Sum3(), [this, qualityWeighted](int v, Sum3& s) {
+		const CVertexO& vert = m.vert[v];
+		if (!vert.IsD())
+			s.add(P(&vert), qualityWeighted ? double(vert.cQ()) : 1.0);
+	});
+	return sum.mean();
+}
+
+/*
+The same eigenvectors of computePrincipalAxisCloud: the covariance is accumulated in
+parallel around the barycenter of the vertices.
+*/
+Matrix33m MeshAnalysis::cloudPrincipalAxes() const
+{
+	struct Covariance
+	{
+		double c[3][3];
+
+		Covariance() : c{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}} {}
+		Covariance& operator+=(const Covariance& s)
+		{
+			for (int i = 0; i < 3; ++i)
+				for (int j = 0; j < 3; ++j)
+					c[i][j] += s.c[i][j];
+			return *this;
+		}
+	};
+
+	const Point3m bp = cloudBarycenter(false);
+	Covariance cov = parallelSum(int(m.vert.size()), Covariance(), [this, &bp](int v, Covariance& s) {
+		if (m.vert[v].IsD())
+			return;
+		const Point3m d = P(&m.vert[v]) - bp;
+		for (int i = 0; i < 3; ++i)
+			for (int j = 0; j < 3; ++j)
+				s.c[i][j] += double(d[i]) * d[j];
+	});
+
+	Eigen::Matrix3d em;
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+			em(i, j) = cov.c[i][j];
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(em);
+	Eigen::Matrix3d c_vec = eig.eigenvectors();
+	Matrix33m eigenvecMatrix;
+	eigenvecMatrix.FromEigenMatrix(c_vec);
+	return eigenvecMatrix;
+}
+
+/*
+The integrals of 1, x, x^2 and xy over the volume, as sums of the signed tetrahedra
+between the origin and each face.
+*/
+MeshAnalysis::VolumeIntegrals MeshAnalysis::volumeIntegrals() const
+{
+	return parallelSum(int(m.face.size()), VolumeIntegrals(), [this](int f, VolumeIntegrals& I) {
+		const CFaceO& face = m.face[f];
+		if (face.IsD())
+			return;
+		const Point3m pa = P(face.cV(0)), pb = P(face.cV(1)), pc = P(face.cV(2));
+		const double a[3] = {pa[0], pa[1], pa[2]};
+		const double b[3] = {pb[0], pb[1], pb[2]};
+		const double c[3] = {pc[0], pc[1], pc[2]};
+		// six times the signed volume of the tetrahedron
+		const double d = a[0] * (b[1] * c[2] - b[2] * c[1])
+		               - a[1] * (b[0] * c[2] - b[2] * c[0])
+		               + a[2] * (b[0] * c[1] - b[1] * c[0]);
+		I.T0 += d / 6.0;
+		double s[3];
+		for (int i = 0; i < 3; ++i) {
+			s[i] = a[i] + b[i] + c[i];
+			I.T1[i] += d / 24.0 * s[i];
+			I.T2[i] += d / 60.0 * (a[i] * a[i] + b[i] * b[i] + c[i] * c[i] + a[i] * b[i] + a[i] * c[i] + b[i] * c[i]);
+		}
+		for (int i = 0; i < 3; ++i) {
+			const int j = (i + 1) % 3;
+			I.TP[i] += d / 120.0 * (a[i] * a[j] + b[i] * b[j] + c[i] * c[j] + s[i] * s[j]);
+		}
+	});
+}
+
+MeshAnalysis::QualityStat MeshAnalysis::vertexQualityStat() const
+{
+	std::vector<Scalarm> values;
+	values.reserve(m.vn);
+	for (const CVertexO& v : m.vert)
+		if (!v.IsD())
+			values.push_back(v.cQ());
+	return qualityStat(values);
+}
+
+MeshAnalysis::QualityStat MeshAnalysis::faceQualityStat() const
+{
+	std::vector<Scalarm> values;
+	values.reserve(m.fn);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			values.push_back(f.cQ());
+	return qualityStat(values);
+}
+
+/*
+Min, max and average in one parallel pass, the variance in a second one around the
+average; the median is the element of Distribution::Percentile(0.5).
+*/
+MeshAnalysis::QualityStat MeshAnalysis::qualityStat(std::vector<Scalarm>& values) const
+{
+	struct MinMaxSum
+	{
+		double min, max, sum;
+
+		MinMaxSum() : min(std::numeric_limits<double>::max()), max(-std::numeric_limits<double>::max()), sum(0) {}
+		MinMaxSum& operator+=(const MinMaxSum& s)
+		{
+			min = std::min(min, s.min);
+			max = std::max(max, s.max);
+			sum += s.sum;
+			return *this;
+		}
+	};
+
+	QualityStat stat;
+	stat.count = int(values.size());
+	if (values.empty()) {
+		stat.min = stat.max = stat.avg = stat.median = stat.variance = 0;
+		return stat;
+	}
+
+	const int n = stat.count;
+	MinMaxSum mms = parallelSum(n, MinMaxSum(), [&values](int i, MinMaxSum& s) {
+		s.min = std::min<double>(s.min, values[i]);
+		s.max = std::max<double>(s.max, values[i]);
+		s.sum += values[i];
+	});
+	const double avg = mms.sum / n;
+	const double sq = parallelSum(n, 0.0, [&values, avg](int i, double& s) {
+		s += (values[i] - avg) * (values[i] - avg);
+	});
+
+	stat.min = Scalarm(mms.min);
+	stat.max = Scalarm(mms.max);
+	stat.avg = Scalarm(avg);
+	stat.variance = Scalarm(sq / n);
+
+	const int mid = std::max(0, int(n * 0.5 - 1));
+	std::nth_element(values.begin(), values.begin() + mid, values.end());
+	stat.median = values[mid];
+	return stat;
+}
+
+std::vector<double> MeshAnalysis::vertexQualityHistogram(Scalarm min, Scalarm max, int binNum, bool areaWeighted)
+{
+	std::vector<Scalarm> values;
+	std::vector<Scalarm> weights;
+	if (areaWeighted && vertFaceFirst.empty())
+		buildVertexFaces();
+
+	const int vn = int(m.vert.size());
+	values.reserve(m.vn);
+	if (areaWeighted)
+		weights.reserve(m.vn);
+	for (int v = 0; v < vn; ++v) {
+		if (m.vert[v].IsD())
+			continue;
+		values.push_back(m.vert[v].cQ());
+		if (areaWeighted) {
+			// a third of the area of the incident faces
+			Scalarm a = 0;
+			for (size_t k = vertFaceFirst[v]; k < vertFaceFirst[v + 1]; ++k)
+				a += doubleArea(vertFaces[k]) / 6.0;
+			weights.push_back(a);
+		}
+	}
+	return histogram(values, weights, min, max, binNum);
+}
+
+std::vector<double> MeshAnalysis::faceQualityHistogram(Scalarm min, Scalarm max, int binNum, bool areaWeighted) const
+{
+	std::vector<Scalarm> values;
+	std::vector<Scalarm> weights;
+	const int fn = int(m.face.size());
+	values.reserve(m.fn);
+	if (areaWeighted)
+		weights.reserve(m.fn);
+	for (int f = 0; f < fn; ++f) {
+		if (m.face[f].IsD())
+			continue;
+		values.push_back(m.face[f].cQ());
+		if (areaWeighted)
+			weights.push_back(doubleArea(f) / 2.0);
+	}
+	return histogram(values, weights, min, max, binNum);
+}
+
+// per thread bins, merged at the end; no weights means a weight of one for each value
+std::vector<double> MeshAnalysis::histogram(const std::vector<Scalarm>& values, const std::vector<Scalarm>& weights, Scalarm min, Scalarm max, int binNum) const
+{
+	const int n = int(values.size());
+	const double range = double(max) - double(min);
+	std::vector<double> bins(binNum + 2, 0.0);
+#pragma omp parallel
+	{
+		std::vector<double> local(binNum + 2, 0.0);
+#pragma omp for schedule(static)
+		for (int i = 0; i < n; ++i) {
+			const double q = values[i];
+			int bin;
+			if (q < min)
+				bin = 0;
+			else if (q >= max || range <= 0)
+				bin = binNum + 1;
+			else
+				bin = std::min(binNum, 1 + int((q - min) / range * binNum));
+			local[bin] += weights.empty() ? 1.0 : double(weights[i]);
+		}
+#pragma omp critical
+		{
+			for (int b = 0; b < binNum + 2; ++b)
+				bins[b] += local[b];
+		}
+	}
+	return bins;
+}
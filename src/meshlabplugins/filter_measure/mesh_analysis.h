@@ -0,0 +1,150 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_MEASURE_MESH_ANALYSIS_H
+#define FILTER_MEASURE_MESH_ANALYSIS_H
+
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+MeshAnalysis
+Parallel computation of the topological and geometric measures of a mesh, the same of
+tri::Clean, tri::Stat and tri::Inertia, without building the FF and VF topology of the mesh.
+
+The face edges are grouped once by their vertices (counting sort on the lower vertex, then
+each group of a vertex is sorted on its own): each group is an edge of the mesh, with all
+the faces incident on it, and it is shared by all the measures that need the edges (edge
+count, borders, manifoldness, connected components, holes, edge lengths). The faces
+incident on each vertex are collected in the same way when needed.
+The integrals (area, barycenters, volume and inertia) and the histograms are parallel
+reductions over faces or vertices.
+
+If applyTransform is true the measures are computed on the mesh transformed by its matrix
+(Tr), without changing the mesh.
+*/
+class MeshAnalysis
+{
+public:
+	MeshAnalysis(CMeshO& m, bool applyTransform = false);
+
+	struct Topology
+	{
+		int vertNum;
+		int edgeNum;
+		int faceNum;
+		int unreferencedVertNum;
+		int borderEdgeNum;
+		int nonManifoldEdgeNum;
+		int nonManifoldEdgeFaceNum; // faces incident on non manifold edges
+		int nonManifoldVertNum;     // not counting the vertices of non manifold edges
+		int nonManifoldVertFaceNum; // faces incident on non manifold vertices
+		int componentNum;
+		int holeNum;                // -1 if the mesh is not two manifold
+		int genus;                  // -1 if the mesh is not two manifold
+
+		bool isTwoManifold() const { return nonManifoldEdgeNum == 0 && nonManifoldVertNum == 0; }
+	};
+
+	// as Clean::CountNonManifoldVertexFF and UpdateSelection::FaceFromVertexLoose, it leaves
+	// selected the non manifold vertices and the faces incident on them
+	Topology topology();
+
+	// tri::Clean<CMeshO>::CountEdgeNum
+	void edgeNum(int& edgeNum, int& borderEdgeNum, int& nonManifoldEdgeNum);
+
+	struct VolumeIntegrals
+	{
+		double T0;
+		double T1[3];
+		double T2[3];
+		double TP[3]; // xy, yz, zx
+
+		VolumeIntegrals();
+		VolumeIntegrals& operator+=(const VolumeIntegrals& v);
+
+		// the same of tri::Inertia
+		Scalarm mass() const;
+		Point3m centerOfMass() const;
+		void inertiaTensor(Matrix33m& J) const;
+		void inertiaTensorEigen(Matrix33m& EV, Point3m& ev) const;
+	};
+
+	Box3m boundingBox() const;
+	Scalarm area() const;
+	// length of the edges of the faces, each one counted once (faux edges only if includeFaux)
+	void edgeLength(bool includeFaux, int& count, Scalarm& total);
+	Point3m shellBarycenter() const;
+	Point3m cloudBarycenter(bool qualityWeighted) const;
+	// eigenvectors of the covariance of the vertices
+	Matrix33m cloudPrincipalAxes() const;
+	// volume integrals of a closed mesh
+	VolumeIntegrals volumeIntegrals() const;
+
+	struct QualityStat
+	{
+		Scalarm min;
+		Scalarm max;
+		Scalarm avg;
+		Scalarm median;
+		Scalarm variance;
+		int count;
+	};
+
+	QualityStat vertexQualityStat() const;
+	QualityStat faceQualityStat() const;
+
+	// binNum + 2 bins: (-inf, min), the binNum bins of [min, max), [max, +inf); the count of
+	// each bin is the number of elements or their area (a third of the incident faces for vertices)
+	std::vector<double> vertexQualityHistogram(Scalarm min, Scalarm max, int binNum, bool areaWeighted);
+	std::vector<double> faceQualityHistogram(Scalarm min, Scalarm max, int binNum, bool areaWeighted) const;
+
+private:
+	struct FaceEdge
+	{
+		int v0, v1; // v0 < v1
+		int face;
+		int z;
+	};
+
+	void buildEdges();
+	void buildVertexFaces();
+	Point3m P(const CVertexO* v) const;
+	Scalarm doubleArea(int f) const;
+	QualityStat qualityStat(std::vector<Scalarm>& values) const;
+	std::vector<double> histogram(const std::vector<Scalarm>& values, const std::vector<Scalarm>& weights, Scalarm min, Scalarm max, int binNum) const;
+
+	CMeshO& m;
+	bool transform;
+	Matrix44m tr;
+
+	// the face edges sorted by vertices; the edge e is faceEdges[edgeFirst[e]] ... faceEdges[edgeFirst[e+1]-1]
+	std::vector<FaceEdge> faceEdges;
+	std::vector<size_t> edgeFirst;
+	// the faces incident on vertex v are vertFaces[vertFaceFirst[v]] ... vertFaces[vertFaceFirst[v+1]-1]
+	std::vector<int> vertFaces;
+	std::vector<size_t> vertFaceFirst;
+};
+
+#endif // FILTER_MEASURE_MESH_ANALYSIS_H
@@ -1,11 +1,17 @@
 include (../../shared.pri)
 
 HEADERS += \
+    knn_normals.h \
+    ooc_clustering.h \
+    parallel_remeshing.h \
     quadric_simp.h \
     meshfilter.h
 
 SOURCES += \
+    knn_normals.cpp \
     meshfilter.cpp \
+    ooc_clustering.cpp \
+    parallel_remeshing.cpp \
     quadric_simp.cpp
 
 TARGET = filter_meshing
@@ -0,0 +1,163 @@
+/****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005                                                \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.																											 *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#include "knn_normals.h"
+
+#include <algorithm>
+#include <vector>
+#include <vcg/space/fitting3.h>
+#include <vcg/complex/algorithms/update/flag.h>
+#include <common/ml_document/knn_graph.h>
+
+using namespace vcg;
+
+namespace {
+
+struct CoherenceArc
+{
+	int s, t;
+	Scalarm w;
+	CoherenceArc(int s, int t, Scalarm w) : s(s), t(t), w(w) {}
+	bool operator<(const CoherenceArc &a) const { return w < a.w; }
+};
+
+void SmoothNormals(CMeshO &m, const KnnGraph &graph, int neighbourNum, int iterNum)
+{
+	const int vn = int(m.vert.size());
+	std::vector<Point3m> smoothed(vn);
+	for (int it = 0; it < iterNum; ++it)
+	{
+		//the new normals are written apart, so every vertex reads the normals of the previous iteration
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < vn; ++i)
+		{
+			if (m.vert[i].IsD()) continue;
+			const Point3m &ni = m.vert[i].cN();
+			Point3m sum = ni;
+			const int *nb = graph.neighbours(i);
+			const int nn = graph.neighbourNum(i, neighbourNum - 1);
+			for (int j = 0; j < nn; ++j)
+			{
+				const Point3m &nj = m.vert[nb[j]].cN();
+				if (ni * nj > 0) sum += nj;
+				else sum -= nj;
+			}
+			smoothed[i] = sum;
+		}
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			if (m.vert[i].IsD()) continue;
+			if (smoothed[i].SquaredNorm() > 0)
+				m.vert[i].N() = smoothed[i].Normalize();
+		}
+	}
+}
+
+void AddCoherenceArcs(const CMeshO &m, const KnnGraph &graph, int s, int coherentAdjNum, std::vector<CoherenceArc> &heap)
+{
+	const int *nb = graph.neighbours(s);
+	const int nn = graph.neighbourNum(s, coherentAdjNum - 1);
+	for (int j = 0; j < nn; ++j)
+	{
+		const CVertexO &t = m.vert[nb[j]];
+		if (t.IsV()) continue;
+		//almost orthogonal normals do not tell anything about the orientation
+		Scalarm w = std::abs(m.vert[s].cN() * t.cN());
+		if (w < Scalarm(0.3)) continue;
+		heap.push_back(CoherenceArc(s, nb[j], w));
+		std::push_heap(heap.begin(), heap.end());
+	}
+}
+
+}
+
+void PointCloudNormalKnn(CMeshO &m, int fittingAdjNum, int smoothingIterNum, int coherentAdjNum,
+                         bool useViewPoint, const Point3m &viewPoint, vcg::CallBackPos *cb)
+{
+	fittingAdjNum = std::max(fittingAdjNum, 3);
+	coherentAdjNum = std::max(coherentAdjNum, 2);
+	const KnnGraph &graph = KnnGraph::get(m, std::max(fittingAdjNum, coherentAdjNum) - 1, cb);
+	const int vn = int(m.vert.size());
+
+	if (cb) cb(50, "Fitting planes");
+#pragma omp parallel
+	{
+		std::vector<Point3m> ptVec;
+#pragma omp for schedule(dynamic, 1024)
+		for (int i = 0; i < vn; ++i)
+		{
+			if (m.vert[i].IsD()) continue;
+			ptVec.clear();
+			ptVec.push_back(m.vert[i].cP());
+			const int *nb = graph.neighbours(i);
+			const int nn = graph.neighbourNum(i, fittingAdjNum - 1);
+			for (int j = 0; j < nn; ++j)
+				ptVec.push_back(m.vert[nb[j]].cP());
+			Plane3m plane;
+			FitPlaneToPointSet(ptVec, plane);
+			m.vert[i].N() = plane.Direction();
+		}
+	}
+
+	SmoothNormals(m, graph, fittingAdjNum, smoothingIterNum);
+
+	if (useViewPoint)
+	{
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			if (!m.vert[i].IsD() && m.vert[i].cN() * (viewPoint - m.vert[i].cP()) < 0)
+				m.vert[i].N() = -m.vert[i].cN();
+		}
+		return;
+	}
+
+	//the orientation is propagated from an arbitrary seed for each group of coherent vertices
+	if (cb) cb(80, "Orienting normals");
+	tri::UpdateFlags<CMeshO>::VertexClearV(m);
+	std::vector<CoherenceArc> heap;
+	for (int seed = 0; seed < vn; ++seed)
+	{
+		if (m.vert[seed].IsD() || m.vert[seed].IsV()) continue;
+		m.vert[seed].SetV();
+		AddCoherenceArcs(m, graph, seed, coherentAdjNum, heap);
+		while (!heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			CoherenceArc a = heap.back();
+			heap.pop_back();
+			CVertexO &t = m.vert[a.t];
+			if (t.IsV()) continue;
+			t.SetV();
+			if (m.vert[a.s].cN() * t.cN() < 0)
+				t.N() = -t.cN();
+			AddCoherenceArcs(m, graph, a.t, coherentAdjNum, heap);
+		}
+	}
+}
+
+void PointCloudNormalSmoothKnn(CMeshO &m, int neighbourNum, int iterNum, vcg::CallBackPos *cb)
+{
+	neighbourNum = std::max(neighbourNum, 2);
+	const KnnGraph &graph = KnnGraph::get(m, neighbourNum - 1, cb);
+	SmoothNormals(m, graph, neighbourNum, iterNum);
+}
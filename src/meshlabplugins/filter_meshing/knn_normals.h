@@ -0,0 +1,36 @@
+/****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005                                                \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.																											 *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#ifndef FILTER_MESHING_KNN_NORMALS_H
+#define FILTER_MESHING_KNN_NORMALS_H
+
+#include <common/ml_document/cmesh.h>
+#include <wrap/callback.h>
+
+// Point cloud normal estimation and smoothing on the cached kNN graph (see KnnGraph).
+// They follow tri::PointCloudNormal and tri::Smooth::VertexNormalPointCloud:
+// neighbourhood sizes count the vertex itself, orientation is propagated along a
+// maximum coherence spanning tree unless a viewpoint is given.
+void PointCloudNormalKnn(CMeshO &m, int fittingAdjNum, int smoothingIterNum, int coherentAdjNum,
+                         bool useViewPoint, const Point3m &viewPoint, vcg::CallBackPos *cb);
+void PointCloudNormalSmoothKnn(CMeshO &m, int neighbourNum, int iterNum, vcg::CallBackPos *cb);
+
+#endif
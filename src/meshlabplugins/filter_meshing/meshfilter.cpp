@@ -37,6 +37,9 @@
 #include <vcg/space/fitting3.h>
 #include <wrap/gl/glu_tessellator_cap.h>
 #include "quadric_simp.h"
+#include "knn_normals.h"
+#include "ooc_clustering.h"
+#include "parallel_remeshing.h"
 
 using namespace std;
 using namespace vcg;
@@ -50,6 +53,7 @@ ExtraMeshFilterPlugin::ExtraMeshFilterPlugin(void)
 	    << FP_CLUSTERING
 	    << FP_QUADRIC_SIMPLIFICATION
 	    << FP_QUADRIC_TEXCOORD_SIMPLIFICATION
+	    << FP_OUT_OF_CORE_SIMPLIFICATION
 	    << FP_EXPLICIT_ISOTROPIC_REMESHING
 	    << FP_MIDPOINT
 	    << FP_REORIENT
@@ -111,6 +115,7 @@ ExtraMeshFilterPlugin::ExtraMeshFilterPlugin(void)
 	lastisor_SwapFlag            = true;
 	lastisor_ProjectFlag         = true;
 	lastisor_FeatureDeg          = 30.0f;
+	lastisor_Parallel            = false;
 }
 
 QString ExtraMeshFilterPlugin::pluginName() const
@@ -127,6 +132,7 @@ ExtraMeshFilterPlugin::FilterClass ExtraMeshFilterPlugin::getClass(const QAction
 		case FP_MIDPOINT                         :
 		case FP_QUADRIC_SIMPLIFICATION           :
 		case FP_QUADRIC_TEXCOORD_SIMPLIFICATION  :
+		case FP_OUT_OF_CORE_SIMPLIFICATION       :
 		case FP_EXPLICIT_ISOTROPIC_REMESHING     :
 		case FP_CLUSTERING                       :
 		case FP_CLOSE_HOLES                      :
@@ -198,6 +204,7 @@ int ExtraMeshFilterPlugin::getPreConditions(const QAction *filter) const
 		case FP_REFINE_LS3_LOOP                  : return MeshModel::MM_FACENUMBER;
 		case FP_NORMAL_SMOOTH_POINTCLOUD         : return MeshModel::MM_VERTNORMAL;
 		case FP_CLUSTERING                       :
+		case FP_OUT_OF_CORE_SIMPLIFICATION       :
 		case FP_SCALE                            :
 		case FP_CENTER                           :
 		case FP_ROTATE                           :
@@ -224,6 +231,7 @@ QString ExtraMeshFilterPlugin::filterName(FilterIDType filter) const
 		case FP_REFINE_CATMULL                   : return tr("Subdivision Surfaces: Catmull-Clark");
 	case FP_QUADRIC_SIMPLIFICATION           : return tr("Simplification: Quadric Edge Collapse Decimation");
 		case FP_QUADRIC_TEXCOORD_SIMPLIFICATION  : return tr("Simplification: Quadric Edge Collapse Decimation (with texture)");
+		case FP_OUT_OF_CORE_SIMPLIFICATION       : return tr("Simplification: Out-of-core Clustering and Quadric Edge Collapse");
 		case FP_EXPLICIT_ISOTROPIC_REMESHING     : return tr("Remeshing: Isotropic Explicit Remeshing");
 		case FP_CLUSTERING                       : return tr("Simplification: Clustering Decimation");
 		case FP_REORIENT                         : return tr("Re-Orient all faces coherentely");
@@ -290,6 +298,7 @@ QString ExtraMeshFilterPlugin::filterInfo(FilterIDType filterID) const
 		case FP_CLUSTERING                         : return tr("Collapse vertices by creating a three dimensional grid enveloping the mesh and discretizes them based on the cells of this grid");
 		case FP_QUADRIC_SIMPLIFICATION             : return tr("Simplify a mesh using a Quadric based Edge Collapse Strategy; better than clustering but slower");
 		case FP_QUADRIC_TEXCOORD_SIMPLIFICATION    : return tr("Simplify a textured mesh using a Quadric based Edge Collapse Strategy preserving UV parametrization; better than clustering but slower");
+		case FP_OUT_OF_CORE_SIMPLIFICATION         : return tr("Simplify a PLY file too large to be loaded, creating a new layer. The file is streamed from disk and its vertices are clustered on a grid, with each cell represented by the point minimizing the quadric error of its faces (out-of-core clustering); the resulting intermediate mesh, whose size depends only on the number of cells, is then simplified to the target number of faces by the Quadric Edge Collapse Decimation.<br>The memory used depends on the intermediate size, not on the size of the input; the per vertex data of the input is kept in a temporary file.");
 		case FP_EXPLICIT_ISOTROPIC_REMESHING       : return tr("Perform a explicit remeshing of a triangular mesh, by repeatedly applying edge flip, collapse, relax and refine to improve aspect ratio (triangle quality) and topological regularity.");
 		case FP_REORIENT                           : return tr("Re-orient in a consistent way all the faces of the mesh. <br>"
 			                                               "The filter visits a mesh face to face, reorienting any unvisited face so that it is coherent "
@@ -378,6 +387,16 @@ void ExtraMeshFilterPlugin::initParameterList(const QAction * action, MeshModel
 			parlst.addParam(RichBool ("Selected",m.cm.sfn>0,"Simplify only selected faces","The simplification is applied only to the selected set of faces.\n Take care of the target number of faces!"));
 			break;
 
+		case FP_OUT_OF_CORE_SIMPLIFICATION:
+			parlst.addParam(RichOpenFile("FileName", "", QStringList("*.ply"), "PLY file", "The PLY file (ascii or binary) to simplify; it is read in chunks and never loaded in memory."));
+			parlst.addParam(RichInt  ("TargetFaceNum", 1000000, "Target number of faces", "The desired final number of faces."));
+			parlst.addParam(RichInt  ("IntermediateFaceNum", 4000000, "Intermediate number of faces", "The approximate number of faces of the mesh produced by the out-of-core clustering, that is then simplified in memory; it sets the number of cells of the clustering grid (about half of this value) and so the memory used. Larger values give better results."));
+			parlst.addParam(RichFloat("QualityThr",lastq_QualityThr,"Quality threshold","Quality threshold for penalizing bad shaped faces.<br>The value is in the range [0..1]\n 0 accept any kind of face (no penalties),\n 0.5  penalize faces with quality < 0.5, proportionally to their shape\n"));
+			parlst.addParam(RichBool ("PreserveBoundary",lastq_PreserveBoundary,"Preserve Boundary of the mesh","The simplification process tries to do not affect mesh boundaries during simplification"));
+			parlst.addParam(RichBool ("PreserveNormal",lastq_PreserveNormal,"Preserve Normal","Try to avoid face flipping effects and try to preserve the original orientation of the surface"));
+			parlst.addParam(RichBool ("OptimalPlacement",lastq_OptimalPlacement,"Optimal position of simplified vertices","Each collapsed vertex is placed in the position minimizing the quadric error.\n It can fail (creating bad spikes) in case of very flat areas. \nIf disabled edges are collapsed onto one of the two original vertices and the final mesh is composed by a subset of the original vertices. "));
+			break;
+
 		case FP_QUADRIC_TEXCOORD_SIMPLIFICATION:
 			parlst.addParam(RichInt  ("TargetFaceNum", (m.cm.sfn>0) ? m.cm.sfn/2 : m.cm.fn/2,"Target number of faces"));
 			parlst.addParam(RichFloat("TargetPerc", 0,"Percentage reduction (0..1)", "If non zero, this parameter specifies the desired final size of the mesh as a percentage of the initial mesh."));
@@ -406,6 +425,7 @@ void ExtraMeshFilterPlugin::initParameterList(const QAction * action, MeshModel
 			parlst.addParam(RichBool ("SwapFlag", lastisor_SwapFlag, "Edge-Swap Step", "If checked the remeshing operations will include a edge-swap step, aimed at improving the vertex valence of the resulting mesh."));
 			parlst.addParam(RichBool ("SmoothFlag", lastisor_SmoothFlag, "Smooth Step", "If checked the remeshing operations will include a smoothing step, aimed at relaxing the vertex positions in a Laplacian sense."));
 			parlst.addParam(RichBool ("ReprojectFlag", lastisor_ProjectFlag, "Reproject Step", "If checked the remeshing operations will include a step to reproject the mesh vertices on the original surface."));
+			parlst.addParam(RichBool ("Parallel", lastisor_Parallel, "Parallel", "If checked the remeshing runs on all the cores: at each step the edges are processed in rounds of non conflicting operations, and the smoothing and reprojection move all the vertices at once. The result is equivalent but not identical to the serial one."));
 
 			break;
 		case FP_CLOSE_HOLES:
@@ -674,8 +694,12 @@ void ApplyTransform(MeshDocument &md, const Matrix44m &tr, bool toAllFlag, bool
 }
 
 
-bool ExtraMeshFilterPlugin::applyFilter(const QAction * filter, MeshDocument & md, std::map<std::string, QVariant>&, unsigned int& /*postConditionMask*/, const RichParameterList & par, vcg::CallBackPos * cb)
+bool ExtraMeshFilterPlugin::applyFilter(const QAction * filter, MeshDocument & md, std::map<std::string, QVariant>& outputValues, unsigned int& /*postConditionMask*/, const RichParameterList & par, vcg::CallBackPos * cb)
 {
+// it does not need a current mesh, it creates a new layer
+if (ID(filter) == FP_OUT_OF_CORE_SIMPLIFICATION)
+	return outOfCoreSimplification(md, outputValues, par, cb);
+
 MeshModel & m = *md.mm();
 
 switch(ID(filter))
@@ -936,7 +960,12 @@ switch(ID(filter))
 	} break;
 	case FP_EXPLICIT_ISOTROPIC_REMESHING:
 	{
-		m.updateDataMask( MeshModel::MM_FACEFACETOPO  | MeshModel::MM_VERTFACETOPO | 
+		const bool parallel = par.getBool("Parallel");
+		// the parallel remeshing keeps its own adjacency, the one of the mesh would be stale
+		if (parallel)
+			m.clearDataMask(MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTFACETOPO);
+		else
+			m.updateDataMask( MeshModel::MM_FACEFACETOPO  | MeshModel::MM_VERTFACETOPO | 
                           MeshModel::MM_VERTQUALITY | MeshModel::MM_FACEMARK | 
                           MeshModel::MM_FACEFLAG | MeshModel::MM_VERTMARK );
 
@@ -981,16 +1010,41 @@ switch(ID(filter))
 
 		lastisor_MaxSurfDist= par.getFloat("MaxSurfDist");
 		lastisor_FeatureDeg = par.getFloat("FeatureDeg");
+		lastisor_Parallel   = parallel;
 
-		try
+		if (parallel)
 		{
-			tri::IsotropicRemeshing<CMeshO>::Do(m.cm, toProjectCopy, params, cb);
+			ParallelIsotropicRemeshing::Params pp;
+			pp.targetLen       = par.getAbsPerc("TargetLen");
+			pp.featureAngleDeg = par.getFloat("FeatureDeg");
+			pp.maxSurfDist     = params.maxSurfDist;
+			pp.iter            = params.iter;
+			pp.adapt           = params.adapt;
+			pp.selectedOnly    = params.selectedOnly;
+			pp.splitFlag       = params.splitFlag;
+			pp.collapseFlag    = params.collapseFlag;
+			pp.swapFlag        = params.swapFlag;
+			pp.smoothFlag      = params.smoothFlag;
+			pp.projectFlag     = params.projectFlag;
+			pp.surfDistCheck   = params.surfDistCheck;
+
+			ParallelIsotropicRemeshing remeshing(m.cm, pp);
+			remeshing.run(toProjectCopy, cb);
+			tri::Allocator<CMeshO>::CompactEveryVector(m.cm);
+			log("Parallel remeshing: %i splits, %i collapses, %i flips", remeshing.splitNum(), remeshing.collapseNum(), remeshing.flipNum());
 		}
-		catch(vcg::MissingPreconditionException& excp)
+		else
 		{
-			log(excp.what());
-			errorMessage = excp.what();
-			return false;
+			try
+			{
+				tri::IsotropicRemeshing<CMeshO>::Do(m.cm, toProjectCopy, params, cb);
+			}
+			catch(vcg::MissingPreconditionException& excp)
+			{
+				log(excp.what());
+				errorMessage = excp.what();
+				return false;
+			}
 		}
 		m.UpdateBoxAndNormals();
 
@@ -1294,13 +1348,12 @@ switch(ID(filter))
 		p.smoothingIterNum = par.getInt("smoothIter");
 		p.viewPoint = par.getPoint3m("viewPos");
 		p.useViewPoint = par.getBool("flipFlag");
-		tri::PointCloudNormal<CMeshO>::Compute(m.cm, p,cb);
+		PointCloudNormalKnn(m.cm, p.fittingAdjNum, p.smoothingIterNum, p.coherentAdjNum, p.useViewPoint, p.viewPoint, cb);
 	} break;
 
 	case FP_NORMAL_SMOOTH_POINTCLOUD :
 	{
-		tri::Allocator<CMeshO>::CompactVertexVector(m.cm);
-		tri::Smooth<CMeshO>::VertexNormalPointCloud(m.cm,par.getInt("K"),1);
+		PointCloudNormalSmoothKnn(m.cm, par.getInt("K"), 1, cb);
 	} break;
 
 	case FP_COMPUTE_PRINC_CURV_DIR:
@@ -1804,10 +1857,85 @@ int ExtraMeshFilterPlugin::postCondition(const QAction * filter) const
 
 		case FP_SLICE_WITH_A_PLANE :
 		case FP_PERIMETER_POLYLINE :
+		case FP_OUT_OF_CORE_SIMPLIFICATION :
 		case FP_CYLINDER_UNWRAP : return MeshModel::MM_NONE; // they create a new layer
 
 		default                  : return MeshModel::MM_ALL;
 	}
 }
 
+FilterPluginInterface::FILTER_ARITY ExtraMeshFilterPlugin::filterArity(const QAction *filter) const
+{
+	switch (ID(filter))
+	{
+		case FP_OUT_OF_CORE_SIMPLIFICATION : return NONE;
+		default                            : return SINGLE_MESH;
+	}
+}
+
+/*
+The out-of-core clustering reduces the input file to an intermediate mesh that fits in
+memory; the intermediate mesh is then simplified by the same steps of
+FP_QUADRIC_SIMPLIFICATION (with the default values of the parameters not exposed).
+*/
+bool ExtraMeshFilterPlugin::outOfCoreSimplification(MeshDocument &md, std::map<std::string, QVariant>& outputValues, const RichParameterList &par, vcg::CallBackPos *cb)
+{
+	const QString fileName = par.getOpenFileName("FileName");
+	const int TargetFaceNum = par.getInt("TargetFaceNum");
+	const int intermediateFaceNum = std::max(TargetFaceNum, par.getInt("IntermediateFaceNum"));
+
+	// on a surface there are about two faces for each vertex (and cell)
+	OutOfCoreClustering clustering(fileName);
+	CMeshO clustered;
+	if (!clustering.extract(std::max(1, intermediateFaceNum / 2), clustered, cb))
+	{
+		errorMessage = clustering.errorMessage();
+		return false;
+	}
+	log("Out-of-core clustering: %llu vertices and %llu faces reduced to %i vertices and %i faces",
+		(unsigned long long) clustering.inputVertNum(), (unsigned long long) clustering.inputFaceNum(), clustered.vn, clustered.fn);
+
+	MeshModel *mm = md.addNewMesh("", QFileInfo(fileName).completeBaseName() + "_simplified", true);
+	tri::Append<CMeshO, CMeshO>::MeshCopy(mm->cm, clustered);
+	clustered.Clear();
+	tri::Clean<CMeshO>::RemoveDuplicateFace(mm->cm);
+
+	const int clusteredFaceNum = mm->cm.fn;
+	if (mm->cm.fn > TargetFaceNum)
+	{
+		mm->updateDataMask( MeshModel::MM_VERTFACETOPO | MeshModel::MM_VERTMARK);
+		tri::UpdateFlags<CMeshO>::FaceBorderFromVF(mm->cm);
+
+		tri::TriEdgeCollapseQuadricParameter pp;
+		pp.QualityThr = lastq_QualityThr = par.getFloat("QualityThr");
+		pp.PreserveBoundary = lastq_PreserveBoundary = par.getBool("PreserveBoundary");
+		pp.NormalCheck = lastq_PreserveNormal = par.getBool("PreserveNormal");
+		pp.OptimalPlacement = lastq_OptimalPlacement = par.getBool("OptimalPlacement");
+
+		QuadricSimplification(mm->cm, TargetFaceNum, false, pp, cb);
+
+		int nullFaces=tri::Clean<CMeshO>::RemoveFaceOutOfRangeArea(mm->cm,0);
+		if(nullFaces) log( "PostSimplification Cleaning: Removed %d null faces", nullFaces);
+		int deldupvert=tri::Clean<CMeshO>::RemoveDuplicateVertex(mm->cm);
+		if(deldupvert) log( "PostSimplification Cleaning: Removed %d duplicated vertices", deldupvert);
+		int delvert=tri::Clean<CMeshO>::RemoveUnreferencedVertex(mm->cm);
+		if(delvert) log( "PostSimplification Cleaning: Removed %d unreferenced vertices",delvert);
+		mm->clearDataMask(MeshModel::MM_VERTFACETOPO | MeshModel::MM_VERTMARK);
+	}
+	tri::Allocator<CMeshO>::CompactVertexVector(mm->cm);
+	tri::Allocator<CMeshO>::CompactFaceVector(mm->cm);
+
+	mm->UpdateBoxAndNormals();
+	tri::UpdateNormal<CMeshO>::NormalizePerFace(mm->cm);
+	tri::UpdateNormal<CMeshO>::PerVertexFromCurrentFaceNormal(mm->cm);
+	tri::UpdateNormal<CMeshO>::NormalizePerVertex(mm->cm);
+
+	outputValues["input_vertices"] = QVariant(qulonglong(clustering.inputVertNum()));
+	outputValues["input_faces"] = QVariant(qulonglong(clustering.inputFaceNum()));
+	outputValues["clustered_faces"] = QVariant(clusteredFaceNum);
+	outputValues["output_vertices"] = QVariant(mm->cm.vn);
+	outputValues["output_faces"] = QVariant(mm->cm.fn);
+	return true;
+}
+
 MESHLAB_PLUGIN_NAME_EXPORTER(ExtraMeshFilterPlugin)
@@ -76,7 +76,8 @@ public:
 		FP_FAUX_CREASE,
 		FP_FAUX_EXTRACT,
 		FP_VATTR_SEAM,
-		FP_REFINE_LS3_LOOP
+		FP_REFINE_LS3_LOOP,
+		FP_OUT_OF_CORE_SIMPLIFICATION
 	} ;
 
 
@@ -92,9 +93,10 @@ public:
 	bool applyFilter(const QAction* filter, MeshDocument &md, std::map<std::string, QVariant>& outputValues, unsigned int& postConditionMask, const RichParameterList & /*parent*/, vcg::CallBackPos * cb) ;
 	int postCondition(const QAction *filter) const;
 	int getPreConditions(const QAction *filter) const;
-	FILTER_ARITY filterArity(const QAction *) const {return SINGLE_MESH;}
+	FILTER_ARITY filterArity(const QAction *filter) const;
 
 protected:
+	bool outOfCoreSimplification(MeshDocument &md, std::map<std::string, QVariant>& outputValues, const RichParameterList &par, vcg::CallBackPos *cb);
 
 	float lastq_QualityThr;
 	bool lastq_QualityWeight;
@@ -121,6 +123,7 @@ protected:
 	bool lastisor_SwapFlag;
 	bool lastisor_SmoothFlag;
 	bool lastisor_ProjectFlag;
+	bool lastisor_Parallel;
 
 };
 #endif
@@ -0,0 +1,606 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "ooc_clustering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QFile>
+#include <QSysInfo>
+#include <QTemporaryFile>
+
+#include <Eigen/Eigenvalues>
+#include <common/utilities/ascii_chunk_reader.h>
+
+using namespace vcg;
+
+namespace {
+
+enum PlyType { PLY_INVALID, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+PlyType plyType(const QByteArray& s)
+{
+	if (s == "char" || s == "int8") return PLY_INT8;
+	if (s == "uchar" || s == "uint8") return PLY_UINT8;
+	if (s == "short" || s == "int16") return PLY_INT16;
+	if (s == "ushort" || s == "uint16") return PLY_UINT16;
+	if (s == "int" || s == "int32") return PLY_INT32;
+	if (s == "uint" || s == "uint32") return PLY_UINT32;
+	if (s == "float" || s == "float32") return PLY_FLOAT32;
+	if (s == "double" || s == "float64") return PLY_FLOAT64;
+	return PLY_INVALID;
+}
+
+int plyTypeSize(PlyType t)
+{
+	switch (t) {
+	case PLY_INT8: case PLY_UINT8: return 1;
+	case PLY_INT16: case PLY_UINT16: return 2;
+	case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+	case PLY_FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+struct PlyProperty
+{
+	QByteArray name;
+	PlyType type;      // type of the value, or of the items of a list
+	bool list;
+	PlyType countType; // type of the size of a list
+};
+
+struct PlyElement
+{
+	QByteArray name;
+	size_t count;
+	std::vector<PlyProperty> props;
+
+	int property(const QByteArray& name) const
+	{
+		for (size_t i = 0; i < props.size(); ++i)
+			if (props[i].name == name)
+				return int(i);
+		return -1;
+	}
+};
+
+/*
+Sequential reader of the element records of a PLY file, through a buffer of a few MB:
+the records are read one at a time and nothing else is kept in memory.
+*/
+class PlyStream
+{
+public:
+	PlyStream() : ascii(false), swap(false), pos(0), len(0) {}
+
+	bool open(const QString& fileName, QString& error);
+	const std::vector<PlyElement>& elements() const { return elems; }
+
+	/*
+	Reads the next record of e: the scalar properties are stored in values (one for each
+	property of e), the items of the list property listProp (if any) in list.
+	*/
+	bool read(const PlyElement& e, double* values, int listProp, std::vector<long long>& list);
+	bool skip(const PlyElement& e);
+
+private:
+	static const size_t BUFFER_SIZE = 4 << 20;
+
+	bool fill(size_t n);
+	bool value(PlyType t, double& v);
+	bool token(const char*& begin, const char*& end);
+
+	QFile file;
+	bool ascii;
+	bool swap; // the file and the machine have different endianness
+	std::vector<PlyElement> elems;
+	std::vector<char> buf;
+	size_t pos;
+	size_t len;
+};
+
+bool PlyStream::open(const QString& fileName, QString& error)
+{
+	file.setFileName(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		error = "Unable to open " + fileName;
+		return false;
+	}
+	if (file.readLine().trimmed() != "ply") {
+		error = fileName + " is not a PLY file";
+		return false;
+	}
+	bool formatFound = false;
+	while (true) {
+		if (file.atEnd()) {
+			error = "Unexpected end of the PLY header";
+			return false;
+		}
+		const QList<QByteArray> tokens = file.readLine().simplified().split(' ');
+		const QByteArray& key = tokens[0];
+		if (key == "end_header")
+			break;
+		if (key == "format" && tokens.size() >= 2) {
+			formatFound = true;
+			ascii = tokens[1] == "ascii";
+			const bool bigEndian = tokens[1] == "binary_big_endian";
+			if (!ascii && !bigEndian && tokens[1] != "binary_little_endian") {
+				error = "Unknown PLY format " + QString(tokens[1]);
+				return false;
+			}
+			swap = !ascii && (bigEndian != (QSysInfo::ByteOrder == QSysInfo::BigEndian));
+		}
+		else if (key == "element" && tokens.size() >= 3) {
+			PlyElement e;
+			e.name = tokens[1];
+			e.count = tokens[2].toULongLong();
+			elems.push_back(e);
+		}
+		else if (key == "property" && !elems.empty()) {
+			PlyProperty p;
+			if (tokens.size() >= 5 && tokens[1] == "list") {
+				p.list = true;
+				p.countType = plyType(tokens[2]);
+				p.type = plyType(tokens[3]);
+				p.name = tokens[4];
+			}
+			else if (tokens.size() >= 3) {
+				p.list = false;
+				p.countType = PLY_INVALID;
+				p.type = plyType(tokens[1]);
+				p.name = tokens[2];
+			}
+			else
+				p.type = PLY_INVALID;
+			if (p.type == PLY_INVALID || (p.list && p.countType == PLY_INVALID)) {
+				error = "Unsupported PLY property in the header";
+				return false;
+			}
+			elems.back().props.push_back(p);
+		}
+	}
+	if (!formatFound) {
+		error = "Missing format in the PLY header";
+		return false;
+	}
+	buf.resize(BUFFER_SIZE);
+	return true;
+}
+
+// at least n bytes in the buffer after pos; false at the end of the file
+bool PlyStream::fill(size_t n)
+{
+	if (len - pos >= n)
+		return true;
+	std::memmove(buf.data(), buf.data() + pos, len - pos);
+	len -= pos;
+	pos = 0;
+	while (len < buf.size()) {
+		const qint64 r = file.read(buf.data() + len, qint64(buf.size() - len));
+		if (r <= 0)
+			break;
+		len += size_t(r);
+	}
+	return len >= n;
+}
+
+bool PlyStream::token(const char*& begin, const char*& end)
+{
+	while (true) {
+		while (pos < len && (AsciiChunkReader::isBlank(buf[pos]) || buf[pos] == '\n'))
+			++pos;
+		if (pos == len) {
+			if (!fill(1))
+				return false;
+			continue;
+		}
+		size_t e = pos;
+		while (e < len && !AsciiChunkReader::isBlank(buf[e]) && buf[e] != '\n')
+			++e;
+		if (e < len || file.atEnd()) {
+			begin = buf.data() + pos;
+			end = buf.data() + e;
+			pos = e;
+			return true;
+		}
+		// the token continues in the next part of the file
+		if (pos == 0 && len == buf.size())
+			return false;
+		fill(e - pos + 1);
+	}
+}
+
+bool PlyStream::value(PlyType t, double& v)
+{
+	if (ascii) {
+		const char* b;
+		const char* e;
+		return token(b, e) && AsciiChunkReader::toDouble(b, e, v);
+	}
+
+	const int size = plyTypeSize(t);
+	if (!fill(size))
+		return false;
+	unsigned char raw[8];
+	std::memcpy(raw, buf.data() + pos, size);
+	pos += size;
+	if (swap)
+		std::reverse(raw, raw + size);
+	switch (t) {
+	case PLY_INT8:    { qint8 x; std::memcpy(&x, raw, 1); v = x; break; }
+	case PLY_UINT8:   { quint8 x; std::memcpy(&x, raw, 1); v = x; break; }
+	case PLY_INT16:   { qint16 x; std::memcpy(&x, raw, 2); v = x; break; }
+	case PLY_UINT16:  { quint16 x; std::memcpy(&x, raw, 2); v = x; break; }
+	case PLY_INT32:   { qint32 x; std::memcpy(&x, raw, 4); v = x; break; }
+	case PLY_UINT32:  { quint32 x; std::memcpy(&x, raw, 4); v = x; break; }
+	case PLY_FLOAT32: { float x; std::memcpy(&x, raw, 4); v = x; break; }
+	case PLY_FLOAT64: { double x; std::memcpy(&x, raw, 8); v = x; break; }
+	default: return false;
+	}
+	return true;
+}
+
+bool PlyStream::read(const PlyElement& e, double* values, int listProp, std::vector<long long>& list)
+{
+	for (size_t k = 0; k < e.props.size(); ++k) {
+		const PlyProperty& p = e.props[k];
+		if (!p.list) {
+			if (!value(p.type, values[k]))
+				return false;
+			continue;
+		}
+		double count;
+		if (!value(p.countType, count) || count < 0)
+			return false;
+		const int n = int(count);
+		if (int(k) == listProp)
+			list.resize(n);
+		for (int j = 0; j < n; ++j) {
+			double item;
+			if (!value(p.type, item))
+				return false;
+			if (int(k) == listProp)
+				list[j] = (long long)item;
+		}
+	}
+	return true;
+}
+
+bool PlyStream::skip(const PlyElement& e)
+{
+	std::vector<double> values(e.props.size());
+	std::vector<long long> list;
+	for (size_t i = 0; i < e.count; ++i)
+		if (!read(e, values.data(), -1, list))
+			return false;
+	return true;
+}
+
+// what is written for each input vertex in the temporary file
+struct VertexRecord
+{
+	float p[3];
+	quint32 cell;
+};
+
+struct Cell
+{
+	quint64 key;
+	double A[6]; // quadric: xx xy xz yy yz zz
+	double b[3];
+	double sum[3];
+	double n;
+
+	Cell(quint64 k) : key(k), A{0, 0, 0, 0, 0, 0}, b{0, 0, 0}, sum{0, 0, 0}, n(0) {}
+
+	void addPoint(const Point3d& p)
+	{
+		sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2];
+		n += 1;
+	}
+
+	// squared distance from the plane of the face, weighted by its area
+	void addPlane(const Point3d& u, double d, double w)
+	{
+		A[0] += w * u[0] * u[0]; A[1] += w * u[0] * u[1]; A[2] += w * u[0] * u[2];
+		A[3] += w * u[1] * u[1]; A[4] += w * u[1] * u[2]; A[5] += w * u[2] * u[2];
+		b[0] += w * d * u[0]; b[1] += w * d * u[1]; b[2] += w * d * u[2];
+	}
+};
+
+struct Triangle
+{
+	quint32 v[3];
+
+	// the same triangle (with the same orientation) has always the same vertex first
+	Triangle(quint32 a, quint32 b, quint32 c)
+	{
+		if (a < b && a < c) { v[0] = a; v[1] = b; v[2] = c; }
+		else if (b < c)     { v[0] = b; v[1] = c; v[2] = a; }
+		else                { v[0] = c; v[1] = a; v[2] = b; }
+	}
+	bool operator==(const Triangle& t) const { return v[0] == t.v[0] && v[1] == t.v[1] && v[2] == t.v[2]; }
+};
+
+struct TriangleHash
+{
+	size_t operator()(const Triangle& t) const
+	{
+		return size_t(t.v[0]) * 73856093u ^ size_t(t.v[1]) * 19349663u ^ size_t(t.v[2]) * 83492791u;
+	}
+};
+
+/*
+The point minimizing the quadric of the cell; the directions where the quadric is almost
+flat keep the coordinate of the average of the vertices of the cell (pseudo inverse),
+and representatives too far from the cell fall back on the average.
+*/
+Point3d representative(const Cell& c, const Point3d& cellMin, double cellSize)
+{
+	const Point3d mean(c.sum[0] / c.n, c.sum[1] / c.n, c.sum[2] / c.n);
+	Eigen::Matrix3d A;
+	A << c.A[0], c.A[1], c.A[2],
+	     c.A[1], c.A[3], c.A[4],
+	     c.A[2], c.A[4], c.A[5];
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(A);
+	const Eigen::Vector3d lambda = eig.eigenvalues();
+	if (!(lambda[2] > 0))
+		return mean;
+
+	const Eigen::Vector3d x0(mean[0], mean[1], mean[2]);
+	const Eigen::Vector3d r = -Eigen::Vector3d(c.b[0], c.b[1], c.b[2]) - A * x0;
+	Eigen::Vector3d x = x0;
+	for (int i = 0; i < 3; ++i)
+		if (lambda[i] > 1e-3 * lambda[2])
+			x += eig.eigenvectors().col(i) * (eig.eigenvectors().col(i).dot(r) / lambda[i]);
+
+	for (int i = 0; i < 3; ++i)
+		if (x[i] < cellMin[i] - cellSize || x[i] > cellMin[i] + 2 * cellSize)
+			return mean;
+	return Point3d(x[0], x[1], x[2]);
+}
+
+}
+
+OutOfCoreClustering::OutOfCoreClustering(const QString& fileName) :
+	fileName(fileName), vertNum(0), faceNum(0)
+{
+}
+
+bool OutOfCoreClustering::extract(int cellNum, CMeshO& m, CallBackPos* cb)
+{
+	// first pass: the bounding box of the vertices
+	PlyStream ply;
+	if (!ply.open(fileName, error))
+		return false;
+	const std::vector<PlyElement>& elems = ply.elements();
+	int vertElem = -1, faceElem = -1;
+	for (size_t i = 0; i < elems.size(); ++i) {
+		if (elems[i].name == "vertex" && vertElem < 0)
+			vertElem = int(i);
+		else if (elems[i].name == "face" && faceElem < 0)
+			faceElem = int(i);
+	}
+	if (vertElem < 0) {
+		error = "The PLY file has no vertices";
+		return false;
+	}
+	if (faceElem >= 0 && faceElem < vertElem) {
+		error = "PLY files with the faces before the vertices are not supported";
+		return false;
+	}
+	const PlyElement& ve = elems[vertElem];
+	const int px = ve.property("x"), py = ve.property("y"), pz = ve.property("z");
+	if (px < 0 || py < 0 || pz < 0 || ve.props[px].list || ve.props[py].list || ve.props[pz].list) {
+		error = "The vertices of the PLY file have no coordinates";
+		return false;
+	}
+	int faceList = -1;
+	if (faceElem >= 0) {
+		faceList = elems[faceElem].property("vertex_indices");
+		if (faceList < 0)
+			faceList = elems[faceElem].property("vertex_index");
+		if (faceList < 0 || !elems[faceElem].props[faceList].list) {
+			error = "The faces of the PLY file have no vertex indices";
+			return false;
+		}
+	}
+	vertNum = ve.count;
+	faceNum = faceElem >= 0 ? elems[faceElem].count : 0;
+	if (vertNum == 0 || vertNum > std::numeric_limits<quint32>::max()) {
+		error = "Unsupported number of vertices in the PLY file";
+		return false;
+	}
+
+	const double totalWork = 2.0 * vertNum + faceNum;
+	size_t work = 0;
+	auto progress = [&work, totalWork, cb](const char* msg) {
+		if (cb && (++work & 0xFFFFF) == 0)
+			cb(int(100 * work / totalWork), msg);
+	};
+
+	std::vector<double> values(std::max(ve.props.size(), faceElem >= 0 ? elems[faceElem].props.size() : 0));
+	std::vector<long long> list;
+	for (int i = 0; i < vertElem; ++i)
+		if (!ply.skip(elems[i])) {
+			error = "Unexpected end of the PLY file";
+			return false;
+		}
+	Box3d box;
+	for (size_t i = 0; i < vertNum; ++i) {
+		if (!ply.read(ve, values.data(), -1, list)) {
+			error = "Unexpected end of the PLY file";
+			return false;
+		}
+		box.Add(Point3d(values[px], values[py], values[pz]));
+		progress("Out-of-core clustering: bounding box");
+	}
+
+	// the grid
+	Point3d size = box.Dim();
+	const double minSide = box.Diag() > 0 ? box.Diag() * 1e-4 : 1.0;
+	for (int i = 0; i < 3; ++i)
+		size[i] = std::max(size[i], minSide);
+	const double cellSize = std::cbrt(size[0] * size[1] * size[2] / std::max(cellNum, 1));
+	Point3i dim;
+	for (int i = 0; i < 3; ++i)
+		dim[i] = std::max(1, int(std::ceil(size[i] / cellSize)));
+	auto cellOf = [&box, &dim, cellSize](const Point3d& p, Point3i& c) {
+		for (int i = 0; i < 3; ++i)
+			c[i] = std::min(dim[i] - 1, std::max(0, int((p[i] - box.min[i]) / cellSize)));
+		return (quint64(c[0]) * dim[1] + c[1]) * dim[2] + c[2];
+	};
+
+	// second pass: the cells of the vertices, then the faces
+	PlyStream ply2;
+	if (!ply2.open(fileName, error))
+		return false;
+	for (int i = 0; i < vertElem; ++i)
+		if (!ply2.skip(elems[i])) {
+			error = "Unexpected end of the PLY file";
+			return false;
+		}
+
+	QTemporaryFile recordFile;
+	std::vector<VertexRecord> recordMemory;
+	VertexRecord* records = nullptr;
+	const qint64 recordBytes = qint64(vertNum * sizeof(VertexRecord));
+	if (recordFile.open() && recordFile.resize(recordBytes))
+		records = reinterpret_cast<VertexRecord*>(recordFile.map(0, recordBytes));
+	if (records == nullptr) {
+		// no temporary file (or no address space to map it): keep the records in memory
+		try {
+			recordMemory.resize(vertNum);
+		}
+		catch (std::bad_alloc&) {
+			error = "Not enough memory for the vertices of the PLY file";
+			return false;
+		}
+		records = recordMemory.data();
+	}
+
+	std::unordered_map<quint64, quint32> cellIndex;
+	std::vector<Cell> cells;
+	cellIndex.reserve(size_t(cellNum));
+	cells.reserve(size_t(cellNum));
+	for (size_t i = 0; i < vertNum; ++i) {
+		if (!ply2.read(ve, values.data(), -1, list)) {
+			error = "Unexpected end of the PLY file";
+			return false;
+		}
+		const Point3d p(values[px], values[py], values[pz]);
+		Point3i c;
+		const quint64 key = cellOf(p, c);
+		auto it = cellIndex.find(key);
+		if (it == cellIndex.end()) {
+			it = cellIndex.insert(std::make_pair(key, quint32(cells.size()))).first;
+			cells.push_back(Cell(key));
+		}
+		cells[it->second].addPoint(p);
+		VertexRecord& r = records[i];
+		r.p[0] = float(p[0]); r.p[1] = float(p[1]); r.p[2] = float(p[2]);
+		r.cell = it->second;
+		progress("Out-of-core clustering: vertices");
+	}
+
+	std::unordered_set<Triangle, TriangleHash> triangles;
+	if (faceElem >= 0) {
+		for (int i = vertElem + 1; i < faceElem; ++i)
+			if (!ply2.skip(elems[i])) {
+				error = "Unexpected end of the PLY file";
+				return false;
+			}
+		const PlyElement& fe = elems[faceElem];
+		for (size_t i = 0; i < faceNum; ++i) {
+			if (!ply2.read(fe, values.data(), faceList, list)) {
+				error = "Unexpected end of the PLY file";
+				return false;
+			}
+			progress("Out-of-core clustering: faces");
+			bool valid = list.size() >= 3;
+			for (size_t j = 0; j < list.size() && valid; ++j)
+				valid = list[j] >= 0 && size_t(list[j]) < vertNum;
+			if (!valid)
+				continue;
+			for (size_t j = 1; j + 1 < list.size(); ++j) {
+				const VertexRecord* v[3] = {&records[list[0]], &records[list[j]], &records[list[j + 1]]};
+				Point3d p[3];
+				for (int k = 0; k < 3; ++k)
+					p[k] = Point3d(v[k]->p[0], v[k]->p[1], v[k]->p[2]);
+				Point3d n = (p[1] - p[0]) ^ (p[2] - p[0]);
+				const double doubleArea = n.Norm();
+				if (doubleArea > 0) {
+					n /= doubleArea;
+					const double d = -(n * p[0]);
+					for (int k = 0; k < 3; ++k)
+						cells[v[k]->cell].addPlane(n, d, doubleArea / 2);
+				}
+				if (v[0]->cell != v[1]->cell && v[1]->cell != v[2]->cell && v[2]->cell != v[0]->cell)
+					triangles.insert(Triangle(v[0]->cell, v[1]->cell, v[2]->cell));
+			}
+		}
+	}
+
+	// the clustered mesh: a vertex for each cell used by a triangle (each cell for point clouds)
+	std::vector<int> cellVert(cells.size(), faceElem >= 0 ? -1 : 0);
+	for (const Triangle& t : triangles)
+		for (int k = 0; k < 3; ++k)
+			cellVert[t.v[k]] = 0;
+	int usedNum = 0;
+	for (int& cv : cellVert)
+		if (cv == 0)
+			cv = usedNum++;
+
+	m.Clear();
+	tri::Allocator<CMeshO>::AddVertices(m, usedNum);
+	const int cn = int(cells.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < cn; ++i) {
+		if (cellVert[i] < 0)
+			continue;
+		const quint64 key = cells[i].key;
+		const Point3d cellMin(
+			box.min[0] + cellSize * double(key / (quint64(dim[1]) * dim[2])),
+			box.min[1] + cellSize * double((key / dim[2]) % dim[1]),
+			box.min[2] + cellSize * double(key % dim[2]));
+		m.vert[cellVert[i]].P() = Point3m::Construct(representative(cells[i], cellMin, cellSize));
+	}
+
+	tri::Allocator<CMeshO>::AddFaces(m, triangles.size());
+	size_t f = 0;
+	for (const Triangle& t : triangles) {
+		for (int k = 0; k < 3; ++k)
+			m.face[f].V(k) = &m.vert[cellVert[t.v[k]]];
+		++f;
+	}
+	if (cb)
+		cb(100, "Out-of-core clustering: done");
+	return true;
+}
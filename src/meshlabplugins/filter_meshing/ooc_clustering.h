@@ -0,0 +1,66 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_MESHING_OOC_CLUSTERING_H
+#define FILTER_MESHING_OOC_CLUSTERING_H
+
+#include <QString>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+OutOfCoreClustering
+Vertex clustering of a PLY file that is too large to be loaded in memory, with the
+representative of each cell placed in the position minimizing the quadric error of the
+faces incident on its vertices (Lindstrom, "Out-of-core simplification of large polygonal
+models", 2000).
+
+The file is streamed twice: the first pass reads only the vertices, for the bounding box
+of the grid; the second one assigns each vertex to its cell (a record with its position
+and cell is written in a memory mapped temporary file, so the faces can find it) and then
+reads the faces, accumulating their quadrics in the cells of their vertices and keeping
+the faces with the vertices in three different cells.
+The memory used depends on the number of cells, not on the size of the input.
+
+Binary (both endianness) and ascii PLY files are supported; polygons are triangulated as fans.
+*/
+class OutOfCoreClustering
+{
+public:
+	OutOfCoreClustering(const QString& fileName);
+
+	// clusters the file on a grid of about cellNum cells and stores the clustered mesh in m
+	bool extract(int cellNum, CMeshO& m, vcg::CallBackPos* cb = nullptr);
+
+	const QString& errorMessage() const { return error; }
+	size_t inputVertNum() const { return vertNum; }
+	size_t inputFaceNum() const { return faceNum; }
+
+private:
+	QString fileName;
+	QString error;
+	size_t vertNum;
+	size_t faceNum;
+};
+
+#endif // FILTER_MESHING_OOC_CLUSTERING_H
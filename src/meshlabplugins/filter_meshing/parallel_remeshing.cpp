@@ -0,0 +1,910 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "parallel_remeshing.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include <common/ml_document/mesh_ray_bvh.h>
+
+using namespace vcg;
+
+namespace {
+
+// rounds of each topological step: the candidates left after them wait the next iteration
+const int MAX_ROUNDS = 32;
+
+inline int sq(int x)
+{
+	return x * x;
+}
+
+}
+
+ParallelIsotropicRemeshing::Params::Params() :
+	targetLen(1), featureAngleDeg(30), maxSurfDist(1), iter(3), adapt(false), selectedOnly(false),
+	splitFlag(true), collapseFlag(true), swapFlag(true), smoothFlag(true), projectFlag(true), surfDistCheck(false)
+{
+}
+
+ParallelIsotropicRemeshing::ParallelIsotropicRemeshing(CMeshO& m, const Params& par) :
+	m(m), par(par), bvh(nullptr), splits(0), collapses(0), flips(0)
+{
+	cosFeature = std::cos(math::ToRad(par.featureAngleDeg));
+
+	const int vn = int(m.vert.size());
+	pos.resize(vn);
+	vertScale.assign(vn, 1);
+	vertSource.resize(vn);
+	vertDeleted.resize(vn);
+	for (int v = 0; v < vn; ++v)
+	{
+		pos[v] = m.vert[v].cP();
+		vertSource[v] = v;
+		vertDeleted[v] = m.vert[v].IsD();
+	}
+
+	const int fn = int(m.face.size());
+	face.assign(3 * fn, 0);
+	faceEdgeFeature.assign(3 * fn, 0);
+	faceSource.resize(fn);
+	faceDeleted.resize(fn);
+	faceSelected.resize(fn);
+	for (int f = 0; f < fn; ++f)
+	{
+		const CFaceO& cf = m.face[f];
+		faceSource[f] = f;
+		faceDeleted[f] = cf.IsD();
+		faceSelected[f] = cf.IsS();
+		if (!cf.IsD())
+			for (int z = 0; z < 3; ++z)
+				face[3 * f + z] = int(tri::Index(m, cf.cV(z)));
+	}
+}
+
+void ParallelIsotropicRemeshing::run(const CMeshO& original, vcg::CallBackPos* cb)
+{
+	std::unique_ptr<MeshRayBVH> tree;
+	if (par.projectFlag || par.surfDistCheck)
+		tree.reset(new MeshRayBVH(original));
+	bvh = tree.get();
+
+	initFeatures();
+	for (int i = 0; i < par.iter; ++i)
+	{
+		if (cb)
+			cb(100 * i / par.iter, "Parallel isotropic remeshing");
+		computeScale();
+		if (par.splitFlag)
+			splits += splitLongEdges();
+		if (par.collapseFlag)
+			collapses += collapseShortEdges();
+		if (par.swapFlag)
+			flips += flipEdges();
+		if (par.smoothFlag)
+			smooth();
+		if (par.projectFlag)
+			project();
+	}
+	writeBack();
+	bvh = nullptr;
+}
+
+void ParallelIsotropicRemeshing::buildVertexFaces()
+{
+	const int vn = vertNum();
+	const int fn = faceNum();
+	vertFaceFirst.assign(vn + 1, 0);
+	for (int f = 0; f < fn; ++f)
+		if (!faceDeleted[f])
+			for (int z = 0; z < 3; ++z)
+				++vertFaceFirst[face[3 * f + z] + 1];
+	for (int v = 0; v < vn; ++v)
+		vertFaceFirst[v + 1] += vertFaceFirst[v];
+
+	vertFaces.resize(vertFaceFirst[vn]);
+	std::vector<int> next(vertFaceFirst.begin(), vertFaceFirst.end() - 1);
+	for (int f = 0; f < fn; ++f)
+		if (!faceDeleted[f])
+			for (int z = 0; z < 3; ++z)
+				vertFaces[next[face[3 * f + z]]++] = f;
+}
+
+// the edges whose dihedral angle exceeds the feature angle, the borders and the non manifold edges
+void ParallelIsotropicRemeshing::initFeatures()
+{
+	buildVertexFaces();
+	const int fn = faceNum();
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < fn; ++f)
+	{
+		if (faceDeleted[f])
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			int ef[2];
+			const int n = edgeFaces(face[3 * f + k], face[3 * f + (k + 1) % 3], ef);
+			bool feature = (n != 2);
+			if (!feature)
+			{
+				const Point3m n0 = normal(ef[0]);
+				const Point3m n1 = normal(ef[1]);
+				const Scalarm l = n0.Norm() * n1.Norm();
+				feature = l > 0 && n0 * n1 < cosFeature * l;
+			}
+			faceEdgeFeature[3 * f + k] = feature;
+		}
+	}
+}
+
+/*
+For the adaptive remeshing the target length of each vertex goes from 1.5 (flat) to 0.5
+(curved) times the target length; the curvature is estimated from the largest deviation of
+the normals of the incident faces from the vertex normal, relative to the 90th percentile
+over the mesh.
+*/
+void ParallelIsotropicRemeshing::computeScale()
+{
+	const int vn = vertNum();
+	vertScale.assign(vn, 1);
+	if (!par.adapt)
+		return;
+
+	buildVertexFaces();
+	std::vector<Scalarm> q(vn, 0);
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < vn; ++v)
+	{
+		if (vertDeleted[v])
+			continue;
+		const Point3m n = vertexNormal(v);
+		Scalarm qm = 0;
+		for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+		{
+			const Point3m nf = normal(vertFaces[j]);
+			const Scalarm l = nf.Norm();
+			if (l > 0)
+				qm = std::max(qm, 1 - (nf * n) / l);
+		}
+		q[v] = qm;
+	}
+
+	std::vector<Scalarm> sorted;
+	sorted.reserve(vn);
+	for (int v = 0; v < vn; ++v)
+		if (!vertDeleted[v])
+			sorted.push_back(q[v]);
+	if (sorted.empty())
+		return;
+	std::vector<Scalarm>::iterator p90 = sorted.begin() + (sorted.size() * 9) / 10;
+	std::nth_element(sorted.begin(), p90, sorted.end());
+	const Scalarm qmax = *p90;
+	if (qmax <= 0)
+		return;
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < vn; ++v)
+		vertScale[v] = Scalarm(1.5) - std::min<Scalarm>(q[v] / qmax, 1);
+}
+
+/*
+The rounds of a topological step. In each round:
+ - the edges of the active faces are evaluated in parallel; evaluate() fills the candidate
+   (its key and, for the collapses, the direction and the new position);
+ - each candidate takes the lock of the vertices returned by locks(), with an atomic min of
+   its rank, and it is applied if it holds all of them; as every operation locks all the
+   vertices of the faces it reads or changes, the winners of a round are independent;
+ - apply() does the winners, in parallel.
+The faces around the candidates (around all the locked vertices for the winners) are the
+active ones in the next round.
+*/
+template <class EvalFn, class LockFn, class ApplyFn>
+int ParallelIsotropicRemeshing::schedule(EvalFn evaluate, LockFn locks, ApplyFn apply)
+{
+	int applied = 0;
+	faceActive.assign(faceNum(), 1);
+	for (int round = 0; round < MAX_ROUNDS; ++round)
+	{
+		buildVertexFaces();
+		const int fn = faceNum();
+		std::vector<Candidate> cands;
+#pragma omp parallel
+		{
+			std::vector<Candidate> local;
+			std::vector<int> s0, s1;
+			Candidate c;
+#pragma omp for schedule(dynamic, 1024)
+			for (int f = 0; f < fn; ++f)
+			{
+				if (faceDeleted[f] || !faceActive[f])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					c.a = face[3 * f + k];
+					c.b = face[3 * f + (k + 1) % 3];
+					int ef[2];
+					const int n = edgeFaces(c.a, c.b, ef);
+					if (n > 2)
+						continue;
+					// each edge is evaluated once, by its lower active face
+					if (n == 2)
+					{
+						const int other = (ef[0] == f) ? ef[1] : ef[0];
+						if (faceActive[other] && other < f)
+							continue;
+					}
+					if (evaluate(f, k, ef, n, c, s0, s1))
+						local.push_back(c);
+				}
+			}
+#pragma omp critical
+			{
+				cands.insert(cands.end(), local.begin(), local.end());
+			}
+		}
+		if (cands.empty())
+			break;
+		std::sort(cands.begin(), cands.end(), [](const Candidate& x, const Candidate& y) {
+			if (x.key != y.key)
+				return x.key < y.key;
+			return (x.a != y.a) ? x.a < y.a : x.b < y.b;
+		});
+
+		const int vn = vertNum();
+		const int cn = int(cands.size());
+		if (int(owner.size()) != vn)
+			std::vector<std::atomic<int>>(vn).swap(owner);
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < vn; ++v)
+			owner[v].store(INT_MAX, std::memory_order_relaxed);
+
+#pragma omp parallel
+		{
+			std::vector<int> lock, tmp;
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < cn; ++i)
+			{
+				locks(cands[i], lock, tmp);
+				for (int v : lock)
+				{
+					int cur = owner[v].load(std::memory_order_relaxed);
+					while (i < cur && !owner[v].compare_exchange_weak(cur, i, std::memory_order_relaxed))
+						;
+				}
+			}
+		}
+
+		std::vector<char> win(cn, 0);
+#pragma omp parallel
+		{
+			std::vector<int> lock, tmp;
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < cn; ++i)
+			{
+				locks(cands[i], lock, tmp);
+				bool w = true;
+				for (size_t j = 0; j < lock.size() && w; ++j)
+					w = owner[lock[j]].load(std::memory_order_relaxed) == i;
+				win[i] = w;
+			}
+		}
+
+		faceActive.assign(fn, 0);
+		std::vector<Candidate> winners;
+		std::vector<int> lock, tmp;
+		for (int i = 0; i < cn; ++i)
+		{
+			if (win[i])
+			{
+				winners.push_back(cands[i]);
+				locks(cands[i], lock, tmp);
+			}
+			else
+			{
+				lock.assign(1, cands[i].a);
+				lock.push_back(cands[i].b);
+			}
+			for (int v : lock)
+				for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+					faceActive[vertFaces[j]] = 1;
+		}
+
+		apply(winners);
+		faceActive.resize(faceNum(), 1);
+		applied += int(winners.size());
+	}
+	return applied;
+}
+
+int ParallelIsotropicRemeshing::splitLongEdges()
+{
+	const Scalarm maxLen = par.targetLen * 4 / 3;
+	auto evaluate = [this, maxLen](int, int, const int ef[2], int n, Candidate& c, std::vector<int>&, std::vector<int>&) {
+		const Scalarm len = maxLen * edgeScale(c.a, c.b);
+		const Scalarm len2 = (pos[c.a] - pos[c.b]).SquaredNorm();
+		if (len2 <= len * len)
+			return false;
+		if (par.selectedOnly)
+			for (int t = 0; t < n; ++t)
+				if (!faceSelected[ef[t]])
+					return false;
+		c.key = -len2;
+		return true;
+	};
+	auto locks = [this](const Candidate& c, std::vector<int>& lock, std::vector<int>&) {
+		lock.clear();
+		int ef[2];
+		const int n = edgeFaces(c.a, c.b, ef);
+		for (int t = 0; t < std::min(n, 2); ++t)
+			for (int z = 0; z < 3; ++z)
+				lock.push_back(face[3 * ef[t] + z]);
+	};
+	auto apply = [this](const std::vector<Candidate>& winners) {
+		const int wn = int(winners.size());
+		std::vector<int> firstFace(wn + 1, 0);
+		for (int i = 0; i < wn; ++i)
+		{
+			int ef[2];
+			firstFace[i + 1] = firstFace[i] + edgeFaces(winners[i].a, winners[i].b, ef);
+		}
+		const int v0 = vertNum();
+		const int f0 = faceNum();
+		pos.resize(v0 + wn);
+		vertScale.resize(v0 + wn);
+		vertSource.resize(v0 + wn);
+		vertDeleted.resize(v0 + wn, 0);
+		const int nfn = f0 + firstFace[wn];
+		face.resize(3 * nfn);
+		faceEdgeFeature.resize(3 * nfn);
+		faceSource.resize(nfn);
+		faceDeleted.resize(nfn, 0);
+		faceSelected.resize(nfn);
+
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < wn; ++i)
+		{
+			const int a = winners[i].a;
+			const int b = winners[i].b;
+			const int mv = v0 + i;
+			pos[mv] = (pos[a] + pos[b]) / 2;
+			vertScale[mv] = (vertScale[a] + vertScale[b]) / 2;
+			vertSource[mv] = vertSource[a];
+			int ef[2];
+			const int n = edgeFaces(a, b, ef);
+			for (int t = 0; t < n; ++t)
+			{
+				const int g = ef[t];
+				const int ka = corner(g, a);
+				if (face[3 * g + (ka + 1) % 3] == b)
+					splitFace(g, ka, mv, f0 + firstFace[i] + t);
+				else
+					splitFace(g, corner(g, b), mv, f0 + firstFace[i] + t);
+			}
+		}
+	};
+	return schedule(evaluate, locks, apply);
+}
+
+// the edge k of f (from a to b) is split at mv: f becomes (a, mv, c) and nf is (mv, b, c)
+void ParallelIsotropicRemeshing::splitFace(int f, int k, int mv, int nf)
+{
+	const int i1 = 3 * f + (k + 1) % 3;
+	const int i2 = 3 * f + (k + 2) % 3;
+	const int b = face[i1];
+	const int c = face[i2];
+	const char fab = faceEdgeFeature[3 * f + k];
+	const char fbc = faceEdgeFeature[i1];
+
+	face[i1] = mv;
+	faceEdgeFeature[i1] = 0;
+
+	face[3 * nf] = mv;
+	face[3 * nf + 1] = b;
+	face[3 * nf + 2] = c;
+	faceEdgeFeature[3 * nf] = fab;
+	faceEdgeFeature[3 * nf + 1] = fbc;
+	faceEdgeFeature[3 * nf + 2] = 0;
+	faceSource[nf] = faceSource[f];
+	faceSelected[nf] = faceSelected[f];
+	faceDeleted[nf] = 0;
+}
+
+/*
+Collapse of a on b (ra and rb are scratch space for the rings). As in vcg a vertex can
+move only if it is not on a feature, or along its feature line if it has just two feature
+edges; two free vertices meet in the middle.
+The collapse must keep the mesh manifold (link condition), make no edge longer than the
+split threshold, flip no face and stay near the original surface.
+*/
+bool ParallelIsotropicRemeshing::collapseValid(int a, int b, std::vector<int>& ra, std::vector<int>& rb, Candidate& c) const
+{
+	if (!movable(a))
+		return false;
+	int fa[2], fb[2];
+	const int na = featureNeighbors(a, fa);
+	const int nb = featureNeighbors(b, fb);
+	const bool abFeature = isFeatureEdge(a, b);
+	Point3m p;
+	if (na == 0)
+		p = (nb == 0 && movable(b)) ? (pos[a] + pos[b]) / 2 : pos[b];
+	else if (na == 2 && abFeature)
+		p = pos[b];
+	else
+		return false;
+
+	int ef[2];
+	const int n = edgeFaces(a, b, ef);
+	if (n < 1 || n > 2)
+		return false;
+	ring(a, ra);
+	ring(b, rb);
+	int common = 0;
+	for (size_t i = 0, j = 0; i < ra.size() && j < rb.size();)
+	{
+		if (ra[i] < rb[j])
+			++i;
+		else if (rb[j] < ra[i])
+			++j;
+		else
+		{
+			++common;
+			++i;
+			++j;
+		}
+	}
+	if (common != n)
+		return false;
+	// the opposite vertices lose a face
+	for (int t = 0; t < n; ++t)
+		for (int z = 0; z < 3; ++z)
+		{
+			const int o = face[3 * ef[t] + z];
+			if (o != a && o != b && vertFaceFirst[o + 1] - vertFaceFirst[o] <= 3)
+				return false;
+		}
+
+	const Scalarm maxLen = par.targetLen * 4 / 3 * edgeScale(a, b);
+	const Scalarm maxLen2 = maxLen * maxLen;
+	for (int x : ra)
+		if (x != b && (p - pos[x]).SquaredNorm() > maxLen2)
+			return false;
+	const bool moveB = (p != pos[b]);
+	if (moveB)
+		for (int x : rb)
+			if (x != a && (p - pos[x]).SquaredNorm() > maxLen2)
+				return false;
+
+	for (int v : { a, b })
+	{
+		if (v == b && !moveB)
+			continue;
+		for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+		{
+			const int f = vertFaces[j];
+			if (f == ef[0] || (n == 2 && f == ef[1]))
+				continue;
+			Point3m q[3];
+			for (int z = 0; z < 3; ++z)
+			{
+				const int w = face[3 * f + z];
+				q[z] = (w == a || w == b) ? p : pos[w];
+			}
+			const Point3m nn = (q[1] - q[0]) ^ (q[2] - q[0]);
+			const Point3m on = normal(f);
+			if (nn * on <= Scalarm(0.5) * nn.Norm() * on.Norm())
+				return false;
+		}
+	}
+	if (!nearSurface(p))
+		return false;
+
+	c.a = a;
+	c.b = b;
+	c.p = p;
+	return true;
+}
+
+int ParallelIsotropicRemeshing::collapseShortEdges()
+{
+	const Scalarm minLen = par.targetLen * 4 / 5;
+	auto evaluate = [this, minLen](int, int, const int*, int, Candidate& c, std::vector<int>& s0, std::vector<int>& s1) {
+		const Scalarm len = minLen * edgeScale(c.a, c.b);
+		const Scalarm len2 = (pos[c.a] - pos[c.b]).SquaredNorm();
+		if (len2 >= len * len)
+			return false;
+		c.key = len2;
+		const int a = c.a;
+		const int b = c.b;
+		return collapseValid(a, b, s0, s1, c) || collapseValid(b, a, s0, s1, c);
+	};
+	auto locks = [this](const Candidate& c, std::vector<int>& lock, std::vector<int>& tmp) {
+		ring(c.a, lock);
+		ring(c.b, tmp);
+		lock.insert(lock.end(), tmp.begin(), tmp.end());
+	};
+	auto apply = [this](const std::vector<Candidate>& winners) {
+		const int wn = int(winners.size());
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < wn; ++i)
+		{
+			const Candidate& c = winners[i];
+			for (int j = vertFaceFirst[c.a]; j < vertFaceFirst[c.a + 1]; ++j)
+			{
+				const int f = vertFaces[j];
+				const int k = corner(f, c.a);
+				if (face[3 * f + (k + 1) % 3] == c.b || face[3 * f + (k + 2) % 3] == c.b)
+					faceDeleted[f] = 1;
+				else
+					face[3 * f + k] = c.b;
+			}
+			pos[c.b] = c.p;
+			vertDeleted[c.a] = 1;
+		}
+	};
+	return schedule(evaluate, locks, apply);
+}
+
+/*
+Flip of the edge (a, b) between (a, b, c) and (b, a, d) to (a, d, c) and (d, b, c), if it
+lowers the deviation of the four valences from the optimal one; the new faces must not
+fold over the old ones nor make a crease sharper than the feature angle.
+*/
+int ParallelIsotropicRemeshing::flipEdges()
+{
+	auto evaluate = [this](int f, int k, const int ef[2], int n, Candidate& c, std::vector<int>& s0, std::vector<int>& s1) {
+		if (n != 2)
+			return false;
+		const int a = c.a;
+		const int b = c.b;
+		const int g = (ef[0] == f) ? ef[1] : ef[0];
+		if (par.selectedOnly && (!faceSelected[f] || !faceSelected[g]))
+			return false;
+		if (isFeatureEdge(a, b))
+			return false;
+		const int cv = face[3 * f + (k + 2) % 3];
+		const int kb = corner(g, b);
+		if (face[3 * g + (kb + 1) % 3] != a)
+			return false;
+		const int d = face[3 * g + (kb + 2) % 3];
+		if (cv == d)
+			return false;
+
+		ring(cv, s0);
+		if (std::binary_search(s0.begin(), s0.end(), d))
+			return false;
+		const int vc = int(s0.size());
+		const int tc = isBorderVertex(cv, s0) ? 4 : 6;
+		ring(a, s1);
+		const int va = int(s1.size());
+		const int ta = isBorderVertex(a, s1) ? 4 : 6;
+		ring(b, s1);
+		const int vb = int(s1.size());
+		const int tb = isBorderVertex(b, s1) ? 4 : 6;
+		ring(d, s1);
+		const int vd = int(s1.size());
+		const int td = isBorderVertex(d, s1) ? 4 : 6;
+		if (va <= 3 || vb <= 3)
+			return false;
+		const int before = sq(va - ta) + sq(vb - tb) + sq(vc - tc) + sq(vd - td);
+		const int after = sq(va - 1 - ta) + sq(vb - 1 - tb) + sq(vc + 1 - tc) + sq(vd + 1 - td);
+		if (after >= before)
+			return false;
+
+		const Point3m on = normal(f) + normal(g);
+		const Point3m n0 = (pos[d] - pos[a]) ^ (pos[cv] - pos[a]);
+		const Point3m n1 = (pos[b] - pos[d]) ^ (pos[cv] - pos[d]);
+		if (n0 * on <= 0 || n1 * on <= 0)
+			return false;
+		if (n0 * n1 < cosFeature * n0.Norm() * n1.Norm())
+			return false;
+		if (!nearSurface((pos[cv] + pos[d]) / 2))
+			return false;
+		c.key = Scalarm(after - before);
+		return true;
+	};
+	auto locks = [this](const Candidate& c, std::vector<int>& lock, std::vector<int>&) {
+		lock.clear();
+		int ef[2];
+		if (edgeFaces(c.a, c.b, ef) != 2)
+			return;
+		for (int t = 0; t < 2; ++t)
+			for (int z = 0; z < 3; ++z)
+				lock.push_back(face[3 * ef[t] + z]);
+	};
+	auto apply = [this](const std::vector<Candidate>& winners) {
+		const int wn = int(winners.size());
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < wn; ++i)
+		{
+			const int a = winners[i].a;
+			const int b = winners[i].b;
+			int ef[2];
+			edgeFaces(a, b, ef);
+			int f0 = ef[0];
+			int f1 = ef[1];
+			if (face[3 * f0 + (corner(f0, a) + 1) % 3] != b)
+				std::swap(f0, f1);
+			const int k0 = corner(f0, a);
+			const int cv = face[3 * f0 + (k0 + 2) % 3];
+			const char fbc = faceEdgeFeature[3 * f0 + (k0 + 1) % 3];
+			const char fca = faceEdgeFeature[3 * f0 + (k0 + 2) % 3];
+			const int k1 = corner(f1, b);
+			const int d = face[3 * f1 + (k1 + 2) % 3];
+			const char fad = faceEdgeFeature[3 * f1 + (k1 + 1) % 3];
+			const char fdb = faceEdgeFeature[3 * f1 + (k1 + 2) % 3];
+
+			face[3 * f0] = a;  face[3 * f0 + 1] = d; face[3 * f0 + 2] = cv;
+			faceEdgeFeature[3 * f0] = fad;  faceEdgeFeature[3 * f0 + 1] = 0;   faceEdgeFeature[3 * f0 + 2] = fca;
+			face[3 * f1] = d;  face[3 * f1 + 1] = b; face[3 * f1 + 2] = cv;
+			faceEdgeFeature[3 * f1] = fdb;  faceEdgeFeature[3 * f1 + 1] = fbc; faceEdgeFeature[3 * f1 + 2] = 0;
+		}
+	};
+	return schedule(evaluate, locks, apply);
+}
+
+/*
+Tangential relaxation: each free vertex moves towards the barycenter of its ring, in the
+tangent plane; the vertices on a feature line move along it, the corners stay. All the
+vertices move at once (Jacobi), a move that flips a face is discarded.
+*/
+void ParallelIsotropicRemeshing::smooth()
+{
+	buildVertexFaces();
+	const int vn = vertNum();
+	std::vector<Point3m> newPos(pos);
+#pragma omp parallel
+	{
+		std::vector<int> r;
+#pragma omp for schedule(dynamic, 1024)
+		for (int v = 0; v < vn; ++v)
+		{
+			if (vertDeleted[v] || vertFaceFirst[v] == vertFaceFirst[v + 1] || !movable(v))
+				continue;
+			const Point3m p = pos[v];
+			Point3m q;
+			int fv[2];
+			const int nf = featureNeighbors(v, fv);
+			if (nf == 0)
+			{
+				ring(v, r);
+				Point3m c(0, 0, 0);
+				for (int y : r)
+					c += pos[y];
+				c /= Scalarm(r.size());
+				const Point3m n = vertexNormal(v);
+				const Point3m d = c - p;
+				q = p + (d - n * (n * d));
+			}
+			else if (nf == 2)
+			{
+				const Point3m dir = pos[fv[1]] - pos[fv[0]];
+				const Scalarm l2 = dir.SquaredNorm();
+				if (l2 <= 0)
+					continue;
+				const Point3m c = (pos[fv[0]] + pos[fv[1]]) / 2;
+				q = p + dir * (((c - p) * dir) / l2);
+			}
+			else
+				continue;
+
+			bool ok = true;
+			for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1] && ok; ++j)
+			{
+				const int f = vertFaces[j];
+				Point3m t[3];
+				for (int z = 0; z < 3; ++z)
+					t[z] = (face[3 * f + z] == v) ? q : pos[face[3 * f + z]];
+				ok = ((t[1] - t[0]) ^ (t[2] - t[0])) * normal(f) > 0;
+			}
+			if (ok && nearSurface(q))
+				newPos[v] = q;
+		}
+	}
+	pos.swap(newPos);
+}
+
+void ParallelIsotropicRemeshing::project()
+{
+	if (!bvh)
+		return;
+	buildVertexFaces();
+	const int vn = vertNum();
+	const Scalarm maxDist = std::sqrt(std::numeric_limits<Scalarm>::max());
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int v = 0; v < vn; ++v)
+	{
+		if (vertDeleted[v] || vertFaceFirst[v] == vertFaceFirst[v + 1] || !movable(v))
+			continue;
+		Point3m q;
+		int f;
+		if (bvh->closestPoint(pos[v], maxDist, q, f))
+			pos[v] = q;
+	}
+}
+
+void ParallelIsotropicRemeshing::writeBack()
+{
+	const int vn0 = int(m.vert.size());
+	const int fn0 = int(m.face.size());
+	const int vn = vertNum();
+	const int fn = faceNum();
+	if (vn > vn0)
+		tri::Allocator<CMeshO>::AddVertices(m, vn - vn0);
+	if (fn > fn0)
+		tri::Allocator<CMeshO>::AddFaces(m, fn - fn0);
+
+#pragma omp parallel for schedule(static)
+	for (int v = vn0; v < vn; ++v)
+		m.vert[v].ImportData(m.vert[vertSource[v]]);
+#pragma omp parallel for schedule(static)
+	for (int f = fn0; f < fn; ++f)
+		m.face[f].ImportData(m.face[faceSource[f]]);
+
+	for (int v = 0; v < vn; ++v)
+	{
+		if (!vertDeleted[v])
+			m.vert[v].P() = pos[v];
+		else if (!m.vert[v].IsD())
+			tri::Allocator<CMeshO>::DeleteVertex(m, m.vert[v]);
+	}
+	for (int f = 0; f < fn; ++f)
+	{
+		if (!faceDeleted[f])
+			for (int z = 0; z < 3; ++z)
+				m.face[f].V(z) = &m.vert[face[3 * f + z]];
+		else if (!m.face[f].IsD())
+			tri::Allocator<CMeshO>::DeleteFace(m, m.face[f]);
+	}
+}
+
+int ParallelIsotropicRemeshing::corner(int f, int v) const
+{
+	return (face[3 * f] == v) ? 0 : (face[3 * f + 1] == v) ? 1 : 2;
+}
+
+// the faces incident on the edge (a, b): the first two are in ef, the count is returned
+int ParallelIsotropicRemeshing::edgeFaces(int a, int b, int ef[2]) const
+{
+	int n = 0;
+	for (int j = vertFaceFirst[a]; j < vertFaceFirst[a + 1]; ++j)
+	{
+		const int f = vertFaces[j];
+		if (face[3 * f] == b || face[3 * f + 1] == b || face[3 * f + 2] == b)
+		{
+			if (n < 2)
+				ef[n] = f;
+			++n;
+		}
+	}
+	return n;
+}
+
+// the adjacent vertices of v, sorted
+void ParallelIsotropicRemeshing::ring(int v, std::vector<int>& r) const
+{
+	r.clear();
+	for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+		for (int z = 0; z < 3; ++z)
+		{
+			const int w = face[3 * vertFaces[j] + z];
+			if (w != v)
+				r.push_back(w);
+		}
+	std::sort(r.begin(), r.end());
+	r.erase(std::unique(r.begin(), r.end()), r.end());
+}
+
+bool ParallelIsotropicRemeshing::isFeatureEdge(int a, int b) const
+{
+	for (int j = vertFaceFirst[a]; j < vertFaceFirst[a + 1]; ++j)
+	{
+		const int f = vertFaces[j];
+		const int k = corner(f, a);
+		if (face[3 * f + (k + 1) % 3] == b && faceEdgeFeature[3 * f + k])
+			return true;
+		if (face[3 * f + (k + 2) % 3] == b && faceEdgeFeature[3 * f + (k + 2) % 3])
+			return true;
+	}
+	return false;
+}
+
+// the number of feature edges of v; the other vertices of the first two are in fn
+int ParallelIsotropicRemeshing::featureNeighbors(int v, int fn[2]) const
+{
+	const int MAX_NEIGHBORS = 8;
+	int y[MAX_NEIGHBORS];
+	int n = 0;
+	auto add = [&](int w) {
+		for (int i = 0; i < std::min(n, MAX_NEIGHBORS); ++i)
+			if (y[i] == w)
+				return;
+		if (n < MAX_NEIGHBORS)
+			y[n] = w;
+		++n;
+	};
+	for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+	{
+		const int f = vertFaces[j];
+		const int k = corner(f, v);
+		if (faceEdgeFeature[3 * f + k])
+			add(face[3 * f + (k + 1) % 3]);
+		if (faceEdgeFeature[3 * f + (k + 2) % 3])
+			add(face[3 * f + (k + 2) % 3]);
+	}
+	for (int i = 0; i < std::min(n, 2); ++i)
+		fn[i] = y[i];
+	return n;
+}
+
+bool ParallelIsotropicRemeshing::isBorderVertex(int v, const std::vector<int>& r) const
+{
+	int ef[2];
+	for (int y : r)
+		if (edgeFaces(v, y, ef) == 1)
+			return true;
+	return false;
+}
+
+// with selectedOnly, only the vertices of selected faces can move or disappear
+bool ParallelIsotropicRemeshing::movable(int v) const
+{
+	if (!par.selectedOnly)
+		return true;
+	for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+		if (!faceSelected[vertFaces[j]])
+			return false;
+	return true;
+}
+
+Point3m ParallelIsotropicRemeshing::normal(int f) const
+{
+	const Point3m& p0 = pos[face[3 * f]];
+	return (pos[face[3 * f + 1]] - p0) ^ (pos[face[3 * f + 2]] - p0);
+}
+
+// area weighted, normalized
+Point3m ParallelIsotropicRemeshing::vertexNormal(int v) const
+{
+	Point3m n(0, 0, 0);
+	for (int j = vertFaceFirst[v]; j < vertFaceFirst[v + 1]; ++j)
+		n += normal(vertFaces[j]);
+	const Scalarm l = n.Norm();
+	return (l > 0) ? n / l : n;
+}
+
+Scalarm ParallelIsotropicRemeshing::edgeScale(int a, int b) const
+{
+	return par.adapt ? (vertScale[a] + vertScale[b]) / 2 : Scalarm(1);
+}
+
+bool ParallelIsotropicRemeshing::nearSurface(const Point3m& p) const
+{
+	if (!par.surfDistCheck || !bvh)
+		return true;
+	Point3m q;
+	int f;
+	return bvh->closestPoint(p, par.maxSurfDist, q, f);
+}
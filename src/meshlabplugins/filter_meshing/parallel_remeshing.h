@@ -0,0 +1,152 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_MESHING_PARALLEL_REMESHING_H
+#define FILTER_MESHING_PARALLEL_REMESHING_H
+
+#include <atomic>
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+class MeshRayBVH;
+
+/*
+ParallelIsotropicRemeshing
+The same steps of vcg::tri::IsotropicRemeshing (split of the edges longer than 4/3 of the
+target length, collapse of the ones shorter than 4/5, edge flips towards valence 6 (4 on the
+borders), tangential smoothing and reprojection on the original surface), with the same
+parameters, run by many threads.
+
+The topological operations are done in rounds: the candidate edges are evaluated in
+parallel, then an independent set of them is chosen (each operation locks the vertices of
+the faces it reads or changes, and among the conflicting ones the best wins: the longest
+edge to split, the shortest to collapse, the flip with the largest valence gain) and
+applied in parallel. The losers are evaluated again in the next round, on the updated mesh.
+Smoothing and reprojection move all the vertices at once; the closest points on the
+original surface are found with a MeshRayBVH, that (unlike the vcg grids) has no marks
+shared among the queries.
+
+The mesh is kept as indexed triangles with a feature flag for each face edge (the borders,
+the non manifold edges and the creases sharper than the feature angle) during the
+remeshing, and written back at the end: the vertices and faces that survive keep their
+attributes, the new ones copy the attributes of the element they come from.
+The FF and VF adjacency of the mesh are not updated.
+*/
+class ParallelIsotropicRemeshing
+{
+public:
+	struct Params
+	{
+		Scalarm targetLen;
+		Scalarm featureAngleDeg;
+		Scalarm maxSurfDist;
+		int iter;
+		bool adapt;          // target length scaled in [0.5, 1.5] by the local curvature
+		bool selectedOnly;   // only the selected faces change
+		bool splitFlag;
+		bool collapseFlag;
+		bool swapFlag;
+		bool smoothFlag;
+		bool projectFlag;
+		bool surfDistCheck;  // operations moving the surface farther than maxSurfDist are discarded
+
+		Params();
+	};
+
+	ParallelIsotropicRemeshing(CMeshO& m, const Params& par);
+
+	// remeshes m, reprojecting it on original (usually a copy of m before the remeshing)
+	void run(const CMeshO& original, vcg::CallBackPos* cb = nullptr);
+
+	int splitNum() const { return splits; }
+	int collapseNum() const { return collapses; }
+	int flipNum() const { return flips; }
+
+private:
+	struct Candidate
+	{
+		Scalarm key;   // the lowest wins
+		int a;         // edge (a, b), as oriented in the face that found it;
+		int b;         // a collapse removes a
+		Point3m p;     // position of b after a collapse
+	};
+
+	void buildVertexFaces();
+	void initFeatures();
+	void computeScale();
+	void writeBack();
+
+	template <class EvalFn, class LockFn, class ApplyFn>
+	int schedule(EvalFn evaluate, LockFn locks, ApplyFn apply);
+
+	int splitLongEdges();
+	int collapseShortEdges();
+	int flipEdges();
+	void smooth();
+	void project();
+
+	bool collapseValid(int a, int b, std::vector<int>& ra, std::vector<int>& rb, Candidate& c) const;
+	void splitFace(int f, int k, int mv, int nf);
+
+	int faceNum() const { return int(faceDeleted.size()); }
+	int vertNum() const { return int(pos.size()); }
+	int corner(int f, int v) const;
+	int edgeFaces(int a, int b, int ef[2]) const;
+	void ring(int v, std::vector<int>& r) const;
+	bool isFeatureEdge(int a, int b) const;
+	int featureNeighbors(int v, int fn[2]) const;
+	bool isBorderVertex(int v, const std::vector<int>& r) const;
+	bool movable(int v) const;
+	Point3m normal(int f) const;
+	Point3m vertexNormal(int v) const;
+	Scalarm edgeScale(int a, int b) const;
+	bool nearSurface(const Point3m& p) const;
+
+	CMeshO& m;
+	Params par;
+	Scalarm cosFeature;
+	const MeshRayBVH* bvh;
+	int splits;
+	int collapses;
+	int flips;
+
+	std::vector<Point3m> pos;
+	std::vector<Scalarm> vertScale;
+	std::vector<int> vertSource;          // vertex of m whose attributes are copied
+	std::vector<char> vertDeleted;
+
+	std::vector<int> face;                // 3 vertices per face
+	std::vector<char> faceEdgeFeature;    // 3 per face, edge k is (face[3f+k], face[3f+(k+1)%3])
+	std::vector<int> faceSource;          // face of m whose attributes are copied
+	std::vector<char> faceDeleted;
+	std::vector<char> faceSelected;
+	std::vector<char> faceActive;         // faces whose edges are evaluated in the next round
+
+	// the faces incident on vertex v are vertFaces[vertFaceFirst[v]] ... vertFaces[vertFaceFirst[v+1]-1]
+	std::vector<int> vertFaceFirst;
+	std::vector<int> vertFaces;
+	std::vector<std::atomic<int>> owner;  // lock of each vertex in a round: best candidate
+};
+
+#endif // FILTER_MESHING_PARALLEL_REMESHING_H
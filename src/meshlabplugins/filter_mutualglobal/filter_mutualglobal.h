@@ -70,6 +70,7 @@ public:
 	bool UpdateGraph(MeshDocument &md, SubGraph graph, int n);
 	float calcShotsDifference(MeshDocument &md, std::vector<Shotm> oldShots, std::vector<vcg::Point3f> points);
 	FILTER_ARITY filterArity(const QAction *) const { return SINGLE_MESH; }
+	bool requiresGLContext(const QAction *) const { return true; }
 
 
 
@@ -20,6 +20,7 @@ class MutualInfo {
   unsigned int *histo2D; //matrix nbisXnbins
   unsigned int *histoA;  //vector nbins
   unsigned int *histoB;
+  unsigned int *histoPart; //3 more nbinsXnbins matrices, see histogram()
 };
 
 
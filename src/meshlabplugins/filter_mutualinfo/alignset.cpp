@@ -24,6 +24,52 @@
 
 using namespace std;
 
+namespace {
+
+inline float clamp01(float v)
+{
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+// the fragment shaders of AlignSet::initializeGL; n is the normal and pos the position in eye space
+void shade(AlignSet::RenderingMode mode, Point3m n, const Point3m& pos, const vcg::Color4b& c, float out[4])
+{
+    const float color[4] = { c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, c[3] / 255.0f };
+    n.Normalize();
+    float ncolor[3];
+    switch(mode) {
+    case AlignSet::COLOR:
+        for(int i = 0; i < 4; i++) out[i] = color[i];
+        return;
+    case AlignSet::SILHOUETTE:
+        //no color attribute: the default current color
+        for(int i = 0; i < 4; i++) out[i] = 1.0f;
+        return;
+    case AlignSet::NORMALMAP:
+    case AlignSet::COMBINE:
+        for(int i = 0; i < 3; i++) ncolor[i] = float(n[i]) * 0.5f + 0.5f;
+        break;
+    case AlignSet::SPECULAR:
+    case AlignSet::SPECAMB: {
+        Point3m r = pos - n * (2 * (n * pos));
+        r.Normalize();
+        for(int i = 0; i < 3; i++) ncolor[i] = float(r[i]) * 0.5f + 0.5f;
+        break;
+    }
+    default: assert(0);
+    }
+    if(mode == AlignSet::NORMALMAP || mode == AlignSet::SPECULAR) {
+        for(int i = 0; i < 3; i++) out[i] = ncolor[i];
+        out[3] = 1.0f;
+        return;
+    }
+    const float t = color[0] * color[0];
+    for(int i = 0; i < 3; i++) out[i] = (1.0f - t) * color[i] + t * ncolor[i];
+    out[3] = (1.0f - t) * color[3] + t;
+}
+
+}
+
 AlignSet::AlignSet(): mode(COMBINE),
     target(NULL), render(NULL),error(0)
 {
@@ -161,6 +207,11 @@ void AlignSet::resize(int max_side) {
 
 void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component) 
 {
+    if(_cont == NULL) {
+        renderSceneCPU(view, component);
+        return;
+    }
+
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
     frmt.setInternalTextureFormat(GL_RGBA);
@@ -275,6 +326,9 @@ void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component)
 }
 
 void AlignSet::readRender(int component) {
+    //the CPU rendering is already in render
+    if(_cont == NULL) return;
+
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
     frmt.setInternalTextureFormat(GL_RGBA);
@@ -296,6 +350,54 @@ void AlignSet::readRender(int component) {
     fbo.release();
 }
 
+/*
+The same images of renderScene on the CPU: MeshRasterizer gives the element visible in each
+pixel, then the rows are shaded in parallel with the vertex normals, positions and colors
+interpolated on it. The rasterizer keeps its buffers, so the many renderings of a
+registration allocate nothing.
+*/
+void AlignSet::renderSceneCPU(vcg::Shot<MESHLAB_SCALAR> &view, int component)
+{
+    if(!render) render = new unsigned char[wt*ht];
+    if(component > 3) return;
+
+    rasterizer.render(*mesh, view, wt, ht);
+    const bool points = rasterizer.pointCloud();
+    //world to eye space of the OpenGL rendering (the camera looks along -z)
+    const Matrix44m rot = view.Extrinsics.Rot();
+    const Point3m viewpoint = view.GetViewPoint();
+
+#pragma omp parallel for schedule(static)
+    for(int y = 0; y < ht; y++) {
+        for(int x = 0; x < wt; x++) {
+            unsigned char &out = render[y*wt + x];
+            const int e = rasterizer.element(x, y);
+            if(e < 0) {
+                out = 0;
+                continue;
+            }
+            Point3m n, p;
+            vcg::Color4b c;
+            if(points) {
+                const CVertexO &v = mesh->vert[e];
+                n = v.cN();
+                p = v.cP();
+                c = v.cC();
+            } else {
+                const CFaceO &f = mesh->face[e];
+                const Point3m b = rasterizer.barycentric(x, y);
+                n = f.cV(0)->cN()*b[0] + f.cV(1)->cN()*b[1] + f.cV(2)->cN()*b[2];
+                p = f.cP(0)*b[0] + f.cP(1)*b[1] + f.cP(2)*b[2];
+                for(int i = 0; i < 4; i++)
+                    c[i] = (unsigned char)(f.cV(0)->cC()[i]*b[0] + f.cV(1)->cC()[i]*b[1] + f.cV(2)->cC()[i]*b[2] + 0.5);
+            }
+            float rgba[4];
+            shade(mode, rot * n, rot * (p - viewpoint), c, rgba);
+            out = (unsigned char)(clamp01(rgba[component]) * 255.0f + 0.5f);
+        }
+    }
+}
+
 GLuint AlignSet::createShaderFromFiles(QString name) {
     QString vert = "shaders/" + name + ".vert";
     QString frag = "shaders/" + name + ".frag";
@@ -8,6 +8,7 @@
 
 // local headers
 #include <common/ml_document/mesh_model.h>
+#include <common/ml_document/mesh_rasterizer.h>
 
 // VCG headers
 #include <vcg/math/shot.h>
@@ -49,6 +50,7 @@ class AlignSet {
   AlignSet();
   ~AlignSet();
 
+  // without a context (NULL) the scene is rendered on the CPU
   void setGLContext(MLPluginGLContext* cont);
   void initializeGL();
 
@@ -71,6 +73,9 @@ class AlignSet {
 
  private:
   MLPluginGLContext* _cont;
+  MeshRasterizer rasterizer;
+
+  void renderSceneCPU(vcg::Shot<MESHLAB_SCALAR>& shot, int component);
   
  
   GLuint createShaderFromFiles(QString basename); // converted into shader/basename.vert .frag
@@ -104,6 +104,7 @@ void FilterMutualInfoPlugin::initParameterList(const QAction *action,MeshDocumen
 		parlst.addParam(RichFloat("Tolerance", 0.1, "Tolerance", "Threshold to stop convergence"));
 		parlst.addParam(RichFloat("ExpectedVariance", 2.0, "Expected Variance", "Expected Variance"));
 		parlst.addParam(RichInt("BackgroundWeight", 2, "Background Weight", "Weight of background pixels (1, as all the other pixels; 2, one half of the other pixels etc etc)"));
+		parlst.addParam(RichBool("AllRasters", false, "Align all rasters", "If checked, all the rasters with a valid shot are aligned at the same time, each one starting from its own shot (the Starting shot is ignored). The mesh is rendered on the CPU, and the rasters are distributed among the available cores"));
 		break;
 	default :
 		assert(0);
@@ -114,6 +115,13 @@ bool FilterMutualInfoPlugin::applyFilter(const QAction *action, MeshDocument &md
 {
 	switch(ID(action))	 {
 	case FP_IMAGE_MUTUALINFO :
+		if (par.getBool("AllRasters"))
+			return allRastersMutualInfoAlign(
+						md,
+						par.getEnum("Rendering Mode"), par.getBool("Estimate Focal"),
+						par.getBool("Fine"), par.getFloat("ExpectedVariance"),
+						par.getFloat("Tolerance"), par.getInt("NumOfIterations"),
+						par.getInt("BackgroundWeight"));
 		return imageMutualInfoAlign(
 					md,
 					par.getEnum("Rendering Mode"), par.getBool("Estimate Focal"),
@@ -168,45 +176,29 @@ bool FilterMutualInfoPlugin::imageMutualInfoAlign(
 	solver.maxiter = numIterations;
 	mutual.bweight = backGroundWeight;
 
-	switch(rendmode)
-	{
-	case 0:
-		align.mode=AlignSet::COMBINE;
-		break;
-	case 1:
-		align.mode=AlignSet::NORMALMAP;
-		break;
-	case 2:
-		align.mode=AlignSet::COLOR;
-		break;
-	case 3:
-		align.mode=AlignSet::SPECULAR;
-		break;
-	case 4:
-		align.mode=AlignSet::SILHOUETTE;
-		break;
-	case 5:
-		align.mode=AlignSet::SPECAMB;
-		break;
-	default:
-		align.mode=AlignSet::COMBINE;
-		break;
-	}
-
-	align.shot = Shotm::Construct(shot);
-
-	align.shot.Intrinsics.ViewportPx[0]=int((double)align.shot.Intrinsics.ViewportPx[1]*align.image->width()/align.image->height());
-	align.shot.Intrinsics.CenterPx[0]=(int)(align.shot.Intrinsics.ViewportPx[0]/2);
+	align.mode = renderingMode(rendmode);
+	setStartingShot(align, shot);
 
 	///// Initialize GLContext
 
-	log( "Initialize GL");
-	align.setGLContext(glContext);
-	glContext->makeCurrent();
-	if (initGLMutualInfo() == false)
-		return false;
-
-	log( "Done");
+	bool useGL = (glContext != NULL) && glContext->isValid();
+	if (useGL)
+	{
+		log( "Initialize GL");
+		align.setGLContext(glContext);
+		glContext->makeCurrent();
+		useGL = initGLMutualInfo();
+		if (useGL)
+			log( "Done");
+		else
+			glContext->doneCurrent();
+	}
+	if (!useGL)
+	{
+		log(GLLogStream::SYSTEM, "No valid OpenGL context, the mesh is rendered on the CPU");
+		align.setGLContext(NULL);
+		align.resize(800);
+	}
 
 	///// Mutual info calculation: every 30 iterations, the mail glarea is updated
 	int rounds=(int)(solver.maxiter/30);
@@ -221,14 +213,7 @@ bool FilterMutualInfoPlugin::imageMutualInfoAlign(
 		else
 			solver.iterative(&align, &mutual, align.shot);
 
-		md.rm()->shot = Shotm::Construct(align.shot);
-		float ratio=(float)md.rm()->currentPlane->image.height()/(float)align.shot.Intrinsics.ViewportPx[1];
-		md.rm()->shot.Intrinsics.ViewportPx[0]=md.rm()->currentPlane->image.width();
-		md.rm()->shot.Intrinsics.ViewportPx[1]=md.rm()->currentPlane->image.height();
-		md.rm()->shot.Intrinsics.PixelSizeMm[1]/=ratio;
-		md.rm()->shot.Intrinsics.PixelSizeMm[0]/=ratio;
-		md.rm()->shot.Intrinsics.CenterPx[0]=(int)((float)md.rm()->shot.Intrinsics.ViewportPx[0]/2.0);
-		md.rm()->shot.Intrinsics.CenterPx[1]=(int)((float)md.rm()->shot.Intrinsics.ViewportPx[1]/2.0);
+		setRasterShot(md.rm(), align.shot);
 
 		QList<int> rl;
 		rl << md.rm()->id();
@@ -237,11 +222,127 @@ bool FilterMutualInfoPlugin::imageMutualInfoAlign(
 
 		md.documentUpdated();
 	}
-	this->glContext->doneCurrent();
+	if (useGL)
+		this->glContext->doneCurrent();
+
+	return true;
+}
+
+/*
+Every raster is aligned by its own AlignSet, Solver and MutualInfo, so the rasters are
+independent and each thread takes one of them at a time; the mesh is only read. Without
+OpenGL the renderings are done on the CPU by the MeshRasterizer of each AlignSet (nested in
+the loop, its parallel loops run on the thread of the raster). The shots are stored in the
+rasters at the end, out of the parallel region.
+*/
+bool FilterMutualInfoPlugin::allRastersMutualInfoAlign(
+		MeshDocument& md,
+		int rendmode,
+		bool estimateFocal,
+		bool fine,
+		float expectedVariance,
+		float tolerance,
+		int numIterations,
+		int backGroundWeight)
+{
+	std::vector<RasterModel*> rasters;
+	for (RasterModel* rm : md.rasterList)
+	{
+		if (rm->shot.IsValid() && rm->currentPlane != NULL && !rm->currentPlane->image.isNull())
+			rasters.push_back(rm);
+		else
+			log(GLLogStream::FILTER, "Raster %s skipped: shot not valid", qUtf8Printable(rm->label()));
+	}
+	if (rasters.empty()) {
+		log(GLLogStream::FILTER, "You need a Raster Model with a valid shot to apply this filter!");
+		return false;
+	}
+	log("Aligning %i rasters on the CPU", int(rasters.size()));
+
+	const int rn = int(rasters.size());
+	const AlignSet::RenderingMode mode = renderingMode(rendmode);
+	std::vector<Shotm> result(rn);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < rn; ++i)
+	{
+		AlignSet a;
+		a.image = &rasters[i]->currentPlane->image;
+		a.mesh = &md.mm()->cm;
+		a.meshid = md.mm()->id();
+		a.mode = mode;
+		setStartingShot(a, rasters[i]->shot);
+		a.resize(800);
+
+		Solver solver;
+		MutualInfo mutual;
+		solver.optimize_focal = estimateFocal;
+		solver.fine_alignment = fine;
+		solver.variance = expectedVariance;
+		solver.tolerance = tolerance;
+		mutual.bweight = backGroundWeight;
+
+		//the same rounds of 30 iterations of imageMutualInfoAlign
+		const int rounds = numIterations / 30;
+		for (int r = 0; r < rounds; ++r)
+		{
+			solver.maxiter = 30;
+			if (solver.fine_alignment)
+				solver.optimize(&a, &mutual, a.shot);
+			else
+				solver.iterative(&a, &mutual, a.shot);
+		}
+		result[i] = a.shot;
+	}
 
+	for (int i = 0; i < rn; ++i)
+		setRasterShot(rasters[i], result[i]);
+	md.documentUpdated();
 	return true;
 }
 
+AlignSet::RenderingMode FilterMutualInfoPlugin::renderingMode(int rendmode)
+{
+	switch(rendmode)
+	{
+	case 0:
+		return AlignSet::COMBINE;
+	case 1:
+		return AlignSet::NORMALMAP;
+	case 2:
+		return AlignSet::COLOR;
+	case 3:
+		return AlignSet::SPECULAR;
+	case 4:
+		return AlignSet::SILHOUETTE;
+	case 5:
+		return AlignSet::SPECAMB;
+	default:
+		return AlignSet::COMBINE;
+	}
+}
+
+//the viewport of the shot takes the aspect ratio of the image
+void FilterMutualInfoPlugin::setStartingShot(AlignSet& a, const Shotm& shot)
+{
+	a.shot = Shotm::Construct(shot);
+
+	a.shot.Intrinsics.ViewportPx[0]=int((double)a.shot.Intrinsics.ViewportPx[1]*a.image->width()/a.image->height());
+	a.shot.Intrinsics.CenterPx[0]=(int)(a.shot.Intrinsics.ViewportPx[0]/2);
+}
+
+//the aligned shot, back to the size of the raster image
+void FilterMutualInfoPlugin::setRasterShot(RasterModel* rm, const Shotm& alignShot)
+{
+	rm->shot = Shotm::Construct(alignShot);
+	float ratio=(float)rm->currentPlane->image.height()/(float)alignShot.Intrinsics.ViewportPx[1];
+	rm->shot.Intrinsics.ViewportPx[0]=rm->currentPlane->image.width();
+	rm->shot.Intrinsics.ViewportPx[1]=rm->currentPlane->image.height();
+	rm->shot.Intrinsics.PixelSizeMm[1]/=ratio;
+	rm->shot.Intrinsics.PixelSizeMm[0]/=ratio;
+	rm->shot.Intrinsics.CenterPx[0]=(int)((float)rm->shot.Intrinsics.ViewportPx[0]/2.0);
+	rm->shot.Intrinsics.CenterPx[1]=(int)((float)rm->shot.Intrinsics.ViewportPx[1]/2.0);
+}
+
 bool FilterMutualInfoPlugin::initGLMutualInfo()
 {
 	log(0, "GL Initialization");
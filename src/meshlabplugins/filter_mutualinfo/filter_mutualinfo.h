@@ -47,6 +47,7 @@ public:
 	QString filterInfo(FilterIDType filter) const;
 	FilterClass getClass(const QAction* a) const;
 	FILTER_ARITY filterArity(const QAction*) const;
+	bool requiresGLContext(const QAction*) const { return false; }
 	void initParameterList(const QAction*, MeshDocument &, RichParameterList & /*parent*/);
 	bool applyFilter(const QAction* filter, MeshDocument &md, std::map<std::string, QVariant>& outputValues, unsigned int& postConditionMask, const RichParameterList & /*parent*/, vcg::CallBackPos * cb) ;
 	int postCondition(const QAction*) const;
@@ -65,6 +66,19 @@ private:
 			int numIterations,
 			int backGroundWeight,
 			Shotm shot);
+	bool allRastersMutualInfoAlign(
+			MeshDocument &md,
+			int rendmode,
+			bool estimateFocal,
+			bool fine,
+			float expectedVariance,
+			float tolerance,
+			int numIterations,
+			int backGroundWeight);
+
+	static AlignSet::RenderingMode renderingMode(int rendmode);
+	static void setStartingShot(AlignSet& a, const Shotm& shot);
+	static void setRasterShot(RasterModel* rm, const Shotm& alignShot);
 
 	bool initGLMutualInfo();
 };
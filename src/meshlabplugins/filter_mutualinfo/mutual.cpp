@@ -10,7 +10,7 @@
 using namespace std;
 MutualInfo::MutualInfo(unsigned int _nbins, int _bweight, bool _use_background):
   bweight(_bweight), use_background(_use_background),
-  histo2D(NULL), histoA(NULL), histoB(NULL) {
+  histo2D(NULL), histoA(NULL), histoB(NULL), histoPart(NULL) {
 
   setBins(_nbins);
 }
@@ -19,6 +19,7 @@ MutualInfo::~MutualInfo() {
   delete []histo2D;
   delete []histoA;
   delete []histoB;
+  delete []histoPart;
 }
 
 void MutualInfo::setBins(unsigned int _nbins) {
@@ -28,7 +29,9 @@ void MutualInfo::setBins(unsigned int _nbins) {
   if(histo2D) delete []histo2D;
   if(histoA) delete []histoA;
   if(histoB) delete []histoB;
+  if(histoPart) delete []histoPart;
   histo2D = new unsigned int[nbins*nbins];
+  histoPart = new unsigned int[3*nbins*nbins];
   histoA = new unsigned int[nbins];
   histoB = new unsigned int[nbins];
 }
@@ -103,14 +106,31 @@ void MutualInfo::histogram(int width, int height,
   int s = 0; 
   while ( bins>>=1) { ++s; }
 
+  //consecutive pixels are often in the same bin: 4 pixels at a time go in 4 different
+  //histograms, so the increments do not wait for each other, and they are summed at the end.
+  unsigned int size = nbins*nbins;
+  memset(histoPart, 0, 3*size*sizeof(int));
+  unsigned int *h0 = histo2D;
+  unsigned int *h1 = histoPart;
+  unsigned int *h2 = histoPart + size;
+  unsigned int *h3 = histoPart + 2*size;
   for(int y = starty; y < endy; y++) {
     int offset = width*y + startx;
-    for(int x = startx; x < endx; x++, offset++) {
+    int x = startx;
+    for(; x + 3 < endx; x += 4, offset += 4) {
+      h0[(target[offset]>>k) + ((render[offset]>>k)<<s)] += 2;
+      h1[(target[offset+1]>>k) + ((render[offset+1]>>k)<<s)] += 2;
+      h2[(target[offset+2]>>k) + ((render[offset+2]>>k)<<s)] += 2;
+      h3[(target[offset+3]>>k) + ((render[offset+3]>>k)<<s)] += 2;
+    }
+    for(; x < endx; x++, offset++) {
       unsigned char a = target[offset]>>k; //instead of /side;
       unsigned char b = render[offset]>>k; //instead of /side;
       histo2D[a + (b<<s)] += 2;//bweight; //instead of nbins*s
     }
   }
+  for(unsigned int i = 0; i < size; i++)
+    histo2D[i] += h1[i] + h2[i] + h3[i];
   //weight of background is divided.
   //background is when b = 0 -> first row of histo2D
   if(bweight != 0) {
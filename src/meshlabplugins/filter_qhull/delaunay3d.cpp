@@ -0,0 +1,605 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "delaunay3d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <utility>
+
+// face i of a tetrahedron (the one opposite to its vertex i), with vertex i on its positive side
+const int Delaunay3D::FACE[4][3] = { { 1, 3, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 0, 1, 2 } };
+
+namespace {
+
+// > 0 if d is on the positive side of the plane of a, b, c (the tetrahedron abcd is positively oriented)
+inline double orient3d(const double* a, const double* b, const double* c, const double* d)
+{
+	const double bx = b[0] - a[0], by = b[1] - a[1], bz = b[2] - a[2];
+	const double cx = c[0] - a[0], cy = c[1] - a[1], cz = c[2] - a[2];
+	const double dx = d[0] - a[0], dy = d[1] - a[1], dz = d[2] - a[2];
+	return bx * (cy * dz - cz * dy) - by * (cx * dz - cz * dx) + bz * (cx * dy - cy * dx);
+}
+
+// > 0 if e is inside the sphere through the positively oriented tetrahedron abcd
+inline double insphere(const double* a, const double* b, const double* c, const double* d, const double* e)
+{
+	const double aex = a[0] - e[0], aey = a[1] - e[1], aez = a[2] - e[2];
+	const double bex = b[0] - e[0], bey = b[1] - e[1], bez = b[2] - e[2];
+	const double cex = c[0] - e[0], cey = c[1] - e[1], cez = c[2] - e[2];
+	const double dex = d[0] - e[0], dey = d[1] - e[1], dez = d[2] - e[2];
+
+	const double ab = aex * bey - bex * aey;
+	const double bc = bex * cey - cex * bey;
+	const double cd = cex * dey - dex * cey;
+	const double da = dex * aey - aex * dey;
+	const double ac = aex * cey - cex * aey;
+	const double bd = bex * dey - dex * bey;
+
+	const double abc = aez * bc - bez * ac + cez * ab;
+	const double bcd = bez * cd - cez * bd + dez * bc;
+	const double cda = cez * da + dez * ac + aez * cd;
+	const double dab = dez * ab + aez * bd + bez * da;
+
+	const double alift = aex * aex + aey * aey + aez * aez;
+	const double blift = bex * bex + bey * bey + bez * bez;
+	const double clift = cex * cex + cey * cey + cez * cez;
+	const double dlift = dex * dex + dey * dey + dez * dez;
+
+	return -((dlift * abc - clift * dab) + (blift * cda - alift * bcd));
+}
+
+// interleaves the lowest 21 bits of x with two zero bits
+inline uint64_t spreadBits(uint64_t x)
+{
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+
+} // namespace
+
+Delaunay3D::Delaunay3D() :
+	stamp(0), hint(0), rng(1)
+{
+}
+
+void Delaunay3D::face(int t, int i, int f[3]) const
+{
+	// the stored order has vertex i on the positive side, i.e. the normal points inside t
+	const int* v = tet(t);
+	f[0] = v[FACE[i][0]];
+	f[1] = v[FACE[i][2]];
+	f[2] = v[FACE[i][1]];
+}
+
+void Delaunay3D::circumcenter(int t, double c[3]) const
+{
+	const int* v = tet(t);
+	const double* a = inputPt(v[0]);
+	double e[3][3];
+	double l[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const double* p = inputPt(v[k + 1]);
+		for (int j = 0; j < 3; ++j)
+			e[k][j] = p[j] - a[j];
+		l[k] = e[k][0] * e[k][0] + e[k][1] * e[k][1] + e[k][2] * e[k][2];
+	}
+	// solve 2 e[k] . x = l[k] (Cramer)
+	const double det = 2 * (e[0][0] * (e[1][1] * e[2][2] - e[1][2] * e[2][1])
+		- e[0][1] * (e[1][0] * e[2][2] - e[1][2] * e[2][0])
+		+ e[0][2] * (e[1][0] * e[2][1] - e[1][1] * e[2][0]));
+	const double x = l[0] * (e[1][1] * e[2][2] - e[1][2] * e[2][1])
+		- e[0][1] * (l[1] * e[2][2] - e[1][2] * l[2])
+		+ e[0][2] * (l[1] * e[2][1] - e[1][1] * l[2]);
+	const double y = e[0][0] * (l[1] * e[2][2] - e[1][2] * l[2])
+		- l[0] * (e[1][0] * e[2][2] - e[1][2] * e[2][0])
+		+ e[0][2] * (e[1][0] * l[2] - l[1] * e[2][0]);
+	const double z = e[0][0] * (e[1][1] * l[2] - l[1] * e[2][1])
+		- e[0][1] * (e[1][0] * l[2] - l[1] * e[2][0])
+		+ l[0] * (e[1][0] * e[2][1] - e[1][1] * e[2][0]);
+	c[0] = a[0] + x / det;
+	c[1] = a[1] + y / det;
+	c[2] = a[2] + z / det;
+}
+
+double Delaunay3D::circumradius(int t) const
+{
+	double c[3];
+	circumcenter(t, c);
+	const double* a = inputPt(tet(t)[0]);
+	return std::sqrt((c[0] - a[0]) * (c[0] - a[0]) + (c[1] - a[1]) * (c[1] - a[1]) + (c[2] - a[2]) * (c[2] - a[2]));
+}
+
+bool Delaunay3D::isInfinite(int t) const
+{
+	const int* v = &tv[4 * size_t(t)];
+	return v[0] == INF || v[1] == INF || v[2] == INF || v[3] == INF;
+}
+
+bool Delaunay3D::conflict(int t, const double* p) const
+{
+	const int* v = &tv[4 * size_t(t)];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (v[i] != INF)
+			continue;
+		// p beyond the hull face, that has the vertex at infinity on its positive side
+		return orient3d(pt(v[FACE[i][0]]), pt(v[FACE[i][1]]), pt(v[FACE[i][2]]), p) > 0;
+	}
+	return insphere(pt(v[0]), pt(v[1]), pt(v[2]), pt(v[3]), p) > 0;
+}
+
+/*
+Visibility walk: from a face with p on its negative side, move to the tetrahedron beyond it;
+the faces are tested starting from a random one, so the walk cannot cycle. The walk stops
+on the finite tetrahedron containing p or on an infinite one (p outside the hull). If it
+takes too long (rounding errors) every tetrahedron is tested.
+*/
+int Delaunay3D::locate(int start, const double* p)
+{
+	int t = start;
+	if (isInfinite(t))
+	{
+		const int* v = &tv[4 * size_t(t)];
+		for (int i = 0; i < 4; ++i)
+			if (v[i] == INF)
+				t = tn[4 * size_t(t) + i];
+	}
+
+	const int maxSteps = 100000;
+	for (int step = 0; step < maxSteps; ++step)
+	{
+		if (isInfinite(t))
+			return t;
+		const int* v = &tv[4 * size_t(t)];
+		rng = rng * 1103515245u + 12345u;
+		const int r = int((rng >> 16) & 3);
+		int next = -1;
+		for (int k = 0; k < 4 && next < 0; ++k)
+		{
+			const int i = (r + k) & 3;
+			if (orient3d(pt(v[FACE[i][0]]), pt(v[FACE[i][1]]), pt(v[FACE[i][2]]), p) < 0)
+				next = tn[4 * size_t(t) + i];
+		}
+		if (next < 0)
+			return t;
+		t = next;
+	}
+
+	const int tetNum = int(alive.size());
+	for (int s = 0; s < tetNum; ++s)
+		if (alive[s] && conflict(s, p))
+			return s;
+	return -1;
+}
+
+int Delaunay3D::newTet(int a, int b, int c, int d)
+{
+	int t;
+	if (!freeTets.empty())
+	{
+		t = freeTets.back();
+		freeTets.pop_back();
+	}
+	else
+	{
+		t = int(alive.size());
+		tv.resize(tv.size() + 4);
+		tn.resize(tn.size() + 4);
+		alive.push_back(0);
+		mark.push_back(0);
+	}
+	int* v = &tv[4 * size_t(t)];
+	v[0] = a; v[1] = b; v[2] = c; v[3] = d;
+	int* n = &tn[4 * size_t(t)];
+	n[0] = n[1] = n[2] = n[3] = -1;
+	alive[t] = 1;
+	return t;
+}
+
+/*
+Links the faces 0, 1 and 2 of the created tetrahedra, that all have the same vertex 3 (the
+new point, or the vertex at infinity for the first ones): the face opposite to the vertex k
+is shared with the created tetrahedron that has the same edge made of the other two, found
+with a small hash table.
+*/
+void Delaunay3D::glue(const std::vector<int>& created)
+{
+	size_t size = 16;
+	while (size < 4 * created.size())
+		size *= 2;
+	const Side empty = { -1, -1, -1 };
+	sides.assign(size, empty);
+	for (int t : created)
+	{
+		const int* v = &tv[4 * size_t(t)];
+		for (int k = 0; k < 3; ++k)
+		{
+			const long long a = v[(k + 1) % 3] + 1;
+			const long long b = v[(k + 2) % 3] + 1;
+			const long long key = (std::min(a, b) << 32) | std::max(a, b);
+			size_t h = size_t((unsigned long long)key * 0x9E3779B97F4A7C15ULL >> 32) & (size - 1);
+			while (sides[h].key != -1 && sides[h].key != key)
+				h = (h + 1) & (size - 1);
+			if (sides[h].key == key)
+			{
+				tn[4 * size_t(t) + k] = sides[h].t;
+				tn[4 * size_t(sides[h].t) + sides[h].i] = t;
+				sides[h].key = -2;   // each edge is shared by two faces only
+			}
+			else
+			{
+				sides[h].key = key;
+				sides[h].t = t;
+				sides[h].i = k;
+			}
+		}
+	}
+}
+
+/*
+The cavity is the connected set of tetrahedra in conflict with p, found by a breadth first
+visit from the one that contains it; with inexact predicates it could be not star shaped
+from p, so the tetrahedra with a boundary face not seen by p are removed from it until it is.
+*/
+bool Delaunay3D::insert(int v)
+{
+	const double* p = pt(v);
+	const int start = locate(hint, p);
+	if (start < 0 || !conflict(start, p))
+		return false;
+
+	// mark: 2*stamp in the cavity, 2*stamp+1 tested and not in conflict
+	++stamp;
+	int in = 2 * stamp;
+	const int out = 2 * stamp + 1;
+	cavity.clear();
+	boundary.clear();
+	mark[start] = in;
+	cavity.push_back(start);
+	for (size_t q = 0; q < cavity.size(); ++q)
+	{
+		const int t = cavity[q];
+		for (int i = 0; i < 4; ++i)
+		{
+			const int n = tn[4 * size_t(t) + i];
+			if (mark[n] == in)
+				continue;
+			if (mark[n] != out && conflict(n, p))
+			{
+				mark[n] = in;
+				cavity.push_back(n);
+				continue;
+			}
+			mark[n] = out;
+			boundary.push_back({ t, i });
+		}
+	}
+
+	for (;;)
+	{
+		bool starShaped = true;
+		for (const Boundary& b : boundary)
+		{
+			const int* tvb = &tv[4 * size_t(b.t)];
+			const int f0 = tvb[FACE[b.i][0]], f1 = tvb[FACE[b.i][1]], f2 = tvb[FACE[b.i][2]];
+			if (f0 == INF || f1 == INF || f2 == INF)
+				continue;
+			if (orient3d(pt(f0), pt(f1), pt(f2), p) > 0)
+				continue;
+			if (b.t == start)
+			{
+				for (int t : cavity)
+					mark[t] = 0;
+				return false;
+			}
+			mark[b.t] = 0;
+			starShaped = false;
+		}
+		if (starShaped)
+			break;
+
+		// the part of the cavity still connected to start, and its boundary
+		++stamp;
+		const int visited = 2 * stamp;
+		cavity.clear();
+		boundary.clear();
+		mark[start] = visited;
+		cavity.push_back(start);
+		for (size_t q = 0; q < cavity.size(); ++q)
+		{
+			const int t = cavity[q];
+			for (int i = 0; i < 4; ++i)
+			{
+				const int n = tn[4 * size_t(t) + i];
+				if (mark[n] == visited)
+					continue;
+				if (mark[n] == in)
+				{
+					mark[n] = visited;
+					cavity.push_back(n);
+				}
+				else
+					boundary.push_back({ t, i });
+			}
+		}
+		in = visited;
+	}
+
+	// a new tetrahedron on each boundary face, glued to the one beyond it and to each other
+	created.clear();
+	for (const Boundary& b : boundary)
+	{
+		const int* tvb = &tv[4 * size_t(b.t)];
+		const int nt = newTet(tvb[FACE[b.i][0]], tvb[FACE[b.i][1]], tvb[FACE[b.i][2]], v);
+		const int n = tn[4 * size_t(b.t) + b.i];
+		tn[4 * size_t(nt) + 3] = n;
+		for (int j = 0; j < 4; ++j)
+			if (tn[4 * size_t(n) + j] == b.t)
+				tn[4 * size_t(n) + j] = nt;
+		created.push_back(nt);
+	}
+	for (int t : cavity)
+	{
+		alive[t] = 0;
+		mark[t] = 0;
+		freeTets.push_back(t);
+	}
+	glue(created);
+	hint = created.back();
+	return true;
+}
+
+/*
+Biased randomized insertion order: the shuffled points are split in rounds of doubling size
+(the last one has half of the points), and each round is sorted along a Morton curve.
+*/
+void Delaunay3D::brioOrder(std::vector<int>& order, unsigned int seed) const
+{
+	std::mt19937 gen(seed);
+	std::shuffle(order.begin(), order.end(), gen);
+
+	double bmin[3], bmax[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		bmin[k] = std::numeric_limits<double>::max();
+		bmax[k] = -std::numeric_limits<double>::max();
+	}
+	for (int v : order)
+		for (int k = 0; k < 3; ++k)
+		{
+			bmin[k] = std::min(bmin[k], inputPt(v)[k]);
+			bmax[k] = std::max(bmax[k], inputPt(v)[k]);
+		}
+	double scale = 0;
+	for (int k = 0; k < 3; ++k)
+		scale = std::max(scale, bmax[k] - bmin[k]);
+	scale = (scale > 0) ? double(0x1fffff) / scale : 0;
+
+	const int n = int(order.size());
+	std::vector<std::pair<uint64_t, int>> keyed(n);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i)
+	{
+		const double* p = inputPt(order[i]);
+		uint64_t code = 0;
+		for (int k = 0; k < 3; ++k)
+			code |= spreadBits(uint64_t((p[k] - bmin[k]) * scale)) << k;
+		keyed[i] = std::make_pair(code, order[i]);
+	}
+
+	std::vector<std::pair<int, int>> rounds;
+	for (int end = n; end > 0;)
+	{
+		const int begin = (end > 1000) ? end / 2 : 0;
+		rounds.push_back(std::make_pair(begin, end));
+		end = begin;
+	}
+	const int roundNum = int(rounds.size());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int r = 0; r < roundNum; ++r)
+		std::sort(keyed.begin() + rounds[r].first, keyed.begin() + rounds[r].second);
+
+	for (int i = 0; i < n; ++i)
+		order[i] = keyed[i].second;
+}
+
+/*
+The first tetrahedron is made of extreme points, then the others are inserted in BRIO order;
+the working points are stored in that order (the index of a working vertex is its position
+in ids), so that consecutive insertions read nearby memory.
+*/
+bool Delaunay3D::build(const std::vector<double>& points, unsigned int seed)
+{
+	tets.clear();
+	neighbors.clear();
+	tv.clear();
+	tn.clear();
+	alive.clear();
+	freeTets.clear();
+	mark.clear();
+	stamp = 0;
+	rng = seed * 2654435761u + 1;
+
+	input = points;
+	const int n = int(points.size() / 3);
+	vertex.assign(n, 0);
+	if (n < 4)
+		return false;
+
+	// the exact duplicates are removed
+	std::vector<int> order(n);
+	for (int i = 0; i < n; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return std::lexicographical_compare(inputPt(a), inputPt(a) + 3, inputPt(b), inputPt(b) + 3);
+	});
+	order.erase(std::unique(order.begin(), order.end(), [&](int a, int b) {
+		return std::equal(inputPt(a), inputPt(a) + 3, inputPt(b));
+	}), order.end());
+	if (order.size() < 4)
+		return false;
+
+	// first tetrahedron: the extreme points
+	int v0 = order[0];
+	for (int v : order)
+		if (inputPt(v)[0] < inputPt(v0)[0])
+			v0 = v;
+	auto dist2 = [&](int a, int b) {
+		double d = 0;
+		for (int k = 0; k < 3; ++k)
+			d += (inputPt(a)[k] - inputPt(b)[k]) * (inputPt(a)[k] - inputPt(b)[k]);
+		return d;
+	};
+	int v1 = (order[0] == v0) ? order[1] : order[0];
+	for (int v : order)
+		if (dist2(v0, v) > dist2(v0, v1))
+			v1 = v;
+	int v2 = -1;
+	double best = 0;
+	for (int v : order)
+	{
+		double e1[3], e2[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			e1[k] = inputPt(v1)[k] - inputPt(v0)[k];
+			e2[k] = inputPt(v)[k] - inputPt(v0)[k];
+		}
+		const double cx = e1[1] * e2[2] - e1[2] * e2[1];
+		const double cy = e1[2] * e2[0] - e1[0] * e2[2];
+		const double cz = e1[0] * e2[1] - e1[1] * e2[0];
+		const double a = cx * cx + cy * cy + cz * cz;
+		if (a > best)
+		{
+			best = a;
+			v2 = v;
+		}
+	}
+	if (v2 < 0)
+		return false;
+	int v3 = -1;
+	best = 0;
+	for (int v : order)
+	{
+		const double o = std::fabs(orient3d(inputPt(v0), inputPt(v1), inputPt(v2), inputPt(v)));
+		if (o > best)
+		{
+			best = o;
+			v3 = v;
+		}
+	}
+	const double diag = std::sqrt(dist2(v0, v1));
+	if (v3 < 0 || best <= 1e-9 * diag * diag * diag)
+		return false;
+
+	order.erase(std::remove_if(order.begin(), order.end(), [&](int v) {
+		return v == v0 || v == v1 || v == v2 || v == v3;
+	}), order.end());
+	brioOrder(order, seed);
+	ids.resize(order.size() + 4);
+	ids[0] = v0;
+	ids[1] = v1;
+	ids[2] = v2;
+	ids[3] = v3;
+	std::copy(order.begin(), order.end(), ids.begin() + 4);
+
+	// joggle
+	double size = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		double lo = std::numeric_limits<double>::max(), hi = -lo;
+		for (int v : ids)
+		{
+			lo = std::min(lo, inputPt(v)[k]);
+			hi = std::max(hi, inputPt(v)[k]);
+		}
+		size = std::max(size, std::max(hi - lo, std::max(std::fabs(lo), std::fabs(hi))));
+	}
+	const int m = int(ids.size());
+	pts.resize(3 * size_t(m));
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<double> jog(-1e-11 * size, 1e-11 * size);
+	for (int i = 0; i < m; ++i)
+		for (int k = 0; k < 3; ++k)
+			pts[3 * size_t(i) + k] = inputPt(ids[i])[k] + jog(gen);
+
+	created.clear();
+	const int first = (orient3d(pt(0), pt(1), pt(2), pt(3)) > 0) ? newTet(0, 1, 2, 3) : newTet(0, 2, 1, 3);
+	for (int i = 0; i < 4; ++i)
+	{
+		const int* f = &tv[4 * size_t(first)];
+		// the outside of the face is the positive side of the reversed face
+		const int t = newTet(f[FACE[i][0]], f[FACE[i][2]], f[FACE[i][1]], INF);
+		tn[4 * size_t(first) + i] = t;
+		tn[4 * size_t(t) + 3] = first;
+		created.push_back(t);
+	}
+	glue(created);
+	hint = first;
+	for (int i = 0; i < m; ++i)
+		if (i < 4 || insert(i))
+			vertex[ids[i]] = 1;
+
+	// compaction of the finite tetrahedra
+	const int workNum = int(alive.size());
+	std::vector<int> remap(workNum, -1);
+	int finite = 0;
+	for (int t = 0; t < workNum; ++t)
+		if (alive[t] && !isInfinite(t))
+			remap[t] = finite++;
+	tets.resize(4 * size_t(finite));
+	neighbors.resize(4 * size_t(finite));
+#pragma omp parallel for schedule(static)
+	for (int t = 0; t < workNum; ++t)
+	{
+		if (remap[t] < 0)
+			continue;
+		for (int i = 0; i < 4; ++i)
+		{
+			tets[4 * size_t(remap[t]) + i] = ids[tv[4 * size_t(t) + i]];
+			neighbors[4 * size_t(remap[t]) + i] = remap[tn[4 * size_t(t) + i]];
+		}
+	}
+
+	tv.clear();
+	tv.shrink_to_fit();
+	tn.clear();
+	tn.shrink_to_fit();
+	alive.clear();
+	mark.clear();
+	freeTets.clear();
+	pts.clear();
+	pts.shrink_to_fit();
+	ids.clear();
+	ids.shrink_to_fit();
+	return true;
+}
@@ -0,0 +1,121 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_QHULL_DELAUNAY3D_H
+#define FILTER_QHULL_DELAUNAY3D_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+Delaunay3D
+The Delaunay tetrahedralization of a set of 3D points, computed without qhull: all the
+state is in the object, so any number of them can be built at the same time by different
+threads (qhull-2003 keeps its state in the global qh struct).
+
+The points are inserted one at a time (Bowyer-Watson: the tetrahedra whose circumsphere
+contains the new point are replaced by a star of new ones) in a BRIO order: random rounds of
+doubling size, each sorted along a Morton curve, so that each point is located by a short
+walk from the last inserted one. The hull is closed by infinite tetrahedra (a finite face
+and a vertex at infinity), so no bounding tetrahedron distorts the result near the hull.
+As qhull with the QJ option does, the input is joggled by a tiny random amount (relative
+1e-11 of its size) so that there are no cospherical or coplanar points and the output is
+always simplicial; the predicates are evaluated in double precision, and each cavity is
+checked to be star shaped from the new point. Duplicated points are inserted once.
+The sort of the rounds is parallel; the insertion is sequential.
+*/
+class Delaunay3D
+{
+public:
+	Delaunay3D();
+
+	// the points are n (x, y, z) triplets; false if they are less than 4 distinct
+	// points, or if they are all coplanar
+	bool build(const std::vector<double>& points, unsigned int seed = 0);
+
+	int tetNum() const { return int(tets.size() / 4); }
+	// the 4 points of the finite tetrahedron t (indices in the input), positively oriented
+	const int* tet(int t) const { return &tets[4 * size_t(t)]; }
+	// the tetrahedron sharing the face of t opposite to its vertex i, -1 on the convex hull
+	int neighbor(int t, int i) const { return neighbors[4 * size_t(t) + i]; }
+	// the points of the face of t opposite to its vertex i, ordered so that the face normal
+	// points outside t
+	void face(int t, int i, int f[3]) const;
+	// true if the point p is a vertex of the tetrahedralization (false for duplicates)
+	bool isVertex(int p) const { return vertex[p] != 0; }
+
+	// circumcenter and circumradius of the tetrahedron t
+	void circumcenter(int t, double c[3]) const;
+	double circumradius(int t) const;
+
+private:
+	static const int INF = -1;
+	static const int FACE[4][3];
+
+	struct Boundary
+	{
+		int t;   // a tetrahedron of the cavity
+		int i;   // its face on the cavity boundary
+	};
+	struct Side
+	{
+		long long key;   // the vertices of an edge
+		int t;
+		int i;
+	};
+
+	const double* pt(int v) const { return &pts[3 * size_t(v)]; }
+	const double* inputPt(int v) const { return &input[3 * size_t(v)]; }
+	bool isInfinite(int t) const;
+	bool conflict(int t, const double* p) const;
+	int locate(int start, const double* p);
+	bool insert(int v);
+	int newTet(int a, int b, int c, int d);
+	void glue(const std::vector<int>& created);
+	void brioOrder(std::vector<int>& order, unsigned int seed) const;
+
+	std::vector<double> input;   // the input points
+	std::vector<double> pts;     // the joggled points, in insertion order
+	std::vector<int> ids;        // the input index of each working vertex
+	std::vector<char> vertex;
+
+	// working tetrahedra: 4 vertices (INF for the vertex at infinity) and 4 neighbors each
+	std::vector<int> tv;
+	std::vector<int> tn;
+	std::vector<char> alive;
+	std::vector<int> freeTets;
+	std::vector<int> mark;
+	int stamp;
+	int hint;
+	unsigned int rng;
+	std::vector<int> cavity;
+	std::vector<Boundary> boundary;
+	std::vector<int> created;
+	std::vector<Side> sides;
+
+	// the finite tetrahedra after build()
+	std::vector<int> tets;
+	std::vector<int> neighbors;
+};
+
+#endif // FILTER_QHULL_DELAUNAY3D_H
@@ -83,25 +83,25 @@ QString QhullPlugin::pluginName() const
  QString QhullPlugin::filterInfo(FilterIDType filterId) const
 {
   switch(filterId) {
-        case FP_QHULL_CONVEX_HULL :  return QString("Calculate the <b>convex hull</b> with Qhull library (http://www.qhull.org/html/qconvex.htm).<br><br> "
+        case FP_QHULL_CONVEX_HULL :  return QString("Calculate the <b>convex hull</b> of the vertices of the mesh (quickhull). On big point clouds the hulls of chunks of the points are computed in parallel, then the hull of their vertices.<br><br> "
                                          "The convex hull of a set of points is the boundary of the minimal convex set containing the given non-empty finite set of points.");
-        case FP_QHULL_DELAUNAY_TRIANGULATION :  return QString("Calculate the <b>Delaunay triangulation</b> with Qhull library (http://www.qhull.org/html/qdelaun.htm).<br><br>"
+        case FP_QHULL_DELAUNAY_TRIANGULATION :  return QString("Calculate the <b>Delaunay triangulation</b> of the vertices of the mesh, with a randomized incremental construction.<br><br>"
                                                     "The Delaunay triangulation DT(P) of a set of points P in d-dimensional spaces is a triangulation of the convex hull "
-                                                    "such that no point in P is inside the circum-sphere of any simplex in DT(P).<br> ");
-        case FP_QHULL_VORONOI_FILTERING :  return QString("Compute a <b>Voronoi filtering</b> (Amenta and Bern 1998) with Qhull library (http://www.qhull.org/). <br><br>"
+                                                    "such that no point in P is inside the circum-sphere of any simplex in DT(P).<br>"
+                                                    "As with the 'QJ' option of Qhull, the points are joggled by a tiny amount, so that the output is always made of tetrahedra.<br> ");
+        case FP_QHULL_VORONOI_FILTERING :  return QString("Compute a <b>Voronoi filtering</b> (Amenta and Bern 1998). <br><br>"
                                                "The algorithm calculates a triangulation of the input point cloud without requiring vertex normals."
                                                "It uses a subset of the Voronoi vertices to remove triangles from the Delaunay triangulation. <br>"
                                                "After computing the Voronoi diagram, foreach sample point it chooses the two farthest opposite Voronoi vertices."
                                                "Then computes a Delaunay triangulation of the sample points and the selected Voronoi vertices, and keep "
                                                "only those triangles in witch all three vertices are sample points.");
-        case FP_QHULL_ALPHA_COMPLEX_AND_SHAPE: return QString("Calculate the <b>Alpha Shape</b> of the mesh(Edelsbrunner and P.Mucke 1994) with Qhull library (http://www.qhull.org/). <br><br>"
+        case FP_QHULL_ALPHA_COMPLEX_AND_SHAPE: return QString("Calculate the <b>Alpha Shape</b> of the mesh(Edelsbrunner and P.Mucke 1994). <br><br>"
                                         "From a given finite point set in the space it computes 'the shape' of the set."
                                         "The Alpha Shape is the boundary of the alpha complex, that is a subcomplex of the Delaunay triangulation of the given point set.<br>"
                                         "For a given value of 'alpha', the alpha complex includes all the simplices in the Delaunay "
                                         "triangulation which have an empty circumsphere with radius equal or smaller than 'alpha'.<br>"
                                         "The filter inserts the minimum value of alpha (the circumradius of the triangle) in attribute Quality foreach face.");
-        case FP_QHULL_VISIBLE_POINTS: return QString("Select the <b>visible points</b> in a point cloud, as viewed from a given viewpoint.<br>"
-                                          "It uses the Qhull library (http://www.qhull.org/ <br><br>"
+        case FP_QHULL_VISIBLE_POINTS: return QString("Select the <b>visible points</b> in a point cloud, as viewed from a given viewpoint, or from the viewpoints of all the rasters.<br><br>"
                                           "The algorithm used (Katz, Tal and Basri 2007) determines visibility without reconstructing a surface or estimating normals."
                                           "A point is considered visible if its transformed point lies on the convex hull of a transformed points cloud from the original mesh points.");
         default : assert(0);
@@ -150,10 +150,10 @@ void QhullPlugin::initParameterList(const QAction *action,MeshModel &m, RichPara
         case FP_QHULL_VORONOI_FILTERING :
             {
                 parlst.addParam(RichDynamicFloat("threshold",10.0f, 0.0f, 2000.0f,"Pole Discard Thr",
-                "Threshold used to discard the Voronoi vertices too far from the origin."
+                "Threshold used to discard the Voronoi vertices too far from the center of the bbox of the mesh."
                 "We discard vertices are further than this factor times the bbox diagonal <br>"
                 "Growing values of this value will add more Voronoi vertices for a better tightier surface reconstruction."
-                "On the other hand they will increase processing time and could cause numerical problems to the qhull library.<br>"
+                "On the other hand they will increase processing time and could cause numerical problems.<br>"
                                                                                          ));
                 break;
             }
@@ -185,6 +185,11 @@ void QhullPlugin::initParameterList(const QAction *action,MeshModel &m, RichPara
                                                 Point3f(0.0f, 0.0f, 0.0f),
                                                 "ViewPoint",
                                                 "if UseCamera is true, this value is ignored"));
+                parlst.addParam(RichBool("allRasters",
+                                                false,
+                                                "Use the ViewPoints of all the Rasters",
+                                                "Select the points visible from at least one of the rasters of the project (the viewpoints are processed in parallel).\n"
+                                                "If true, the other viewpoints and the output meshes are ignored"));
 
                 parlst.addParam(RichBool("convex_hullFP",false,"Show Partial Convex Hull of flipped points", "Show Partial Convex Hull of the transformed point cloud"));
                 parlst.addParam(RichBool("triangVP",false,"Show a triangulation of the visible points", "Show a triangulation of the visible points"));
@@ -207,7 +212,7 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                 MeshModel &m=*md.mm();
                 MeshModel &pm =*md.addNewMesh("","Convex Hull");
                 pm.updateDataMask(MeshModel::MM_FACEFACETOPO);
-                bool result = vcg::tri::ConvexHull<CMeshO, CMeshO>::ComputeConvexHull(m.cm, pm.cm);
+                bool result = compute_convex_hull(m.cm, pm.cm);
                 pm.clearDataMask(MeshModel::MM_FACEFACETOPO);
                 pm.UpdateBoxAndNormals();
                 return result;
@@ -220,75 +225,15 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                     m.clearDataMask(MeshModel::MM_WEDGTEXCOORD);
                     m.clearDataMask(MeshModel::MM_VERTTEXCOORD);
 
-                int dim= 3;				/* dimension of points */
-                int numpoints= m.cm.vn;	/* number of mesh vertices */
-
-                //facet_list contains the Delaunauy triangulation as a list of tetrahedral facets */
-                facetT *facet_list = compute_delaunay(dim,numpoints,m);
-
-                if(facet_list!=NULL){
-
-                    int convexNumVert = qh_setsize(qh_facetvertices (facet_list, NULL, false));
-                    assert( qh num_vertices == convexNumVert);
-
-                    tri::Allocator<CMeshO>::AddVertices(pm.cm,convexNumVert);
-
-                    vector<tri::Allocator<CMeshO>::VertexPointer> ivp(qh num_vertices);
-                    vertexT *vertex;
-                    int i=0;
-                    FORALLvertices{
-                        if ((*vertex).point){
-                            pm.cm.vert[i].P()[0] = (*vertex).point[0];
-                            pm.cm.vert[i].P()[1] = (*vertex).point[1];
-                            pm.cm.vert[i].P()[2] = (*vertex).point[2];
-                            ivp[qh_pointid(vertex->point)] = &pm.cm.vert[i];
-                            i++;
-                        }
-                    }
-
-                    // In 3-d Delaunay triangulation each facet is a tetrahedron. If triangulated,
-                    //each ridge (d-1 vertices between two neighboring facets) is a triangle.
-
-                    facetT *facet, *neighbor;
-                    qh visit_id++;
-                    int ridgeCount=0;
-
-                    //Compute each ridge (triangle) once
-                    FORALLfacet_(facet_list)
-                    if (!facet->upperdelaunay) {
-                        facet->visitid= qh visit_id;
-                        qh_makeridges(facet);
-                        ridgeT *ridge, **ridgep;
-                        FOREACHridge_(facet->ridges) {
-                            neighbor= otherfacet_(ridge, facet);
-                            if (neighbor->visitid != qh visit_id) {
-                                tri::Allocator<CMeshO>::FaceIterator fi=tri::Allocator<CMeshO>::AddFaces(pm.cm,1);
-                                ridgeCount++;
-                                int vertex_n, vertex_i;
-                                FOREACHvertex_i_(ridge->vertices)
-                                    (*fi).V(vertex_i)= ivp[qh_pointid(vertex->point)];
-                            }
-                        }
-                    }
-
-                    assert(pm.cm.fn == ridgeCount);
-                    log("Successfully created a mesh of %i vert and %i faces",pm.cm.vn,pm.cm.fn);
-                    //m.cm.Clear();
-
-                    //vcg::tri::UpdateBounding<CMeshO>::Box(pm.cm);
-                    //vcg::tri::UpdateNormal<CMeshO>::PerVertexNormalizedPerFace(pm.cm);
-                    pm.UpdateBoxAndNormals();
-
-                    int curlong, totlong;	  /* memory remaining after qh_memfreeshort */
-                    qh_freeqhull(!qh_ALL);
-                    qh_memfreeshort (&curlong, &totlong);
-                    if (curlong || totlong)
-                        fprintf (stderr, "qhull internal warning (main): did not free %d bytes of long memory (%d pieces)\n",
-                                     totlong, curlong);
-                    return true;
-                }
-                else
+                if (!compute_delaunay(m, pm))
+                {
+                    errorMessage = "Unable to compute the Delaunay triangulation: the mesh must have at least 4 distinct vertices, not all coplanar.";
                     return false;
+                }
+
+                log("Successfully created a mesh of %i vert and %i faces",pm.cm.vn,pm.cm.fn);
+                pm.UpdateBoxAndNormals();
+                return true;
             }
             case FP_QHULL_VORONOI_FILTERING:
             {
@@ -298,12 +243,9 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                     m.clearDataMask(MeshModel::MM_WEDGTEXCOORD);
                     m.clearDataMask(MeshModel::MM_VERTTEXCOORD);
 
-                int dim= 3;				/* dimension of points */
-                int numpoints= m.cm.vn;	/* number of mesh vertices */
-
                 float threshold = par.getDynamicFloat("threshold");
 
-                bool result = compute_voronoi(dim,numpoints,m,pm,threshold);
+                bool result = compute_voronoi(m,pm,threshold);
 
                 if(result){
                     //vcg::tri::UpdateBounding<CMeshO>::Box(pm.cm);
@@ -327,9 +269,6 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                     m.clearDataMask(MeshModel::MM_VERTTEXCOORD);
                 }
 
-                int dim= 3;				/* dimension of points */
-                int numpoints= m.cm.vn;	/* number of mesh vertices */
-
                 double alpha = par.getAbsPerc("alpha");
 
                 bool alphashape = false;
@@ -353,7 +292,7 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                     pm.updateDataMask(MeshModel::MM_FACEQUALITY);
                 }
 
-                bool result =compute_alpha_shapes(dim,numpoints,m,pm,alpha,alphashape);
+                bool result =compute_alpha_shapes(m,pm,alpha,alphashape);
 
                 if(result){
                     //vcg::tri::UpdateBounding<CMeshO>::Box(pm.cm);
@@ -377,13 +316,26 @@ bool QhullPlugin::applyFilter(const QAction *filter, MeshDocument &md, std::map<
                 //Clear old selection
                 tri::UpdateSelection<CMeshO>::VertexClear(m.cm);
 
-                int dim= 3;				/* dimension of points */
-                int numpoints= m.cm.vn;	/* number of mesh vertices */
-
                 bool usecam = par.getBool("usecamera");
                 Point3m viewpoint = par.getPoint3m("viewpoint");
                 float threshold = par.getDynamicFloat("radiusThreshold");
 
+                if (par.getBool("allRasters"))
+                {
+                    vector<Point3m> viewpoints;
+                    foreach (RasterModel *rm, md.rasterList)
+                        if (rm->shot.IsValid())
+                            viewpoints.push_back(rm->shot.GetViewPoint());
+                    if (viewpoints.empty())
+                    {
+                        errorMessage = "There are no rasters with a valid camera whose viewpoints can be used.";
+                        return false;
+                    }
+                    int result = visible_points(m.cm, viewpoints, threshold);
+                    log("Selected %i points visible from %i viewpoints", result, int(viewpoints.size()));
+                    return true;
+                }
+
                 // if usecamera but mesh does not have one
                 if( usecam && !m.hasDataMask(MeshModel::MM_CAMERA) )
                 {
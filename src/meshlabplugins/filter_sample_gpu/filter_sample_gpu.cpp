@@ -23,9 +23,13 @@
 
 #include "filter_sample_gpu.h"
 #include <common/GLExtensionsManager.h>
+#include <common/ml_document/mesh_ray_bvh.h>
 #include <wrap/glw/glw.h>
 #include <QImage>
 
+#include <algorithm>
+#include <cmath>
+
 // Constructor usually performs only two simple tasks of filling the two lists
 //  - typeList: with all the possible id of the filtering actions
 //  - actionList with the corresponding actions. If you want to add icons to your filtering actions you can do here by construction the QActions accordingly
@@ -106,6 +110,52 @@ void ExtraSampleGPUPlugin::initParameterList(const QAction * action, MeshModel &
 	}
 }
 
+// Ray casting version of the rendering below, used when there is no gl context.
+// Same camera (50 degrees perspective from (0,0,1) on the mesh scaled to unit diagonal) and
+// same lambertian shading of the vertex normals, but the triangles are filled
+// instead of drawing points and wireframe.
+static void renderImageCPU(const CMeshO & mesh, const QColor & backgroundColor, QImage & image)
+{
+	const MeshRayBVH bvh(mesh);
+
+	const int     width      = image.width();
+	const int     height     = image.height();
+	const Point3m center     = mesh.bbox.Center();
+	const Scalarm scale      = Scalarm(1) / mesh.bbox.Diag();
+	const Scalarm tanHalfFov = std::tan(vcg::math::ToRad(Scalarm(25)));
+	const Scalarm aspect     = Scalarm(width) / Scalarm(height);
+	const Point3m eye        = center + Point3m(0, 0, 1) / scale;
+	const QRgb    background = backgroundColor.rgba();
+
+	uchar *   bits         = image.bits();
+	const int bytesPerLine = image.bytesPerLine();
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int y = 0; y < height; ++y)
+	{
+		QRgb * line = reinterpret_cast<QRgb *>(bits + y * bytesPerLine);
+		for (int x = 0; x < width; ++x)
+		{
+			// view space direction with unit depth: t is the distance from the eye along the view axis
+			const Point3m dirVS((Scalarm(2) * (x + Scalarm(0.5)) / width  - 1) * tanHalfFov * aspect,
+			                    (1 - Scalarm(2) * (y + Scalarm(0.5)) / height) * tanHalfFov,
+			                    -1);
+			MeshRayBVH::Hit hit;
+			if (!bvh.closestHit(eye, dirVS / scale, Scalarm(0.1), Scalarm(2), hit))
+			{
+				line[x] = background;
+				continue;
+			}
+			const CFaceO & f = mesh.face[hit.face];
+			Point3m normal = f.cV(0)->cN() * (1 - hit.u - hit.v) + f.cV(1)->cN() * hit.u + f.cV(2)->cN() * hit.v;
+			normal.Normalize();
+			// the view has no rotation, so the light direction (0,0,-1) is the same in mesh space
+			const int lambert = int(Scalarm(255) * std::max(Scalarm(0), normal.Z()) + Scalarm(0.5));
+			line[x] = qRgba(lambert, lambert, lambert, 255);
+		}
+	}
+}
+
 // The Real Core Function doing the actual mesh processing.
 // Move Vertex of a random quantity
 bool ExtraSampleGPUPlugin::applyFilter(const QAction * a, MeshDocument & md , std::map<std::string, QVariant>&, unsigned int& /*postConditionMask*/, const RichParameterList & par, vcg::CallBackPos * /*cb*/)
@@ -117,6 +167,15 @@ bool ExtraSampleGPUPlugin::applyFilter(const QAction * a, MeshDocument & md , st
 			CMeshO & mesh = md.mm()->cm;
 			if ((mesh.vn < 3) || (mesh.fn < 1)) return false;
 
+			if ((glContext == NULL) || !glContext->isValid())
+			{
+				log("No valid OpenGL context, the image is ray casted on the CPU");
+				QImage image(par.getInt("ImageWidth"), par.getInt("ImageHeight"), QImage::Format_ARGB32);
+				renderImageCPU(mesh, par.getColor("ImageBackgroundColor"), image);
+				image.save(par.getSaveFileName("ImageFileName"));
+				break;
+			}
+
 //			const unsigned char * p0      = (const unsigned char *)(&(mesh.vert[0].P()));
 //			const unsigned char * p1      = (const unsigned char *)(&(mesh.vert[1].P()));
 //			const void *          pbase   = p0;
@@ -40,6 +40,8 @@ $Log: samplefilter.cpp,v $
 #include <vcg/complex/algorithms/geodesic.h>
 #include <vcg/complex/algorithms/voronoi_processing.h>
 
+#include <common/ml_document/poisson_disk.h>
+
 #include <QElapsedTimer>
 
 using namespace vcg;
@@ -546,6 +548,7 @@ void FilterDocSampling::initParameterList(const QAction *action, MeshDocument &
     parlst.addParam(RichInt("BestSamplePool", 10, "Best Sample Pool Size", "Used only if the Best Sample Flag is true. It control the number of attempt that it makes to get the best sample. It is reasonable that it is smaller than the Montecarlo oversampling factor."));
     parlst.addParam(RichBool("ExactNumFlag", false, "Exact number of samples", "If requested it will try to do a dicotomic search for the best poisson disk radius that will generate the requested number of samples with a tolerance of the 0.5%. Obviously it takes much longer."));
     parlst.addParam(RichFloat("RadiusVariance", 1, "Radius Variance", "The radius of the disk is allowed to vary between r and r*var. If this parameter is 1 the sampling is the same of the Poisson Disk Sampling"));
+    parlst.addParam(RichBool("Parallel", false, "Parallel", "If true the Montecarlo samples are generated and pruned on all the cores: the grid cells of the samples are processed in phases of cells far enough to never remove the same samples. The result is still a Poisson-disk sampling, but not the same of the serial one."));
     break;
 
   case FP_TEXEL_SAMPLING :
@@ -996,7 +999,9 @@ bool FilterDocSampling::applyFilter(
 			QElapsedTimer tt;tt.start();
 			BaseSampler sampler(presampledMesh);
 			sampler.qualitySampling=true;
-			if(pp.adaptiveRadiusFlag)
+			if(par.getBool("Parallel"))
+				PoissonDiskSampler::montecarlo(curMM->cm, *presampledMesh, sampleNum*par.getInt("MontecarloRate"), 0, pp.adaptiveRadiusFlag ? pp.radiusVariance : 1);
+			else if(pp.adaptiveRadiusFlag)
 				tri::SurfaceSampling<CMeshO,BaseSampler>::WeightedMontecarlo(curMM->cm, sampler, sampleNum*par.getInt("MontecarloRate"),pp.radiusVariance);
 			else
 				tri::SurfaceSampling<CMeshO,BaseSampler>::Montecarlo(curMM->cm, sampler, sampleNum*par.getInt("MontecarloRate"));
@@ -1013,15 +1018,47 @@ bool FilterDocSampling::applyFilter(
 		pp.geodesicDistanceFlag=par.getBool("ApproximateGeodesicDistance");
 		pp.bestSampleChoiceFlag=par.getBool("BestSampleFlag");
 		pp.bestSamplePoolSize =par.getInt("BestSamplePool");
-		if(par.getBool("ExactNumFlag"))
-			tri::SurfaceSampling<CMeshO,BaseSampler>::PoissonDiskPruningByNumber(mps, *presampledMesh, sampleNum, radius,pp,0.005);
+		Point3i g;
+		int gridCellNum;
+		if(par.getBool("Parallel"))
+		{
+			PoissonDiskSampler::Params pdp;
+			pdp.adaptiveRadius   = pp.adaptiveRadiusFlag;
+			pdp.radiusVariance   = pp.radiusVariance;
+			pdp.geodesicDistance = pp.geodesicDistanceFlag;
+			pdp.bestSample       = pp.bestSampleChoiceFlag;
+			pdp.bestSamplePool   = pp.bestSamplePoolSize;
+			if(pp.preGenFlag)
+				pdp.preGen = pp.preGenMesh;
+			PoissonDiskSampler pds(*presampledMesh, pdp);
+			std::vector<int> samples;
+			if(par.getBool("ExactNumFlag"))
+				radius = pds.pruneByNumber(sampleNum, 0.005, samples);
+			else
+				pds.prune(radius, samples);
+			// as PoissonDiskPruning does, the refined samples are kept
+			if(pp.preGenFlag)
+				for(CMeshO::VertexIterator vi = pp.preGenMesh->vert.begin(); vi != pp.preGenMesh->vert.end(); ++vi)
+					if(!vi->IsD())
+						mps.AddVert(*vi);
+			for(size_t i = 0; i < samples.size(); ++i)
+				mps.AddVert(presampledMesh->vert[samples[i]]);
+			g = pds.gridSize();
+			gridCellNum = pds.gridCellNum();
+		}
 		else
-			tri::SurfaceSampling<CMeshO,BaseSampler>::PoissonDiskPruning(mps, *presampledMesh, radius,pp);
+		{
+			if(par.getBool("ExactNumFlag"))
+				tri::SurfaceSampling<CMeshO,BaseSampler>::PoissonDiskPruningByNumber(mps, *presampledMesh, sampleNum, radius,pp,0.005);
+			else
+				tri::SurfaceSampling<CMeshO,BaseSampler>::PoissonDiskPruning(mps, *presampledMesh, radius,pp);
+			g = pp.pds.gridSize;
+			gridCellNum = pp.pds.gridCellNum;
+		}
 		
 		//tri::SurfaceSampling<CMeshO,BaseSampler>::PoissonDisk(curMM->cm, mps, *presampledMesh, radius,pp);
 		vcg::tri::UpdateBounding<CMeshO>::Box(mm->cm);
-		Point3i &g=pp.pds.gridSize;
-		log("Grid size was %i %i %i (%i allocated on %i)",g[0],g[1],g[2], pp.pds.gridCellNum, g[0]*g[1]*g[2]);
+		log("Grid size was %i %i %i (%i allocated on %.0f)",g[0],g[1],g[2], gridCellNum, double(g[0])*g[1]*g[2]);
 		log("Poisson Disk Sampling created a new mesh of %i points", mm->cm.vn);
 	} break;
 		
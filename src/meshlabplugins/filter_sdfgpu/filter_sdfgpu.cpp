@@ -1,5 +1,6 @@
 #include "filter_sdfgpu.h"
 #include <common/GLExtensionsManager.h>
+#include <common/ml_document/mesh_ray_bvh.h>
 
 #include <vcg/complex/complex.h>
 #include <vcg/complex/algorithms/intersection.h>
@@ -10,6 +11,8 @@
 #include <wrap/qt/checkGLError.h>
 #include <stdio.h>
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 using namespace std;
 using namespace vcg;
 
@@ -170,9 +173,17 @@ bool SdfGpuPlugin::applyFilter(const QAction */*filter*/, MeshDocument &md, std:
     //MESH CLEAN UP
     setupMesh( md, mOnPrimitive );
 
+    //without OpenGL (e.g. meshlabserver on a machine without display) the rays are traced on the CPU
+    if((glContext == NULL) || !glContext->isValid())
+        return applyFilterCPU(*mm, numViews, peel, cb);
+
     //glContext->makeCurrent();
     //GL INIT
-    if(!initGL(*mm)) return false;
+    if(!initGL(*mm))
+    {
+        glContext->doneCurrent();
+        return applyFilterCPU(*mm, numViews, peel, cb);
+    }
 
     //
     if(mOnPrimitive==ON_VERTICES)
@@ -593,7 +604,8 @@ void SdfGpuPlugin::setupMesh(MeshDocument& md, ONPRIMITIVE onPrimitive )
     else if(!vcg::tri::HasPerFaceAttribute(m,"maxQualityDir") && onPrimitive == ON_FACES)
         mMaxQualityDirPerFace = vcg::tri::Allocator<CMeshO>::AddPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
 
-    glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
+    if(glContext != NULL)
+        glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
 
 }
 
@@ -1095,6 +1107,214 @@ void SdfGpuPlugin::TraceRay(int peelingIteration,const Point3f& dir, MeshModel*
     checkGLError::debugInfo("Error during depth peeling");
 }
 
+bool SdfGpuPlugin::applyFilterCPU(MeshModel& mm, unsigned int numViews, int peelingIteration, vcg::CallBackPos *cb)
+{
+    CMeshO& m = mm.cm;
+    peelingIteration = std::max(peelingIteration, 1);
+
+    log(GLLogStream::SYSTEM, "No valid OpenGL context, rays are traced on the CPU");
+
+    //Uniform sampling of directions over a sphere
+    std::vector<Point3f> unifDirVec;
+    GenNormal<float>::Fibonacci(numViews,unifDirVec);
+    for(size_t i = 0; i < unifDirVec.size(); ++i)
+        unifDirVec[i].Normalize();
+
+    log(GLLogStream::SYSTEM, "Number of rays: %i ", int(unifDirVec.size()) );
+
+    MeshRayBVH bvh(m);
+
+    //same depth range of the views used by setCamera
+    mScale = 2*0.1f + m.bbox.Diag();
+
+    if(mAction != SDF_DEPTH_COMPLEXITY)
+    {
+        traceRaysCPU(m, bvh, unifDirVec, cb);
+        return true;
+    }
+
+    vector<int> depthDistrib(peelingIteration,0);
+    mDepthComplexityWarning = false;
+    for(size_t i = 0; i < unifDirVec.size(); ++i)
+    {
+        if(cb) cb(100*((float)i/(float)unifDirVec.size()), "Tracing rays...");
+        unsigned int complexity = depthComplexityCPU(bvh, unifDirVec[i], m.bbox, peelingIteration);
+        mDepthComplexity = std::max(mDepthComplexity, complexity);
+        depthDistrib[complexity]++;
+    }
+
+    if(mDepthComplexityWarning)
+        log(GLLogStream::SYSTEM,"WARNING: You may have underestimated the depth complexity of the mesh. Run the filter with a higher number of peeling iteration.");
+
+    log(GLLogStream::SYSTEM, "Mesh depth complexity %i (The accuracy of the result depends on the value you provided for the max number of peeling iterations, \n if you get warnings try increasing"
+        " the peeling iteration parameter)\n", mDepthComplexity );
+
+    log(GLLogStream::SYSTEM, "Depth complexity             NumberOfViews\n", mDepthComplexity );
+    for(int j = 0; j < peelingIteration; j++)
+    {
+        log(GLLogStream::SYSTEM, "   %i                             %i\n", j, depthDistrib[j] );
+    }
+
+    mDepthComplexity = 0;
+    return true;
+}
+
+void SdfGpuPlugin::traceRaysCPU(CMeshO& m, const MeshRayBVH& bvh, const std::vector<Point3f>& dirs, vcg::CallBackPos *cb)
+{
+    const bool    onVertices = (mOnPrimitive == ON_VERTICES);
+    const int     numElems   = onVertices ? m.vn : m.fn;
+    const Scalarm bbDiag     = m.bbox.Diag();
+    //rays start a bit away from the surface they leave from
+    const Scalarm eps        = mScale * std::max(mTolerance, 1e-5f);
+
+    CMeshO::PerVertexAttributeHandle<Point3f> dirPerVertex;
+    CMeshO::PerFaceAttributeHandle<Point3f>   dirPerFace;
+    if(onVertices)
+        dirPerVertex = tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3f>(m,std::string("maxQualityDir"));
+    else
+        dirPerFace   = tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
+
+    //the elements are processed in blocks only to report the progress
+    const int blockSize = std::max(1, numElems/100);
+    for(int block = 0; block < numElems; block += blockSize)
+    {
+        if(cb) cb(100*((float)block/(float)numElems), "Tracing rays...");
+        const int last = std::min(numElems, block + blockSize);
+
+#pragma omp parallel for schedule(dynamic, 16)
+        for(int i = block; i < last; ++i)
+        {
+            Point3m p, n;
+            int ignoredFace = -1;
+            if(onVertices)
+            {
+                p = m.vert[i].cP();
+                n = m.vert[i].cN();
+            }
+            else
+            {
+                p = Barycenter(m.face[i]);
+                n = TriangleNormal(m.face[i]);
+                ignoredFace = i;
+            }
+            n.Normalize();
+
+            Scalarm sum = 0, weight = 0;
+            Point3m dirSum(0,0,0);
+            for(size_t j = 0; j < dirs.size(); ++j)
+            {
+                const Point3m dir      = Point3m::Construct(dirs[j]);
+                const Scalarm cosAngle = n * dir;
+                MeshRayBVH::Hit hit;
+                if(mAction == SDF_SDF)
+                {
+                    //rays are traced inside the cone around the inward normal, toward the other side of the mesh
+                    if(cosAngle <= 0 || cosAngle < mMinCos)
+                        continue;
+                    if(!bvh.closestHit(p, -dir, eps, mScale, hit, ignoredFace))
+                        continue;
+                    if(mRemoveFalse && (TriangleNormal(m.face[hit.face]) * n > 0))
+                        continue;
+                    const Scalarm sdf = hit.t * cosAngle;
+                    sum    += sdf;
+                    weight += cosAngle;
+                    dirSum += dir * sdf;
+                }
+                else
+                {
+                    //only the rays leaving the front side, attenuated by the distance of the occluder (if any)
+                    if(cosAngle <= 0)
+                        continue;
+                    Scalarm obscurance = cosAngle;
+                    if(bvh.closestHit(p, dir, eps, mScale, hit, ignoredFace))
+                        obscurance = (1.0 - std::exp(-mTau * (hit.t/mScale) * bbDiag)) * cosAngle;
+                    sum    += obscurance;
+                    dirSum += dir * obscurance;
+                }
+            }
+
+            Scalarm q;
+            if(mAction == SDF_SDF)
+                q = (weight > 0) ? (sum / weight) : 0;
+            else
+                q = sum / Scalarm(dirs.size());
+            dirSum.Normalize();
+
+            if(onVertices)
+            {
+                m.vert[i].Q()   = q;
+                dirPerVertex[i] = Point3f::Construct(dirSum);
+            }
+            else
+            {
+                m.face[i].Q()   = q;
+                dirPerFace[i]   = Point3f::Construct(dirSum);
+            }
+        }
+    }
+
+    if(mAction == SDF_OBSCURANCE)
+    {
+        if(onVertices)
+            tri::UpdateColor<CMeshO>::PerVertexQualityGray(m,0.0f,0.0f);
+        else
+            tri::UpdateColor<CMeshO>::PerFaceQualityGray(m);
+    }
+}
+
+unsigned int SdfGpuPlugin::depthComplexityCPU(const MeshRayBVH& bvh, const Point3f& dir, const Box3m& bbox, int peelingIteration)
+{
+    //one ray per pixel of the depth texture, on the same orthographic view of setCamera
+    const Scalarm d       = bbox.Diag()/2.0;
+    const Point3m viewDir = Point3m::Construct(dir);
+    const Point3m eye     = bbox.Center() + viewDir*(d + 0.1);
+    Point3m up = (std::abs(viewDir.Y()) < 0.9) ? Point3m(0,1,0) : Point3m(1,0,0);
+    Point3m u  = (up ^ viewDir).Normalize();
+    Point3m v  = viewDir ^ u;
+
+    const int     res      = int(mPeelingTextureSize);
+    const Scalarm layerTol = mScale * std::max(mTolerance, 1e-6f);
+
+    //layerPixels[l] is the number of pixels covered by more than l layers
+    std::vector<int> layerPixels(peelingIteration,0);
+#pragma omp parallel
+    {
+        std::vector<int>     localPixels(peelingIteration,0);
+        std::vector<Scalarm> ts;
+#pragma omp for schedule(dynamic, 1)
+        for(int y = 0; y < res; ++y)
+        {
+            for(int x = 0; x < res; ++x)
+            {
+                const Point3m o = eye + u*(((x + 0.5)/res*2.0 - 1.0)*d) + v*(((y + 0.5)/res*2.0 - 1.0)*d);
+                bvh.allHits(o, -viewDir, 0, mScale, ts);
+                std::sort(ts.begin(), ts.end());
+                int layers = 0;
+                for(size_t h = 0; h < ts.size(); ++h)
+                    if(h == 0 || ts[h] - ts[h-1] > layerTol)
+                        ++layers;
+                for(int l = 0; l < std::min(layers, peelingIteration); ++l)
+                    ++localPixels[l];
+            }
+        }
+#pragma omp critical
+        for(int l = 0; l < peelingIteration; ++l)
+            layerPixels[l] += localPixels[l];
+    }
+
+    //as with the occlusion queries, a layer counts when it covers more than PIXEL_COUNT_THRESHOLD pixels
+    unsigned int complexity = 0;
+    for(int l = 1; l < peelingIteration; ++l)
+    {
+        if(layerPixels[l] <= PIXEL_COUNT_THRESHOLD)
+            break;
+        ++complexity;
+        if(l == peelingIteration - 1)
+            mDepthComplexityWarning = true;
+    }
+    return complexity;
+}
+
 FilterPluginInterface::FILTER_ARITY SdfGpuPlugin::filterArity(const QAction *) const
 {
     return FilterPluginInterface::SINGLE_MESH;
@@ -9,6 +9,8 @@
 #include <framebufferObject.h>
 #include <texture2D.h>
 
+class MeshRayBVH;
+
 enum ONPRIMITIVE{ON_VERTICES=0, ON_FACES=1};
 
 class SdfGpuPlugin : public QObject, public FilterPluginInterface
@@ -91,6 +93,15 @@ public:
 
     bool postRender(unsigned int peelingIteration);
 
+    //CPU ray casting, used when there is no valid OpenGL context
+    bool applyFilterCPU(MeshModel& mm, unsigned int numViews, int peelingIteration, vcg::CallBackPos *cb);
+
+    //Sdf or obscurance of each element, tracing the rays on the BVH of the mesh
+    void traceRaysCPU(CMeshO& m, const MeshRayBVH& bvh, const std::vector<vcg::Point3f>& dirs, vcg::CallBackPos *cb);
+
+    //Number of layers seen along a direction, counted as the depth peeling does
+    unsigned int depthComplexityCPU(const MeshRayBVH& bvh, const vcg::Point3f& dir, const Box3m& bbox, int peelingIteration);
+
   protected:
 
     FilterIDType       mAction;
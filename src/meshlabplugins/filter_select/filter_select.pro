@@ -2,10 +2,12 @@ include (../../shared.pri)
 
 HEADERS += \
     $$VCGDIR/vcg/complex/algorithms/clean.h\
-    meshselect.h
+    meshselect.h \
+    self_intersection.h
 
 SOURCES += \
-    meshselect.cpp
+    meshselect.cpp \
+    self_intersection.cpp
 
 RESOURCES += \
     meshlab.qrc
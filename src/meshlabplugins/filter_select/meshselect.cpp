@@ -27,7 +27,8 @@
 #include "meshselect.h"
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/stat.h>
-#include <vcg/complex/algorithms/point_outlier.h>
+#include "self_intersection.h"
+#include <common/ml_document/knn_graph.h>
 
 #include <QCoreApplication>
 
@@ -37,6 +38,64 @@ using namespace vcg;
 #define CheckError(x,y); if ((x)) {this->errorMessage = (y); return false;}
 ///////////////////////////////////////////////////////
 
+// Local Outlier Probabilities (Kriegel et al. 2009), same scoring of tri::OutlierRemoval
+// but the neighbourhoods come from the cached kNN graph and each step runs in parallel.
+// As in the kd-tree query used by vcg, the kNearest neighbourhood includes the vertex itself.
+static int SelectLoOPOutliers(CMeshO &m, int kNearest, float threshold, vcg::CallBackPos *cb)
+{
+	const KnnGraph &graph = KnnGraph::get(m, kNearest - 1, cb);
+	const int vn = int(m.vert.size());
+	CMeshO::PerVertexAttributeHandle<Scalarm> outlierScore = tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m, std::string("outlierScore"));
+	std::vector<Scalarm> sigma(vn, 0), plof(vn, 0);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < vn; ++i)
+	{
+		if (m.vert[i].IsD()) continue;
+		const int *nb = graph.neighbours(i);
+		const int nn = graph.neighbourNum(i, kNearest - 1);
+		Scalarm sum = 0;
+		for (int j = 0; j < nn; ++j)
+			sum += SquaredDistance(m.vert[i].cP(), m.vert[nb[j]].cP());
+		sigma[i] = sqrt(sum / (nn + 1));
+	}
+
+	double mean = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+: mean)
+	for (int i = 0; i < vn; ++i)
+	{
+		if (m.vert[i].IsD()) continue;
+		const int *nb = graph.neighbours(i);
+		const int nn = graph.neighbourNum(i, kNearest - 1);
+		Scalarm sum = sigma[i];
+		for (int j = 0; j < nn; ++j)
+			sum += sigma[nb[j]];
+		plof[i] = (sum > 0) ? sigma[i] / (sum / (nn + 1)) - 1 : 0;
+		mean += plof[i] * plof[i];
+	}
+	mean = sqrt(mean / std::max(m.vn, 1));
+
+	int count = 0;
+#pragma omp parallel for schedule(static) reduction(+: count)
+	for (int i = 0; i < vn; ++i)
+	{
+		if (m.vert[i].IsD()) continue;
+		//complementary error function approximation
+		double value = (mean > 0) ? plof[i] / (mean * sqrt(2.0)) : 0;
+		double dem = 1.0 + 0.278393 * value;
+		dem += 0.230389 * value * value;
+		dem += 0.000972 * value * value * value;
+		dem += 0.078108 * value * value * value * value;
+		outlierScore[i] = std::max(0.0, 1.0 - 1.0 / dem);
+		if (outlierScore[i] > threshold)
+		{
+			m.vert[i].SetS();
+			++count;
+		}
+	}
+	return count;
+}
+
 SelectionFilterPlugin::SelectionFilterPlugin()
 {
 
@@ -173,7 +232,7 @@ QString SelectionFilterPlugin::filterInfo(FilterIDType filterId) const
 	case FP_SELECT_DELETE_FACEVERT :    return tr("Delete the current set of selected faces and all the vertices surrounded by that faces.");
 	case FP_SELECTBYANGLE :             return tr("Select faces according to the angle between their normal and the view direction. It is used in range map processing to select and delete steep faces parallel to viewdirection.");
 	case FP_SELECT_UGLY :               return tr("Select faces with 'problems', like normal inverted w.r.t the surrounding areas, or extremely elongated");
-	case CP_SELFINTERSECT_SELECT :      return tr("Select only self intersecting faces.");
+	case CP_SELFINTERSECT_SELECT :      return tr("Select only self intersecting faces. The candidate face pairs are found with a bounding volume hierarchy traversed in parallel. In count only mode the selection is left untouched and the number of self intersecting faces is just reported.");
 	case FP_SELECT_FACE_FROM_VERT :     return tr("Select faces from selected vertices.");
 	case FP_SELECT_VERT_FROM_FACE :     return tr("Select vertices from selected faces.");
 	case FP_SELECT_FACES_BY_EDGE :      return tr("Select all triangles having an edge with length greater or equal than a given threshold.");
@@ -296,6 +355,11 @@ void SelectionFilterPlugin::initParameterList(const QAction *action, MeshModel &
 		parlst.addParam(RichInt("KNearest", 32, tr("Number of neighbors"), tr("Number of neighbours used to compute the LoOP")));
 	} break;
 
+	case CP_SELFINTERSECT_SELECT:
+	{
+		parlst.addParam(RichBool("countOnly", false, "Count only", "If true the self intersecting faces are only counted and the current selection is not modified. The number of faces is written in the log and returned as filter output (useful to quickly validate meshes in scripts)."));
+	} break;
+
 	case FP_SELECT_DELETE_ALL_FACE:
 	{
 		parlst.addParam(RichBool("allLayers", false, "Apply to all visible Layers", "If selected, the filter will be applied to all visible mesh Layers."));
@@ -303,7 +367,7 @@ void SelectionFilterPlugin::initParameterList(const QAction *action, MeshModel &
  }
 }
 
-bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md, std::map<std::string, QVariant>&, unsigned int& /*postConditionMask*/, const RichParameterList & par, vcg::CallBackPos * /*cb*/)
+bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md, std::map<std::string, QVariant>& outputValues, unsigned int& /*postConditionMask*/, const RichParameterList & par, vcg::CallBackPos * cb)
 {
 	if (md.mm() == NULL)
 		return false;
@@ -397,6 +461,7 @@ bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md,
 
 	case FP_SELECT_CONNECTED:
 		tri::UpdateSelection<CMeshO>::FaceConnectedFF(m.cm);
+		m.markSelectedFaceDirty();
 		break;
 
 	case FP_SELECTBYANGLE :
@@ -477,9 +542,15 @@ bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md,
 
 	case FP_SELECT_NONE   :
 		if (par.getBool("allVerts"))
+		{
+			m.markSelectedVertDirty();
 			tri::UpdateSelection<CMeshO>::VertexClear(m.cm);
+		}
 		if (par.getBool("allFaces"))
+		{
+			m.markSelectedFaceDirty();
 			tri::UpdateSelection<CMeshO>::FaceClear(m.cm);
+		}
 		break;
 
 	case FP_SELECT_INVERT :
@@ -503,14 +574,22 @@ bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md,
 			tri::UpdateSelection<CMeshO>::FaceFromVertexLoose(m.cm);
 		break;
 
+	// erosion and dilation change only the elements around the current selection:
+	// the elements selected before and after the operation cover all of them
 	case FP_SELECT_ERODE:
+		m.markSelectedVertDirty();
+		m.markSelectedFaceDirty();
 		tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
 		tri::UpdateSelection<CMeshO>::FaceFromVertexStrict(m.cm);
+		m.markSelectedVertDirty();
 		break;
 
 	case FP_SELECT_DILATE:
+		m.markSelectedVertDirty();
 		tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(m.cm);
 		tri::UpdateSelection<CMeshO>::FaceFromVertexLoose(m.cm);
+		m.markSelectedVertDirty();
+		m.markSelectedFaceDirty();
 		break;
 
 	case FP_SELECT_BORDER:
@@ -614,11 +693,17 @@ bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md,
 	case CP_SELFINTERSECT_SELECT:
 	{
 		std::vector<CFaceO *> IntersFace;
-		tri::Clean<CMeshO>::SelfIntersections(m.cm, IntersFace);
-		tri::UpdateSelection<CMeshO>::FaceClear(m.cm);
-		std::vector<CFaceO *>::iterator fpi;
-		for (fpi = IntersFace.begin(); fpi != IntersFace.end(); ++fpi)
-			(*fpi)->SetS();
+		SelfIntersectionBVH bvh(m.cm, cb);
+		bvh.intersectingFaces(IntersFace);
+		if (!par.getBool("countOnly"))
+		{
+			tri::UpdateSelection<CMeshO>::FaceClear(m.cm);
+			std::vector<CFaceO *>::iterator fpi;
+			for (fpi = IntersFace.begin(); fpi != IntersFace.end(); ++fpi)
+				(*fpi)->SetS();
+		}
+		log("Found %i self intersecting faces", int(IntersFace.size()));
+		outputValues["self_intersecting_faces"] = QVariant(int(IntersFace.size()));
 	} break;
 
 	case FP_SELECT_FACES_BY_EDGE:
@@ -639,10 +724,8 @@ bool SelectionFilterPlugin::applyFilter(const QAction *action, MeshDocument &md,
 	case FP_SELECT_OUTLIER:
 	{
 		float threshold = par.getDynamicFloat("PropThreshold");
-		int kNearest = par.getInt("KNearest");
-		VertexConstDataWrapper<CMeshO> wrapper(m.cm);
-		KdTree<typename CMeshO::ScalarType> kdTree(wrapper);
-		int selVertexNum = tri::OutlierRemoval<CMeshO>::SelectLoOPOutliers(m.cm, kdTree, kNearest, threshold);
+		int kNearest = std::max(par.getInt("KNearest"), 2);
+		int selVertexNum = SelectLoOPOutliers(m.cm, kNearest, threshold, cb);
 		log("Selected %d outlier vertices", selVertexNum);
 	} break;
 
@@ -697,8 +780,6 @@ FilterPluginInterface::FilterClass SelectionFilterPlugin::getClass(const QAction
     case FP_SELECT_CONNECTED: return MeshModel::MM_FACEFACETOPO;
   
 	case CP_SELECT_TEXBORDER: return MeshModel::MM_FACEFACETOPO;
-	case CP_SELFINTERSECT_SELECT: return MeshModel::MM_FACEMARK | MeshModel::MM_FACEFACETOPO;
-
 	case FP_SELECT_FOLD_FACE: return MeshModel::MM_VERTFACETOPO;
 
 	default: return MeshModel::MM_NONE;
@@ -0,0 +1,334 @@
+/****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005                                                \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "self_intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <vcg/complex/algorithms/clean.h>
+
+using namespace vcg;
+
+namespace {
+
+//spreads the lower 10 bits of v so that there are two zero bits between each of them
+inline uint32_t expandBits(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+inline uint32_t mortonCode(const Point3m& p, const Box3m& box)
+{
+	Point3m dim = box.Dim();
+	uint32_t code[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		Scalarm t = (dim[k] > 0) ? (p[k] - box.min[k]) / dim[k] : Scalarm(0);
+		code[k] = uint32_t(std::min(std::max(t * Scalarm(1024), Scalarm(0)), Scalarm(1023)));
+	}
+	return (expandBits(code[0]) << 2) | (expandBits(code[1]) << 1) | expandBits(code[2]);
+}
+
+//sorts independent chunks in parallel and then merges them pairwise
+void parallelSort(std::vector<uint64_t>& v)
+{
+	int chunks = 1;
+#ifdef _OPENMP
+	chunks = omp_get_max_threads();
+#endif
+	if (chunks < 2 || v.size() < 65536)
+	{
+		std::sort(v.begin(), v.end());
+		return;
+	}
+	std::vector<size_t> bound(chunks + 1);
+	for (int c = 0; c <= chunks; ++c)
+		bound[c] = (v.size() * c) / chunks;
+
+#pragma omp parallel for schedule(static, 1)
+	for (int c = 0; c < chunks; ++c)
+		std::sort(v.begin() + bound[c], v.begin() + bound[c + 1]);
+
+	for (int width = 1; width < chunks; width *= 2)
+	{
+#pragma omp parallel for schedule(static, 1)
+		for (int c = 0; c < chunks; c += 2 * width)
+		{
+			if (c + width < chunks)
+				std::inplace_merge(v.begin() + bound[c], v.begin() + bound[c + width], v.begin() + bound[std::min(c + 2 * width, chunks)]);
+		}
+	}
+}
+
+}
+
+SelfIntersectionBVH::SelfIntersectionBVH(CMeshO& m, CallBackPos* callback)
+	: mesh(m), cb(callback), leafnum(1)
+{
+	build();
+}
+
+void SelfIntersectionBVH::build()
+{
+	faces.clear();
+	faces.reserve(mesh.fn);
+	for (CMeshO::FaceIterator fi = mesh.face.begin(); fi != mesh.face.end(); ++fi)
+		if (!fi->IsD())
+			faces.push_back(&*fi);
+
+	const int fn = int(faces.size());
+	if (fn == 0)
+		return;
+
+	Box3m centerBox;
+	for (int i = 0; i < fn; ++i)
+		centerBox.Add(Barycenter(*faces[i]));
+
+	//64 bit keys: morton code in the upper half, index of the face in the lower one
+	std::vector<uint64_t> keys(fn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i)
+		keys[i] = (uint64_t(mortonCode(Barycenter(*faces[i]), centerBox)) << 32) | uint64_t(i);
+	parallelSort(keys);
+
+	std::vector<CFaceO*> sorted(fn);
+	faceBox.resize(fn);
+	faceNormal.resize(fn);
+	faceOffset.resize(fn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i)
+	{
+		CFaceO* f = faces[size_t(keys[i] & 0xFFFFFFFFu)];
+		sorted[i] = f;
+		f->GetBBox(faceBox[i]);
+		faceNormal[i] = TriangleNormal(*f);
+		faceOffset[i] = faceNormal[i] * f->cP(0);
+	}
+	faces.swap(sorted);
+
+	if (cb)
+		cb(30, "Building the bounding volume hierarchy");
+
+	leafnum = 1;
+	while (leafnum * LEAF_SIZE < faces.size())
+		leafnum *= 2;
+	nodeBox.assign(2 * leafnum - 1, Box3m());
+	refit();
+}
+
+void SelfIntersectionBVH::refit()
+{
+	const int ln = int(leafnum);
+#pragma omp parallel for schedule(static)
+	for (int k = 0; k < ln; ++k)
+	{
+		size_t first, last;
+		leafRange(leafnum - 1 + k, first, last);
+		Box3m& b = nodeBox[leafnum - 1 + k];
+		for (size_t i = first; i < last; ++i)
+			b.Add(faceBox[i]);
+	}
+
+	//the nodes of each level are [levelsize - 1, 2 * levelsize - 1)
+	for (size_t levelsize = leafnum / 2; levelsize > 0; levelsize /= 2)
+	{
+		const int first = int(levelsize - 1);
+		const int last = int(2 * levelsize - 1);
+#pragma omp parallel for schedule(static)
+		for (int n = first; n < last; ++n)
+		{
+			nodeBox[n] = nodeBox[2 * n + 1];
+			nodeBox[n].Add(nodeBox[2 * n + 2]);
+		}
+	}
+}
+
+void SelfIntersectionBVH::leafRange(size_t node, size_t& first, size_t& last) const
+{
+	size_t k = node - (leafnum - 1);
+	first = std::min(k * LEAF_SIZE, faces.size());
+	last = std::min(first + LEAF_SIZE, faces.size());
+}
+
+//unlike Box3::Collide touching boxes overlap: flat faces have flat boxes
+bool SelfIntersectionBVH::overlap(const Box3m& b0, const Box3m& b1)
+{
+	return b0.min.X() <= b1.max.X() && b1.min.X() <= b0.max.X() &&
+		b0.min.Y() <= b1.max.Y() && b1.min.Y() <= b0.max.Y() &&
+		b0.min.Z() <= b1.max.Z() && b1.min.Z() <= b0.max.Z();
+}
+
+size_t SelfIntersectionBVH::intersectingFaces(std::vector<CFaceO*>& ret)
+{
+	ret.clear();
+	if (faces.empty())
+		return 0;
+
+	//the tree is complete, so both the nodes of a pair are always at the same level
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	const size_t target = size_t(threads) * 64;
+	std::vector<NodePair> work(1, NodePair(0, 0));
+	std::vector<NodePair> next;
+	while (work.size() < target && !isLeaf(work.front().a))
+	{
+		next.clear();
+		for (const NodePair& p : work)
+		{
+			const size_t la = 2 * p.a + 1, ra = 2 * p.a + 2;
+			if (p.a == p.b)
+			{
+				next.push_back(NodePair(la, la));
+				next.push_back(NodePair(ra, ra));
+				if (overlap(nodeBox[la], nodeBox[ra]))
+					next.push_back(NodePair(la, ra));
+			}
+			else
+			{
+				const size_t lb = 2 * p.b + 1, rb = 2 * p.b + 2;
+				const size_t childa[2] = { la, ra };
+				const size_t childb[2] = { lb, rb };
+				for (int i = 0; i < 2; ++i)
+					for (int j = 0; j < 2; ++j)
+						if (overlap(nodeBox[childa[i]], nodeBox[childb[j]]))
+							next.push_back(NodePair(childa[i], childb[j]));
+			}
+		}
+		work.swap(next);
+	}
+
+	if (cb)
+		cb(50, "Testing face pairs");
+
+	//each thread collects the indexes of the intersecting faces it found
+	std::vector<std::vector<size_t> > hits(threads);
+	const int worknum = int(work.size());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int w = 0; w < worknum; ++w)
+	{
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		traverse(work[w].a, work[w].b, hits[t]);
+	}
+
+	std::vector<char> intersected(faces.size(), 0);
+	for (const std::vector<size_t>& h : hits)
+		for (size_t i : h)
+			intersected[i] = 1;
+
+	for (size_t i = 0; i < faces.size(); ++i)
+		if (intersected[i])
+			ret.push_back(faces[i]);
+	//the faces are returned in the order of the face container
+	std::sort(ret.begin(), ret.end());
+	return ret.size();
+}
+
+void SelfIntersectionBVH::traverse(size_t a, size_t b, std::vector<size_t>& hits) const
+{
+	if (a != b && !overlap(nodeBox[a], nodeBox[b]))
+		return;
+	if (isLeaf(a))
+	{
+		testLeaves(a, b, hits);
+		return;
+	}
+	const size_t la = 2 * a + 1, ra = 2 * a + 2;
+	if (a == b)
+	{
+		traverse(la, la, hits);
+		traverse(ra, ra, hits);
+		traverse(la, ra, hits);
+	}
+	else
+	{
+		const size_t lb = 2 * b + 1, rb = 2 * b + 2;
+		traverse(la, lb, hits);
+		traverse(la, rb, hits);
+		traverse(ra, lb, hits);
+		traverse(ra, rb, hits);
+	}
+}
+
+void SelfIntersectionBVH::testLeaves(size_t a, size_t b, std::vector<size_t>& hits) const
+{
+	size_t fa, la, fb, lb;
+	leafRange(a, fa, la);
+	leafRange(b, fb, lb);
+	for (size_t i = fa; i < la; ++i)
+	{
+		//inside the same leaf each pair is tested once
+		for (size_t j = (a == b) ? i + 1 : fb; j < lb; ++j)
+		{
+			if (overlap(faceBox[i], faceBox[j]) && testPair(i, j))
+			{
+				hits.push_back(i);
+				hits.push_back(j);
+			}
+		}
+	}
+}
+
+//true if all the vertices of face j lie on the same side of the plane of face i.
+//Distances near zero are not trusted: the exact test snaps them to the plane
+//and the pre-check must never reject a pair that the exact test would accept.
+bool SelfIntersectionBVH::separatedByPlane(size_t i, size_t j) const
+{
+	const CFaceO* f = faces[j];
+	int above = 0, below = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		const Scalarm proj = faceNormal[i] * f->cP(k);
+		const Scalarm d = proj - faceOffset[i];
+		const Scalarm tol = Scalarm(1e-6) + Scalarm(1e-5) * (std::abs(proj) + std::abs(faceOffset[i]));
+		if (d > tol)
+			++above;
+		else if (d < -tol)
+			++below;
+	}
+	return above == 3 || below == 3;
+}
+
+bool SelfIntersectionBVH::testPair(size_t i, size_t j) const
+{
+	CFaceO* f0 = faces[i];
+	CFaceO* f1 = faces[j];
+	//the plane test is meaningful only for faces without shared vertices,
+	//the other cases are completely handled by the topological checks of vcg
+	if (face::CountSharedVertex(f0, f1) == 0 && (separatedByPlane(i, j) || separatedByPlane(j, i)))
+		return false;
+	return tri::Clean<CMeshO>::TestFaceFaceIntersection(f0, f1);
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005                                                \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_SELECT_SELF_INTERSECTION_H
+#define FILTER_SELECT_SELF_INTERSECTION_H
+
+#include <vector>
+#include <common/ml_document/cmesh.h>
+
+/*
+SelfIntersectionBVH
+Finds the self intersecting faces of a mesh; it gives the same result of
+vcg::tri::Clean::SelfIntersections but it scales on large meshes.
+
+The faces are sorted along a Morton curve and grouped in leaves of a complete
+binary tree of bounding boxes (so the tree is implicit and each level is refitted in parallel).
+The traversal of the tree against itself is expanded breadth-first into a list of
+overlapping node pairs that are then consumed by the threads with a dynamic schedule.
+Candidate face pairs are rejected with a cheap box and plane-side test before the exact
+triangle-triangle test of vcg.
+*/
+class SelfIntersectionBVH
+{
+public:
+	SelfIntersectionBVH(CMeshO& m, vcg::CallBackPos* cb = nullptr);
+
+	// fills ret with the faces intersecting at least another face and returns their number
+	size_t intersectingFaces(std::vector<CFaceO*>& ret);
+
+private:
+	static const size_t LEAF_SIZE = 8;
+
+	struct NodePair
+	{
+		size_t a;
+		size_t b;    // a == b means the subtree of a tested against itself
+		NodePair(size_t na, size_t nb) : a(na), b(nb) {}
+	};
+
+	void build();
+	void refit();
+
+	bool isLeaf(size_t node) const { return node >= leafnum - 1; }
+	void leafRange(size_t node, size_t& first, size_t& last) const;
+	void traverse(size_t a, size_t b, std::vector<size_t>& hits) const;
+	void testLeaves(size_t a, size_t b, std::vector<size_t>& hits) const;
+	bool testPair(size_t i, size_t j) const;
+	bool separatedByPlane(size_t i, size_t j) const;
+
+	static bool overlap(const Box3m& b0, const Box3m& b1);
+
+	CMeshO& mesh;
+	vcg::CallBackPos* cb;
+
+	std::vector<CFaceO*> faces;     // alive faces in Morton order
+	std::vector<Box3m> faceBox;
+	std::vector<Point3m> faceNormal; // not normalized, zero for degenerate faces
+	std::vector<Scalarm> faceOffset;
+
+	size_t leafnum;                 // power of two, the leaves are the last leafnum nodes
+	std::vector<Box3m> nodeBox;
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "filter_texture.h"
 #include "pushpull.h"
 #include "rastering.h"
+#include "texel_raster.h"
 #include <vcg/complex/algorithms/update/texture.h>
 #include<wrap/io_trimesh/export_ply.h>
 #include <vcg/complex/algorithms/parametrization/voronoi_atlas.h>
@@ -329,6 +330,35 @@ inline void buildTrianglesCache(std::vector<Tri2> &arr, int maxLevels, float bor
 	buildTrianglesCache (arr, maxLevels, border, quadSize, 2*idx+3);
 }
 	
+// The alpha of the texels sampled out of the faces (on the texture space borders) back to 255;
+// with the pull push the empty texels stay transparent, to be filled.
+static void revertBorderAlpha(QImage &img, bool pullPush)
+{
+	uchar *bits = img.bits();
+	const int bpl = img.bytesPerLine();
+	const int w = img.width();
+	const int h = img.height();
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; ++y)
+	{
+		QRgb *row = reinterpret_cast<QRgb *>(bits + size_t(y) * bpl);
+		for (int x = 0; x < w; ++x)
+			if (qAlpha(row[x]) < 255 && (!pullPush || qAlpha(row[x]) > 0))
+				row[x] |= 0xff000000;
+	}
+}
+
+// Saves the textures at the same time (the encoding of large images is slow); false for
+// the ones that cannot be saved.
+static std::vector<char> saveTextures(const std::vector<QImage> &imgs, const std::vector<QString> &fileNames)
+{
+	std::vector<char> saved(imgs.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(imgs.size()); ++i)
+		saved[i] = imgs[i].save(fileNames[i]);
+	return saved;
+}
+
 // ERROR CHECKING UTILITY
 #define CheckError(x,y); if ((x)) {this->errorMessage = (y); return false;}
 ///////////////////////////////////////////////////////
@@ -783,8 +813,7 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 		
 		// Rasterizing triangles
 		RasterSampler rs(trgImgs);
-		rs.InitCallback(cb, m.cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO,RasterSampler>::Texture(m.cm,rs,textW,textH,true);
+		TexelRaster<RasterSampler>::Texture(m.cm, rs, texNum, textW, textH, true, cb, 0, 80);
 		
 		// Undo topology changes
 		tri::UpdateTopology<CMeshO>::FaceFace(m.cm);
@@ -794,13 +823,7 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 		{
 			// Revert alpha values for border edge pixels to 255
 			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y<textH; ++y)
-				for (int x = 0; x<textW; ++x)
-				{
-					QRgb px = trgImgs[texInd].pixel(x, y);
-					if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-						trgImgs[texInd].setPixel(x, y, px | 0xff000000);
-				}
+			revertBorderAlpha(trgImgs[texInd], pp);
 			
 			// PullPush
 			if (pp)
@@ -808,10 +831,14 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 				cb(85, "Filling texture holes...");
 				PullPush(trgImgs[texInd], qRgba(0, 0, 0, 0));
 			}
-			
-			// Save texture
-			cb(90, "Saving texture ...");
-			CheckError(!trgImgs[texInd].save(texFileNames[texInd]), "Texture file cannot be saved");
+		}
+		
+		// Save textures
+		cb(90, "Saving texture ...");
+		std::vector<char> saved = saveTextures(trgImgs, texFileNames);
+		for (texInd = 0; texInd < texNum; texInd++)
+		{
+			CheckError(!saved[texInd], "Texture file cannot be saved");
 			log("Texture \"%s\" Created", texFileNames[texInd].toStdString().c_str());
 			assert(QFile(texFileNames[texInd]).exists());
 		}
@@ -976,19 +1003,16 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 		}
 		
 		// Rasterizing faces
-		srcMesh->updateDataMask(MeshModel::MM_FACEMARK);
 		tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
 		if (vertexSampling)
 		{
 			TransferColorSampler sampler(srcMesh->cm, trgImgs, upperbound, vertexMode); // color sampling
-			sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-			tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
+			TexelRaster<TransferColorSampler>::Texture(trgMesh->cm, sampler, numTrgTex, textW, textH, false, cb, 0, 80);
 		} 
 		else 
 		{ 
 			TransferColorSampler sampler(srcMesh->cm, trgImgs, &srcImgs, upperbound); // texture sampling
-			sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-			tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
+			TexelRaster<TransferColorSampler>::Texture(trgMesh->cm, sampler, numTrgTex, textW, textH, false, cb, 0, 80);
 		}
 		
 		// the meshes have to return to their original position
@@ -1009,13 +1033,7 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 		{
 			// Revert alpha values for border edge pixels to 255
 			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y<textH; ++y)
-				for (int x = 0; x<textW; ++x)
-				{
-					QRgb px = trgImgs[trgTexInd].pixel(x, y);
-					if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-						trgImgs[trgTexInd].setPixel(x, y, px | 0xff000000);
-				}
+			revertBorderAlpha(trgImgs[trgTexInd], pp);
 			
 			// PullPush
 			if (pp)
@@ -1023,10 +1041,14 @@ bool FilterTexturePlugin::applyFilter(const QAction *filter, MeshDocument &md, s
 				cb(85, "Filling texture holes...");
 				PullPush(trgImgs[trgTexInd], qRgba(0, 0, 0, 0));
 			}
-			
-			// Save texture
-			cb(90, "Saving texture ...");
-			CheckError(!trgImgs[trgTexInd].save(trgTextureFileNames[trgTexInd]), "Texture file cannot be saved");
+		}
+		
+		// Save textures
+		cb(90, "Saving texture ...");
+		std::vector<char> saved = saveTextures(trgImgs, trgTextureFileNames);
+		for (trgTexInd = 0; trgTexInd < numTrgTex; trgTexInd++)
+		{
+			CheckError(!saved[trgTexInd], "Texture file cannot be saved");
 			log("Texture \"%s\" Created", trgTextureFileNames[trgTexInd].toStdString().c_str());
 			assert(QFile(trgTextureFileNames[trgTexInd]).exists());
 		}
@@ -4,6 +4,7 @@ HEADERS += \
     filter_texture.h \
     pushpull.h \
     rastering.h \
+    texel_raster.h \
     $$VCGDIR/vcg/complex/algorithms/parametrization/voronoi_atlas.h
 
 SOURCES += \
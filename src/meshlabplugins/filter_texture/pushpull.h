@@ -31,14 +31,14 @@ namespace vcg
 {
     /* pull push filling algorithm */
 
-    int mean4w(int p1,byte w1,int p2,byte w2,int p3,byte w3,int p4,byte w4)
+    inline int mean4w(int p1,byte w1,int p2,byte w2,int p3,byte w3,int p4,byte w4)
     {
         int result =(p1*int(w1) + p2*int(w2)  +p3*int(w3) + p4*int(w4) )
         / ( int(w1)+int(w2)+int(w3)+int(w4)  ) ;
         return result;
     }
 
-    QRgb mean4Pixelw(QRgb p1,byte w1,QRgb p2,byte w2,QRgb p3,byte w3,QRgb p4,byte w4)
+    inline QRgb mean4Pixelw(QRgb p1,byte w1,QRgb p2,byte w2,QRgb p3,byte w3,QRgb p4,byte w4)
     {
         int r= mean4w(qRed(p1),w1,qRed(p2),w2,qRed(p3),w3,qRed(p4),w4);
         int g= mean4w(qGreen(p1),w1,qGreen(p2),w2,qGreen(p3),w3,qGreen(p4),w4);
@@ -49,66 +49,91 @@ namespace vcg
 
     }
 
+    /*
+    The pull and push steps read and write the scanlines of ARGB32 (or RGB32) images directly,
+    instead of calling pixel()/setPixel() (that check the bounds and the format, and detach the
+    image, at each call). The rows of the coarser level depend only on two rows of the finer
+    one, and the other way round, so they are processed in parallel.
+    */
+    inline const QRgb *constRow(const QImage & p, int y) { return reinterpret_cast<const QRgb *>(p.constScanLine(y)); }
+
     // Genera una mipmap pesata
-    void PullPushMip( QImage & p, QImage & mip, QRgb  bkcolor )
+    inline void PullPushMip( QImage & p, QImage & mip, QRgb  bkcolor )
     {
         assert(p.width()/2==mip.width());
         assert(p.height()/2==mip.height());
-        byte w1,w2,w3,w4;
-        int x,y;
-        for(y=0;y<mip.height();++y)
-            for(x=0;x<mip.width();++x)
+        const int mw = mip.width();
+        const int mh = mip.height();
+        uchar *bits = mip.bits(); // detaches, out of the parallel loop
+        const int bpl = mip.bytesPerLine();
+#pragma omp parallel for schedule(static)
+        for(int y=0;y<mh;++y)
+        {
+            const QRgb *r0 = constRow(p, y*2);
+            const QRgb *r1 = constRow(p, y*2+1);
+            QRgb *m = reinterpret_cast<QRgb *>(bits + size_t(y)*bpl);
+            for(int x=0;x<mw;++x)
             {
-                if(p.pixel(x*2  ,y*2  )==bkcolor) w1=0; else w1=255;
-                if(p.pixel(x*2+1,y*2  )==bkcolor) w2=0; else w2=255;
-                if(p.pixel(x*2  ,y*2+1)==bkcolor) w3=0; else w3=255;
-                if(p.pixel(x*2+1,y*2+1)==bkcolor) w4=0; else w4=255;
+                const byte w1 = (r0[x*2  ]==bkcolor) ? 0 : 255;
+                const byte w2 = (r0[x*2+1]==bkcolor) ? 0 : 255;
+                const byte w3 = (r1[x*2  ]==bkcolor) ? 0 : 255;
+                const byte w4 = (r1[x*2+1]==bkcolor) ? 0 : 255;
                 if(w1+w2+w3+w4>0        )
-                    mip.setPixel(x, y, mean4Pixelw(
-                                                   p.pixel(x*2  ,y*2  ),w1,
-                                                   p.pixel(x*2+1,y*2  ),w2,
-                                                   p.pixel(x*2  ,y*2+1),w3,
-                                                   p.pixel(x*2+1,y*2+1),w4 ));
+                    m[x] = mean4Pixelw(r0[x*2],w1, r0[x*2+1],w2, r1[x*2],w3, r1[x*2+1],w4);
             }
+        }
     }
 
     // interpola a partire da una mipmap
-    void PullPushFill( QImage & p, QImage & mip, QRgb  bkg )
+    inline void PullPushFill( QImage & p, QImage & mip, QRgb  bkg )
     {
         assert(p.width()/2==mip.width());
         assert(p.height()/2==mip.height());
-        //      byte w1,w2,w3,w4;
-        int x,y;
-        for(y=0;y<mip.height();++y)
-            for(x=0;x<mip.width();++x)
+        const int mw = mip.width();
+        const int mh = mip.height();
+        uchar *bits = p.bits(); // detaches, out of the parallel loop
+        const int bpl = p.bytesPerLine();
+#pragma omp parallel for schedule(static)
+        for(int y=0;y<mh;++y)
+        {
+            const QRgb *mc = constRow(mip, y);
+            const QRgb *mu = (y>0) ? constRow(mip, y-1) : 0;
+            const QRgb *md = (y<mh-1) ? constRow(mip, y+1) : 0;
+            QRgb *r0 = reinterpret_cast<QRgb *>(bits + size_t(y*2)*bpl);
+            QRgb *r1 = reinterpret_cast<QRgb *>(bits + size_t(y*2+1)*bpl);
+            for(int x=0;x<mw;++x)
             {
-                if(p.pixel(x*2 ,y*2)==bkg)
-                    p.setPixel(x*2 ,y*2 ,mean4Pixelw( mip.pixel(x  ,y  ) ,  byte(144),
-                                                     (x>0 ? mip.pixel(x-1,y  ) : bkg),  (x>0 ? byte( 48) : 0),
-                                                     (y>0 ? mip.pixel(x  ,y-1) : bkg),  (y>0 ? byte( 48) : 0),
-                                                     ((x>0 && y>0 )? mip.pixel(x-1,y-1) : bkg), ((x>0 && y>0 )? byte( 16) : 0)));
-                if(p.pixel(x*2+1,y*2  )==bkg)
-                    p.setPixel(x*2+1,y*2  ,mean4Pixelw(mip.pixel(x  ,y  ) ,byte(144),
-                                                       (x<mip.width()-1 ? mip.pixel(x+1,y) : bkg),  (x<mip.width()-1 ? byte( 48) : 0),
-                                                       (y>0  ? mip.pixel(x  ,y-1) : bkg),  (y>0  ? byte( 48) : 0),
-                                                       ((x<mip.width()-1 && y>0) ? mip.pixel(x+1,y-1) : bkg), ((x<mip.width()-1 && y>0) ? byte( 16) : 0)));
-                if(p.pixel(x*2  ,y*2+1)==bkg)
-                    p.setPixel(x*2  ,y*2+1, mean4Pixelw( mip.pixel(x  ,y  ), byte(144),
-                                                        (x>0 ? mip.pixel(x-1,y  ) : bkg),  (x>0 ? byte( 48) : 0),
-                                                        (y<mip.height()-1  ? mip.pixel(x  ,y+1) : bkg),  (y<mip.height()-1  ? byte( 48) : 0),
-                                                        ((x>0 && y<mip.height()-1) ? mip.pixel(x-1,y+1) : bkg), ((x>0 && y<mip.height()-1 )? byte( 16) : 0)));
-                if(p.pixel(x*2+1,y*2+1)==bkg)
-                    p.setPixel(x*2+1,y*2+1, mean4Pixelw(mip.pixel(x  ,y  ), byte(144),
-                                                        (x<mip.width()-1 ? mip.pixel(x+1,y  ) : bkg), (x<mip.width()-1 ? byte( 48) : 0),
-                                                        (y<mip.height()-1  ? mip.pixel(x  ,y+1) : bkg), ( y<mip.height()-1  ? byte( 48) : 0),
-                                                        ((x<mip.width()-1  && y<mip.height()-1) ? mip.pixel(x+1,y+1) : bkg), ((x<mip.width()-1  && y<mip.height()-1) ? byte( 16) : 0)));
-
+                const bool l = x>0;
+                const bool r = x<mw-1;
+                if(r0[x*2]==bkg)
+                    r0[x*2] = mean4Pixelw(mc[x], byte(144),
+                                          (l ? mc[x-1] : bkg), (l ? byte( 48) : 0),
+                                          (mu ? mu[x] : bkg), (mu ? byte( 48) : 0),
+                                          ((l && mu) ? mu[x-1] : bkg), ((l && mu) ? byte( 16) : 0));
+                if(r0[x*2+1]==bkg)
+                    r0[x*2+1] = mean4Pixelw(mc[x], byte(144),
+                                            (r ? mc[x+1] : bkg), (r ? byte( 48) : 0),
+                                            (mu ? mu[x] : bkg), (mu ? byte( 48) : 0),
+                                            ((r && mu) ? mu[x+1] : bkg), ((r && mu) ? byte( 16) : 0));
+                if(r1[x*2]==bkg)
+                    r1[x*2] = mean4Pixelw(mc[x], byte(144),
+                                          (l ? mc[x-1] : bkg), (l ? byte( 48) : 0),
+                                          (md ? md[x] : bkg), (md ? byte( 48) : 0),
+                                          ((l && md) ? md[x-1] : bkg), ((l && md) ? byte( 16) : 0));
+                if(r1[x*2+1]==bkg)
+                    r1[x*2+1] = mean4Pixelw(mc[x], byte(144),
+                                            (r ? mc[x+1] : bkg), (r ? byte( 48) : 0),
+                                            (md ? md[x] : bkg), (md ? byte( 48) : 0),
+                                            ((r && md) ? md[x+1] : bkg), ((r && md) ? byte( 16) : 0));
             }
+        }
     }
 
 
-    void PullPush( QImage & p, QRgb  bkcolor )
+    inline void PullPush( QImage & p, QRgb  bkcolor )
     {
+        if(p.format()!=QImage::Format_ARGB32 && p.format()!=QImage::Format_RGB32)
+            p = p.convertToFormat(QImage::Format_ARGB32);
         int i=0;
         std::vector<QImage> mip(16);
         int div=2;
@@ -24,10 +24,39 @@
 #ifndef _RASTERING_H
 #define _RASTERING_H
 
+#include <memory>
+
 #include <common/ml_document/mesh_model.h>
+#include <common/ml_document/mesh_ray_bvh.h>
 #include <vcg/complex/algorithms/point_sampling.h>
 #include <vcg/space/triangle2.h>
 
+// direct access to the texels of ARGB32 images, addressed as in the texture space (row 0 at
+// the bottom); different texels can be read and written by different threads
+class TexelImages
+{
+    vector<uchar *> bits;
+    vector<int> bytesPerLine;
+    vector<int> height;
+
+public:
+    TexelImages(vector<QImage> &imgs)
+    {
+        for (size_t i = 0; i < imgs.size(); ++i)
+        {
+            assert(imgs[i].format() == QImage::Format_ARGB32);
+            bits.push_back(imgs[i].bits());
+            bytesPerLine.push_back(imgs[i].bytesPerLine());
+            height.push_back(imgs[i].height());
+        }
+    }
+
+    QRgb &texel(int n, const vcg::Point2i &tp)
+    {
+        return reinterpret_cast<QRgb *>(bits[n] + size_t(height[n] - 1 - tp.Y()) * bytesPerLine[n])[tp.X()];
+    }
+};
+
 class VertexSampler
 {
     typedef vcg::GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType > MetroMeshGrid;
@@ -101,30 +130,13 @@ public:
     }
 };
 
+// used with TexelRaster: the samples can come from many threads
 class RasterSampler
 {
-    vector<QImage> &trgImgs;
-
-    // Callback stuff
-    vcg::CallBackPos *cb;
-    const CMeshO::FaceType *currFace;
-    int faceNo, faceCnt, start, offset;
+    TexelImages trgTexels;
 
 public:
-	RasterSampler(vector<QImage> &_imgs) : trgImgs(_imgs) {}
-
-    void InitCallback(vcg::CallBackPos *_cb, int _faceNo, int _start=0, int _offset=100)
-    {
-        assert(_faceNo > 0);
-        assert(_start>=0);
-        assert(_offset>=0 && _offset <= 100-_start);
-        cb = _cb;
-        faceNo = _faceNo;
-        faceCnt = 0;
-        start = _start;
-        offset = _offset;
-        currFace = NULL;
-    }
+	RasterSampler(vector<QImage> &_imgs) : trgTexels(_imgs) {}
 
         // expects points outside face (affecting face color) with edge distance > 0
     void AddTextureSample(const CMeshO::FaceType &f, const CMeshO::CoordType &p, const vcg::Point2i &tp, float edgeDist= 0.0)
@@ -139,41 +151,32 @@ public:
         if (edgeDist != 0.0)
             alpha=254-edgeDist*128;
 
-		if (alpha == 255 || qAlpha(trgImgs[f.cWT(0).N()].pixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y())) < alpha)
+        QRgb &texel = trgTexels.texel(f.cWT(0).N(), tp);
+		if (alpha == 255 || qAlpha(texel) < alpha)
         {
             c.lerp(f.cV(0)->cC(), f.cV(1)->cC(), f.cV(2)->cC(), p);
-			trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(c[0], c[1], c[2], alpha));
-        }
-        if (cb)
-        {
-            if (&f != currFace) {currFace = &f; ++faceCnt;}
-            cb(start + faceCnt*offset/faceNo, "Rasterizing faces ...");
+			texel = qRgba(c[0], c[1], c[2], alpha);
         }
     }
 };
 
+// used with TexelRaster: the closest points are searched with a MeshRayBVH (the face grid
+// would share the marks of the mesh among the threads)
 class TransferColorSampler
 {
-    typedef vcg::GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType > MetroMeshGrid;
     typedef vcg::GridStaticPtr<CMeshO::VertexType, CMeshO::ScalarType > VertexMeshGrid;
 
-    vector <QImage> &trgImgs;
+    TexelImages trgTexels;
 	vector <QImage> *srcImgs;
     float dist_upper_bound;
     bool fromTexture;
-    MetroMeshGrid unifGridFace;
+    std::unique_ptr<MeshRayBVH> bvh;
     VertexMeshGrid   unifGridVert;
     bool usePointCloudSampling;
 
-    // Callback stuff
-    vcg::CallBackPos *cb;
-    const CMeshO::FaceType *currFace;
     CMeshO *srcMesh;
-    int faceNo, faceCnt, start, offset;
     int vertexMode;
     float minQ,maxQ;
-    typedef vcg::tri::FaceTmark<CMeshO> MarkerFace;
-    MarkerFace markerFunctor;
 
     /*QRgb GetBilinearPixelColor(float _u, float _v, int alpha)
     {
@@ -207,13 +210,12 @@ class TransferColorSampler
 
 public:
     TransferColorSampler(CMeshO &_srcMesh, vector <QImage> &_trgImgs, float upperBound, int _vertexMode)
-    : trgImgs(_trgImgs), dist_upper_bound(upperBound)
+    : trgTexels(_trgImgs), srcImgs(NULL), dist_upper_bound(upperBound)
     {
         srcMesh=&_srcMesh;
         usePointCloudSampling = _srcMesh.face.empty();
         if(usePointCloudSampling) unifGridVert.Set(_srcMesh.vert.begin(),_srcMesh.vert.end());
-                        else  unifGridFace.Set(_srcMesh.face.begin(),_srcMesh.face.end());
-        markerFunctor.SetMesh(&_srcMesh);
+                        else  bvh.reset(new MeshRayBVH(_srcMesh));
         fromTexture = false;
         vertexMode=_vertexMode;
         if(vertexMode==2)
@@ -225,26 +227,14 @@ public:
     }
 
 	TransferColorSampler(CMeshO &_srcMesh, vector <QImage> &_trgImgs, vector <QImage> *_srcImgs, float upperBound)
-		: trgImgs(_trgImgs), srcImgs(_srcImgs), dist_upper_bound(upperBound)
+		: trgTexels(_trgImgs), srcImgs(_srcImgs), dist_upper_bound(upperBound)
     {
-        unifGridFace.Set(_srcMesh.face.begin(),_srcMesh.face.end());
-        markerFunctor.SetMesh(&_srcMesh);
+        srcMesh=&_srcMesh;
+        bvh.reset(new MeshRayBVH(_srcMesh));
         fromTexture = true;
         usePointCloudSampling=false;
         vertexMode=-1;
     }
-    void InitCallback(vcg::CallBackPos *_cb, int _faceNo, int _start=0, int _offset=100)
-    {
-        assert(_faceNo > 0);
-        assert(_start>=0);
-        assert(_offset>=0 && _offset <= 100-_start);
-        cb = _cb;
-        faceNo = _faceNo;
-        faceCnt = 0;
-        start = _start;
-        offset = _offset;
-        currFace = NULL;
-    }
 
     void AddTextureSample(const CMeshO::FaceType &f, const CMeshO::CoordType &p, const vcg::Point2i &tp, float edgeDist=0.0)
     {
@@ -298,20 +288,18 @@ public:
                     rr = gg = bb = q;
                 } break;
             }
-			trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(rr, gg, bb, 255));
+			trgTexels.texel(f.cWT(0).N(), tp) = qRgba(rr, gg, bb, 255);
         }
         else // sampling from a mesh
         {
             CMeshO::CoordType closestPt;
-            vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
-            CMeshO::ScalarType dist=dist_upper_bound;
-            CMeshO::FaceType *nearestF;
-            nearestF =  unifGridFace.GetClosest(PDistFunct, markerFunctor, startPt, dist_upper_bound, dist, closestPt);
-            if (dist == dist_upper_bound) return;
+            int nearestIndex;
+            if (!bvh->closestPoint(startPt, dist_upper_bound, closestPt, nearestIndex)) return;
+            const CMeshO::FaceType *nearestF = &srcMesh->face[nearestIndex];
 
             // Convert point to barycentric coords
             CMeshO::CoordType interp;
-            bool ret = vcg::InterpolationParameters(*nearestF, nearestF->N(), closestPt, interp);
+            bool ret = vcg::InterpolationParameters(*nearestF, nearestF->cN(), closestPt, interp);
                         // if the point is outside the nearest face,
             // then let's clamp it inside:
                         if(!ret)
@@ -330,7 +318,8 @@ public:
               interp[2]=1.0-interp[1]-interp[0];
             }
 
-		if (alpha == 255 || qAlpha(trgImgs[f.cWT(0).N()].pixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y())) < alpha)
+        QRgb &texel = trgTexels.texel(f.cWT(0).N(), tp);
+		if (alpha == 255 || qAlpha(texel) < alpha)
         {
             if (fromTexture)
             {
@@ -342,7 +331,7 @@ public:
                 x = (x%w + w)%w;
                 y = (y%h + h)%h;
 				QRgb px = (*srcImgs)[nearestF->cWT(0).N()].pixel(x, y);
-				trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(qRed(px), qGreen(px), qBlue(px), alpha));
+				texel = qRgba(qRed(px), qGreen(px), qBlue(px), alpha);
             }
             else
             {
@@ -351,32 +340,27 @@ public:
                 switch(vertexMode)
                 {
                 case 0 : // Color
-                    c.lerp(nearestF->V(0)->cC(), nearestF->V(1)->cC(), nearestF->V(2)->cC(), interp);
+                    c.lerp(nearestF->cV(0)->cC(), nearestF->cV(1)->cC(), nearestF->cV(2)->cC(), interp);
                     break;
                 case 1 : { // Normal
-                    CMeshO::CoordType nn = nearestF->V(0)->cN()*interp[0]+
-                                           nearestF->V(1)->cN()*interp[1]+
-                                           nearestF->V(2)->cN()*interp[2];
+                    CMeshO::CoordType nn = nearestF->cV(0)->cN()*interp[0]+
+                                           nearestF->cV(1)->cN()*interp[1]+
+                                           nearestF->cV(2)->cN()*interp[2];
                     nn.Normalize();
                     nn= ((nn+CMeshO::CoordType(1.0,1.0,1.0))/2.0f)*255.0f;
                     c=vcg::Color4b(nn[0],nn[1],nn[2],255);
                 } break;
                 case 2 : { // Quality
-                    float q = nearestF->V(0)->cQ()*interp[0]+
-                            nearestF->V(1)->cQ()*interp[1]+
-                            nearestF->V(2)->cQ()*interp[2];
+                    float q = nearestF->cV(0)->cQ()*interp[0]+
+                            nearestF->cV(1)->cQ()*interp[1]+
+                            nearestF->cV(2)->cQ()*interp[2];
                     c=vcg::Color4b::GrayShade(255.0*(q-minQ)/(maxQ-minQ));
                 } break;
                 default: assert(0);
                 }
-				trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(c[0], c[1], c[2], alpha));
+				texel = qRgba(c[0], c[1], c[2], alpha);
             }
         }
-            if (cb)
-            {
-                if (&f != currFace) {currFace = &f; ++faceCnt;}
-                cb(start + faceCnt*offset/faceNo, "Rasterizing faces ...");
-            }
         }
     }
 };
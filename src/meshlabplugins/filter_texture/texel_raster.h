@@ -0,0 +1,242 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+
+#ifndef _TEXEL_RASTER_H
+#define _TEXEL_RASTER_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+#include <wrap/callback.h>
+
+/*
+TexelRaster
+The rasterization of vcg::tri::SurfaceSampling::Texture run in parallel: the sampler gets
+the same texels of SingleFaceRaster, with the same barycentric coords, including the
+samples just outside the texture space border edges (edgeDist > 0).
+
+The textures are split in square tiles, the faces are binned on the tiles of their texture
+(WT(0).N()) overlapped by their bounding box, and each tile is rasterized by one thread,
+clipping the faces to it. In a tile the faces come in the mesh order, so each texel gets
+its samples in the order of the serial rasterization, and the samplers that test what is
+already in the texel give the same result. The tiles of all the textures are processed
+together.
+The sampler must accept concurrent AddTextureSample calls on different texels (so it
+cannot call the callback: the progress is reported here, between batches of tiles).
+The samples out of the textures are dropped, the faces with a texture index not in
+[0, textureNum) are skipped.
+*/
+template <class Sampler>
+class TexelRaster
+{
+    typedef CMeshO::ScalarType S;
+    typedef vcg::Point2<S> Point2x;
+    static const int TILE_SIZE = 64;
+
+public:
+    static void Texture(CMeshO &m, Sampler &ps, int textureNum, int textureWidth, int textureHeight,
+                        bool correctSafePointsBaryCoords, vcg::CallBackPos *cb = 0, int start = 0, int offset = 100)
+    {
+        const int fn = int(m.face.size());
+        const int tilesX = (textureWidth + TILE_SIZE - 1) / TILE_SIZE;
+        const int tilesY = (textureHeight + TILE_SIZE - 1) / TILE_SIZE;
+        const int texTiles = tilesX * tilesY;
+        const int tileNum = textureNum * texTiles;
+
+        // texture space vertices and texel bounding box (the one visited by SingleFaceRaster)
+        std::vector<Point2x> uv(3 * size_t(fn));
+        std::vector<int> box(4 * size_t(fn));
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < fn; ++i)
+        {
+            const CMeshO::FaceType &f = m.face[i];
+            int *b = &box[4 * size_t(i)];
+            b[0] = b[2] = 0;
+            b[1] = b[3] = -1;
+            if (f.IsD() || f.cWT(0).N() < 0 || f.cWT(0).N() >= textureNum)
+                continue;
+            S minx = FLT_MAX, miny = FLT_MAX, maxx = -FLT_MAX, maxy = -FLT_MAX;
+            for (int k = 0; k < 3; ++k)
+            {
+                Point2x &t = uv[3 * size_t(i) + k];
+                t = Point2x(f.cWT(k).U() * textureWidth - 0.5, f.cWT(k).V() * textureHeight - 0.5);
+                minx = std::min(minx, t[0]); maxx = std::max(maxx, t[0]);
+                miny = std::min(miny, t[1]); maxy = std::max(maxy, t[1]);
+            }
+            if (!std::isfinite(minx) || !std::isfinite(maxx) || !std::isfinite(miny) || !std::isfinite(maxy))
+                continue;
+            b[0] = int(std::min<S>(S(textureWidth), std::max<S>(S(0), std::floor(minx) - 1)));
+            b[1] = int(std::max<S>(S(-1), std::min<S>(S(textureWidth - 1), std::ceil(maxx) + 1)));
+            b[2] = int(std::min<S>(S(textureHeight), std::max<S>(S(0), std::floor(miny) - 1)));
+            b[3] = int(std::max<S>(S(-1), std::min<S>(S(textureHeight - 1), std::ceil(maxy) + 1)));
+        }
+
+        // binning: counting sort of the (face, tile) pairs on the tile, faces in mesh order
+        std::vector<int> tileFirst(tileNum + 1, 0);
+        for (int i = 0; i < fn; ++i)
+        {
+            const int *b = &box[4 * size_t(i)];
+            if (b[0] > b[1] || b[2] > b[3]) continue;
+            const int base = m.face[i].cWT(0).N() * texTiles;
+            for (int ty = b[2] / TILE_SIZE; ty <= b[3] / TILE_SIZE; ++ty)
+                for (int tx = b[0] / TILE_SIZE; tx <= b[1] / TILE_SIZE; ++tx)
+                    ++tileFirst[base + ty * tilesX + tx + 1];
+        }
+        for (int t = 0; t < tileNum; ++t)
+            tileFirst[t + 1] += tileFirst[t];
+        std::vector<int> tileFace(tileFirst[tileNum]);
+        std::vector<int> next(tileFirst.begin(), tileFirst.end() - 1);
+        for (int i = 0; i < fn; ++i)
+        {
+            const int *b = &box[4 * size_t(i)];
+            if (b[0] > b[1] || b[2] > b[3]) continue;
+            const int base = m.face[i].cWT(0).N() * texTiles;
+            for (int ty = b[2] / TILE_SIZE; ty <= b[3] / TILE_SIZE; ++ty)
+                for (int tx = b[0] / TILE_SIZE; tx <= b[1] / TILE_SIZE; ++tx)
+                    tileFace[next[base + ty * tilesX + tx]++] = i;
+        }
+
+        const int batchNum = std::max(1, std::min(tileNum, 20));
+        for (int batch = 0; batch < batchNum; ++batch)
+        {
+            const int tb = int((long long)tileNum * batch / batchNum);
+            const int te = int((long long)tileNum * (batch + 1) / batchNum);
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int t = tb; t < te; ++t)
+            {
+                const int tile = t % texTiles;
+                const int x0 = (tile % tilesX) * TILE_SIZE;
+                const int y0 = (tile / tilesX) * TILE_SIZE;
+                const int x1 = std::min(textureWidth, x0 + TILE_SIZE) - 1;
+                const int y1 = std::min(textureHeight, y0 + TILE_SIZE) - 1;
+                for (int j = tileFirst[t]; j < tileFirst[t + 1]; ++j)
+                {
+                    const int i = tileFace[j];
+                    const int *b = &box[4 * size_t(i)];
+                    FaceRaster(m.face[i], ps, &uv[3 * size_t(i)],
+                               std::max(x0, b[0]), std::min(x1, b[1]), std::max(y0, b[2]), std::min(y1, b[3]),
+                               correctSafePointsBaryCoords);
+                }
+            }
+            if (cb) cb(start + offset * (batch + 1) / batchNum, "Rasterizing faces ...");
+        }
+    }
+
+private:
+    static Point2x ClosestSegmentPoint(const Point2x &a, const Point2x &b, const Point2x &p)
+    {
+        const Point2x d = b - a;
+        const S len2 = d.SquaredNorm();
+        if (len2 <= 0) return a;
+        const S t = std::max<S>(0, std::min<S>(1, ((p - a) * d) / len2));
+        return a + d * t;
+    }
+
+    // SingleFaceRaster on the texels [x0, x1] x [y0, y1], with the edge functions evaluated
+    // at each texel instead of incrementally
+    static void FaceRaster(const CMeshO::FaceType &f, Sampler &ps, const Point2x *v,
+                           int x0, int x1, int y0, int y1, bool correctSafePointsBaryCoords)
+    {
+        const Point2x &v0 = v[0], &v1 = v[1], &v2 = v[2];
+        const Point2x d[3] = { v1 - v0, v2 - v1, v0 - v2 };
+        const bool flipped = !(d[2] * Point2x(-d[0][1], d[0][0]) >= 0);
+
+        // border edges of the texture space
+        Point2x edgeP0[3], edgeP1[3];
+        S edgeLength[3];
+        unsigned char edgeMask = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (!f.IsB(i)) continue;
+            edgeP0[i] = v[i];
+            edgeP1[i] = v[(i + 1) % 3];
+            edgeLength[i] = (edgeP1[i] - edgeP0[i]).Norm();
+            edgeMask |= (1 << i);
+        }
+
+        const double de = v0[0]*v1[1]-v0[0]*v2[1]-v1[0]*v0[1]+v1[0]*v2[1]-v2[0]*v1[1]+v2[0]*v0[1];
+
+        for (int x = x0; x <= x1; ++x)
+            for (int y = y0; y <= y1; ++y)
+            {
+                S n[3];
+                for (int i = 0; i < 3; ++i)
+                    n[i] = (x - v[i][0]) * d[i][1] - (y - v[i][1]) * d[i][0];
+                if (((n[0] >= 0 && n[1] >= 0 && n[2] >= 0) || (n[0] <= 0 && n[1] <= 0 && n[2] <= 0)) && (de != 0))
+                {
+                    CMeshO::CoordType baryCoord;
+                    baryCoord[0] =  double(-y*v1[0]+v2[0]*y+v1[1]*x-v2[0]*v1[1]+v1[0]*v2[1]-x*v2[1])/de;
+                    baryCoord[1] = -double(   x*v0[1]-x*v2[1]-v0[0]*y+v0[0]*v2[1]-v2[0]*v0[1]+v2[0]*y)/de;
+                    baryCoord[2] = 1-baryCoord[0]-baryCoord[1];
+                    ps.AddTextureSample(f, baryCoord, vcg::Point2i(x, y), 0);
+                    continue;
+                }
+                if (edgeMask == 0) continue;
+
+                // a texel outside the face, whose 2x2 neighborhood touches a border edge
+                const Point2x px(x, y);
+                Point2x closePoint;
+                int closeEdge = -1;
+                S minDst = FLT_MAX;
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (!(edgeMask & (1 << i))) continue;
+                    if (!((!flipped && n[i] < 0) || (flipped && n[i] > 0))) continue;
+                    const Point2x close = ClosestSegmentPoint(edgeP0[i], edgeP1[i], px);
+                    const S dst = (close - px).Norm();
+                    if (dst < minDst &&
+                        close.X() > px.X()-1 && close.X() < px.X()+1 &&
+                        close.Y() > px.Y()-1 && close.Y() < px.Y()+1)
+                    {
+                        minDst = dst;
+                        closePoint = close;
+                        closeEdge = i;
+                    }
+                }
+                if (closeEdge < 0) continue;
+
+                CMeshO::CoordType baryCoord;
+                if (correctSafePointsBaryCoords)
+                {
+                    // the barycentric coords of the closest point on the edge
+                    baryCoord[closeEdge] = (closePoint - edgeP1[closeEdge]).Norm() / edgeLength[closeEdge];
+                    baryCoord[(closeEdge+1)%3] = 1 - baryCoord[closeEdge];
+                    baryCoord[(closeEdge+2)%3] = 0;
+                }
+                else
+                {
+                    // the (out of the face) barycentric coords of the texel
+                    baryCoord[0] =  double(-y*v1[0]+v2[0]*y+v1[1]*x-v2[0]*v1[1]+v1[0]*v2[1]-x*v2[1])/de;
+                    baryCoord[1] = -double(   x*v0[1]-x*v2[1]-v0[0]*y+v0[0]*v2[1]-v2[0]*v0[1]+v2[0]*y)/de;
+                    baryCoord[2] = 1-baryCoord[0]-baryCoord[1];
+                }
+                ps.AddTextureSample(f, baryCoord, vcg::Point2i(x, y), minDst);
+            }
+    }
+};
+
+#endif
@@ -31,6 +31,10 @@
 
 #include <vcg/complex/algorithms/update/normal.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include "curvdata.h"
 
 namespace vcg
@@ -69,11 +73,28 @@ protected:
     // adjacent to edge to be flipped
     ScalarType _cv0, _cv1, _cv2, _cv3;
 
+    /* Vertex normals seen by the curvature evaluation: the normals of the
+     * (at most 4) vertices in v are replaced by the ones in n, so that the
+     * curvature after a flip is evaluated without modifying the mesh */
+    struct NormalOverride
+    {
+        VertexPointer v[4];
+        CoordType n[4];
+
+        CoordType N(VertexPointer p) const
+        {
+            for (int k = 0; k < 4; ++k)
+                if (v[k] == p)
+                    return n[k];
+            return p->cN();
+        }
+    };
 
     static CurvData FaceCurv(VertexPointer v0,
                           VertexPointer v1,
                           VertexPointer v2,
-                          CoordType fNormal)
+                          CoordType fNormal,
+                          const NormalOverride *no = NULL)
     {
         CurvData res;
 
@@ -98,8 +119,8 @@ protected:
 
         res.K += ang0;
 
-        ang1 = math::Abs(Angle(fNormal, v1->N()));
-        ang2 = math::Abs(Angle(fNormal, v2->N()));
+        ang1 = math::Abs(Angle(fNormal, no ? no->N(v1) : v1->cN()));
+        ang2 = math::Abs(Angle(fNormal, no ? no->N(v2) : v2->cN()));
         res.H += ( (math::Sqrt(s01) / 2.0) * ang1 +
                    (math::Sqrt(s02) / 2.0) * ang2 );
 
@@ -108,8 +129,10 @@ protected:
 
     /* Compute vertex curvature walking around a verte with VF adjacency
      * f1, f2 --> this faces are to be ignored
+     * no --> vertex normals to be used in place of the current ones
      * */
-    static CurvData Curvature(VertexPointer v, FacePointer f1 = NULL, FacePointer f2 = NULL)
+    static CurvData Curvature(VertexPointer v, FacePointer f1 = NULL, FacePointer f2 = NULL,
+                              const NormalOverride *no = NULL)
     {
         CurvData curv;
         VFIteratorType vfi(v);
@@ -120,7 +143,7 @@ protected:
                 curv += FaceCurv(vfi.F()->V0(i),
                                  vfi.F()->V1(i),
                                  vfi.F()->V2(i),
-                                 vfi.F()->N());
+                                 vfi.F()->N(), no);
             }
             ++vfi;
         }
@@ -261,33 +284,22 @@ public:
         // save sum of curvatures of vertices
         float cbefore = v0->Q() + v1->Q() + v2->Q() + v3->Q();
 
-        // saving current vertex normals
-        CoordType nv0orig = v0->N();
-        CoordType nv1orig = v1->N();
-        CoordType nv2orig = v2->N();
-        CoordType nv3orig = v3->N();
-
         CurvData cd0, cd1, cd2, cd3;
         CoordType n1 = Normal(v0->P(), v3->P(), v2->P());
         CoordType n2 = Normal(v1->P(), v2->P(), v3->P());
 
-        // new vertex normal after the flip
-        // set this now to evaluate new curvatures
-        v0->N() = nv0orig - f1->N() - f2->N() + n1;
-        v1->N() = nv1orig - f1->N() - f2->N() + n2;
-        v2->N() = nv2orig - f1->N() + n1 + n2;
-        v3->N() = nv3orig - f2->N() + n1 + n2;
-
-        cd0 = FaceCurv(v0, v3, v2, n1) + Curvature(v0, f1, f2);
-        cd1 = FaceCurv(v1, v2, v3, n2) + Curvature(v1, f1, f2);
-        cd2 = FaceCurv(v2, v0, v3, n1) + FaceCurv(v2, v3, v1, n2) + Curvature(v2, f1, f2);
-        cd3 = FaceCurv(v3, v2, v0, n1) + FaceCurv(v3, v1, v2, n2) + Curvature(v3, f1, f2);
+        // new vertex normals after the flip, used to evaluate new curvatures;
+        // the mesh is only read, so many priorities can be computed at once
+        NormalOverride no;
+        no.v[0] = v0; no.n[0] = v0->cN() - f1->cN() - f2->cN() + n1;
+        no.v[1] = v1; no.n[1] = v1->cN() - f1->cN() - f2->cN() + n2;
+        no.v[2] = v2; no.n[2] = v2->cN() - f1->cN() + n1 + n2;
+        no.v[3] = v3; no.n[3] = v3->cN() - f2->cN() + n1 + n2;
 
-        // restore original pervertex normals after computation
-        v0->N() = nv0orig;
-        v1->N() = nv1orig;
-        v2->N() = nv2orig;
-        v3->N() = nv3orig;
+        cd0 = FaceCurv(v0, v3, v2, n1, &no) + Curvature(v0, f1, f2, &no);
+        cd1 = FaceCurv(v1, v2, v3, n2, &no) + Curvature(v1, f1, f2, &no);
+        cd2 = FaceCurv(v2, v0, v3, n1, &no) + FaceCurv(v2, v3, v1, n2, &no) + Curvature(v2, f1, f2, &no);
+        cd3 = FaceCurv(v3, v2, v0, n1, &no) + FaceCurv(v3, v1, v2, n2, &no) + Curvature(v3, f1, f2, &no);
 
         CURVEVAL curveval;
 
@@ -330,6 +342,133 @@ public:
             TopoEdgeFlip<TRIMESH_TYPE, MYTYPE>::Insert(heap, newpos, tri::IMark(m),pp);
                     }
     }
+
+    /* Parallel alternative to the LocalOptimization heap; it requires FF and VF
+     * adjacency and compact vectors. Returns the number of performed flips.
+     *
+     * The optimization proceeds in rounds: the priorities of the edges around
+     * the last flips are evaluated in parallel, then the improving flips are
+     * taken in order of priority, skipping the ones whose 4 vertices are in
+     * the one-ring of the vertices of a flip already taken (and vice versa),
+     * and executed. The priority of a flip reads the quality of its 4 vertices
+     * and the positions and normals of their one-ring, while a flip changes
+     * only its 4 vertices and its 2 faces, so the flips taken in a round do not
+     * change each other's gain; each one is still re-evaluated before being
+     * executed. Only the curvature flips use this scheme, the planar flips
+     * are run through the LocalOptimization heap.
+     */
+    static int ParallelOptimization(TRIMESH_TYPE &m, BaseParameterClass *pp,
+                                    ScalarType targetMetric, int maxRounds = 1000)
+    {
+        // comuputing edge flip priority require non normalized vertex normals AND non normalized face normals.
+        vcg::tri::UpdateNormal<TRIMESH_TYPE>::PerVertexPerFace(m);
+
+        const int vn = int(m.vert.size());
+        const int fn = int(m.face.size());
+#pragma omp parallel for schedule(dynamic, 256)
+        for (int i = 0; i < vn; ++i)
+            if (!m.vert[i].IsD() && m.vert[i].IsW()) {
+                CURVEVAL curveval;
+                m.vert[i].Q() = curveval(Curvature(&m.vert[i]));
+            }
+
+        const int mark = tri::IMark(m);
+        const ScalarType inf = std::numeric_limits<ScalarType>::infinity();
+        // priority of the edge i of face f in priority[3*f+i], each edge is
+        // evaluated on the face where V1 > V0 (as in Init), infinity elsewhere
+        std::vector<ScalarType> priority(3 * size_t(fn), inf);
+        std::vector<char> dirty(fn, 1);
+        std::vector<int> dirtyFaces, candidates, taken;
+        // round in which a vertex has been written/read by a flip taken
+        std::vector<int> writeMark(vn, -1), readMark(vn, -1);
+        std::vector<int> ring;
+        int performed = 0;
+
+        for (int round = 0; round < maxRounds; ++round)
+        {
+            dirtyFaces.clear();
+            for (int i = 0; i < fn; ++i)
+                if (dirty[i]) {
+                    dirtyFaces.push_back(i);
+                    dirty[i] = 0;
+                }
+
+            const int dn = int(dirtyFaces.size());
+#pragma omp parallel for schedule(dynamic, 64)
+            for (int k = 0; k < dn; ++k) {
+                FacePointer f = &m.face[dirtyFaces[k]];
+                for (int i = 0; i < 3; ++i) {
+                    ScalarType &pri = priority[3 * size_t(dirtyFaces[k]) + i];
+                    pri = inf;
+                    if (!f->IsD() && f->V1(i) - f->V0(i) > 0)
+                        pri = MYTYPE(PosType(f, i), mark, pp).Priority();
+                }
+            }
+
+            // stop when flips become harmful
+            candidates.clear();
+            for (int c = 0; c < 3 * fn; ++c)
+                if (priority[c] <= targetMetric)
+                    candidates.push_back(c);
+            if (candidates.empty())
+                break;
+            std::sort(candidates.begin(), candidates.end(), [&priority](int a, int b) {
+                return priority[a] < priority[b] || (priority[a] == priority[b] && a < b);
+            });
+
+            // greedy maximal set of independent flips, best first
+            taken.clear();
+            for (size_t k = 0; k < candidates.size(); ++k) {
+                const int c = candidates[k];
+                FacePointer f = &m.face[c / 3];
+                const int i = c % 3;
+                VertexPointer v[4] = { f->V0(i), f->V1(i), f->V2(i), f->FFp(i)->V2(f->FFi(i)) };
+
+                ring.clear();
+                for (int j = 0; j < 4; ++j)
+                    for (VFIteratorType vfi(v[j]); !vfi.End(); ++vfi)
+                        for (int l = 0; l < 3; ++l)
+                            ring.push_back(int(tri::Index(m, vfi.F()->V(l))));
+
+                bool independent = true;
+                for (int j = 0; j < 4 && independent; ++j)
+                    independent = readMark[tri::Index(m, v[j])] != round;
+                for (size_t j = 0; j < ring.size() && independent; ++j)
+                    independent = writeMark[ring[j]] != round;
+                if (!independent)
+                    continue;
+
+                for (int j = 0; j < 4; ++j)
+                    writeMark[tri::Index(m, v[j])] = round;
+                for (size_t j = 0; j < ring.size(); ++j)
+                    readMark[ring[j]] = round;
+                taken.push_back(c);
+            }
+
+            for (size_t k = 0; k < taken.size(); ++k) {
+                MYTYPE flip(PosType(&m.face[taken[k] / 3], taken[k] % 3), mark, pp);
+                if (!(flip.Priority() <= targetMetric))
+                    continue;
+                flip.Execute(m, pp);
+                ++performed;
+            }
+
+            // the priority of an edge may have changed if a vertex of its
+            // diamond is in the one-ring of the flips: the edge has then a face
+            // around that vertex, but it is evaluated on only one of its two
+            // faces, so the adjacent faces are marked as well
+            for (int i = 0; i < vn; ++i)
+                if (readMark[i] == round)
+                    for (VFIteratorType vfi(&m.vert[i]); !vfi.End(); ++vfi) {
+                        FacePointer f = vfi.F();
+                        dirty[tri::Index(m, f)] = 1;
+                        for (int j = 0; j < 3; ++j)
+                            dirty[tri::Index(m, f->FFp(j))] = 1;
+                    }
+        }
+
+        return performed;
+    }
 }; // end CurvEdgeFlip class
 
 
@@ -285,7 +285,6 @@ bool TriOptimizePlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 		}
 	vcg::tri::PlanarEdgeFlipParameter pp;
 
-	vcg::LocalOptimization<CMeshO> optimiz(m.cm,&pp);
 		float pthr = par.getFloat("pthreshold");
 		time_t start = clock();
 
@@ -312,19 +311,17 @@ bool TriOptimizePlugin::applyFilter(const QAction *filter, MeshDocument &md, std
 
             int metric = par.getEnum("curvtype");
       pp.CoplanarAngleThresholdDeg = pthr;
+
+			// rounds of independent flips with their gains evaluated in parallel,
+			// stopping when flips become harmful
+			int nflips = 0;
             switch (metric) {
-        case 0: optimiz.Init<MeanCEFlip>(); break;
-        case 1: optimiz.Init<NSMCEFlip>();  break;
-        case 2: optimiz.Init<AbsCEFlip>();  break;
+        case 0: nflips = MeanCEFlip::ParallelOptimization(m.cm, &pp, limit); break;
+        case 1: nflips = NSMCEFlip::ParallelOptimization(m.cm, &pp, limit);  break;
+        case 2: nflips = AbsCEFlip::ParallelOptimization(m.cm, &pp, limit);  break;
             }
 
-			// stop when flips become harmful
-			optimiz.SetTargetMetric(limit);
-			//optimiz.SetTargetOperations(10);
-			optimiz.DoOptimization();
-			optimiz.h.clear();
-
-			log( "%d curvature edge flips performed in %.2f sec.",  optimiz.nPerformedOps, (clock() - start) / (float) CLOCKS_PER_SEC);
+			log( "%d curvature edge flips performed in %.2f sec.",  nflips, (clock() - start) / (float) CLOCKS_PER_SEC);
 		}
 	if (ID(filter) == FP_PLANAR_EDGE_FLIP) {
 	  if ( tri::Clean<CMeshO>::CountNonManifoldEdgeFF(m.cm) >0) {
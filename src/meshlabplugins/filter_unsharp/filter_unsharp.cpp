@@ -21,6 +21,7 @@
 *                                                                           *
 ****************************************************************************/
 #include "filter_unsharp.h"
+#include "vertex_smoother.h"
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/smooth.h>
@@ -429,7 +430,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
              break;
   case FP_VERTEX_QUALITY_SMOOTHING :
       tri::UpdateFlags<CMeshO>::FaceBorderFromNone(m.cm);
-                 tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm);
+                 if (VertexSmoother::supports(m.cm))
+                     VertexSmoother(m.cm).qualityLaplacian();
+                 else
+                     tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm);
              break;
 
     case FP_LAPLACIAN_SMOOTH :
@@ -444,7 +448,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
       bool cotangentWeight = par.getBool("cotangentWeight");
       if(!boundarySmooth) tri::UpdateFlags<CMeshO>::FaceClearB(m.cm);
 
-      tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm,stepSmoothNum,Selected,cotangentWeight,cb);
+      if (VertexSmoother::supports(m.cm))
+          VertexSmoother(m.cm).coordLaplacian(stepSmoothNum,Selected,cotangentWeight,cb);
+      else
+          tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm,stepSmoothNum,Selected,cotangentWeight,cb);
       log( "Smoothed %d vertices", Selected ? m.cm.svn : m.cm.vn);
       m.UpdateBoxAndNormals();
       }
@@ -523,7 +530,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
       {
             tri::UpdateFlags<CMeshO>::FaceBorderFromNone(m.cm);
             size_t cnt=tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
-            tri::Smooth<CMeshO>::VertexCoordLaplacianHC(m.cm,1,cnt>0);
+            if (VertexSmoother::supports(m.cm))
+                VertexSmoother(m.cm).coordLaplacianHC(1,cnt>0);
+            else
+                tri::Smooth<CMeshO>::VertexCoordLaplacianHC(m.cm,1,cnt>0);
             m.UpdateBoxAndNormals();
       }
         break;
@@ -556,7 +566,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
             float mu=par.getFloat("mu");
 
             size_t cnt=tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
-      tri::Smooth<CMeshO>::VertexCoordTaubin(m.cm,stepSmoothNum,lambda,mu,cnt>0,cb);
+      if (VertexSmoother::supports(m.cm))
+          VertexSmoother(m.cm).coordTaubin(stepSmoothNum,lambda,mu,cnt>0,cb);
+      else
+          tri::Smooth<CMeshO>::VertexCoordTaubin(m.cm,stepSmoothNum,lambda,mu,cnt>0,cb);
             log( "Smoothed %d vertices", cnt>0 ? cnt : m.cm.vn);
             m.UpdateBoxAndNormals();
       }
@@ -634,7 +647,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
                 for(int i=0;i<m.cm.vn;++i)
                     geomOrig[i]=m.cm.vert[i].P();
 
-                tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm,smoothIter);
+                if (VertexSmoother::supports(m.cm))
+                    VertexSmoother(m.cm).coordLaplacian(smoothIter);
+                else
+                    tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm,smoothIter);
 
                 for(int i=0;i<m.cm.vn;++i)
                     m.cm.vert[i].P()=geomOrig[i]*alphaorig + (geomOrig[i] - m.cm.vert[i].P())*alpha;
@@ -654,7 +670,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
                 for(int i=0;i<m.cm.vn;++i)
                     colorOrig[i].Import(m.cm.vert[i].C());
 
-                tri::Smooth<CMeshO>::VertexColorLaplacian(m.cm,smoothIter);
+                if (VertexSmoother::supports(m.cm))
+                    VertexSmoother(m.cm).colorLaplacian(smoothIter);
+                else
+                    tri::Smooth<CMeshO>::VertexColorLaplacian(m.cm,smoothIter);
                 for(int i=0;i<m.cm.vn;++i)
                     {
                         Color4f colorDelta = colorOrig[i] - Color4f::Construct(m.cm.vert[i].C());
@@ -676,7 +695,10 @@ bool FilterUnsharp::applyFilter(const QAction *filter, MeshDocument &md, std::ma
                 for(int i=0;i<m.cm.vn;++i)
                     qualityOrig[i] = m.cm.vert[i].Q();
 
-                tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm, smoothIter);
+                if (VertexSmoother::supports(m.cm))
+                    VertexSmoother(m.cm).qualityLaplacian(smoothIter);
+                else
+                    tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm, smoothIter);
                 for(int i=0;i<m.cm.vn;++i)
                 {
                     float qualityDelta = qualityOrig[i] - m.cm.vert[i].Q();
@@ -2,10 +2,12 @@ include (../../shared.pri)
 
 HEADERS += \
     filter_unsharp.h \
+    vertex_smoother.h \
     $$VCGDIR/vcg/complex/algorithms/crease_cut.h
 				
 SOURCES += \
-    filter_unsharp.cpp
+    filter_unsharp.cpp \
+    vertex_smoother.cpp
 		
 TARGET = filter_unsharp
 
@@ -0,0 +1,379 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "vertex_smoother.h"
+
+#include <cmath>
+
+using namespace vcg;
+
+VertexSmoother::VertexSmoother(CMeshO& m) : m(m)
+{
+}
+
+bool VertexSmoother::supports(const CMeshO& m)
+{
+	return m.en == 0;
+}
+
+/*
+The same contributions of tri::Smooth::AccumulateLaplacianInfo: a vertex on a border
+edge is averaged only with the other vertices of its border edges, any other vertex
+with the vertices of all its (non border) edges, once for each face of the edge.
+*/
+void VertexSmoother::buildLaplacianAdjacency()
+{
+	const size_t vn = m.vert.size();
+	Adjacency& a = laplacian;
+	a.border.assign(vn, 0);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+				if (f.IsB(j))
+				{
+					a.border[tri::Index(m, f.cV0(j))] = 1;
+					a.border[tri::Index(m, f.cV1(j))] = 1;
+				}
+
+	a.first.assign(vn + 1, 0);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+			{
+				const size_t v0 = tri::Index(m, f.cV0(j));
+				const size_t v1 = tri::Index(m, f.cV1(j));
+				if (f.IsB(j) || !a.border[v0]) ++a.first[v0 + 1];
+				if (f.IsB(j) || !a.border[v1]) ++a.first[v1 + 1];
+			}
+	for (size_t i = 0; i < vn; ++i)
+		a.first[i + 1] += a.first[i];
+
+	// the entries are filled in the order of the faces
+	a.neighbor.resize(a.first[vn]);
+	a.opposite.resize(a.first[vn]);
+	std::vector<size_t> pos(a.first.begin(), a.first.end() - 1);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+			{
+				const int v0 = int(tri::Index(m, f.cV0(j)));
+				const int v1 = int(tri::Index(m, f.cV1(j)));
+				const int opp = f.IsB(j) ? -1 : int(tri::Index(m, f.cV2(j)));
+				if (f.IsB(j) || !a.border[v0])
+				{
+					a.neighbor[pos[v0]] = v1;
+					a.opposite[pos[v0]++] = opp;
+				}
+				if (f.IsB(j) || !a.border[v1])
+				{
+					a.neighbor[pos[v1]] = v0;
+					a.opposite[pos[v1]++] = opp;
+				}
+			}
+}
+
+/*
+The neighbours of VertexCoordLaplacianHC: the vertices of all the face edges,
+twice for the border ones.
+*/
+void VertexSmoother::buildHCAdjacency()
+{
+	const size_t vn = m.vert.size();
+	Adjacency& a = hc;
+	a.first.assign(vn + 1, 0);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+			{
+				const int k = f.IsB(j) ? 2 : 1;
+				a.first[tri::Index(m, f.cV0(j)) + 1] += k;
+				a.first[tri::Index(m, f.cV1(j)) + 1] += k;
+			}
+	for (size_t i = 0; i < vn; ++i)
+		a.first[i + 1] += a.first[i];
+
+	a.neighbor.resize(a.first[vn]);
+	std::vector<size_t> pos(a.first.begin(), a.first.end() - 1);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+			{
+				const int v0 = int(tri::Index(m, f.cV0(j)));
+				const int v1 = int(tri::Index(m, f.cV1(j)));
+				for (int k = f.IsB(j) ? 2 : 1; k > 0; --k)
+				{
+					a.neighbor[pos[v0]++] = v1;
+					a.neighbor[pos[v1]++] = v0;
+				}
+			}
+}
+
+void VertexSmoother::toArrays()
+{
+	const int vn = int(m.vert.size());
+	x.resize(vn); y.resize(vn); z.resize(vn);
+	nx.resize(vn); ny.resize(vn); nz.resize(vn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+	{
+		const Point3m& p = m.vert[i].cP();
+		x[i] = p[0]; y[i] = p[1]; z[i] = p[2];
+	}
+}
+
+void VertexSmoother::fromArrays()
+{
+	const int vn = int(m.vert.size());
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].P() = Point3m(x[i], y[i], z[i]);
+}
+
+// P = (P + sum) / (cnt + 1), the sum of a border vertex includes the vertex itself
+void VertexSmoother::laplacianStep(bool cotangentWeight, bool smoothSelected)
+{
+	const int vn = int(m.vert.size());
+	const Adjacency& a = laplacian;
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+	{
+		nx[i] = x[i]; ny[i] = y[i]; nz[i] = z[i];
+		const CVertexO& v = m.vert[i];
+		if (v.IsD() || (smoothSelected && !v.IsS()))
+			continue;
+		Scalarm sx = 0, sy = 0, sz = 0, cnt = 0;
+		if (a.border[i])
+		{
+			sx = x[i]; sy = y[i]; sz = z[i];
+			cnt = 1;
+		}
+		for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+		{
+			const int n = a.neighbor[k];
+			float w = 1.0f;
+			if (cotangentWeight && a.opposite[k] >= 0)
+			{
+				const int o = a.opposite[k];
+				const Point3m po(x[o], y[o], z[o]);
+				const Scalarm angle = Angle(Point3m(x[n], y[n], z[n]) - po, Point3m(x[i], y[i], z[i]) - po);
+				w = tan((M_PI * 0.5) - angle);
+			}
+			sx += x[n] * w; sy += y[n] * w; sz += z[n] * w;
+			cnt += w;
+		}
+		if (cnt > 0)
+		{
+			nx[i] = (x[i] + sx) / (cnt + 1);
+			ny[i] = (y[i] + sy) / (cnt + 1);
+			nz[i] = (z[i] + sz) / (cnt + 1);
+		}
+	}
+	x.swap(nx); y.swap(ny); z.swap(nz);
+}
+
+// P += (sum / cnt - P) * scale
+void VertexSmoother::umbrellaStep(float scale, bool smoothSelected)
+{
+	const int vn = int(m.vert.size());
+	const Adjacency& a = laplacian;
+	const Scalarm s = scale;
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+	{
+		nx[i] = x[i]; ny[i] = y[i]; nz[i] = z[i];
+		const CVertexO& v = m.vert[i];
+		if (v.IsD() || (smoothSelected && !v.IsS()))
+			continue;
+		Scalarm sx = 0, sy = 0, sz = 0, cnt = 0;
+		if (a.border[i])
+		{
+			sx = x[i]; sy = y[i]; sz = z[i];
+			cnt = 1;
+		}
+		for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+		{
+			const int n = a.neighbor[k];
+			sx += x[n]; sy += y[n]; sz += z[n];
+			cnt += 1;
+		}
+		if (cnt > 0)
+		{
+			nx[i] = x[i] + (sx / cnt - x[i]) * s;
+			ny[i] = y[i] + (sy / cnt - y[i]) * s;
+			nz[i] = z[i] + (sz / cnt - z[i]) * s;
+		}
+	}
+	x.swap(nx); y.swap(ny); z.swap(nz);
+}
+
+void VertexSmoother::coordLaplacian(int step, bool smoothSelected, bool cotangentWeight, CallBackPos* cb)
+{
+	if (laplacian.first.empty())
+		buildLaplacianAdjacency();
+	toArrays();
+	for (int i = 0; i < step; ++i)
+	{
+		if (cb) cb(100 * i / step, "Classic Laplacian Smoothing");
+		laplacianStep(cotangentWeight, smoothSelected);
+	}
+	fromArrays();
+}
+
+void VertexSmoother::coordTaubin(int step, float lambda, float mu, bool smoothSelected, CallBackPos* cb)
+{
+	if (laplacian.first.empty())
+		buildLaplacianAdjacency();
+	toArrays();
+	for (int i = 0; i < step; ++i)
+	{
+		if (cb) cb(100 * i / step, "Taubin Smoothing");
+		umbrellaStep(lambda, smoothSelected);
+		umbrellaStep(mu, smoothSelected);
+	}
+	fromArrays();
+}
+
+void VertexSmoother::coordLaplacianHC(int step, bool smoothSelected)
+{
+	if (hc.first.empty())
+		buildHCAdjacency();
+	toArrays();
+	const Adjacency& a = hc;
+	const Scalarm beta = 0.5;
+	const int vn = int(m.vert.size());
+	std::vector<Scalarm> rx(vn), ry(vn), rz(vn);
+	for (int s = 0; s < step; ++s)
+	{
+		// average of the neighbours (in nx, ny, nz)
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			Scalarm sx = 0, sy = 0, sz = 0;
+			for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+			{
+				const int n = a.neighbor[k];
+				sx += x[n]; sy += y[n]; sz += z[n];
+			}
+			const Scalarm cnt = Scalarm(float(a.first[i + 1] - a.first[i]));
+			if (cnt > 0)
+			{
+				nx[i] = sx / cnt; ny[i] = sy / cnt; nz[i] = sz / cnt;
+			}
+		}
+		// average difference of the neighbours, then the new position
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			rx[i] = x[i]; ry[i] = y[i]; rz[i] = z[i];
+			const Scalarm cnt = Scalarm(float(a.first[i + 1] - a.first[i]));
+			if (cnt == 0 || (smoothSelected && !m.vert[i].IsS()))
+				continue;
+			Scalarm dx = 0, dy = 0, dz = 0;
+			for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+			{
+				const int n = a.neighbor[k];
+				dx += nx[n] - x[n]; dy += ny[n] - y[n]; dz += nz[n] - z[n];
+			}
+			dx /= cnt; dy /= cnt; dz /= cnt;
+			rx[i] = nx[i] - (nx[i] - x[i]) * beta + dx * (1.f - beta);
+			ry[i] = ny[i] - (ny[i] - y[i]) * beta + dy * (1.f - beta);
+			rz[i] = nz[i] - (nz[i] - z[i]) * beta + dz * (1.f - beta);
+		}
+		x.swap(rx); y.swap(ry); z.swap(rz);
+	}
+	fromArrays();
+}
+
+// Q = sum / cnt, a border vertex is averaged with its border neighbours only (without itself)
+void VertexSmoother::qualityLaplacian(int step, bool smoothSelected)
+{
+	if (laplacian.first.empty())
+		buildLaplacianAdjacency();
+	const Adjacency& a = laplacian;
+	const int vn = int(m.vert.size());
+	std::vector<CVertexO::QualityType> q(vn), nq(vn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		q[i] = m.vert[i].cQ();
+	for (int s = 0; s < step; ++s)
+	{
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			nq[i] = q[i];
+			const CVertexO& v = m.vert[i];
+			const int cnt = int(a.first[i + 1] - a.first[i]);
+			if (v.IsD() || cnt == 0 || (smoothSelected && !v.IsS()))
+				continue;
+			Scalarm sum = 0;
+			for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+				sum += q[a.neighbor[k]];
+			nq[i] = sum / cnt;
+		}
+		q.swap(nq);
+	}
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].Q() = q[i];
+}
+
+// each channel is the (integer) average of the channel of the neighbours, as for the quality
+void VertexSmoother::colorLaplacian(int step, bool smoothSelected, CallBackPos* cb)
+{
+	if (laplacian.first.empty())
+		buildLaplacianAdjacency();
+	const Adjacency& a = laplacian;
+	const int vn = int(m.vert.size());
+	std::vector<Color4b> c(vn), nc(vn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		c[i] = m.vert[i].cC();
+	for (int s = 0; s < step; ++s)
+	{
+		if (cb) cb(100 * s / step, "Vertex Color Laplacian Smoothing");
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i)
+		{
+			nc[i] = c[i];
+			const CVertexO& v = m.vert[i];
+			const unsigned int cnt = (unsigned int)(a.first[i + 1] - a.first[i]);
+			if (v.IsD() || cnt == 0 || (smoothSelected && !v.IsS()))
+				continue;
+			unsigned int sum[4] = { 0, 0, 0, 0 };
+			for (size_t k = a.first[i]; k < a.first[i + 1]; ++k)
+			{
+				const Color4b& cn = c[a.neighbor[k]];
+				sum[0] += cn[0]; sum[1] += cn[1]; sum[2] += cn[2]; sum[3] += cn[3];
+			}
+			for (int ch = 0; ch < 4; ++ch)
+				nc[i][ch] = (unsigned char)(sum[ch] / cnt);
+		}
+		c.swap(nc);
+	}
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].C() = c[i];
+}
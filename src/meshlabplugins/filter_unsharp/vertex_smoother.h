@@ -0,0 +1,96 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_UNSHARP_VERTEX_SMOOTHER_H
+#define FILTER_UNSHARP_VERTEX_SMOOTHER_H
+
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+VertexSmoother
+Parallel versions of the Laplacian smoothing routines of vcg::tri::Smooth used by the
+unsharp filters (VertexCoordLaplacian, VertexCoordTaubin, VertexCoordLaplacianHC,
+VertexQualityLaplacian and VertexColorLaplacian).
+
+The vcg routines scatter, at every iteration, the contribution of each face edge in
+per vertex temporary data. Here the neighbours of each vertex are gathered once in a
+compact (CSR) adjacency, with one entry for each face edge that contributes to the vertex;
+the iterations then read the coordinates from plain x/y/z arrays and compute all
+the vertices in parallel, each one from its own entries only.
+
+The entries of a vertex are stored in the order of the faces, i.e. in the same order
+in which the vcg routines accumulate them, so the sums (and the results) are the same.
+The border flags of the faces must be up to date, as for the vcg routines. Meshes with
+edges are not supported (supports() is false): use the vcg routines for them.
+*/
+class VertexSmoother
+{
+public:
+	VertexSmoother(CMeshO& m);
+
+	static bool supports(const CMeshO& m);
+
+	// tri::Smooth<CMeshO>::VertexCoordLaplacian
+	void coordLaplacian(int step, bool smoothSelected = false, bool cotangentWeight = false, vcg::CallBackPos* cb = nullptr);
+
+	// tri::Smooth<CMeshO>::VertexCoordTaubin
+	void coordTaubin(int step, float lambda, float mu, bool smoothSelected = false, vcg::CallBackPos* cb = nullptr);
+
+	// tri::Smooth<CMeshO>::VertexCoordLaplacianHC
+	void coordLaplacianHC(int step, bool smoothSelected = false);
+
+	// tri::Smooth<CMeshO>::VertexQualityLaplacian
+	void qualityLaplacian(int step = 1, bool smoothSelected = false);
+
+	// tri::Smooth<CMeshO>::VertexColorLaplacian
+	void colorLaplacian(int step, bool smoothSelected = false, vcg::CallBackPos* cb = nullptr);
+
+private:
+	// the neighbours of vertex i are neighbor[first[i]] ... neighbor[first[i+1]-1]
+	struct Adjacency
+	{
+		std::vector<size_t> first;
+		std::vector<int> neighbor;
+		std::vector<int> opposite; // vertex opposite to the edge in its face (cotangent weights)
+		std::vector<char> border;  // the vertex is on a border edge
+	};
+
+	void buildLaplacianAdjacency();
+	void buildHCAdjacency();
+	void toArrays();
+	void fromArrays();
+	void laplacianStep(bool cotangentWeight, bool smoothSelected);
+	void umbrellaStep(float scale, bool smoothSelected);
+
+	CMeshO& m;
+	// interior vertices: the non border face edges; border vertices: the border edges only
+	Adjacency laplacian;
+	// every face edge, border edges twice
+	Adjacency hc;
+	std::vector<Scalarm> x, y, z;
+	std::vector<Scalarm> nx, ny, nz;
+};
+
+#endif // FILTER_UNSHARP_VERTEX_SMOOTHER_H
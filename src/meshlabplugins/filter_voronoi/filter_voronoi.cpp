@@ -22,6 +22,7 @@
 ****************************************************************************/
 
 #include "filter_voronoi.h"
+#include "parallel_voronoi.h"
 
 #include<vcg/complex/algorithms/voronoi_processing.h>
 #include<vcg/complex/algorithms/update/curvature.h>
@@ -31,6 +32,8 @@
 #include<vcg/complex/algorithms/voronoi_volume_sampling.h>
 #include<vcg/complex/algorithms/polygon_support.h>
 
+#include <common/ml_document/poisson_disk.h>
+
 using namespace vcg;
 
 FilterVoronoiPlugin::FilterVoronoiPlugin()
@@ -82,7 +85,7 @@ QString FilterVoronoiPlugin::filterInfo(FilterIDType filterId) const
 	case VOLUME_SAMPLING:
 		return "Compute a volumetric sampling over a watertight mesh.";
 	case VORONOI_SCAFFOLDING:
-		return "Compute a volumetric sampling over a watertight mesh.";
+		return "Compute a volumetric sampling over a watertight mesh and build a scaffolding from the Voronoi diagram of the relaxed samples.";
 	case BUILD_SHELL:
 		return "";
 	case CROSS_FIELD_CREATION:
@@ -309,7 +312,18 @@ bool FilterVoronoiPlugin::voronoiSampling(
 	vector<bool> fixedVec;
 	CMeshO::ScalarType radius=0;
 
-	tri::PoissonSampling<CMeshO>(m.cm,pointVec,sampleNum,radius,radiusVariance,0,randomSeed);
+	// the same pool and pruning by number of tri::PoissonSampling, on all the cores
+	CMeshO montecarloMesh;
+	PoissonDiskSampler::montecarlo(m.cm, montecarloMesh, std::max(10000, sampleNum*40), randomSeed);
+	PoissonDiskSampler::Params pdp;
+	pdp.adaptiveRadius = (radiusVariance != 1);
+	pdp.radiusVariance = radiusVariance;
+	pdp.randomSeed = randomSeed;
+	PoissonDiskSampler pds(montecarloMesh, pdp);
+	vector<int> poissonSamples;
+	radius = pds.pruneByNumber(sampleNum, 0, poissonSamples);
+	for(size_t i=0;i<poissonSamples.size();++i)
+		pointVec.push_back(montecarloMesh.vert[poissonSamples[i]].cP());
 
 	tri::VoronoiProcessingParameter vpp;
 	vpp.geodesicRelaxFlag = (relaxType==0);
@@ -327,7 +341,24 @@ bool FilterVoronoiPlugin::voronoiSampling(
 	QList<int> meshlist; meshlist << m.id();
 
 	// Uniform Euclidean Distance
-	if(distanceType==0)  {
+	if(distanceType==0 && relaxType!=2 && perturbProbability==0) {
+		// same steps of VoronoiRelaxing, with the regions grown and the seeds moved in parallel
+		vector<int> seedInd;
+		for(auto vi =seedVec.begin();vi!=seedVec.end();++vi)
+			seedInd.push_back(int(tri::Index(m.cm,*vi)));
+		ParallelVoronoiRelaxing pvr(m.cm);
+		pvr.relax(seedInd, iterNum, relaxType==0, cb);
+		if(pvr.writeRegions(seedInd, colorStrategy, vpp.deleteUnreachedRegionFlag) > 0) {
+			tri::UpdateTopology<CMeshO>::FaceFace(m.cm);
+			tri::UpdateTopology<CMeshO>::VertexFace(m.cm);
+		}
+		seedVec.clear();
+		for(size_t i=0;i<seedInd.size();++i)
+			seedVec.push_back(&m.cm.vert[seedInd[i]]);
+		om->updateDataMask(MeshModel::MM_FACEFACETOPO);
+		tri::VoronoiProcessing<CMeshO>::ConvertVoronoiDiagramToMesh(m.cm,om->cm,poly->cm,seedVec, vpp);
+	}
+	else if(distanceType==0)  {
 		EuclideanDistance<CMeshO> dd;
 		for(int i=0;i<iterNum;++i) {
 			cb(100*i/iterNum, "Relaxing...");
@@ -440,7 +471,7 @@ bool FilterVoronoiPlugin::voronoiScaffolding(
 	cb(10, "Sampling Surface...");
 
 	VoronoiVolumeSampling<CMeshO> vvs(m->cm);
-	VoronoiVolumeSampling<CMeshO>::Param par;
+	ParallelVoronoiScaffolding::Params par;
 
 	log("Sampling Surface at a radius %f ",sampleSurfRadius);
 	vvs.Init(sampleSurfRadius);
@@ -450,14 +481,22 @@ bool FilterVoronoiPlugin::voronoiScaffolding(
 	log("Base Poisson volume sampling at a radius %f ",poissonVolumeRadius);
 
 	cb(40, "Relaxing Volume...");
-	vvs.BarycentricRelaxVoronoiSamples(relaxStep);
+	vector<Point3m> seeds;
+	vector<bool> fixedSeeds;
+	for(auto vi=vvs.seedMesh.vert.begin();vi!=vvs.seedMesh.vert.end();++vi)
+		if(!vi->IsD()) {
+			seeds.push_back(vi->cP());
+			fixedSeeds.push_back(vi->IsS());
+		}
+	ParallelVoronoiScaffolding pvs(m->cm, seeds, fixedSeeds);
+	pvs.relax(vvs.montecarloVolumeMesh, relaxStep);
 
 	cb(50, "Building Scaffloding Volume...");
 	par.isoThr = isoThr;
 	par.surfFlag = surfFlag;
 	par.elemType = elemType;
 	par.voxelSide = voxelRes;
-	vvs.BuildScaffoldingMesh(sm->cm,par);
+	pvs.buildMesh(sm->cm,par);
 	cb(90, "Final Smoothing...");
 	tri::Smooth<CMeshO>::VertexCoordLaplacian(sm->cm, smoothStep);
 	sm->UpdateBoxAndNormals();
@@ -1,9 +1,11 @@
 include (../../shared.pri)
 
 HEADERS += \
-    filter_voronoi.h
+    filter_voronoi.h \
+    parallel_voronoi.h
 
 SOURCES += \
-    filter_voronoi.cpp
+    filter_voronoi.cpp \
+    parallel_voronoi.cpp
 		
 TARGET = filter_voronoi
@@ -0,0 +1,670 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "parallel_voronoi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <vcg/complex/algorithms/create/mc_trivial_walker.h>
+#include <vcg/complex/algorithms/update/color.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+
+#include <common/ml_document/mesh_ray_bvh.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef vcg::KdTree<Scalarm> SeedTree;
+
+// the k seeds nearest to p, sorted by squared distance
+int nearestSeeds(SeedTree& tree, SeedTree::PriorityQueue& queue, const Point3m& p, int k, std::pair<Scalarm, int>* found)
+{
+	tree.doQueryK(p, k, queue);
+	const int n = queue.getNofElements();
+	for (int j = 0; j < n; ++j)
+		found[j] = std::make_pair(queue.getWeight(j), int(queue.getIndex(j)));
+	std::sort(found, found + n);
+	return n;
+}
+
+/*
+Distance of p from the Voronoi element of the diagram of the seeds: the nearest seed, the
+bisector plane of the two nearest seeds (a face of the diagram) or the line equidistant
+from the three nearest seeds (an edge). The last two come from the squared distances of
+the seeds, with no square root of the large ones.
+*/
+Scalarm elementDistance(SeedTree& tree, SeedTree::PriorityQueue& queue, const std::vector<Point3m>& seed, const Point3m& p, int elemType)
+{
+	std::pair<Scalarm, int> found[3];
+	const int k = std::min(int(seed.size()), elemType == 0 ? 1 : (elemType == 1 ? 3 : 2));
+	const int n = nearestSeeds(tree, queue, p, k, found);
+	if (n < 2)
+		return std::sqrt(found[0].first);
+
+	const Point3d s0 = Point3d::Construct(seed[found[0].second]);
+	const Point3d n1 = Point3d::Construct(seed[found[1].second]) - s0;
+	const double n1n1 = n1.SquaredNorm();
+	if (n1n1 == 0)
+		return std::sqrt(found[0].first);
+	// residual of p in the equation of the bisector planes n_i * x = c_i
+	const double e1 = -0.5 * (double(found[1].first) - double(found[0].first));
+	if (n < 3)
+		return Scalarm(std::fabs(e1) / std::sqrt(n1n1));
+
+	const Point3d n2 = Point3d::Construct(seed[found[2].second]) - s0;
+	const double e2 = -0.5 * (double(found[2].first) - double(found[0].first));
+	const double n2n2 = n2.SquaredNorm();
+	const double n1n2 = n1 * n2;
+	const double det = n1n1 * n2n2 - n1n2 * n1n2;
+	if (det <= 1e-12 * n1n1 * n2n2)
+		return Scalarm(std::fabs(e1) / std::sqrt(n1n1));
+	// the nearest point of the line is p - a n1 - b n2
+	const double a = (e1 * n2n2 - e2 * n1n2) / det;
+	const double b = (e2 * n1n1 - e1 * n1n2) / det;
+	return Scalarm((n1 * a + n2 * b).Norm());
+}
+
+} // namespace
+
+/************************ ParallelVoronoiRelaxing ************************/
+
+ParallelVoronoiRelaxing::ParallelVoronoiRelaxing(CMeshO& m) :
+	m(m), delta(0), stampRound(0)
+{
+	buildGraph();
+}
+
+ParallelVoronoiRelaxing::Label ParallelVoronoiRelaxing::pack(float d, int source)
+{
+	//the distances are not negative, so their bits sort as the floats
+	unsigned int bits;
+	std::memcpy(&bits, &d, sizeof(bits));
+	return (Label(bits) << 32) | Label(unsigned(source));
+}
+
+float ParallelVoronoiRelaxing::labelDistance(Label l)
+{
+	const unsigned int bits = unsigned(l >> 32);
+	float d;
+	std::memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+void ParallelVoronoiRelaxing::buildGraph()
+{
+	const int vn = int(m.vert.size());
+	pos.resize(vn);
+	area.assign(vn, 0);
+#pragma omp parallel for
+	for (int v = 0; v < vn; ++v)
+		pos[v] = m.vert[v].cP();
+
+	std::vector<int> first(vn + 1, 0);
+	for (const CFaceO& f : m.face)
+	{
+		if (f.IsD())
+			continue;
+		const Scalarm a = DoubleArea(f) / 6;
+		for (int k = 0; k < 3; ++k)
+		{
+			const int v = int(tri::Index(m, f.cV(k)));
+			first[v + 1] += 2;
+			area[v] += a;
+		}
+	}
+	for (int v = 0; v < vn; ++v)
+		first[v + 1] += first[v];
+	std::vector<int> nb(first[vn]);
+	std::vector<int> next(first.begin(), first.end() - 1);
+	for (const CFaceO& f : m.face)
+	{
+		if (f.IsD())
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			const int v = int(tri::Index(m, f.cV(k)));
+			nb[next[v]++] = int(tri::Index(m, f.cV((k + 1) % 3)));
+			nb[next[v]++] = int(tri::Index(m, f.cV((k + 2) % 3)));
+		}
+	}
+
+	//each edge is found by the two faces around it
+	std::vector<int> deg(vn);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int v = 0; v < vn; ++v)
+	{
+		std::sort(nb.begin() + first[v], nb.begin() + first[v + 1]);
+		deg[v] = int(std::unique(nb.begin() + first[v], nb.begin() + first[v + 1]) - (nb.begin() + first[v]));
+	}
+	adjFirst.assign(vn + 1, 0);
+	for (int v = 0; v < vn; ++v)
+		adjFirst[v + 1] = adjFirst[v] + deg[v];
+	adj.resize(adjFirst[vn]);
+	double lenSum = 0;
+	for (int v = 0; v < vn; ++v)
+	{
+		std::copy(nb.begin() + first[v], nb.begin() + first[v] + deg[v], adj.begin() + adjFirst[v]);
+		for (int j = adjFirst[v]; j < adjFirst[v + 1]; ++j)
+			lenSum += Distance(pos[v], pos[adj[j]]);
+	}
+
+	//the width of the buckets of the delta stepping: a few edges
+	delta = adj.empty() ? Scalarm(1) : Scalarm(2 * lenSum / adj.size());
+
+	std::vector<std::atomic<Label>>(vn).swap(region);
+	std::vector<std::atomic<Label>>(vn).swap(border);
+	std::vector<std::atomic<int>>(vn).swap(stamp);
+	for (int v = 0; v < vn; ++v)
+		stamp[v].store(0, std::memory_order_relaxed);
+}
+
+/*
+Multi source shortest paths on the edges of the mesh, from the vertices in from (at distance
+0 from the sources fromSource). The vertices nearer than the threshold are relaxed in
+rounds, the ones that are improved beyond it wait in the far set; when no near vertex is
+left, the threshold moves delta beyond the nearest far one.
+*/
+void ParallelVoronoiRelaxing::grow(const std::vector<int>& from, const std::vector<int>& fromSource, std::vector<std::atomic<Label>>& label)
+{
+	const int vn = int(pos.size());
+#pragma omp parallel for
+	for (int v = 0; v < vn; ++v)
+		label[v].store(UNREACHED, std::memory_order_relaxed);
+
+	std::vector<int> nearSet;
+	std::vector<int> farSet;
+	++stampRound;
+	for (size_t i = 0; i < from.size(); ++i)
+	{
+		const int v = from[i];
+		const Label l = pack(0, fromSource[i]);
+		if (l < label[v].load(std::memory_order_relaxed))
+			label[v].store(l, std::memory_order_relaxed);
+		if (stamp[v].exchange(stampRound) != stampRound)
+			nearSet.push_back(v);
+	}
+
+	float threshold = float(delta);
+	while (!nearSet.empty())
+	{
+		++stampRound;
+		const int r = stampRound;
+		std::vector<int> nextNear;
+#pragma omp parallel
+		{
+			std::vector<int> localNear;
+			std::vector<int> localFar;
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < int(nearSet.size()); ++i)
+			{
+				const int v = nearSet[i];
+				const Label lv = label[v].load(std::memory_order_relaxed);
+				const float dv = labelDistance(lv);
+				const int s = labelSource(lv);
+				for (int j = adjFirst[v]; j < adjFirst[v + 1]; ++j)
+				{
+					const int w = adj[j];
+					const float dw = dv + float(Distance(pos[v], pos[w]));
+					const Label lw = pack(dw, s);
+					Label cur = label[w].load(std::memory_order_relaxed);
+					bool improved = false;
+					while (lw < cur && !improved)
+						improved = label[w].compare_exchange_weak(cur, lw, std::memory_order_relaxed);
+					if (!improved)
+						continue;
+					if (dw >= threshold)
+						localFar.push_back(w);
+					else if (stamp[w].exchange(r) != r)
+						localNear.push_back(w);
+				}
+			}
+#pragma omp critical
+			{
+				nextNear.insert(nextNear.end(), localNear.begin(), localNear.end());
+				farSet.insert(farSet.end(), localFar.begin(), localFar.end());
+			}
+		}
+		nearSet.swap(nextNear);
+		if (!nearSet.empty() || farSet.empty())
+			continue;
+
+		//next bucket: the far vertices (the ones not improved since they were queued) nearer
+		//than delta beyond the nearest of them
+		float minFar = std::numeric_limits<float>::max();
+		for (int v : farSet)
+			minFar = std::min(minFar, labelDistance(label[v].load(std::memory_order_relaxed)));
+		threshold = minFar + float(delta);
+		++stampRound;
+		const int fr = stampRound;
+		std::vector<int> keep;
+#pragma omp parallel
+		{
+			std::vector<int> localNear;
+			std::vector<int> localKeep;
+#pragma omp for schedule(static)
+			for (int i = 0; i < int(farSet.size()); ++i)
+			{
+				const int v = farSet[i];
+				if (labelDistance(label[v].load(std::memory_order_relaxed)) >= threshold)
+					localKeep.push_back(v);
+				else if (stamp[v].exchange(fr) != fr)
+					localNear.push_back(v);
+			}
+#pragma omp critical
+			{
+				nearSet.insert(nearSet.end(), localNear.begin(), localNear.end());
+				keep.insert(keep.end(), localKeep.begin(), localKeep.end());
+			}
+		}
+		farSet.swap(keep);
+	}
+}
+
+// counting sort of the reached vertices on their region, in index order inside each region
+void ParallelVoronoiRelaxing::sortByRegion(int regionNum)
+{
+	const int vn = int(pos.size());
+	regionFirst.assign(regionNum + 1, 0);
+	for (int v = 0; v < vn; ++v)
+	{
+		const Label l = region[v].load(std::memory_order_relaxed);
+		if (l != UNREACHED)
+			++regionFirst[labelSource(l) + 1];
+	}
+	for (int r = 0; r < regionNum; ++r)
+		regionFirst[r + 1] += regionFirst[r];
+	regionVert.resize(regionFirst[regionNum]);
+	std::vector<int> next(regionFirst.begin(), regionFirst.end() - 1);
+	for (int v = 0; v < vn; ++v)
+	{
+		const Label l = region[v].load(std::memory_order_relaxed);
+		if (l != UNREACHED)
+			regionVert[next[labelSource(l)]++] = v;
+	}
+}
+
+// distance of each vertex from the border of the regions: the vertices with a neighbour in another region
+void ParallelVoronoiRelaxing::borderDistance()
+{
+	const int vn = int(pos.size());
+	std::vector<int> from;
+	std::vector<int> fromSource;
+#pragma omp parallel
+	{
+		std::vector<int> local;
+#pragma omp for schedule(dynamic, 1024)
+		for (int v = 0; v < vn; ++v)
+		{
+			const Label l = region[v].load(std::memory_order_relaxed);
+			if (l == UNREACHED)
+				continue;
+			for (int j = adjFirst[v]; j < adjFirst[v + 1]; ++j)
+			{
+				const Label ln = region[adj[j]].load(std::memory_order_relaxed);
+				if (ln == UNREACHED || labelSource(ln) != labelSource(l))
+				{
+					local.push_back(v);
+					break;
+				}
+			}
+		}
+#pragma omp critical
+		from.insert(from.end(), local.begin(), local.end());
+	}
+	fromSource.resize(from.size());
+	for (size_t i = 0; i < from.size(); ++i)
+		fromSource[i] = labelSource(region[from[i]].load(std::memory_order_relaxed));
+	grow(from, fromSource, border);
+}
+
+int ParallelVoronoiRelaxing::relax(std::vector<int>& seeds, int iterNum, bool geodesicRelax, vcg::CallBackPos* cb)
+{
+	std::vector<char> used(pos.size(), 0);
+	std::vector<int> unique;
+	for (int s : seeds)
+	{
+		if (!used[s])
+			unique.push_back(s);
+		used[s] = 1;
+	}
+	seeds.swap(unique);
+
+	const int sn = int(seeds.size());
+	std::vector<int> source(sn);
+	for (int i = 0; i < sn; ++i)
+		source[i] = i;
+	grow(seeds, source, region);
+
+	int it = 0;
+	for (; it < iterNum; ++it)
+	{
+		if (cb)
+			cb(100 * it / iterNum, "Relaxing...");
+		sortByRegion(sn);
+		if (geodesicRelax)
+			borderDistance();
+
+		std::vector<int> next(sn);
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int r = 0; r < sn; ++r)
+		{
+			const int first = regionFirst[r];
+			const int last = regionFirst[r + 1];
+			int best = seeds[r];
+			if (geodesicRelax)
+			{
+				//a region with no border (a whole connected component) keeps its seed
+				float bestDist = -1;
+				for (int i = first; i < last; ++i)
+				{
+					const int v = regionVert[i];
+					const Label l = border[v].load(std::memory_order_relaxed);
+					if (l != UNREACHED && labelDistance(l) > bestDist)
+					{
+						bestDist = labelDistance(l);
+						best = v;
+					}
+				}
+			}
+			else if (first < last)
+			{
+				Point3d centroid(0, 0, 0);
+				double weight = 0;
+				for (int i = first; i < last; ++i)
+				{
+					const int v = regionVert[i];
+					centroid += Point3d::Construct(pos[v]) * double(area[v]);
+					weight += area[v];
+				}
+				if (weight > 0)
+				{
+					centroid /= weight;
+					double bestDist = std::numeric_limits<double>::max();
+					for (int i = first; i < last; ++i)
+					{
+						const int v = regionVert[i];
+						const double d = SquaredDistance(Point3d::Construct(pos[v]), centroid);
+						if (d < bestDist)
+						{
+							bestDist = d;
+							best = v;
+						}
+					}
+				}
+			}
+			next[r] = best;
+		}
+
+		if (next == seeds)
+			break;
+		seeds.swap(next);
+		grow(seeds, source, region);
+	}
+	return it;
+}
+
+int ParallelVoronoiRelaxing::writeRegions(const std::vector<int>& seeds, int colorStrategy, bool deleteUnreached)
+{
+	const int vn = int(pos.size());
+	CMeshO::PerVertexAttributeHandle<CMeshO::VertexPointer> sources =
+			tri::Allocator<CMeshO>::GetPerVertexAttribute<CMeshO::VertexPointer>(m, "sources");
+
+	if (colorStrategy == 2)
+		borderDistance();
+	std::vector<Scalarm> regionArea;
+	if (colorStrategy == 3)
+	{
+		const int sn = int(seeds.size());
+		sortByRegion(sn);
+		regionArea.assign(sn, 0);
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int r = 0; r < sn; ++r)
+		{
+			double a = 0;
+			for (int i = regionFirst[r]; i < regionFirst[r + 1]; ++i)
+				a += area[regionVert[i]];
+			regionArea[r] = Scalarm(a);
+		}
+	}
+
+#pragma omp parallel for
+	for (int v = 0; v < vn; ++v)
+	{
+		if (m.vert[v].IsD())
+			continue;
+		const Label l = region[v].load(std::memory_order_relaxed);
+		if (l == UNREACHED)
+		{
+			sources[v] = nullptr;
+			m.vert[v].Q() = 0;
+			continue;
+		}
+		sources[v] = &m.vert[seeds[labelSource(l)]];
+		m.vert[v].Q() = labelDistance(l);
+		if (colorStrategy == 2)
+		{
+			const Label b = border[v].load(std::memory_order_relaxed);
+			m.vert[v].Q() = (b == UNREACHED) ? 0 : labelDistance(b);
+		}
+		else if (colorStrategy == 3)
+			m.vert[v].Q() = regionArea[labelSource(l)];
+	}
+	if (colorStrategy != 0)
+		tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m);
+
+	if (!deleteUnreached)
+		return 0;
+	int deleted = 0;
+	for (CMeshO::FaceIterator fi = m.face.begin(); fi != m.face.end(); ++fi)
+	{
+		if (fi->IsD())
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (region[tri::Index(m, fi->V(k))].load(std::memory_order_relaxed) == UNREACHED)
+			{
+				tri::Allocator<CMeshO>::DeleteFace(m, *fi);
+				break;
+			}
+		}
+	}
+	for (int v = 0; v < vn; ++v)
+	{
+		if (!m.vert[v].IsD() && region[v].load(std::memory_order_relaxed) == UNREACHED)
+		{
+			tri::Allocator<CMeshO>::DeleteVertex(m, m.vert[v]);
+			++deleted;
+		}
+	}
+	return deleted;
+}
+
+/************************ ParallelVoronoiScaffolding ************************/
+
+ParallelVoronoiScaffolding::ParallelVoronoiScaffolding(const CMeshO& surface, const std::vector<Point3m>& seeds, const std::vector<bool>& fixed) :
+	surface(surface), seed(seeds), fixed(fixed)
+{
+}
+
+int ParallelVoronoiScaffolding::relax(CMeshO& samples, int relaxStep)
+{
+	const int n = int(samples.vert.size());
+	std::vector<int> nearest(n, -1);
+	int it = 0;
+	for (; it < relaxStep && !seed.empty(); ++it)
+	{
+		const int sn = int(seed.size());
+		ConstDataWrapper<Point3m> wrapper(seed.data(), sn);
+		SeedTree tree(wrapper);
+
+		//the kd-tree is only read by the queries, each thread owns its priority queue
+#pragma omp parallel
+		{
+			SeedTree::PriorityQueue queue;
+			std::pair<Scalarm, int> found[1];
+#pragma omp for schedule(dynamic, 1024)
+			for (int i = 0; i < n; ++i)
+			{
+				if (samples.vert[i].IsD())
+					continue;
+				nearestSeeds(tree, queue, samples.vert[i].cP(), 1, found);
+				nearest[i] = found[0].second;
+				samples.vert[i].Q() = std::sqrt(found[0].first);
+			}
+		}
+
+		//the samples of each cell, in index order, so that the sums do not depend on the threads
+		std::vector<int> first(sn + 1, 0);
+		for (int i = 0; i < n; ++i)
+			if (!samples.vert[i].IsD())
+				++first[nearest[i] + 1];
+		for (int s = 0; s < sn; ++s)
+			first[s + 1] += first[s];
+		std::vector<int> cell(first[sn]);
+		std::vector<int> next(first.begin(), first.end() - 1);
+		for (int i = 0; i < n; ++i)
+			if (!samples.vert[i].IsD())
+				cell[next[nearest[i]]++] = i;
+
+		std::vector<Point3m> centroid(sn);
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int s = 0; s < sn; ++s)
+		{
+			Point3d sum(0, 0, 0);
+			for (int j = first[s]; j < first[s + 1]; ++j)
+				sum += Point3d::Construct(samples.vert[cell[j]].cP());
+			const int count = first[s + 1] - first[s];
+			centroid[s] = (fixed[s] || count == 0) ? seed[s] : Point3m::Construct(sum / double(count));
+		}
+
+		//the seeds with an empty cell are removed
+		bool changed = false;
+		std::vector<Point3m> newSeed;
+		std::vector<bool> newFixed;
+		for (int s = 0; s < sn; ++s)
+		{
+			if (first[s + 1] == first[s])
+			{
+				changed = true;
+				continue;
+			}
+			changed = changed || (centroid[s] != seed[s]);
+			newSeed.push_back(centroid[s]);
+			newFixed.push_back(fixed[s]);
+		}
+		seed.swap(newSeed);
+		fixed.swap(newFixed);
+		if (!changed)
+			break;
+	}
+	return it;
+}
+
+void ParallelVoronoiScaffolding::buildMesh(CMeshO& out, const Params& par, vcg::CallBackPos* cb)
+{
+	out.Clear();
+	if (seed.empty() || surface.fn == 0)
+		return;
+
+	if (cb)
+		cb(0, "Building the distance field");
+	MeshRayBVH bvh(surface);
+	const int sn = int(seed.size());
+	ConstDataWrapper<Point3m> wrapper(seed.data(), sn);
+	SeedTree tree(wrapper);
+
+	const Scalarm voxel = surface.bbox.MaxDim() / std::max(1, par.voxelSide);
+	const Scalarm thick = par.isoThr * voxel;
+	Box3m bb = surface.bbox;
+	bb.Offset(thick + 2 * voxel);
+	Point3i siz;
+	for (int k = 0; k < 3; ++k)
+	{
+		siz[k] = int(std::ceil(bb.Dim()[k] / voxel)) + 1;
+		bb.max[k] = bb.min[k] + siz[k] * voxel;
+	}
+	SimpleVolume<SimpleVoxel<Scalarm> > volume;
+	volume.Init(siz, bb);
+	const Scalarm farDist = bb.Diag();
+
+	const int bx = (siz[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const int by = (siz[1] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const int bz = (siz[2] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	for (int z = 0; z < bz; ++z)
+	{
+		if (cb)
+			cb(90 * z / bz, "Building the distance field");
+		//the blocks of a layer are filled in parallel, each voxel is written by one thread
+#pragma omp parallel
+		{
+			SeedTree::PriorityQueue queue;
+#pragma omp for schedule(dynamic, 1)
+			for (int b = 0; b < bx * by; ++b)
+			{
+				const int i0 = (b % bx) * BLOCK_SIZE;
+				const int j0 = (b / bx) * BLOCK_SIZE;
+				const int k0 = z * BLOCK_SIZE;
+				for (int k = k0; k < std::min(siz[2], k0 + BLOCK_SIZE); ++k)
+					for (int j = j0; j < std::min(siz[1], j0 + BLOCK_SIZE); ++j)
+						for (int i = i0; i < std::min(siz[0], i0 + BLOCK_SIZE); ++i)
+						{
+							const Point3m p = bb.min + Point3m(Scalarm(i), Scalarm(j), Scalarm(k)) * voxel;
+
+							//signed distance from the surface, negative inside
+							Scalarm surf = farDist;
+							Point3m closest;
+							int f;
+							if (bvh.closestPoint(p, farDist, closest, f))
+							{
+								const CFaceO& face = surface.face[f];
+								const Point3m n = (face.cP(1) - face.cP(0)) ^ (face.cP(2) - face.cP(0));
+								surf = Distance(p, closest);
+								if ((closest - p) * n > 0)
+									surf = -surf;
+							}
+
+							const Scalarm elem = elementDistance(tree, queue, seed, p, par.elemType) - thick;
+							Scalarm val;
+							if (par.surfFlag)
+								val = std::max(std::min(elem, -surf - thick), surf);
+							else
+								val = std::max(elem, surf);
+							volume.Val(i, j, k) = val;
+						}
+			}
+		}
+	}
+
+	if (cb)
+		cb(90, "Marching cubes");
+	typedef tri::TrivialWalker<CMeshO, SimpleVolume<SimpleVoxel<Scalarm> > > MyWalker;
+	typedef tri::MarchingCubes<CMeshO, MyWalker> MyMarchingCubes;
+	MyWalker walker;
+	MyMarchingCubes mc(out, walker);
+	walker.BuildMesh<MyMarchingCubes>(out, volume, mc, 0);
+}
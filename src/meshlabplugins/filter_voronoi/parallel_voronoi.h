@@ -0,0 +1,140 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_VORONOI_PARALLEL_VORONOI_H
+#define FILTER_VORONOI_PARALLEL_VORONOI_H
+
+#include <atomic>
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+ParallelVoronoiRelaxing
+The Lloyd relaxation of a Voronoi partition of the vertices of a mesh, with the euclidean
+length of the edges as distance (the same steps of vcg::tri::VoronoiProcessing::VoronoiRelaxing
+with EuclideanDistance), run by many threads.
+
+The regions are grown from all the seeds at once with a near-far delta stepping: the
+vertices whose distance is below the current threshold are relaxed in parallel, each one
+updating the label (distance and seed packed in 64 bits, so that an atomic min settles the
+ties on the seed index) of its neighbours, until none is left; then the threshold moves on.
+The result does not depend on the number of threads or on the order of the updates.
+The new seed of each region is then found in parallel over the regions: the vertex nearest
+to the area weighted centroid of the region (the minimum of the sum of the squared
+distances, as the quadric relax does) or, with the geodesic relax, the vertex farthest from
+the border of the region.
+*/
+class ParallelVoronoiRelaxing
+{
+public:
+	ParallelVoronoiRelaxing(CMeshO& m);
+
+	// at most iterNum relaxation steps of the seeds (indices in m.vert; the duplicates are
+	// removed), stopping when they do not move; returns the number of steps done
+	int relax(std::vector<int>& seeds, int iterNum, bool geodesicRelax, vcg::CallBackPos* cb = nullptr);
+
+	// writes the regions of the last relaxation in the mesh: the "sources" per vertex
+	// attribute, the distance from the seed in the vertex quality (the distance from the
+	// border or the area of the region with those color strategies) and the colors of the
+	// colorStrategy of vcg::tri::VoronoiProcessingParameter; with deleteUnreached the vertices
+	// not reached by any seed are deleted, with their faces. Returns the deleted vertices.
+	int writeRegions(const std::vector<int>& seeds, int colorStrategy, bool deleteUnreached);
+
+private:
+	typedef unsigned long long Label;
+	static const Label UNREACHED = ~Label(0);
+
+	static Label pack(float d, int source);
+	static float labelDistance(Label l);
+	static int labelSource(Label l) { return int(l & 0xffffffffu); }
+
+	void buildGraph();
+	void grow(const std::vector<int>& from, const std::vector<int>& fromSource, std::vector<std::atomic<Label>>& label);
+	void sortByRegion(int regionNum);
+	void borderDistance();
+
+	CMeshO& m;
+	Scalarm delta;
+	std::vector<Point3m> pos;
+	std::vector<Scalarm> area;   // a third of the area of the faces around each vertex
+
+	// the neighbours of vertex v are adj[adjFirst[v]] ... adj[adjFirst[v+1]-1]
+	std::vector<int> adjFirst;
+	std::vector<int> adj;
+
+	std::vector<std::atomic<Label>> region;   // seed of each vertex and distance from it
+	std::vector<std::atomic<Label>> border;   // distance from the border of the region
+	std::vector<std::atomic<int>> stamp;      // dedup of the frontiers: last round that queued the vertex
+	int stampRound;
+
+	// the vertices of region r are regionVert[regionFirst[r]] ... regionVert[regionFirst[r+1]-1]
+	std::vector<int> regionFirst;
+	std::vector<int> regionVert;
+};
+
+/*
+ParallelVoronoiScaffolding
+The Voronoi scaffolding of a watertight mesh (as vcg::tri::VoronoiVolumeSampling builds it)
+from a set of seeds inside the volume: the seeds are relaxed toward the centroid of their
+cell, evaluated on the montecarlo samples of the volume, then the struts (the seeds, the
+edges or the faces of the Voronoi diagram) thickened by isoThr voxels and clipped by the
+mesh, optionally with a shell along its surface, are extracted with the marching cubes.
+
+The nearest seeds of each sample and of each voxel are found with a kd-tree, each thread
+with its own queue, and the signed distance from the surface with a MeshRayBVH (no marks
+shared among the queries, unlike the vcg grids); the distance field is computed in
+parallel blocks of voxels.
+*/
+class ParallelVoronoiScaffolding
+{
+public:
+	struct Params
+	{
+		Scalarm isoThr;   // half width of the struts, in voxels
+		bool surfFlag;    // adds a shell of the same width along the surface
+		int elemType;     // 0 seeds, 1 edges, 2 faces of the Voronoi diagram
+		int voxelSide;    // voxels along the largest side of the bounding box
+	};
+
+	// the seeds with fixed[i] set do not move
+	ParallelVoronoiScaffolding(const CMeshO& surface, const std::vector<Point3m>& seeds, const std::vector<bool>& fixed);
+
+	// at most relaxStep Lloyd steps, stopping when the seeds do not move; the seeds with an
+	// empty cell are removed. The quality of the samples is their distance from the nearest
+	// seed. Returns the number of steps done.
+	int relax(CMeshO& samples, int relaxStep);
+
+	void buildMesh(CMeshO& out, const Params& par, vcg::CallBackPos* cb = nullptr);
+
+	const std::vector<Point3m>& seeds() const { return seed; }
+
+private:
+	static const int BLOCK_SIZE = 8;
+
+	const CMeshO& surface;
+	std::vector<Point3m> seed;
+	std::vector<bool> fixed;
+};
+
+#endif // FILTER_VORONOI_PARALLEL_VORONOI_H
@@ -0,0 +1,1028 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "collada_stream_importer.h"
+
+#include <climits>
+
+#include <QFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+
+#include <common/utilities/ascii_chunk_reader.h>
+#include <wrap/io_trimesh/io_mask.h>
+
+namespace {
+
+// depth of the scene graph after which instance_node references are considered a loop
+const int MAX_NODE_DEPTH = 256;
+
+inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline void parseNumber(const char* begin, const char* end, Scalarm& v)
+{
+	double d;
+	AsciiChunkReader::toDouble(begin, end, d);
+	v = Scalarm(d);
+}
+
+inline void parseNumber(const char* begin, const char* end, int& v)
+{
+	const char* p = begin;
+	const bool negative = (p < end && *p == '-');
+	if (p < end && (*p == '-' || *p == '+'))
+		++p;
+	int n = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+		n = n * 10 + (*p - '0');
+	// like QString::toInt(), malformed numbers are 0
+	v = (p == end) ? (negative ? -n : n) : 0;
+}
+
+template <class T>
+void parseNumbers(const char* begin, const char* end, std::vector<T>& values)
+{
+	const char* p = begin;
+	while (p < end)
+	{
+		while (p < end && isSpace(*p))
+			++p;
+		const char* s = p;
+		while (p < end && !isSpace(*p))
+			++p;
+		if (p > s)
+		{
+			T v;
+			parseNumber(s, p, v);
+			values.push_back(v);
+		}
+	}
+}
+
+// appends the numbers of the text of the current element; QXmlStreamReader may deliver it in several pieces,
+// so the last (maybe incomplete) number of each piece is kept for the next one
+template <class T>
+void readNumbers(QXmlStreamReader& xml, std::vector<T>& values)
+{
+	QByteArray pending;
+	while (!xml.atEnd())
+	{
+		xml.readNext();
+		if (xml.isCharacters())
+		{
+			pending += xml.text().toLatin1();
+			const char* begin = pending.constData();
+			const char* last = begin + pending.size();
+			while (last > begin && !isSpace(last[-1]))
+				--last;
+			parseNumbers(begin, last, values);
+			pending.remove(0, int(last - begin));
+		}
+		else if (xml.isStartElement())
+			xml.skipCurrentElement();
+		else if (xml.isEndElement())
+			break;
+	}
+	parseNumbers(pending.constData(), pending.constData() + pending.size(), values);
+}
+
+// the text of the current element and of its children
+QString readText(QXmlStreamReader& xml)
+{
+	QString text;
+	int depth = 1;
+	while (depth > 0 && !xml.atEnd())
+	{
+		xml.readNext();
+		if (xml.isStartElement())
+			++depth;
+		else if (xml.isEndElement())
+			--depth;
+		else if (xml.isCharacters())
+			text += xml.text();
+	}
+	return text.trimmed();
+}
+
+inline QString attribute(const QXmlStreamReader& xml, const char* name)
+{
+	return xml.attributes().value(QLatin1String(name)).toString();
+}
+
+// the id referenced by an url attribute ("#id")
+inline QString urlId(const QString& url)
+{
+	return url.startsWith('#') ? url.mid(1) : url;
+}
+
+inline bool is(const QXmlStreamReader& xml, const char* name)
+{
+	return xml.name() == QLatin1String(name);
+}
+
+template <class T>
+inline int findIndex(const std::map<QString, T>& map, const QString& key, int notFound = -1)
+{
+	typename std::map<QString, T>::const_iterator it = map.find(key);
+	return (it != map.end()) ? int(it->second) : notFound;
+}
+
+}
+
+ColladaStreamImporter::ColladaStreamImporter() : vertNum(0), faceNum(0), loadMask(0)
+{
+}
+
+QString ColladaStreamImporter::errorMsg(int error)
+{
+	switch (error)
+	{
+	case E_NOERROR: return "No error";
+	case E_CANTOPEN: return "Can't open file";
+	case E_INVALIDXML: return "Invalid XML";
+	case E_INVALIDFILE: return "Invalid COLLADA file";
+	case E_UNSUPPORTED: return "COLLADA content not supported by the streaming importer";
+	}
+	return "Unknown error";
+}
+
+bool ColladaStreamImporter::geometryIds(const QString& fileName, QStringList& ids)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	QXmlStreamReader xml(&file);
+	while (!xml.atEnd())
+	{
+		xml.readNext();
+		if (!xml.isStartElement())
+			continue;
+		if (is(xml, "geometry"))
+			ids.push_back(attribute(xml, "id"));
+		else if (is(xml, "float_array") || is(xml, "p"))
+			xml.skipCurrentElement();
+	}
+	return !xml.hasError();
+}
+
+int ColladaStreamImporter::load(const QString& fileName, vcg::CallBackPos* cb)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return E_CANTOPEN;
+	const double fileSize = double(std::max<qint64>(file.size(), 1));
+
+	QXmlStreamReader xml(&file);
+	int result = E_NOERROR;
+	while (result == E_NOERROR && !xml.atEnd())
+	{
+		xml.readNext();
+		if (!xml.isStartElement() || is(xml, "COLLADA"))
+			continue;
+		if (is(xml, "library_images"))
+			result = readImages(xml);
+		else if (is(xml, "library_effects"))
+			result = readEffects(xml);
+		else if (is(xml, "library_materials"))
+			result = readMaterials(xml);
+		else if (is(xml, "library_geometries"))
+			result = readGeometries(xml, cb);
+		else if (is(xml, "library_nodes"))
+		{
+			while (result == E_NOERROR && xml.readNextStartElement())
+			{
+				int index;
+				if (is(xml, "node"))
+					result = readNode(xml, index);
+				else
+					xml.skipCurrentElement();
+			}
+		}
+		else if (is(xml, "library_visual_scenes"))
+			result = readVisualScenes(xml);
+		else if (is(xml, "scene"))
+			result = readScene(xml);
+		else
+			xml.skipCurrentElement();
+		if (cb)
+			cb(int(50 * double(file.pos()) / fileSize), "Reading COLLADA document");
+	}
+	if (xml.hasError())
+		return E_INVALIDXML;
+	if (result != E_NOERROR)
+		return result;
+
+	//the sources are complete: the primitives can be checked and counted
+	std::vector<int> geometryResult(geometries.size(), E_NOERROR);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(geometries.size()); ++i)
+		geometryResult[i] = resolveGeometry(geometries[i]);
+	for (int r : geometryResult)
+		if (r != E_NOERROR)
+			return r;
+
+	//flatten the scene
+	const QString scene = sceneUrl.isEmpty() ? firstVisualScene : sceneUrl;
+	std::map<QString, std::vector<int> >::const_iterator sceneIt = visualScenes.find(scene);
+	if (sceneIt != visualScenes.end())
+	{
+		vcg::Matrix44d identity;
+		identity.SetIdentity();
+		for (int root : sceneIt->second)
+			if (!collectInstances(root, identity, 0))
+				return E_INVALIDFILE;
+	}
+	//nothing to place: leave the decision to the DOM importer
+	if (instances.empty())
+		return E_UNSUPPORTED;
+
+	bool hasNormal = true;
+	bool hasColor = false;
+	bool hasTexCoord = false;
+	std::vector<char> placed(geometries.size(), 0);
+	for (const Instance& inst : instances)
+	{
+		const Geometry& g = geometries[inst.geometry];
+		placed[inst.geometry] = 1;
+		for (const Primitive& pr : g.primitives)
+		{
+			if (pr.faceNum == 0)
+				continue;
+			hasNormal = hasNormal && (pr.normal.source >= 0);
+			hasColor = hasColor || (pr.color.source >= 0);
+			hasTexCoord = hasTexCoord || (pr.texCoord.source >= 0);
+		}
+	}
+	loadMask = vcg::tri::io::Mask::IOM_VERTCOORD | vcg::tri::io::Mask::IOM_FACEINDEX;
+	//normals are used only if every face has them, otherwise they are computed as usual
+	if (hasNormal && faceNum > 0)
+		loadMask |= vcg::tri::io::Mask::IOM_VERTNORMAL;
+	if (hasColor)
+		loadMask |= vcg::tri::io::Mask::IOM_VERTCOLOR;
+	if (hasTexCoord)
+		loadMask |= vcg::tri::io::Mask::IOM_WEDGTEXCOORD;
+
+	//the vertices of each geometry depend on the attributes that are loaded
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(geometries.size()); ++i)
+		if (placed[i])
+			splitVertices(geometries[i]);
+	for (Instance& inst : instances)
+	{
+		const Geometry& g = geometries[inst.geometry];
+		inst.vertBase = vertNum;
+		inst.faceBase = faceNum;
+		vertNum += g.vertex.size();
+		faceNum += g.faceNum;
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readImages(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement())
+	{
+		if (!is(xml, "image"))
+		{
+			xml.skipCurrentElement();
+			continue;
+		}
+		const QString id = attribute(xml, "id");
+		while (xml.readNextStartElement())
+		{
+			//COLLADA 1.4: <init_from>file</init_from>, 1.5: <init_from><ref>file</ref></init_from>
+			if (is(xml, "init_from"))
+			{
+				QString path = readText(xml);
+				if (path.startsWith("file:"))
+					path = QUrl(path).toLocalFile();
+				images[id] = path;
+			}
+			else
+				xml.skipCurrentElement();
+		}
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readEffects(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement())
+	{
+		if (!is(xml, "effect"))
+		{
+			xml.skipCurrentElement();
+			continue;
+		}
+		const QString id = attribute(xml, "id");
+		//the diffuse texture refers to a sampler, that refers to a surface (1.4) or an image (1.5)
+		std::map<QString, QString> surfaces, samplers;
+		QString param, texture;
+		QStringList path;
+		int depth = 1;
+		while (depth > 0 && !xml.atEnd())
+		{
+			xml.readNext();
+			if (xml.isEndElement())
+			{
+				if (--depth > 0)
+					path.pop_back();
+				continue;
+			}
+			if (!xml.isStartElement())
+				continue;
+			const QString parent = path.isEmpty() ? QString() : path.back();
+			if (is(xml, "newparam"))
+				param = attribute(xml, "sid");
+			else if (is(xml, "texture") && path.contains("diffuse") && texture.isEmpty())
+				texture = attribute(xml, "texture");
+			else if (is(xml, "instance_image") && parent == "sampler2D")
+				samplers[param] = urlId(attribute(xml, "url"));
+			else if ((is(xml, "init_from") && parent == "surface") || (is(xml, "source") && parent == "sampler2D"))
+			{
+				std::map<QString, QString>& refs = is(xml, "init_from") ? surfaces : samplers;
+				refs[param] = readText(xml);
+				continue;
+			}
+			++depth;
+			path.push_back(xml.name().toString());
+		}
+		QString image = texture;
+		if (samplers.count(image) > 0)
+			image = samplers[image];
+		if (surfaces.count(image) > 0)
+			image = surfaces[image];
+		if (!image.isEmpty())
+			effectImages[id] = image;
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readMaterials(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement())
+	{
+		if (!is(xml, "material"))
+		{
+			xml.skipCurrentElement();
+			continue;
+		}
+		const QString id = attribute(xml, "id");
+		while (xml.readNextStartElement())
+		{
+			if (is(xml, "instance_effect"))
+				materialEffects[id] = urlId(attribute(xml, "url"));
+			xml.skipCurrentElement();
+		}
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readGeometries(QXmlStreamReader& xml, vcg::CallBackPos* cb)
+{
+	const double fileSize = double(std::max<qint64>(xml.device()->size(), 1));
+	while (xml.readNextStartElement())
+	{
+		if (!is(xml, "geometry"))
+		{
+			xml.skipCurrentElement();
+			continue;
+		}
+		Geometry geometry;
+		geometry.id = attribute(xml, "id");
+		bool isMesh = false;
+		while (xml.readNextStartElement())
+		{
+			if (is(xml, "mesh"))
+			{
+				isMesh = true;
+				int result = readMesh(xml, geometry);
+				if (result != E_NOERROR)
+					return result;
+			}
+			else
+				xml.skipCurrentElement();
+		}
+		//convex_mesh, spline and brep geometries are ignored
+		if (isMesh)
+		{
+			geometryIndex[geometry.id] = int(geometries.size());
+			geometries.push_back(Geometry());
+			std::swap(geometries.back(), geometry);
+		}
+		if (cb)
+			cb(int(50 * double(xml.device()->pos()) / fileSize), "Reading COLLADA geometries");
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readMesh(QXmlStreamReader& xml, Geometry& geometry)
+{
+	while (xml.readNextStartElement())
+	{
+		int result = E_NOERROR;
+		if (is(xml, "source"))
+			result = readSource(xml);
+		else if (is(xml, "vertices"))
+			result = readVertices(xml);
+		else if (is(xml, "triangles"))
+			result = readPrimitive(xml, TRIANGLES, geometry);
+		else if (is(xml, "polylist"))
+			result = readPrimitive(xml, POLYLIST, geometry);
+		else if (is(xml, "polygons"))
+			result = readPrimitive(xml, POLYGONS, geometry);
+		else if (is(xml, "tristrips"))
+			result = readPrimitive(xml, TRISTRIPS, geometry);
+		else if (is(xml, "trifans"))
+			result = readPrimitive(xml, TRIFANS, geometry);
+		else
+			xml.skipCurrentElement(); // lines, linestrips, extra
+		if (result != E_NOERROR)
+			return result;
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readSource(QXmlStreamReader& xml)
+{
+	const QString id = attribute(xml, "id");
+	Source source;
+	while (xml.readNextStartElement())
+	{
+		if (is(xml, "float_array"))
+		{
+			source.data.reserve(size_t(std::max(attribute(xml, "count").toLongLong(), 0ll)));
+			readNumbers(xml, source.data);
+		}
+		else if (is(xml, "technique_common"))
+		{
+			while (xml.readNextStartElement())
+			{
+				if (is(xml, "accessor"))
+					source.stride = std::max(1, xml.attributes().value(QLatin1String("stride")).toInt());
+				xml.skipCurrentElement();
+			}
+		}
+		else
+			xml.skipCurrentElement();
+	}
+	sourceIndex[id] = int(sources.size());
+	sources.push_back(Source());
+	sources.back().data.swap(source.data);
+	sources.back().stride = source.stride;
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::semanticOf(const QString& semantic)
+{
+	if (semantic == "VERTEX") return VERTEX;
+	if (semantic == "POSITION") return POSITION;
+	if (semantic == "NORMAL") return NORMAL;
+	if (semantic == "TEXCOORD") return TEXCOORD;
+	if (semantic == "COLOR") return COLOR;
+	return OTHER;
+}
+
+int ColladaStreamImporter::readVertices(QXmlStreamReader& xml)
+{
+	std::vector<Input>& inputs = vertices[attribute(xml, "id")];
+	while (xml.readNextStartElement())
+	{
+		if (is(xml, "input"))
+		{
+			Input in;
+			in.semantic = semanticOf(attribute(xml, "semantic"));
+			in.offset = -1;
+			in.set = 0;
+			in.source = urlId(attribute(xml, "source"));
+			inputs.push_back(in);
+		}
+		xml.skipCurrentElement();
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readPrimitive(QXmlStreamReader& xml, int type, Geometry& geometry)
+{
+	Primitive pr;
+	pr.type = type;
+	pr.count = std::max(0, xml.attributes().value(QLatin1String("count")).toInt());
+	pr.material = attribute(xml, "material");
+	pr.stride = 1;
+	while (xml.readNextStartElement())
+	{
+		if (is(xml, "input"))
+		{
+			Input in;
+			in.semantic = semanticOf(attribute(xml, "semantic"));
+			in.offset = std::max(0, xml.attributes().value(QLatin1String("offset")).toInt());
+			in.set = xml.attributes().value(QLatin1String("set")).toInt();
+			in.source = urlId(attribute(xml, "source"));
+			pr.inputs.push_back(in);
+			pr.stride = std::max(pr.stride, in.offset + 1);
+			xml.skipCurrentElement();
+		}
+		else if (is(xml, "vcount"))
+		{
+			pr.vcount.reserve(size_t(pr.count));
+			readNumbers(xml, pr.vcount);
+		}
+		else if (is(xml, "p"))
+		{
+			if (type == TRIANGLES)
+				pr.p.reserve(size_t(pr.count) * 3 * pr.stride);
+			pr.first.push_back(pr.p.size());
+			readNumbers(xml, pr.p);
+		}
+		else if (is(xml, "ph"))
+			return E_UNSUPPORTED;
+		else
+			xml.skipCurrentElement();
+	}
+	geometry.primitives.push_back(Primitive());
+	std::swap(geometry.primitives.back(), pr);
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readNode(QXmlStreamReader& xml, int& index)
+{
+	index = int(nodes.size());
+	nodes.push_back(Node());
+	nodes[index].transform.SetIdentity();
+	const QString id = attribute(xml, "id");
+	if (!id.isEmpty())
+		nodeIndex[id] = index;
+
+	while (xml.readNextStartElement())
+	{
+		vcg::Matrix44d t;
+		std::vector<double> v;
+		if (is(xml, "matrix"))
+		{
+			readNumbers(xml, v);
+			if (v.size() != 16)
+				return E_INVALIDFILE;
+			for (int i = 0; i < 4; ++i)
+				for (int j = 0; j < 4; ++j)
+					t[i][j] = v[i * 4 + j];
+			nodes[index].transform = nodes[index].transform * t;
+		}
+		else if (is(xml, "translate") || is(xml, "scale") || is(xml, "rotate"))
+		{
+			const bool rotate = is(xml, "rotate");
+			const bool translate = is(xml, "translate");
+			readNumbers(xml, v);
+			if (v.size() != (rotate ? 4u : 3u))
+				return E_INVALIDFILE;
+			if (rotate)
+				t.SetRotateDeg(v[3], vcg::Point3d(v[0], v[1], v[2]));
+			else if (translate)
+				t.SetTranslate(v[0], v[1], v[2]);
+			else
+				t.SetScale(v[0], v[1], v[2]);
+			nodes[index].transform = nodes[index].transform * t;
+		}
+		else if (is(xml, "lookat") || is(xml, "skew") || is(xml, "instance_controller"))
+			return E_UNSUPPORTED;
+		else if (is(xml, "node"))
+		{
+			int child;
+			int result = readNode(xml, child);
+			if (result != E_NOERROR)
+				return result;
+			nodes[index].children.push_back(child);
+		}
+		else if (is(xml, "instance_node"))
+		{
+			nodes[index].instanceNodes.push_back(urlId(attribute(xml, "url")));
+			xml.skipCurrentElement();
+		}
+		else if (is(xml, "instance_geometry"))
+		{
+			GeometryInstance gi;
+			gi.geometry = urlId(attribute(xml, "url"));
+			//the instance_material elements of bind_material
+			int depth = 1;
+			while (depth > 0 && !xml.atEnd())
+			{
+				xml.readNext();
+				if (xml.isStartElement())
+				{
+					++depth;
+					if (is(xml, "instance_material"))
+						gi.material[attribute(xml, "symbol")] = urlId(attribute(xml, "target"));
+				}
+				else if (xml.isEndElement())
+					--depth;
+			}
+			nodes[index].geometries.push_back(gi);
+		}
+		else
+			xml.skipCurrentElement();
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readVisualScenes(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement())
+	{
+		if (!is(xml, "visual_scene"))
+		{
+			xml.skipCurrentElement();
+			continue;
+		}
+		const QString id = attribute(xml, "id");
+		if (firstVisualScene.isEmpty())
+			firstVisualScene = id;
+		std::vector<int> roots;
+		while (xml.readNextStartElement())
+		{
+			if (is(xml, "node"))
+			{
+				int index;
+				int result = readNode(xml, index);
+				if (result != E_NOERROR)
+					return result;
+				roots.push_back(index);
+			}
+			else
+				xml.skipCurrentElement();
+		}
+		visualScenes[id] = roots;
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::readScene(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement())
+	{
+		if (is(xml, "instance_visual_scene"))
+			sceneUrl = urlId(attribute(xml, "url"));
+		xml.skipCurrentElement();
+	}
+	return E_NOERROR;
+}
+
+int ColladaStreamImporter::resolveGeometry(Geometry& g) const
+{
+	//the attributes given in the vertices element are indexed as the positions
+	std::map<QString, std::vector<Input> >::const_iterator vertIt = vertices.end();
+	for (const Primitive& pr : g.primitives)
+		for (const Input& in : pr.inputs)
+			if (in.semantic == VERTEX)
+				vertIt = vertices.find(in.source);
+	if (vertIt == vertices.end())
+		return g.primitives.empty() ? E_NOERROR : E_INVALIDFILE;
+	for (const Input& in : vertIt->second)
+	{
+		const int source = findIndex(sourceIndex, in.source);
+		if (in.semantic == POSITION)
+			g.position = source;
+		else if (in.semantic == NORMAL)
+			g.normal.source = source;
+		else if (in.semantic == COLOR)
+			g.color.source = source;
+		else if (in.semantic == TEXCOORD && g.texCoord.source < 0)
+			g.texCoord.source = source;
+	}
+	if (g.position < 0 || sources[g.position].stride < 3)
+		return E_INVALIDFILE;
+	const int vertCount = int(sources[g.position].count());
+
+	g.faceNum = 0;
+	for (Primitive& pr : g.primitives)
+	{
+		pr.vertexOffset = -1;
+		pr.normal = g.normal;
+		pr.color = g.color;
+		pr.texCoord = g.texCoord;
+		int texSet = INT_MAX;
+		for (const Input& in : pr.inputs)
+		{
+			if (in.semantic == VERTEX)
+			{
+				if (vertices.find(in.source) != vertIt)
+					return E_UNSUPPORTED;
+				pr.vertexOffset = in.offset;
+				continue;
+			}
+			Attribute a;
+			a.source = findIndex(sourceIndex, in.source);
+			a.offset = in.offset;
+			if (in.semantic == NORMAL)
+				pr.normal = a;
+			else if (in.semantic == COLOR)
+				pr.color = a;
+			else if (in.semantic == TEXCOORD && in.set < texSet)
+			{
+				pr.texCoord = a;
+				texSet = in.set;
+			}
+		}
+		if (pr.vertexOffset < 0)
+			return E_INVALIDFILE;
+		if (pr.normal.source >= 0 && sources[pr.normal.source].stride < 3)
+			pr.normal.source = -1;
+		if (pr.color.source >= 0 && sources[pr.color.source].stride < 3)
+			pr.color.source = -1;
+		if (pr.texCoord.source >= 0 && sources[pr.texCoord.source].stride < 2)
+			pr.texCoord.source = -1;
+
+		//the corners of each polygon, strip or fan
+		const size_t corners = pr.p.size() / size_t(pr.stride);
+		if (pr.type == TRIANGLES)
+		{
+			pr.first.clear();
+			pr.faceNum = corners / 3;
+		}
+		else if (pr.type == POLYLIST)
+		{
+			pr.first.assign(1, 0);
+			for (int n : pr.vcount)
+			{
+				if (n < 0 || pr.first.back() + size_t(n) > corners)
+					return E_INVALIDFILE;
+				pr.first.push_back(pr.first.back() + size_t(n));
+			}
+		}
+		else
+		{
+			for (size_t& f : pr.first)
+				f /= size_t(pr.stride);
+			pr.first.push_back(corners);
+		}
+		if (pr.type != TRIANGLES)
+		{
+			pr.faceNum = 0;
+			for (size_t i = 0; i + 1 < pr.first.size(); ++i)
+				if (pr.first[i + 1] >= pr.first[i] + 3)
+					pr.faceNum += pr.first[i + 1] - pr.first[i] - 2;
+		}
+		g.faceNum += pr.faceNum;
+
+		//indices out of range would write outside the vertices of the instance
+		const Attribute* attrs[] = { &pr.normal, &pr.color, &pr.texCoord };
+		const size_t used = corners * size_t(pr.stride);
+		for (size_t c = 0; c < used; c += size_t(pr.stride))
+		{
+			const int v = pr.p[c + pr.vertexOffset];
+			if (v < 0 || v >= vertCount)
+				return E_INVALIDFILE;
+			for (const Attribute* a : attrs)
+			{
+				if (a->source < 0)
+					continue;
+				const int i = (a->offset < 0) ? v : pr.p[c + a->offset];
+				if (i < 0 || size_t(i) >= sources[a->source].count())
+					return E_INVALIDFILE;
+			}
+		}
+	}
+	return E_NOERROR;
+}
+
+void ColladaStreamImporter::splitVertices(Geometry& g) const
+{
+	const bool loadNormal = (loadMask & vcg::tri::io::Mask::IOM_VERTNORMAL) != 0;
+	const bool loadColor = (loadMask & vcg::tri::io::Mask::IOM_VERTCOLOR) != 0;
+	const size_t pn = sources[g.position].count();
+	//the vertex of each position gets the attributes of its first corner; the corners
+	//with different attributes get a copy, the copies of a position are chained in next
+	g.vertex.assign(pn, SplitVertex());
+	for (size_t i = 0; i < pn; ++i)
+		g.vertex[i].position = int(i);
+	std::vector<char> assigned(pn, 0);
+	std::vector<int> next(pn, -1);
+	for (Primitive& pr : g.primitives)
+	{
+		const size_t corners = pr.p.size() / size_t(pr.stride);
+		pr.cornerVertex.resize(corners);
+		for (size_t c = 0; c < corners; ++c)
+		{
+			const int* index = &pr.p[c * pr.stride];
+			SplitVertex sv;
+			sv.position = index[pr.vertexOffset];
+			if (loadNormal && pr.normal.source >= 0)
+			{
+				sv.normalSource = pr.normal.source;
+				sv.normal = (pr.normal.offset < 0) ? sv.position : index[pr.normal.offset];
+			}
+			if (loadColor && pr.color.source >= 0)
+			{
+				sv.colorSource = pr.color.source;
+				sv.color = (pr.color.offset < 0) ? sv.position : index[pr.color.offset];
+			}
+			int v = sv.position;
+			if (!assigned[v])
+			{
+				assigned[v] = 1;
+				g.vertex[v] = sv;
+			}
+			else
+			{
+				while (!(g.vertex[v] == sv) && next[v] >= 0)
+					v = next[v];
+				if (!(g.vertex[v] == sv))
+				{
+					next[v] = int(g.vertex.size());
+					g.vertex.push_back(sv);
+					next.push_back(-1);
+					v = next[v];
+				}
+			}
+			pr.cornerVertex[c] = v;
+		}
+	}
+}
+
+bool ColladaStreamImporter::collectInstances(int node, const vcg::Matrix44d& parent, int depth)
+{
+	if (depth > MAX_NODE_DEPTH)
+		return false;
+	const vcg::Matrix44d transform = parent * nodes[node].transform;
+	for (const GeometryInstance& gi : nodes[node].geometries)
+	{
+		const int g = findIndex(geometryIndex, gi.geometry);
+		if (g < 0 || geometries[g].position < 0)
+			continue;
+		Instance inst;
+		inst.geometry = g;
+		inst.transform = transform;
+		for (const Primitive& pr : geometries[g].primitives)
+		{
+			std::map<QString, QString>::const_iterator it = gi.material.find(pr.material);
+			inst.texture.push_back((it != gi.material.end()) ? textureIndex(it->second) : -1);
+		}
+		instances.push_back(inst);
+	}
+	for (int child : nodes[node].children)
+		if (!collectInstances(child, transform, depth + 1))
+			return false;
+	for (const QString& id : nodes[node].instanceNodes)
+	{
+		const int n = findIndex(nodeIndex, id);
+		if (n >= 0 && !collectInstances(n, transform, depth + 1))
+			return false;
+	}
+	return true;
+}
+
+int ColladaStreamImporter::textureIndex(const QString& material)
+{
+	std::map<QString, QString>::const_iterator effect = materialEffects.find(material);
+	if (effect == materialEffects.end())
+		return -1;
+	std::map<QString, QString>::const_iterator image = effectImages.find(effect->second);
+	if (image == effectImages.end())
+		return -1;
+	std::map<QString, QString>::const_iterator file = images.find(image->second);
+	const QString path = (file != images.end()) ? file->second : image->second;
+	std::map<QString, int>::const_iterator it = textureIndexes.find(path);
+	if (it != textureIndexes.end())
+		return it->second;
+	const int index = int(textures.size());
+	textures.push_back(path.toStdString());
+	textureIndexes[path] = index;
+	return index;
+}
+
+void ColladaStreamImporter::fill(CMeshO& m, vcg::CallBackPos* cb) const
+{
+	const int textureBase = int(m.textures.size());
+	m.textures.insert(m.textures.end(), textures.begin(), textures.end());
+	const size_t vertBase = m.vert.size();
+	const size_t faceBase = m.face.size();
+	vcg::tri::Allocator<CMeshO>::AddVertices(m, vertNum);
+	vcg::tri::Allocator<CMeshO>::AddFaces(m, faceNum);
+	if (cb)
+		cb(60, "Building mesh");
+
+	//each instance has its own vertices and faces
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(instances.size()); ++i)
+	{
+		Instance inst = instances[i];
+		inst.vertBase += vertBase;
+		inst.faceBase += faceBase;
+		fillInstance(m, inst, textureBase);
+	}
+	if (cb)
+		cb(90, "Building mesh");
+}
+
+void ColladaStreamImporter::fillInstance(CMeshO& m, const Instance& inst, int textureBase) const
+{
+	const Geometry& g = geometries[inst.geometry];
+	const Source& position = sources[g.position];
+	const vcg::Matrix44d& tr = inst.transform;
+	//normals are transformed by the inverse transpose
+	vcg::Matrix44d nm = vcg::Inverse(tr);
+	nm.transposeInPlace();
+	const size_t vn = g.vertex.size();
+	for (size_t i = 0; i < vn; ++i)
+	{
+		const SplitVertex& sv = g.vertex[i];
+		CVertexO& vert = m.vert[inst.vertBase + i];
+		const Scalarm* p = &position.data[size_t(sv.position) * position.stride];
+		vert.P() = Point3m::Construct(tr * vcg::Point3d(p[0], p[1], p[2]));
+		if (sv.normalSource >= 0)
+		{
+			const Source& s = sources[sv.normalSource];
+			const Scalarm* n = &s.data[size_t(sv.normal) * s.stride];
+			vcg::Point3d d(0, 0, 0);
+			for (int r = 0; r < 3; ++r)
+				d[r] = nm[r][0] * n[0] + nm[r][1] * n[1] + nm[r][2] * n[2];
+			vert.N() = Point3m::Construct(d.Normalize());
+		}
+		if (sv.colorSource >= 0)
+		{
+			const Source& s = sources[sv.colorSource];
+			const Scalarm* c = &s.data[size_t(sv.color) * s.stride];
+			vert.C().Import(vcg::Color4f(c[0], c[1], c[2], (s.stride > 3) ? c[3] : 1.0f));
+		}
+	}
+
+	const bool loadTexCoord = (loadMask & vcg::tri::io::Mask::IOM_WEDGTEXCOORD) != 0;
+	size_t f = inst.faceBase;
+	for (size_t pi = 0; pi < g.primitives.size(); ++pi)
+	{
+		const Primitive& pr = g.primitives[pi];
+		const int texture = (inst.texture[pi] >= 0) ? textureBase + inst.texture[pi] : -1;
+		auto corner = [&](CFaceO& face, int k, size_t c)
+		{
+			const int* index = &pr.p[c * pr.stride];
+			const int v = index[pr.vertexOffset];
+			face.V(k) = &m.vert[inst.vertBase + pr.cornerVertex[c]];
+			if (loadTexCoord)
+			{
+				face.WT(k) = vcg::TexCoord2<float>(0, 0);
+				face.WT(k).N() = -1;
+				if (pr.texCoord.source >= 0)
+				{
+					const Source& s = sources[pr.texCoord.source];
+					const Scalarm* t = &s.data[size_t(pr.texCoord.offset < 0 ? v : index[pr.texCoord.offset]) * s.stride];
+					face.WT(k).U() = t[0];
+					face.WT(k).V() = t[1];
+					face.WT(k).N() = texture;
+				}
+			}
+		};
+		auto triangle = [&](size_t a, size_t b, size_t c)
+		{
+			CFaceO& face = m.face[f++];
+			corner(face, 0, a);
+			corner(face, 1, b);
+			corner(face, 2, c);
+		};
+
+		if (pr.type == TRIANGLES)
+		{
+			for (size_t t = 0; t < pr.faceNum; ++t)
+				triangle(3 * t, 3 * t + 1, 3 * t + 2);
+			continue;
+		}
+		for (size_t i = 0; i + 1 < pr.first.size(); ++i)
+		{
+			const size_t b = pr.first[i];
+			const size_t e = pr.first[i + 1];
+			for (size_t j = b; j + 2 < e; ++j)
+			{
+				if (pr.type == TRISTRIPS)
+				{
+					//every other triangle of a strip is flipped to keep the orientation
+					if ((j - b) % 2 == 0)
+						triangle(j, j + 1, j + 2);
+					else
+						triangle(j + 1, j, j + 2);
+				}
+				else
+					triangle(b, j + 1, j + 2); // polygons and fans
+			}
+		}
+	}
+}
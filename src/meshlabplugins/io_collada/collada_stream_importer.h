@@ -0,0 +1,226 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef IO_COLLADA_STREAM_IMPORTER_H
+#define IO_COLLADA_STREAM_IMPORTER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include <common/ml_document/cmesh.h>
+
+class QXmlStreamReader;
+
+/*
+ColladaStreamImporter
+Loads the geometry of a COLLADA scene with a pull parser (QXmlStreamReader), without
+building the DOM of the document.
+
+The numeric arrays (float_array, p, vcount) are decoded while they are read, directly
+in typed buffers sized from their count attributes. Once the document has been read,
+the visual scene is flattened in a list of geometry instances; the final size of the mesh
+is then known, the mesh is allocated once and the instances are copied in parallel,
+each one in its own range of vertices and faces.
+
+Supported: triangles, polylist, polygons (without holes), tristrips and trifans,
+with positions, normals and colors and the first set of texture coordinates (per wedge,
+with the diffuse texture of the bound material). Normals and colors are indexed per
+corner as positions are: like the DOM importer, a position whose corners reference
+different normals or colors is split in one vertex per distinct (position, normal, color)
+index tuple. Node transforms (matrix, translate, rotate, scale), library_nodes and
+instance_node are supported.
+Documents using anything else that affects the geometry (skinning controllers, lookat,
+skew, polygons with holes) are reported as E_UNSUPPORTED, so that the caller can use
+the full DOM importer of vcg instead.
+*/
+class ColladaStreamImporter
+{
+public:
+	enum Error
+	{
+		E_NOERROR = 0,
+		E_CANTOPEN,
+		E_INVALIDXML,
+		E_INVALIDFILE,
+		E_UNSUPPORTED
+	};
+
+	ColladaStreamImporter();
+
+	// reads the document and prepares the instances of the scene
+	int load(const QString& fileName, vcg::CallBackPos* cb = nullptr);
+
+	// the components of the mesh that fill() sets; they must be enabled before calling it
+	int mask() const { return loadMask; }
+
+	void fill(CMeshO& m, vcg::CallBackPos* cb = nullptr) const;
+
+	static QString errorMsg(int error);
+
+	// the ids of the geometry elements of the document, read without loading it
+	static bool geometryIds(const QString& fileName, QStringList& ids);
+
+private:
+	enum Semantic { VERTEX, POSITION, NORMAL, TEXCOORD, COLOR, OTHER };
+	enum PrimitiveType { TRIANGLES, POLYLIST, POLYGONS, TRISTRIPS, TRIFANS };
+
+	struct Source
+	{
+		std::vector<Scalarm> data;
+		int stride;
+		Source() : stride(1) {}
+		size_t count() const { return data.size() / size_t(stride); }
+	};
+
+	struct Input
+	{
+		int semantic;
+		int offset;
+		int set;
+		QString source;
+	};
+
+	// an attribute of the corners: the source and the offset of its index in p
+	// (-1: the attribute is indexed by the vertex, as it comes from the vertices element)
+	struct Attribute
+	{
+		int source;
+		int offset;
+		Attribute() : source(-1), offset(-1) {}
+	};
+
+	// a vertex of the mesh: a position with the normal and color (source and index) of its corners
+	struct SplitVertex
+	{
+		int position;
+		int normalSource, normal;
+		int colorSource, color;
+		SplitVertex() : position(-1), normalSource(-1), normal(-1), colorSource(-1), color(-1) {}
+		bool operator==(const SplitVertex& o) const
+		{
+			return position == o.position && normalSource == o.normalSource && normal == o.normal &&
+				colorSource == o.colorSource && color == o.color;
+		}
+	};
+
+	struct Primitive
+	{
+		int type;
+		int count;
+		QString material;
+		std::vector<Input> inputs;
+		std::vector<int> vcount;
+		std::vector<int> p;
+		// start of each p element in p (polygons, tristrips, trifans), then polygons, strips and fans
+		// are all stored as ranges of corners in first (with the end of the last one)
+		std::vector<size_t> first;
+		int stride;
+		int vertexOffset;
+		Attribute normal, texCoord, color;
+		size_t faceNum;
+		std::vector<int> cornerVertex; // vertex of the geometry of each corner
+	};
+
+	struct Geometry
+	{
+		QString id;
+		std::vector<Primitive> primitives;
+		int position;
+		Attribute normal, texCoord, color;
+		size_t faceNum;
+		// the first ones are the positions, in order; the split copies follow
+		std::vector<SplitVertex> vertex;
+		Geometry() : position(-1), faceNum(0) {}
+	};
+
+	struct GeometryInstance
+	{
+		QString geometry;
+		std::map<QString, QString> material; // symbol -> material id
+	};
+
+	struct Node
+	{
+		vcg::Matrix44d transform;
+		std::vector<int> children;
+		QStringList instanceNodes;
+		std::vector<GeometryInstance> geometries;
+	};
+
+	// a geometry placed in the scene
+	struct Instance
+	{
+		int geometry;
+		vcg::Matrix44d transform;
+		std::vector<int> texture; // texture index of each primitive
+		size_t vertBase;
+		size_t faceBase;
+	};
+
+	int readImages(QXmlStreamReader& xml);
+	int readEffects(QXmlStreamReader& xml);
+	int readMaterials(QXmlStreamReader& xml);
+	int readGeometries(QXmlStreamReader& xml, vcg::CallBackPos* cb);
+	int readMesh(QXmlStreamReader& xml, Geometry& geometry);
+	int readSource(QXmlStreamReader& xml);
+	int readVertices(QXmlStreamReader& xml);
+	int readPrimitive(QXmlStreamReader& xml, int type, Geometry& geometry);
+	int readNode(QXmlStreamReader& xml, int& index);
+	int readVisualScenes(QXmlStreamReader& xml);
+	int readScene(QXmlStreamReader& xml);
+
+	static int semanticOf(const QString& semantic);
+	int resolveGeometry(Geometry& geometry) const;
+	void splitVertices(Geometry& geometry) const;
+	bool collectInstances(int node, const vcg::Matrix44d& parent, int depth);
+	int textureIndex(const QString& material);
+	void fillInstance(CMeshO& m, const Instance& instance, int textureBase) const;
+
+	std::vector<Source> sources;
+	std::map<QString, int> sourceIndex;
+	std::map<QString, std::vector<Input> > vertices;
+	std::vector<Geometry> geometries;
+	std::map<QString, int> geometryIndex;
+	std::vector<Node> nodes;
+	std::map<QString, int> nodeIndex;
+	std::map<QString, std::vector<int> > visualScenes;
+	QString firstVisualScene;
+	QString sceneUrl;
+
+	std::map<QString, QString> images;          // image id -> file
+	std::map<QString, QString> effectImages;    // effect id -> image id of the diffuse texture
+	std::map<QString, QString> materialEffects; // material id -> effect id
+
+	std::vector<Instance> instances;
+	std::vector<std::string> textures;
+	std::map<QString, int> textureIndexes;
+	size_t vertNum;
+	size_t faceNum;
+	int loadMask;
+};
+
+#endif // IO_COLLADA_STREAM_IMPORTER_H
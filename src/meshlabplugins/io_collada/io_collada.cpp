@@ -92,6 +92,7 @@
 #include <QElapsedTimer>
 
 #include "io_collada.h"
+#include "collada_stream_importer.h"
 
 #include <vcg/complex/algorithms/update/texture.h>
 #include <wrap/io_trimesh/export.h>
@@ -118,28 +119,49 @@ bool ColladaIOPlugin::open(const QString &formatName, const QString &fileName, M
 
 	if(formatName.toUpper() == tr("DAE"))
 	{
-		//m.addinfo = NULL;
-        tri::io::InfoDAE  info;
-		if (!tri::io::ImporterDAE<CMeshO>::LoadMask(filename.c_str(), info))
+		// the streaming importer reads the common geometry without building the DOM;
+		// the documents it does not support are loaded by the DOM importer of vcg
+		ColladaStreamImporter importer;
+		int streamResult = importer.load(fileName, cb);
+		if (streamResult == ColladaStreamImporter::E_NOERROR)
+		{
+			m.Enable(importer.mask());
+			importer.fill(m.cm, cb);
+			_mp.push_back(&m);
+			if (importer.mask() & vcg::tri::io::Mask::IOM_VERTNORMAL)
+				normalsUpdated = true;
+			mask = importer.mask();
+		}
+		else if (streamResult != ColladaStreamImporter::E_UNSUPPORTED)
+		{
+			qDebug() << "DAE Opening Error" << ColladaStreamImporter::errorMsg(streamResult) << endl;
 			return false;
-
-        m.Enable(info.mask);
-	//	for(unsigned int tx = 0; tx < info->texturefile.size();++tx)
-	//		m.cm.textures.push_back(info->texturefile[tx].toStdString());
+		}
+		else
+		{
+			//m.addinfo = NULL;
+			tri::io::InfoDAE  info;
+			if (!tri::io::ImporterDAE<CMeshO>::LoadMask(filename.c_str(), info))
+				return false;
+
+			m.Enable(info.mask);
+		//	for(unsigned int tx = 0; tx < info->texturefile.size();++tx)
+		//		m.cm.textures.push_back(info->texturefile[tx].toStdString());
 		
-		int result = vcg::tri::io::ImporterDAE<CMeshO>::Open(m.cm, filename.c_str(),info);
+			int result = vcg::tri::io::ImporterDAE<CMeshO>::Open(m.cm, filename.c_str(),info);
 		
-		if (result != vcg::tri::io::ImporterDAE<CMeshO>::E_NOERROR)
-		{
-			//QMessageBox::critical(parent, tr("DAE Opening Error"), errorMsgFormat.arg(fileName, vcg::tri::io::ImporterDAE<CMeshO>::ErrorMsg(result)));
-			qDebug() << "DAE Opening Error" << vcg::tri::io::ImporterDAE<CMeshO>::ErrorMsg(result) << endl;
-			return false;
+			if (result != vcg::tri::io::ImporterDAE<CMeshO>::E_NOERROR)
+			{
+				//QMessageBox::critical(parent, tr("DAE Opening Error"), errorMsgFormat.arg(fileName, vcg::tri::io::ImporterDAE<CMeshO>::ErrorMsg(result)));
+				qDebug() << "DAE Opening Error" << vcg::tri::io::ImporterDAE<CMeshO>::ErrorMsg(result) << endl;
+				return false;
+			}
+			else _mp.push_back(&m);
+
+			if(info.mask & vcg::tri::io::Mask::IOM_WEDGNORMAL)
+				normalsUpdated = true;
+			mask = info.mask;
 		}
-		else _mp.push_back(&m);
-
-        if(info.mask & vcg::tri::io::Mask::IOM_WEDGNORMAL)
-			normalsUpdated = true;
-        mask = info.mask;
 	}
 	
 	vcg::tri::UpdateBounding<CMeshO>::Box(m.cm);					// updates bounding box
@@ -156,23 +178,16 @@ void ColladaIOPlugin::initPreOpenParameter(const QString &/*format*/, const QStr
 	QElapsedTimer t;
 	t.start();
 	
-	QDomDocument* doc = new QDomDocument(filename);
-	QFile file(filename);
-	if (!file.open(QIODevice::ReadOnly))
-				return;
-	if (!doc->setContent(&file)) 
-	{
-				file.close();
-				return;
-	}
-	file.close();
+	// only the ids are needed: the document is streamed instead of loaded in a DOM
+	QStringList geomIds;
+	if (!ColladaStreamImporter::geometryIds(filename, geomIds))
+		return;
 	
-	QDomNodeList geomList = doc->elementsByTagName("geometry");
 	QStringList idList;
 	idList.push_back("Full Scene");
-	for(int i=0;i<geomList.size();++i)
+	for(int i=0;i<geomIds.size();++i)
 	{
-		QString idVal = geomList.at(i).toElement().attribute("id");
+		QString idVal = geomIds.at(i);
 		idList.push_back(idVal);
 		qDebug("Node %i geom id = '%s'",i,qUtf8Printable(idVal));
 	}
@@ -2,6 +2,7 @@ include (../../shared.pri)
 
 HEADERS += \
     io_collada.h \
+    collada_stream_importer.h \
     $$VCGDIR/wrap/io_trimesh/export_dae.h \
     $$VCGDIR/wrap/io_trimesh/import_dae.h \
     $$VCGDIR/wrap/dae/util_dae.h \
@@ -10,6 +11,7 @@ HEADERS += \
 
 SOURCES += \
     io_collada.cpp \
+    collada_stream_importer.cpp \
     $$VCGDIR/wrap/dae/xmldocumentmanaging.cpp
 
 TARGET = io_collada
@@ -33,6 +33,8 @@
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <atomic>
+#include <common/utilities/ascii_chunk_reader.h>
 #include <vcg/space/color4.h>
 #include <wrap/callback.h>
 #include <wrap/io_trimesh/io_mask.h>
@@ -66,6 +68,8 @@ class ImporterExpePTS
 
 		enum ExpeCodes {NoError=0, CantOpen, InvalidFile, UnsupportedVersion};
 
+		static const int MAX_PROPERTIES = 32;
+
 		struct Options
 		{
 			Options()
@@ -160,7 +164,7 @@ class ImporterExpePTS
 		}
 
 		static int Open(MESH_TYPE &mesh, const char *filename, int &loadmask,
-			const Options& options, CallBackPos * /*cb*/)
+			const Options& options, CallBackPos *cb)
 		{
 			QFile device(filename);
 			if ( (!device.open(QFile::ReadOnly)) )
@@ -267,96 +271,108 @@ class ImporterExpePTS
 			if(header[2]=="Binary")
 				return appendBinaryData(mesh, nofPoints, fileProperties, pointSize, device);
 			else if(header[2]=="Ascii")
-				return appendAsciiData(mesh, nofPoints, fileProperties, device);
+				return appendAsciiData(mesh, nofPoints, fileProperties, filename, streamPos, cb);
 
 			return 0;
 		} // end Open
 
-		template<typename VectorType>
-		static bool parse_vector(const QString& str, VectorType& v)
+		// the values of a vector are separated by blanks or commas, and may be enclosed in brackets
+		static bool parse_vector(const char* begin, const char* end, double* v, int size)
 		{
-			bool ok = true;
-			QRegExp xtrimming("^.*([-\\d].*\\d).*$");
-			xtrimming.indexIn(str);
-			QString trimmed = xtrimming.cap(1);
-			QList<QString> elements = trimmed.split(QRegExp("[ \t]+|[ \t]*,[ \t]*"));
-			size_t expectedSize = v.size();
-			if ((unsigned int)elements.size() != expectedSize)
+			while (begin<end && *begin!='-' && (*begin<'0' || *begin>'9'))
+				++begin;
+			while (end>begin && (end[-1]<'0' || end[-1]>'9'))
+				--end;
+			static const AsciiChunkReader::Tokenizer tokenizer(" \t,");
+			AsciiChunkReader::Token elements[4];
+			if (tokenizer.split(begin, end, elements, 4) != size)
 				return false;
-			for (uint k=0 ; k<expectedSize && ok ; ++k)
-				v[k] = elements[k].toDouble(&ok);
-			return ok;
+			for (int k=0 ; k<size ; ++k)
+				if (!AsciiChunkReader::toDouble(elements[k].begin, elements[k].end, v[k]))
+					return false;
+			return true;
 		}
 
-		static int appendAsciiData(MESH_TYPE& mesh, uint nofPoints, const FileProperties& fileProperties, QIODevice& device)
+		static int appendAsciiData(MESH_TYPE& mesh, int nofPoints, const FileProperties& fileProperties, const char* filename, qint64 dataPos, CallBackPos* cb)
 		{
-			QTextStream stream(&device);
-			std::vector<double> v(3);
-			std::vector<double> c(4);
-			QStringList line;
-			uint i=0;
-			VertexIterator v_iter = Allocator<MESH_TYPE>::AddVertices(mesh, nofPoints);
-			while(i<nofPoints && !stream.atEnd())
+			AsciiChunkReader reader(filename);
+			if (!reader.isOpen() || !reader.seek(dataPos))
+				return InvalidFile;
+
+			// the lines are parsed in parallel, each one directly in its vertex:
+			// lines with a wrong number of properties are skipped, while a property that cannot be parsed makes the whole file invalid
+			const int propertyNum = int(fileProperties.size());
+			if (propertyNum>MAX_PROPERTIES)
+				return InvalidFile;
+			std::atomic<bool> invalidProperty(false);
+			const AsciiChunkReader::Tokenizer tokenizer(";");
+			auto parsePoint = [&](const char* begin, const char* end, VertexType& v) -> bool
 			{
-				line = stream.readLine(1024).split(";");
-				if (line.size()==int(fileProperties.size()))
+				AsciiChunkReader::Token line[MAX_PROPERTIES];
+				if (tokenizer.split(begin, end, line, propertyNum) != propertyNum)
+					return false;
+				double c[4];
+				for(int k=0 ; k<propertyNum ; ++k)
 				{
-					for(uint k=0 ; k<fileProperties.size() ; ++k)
+					if (!fileProperties[k].hasProperty)
+						continue;
+					const AsciiChunkReader::Token& t = line[k];
+					if (fileProperties[k].name=="position")
 					{
-						if (fileProperties[k].hasProperty)
+						if (!parse_vector(t.begin, t.end, c, 3))
 						{
-							if (fileProperties[k].name=="position")
-							{
-								if (!parse_vector(line[k], v))
-								{
-									std::cerr << "Error parsing position " << line[k].toLocal8Bit().data() << "\n";
-									return InvalidFile;
-								}
-								for (int j=0; j<3; ++j)
-									v_iter->P()[j] = v[j];
-							}
-							else if(fileProperties[k].name=="normal")
-							{
-								if (!parse_vector(line[k], v))
-								{
-									std::cerr << "Error parsing normal " << line[k].toLocal8Bit().data() << "\n";
-									return InvalidFile;
-								}
-								for (int j=0; j<3; ++j)
-									v_iter->N()[j] = v[j];
-							}
-							else if(fileProperties[k].name=="radius")
-							{
-								bool ok = true;
-								v_iter->R() = line[k].toFloat(&ok);
-								if (!ok)
-								{
-									std::cerr << "Error parsing radius " << line[k].toLocal8Bit().data() << "\n";
-									return InvalidFile;
-								}
-							}
-							else if(fileProperties[k].name=="color")
-							{
-								if (!parse_vector(line[k], c))
-								{
-									std::cerr << "Error parsing color " << line[k].toLocal8Bit().data() << "\n";
-									return InvalidFile;
-								}
-								vcg::Color4f color(c[0],c[1],c[2],c[3]);
-								(*v_iter).C().Import(color);
-							}
-							else
-							{
-								std::cerr << "unsupported property " << fileProperties[k].name.data() << "\n";
-							}
+							invalidProperty = true;
+							return false;
 						}
+						for (int j=0; j<3; ++j)
+							v.P()[j] = c[j];
+					}
+					else if(fileProperties[k].name=="normal")
+					{
+						if (!parse_vector(t.begin, t.end, c, 3))
+						{
+							invalidProperty = true;
+							return false;
+						}
+						for (int j=0; j<3; ++j)
+							v.N()[j] = c[j];
+					}
+					else if(fileProperties[k].name=="radius")
+					{
+						if (!AsciiChunkReader::toDouble(t.begin, t.end, c[0]))
+						{
+							invalidProperty = true;
+							return false;
+						}
+						v.R() = c[0];
+					}
+					else if(fileProperties[k].name=="color")
+					{
+						if (!parse_vector(t.begin, t.end, c, 4))
+						{
+							invalidProperty = true;
+							return false;
+						}
+						vcg::Color4f color(c[0],c[1],c[2],c[3]);
+						v.C().Import(color);
 					}
-					++v_iter;
-				}
-				else if(line.size()!=0)
-				{
-					std::cerr << "\tInvalid line : " << line[0].toLocal8Bit().data() << "... (skip)\n";
 				}
+				return true;
+			};
+
+			const size_t base = mesh.vert.size();
+			reader.appendVertices(mesh, parsePoint, AsciiChunkReader::SKIP_LINE, cb);
+			if (invalidProperty)
+			{
+				std::cerr << "Error parsing the point properties\n";
+				return InvalidFile;
+			}
+			// the points after the declared number are dropped
+			if (nofPoints>=0 && mesh.vert.size()>base+size_t(nofPoints))
+			{
+				for (size_t i=base+nofPoints; i<mesh.vert.size(); ++i)
+					Allocator<MESH_TYPE>::DeleteVertex(mesh, mesh.vert[i]);
+				Allocator<MESH_TYPE>::CompactVertexVector(mesh);
 			}
 			return 0;
 		}
@@ -33,6 +33,8 @@
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <atomic>
+#include <common/utilities/ascii_chunk_reader.h>
 #include <vcg/space/color4.h>
 #include <wrap/callback.h>
 #include <wrap/io_trimesh/io_mask.h>
@@ -138,7 +140,7 @@ class ImporterXYZ
 		}
 
 		static int Open(MESH_TYPE &mesh, const char *filename, int &loadmask,
-			const Options& options, CallBackPos * /*cb*/)
+			const Options& options, CallBackPos *cb)
 		{
 			QFile device(filename);
 			if ( (!device.open(QFile::ReadOnly)) )
@@ -170,54 +172,40 @@ class ImporterXYZ
 				return 0;
       }
 
-      std::vector<CoordType> pos,normals;
-      CoordType p,n;
-      while(!stream.atEnd())
+      // the lines are parsed in parallel, each one directly in its vertex
+      std::atomic<bool> hasNormal(false);
+      const AsciiChunkReader::Tokenizer tokenizer(" \t|");
+      auto parsePoint = [&tokenizer, &hasNormal](const char* begin, const char* end, VertexType& v) -> bool
       {
-        buf = stream.readLine(0);
-        buf = buf.trimmed();
-		line = buf.split(QRegExp("[ |\t]"), QString::SkipEmptyParts);
-
-        if (line.size()==6)
+        AsciiChunkReader::Token token[6];
+        double val[6];
+        const int tokenNum = tokenizer.split(begin, end, token, 6);
+        if (tokenNum!=6 && tokenNum!=3)
+          return false;
+        for (int k=0; k<tokenNum; ++k)
+          AsciiChunkReader::toDouble(token[k].begin, token[k].end, val[k]);
+        v.P() = CoordType(val[0], val[1], val[2]);
+        if (tokenNum==6)
         {
-          loadmask |= Mask::IOM_VERTCOORD;
-          loadmask |= Mask::IOM_VERTNORMAL;
-          for (int k=0; k<3; ++k)
-          {
-            p[k] = line[k].toDouble();
-            n[k] = line[3+k].toDouble();
-          }
-          pos.push_back(p);
-          normals.push_back(n);
-        }
-        else if (line.size()==3)
-        {
-          loadmask |= Mask::IOM_VERTCOORD;
-          // there is no normal information
-          for (int k=0; k<3; ++k)
-          {
-            p[k] = line[k].toDouble();
-            n[k] = 0;
-          }
-          pos.push_back(p);
-          normals.push_back(n);
+          v.N() = CoordType(val[3], val[4], val[5]);
+          hasNormal = true;
         }
         else
         {
-          std::cerr << "error: skip line " << buf.toUtf8().data() << "\n";
-          for (int i=0; i<line.size(); ++i)
-            std::cerr << line[i].toUtf8().data() << " $ ";
-          std::cerr << "\n";
+          // there is no normal information
+          v.N() = CoordType(0, 0, 0);
         }
-      }
-      VertexIterator v_iter = Allocator<MESH_TYPE>::AddVertices(mesh,pos.size());
-      for (size_t i=0; i<pos.size(); ++i)
-      {
-        v_iter->P() = pos[i];
-        v_iter->N() = normals[i];
-        ++v_iter;
-      }
-
+        return true;
+      };
+
+      AsciiChunkReader reader(filename);
+      if (!reader.isOpen())
+        return CantOpen;
+      // the lines that are not made of 3 or 6 values are skipped
+      if (reader.appendVertices(mesh, parsePoint, AsciiChunkReader::SKIP_LINE, cb) > 0)
+        loadmask |= Mask::IOM_VERTCOORD;
+      if (hasNormal)
+        loadmask |= Mask::IOM_VERTNORMAL;
 			return 0;
 		} // end Open
 
@@ -24,6 +24,8 @@
 
 #include "io_txt.h"
 
+#include <common/utilities/ascii_chunk_reader.h>
+
 //#include <wrap/io_trimesh/export.h>
 
 #include <QMessageBox>
@@ -31,7 +33,7 @@
 
 using namespace vcg;
 
-bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError);
+bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError, CallBackPos *cb);
 
 void TxtIOPlugin::initPreOpenParameter(const QString &format, const QString &/*fileName*/, RichParameterList & parlst)
 {
@@ -62,7 +64,7 @@ void TxtIOPlugin::initPreOpenParameter(const QString &format, const QString &/*f
     }
 }
 
-bool TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshModel &m, int& mask, const RichParameterList &parlst, CallBackPos * /*cb*/, QWidget * /*parent*/)
+bool TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshModel &m, int& mask, const RichParameterList &parlst, CallBackPos *cb, QWidget * /*parent*/)
 {
     bool result=false;
 
@@ -83,7 +85,7 @@ bool TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshM
 
             m.Enable(mask);
 
-            return parseTXT(fileName, m.cm, rowToSkip, dataSeparator, dataFormat, rgbMode, onError);
+            return parseTXT(fileName, m.cm, rowToSkip, dataSeparator, dataFormat, rgbMode, onError, cb);
 		}
 
 	return result;
@@ -131,493 +133,90 @@ void TxtIOPlugin::GetExportMaskCapability(const QString & /*format*/, int &capab
 }
  
 
-bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError)
+/*
+	columns of each point format (in the order of the "strformat" enum): the first column of the
+	reflectance, color and normal values (-1 if missing) and the number of columns
+*/
+struct TxtFormat
 {
-    QFile impFile(filename);
-    int ii;
-
-    if(impFile.open(QIODevice::ReadOnly))
-    {
-        QString freshLine;
-        QStringList tokenizedLine;
-        QString separator;
-        float XX,YY,ZZ;
-        float NX,NY,NZ;
-        float RR,GG,BB;
-        float Qual;
-        bool parseOK[10];
-
-        //skipping first rowToSkip lines,because it's the header
-        for(ii=0; ii<rowToSkip; ii++)
-        {
-            if(!impFile.atEnd())
-                freshLine = QString(impFile.readLine()).simplified();
-            else
-            {
-                impFile.close();
-                return false;
-            }
-        }
-
-        switch(dataSeparator)
-        {
-            case 0: separator = ";"; break;
-            case 1: separator = ","; break;
-            case 2: separator = " "; break;
-        }
-
-        //now, the data
-        while(!impFile.atEnd())
-        {
-            // reading and tokenizing
-            freshLine = QString(impFile.readLine()).simplified();
-            tokenizedLine = freshLine.split(separator, QString::SkipEmptyParts);
-
-            switch(dataFormat)
-            {
-                case 0: // X Y Z
-                    {
-                        // number of token mismatch
-						if (tokenizedLine.size()<3)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							if (parseOK[0] && parseOK[1] && parseOK[2])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 1: // X Y Z Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<4)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 2: // X Y Z Reflectance R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							RR = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							GG = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							BB = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 3: // X Y Z Reflectance Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NX = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NY = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NZ = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 4: // X Y Z Reflectance R G B Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							RR = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							GG = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							BB = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NX = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NY = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							NZ = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 5: // X Y Z Reflectance Nx Ny Nz R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NX = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NY = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NZ = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							RR = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							GG = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							BB = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 6: // X Y Z R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<6)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 7: // X Y Z R G B Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 8: // X Y Z R G B Reflectance Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NX = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NY = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							NZ = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 9: // X Y Z R G B Nx Ny Nz Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NX = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NY = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NZ = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							Qual = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 10: // X Y Z Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<6)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 11: // X Y Z Nx Ny Nz R G B Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							RR = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							GG = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							BB = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							Qual = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 12: // X Y Z Nx Ny Nz Reflectance R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							RR = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							GG = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							BB = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-            }
+	int quality;
+	int color;
+	int normal;
+	int columns;
+};
+
+static const TxtFormat txtFormats[] = {
+	{ -1, -1, -1,  3 }, // X Y Z
+	{  3, -1, -1,  4 }, // X Y Z Reflectance
+	{  3,  4, -1,  7 }, // X Y Z Reflectance R G B
+	{  3, -1,  4,  7 }, // X Y Z Reflectance Nx Ny Nz
+	{  3,  4,  7, 10 }, // X Y Z Reflectance R G B Nx Ny Nz
+	{  3,  7,  4, 10 }, // X Y Z Reflectance Nx Ny Nz R G B
+	{ -1,  3, -1,  6 }, // X Y Z R G B
+	{  6,  3, -1,  7 }, // X Y Z R G B Reflectance
+	{  6,  3,  7, 10 }, // X Y Z R G B Reflectance Nx Ny Nz
+	{  9,  3,  6, 10 }, // X Y Z R G B Nx Ny Nz Reflectance
+	{ -1, -1,  3,  6 }, // X Y Z Nx Ny Nz
+	{  9,  6,  3, 10 }, // X Y Z Nx Ny Nz R G B Reflectance
+	{  6,  7,  3, 10 }  // X Y Z Nx Ny Nz Reflectance R G B
+};
+
+bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError, CallBackPos *cb)
+{
+	AsciiChunkReader reader(filename);
+	if (!reader.isOpen())
+		return false;
 
+	//skipping first rowToSkip lines,because it's the header
+	if (!reader.skipLines(rowToSkip))
+		return false;
 
-        }
+	if (dataFormat < 0 || dataFormat >= int(sizeof(txtFormats) / sizeof(txtFormats[0])))
+		return false;
+	const TxtFormat format = txtFormats[dataFormat];
 
-        impFile.close();
-        return true;
-    }
-    else
-        return false;
+	const char* separator = " \t\v\f";
+	switch(dataSeparator)
+	{
+		case 0: separator = ";"; break;
+		case 1: separator = ","; break;
+	}
+	const AsciiChunkReader::Tokenizer tokenizer(separator);
 
+	//the lines are parsed in parallel, each one directly in its vertex
+	auto parsePoint = [&](const char* begin, const char* end, CVertexO& v) -> bool
+	{
+		AsciiChunkReader::Token token[10];
+		double val[10];
+		// number of token mismatch
+		if (tokenizer.split(begin, end, token, 10) < format.columns)
+			return false;
+		for (int i = 0; i < format.columns; ++i)
+			if (!AsciiChunkReader::toDouble(token[i].begin, token[i].end, val[i]))
+				return false;
+
+		v.P() = Point3m(val[0], val[1], val[2]);
+		if (format.quality >= 0)
+			v.Q() = float(val[format.quality]);
+		if (format.color >= 0)
+		{
+			float RR = float(val[format.color]);
+			float GG = float(val[format.color + 1]);
+			float BB = float(val[format.color + 2]);
+			if (rgbMode == 1) //[0.0-1.0]
+			{
+				RR *= 255; GG *= 255; BB *= 255;
+			}
+			v.C() = Color4b(RR, GG, BB, 255);
+		}
+		if (format.normal >= 0)
+			v.N() = Point3m(val[format.normal], val[format.normal + 1], val[format.normal + 2]);
+		return true;
+	};
+
+	// on error the line is skipped or the import stops at that point, keeping the points already read
+	reader.appendVertices(m, parsePoint, (onError == 1) ? AsciiChunkReader::STOP : AsciiChunkReader::SKIP_LINE, cb);
+	return true;
 }
 
 
@@ -84,9 +84,13 @@
 #include <vcg/complex/append.h>
 #include <wrap/gl/glu_tesselator.h>
 
+#include <common/utilities/ascii_chunk_reader.h>
+
 #include "util_x3d.h"
 #include "vrml/Parser.h"
 
+#include <map>
+#include <memory>
 #include <set>
 
 namespace vcg {
@@ -167,10 +171,72 @@ namespace io {
 
 		
 		
+		//A linked file, read and parsed before being used by ManageInlineNode
+		struct InlineDocument
+		{
+			std::unique_ptr<QDomDocument> doc;
+			bool opened;
+			bool parsed;
+			InlineDocument() : opened(false), parsed(false) {}
+		};
+
+
+
+		static void ReadInlineDocument(const QString& path, InlineDocument& inlineDoc)
+		{
+			inlineDoc.doc.reset(new QDomDocument(path));
+			QFile file(path);
+			inlineDoc.opened = file.open(QIODevice::ReadOnly);
+			inlineDoc.parsed = inlineDoc.opened && inlineDoc.doc->setContent(&file);
+		}
+
+
+
+		//Parse concurrently the .x3d files linked by the Inline nodes of the document (the first existing path of each node)
+		static void PrefetchInlineDocuments(const QDomNodeList& inlineNodes, AdditionalInfoX3D* info, std::map<QString, InlineDocument>& prefetched)
+		{
+			std::vector<QString> paths;
+			QFileInfo current(info->filename);
+			for(int in = 0; in < inlineNodes.size(); in++)
+			{
+				QDomElement inl = inlineNodes.at(in).toElement();
+				if(inl.attribute("load", "true") != "true")
+					continue;
+				QStringList urls = inl.attribute("url").split(" ", QString::SkipEmptyParts);
+				for (int i = 0; i < urls.size(); i++)
+				{
+					QString path = urls.at(i).trimmed().remove(QChar('"'));
+					QFileInfo fi(path);
+					if (!fi.exists())
+						continue;
+					bool load = fi.suffix().toLower() == "x3d" && fi.fileName() != current.fileName() && prefetched.find(path) == prefetched.end();
+					std::map<QString, QDomNode*>::const_iterator iter;
+					for (iter = info->inlineNodeMap.begin(); iter != info->inlineNodeMap.end() && load; iter++)
+						load = (QFileInfo(iter->first).fileName() != fi.fileName());
+					if (load)
+					{
+						prefetched[path];
+						paths.push_back(path);
+					}
+					break;
+				}
+			}
+			std::vector<InlineDocument*> docs;
+			for (size_t i = 0; i < paths.size(); i++)
+				docs.push_back(&prefetched[paths[i]]);
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int i = 0; i < int(paths.size()); i++)
+				ReadInlineDocument(paths[i], *docs[i]);
+		}
+
+
+
 		//search all Inline nodes and try to open the linked files
 		static int ManageInlineNode(QDomDocument* doc, AdditionalInfoX3D*& info)
 		{
 			QDomNodeList inlineNodes = doc->elementsByTagName("Inline");
+			std::map<QString, InlineDocument> prefetched;
+			PrefetchInlineDocuments(inlineNodes, info, prefetched);
 			for(int in = 0; in < inlineNodes.size(); in++)
 			{
 				QDomElement inl = inlineNodes.at(in).toElement();
@@ -206,16 +272,21 @@ namespace io {
 							}
 							if(load && fi.suffix().toLower()=="x3d")
 							{
-								QDomDocument* docChild = new QDomDocument(path);
-								QFile file(path);
-								if (file.open(QIODevice::ReadOnly))
+								typename std::map<QString, InlineDocument>::iterator pre = prefetched.find(path);
+								if (pre == prefetched.end())
+								{
+									pre = prefetched.insert(std::make_pair(path, InlineDocument())).first;
+									ReadInlineDocument(path, pre->second);
+								}
+								if (pre->second.opened)
 								{
 									//load components mesh info from file .x3d linked in Inline node
 									info->filenameStack.push_back(path);
-									if (!docChild->setContent(&file)) 
+									if (!pre->second.parsed) 
 										return E_INVALIDXML;
+									QDomDocument* docChild = pre->second.doc.release();
+									prefetched.erase(pre);
 									info->inlineNodeMap[path] = docChild;
-									file.close();
 									int result = LoadMaskByDom(docChild, info, fi.fileName());
 									if (result != E_NOERROR) return result;
 									info->filenameStack.pop_back();
@@ -486,16 +557,50 @@ namespace io {
 	
 		
 		//Find and return the list of value of attribute in the node 'elem'
-		inline static void findAndParseAttribute(QStringList& list, const QDomElement& elem, QString attribute, QString defValue)
+		inline static void findAndParseAttribute(NumberList& list, const QDomElement& elem, QString attribute, QString defValue)
 		{
+			list.clear();
 			if (elem.isNull())
-			{
-				list = QStringList();
 				return;
+			//values are separated by blanks and commas; they are counted first, to fill the list with a single allocation
+			const QByteArray value = elem.attribute(attribute, defValue).toLatin1();
+			const char* begin = value.constData();
+			const char* end = begin + value.size();
+			size_t n = 0;
+			for (const char* p = begin; p < end; ++p)
+				if (!isValueSeparator(*p) && (p == begin || isValueSeparator(p[-1])))
+					++n;
+			list.values.resize(n);
+			n = 0;
+			const char* p = begin;
+			while (p < end)
+			{
+				while (p < end && isValueSeparator(*p))
+					++p;
+				const char* s = p;
+				while (p < end && !isValueSeparator(*p))
+					++p;
+				//as QString::toFloat(), malformed values are 0
+				if (p > s)
+					AsciiChunkReader::toDouble(s, p, list.values[n++]);
 			}
-			QString value = elem.attribute(attribute, defValue);
-			value.replace(",", " ");
-			list = value.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+		}
+
+		inline static bool isValueSeparator(char c)
+		{
+			return c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+		}
+
+		//Check if the attribute has at least a value, without parsing it
+		inline static bool hasAttributeValues(const QDomElement& elem, QString attribute)
+		{
+			if (elem.isNull())
+				return false;
+			const QString value = elem.attribute(attribute);
+			for (int i = 0; i < value.size(); i++)
+				if (!value.at(i).isSpace() && value.at(i) != ',')
+					return true;
+			return false;
 		}
 
 		
@@ -786,30 +891,27 @@ namespace io {
 					if ((!coordinate.isNull() && ((coordinate.attribute("point")!= "") || coordinate.attribute("USE", "") != "")) || (tagName == "ElevationGrid") || (tagName == "Cylinder") || (tagName == "Sphere"))
 					{
 						bool copyTextureFile = true;
-						QStringList colorList, normalList, textureList;
 						QString colorTag[] = {"Color", "ColorRGBA"};
 						QDomElement color = findNode(colorTag, 2, geometry);
-						findAndParseAttribute(colorList, color, "color", "");
+						bool hasColorList = hasAttributeValues(color, "color");
 						QDomElement normal = geometry.firstChildElement("Normal");
-						findAndParseAttribute(normalList, normal, "point", "");
+						bool hasNormalList = hasAttributeValues(normal, "point");
 						QString textCoorTag[] = {"TextureCoordinate", "MultiTextureCoordinate", "TextureCoordinateGenerator"};
 						QDomElement textureCoor = findNode(textCoorTag, 3, geometry);
-						findAndParseAttribute(textureList, textureCoor, "point", "");
+						bool hasTextureList = hasAttributeValues(textureCoor, "point");
 						QString colorPerVertex = geometry.attribute("colorPerVertex", "true");
 						QString normalPerVertex = geometry.attribute("normalPerVertex", "true");
  						bool textureGenSup = isTextCoorGenSupported(textureCoor);
 						if (tagName == "IndexedTriangleFanSet" || tagName == "IndexedTriangleSet" || tagName == "IndexedTriangleStripSet" || tagName == "IndexedQuadSet")
 						{
-							QStringList coordIndex;
-							findAndParseAttribute(coordIndex, geometry, "index", "");
-							if (!coordIndex.isEmpty())
+							if (hasAttributeValues(geometry, "index"))
 							{
-								if (!color.isNull() && (!colorList.isEmpty() || color.attribute("USE", "") != "")) bHasPerVertexColor = true;
-								if ((!textureCoor.isNull() || textureGenSup || !textureList.isEmpty() || textureCoor.attribute("USE", "") != "") && textureFile.size()>0) 
+								if (!color.isNull() && (hasColorList || color.attribute("USE", "") != "")) bHasPerVertexColor = true;
+								if ((!textureCoor.isNull() || textureGenSup || hasTextureList || textureCoor.attribute("USE", "") != "") && textureFile.size()>0) 
 									bHasPerVertexText = true;
 								else 
 									copyTextureFile = false;
-								if (!normal.isNull() && (!normalList.isEmpty() || normal.attribute("USE", "") != ""))
+								if (!normal.isNull() && (hasNormalList || normal.attribute("USE", "") != ""))
 								{
 									if (normalPerVertex == "true")
 										bHasPerVertexNormal = true;
@@ -820,12 +922,12 @@ namespace io {
 						}
 						else if (tagName == "TriangleFanSet" || tagName == "TriangleSet" || tagName == "TriangleStripSet" || tagName == "QuadSet")
 						{
-							if (!color.isNull() && (!colorList.isEmpty() || color.attribute("USE", "") != "")) bHasPerWedgeColor = true;
-							if ((textureGenSup || !textureCoor.isNull() || !textureList.isEmpty() || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
+							if (!color.isNull() && (hasColorList || color.attribute("USE", "") != "")) bHasPerWedgeColor = true;
+							if ((textureGenSup || !textureCoor.isNull() || hasTextureList || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
 								bHasPerWedgeTexCoord = true;
 							else
 								copyTextureFile = false;
-							if (!normal.isNull() && (!normalList.isEmpty() || normal.attribute("USE", "") != ""))
+							if (!normal.isNull() && (hasNormalList || normal.attribute("USE", "") != ""))
 							{
 								if (normalPerVertex == "true")
 									bHasPerWedgeNormal = true;
@@ -835,36 +937,34 @@ namespace io {
 						}
 						else if (tagName == "IndexedFaceSet")
 						{
-							QStringList colorIndex, normalIndex, texCoordIndex, coordIndex;
-							findAndParseAttribute(colorIndex, geometry, "colorIndex", "");
-							findAndParseAttribute(normalIndex, geometry, "normalIndex", "");
-							findAndParseAttribute(texCoordIndex, geometry, "texCoordIndex", "");
-							findAndParseAttribute(coordIndex, geometry, "coordIndex", "");
-							if (!coordIndex.isEmpty())
+							bool hasColorIndex = hasAttributeValues(geometry, "colorIndex");
+							bool hasNormalIndex = hasAttributeValues(geometry, "normalIndex");
+							bool hasTexCoordIndex = hasAttributeValues(geometry, "texCoordIndex");
+							if (hasAttributeValues(geometry, "coordIndex"))
 							{
-								if ((textureGenSup || !textureCoor.isNull() || !textureList.isEmpty() || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
+								if ((textureGenSup || !textureCoor.isNull() || hasTextureList || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
 								{
-									if (!texCoordIndex.isEmpty() || textureGenSup)
+									if (hasTexCoordIndex || textureGenSup)
 										bHasPerWedgeTexCoord = true;
 									else 
 										bHasPerVertexText = true;
 								}
 								else
 									copyTextureFile = false;
-								if (!color.isNull() && (!colorList.isEmpty() || color.attribute("USE", "") != ""))
+								if (!color.isNull() && (hasColorList || color.attribute("USE", "") != ""))
 								{
-									if (colorPerVertex == "true" && !colorIndex.isEmpty())
+									if (colorPerVertex == "true" && hasColorIndex)
 										bHasPerWedgeColor = true;
-									else if (colorPerVertex == "true" && colorIndex.isEmpty())
+									else if (colorPerVertex == "true" && !hasColorIndex)
 										bHasPerVertexColor = true;
 									else
 										bHasPerFaceColor = true;
 								}
-								if (!normal.isNull() && (!normalList.isEmpty() || normal.attribute("USE", "") != ""))
+								if (!normal.isNull() && (hasNormalList || normal.attribute("USE", "") != ""))
 								{
-									if (normalPerVertex == "true" && !normalIndex.isEmpty())
+									if (normalPerVertex == "true" && hasNormalIndex)
 										bHasPerWedgeNormal = true;
-									else if (normalPerVertex == "true" && normalIndex.isEmpty())
+									else if (normalPerVertex == "true" && !hasNormalIndex)
 										bHasPerVertexNormal = true;
 									else
 										bHasPerFaceNormal = true;
@@ -877,18 +977,18 @@ namespace io {
 							int zDimension = geometry.attribute("zDimension", "0").toInt();
 							if (xDimension != 0 && zDimension!=0)
 							{
-								if (!textureCoor.isNull() && (textureGenSup || !textureList.isEmpty() || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
+								if (!textureCoor.isNull() && (textureGenSup || hasTextureList || textureCoor.attribute("USE", "") != "") && textureFile.size()>0)
 									bHasPerVertexText = true;
 								else
 									copyTextureFile = false;
-								if (!color.isNull() && (!colorList.isEmpty() || color.attribute("USE", "") != ""))
+								if (!color.isNull() && (hasColorList || color.attribute("USE", "") != ""))
 								{
 									if (colorPerVertex == "true")
 										bHasPerVertexColor = true;
 									else
 										bHasPerFaceColor = true;
 								}
-								if (!normal.isNull() && (!normalList.isEmpty() || normal.attribute("USE", "") != ""))
+								if (!normal.isNull() && (hasNormalList || normal.attribute("USE", "") != ""))
 								{
 									if (normalPerVertex == "true")
 										bHasPerVertexNormal = true;
@@ -897,7 +997,7 @@ namespace io {
 								}
 							}
 						}
-						else if (tagName == "PointSet" && !color.isNull() && (!colorList.isEmpty() || color.attribute("USE", "") != ""))
+						else if (tagName == "PointSet" && !color.isNull() && (hasColorList || color.attribute("USE", "") != ""))
 						{
 							bHasPerVertexColor = true;
 							copyTextureFile = false;
@@ -974,9 +1074,9 @@ namespace io {
 									OpenMeshType& m,
 									const vcg::Matrix44<ScalarType>& tMatrix,
 									const TextureInfo& texture,
-									const QStringList& coordList,
-									const QStringList& colorList,
-									const QStringList& normalList,
+									const NumberList& coordList,
+									const NumberList& colorList,
+									const NumberList& normalList,
 									int colorComponent,
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
@@ -986,26 +1086,16 @@ namespace io {
 			std::vector< vcg::Point4<ScalarType> > vertexSet;
 			int index = 0;
 			std::vector<int> vertexFaceIndex;
-			//create list of vertex index
+			//create list of vertex index, merging the equal vertices
+			std::map<vcg::Point4<ScalarType>, int> vertexMap;
+			vertexFaceIndex.reserve(coordList.size() / 3);
 			while (index + 2 < coordList.size())
 			{
-				vcg::Point4<ScalarType> vertex(coordList.at(index).toFloat(), coordList.at(index + 1).toFloat(), coordList.at(index + 2).toFloat(), 1.0);
-				size_t vi = 0;
-				bool found = false;
-				while (vi < vertexSet.size() && !found)
-				{
-					if (vertexSet.at(vi) == vertex)
-						found = true;
-					else
-						vi++;
-				}
-				if (!found)
-				{
+				vcg::Point4<ScalarType> vertex(coordList.at(index), coordList.at(index + 1), coordList.at(index + 2), 1.0);
+				typename std::map<vcg::Point4<ScalarType>, int>::iterator vi = vertexMap.insert(std::make_pair(vertex, int(vertexSet.size()))).first;
+				if (vi->second == int(vertexSet.size()))
 					vertexSet.push_back(vertex);
-					vertexFaceIndex.push_back(vertexSet.size() - 1);
-				}
-				else
-					vertexFaceIndex.push_back(vi);
+				vertexFaceIndex.push_back(vi->second);
 				index += 3;
 			}
 			//Load vertexs in the mesh
@@ -1053,7 +1143,7 @@ namespace io {
 			}
 			else if (geometry.tagName() == "TriangleFanSet" || geometry.tagName() == "TriangleStripSet")
 			{
-				QStringList countList;
+				NumberList countList;
 				if (geometry.tagName() == "TriangleFanSet")
 					findAndParseAttribute(countList, geometry, "fanCount", "");
 				else
@@ -1069,15 +1159,15 @@ namespace io {
 				{
 					for (int i = 0; i < countList.size(); i++)
 					{
-						if (countList.at(i).toInt() < 3)
+						if (int(countList.at(i)) < 3)
 						{
 							info->lineNumberError = geometry.lineNumber();
 							return E_INVALIDFANSTRIP;
 						}
 						else
 						{
-							count.push_back(countList.at(i).toInt());
-							nFace += countList.at(i).toInt() - 2;
+							count.push_back(int(countList.at(i)));
+							nFace += int(countList.at(i)) - 2;
 						}
 					}
 				}
@@ -1222,14 +1312,14 @@ namespace io {
 									OpenMeshType& m,
 									const Matrix44<ScalarType>& tMatrix,
 									const TextureInfo& texture,
-									const QStringList& coordList,
-									const QStringList& colorList,
-									const QStringList& normalList,
+									const NumberList& coordList,
+									const NumberList& colorList,
+									const NumberList& normalList,
 									int colorComponent,
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
 		{
-			QStringList indexList;
+			NumberList indexList;
 			findAndParseAttribute(indexList, geometry, "index", "");
 			if (!indexList.isEmpty())
 			{
@@ -1246,7 +1336,7 @@ namespace io {
 					defValue = vcg::Color4b(Color4b::White);
 				for (int vv = 0; vv < nVertex; vv++)
 				{
-					Point4<ScalarType> tmp = tMatrix * Point4<ScalarType>(coordList.at(vv*3).toFloat(), coordList.at(vv*3 + 1).toFloat(), coordList.at(vv*3 + 2).toFloat(), 1.0);
+					Point4<ScalarType> tmp = tMatrix * Point4<ScalarType>(coordList.at(vv*3), coordList.at(vv*3 + 1), coordList.at(vv*3 + 2), 1.0);
 					m.vert[offset + vv].P() = CoordType(tmp.X(),tmp.Y(),tmp.Z());
 					//Load normal per vertex
 					if (HasPerVertexNormal(m) && (info->mask & vcg::tri::io::Mask::IOM_VERTNORMAL) && normalPerVertex == "true")
@@ -1273,7 +1363,7 @@ namespace io {
 							int vertIndexPerFace = tt;
 							if (ccw == "false")
 								vertIndexPerFace = 2 - tt;
-							size_t vertIndex = indexList.at(tt + ff*3).toInt() + offset;
+							size_t vertIndex = int(indexList.at(tt + ff*3)) + offset;
 							if (vertIndex >= m.vert.size())
 							{
 								info->lineNumberError = geometry.lineNumber();
@@ -1282,7 +1372,7 @@ namespace io {
 							m.face[faceIndex].V(vertIndexPerFace) = &(m.vert[vertIndex]);
 							//Load texture coordinate per wedge
 							if (!HasPerVertexTexCoord(m) && HasPerWedgeTexCoord(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGTEXCOORD))
-								getTextureCoord(texture, indexList.at(tt + ff*3).toInt()*2, m.vert[vertIndex].cP(), m.face[faceIndex].WT(vertIndexPerFace), tMatrix, info);
+								getTextureCoord(texture, int(indexList.at(tt + ff*3))*2, m.vert[vertIndex].cP(), m.face[faceIndex].WT(vertIndexPerFace), tMatrix, info);
 							if (HasPerWedgeColor(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGCOLOR))
 								m.face[faceIndex].WC(vertIndexPerFace) = vcg::Color4b(vcg::Color4b::White);
  						}
@@ -1296,12 +1386,12 @@ namespace io {
 				else if (geometry.tagName() == "IndexedTriangleFanSet" || geometry.tagName() == "IndexedTriangleStripSet")
 				{									
 					int count = 0;
-					int pos = indexList.indexOf("-1");
+					int pos = indexList.indexOf(-1);
 					//Check it the fans or the strips is correct
 					while(pos != -1)
 					{
 						count ++;
-						int nextPos = indexList.indexOf("-1", pos+1);
+						int nextPos = indexList.indexOf(-1, pos+1);
 						int tmp = (nextPos == -1)? indexList.size(): nextPos;
 						if ((tmp - pos -1) < 3)
 						{
@@ -1312,7 +1402,7 @@ namespace io {
 					}
 					int sub = count;
 					count++;
-					if (indexList.at(indexList.size()-1) == "-1")
+					if (indexList.at(indexList.size()-1) == -1)
 						sub++;
 					nFace = indexList.size() - 2*count - sub;
 					vcg::tri::Allocator<OpenMeshType>::AddFaces(m, nFace);
@@ -1322,18 +1412,18 @@ namespace io {
 					size_t vertIndex;
 					for (int ls = 0; ls < indexList.size() && ff < nFace; ls++)
 					{
-						if (indexList.at(ls) == "-1" || ls == 0)
+						if (indexList.at(ls) == -1 || ls == 0)
 						{
 							//Get the first two vertex
 							if (ls == 0) ls = -1;
-							vertIndex = indexList.at(ls + 1).toInt() + offset;
+							vertIndex = int(indexList.at(ls + 1)) + offset;
 							if (vertIndex >= m.vert.size())
 							{
 								info->lineNumberError = geometry.lineNumber();
 								return E_INVALIDINDEXED;
 							}
 							firstVertexIndex = vertIndex;
-							vertIndex = indexList.at(ls + 2).toInt() + offset;
+							vertIndex = int(indexList.at(ls + 2)) + offset;
 							if (vertIndex >= m.vert.size())
 							{
 								info->lineNumberError = geometry.lineNumber();
@@ -1355,7 +1445,7 @@ namespace io {
 								getTextureCoord(texture, (secondVertexIndex - offset)*2, m.vert[firstVertexIndex].cP(), m.face[faceIndex].WT(1), tMatrix, info);
 						}
 
- 						vertIndex = indexList.at(ls).toInt() + offset;
+ 						vertIndex = int(indexList.at(ls)) + offset;
 						if (vertIndex >= m.vert.size())
 						{
 							info->lineNumberError = geometry.lineNumber();
@@ -1393,13 +1483,13 @@ namespace io {
 						std::vector<CoordType> polygon;
 						for (int tt = 0; tt < 4; tt++)
 						{
-							size_t vertIndex = indexList.at(tt + ff*4).toInt() + offset;
+							size_t vertIndex = int(indexList.at(tt + ff*4)) + offset;
 							if (vertIndex >= m.vert.size())
 							{
 								info->lineNumberError = geometry.lineNumber();
 								return E_INVALIDINDEXED;
 							}
-							polygon.push_back(m.vert[indexList.at(tt + ff*4).toInt() + offset].cP());
+							polygon.push_back(m.vert[int(indexList.at(tt + ff*4)) + offset].cP());
 						}
 						polygonVect.push_back(polygon);
 						std::vector<int> indexVect;
@@ -1422,10 +1512,10 @@ namespace io {
 								if (ccw == "false")
 									vertIndexPerFace = 2 - tt;
 								int indexVertex = indexVect.at(iv) + ff*4;
-								m.face[faceIndex].V(vertIndexPerFace) = &(m.vert[indexList.at(indexVertex).toInt() + offset]);
+								m.face[faceIndex].V(vertIndexPerFace) = &(m.vert[int(indexList.at(indexVertex)) + offset]);
 								//Load texture coordinate per wedge
 								if(!HasPerVertexTexCoord(m) && HasPerWedgeTexCoord(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGTEXCOORD))
-									getTextureCoord(texture, indexList.at(indexVertex).toInt()*2, m.vert[indexList.at(indexVertex).toInt() + offset].cP(), m.face[faceIndex].WT(vertIndexPerFace), tMatrix, info);
+									getTextureCoord(texture, int(indexList.at(indexVertex))*2, m.vert[int(indexList.at(indexVertex)) + offset].cP(), m.face[faceIndex].WT(vertIndexPerFace), tMatrix, info);
 								if (HasPerWedgeColor(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGCOLOR))
 									m.face[faceIndex].WC(vertIndexPerFace) = vcg::Color4b(vcg::Color4b::White);
 								iv++;
@@ -1452,8 +1542,8 @@ namespace io {
 									OpenMeshType& m,
 									const vcg::Matrix44<ScalarType>& tMatrix,
 									const TextureInfo& texture,
-									const QStringList& colorList,
-									const QStringList& normalList,
+									const NumberList& colorList,
+									const NumberList& normalList,
 									int colorComponent,
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
@@ -1465,7 +1555,7 @@ namespace io {
 			int zDimension = geometry.attribute("zDimension", "0").toInt();
 			float xSpacing = geometry.attribute("xSpacing", "1.0").toFloat();
 			float zSpacing = geometry.attribute("zSpacing", "1.0").toFloat();
-			QStringList heightList;
+			NumberList heightList;
 			findAndParseAttribute(heightList, geometry, "height", "");
 			if (xDimension <= 0 || zDimension <= 0) return E_NOERROR;
 			if (heightList.size() < (xDimension * zDimension))
@@ -1476,7 +1566,7 @@ namespace io {
 			//Get heights vector
 			std::vector<float> heightVector;
 			for (int i = 0; i < heightList.size(); i++)
-				heightVector.push_back(heightList.at(i).toFloat());
+				heightVector.push_back(heightList.at(i));
 			int offsetVertex = m.vert.size();
 			int offsetFace = m.face.size();
 			vcg::tri::Allocator<OpenMeshType>::AddVertices(m, xDimension * zDimension);
@@ -1568,21 +1658,21 @@ namespace io {
 									OpenMeshType& m,
 									const vcg::Matrix44<ScalarType>& tMatrix,
 									const TextureInfo& texture,
-									const QStringList& coordList,
-									const QStringList& colorList,
-									const QStringList& normalList,
+									const NumberList& coordList,
+									const NumberList& colorList,
+									const NumberList& normalList,
 									int colorComponent,
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
 		{
-			QStringList coordIndex;
+			NumberList coordIndex;
 			findAndParseAttribute(coordIndex, geometry, "coordIndex", "");
 			if (!coordIndex.isEmpty())
 			{
 				QString normalPerVertex = geometry.attribute("normalPerVertex", "true");
 				QString colorPerVertex = geometry.attribute("colorPerVertex", "true");
 				QString ccw = geometry.attribute("ccw", "true");
-				QStringList colorIndex, normalIndex, texCoordIndex;
+				NumberList colorIndex, normalIndex, texCoordIndex;
 				findAndParseAttribute(colorIndex, geometry, "colorIndex", "");
 				findAndParseAttribute(normalIndex, geometry, "normalIndex", "");
 				findAndParseAttribute(texCoordIndex, geometry, "texCoordIndex", "");
@@ -1598,7 +1688,7 @@ namespace io {
 					defValue = vcg::Color4b(Color4b::White);
 				for (int vv = 0; vv < nVertex; vv++)
 				{
-					vcg::Point4<ScalarType> tmp = tMatrix * vcg::Point4<ScalarType>(coordList.at(vv*3).toFloat(), coordList.at(vv*3 + 1).toFloat(), coordList.at(vv*3 + 2).toFloat(), 1.0);
+					vcg::Point4<ScalarType> tmp = tMatrix * vcg::Point4<ScalarType>(coordList.at(vv*3), coordList.at(vv*3 + 1), coordList.at(vv*3 + 2), 1.0);
 					m.vert[offset + vv].P() = CoordType(tmp.X(),tmp.Y(),tmp.Z());
 					//Load color per vertex
 					if (HasPerVertexColor(m) && (info->mask & vcg::tri::io::Mask::IOM_VERTCOLOR))
@@ -1627,9 +1717,9 @@ namespace io {
 					std::vector<std::vector<CoordType> > polygonVect;
 					std::vector<CoordType> polygon;
 					//Check if polygon is correct
-					while(ci < coordIndex.size() && coordIndex.at(ci) != "-1")
+					while(ci < coordIndex.size() && coordIndex.at(ci) != -1)
 					{
-						size_t n = coordIndex.at(ci).toInt() + offset;
+						size_t n = int(coordIndex.at(ci)) + offset;
 						if (n >= m.vert.size())
 						{
 							info->lineNumberError = geometry.lineNumber();
@@ -1676,19 +1766,19 @@ namespace io {
 							int vertIndexPerFace = tt;
 							if (ccw == "false")
 								vertIndexPerFace = 2 - tt;
-							int index = coordIndex.at(indexVect.at(tt + ff*3) + initPolygon).toInt();
+							int index = int(coordIndex.at(indexVect.at(tt + ff*3) + initPolygon));
 							m.face[ff + offsetFace].V(vertIndexPerFace) = &(m.vert[index + offset]);
 							//Load per wedge color
 							if (HasPerWedgeColor(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGCOLOR))
 							{
 								if (index < colorIndex.size() && colorPerVertex == "true")
-									getColor(colorList, colorComponent, colorIndex.at(indexVect.at(tt + ff*3) + initPolygon).toInt() * colorComponent, m.face[ff + offsetFace].WC(vertIndexPerFace), vcg::Color4b(Color4b::White));
+									getColor(colorList, colorComponent, int(colorIndex.at(indexVect.at(tt + ff*3) + initPolygon)) * colorComponent, m.face[ff + offsetFace].WC(vertIndexPerFace), vcg::Color4b(Color4b::White));
 								else
 									m.face[ff + offsetFace].WC(vertIndexPerFace) = vcg::Color4b(vcg::Color4b::White);
 							}
 							//Load per wedge normal
 							if (HasPerWedgeNormal(m) && normalPerVertex == "true" && (info->mask & vcg::tri::io::Mask::IOM_WEDGNORMAL) && index < normalIndex.size())
-								getNormal(normalList, normalIndex.at(indexVect.at(tt + ff*3) + initPolygon).toInt() * 3, m.face[ff + offsetFace].WN(vertIndexPerFace), tMatrix);
+								getNormal(normalList, int(normalIndex.at(indexVect.at(tt + ff*3) + initPolygon)) * 3, m.face[ff + offsetFace].WN(vertIndexPerFace), tMatrix);
 								
 							//Load per wegde texture coordinate
 							if(HasPerWedgeTexCoord(m) && (info->mask & vcg::tri::io::Mask::IOM_WEDGTEXCOORD))
@@ -1696,7 +1786,7 @@ namespace io {
 								if (texCoordIndex.isEmpty())// && !HasPerVertexTexCoord(m))
 									getTextureCoord(texture, index*2, m.vert[index + offset].cP(), m.face[ff + offsetFace].WT(vertIndexPerFace), tMatrix, info);
 								else if (!texCoordIndex.isEmpty() && (indexVect.at(tt + ff*3) + initPolygon) < texCoordIndex.size())
-									getTextureCoord(texture, texCoordIndex.at(indexVect.at(tt + ff*3) + initPolygon).toInt()*2, m.vert[index + offset].cP(), m.face[ff + offsetFace].WT(vertIndexPerFace), tMatrix, info); 
+									getTextureCoord(texture, int(texCoordIndex.at(indexVect.at(tt + ff*3) + initPolygon))*2, m.vert[index + offset].cP(), m.face[ff + offsetFace].WT(vertIndexPerFace), tMatrix, info); 
 								else
 								{
 									m.face[ff + offsetFace].WT(tt) = vcg::TexCoord2<float>(0, 0);
@@ -1707,8 +1797,8 @@ namespace io {
 						//Load per face normal
 						if (HasPerFaceNormal(m) && normalPerVertex == "false" && (info->mask & vcg::tri::io::Mask::IOM_FACENORMAL))
 						{
-							if (!normalIndex.isEmpty() && ff < normalIndex.size() && normalIndex.at(ff).toInt() > -1)
-								getNormal(normalList, normalIndex.at(j).toInt() * 3,  m.face[ff + offsetFace].N(), tMatrix);
+							if (!normalIndex.isEmpty() && ff < normalIndex.size() && int(normalIndex.at(ff)) > -1)
+								getNormal(normalList, int(normalIndex.at(j)) * 3,  m.face[ff + offsetFace].N(), tMatrix);
 							else
 								getNormal(normalList, j*3,  m.face[ff + offsetFace].N(), tMatrix);
 						}
@@ -1717,8 +1807,8 @@ namespace io {
 						{
 							if (colorPerVertex == "false")
 							{
-								if (!colorIndex.isEmpty() && ff < colorIndex.size() && colorIndex.at(ff).toInt() > -1)
-									getColor(colorList, colorComponent, colorIndex.at(j).toInt() * colorComponent, m.face[ff + offsetFace].C(), vcg::Color4b(Color4b::White));
+								if (!colorIndex.isEmpty() && ff < colorIndex.size() && int(colorIndex.at(ff)) > -1)
+									getColor(colorList, colorComponent, int(colorIndex.at(j)) * colorComponent, m.face[ff + offsetFace].C(), vcg::Color4b(Color4b::White));
 								else
 									getColor(colorList, colorComponent, j*colorComponent, m.face[ff + offsetFace].C(), vcg::Color4b(Color4b::White));
 							}
@@ -1741,8 +1831,8 @@ namespace io {
 		static int LoadPointSet(QDomElement /* geometry */,
 									OpenMeshType& m,
 									const vcg::Matrix44<ScalarType>& tMatrix,
-									const QStringList& coordList,
-									const QStringList& colorList,
+									const NumberList& coordList,
+									const NumberList& colorList,
 									int colorComponent,
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
@@ -1758,7 +1848,7 @@ namespace io {
 				defValue = vcg::Color4b(Color4b::White);
 			for (int vv = 0; vv < nVertex; vv++)
 			{
-				vcg::Point4<ScalarType> tmp(coordList.at(vv*3).toFloat(), coordList.at(vv*3 + 1).toFloat(), coordList.at(vv*3 + 2).toFloat(), 1.0);
+				vcg::Point4<ScalarType> tmp(coordList.at(vv*3), coordList.at(vv*3 + 1), coordList.at(vv*3 + 2), 1.0);
 				tmp = tMatrix * tmp;			
 				m.vert[vv + offset].P() = CoordType(tmp.X(), tmp.Y(), tmp.Z());
 				//Load color per vertex
@@ -1785,7 +1875,7 @@ namespace io {
 		{
 			//Load vertex in the mesh
 			int offset = m.vert.size();
-			QStringList pointList;
+			NumberList pointList;
 			findAndParseAttribute(pointList, geometry, "point", "");
 			if (!pointList.isEmpty())
 			{
@@ -1793,7 +1883,7 @@ namespace io {
 				vcg::tri::Allocator<OpenMeshType>::AddVertices(m, nVertex);
 				for (int vv = 0; vv < nVertex; vv++)
 				{
-					vcg::Point4<ScalarType> tmp(pointList.at(vv*2).toFloat(), pointList.at(vv*2 + 1).toFloat(), 0, 1.0);
+					vcg::Point4<ScalarType> tmp(pointList.at(vv*2), pointList.at(vv*2 + 1), 0, 1.0);
 					tmp = tMatrix * tmp;			
 					m.vert[vv + offset].P() = CoordType(tmp.X(), tmp.Y(), tmp.Z());
 					loadDefaultValuePerVertex(&(m.vert[vv + offset]), m, info->mask);
@@ -1813,7 +1903,7 @@ namespace io {
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
 		{
-			QStringList vertices;
+			NumberList vertices;
 			findAndParseAttribute(vertices, geometry, "vertices", "");
 			if (!vertices.isEmpty())
 			{
@@ -1821,25 +1911,14 @@ namespace io {
 				std::vector< vcg::Point4<ScalarType> > vertexSet;
 				int index = 0;
 				std::vector<int> vertexFaceIndex;
+				std::map<vcg::Point4<ScalarType>, int> vertexMap;
 				while (index + 1 < vertices.size())
 				{
-					vcg::Point4<ScalarType> vertex(vertices.at(index).toFloat(), vertices.at(index + 1).toFloat(), 0, 1.0);
-					size_t vi = 0;
-					bool found = false;
-					while (vi < vertexSet.size() && !found)
-					{
-						if (vertexSet.at(vi) == vertex)
-							found = true;
-						else
-							vi++;
-					}
-					if (!found)
-					{
+					vcg::Point4<ScalarType> vertex(vertices.at(index), vertices.at(index + 1), 0, 1.0);
+					typename std::map<vcg::Point4<ScalarType>, int>::iterator vi = vertexMap.insert(std::make_pair(vertex, int(vertexSet.size()))).first;
+					if (vi->second == int(vertexSet.size()))
 						vertexSet.push_back(vertex);
-						vertexFaceIndex.push_back(vertexSet.size() - 1);
-					}
-					else
-						vertexFaceIndex.push_back(vi);
+					vertexFaceIndex.push_back(vi->second);
 					index += 2;
 				}
 				//Load vertex in the mesh
@@ -1877,12 +1956,12 @@ namespace io {
 									AdditionalInfoX3D* info,
 									CallBackPos *cb)
 		{
-			QStringList radiusList;
+			NumberList radiusList;
 			findAndParseAttribute(radiusList, geometry, "radius", "1");
-			QStringList heightList;
+			NumberList heightList;
 			findAndParseAttribute(heightList, geometry, "height", "2");
-			float radius = radiusList[0].toFloat();
-			float height = heightList[0].toFloat();
+			float radius = radiusList[0];
+			float height = heightList[0];
 			OpenMeshType newCylinder;
 			vcg::tri::Cone<OpenMeshType>(newCylinder, radius, radius, height, 100);
 			if (info->meshColor)
@@ -1903,9 +1982,9 @@ namespace io {
 			vcg::Matrix44<ScalarType> t, tmp;
 			t.SetIdentity();
 
-			QStringList radiusList;
+			NumberList radiusList;
 			findAndParseAttribute(radiusList, geometry, "radius", "1");
-			float radius = radiusList[0].toFloat();
+			float radius = radiusList[0];
 			tmp.SetScale(radius,radius,radius);
 			t *= tmp;
 			tmp = tMatrix * t;
@@ -2003,12 +2082,12 @@ namespace io {
 				}
 				textTransfList = appearance.elementsByTagName("TextureTransform");
 				QDomElement materialNode = appearance.firstChildElement("Material");
-				QStringList list;
+				NumberList list;
 				findAndParseAttribute(list, materialNode, "diffuseColor", "");
 				if (list.size() >= 3)
 				{
 					float transparency = 1.0 - materialNode.attribute("transparency", "0.0").toFloat();
-					vcg::Color4f color(list.at(0).toFloat(), list.at( 1).toFloat(), list.at(2).toFloat(), transparency); 
+					vcg::Color4f color(list.at(0), list.at( 1), list.at(2), transparency); 
 					vcg::Color4b colorB;
 					colorB.Import(color);
 					info->color = colorB;
@@ -2027,26 +2106,26 @@ namespace io {
 		{
 			vcg::Matrix33f matrix, tmp;
 			matrix.SetIdentity();
-			QStringList coordList, center;
+			NumberList coordList, center;
 			findAndParseAttribute(center, elem, "center", "0 0");
 			if (center.size() == 2)
 			{			
-				matrix[0][2] = -center.at(0).toFloat();
-				matrix[1][2] = -center.at(1).toFloat();
+				matrix[0][2] = -center.at(0);
+				matrix[1][2] = -center.at(1);
 			}
 			findAndParseAttribute(coordList, elem, "scale", "1 1");
 			if(coordList.size() == 2)
 			{
 				tmp.SetIdentity();
-				tmp[0][0] = coordList.at(0).toFloat();
-				tmp[1][1] = coordList.at(1).toFloat();
+				tmp[0][0] = coordList.at(0);
+				tmp[1][1] = coordList.at(1);
 				matrix *= tmp;
 			}
 			findAndParseAttribute(coordList, elem, "rotation", "0");
 			if(coordList.size() == 1)
 			{
 				tmp.SetIdentity();
-				float angle = coordList.at(0).toFloat();
+				float angle = coordList.at(0);
 				tmp[0][0] = cos(angle);
 				tmp[0][1] = -sin(angle);
 				tmp[1][0] = sin(angle);
@@ -2057,16 +2136,16 @@ namespace io {
 			if (center.size() == 2)
 			{
 				tmp.SetIdentity();
-				tmp[0][2] = center.at(0).toFloat();
-				tmp[1][2] = center.at(1).toFloat();
+				tmp[0][2] = center.at(0);
+				tmp[1][2] = center.at(1);
 				matrix *= tmp;
 			}
 			findAndParseAttribute(coordList, elem, "translation", "0 0");
 			if(coordList.size() == 2)
 			{
 				tmp.SetIdentity();
-				tmp[0][2] = coordList.at(0).toFloat();
-				tmp[1][2] = coordList.at(1).toFloat();
+				tmp[0][2] = coordList.at(0);
+				tmp[1][2] = coordList.at(1);
 				matrix *= tmp;
 			}
 			return matrix;
@@ -2078,42 +2157,42 @@ namespace io {
 		{
 			vcg::Matrix44<ScalarType> t, tmp;
 			t.SetIdentity();
-			QStringList coordList, center, scale;
+			NumberList coordList, center, scale;
 			findAndParseAttribute(coordList, root, "translation", "");
 			if(coordList.size() == 3)
-				t.SetTranslate(coordList.at(0).toFloat(), coordList.at(1).toFloat(), coordList.at(2).toFloat()); 
+				t.SetTranslate(coordList.at(0), coordList.at(1), coordList.at(2)); 
 			findAndParseAttribute(center, root, "center", "");
 			if(center.size() == 3)
 			{
-				tmp.SetTranslate(center.at(0).toFloat(), center.at(1).toFloat(), center.at(2).toFloat());
+				tmp.SetTranslate(center.at(0), center.at(1), center.at(2));
 				t *= tmp;
 			}
 			findAndParseAttribute(coordList, root, "rotation", "");
 			if(coordList.size() == 4)
 			{
-				tmp.SetRotateRad(coordList.at(3).toFloat(), CoordType(coordList.at(0).toFloat(), coordList.at(1).toFloat(), coordList.at(2).toFloat()));
+				tmp.SetRotateRad(coordList.at(3), CoordType(coordList.at(0), coordList.at(1), coordList.at(2)));
 				t *= tmp;
 			}
 			findAndParseAttribute(scale, root, "scaleOrientation", "");
 			if(scale.size() == 4)
 			{
-				tmp.SetRotateRad(scale.at(3).toFloat(), CoordType(scale.at(0).toFloat(), scale.at(1).toFloat(), scale.at(2).toFloat()));
+				tmp.SetRotateRad(scale.at(3), CoordType(scale.at(0), scale.at(1), scale.at(2)));
 				t *= tmp;
 			}
 			findAndParseAttribute(coordList, root, "scale", "");
 			if(coordList.size() == 3)
 			{
-				tmp.SetScale(coordList.at(0).toFloat(), coordList.at(1).toFloat(), coordList.at(2).toFloat());
+				tmp.SetScale(coordList.at(0), coordList.at(1), coordList.at(2));
 				t *= tmp;
 			}
 			if(scale.size() == 4)
 			{
-				tmp.SetRotateRad(-scale.at(3).toFloat(), CoordType(scale.at(0).toFloat(), scale.at(1).toFloat(), scale.at(2).toFloat()));
+				tmp.SetRotateRad(-scale.at(3), CoordType(scale.at(0), scale.at(1), scale.at(2)));
 				t *= tmp;
 			}
 			if(center.size() == 3)
 			{
-				tmp.SetTranslate(-center.at(0).toFloat(), -center.at(1).toFloat(), -center.at(2).toFloat());
+				tmp.SetTranslate(-center.at(0), -center.at(1), -center.at(2));
 				t *= tmp;
 			}
 			t = tMatrix * t;
@@ -2312,11 +2391,11 @@ namespace io {
 		
 		
 		//If the index is valid, return the normal of index 'index'
-		inline static void getNormal(const QStringList& list, int index, CoordType& dest, const vcg::Matrix44<ScalarType>& tMatrix)
+		inline static void getNormal(const NumberList& list, int index, CoordType& dest, const vcg::Matrix44<ScalarType>& tMatrix)
 		{
 			if(!list.isEmpty() && (index + 2) < list.size())
 			{
-				CoordType normal(list.at(index).toFloat(), list.at(index + 1).toFloat(), list.at( index+ 2).toFloat());
+				CoordType normal(list.at(index), list.at(index + 1), list.at( index+ 2));
 				vcg::Matrix44<ScalarType> intr44 = vcg::Inverse(tMatrix);
 				intr44.transposeInPlace();
 				Matrix33<ScalarType> intr33;
@@ -2333,15 +2412,15 @@ namespace io {
 		
 
 		//If the index is valid, return the color of index 'index'
-		inline static void getColor(const QStringList& list, int component, int index, vcg::Color4b& dest, const vcg::Color4b& defValue)
+		inline static void getColor(const NumberList& list, int component, int index, vcg::Color4b& dest, const vcg::Color4b& defValue)
 		{
 			if(!list.isEmpty() && (index + component - 1) < list.size())
 			{
 				vcg::Color4f color;
 				if (component == 3)
-					color = vcg::Color4f(list.at(index).toFloat(), list.at(index + 1).toFloat(), list.at(index + 2).toFloat(), 1); 
+					color = vcg::Color4f(list.at(index), list.at(index + 1), list.at(index + 2), 1); 
 				else
-					color = vcg::Color4f(list.at(index).toFloat(), list.at(index + 1).toFloat(), list.at(index + 2).toFloat(), list.at(index + 3).toFloat());
+					color = vcg::Color4f(list.at(index), list.at(index + 1), list.at(index + 2), list.at(index + 3));
 				vcg::Color4b colorB;
 				colorB.Import(color);
 				dest = colorB;
@@ -2388,7 +2467,7 @@ namespace io {
 			}
 			else if (!textInfo.textureCoordList.isEmpty() && (index + 1) < textInfo.textureCoordList.size())
 			{
-				point = vcg::Point3f(textInfo.textureCoordList.at(index).toFloat(), textInfo.textureCoordList.at(index + 1).toFloat(), 1.0);
+				point = vcg::Point3f(textInfo.textureCoordList.at(index), textInfo.textureCoordList.at(index + 1), 1.0);
 				textCoord.N() = textInfo.textureIndex;
 			}
 			else
@@ -2518,14 +2597,14 @@ namespace io {
 					if ((!coordinate.isNull() && (coordinate.attribute("point") != "")) || (geometry.tagName() == "ElevationGrid") || (geometry.tagName() == "Cylinder") || (geometry.tagName() == "Sphere"))
 					{
 						//Get coordinate 
-						QStringList coordList;
+						NumberList coordList;
 						findAndParseAttribute(coordList, coordinate, "point", "");
 						//GetColor
 						QString colorTag[] = {"Color", "ColorRGBA"};
 						QDomElement color = findNode(colorTag, 2, geometry);
 						result = solveDefUse(color, defMap, color, info);
 						if (result != E_NOERROR) return result;
-						QStringList colorList;
+						NumberList colorList;
 						findAndParseAttribute(colorList, color, "color", "");
 						if (!colorList.isEmpty())
 							info->meshColor = false;
@@ -2533,7 +2612,7 @@ namespace io {
 						QDomElement normal = geometry.firstChildElement("Normal");
 						result = solveDefUse(normal, defMap, normal, info);
 						if (result != E_NOERROR) return result;
-						QStringList normalList;
+						NumberList normalList;
 						findAndParseAttribute(normalList, normal, "vector", "");
 						//Get texture coordinate
 						QString textCoorTag[] = {"TextureCoordinate", "MultiTextureCoordinate", "TextureCoordinateGenerator"};
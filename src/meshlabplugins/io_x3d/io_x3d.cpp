@@ -26,6 +26,7 @@
 #include "io_x3d.h"
 
 #include "import_x3d.h"
+#include "x3d_stream_importer.h"
 #include "export_x3d.h"
 
 
@@ -47,6 +48,26 @@ bool IoX3DPlugin::open(const QString &formatName, const QString &fileName, MeshM
     string filename = QFile::encodeName(fileName).constData ();
     bool normalsUpdated = false;
     vcg::tri::io::AdditionalInfoX3D* info = NULL;
+    if (formatName.toUpper() == tr("X3D"))
+    {
+        // the streaming importer reads the common geometry without building the DOM;
+        // the documents it does not support, or cannot read, are loaded by the DOM importer,
+        // that also reports the errors
+        X3DStreamImporter importer;
+        if (importer.load(fileName, cb) == X3DStreamImporter::E_NOERROR)
+        {
+            m.Enable(importer.mask());
+            importer.fill(m.cm, cb);
+            mask = importer.mask();
+            vcg::tri::UpdateBounding<CMeshO>::Box(m.cm);
+            if (mask & vcg::tri::io::Mask::IOM_VERTNORMAL)
+                vcg::tri::UpdateNormal<CMeshO>::PerFace(m.cm);
+            else
+                vcg::tri::UpdateNormal<CMeshO>::PerVertexPerFace(m.cm);
+            if (cb != NULL)	(*cb)(99, "Done");
+            return true;
+        }
+    }
     if(formatName.toUpper() == tr("X3D") || formatName.toUpper() == tr("X3DV") || formatName.toUpper() == tr("WRL"))
     {
         int result;
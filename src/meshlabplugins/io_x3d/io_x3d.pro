@@ -4,12 +4,14 @@ HEADERS  += \
     io_x3d.h import_x3d.h\
     export_x3d.h util_x3d.h \
     vrml/Parser.h \
-    vrml/Scanner.h
+    vrml/Scanner.h \
+    x3d_stream_importer.h
 				
 SOURCES += \
     io_x3d.cpp \
     vrml/Parser.cpp \
-    vrml/Scanner.cpp
+    vrml/Scanner.cpp \
+    x3d_stream_importer.cpp
 				
 TARGET = io_x3d
 
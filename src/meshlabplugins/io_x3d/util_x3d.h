@@ -53,6 +53,8 @@
 #define UTILX3D
 
 #include<QtXml/QDomDocument>
+#include <algorithm>
+#include <vector>
 
 
 namespace vcg {
@@ -192,6 +194,34 @@ namespace io {
 
 	
 	
+	/*
+	NumberList
+	The values of a numeric field (MFFloat, MFInt32, MFVec3f...), decoded once in a
+	contiguous array instead of keeping a QString for each number.
+	*/
+	class NumberList
+	{
+	public:
+		int size() const { return int(values.size()); }
+		bool isEmpty() const { return values.empty(); }
+		void clear() { values.clear(); }
+
+		double at(int i) const { return values[i]; }
+		double operator[](int i) const { return values[i]; }
+
+		int indexOf(double value, int from = 0) const
+		{
+			for (int i = std::max(from, 0); i < size(); i++)
+				if (values[i] == value)
+					return i;
+			return -1;
+		}
+
+		std::vector<double> values;
+	};
+
+
+
 	class TextureInfo
 	{
 	public:
@@ -200,7 +230,7 @@ namespace io {
 		
 		vcg::Matrix33f textureTransform;
 
-		QStringList textureCoordList;
+		NumberList textureCoordList;
 
 		bool repeatS, repeatT;
 
@@ -0,0 +1,1027 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "x3d_stream_importer.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamReader>
+
+#include <common/utilities/ascii_chunk_reader.h>
+#include <wrap/io_trimesh/io_mask.h>
+
+namespace {
+
+// depth of the scene graph after which USE references are considered a loop
+const int MAX_NODE_DEPTH = 256;
+
+// the values of the numeric fields are separated by blanks and commas
+inline bool isSeparator(ushort c)
+{
+	return c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline void parseNumber(const char* begin, const char* end, double& v)
+{
+	AsciiChunkReader::toDouble(begin, end, v);
+}
+
+inline void parseNumber(const char* begin, const char* end, float& v)
+{
+	double d;
+	AsciiChunkReader::toDouble(begin, end, d);
+	v = float(d);
+}
+
+inline void parseNumber(const char* begin, const char* end, int& v)
+{
+	const char* p = begin;
+	const bool negative = (p < end && *p == '-');
+	if (p < end && (*p == '-' || *p == '+'))
+		++p;
+	int n = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+		n = n * 10 + (*p - '0');
+	// like QString::toInt(), malformed numbers are 0
+	v = (p == end) ? (negative ? -n : n) : 0;
+}
+
+// appends the numbers of an attribute value; they are counted first, to fill the values with a single allocation
+template <class T>
+void parseNumbers(const QStringRef& text, std::vector<T>& values)
+{
+	const QChar* begin = text.constData();
+	const QChar* end = begin + text.size();
+	size_t n = 0;
+	for (const QChar* p = begin; p < end; ++p)
+		if (!isSeparator(p->unicode()) && (p == begin || isSeparator(p[-1].unicode())))
+			++n;
+	values.reserve(values.size() + n);
+
+	// the numbers are short: each one is copied in a small buffer to be parsed
+	char buffer[64];
+	const QChar* p = begin;
+	while (p < end)
+	{
+		while (p < end && isSeparator(p->unicode()))
+			++p;
+		const QChar* s = p;
+		while (p < end && !isSeparator(p->unicode()))
+			++p;
+		if (p > s)
+		{
+			const int len = std::min(int(p - s), int(sizeof(buffer)));
+			for (int i = 0; i < len; ++i)
+				buffer[i] = s[i].toLatin1();
+			T v;
+			parseNumber(buffer, buffer + len, v);
+			values.push_back(v);
+		}
+	}
+}
+
+inline QStringRef value(const QXmlStreamAttributes& attributes, const char* name)
+{
+	return attributes.value(QLatin1String(name));
+}
+
+// the boolean fields, as the DOM importer: anything but the default is the other value
+inline bool isTrue(const QXmlStreamAttributes& attributes, const char* name)
+{
+	const QStringRef v = value(attributes, name);
+	return v.isEmpty() || v == QLatin1String("true");
+}
+
+inline bool isFalse(const QXmlStreamAttributes& attributes, const char* name)
+{
+	return value(attributes, name) == QLatin1String("false");
+}
+
+inline bool is(const QXmlStreamReader& xml, const char* name)
+{
+	return xml.name() == QLatin1String(name);
+}
+
+// the geometry nodes loaded by the DOM importer
+bool isGeometry(const QXmlStreamReader& xml)
+{
+	static const char* const names[] = {
+		"IndexedFaceSet", "IndexedTriangleSet", "IndexedTriangleFanSet", "IndexedTriangleStripSet",
+		"IndexedQuadSet", "TriangleSet", "QuadSet", "TriangleFanSet", "TriangleStripSet",
+		"ElevationGrid", "PointSet", "Cylinder", "Sphere", "Polypoint2D", "TriangleSet2D" };
+	for (const char* name : names)
+		if (is(xml, name))
+			return true;
+	return false;
+}
+
+// the transformation of a Transform node: T * C * R * SR * S * -SR * -C
+vcg::Matrix44d transformMatrix(const QXmlStreamAttributes& attributes)
+{
+	vcg::Matrix44d t, tmp;
+	t.SetIdentity();
+	std::vector<double> translation, center, rotation, scale, scaleOrientation;
+	parseNumbers(value(attributes, "translation"), translation);
+	parseNumbers(value(attributes, "center"), center);
+	parseNumbers(value(attributes, "rotation"), rotation);
+	parseNumbers(value(attributes, "scale"), scale);
+	parseNumbers(value(attributes, "scaleOrientation"), scaleOrientation);
+	if (translation.size() == 3)
+		t.SetTranslate(translation[0], translation[1], translation[2]);
+	if (center.size() == 3)
+	{
+		tmp.SetTranslate(center[0], center[1], center[2]);
+		t = t * tmp;
+	}
+	if (rotation.size() == 4)
+	{
+		tmp.SetRotateRad(rotation[3], vcg::Point3d(rotation[0], rotation[1], rotation[2]));
+		t = t * tmp;
+	}
+	if (scaleOrientation.size() == 4)
+	{
+		tmp.SetRotateRad(scaleOrientation[3], vcg::Point3d(scaleOrientation[0], scaleOrientation[1], scaleOrientation[2]));
+		t = t * tmp;
+	}
+	if (scale.size() == 3)
+	{
+		tmp.SetScale(scale[0], scale[1], scale[2]);
+		t = t * tmp;
+	}
+	if (scaleOrientation.size() == 4)
+	{
+		tmp.SetRotateRad(-scaleOrientation[3], vcg::Point3d(scaleOrientation[0], scaleOrientation[1], scaleOrientation[2]));
+		t = t * tmp;
+	}
+	if (center.size() == 3)
+	{
+		tmp.SetTranslate(-center[0], -center[1], -center[2]);
+		t = t * tmp;
+	}
+	return t;
+}
+
+}
+
+X3DStreamImporter::X3DStreamImporter() : progress(nullptr), vertNum(0), faceNum(0), loadMask(0)
+{
+}
+
+QString X3DStreamImporter::errorMsg(int error)
+{
+	switch (error)
+	{
+	case E_NOERROR: return "No error";
+	case E_CANTOPEN: return "Can't open file";
+	case E_INVALIDXML: return "Invalid XML";
+	case E_INVALIDFILE: return "Invalid X3D file";
+	case E_UNSUPPORTED: return "X3D content not supported by the streaming importer";
+	}
+	return "Unknown error";
+}
+
+int X3DStreamImporter::load(const QString& fileName, vcg::CallBackPos* cb)
+{
+	baseDir = QFileInfo(fileName).absolutePath();
+	int result = readDocument(fileName, QStringList(), cb);
+	if (result != E_NOERROR)
+		return result;
+
+	//the documents are complete: the geometries of all of them can be checked and counted
+	std::vector<X3DStreamImporter*> docs;
+	documents(docs);
+	std::vector<std::pair<X3DStreamImporter*, Geometry*> > all;
+	for (X3DStreamImporter* d : docs)
+		for (Geometry& g : d->geometries)
+			if (g.coord >= 0)
+				all.push_back(std::make_pair(d, &g));
+	std::vector<int> geometryResult(all.size(), E_NOERROR);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(all.size()); ++i)
+		geometryResult[i] = all[i].first->resolveGeometry(*all[i].second);
+	for (int r : geometryResult)
+		if (r != E_NOERROR)
+			return r;
+
+	//flatten the scene
+	vcg::Matrix44d identity;
+	identity.SetIdentity();
+	result = collectInstances(*this, 0, identity, 0);
+	if (result != E_NOERROR)
+		return result;
+	//nothing to place: leave the decision to the DOM importer
+	if (instances.empty())
+		return E_UNSUPPORTED;
+
+	bool hasNormal = true;
+	bool hasColor = false;
+	bool hasTexCoord = false;
+	for (const Instance& inst : instances)
+	{
+		const Geometry& g = inst.document->geometries[inst.geometry];
+		if (g.faceNum == 0)
+			continue;
+		hasNormal = hasNormal && (g.normal >= 0);
+		hasColor = hasColor || (g.color >= 0) || inst.hasMaterial;
+		hasTexCoord = hasTexCoord || (inst.texture >= 0);
+	}
+	loadMask = vcg::tri::io::Mask::IOM_VERTCOORD | vcg::tri::io::Mask::IOM_FACEINDEX;
+	//normals are used only if every face has them, otherwise they are computed as usual
+	if (hasNormal)
+		loadMask |= vcg::tri::io::Mask::IOM_VERTNORMAL;
+	if (hasColor)
+		loadMask |= vcg::tri::io::Mask::IOM_VERTCOLOR;
+	if (hasTexCoord)
+		loadMask |= vcg::tri::io::Mask::IOM_WEDGTEXCOORD;
+
+	//the vertices of each geometry depend on the attributes that are loaded
+	std::vector<std::pair<X3DStreamImporter*, Geometry*> > placed;
+	for (size_t i = 0; i < all.size(); ++i)
+		if (all[i].second->placed)
+			placed.push_back(all[i]);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(placed.size()); ++i)
+		placed[i].first->splitVertices(*placed[i].second, loadMask);
+	for (Instance& inst : instances)
+	{
+		const Geometry& g = inst.document->geometries[inst.geometry];
+		inst.vertBase = vertNum;
+		inst.faceBase = faceNum;
+		vertNum += g.vertex.size();
+		faceNum += g.faceNum;
+	}
+	//only coordinates, maybe of points: leave the decision to the DOM importer
+	if (faceNum == 0)
+		return E_UNSUPPORTED;
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readDocument(const QString& fileName, const QStringList& ancestors, vcg::CallBackPos* cb)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return E_CANTOPEN;
+	fileStack = ancestors;
+	fileStack.push_back(QFileInfo(fileName).canonicalFilePath());
+	progress = cb;
+
+	nodes.assign(1, Node());
+	nodes[0].transform.SetIdentity();
+	QXmlStreamReader xml(&file);
+	int result = E_NOERROR;
+	int scenes = 0;
+	while (result == E_NOERROR && !xml.atEnd())
+	{
+		xml.readNext();
+		if (!xml.isStartElement() || is(xml, "X3D"))
+			continue;
+		if (is(xml, "Scene"))
+		{
+			//the DOM importer reports the documents with more scenes
+			if (scenes++ > 0)
+				return E_UNSUPPORTED;
+			while (result == E_NOERROR && xml.readNextStartElement())
+				result = readChild(xml, 0);
+		}
+		else
+			xml.skipCurrentElement();
+	}
+	progress = nullptr;
+	if (xml.hasError())
+		return E_INVALIDXML;
+	if (result != E_NOERROR)
+		return result;
+	if (scenes == 0)
+		return E_UNSUPPORTED;
+
+	//the linked documents are read concurrently
+	std::vector<QString> files(inlineDocuments.size());
+	for (std::map<QString, int>::const_iterator it = inlineIndex.begin(); it != inlineIndex.end(); ++it)
+		files[it->second] = it->first;
+	std::vector<int> inlineResult(inlineDocuments.size(), E_NOERROR);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(inlineDocuments.size()); ++i)
+	{
+		inlineDocuments[i]->baseDir = baseDir;
+		inlineResult[i] = inlineDocuments[i]->readDocument(files[i], fileStack, nullptr);
+	}
+	for (int r : inlineResult)
+		if (r != E_NOERROR)
+			return r;
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readChild(QXmlStreamReader& xml, int parent)
+{
+	if (is(xml, "Shape"))
+		return readShape(xml, parent);
+	if (is(xml, "Inline"))
+		return readInline(xml, parent);
+	if (is(xml, "ProtoDeclare") || is(xml, "ExternProtoDeclare") || is(xml, "ProtoInstance"))
+		return E_UNSUPPORTED;
+	//Transform, Group, Switch, LOD and any other node that may contain shapes
+	return readGroup(xml, parent);
+}
+
+int X3DStreamImporter::readGroup(QXmlStreamReader& xml, int parent)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	const QString tag = xml.name().toString();
+	int index, result;
+	if (use(attributes, tag, index, result))
+	{
+		if (index >= 0)
+			nodes[parent].children.push_back(index);
+		xml.skipCurrentElement();
+		return result;
+	}
+	index = int(nodes.size());
+	nodes.push_back(Node());
+	nodes[index].transform.SetIdentity();
+	if (tag == "Transform")
+		nodes[index].transform = transformMatrix(attributes);
+
+	//Switch keeps only the chosen child and LOD the first one, moved to its center as the DOM
+	//importer does; the other children are read anyway, since their DEF names can be used later
+	const bool select = (tag == "Switch" || tag == "LOD");
+	int choice = 0;
+	if (tag == "Switch")
+	{
+		const QStringRef which = value(attributes, "whichChoice");
+		choice = which.isEmpty() ? -1 : which.toInt();
+	}
+	else if (tag == "LOD")
+	{
+		std::vector<double> center;
+		parseNumbers(value(attributes, "center"), center);
+		if (center.size() == 3)
+			nodes[index].transform.SetTranslate(center[0], center[1], center[2]);
+	}
+	for (int k = 0; xml.readNextStartElement(); ++k)
+	{
+		if (!select || k == choice)
+			result = readChild(xml, index);
+		else
+		{
+			const int discarded = int(nodes.size());
+			nodes.push_back(Node());
+			nodes[discarded].transform.SetIdentity();
+			result = readChild(xml, discarded);
+		}
+		if (result != E_NOERROR)
+			return result;
+	}
+	define(attributes, tag, index);
+	nodes[parent].children.push_back(index);
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readShape(QXmlStreamReader& xml, int parent)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	int index, result;
+	if (use(attributes, "Shape", index, result))
+	{
+		if (index >= 0)
+			nodes[parent].shapes.push_back(index);
+		xml.skipCurrentElement();
+		return result;
+	}
+	Shape shape;
+	while (xml.readNextStartElement())
+	{
+		result = E_NOERROR;
+		if (is(xml, "Appearance"))
+			result = readAppearance(xml, shape.appearance);
+		else if (shape.geometry < 0 && isGeometry(xml))
+		{
+			//as the DOM importer, the first geometry with coordinates is loaded
+			int g = -1;
+			result = readGeometry(xml, g);
+			if (g >= 0 && geometries[g].coord >= 0 && arrays[geometries[g].coord].count() > 0)
+				shape.geometry = g;
+		}
+		else
+			xml.skipCurrentElement();
+		if (result != E_NOERROR)
+			return result;
+	}
+	index = int(shapes.size());
+	shapes.push_back(shape);
+	define(attributes, "Shape", index);
+	nodes[parent].shapes.push_back(index);
+	if (progress)
+		progress(int(50 * double(xml.device()->pos()) / double(std::max<qint64>(xml.device()->size(), 1))), "Reading X3D document");
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readAppearance(QXmlStreamReader& xml, int& index)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	int result;
+	if (use(attributes, "Appearance", index, result))
+	{
+		xml.skipCurrentElement();
+		return result;
+	}
+	Appearance appearance;
+	int textureNum = 0;
+	while (xml.readNextStartElement())
+	{
+		const QXmlStreamAttributes child = xml.attributes();
+		result = E_NOERROR;
+		if (is(xml, "Material"))
+		{
+			int m;
+			if (!use(child, "Material", m, result))
+			{
+				//as the DOM importer, only a given diffuse color is used
+				std::vector<double> diffuse;
+				parseNumbers(value(child, "diffuseColor"), diffuse);
+				m = -1;
+				if (diffuse.size() >= 3)
+				{
+					const double transparency = value(child, "transparency").toDouble();
+					vcg::Color4b c;
+					c.Import(vcg::Color4f(diffuse[0], diffuse[1], diffuse[2], 1.0 - transparency));
+					m = int(materials.size());
+					materials.push_back(c);
+				}
+				define(child, "Material", m);
+			}
+			appearance.material = m;
+		}
+		else if (is(xml, "ImageTexture"))
+		{
+			++textureNum;
+			int t;
+			if (!use(child, "ImageTexture", t, result))
+			{
+				Texture texture;
+				const QString url = value(child, "url").toString();
+				texture.file = existingFile(url);
+				//the DOM importer reports the missing texture files
+				if (texture.file.isEmpty() && !url.trimmed().isEmpty())
+					return E_UNSUPPORTED;
+				texture.repeatS = isTrue(child, "repeatS");
+				texture.repeatT = isTrue(child, "repeatT");
+				t = int(imageTextures.size());
+				imageTextures.push_back(texture);
+				define(child, "ImageTexture", t);
+			}
+			appearance.texture = t;
+		}
+		else if (is(xml, "MultiTexture") || is(xml, "TextureTransform"))
+			return E_UNSUPPORTED;
+		xml.skipCurrentElement();
+		if (result != E_NOERROR)
+			return result;
+	}
+	//the DOM importer reports more textures without a MultiTexture
+	if (textureNum > 1)
+		return E_INVALIDFILE;
+	index = int(appearances.size());
+	appearances.push_back(appearance);
+	define(attributes, "Appearance", index);
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readGeometry(QXmlStreamReader& xml, int& index)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	const QString tag = xml.name().toString();
+	int result;
+	if (use(attributes, tag, index, result))
+	{
+		xml.skipCurrentElement();
+		return result;
+	}
+	Geometry g;
+	if (tag == "IndexedFaceSet")
+	{
+		g.type = POLYGONS;
+		parseNumbers(value(attributes, "coordIndex"), g.coordIndex);
+		parseNumbers(value(attributes, "normalIndex"), g.normalIndex);
+		parseNumbers(value(attributes, "colorIndex"), g.colorIndex);
+		parseNumbers(value(attributes, "texCoordIndex"), g.texCoordIndex);
+	}
+	else if (tag == "IndexedTriangleSet" || tag == "IndexedQuadSet" ||
+		tag == "IndexedTriangleFanSet" || tag == "IndexedTriangleStripSet")
+	{
+		if (tag == "IndexedTriangleSet")
+			g.type = TRIANGLES;
+		else if (tag == "IndexedQuadSet")
+			g.type = QUADS;
+		else
+			g.type = (tag == "IndexedTriangleFanSet") ? FANS : STRIPS;
+		parseNumbers(value(attributes, "index"), g.coordIndex);
+	}
+	else if (tag == "TriangleSet" || tag == "QuadSet")
+	{
+		g.type = (tag == "TriangleSet") ? TRIANGLES : QUADS;
+		g.indexed = false;
+	}
+	else
+		return E_UNSUPPORTED;
+	g.ccw = !isFalse(attributes, "ccw");
+	g.convex = !isFalse(attributes, "convex");
+
+	while (xml.readNextStartElement())
+	{
+		result = E_NOERROR;
+		if (is(xml, "Coordinate") || is(xml, "CoordinateDouble"))
+			result = readArray(xml, "point", 3, g.coord);
+		else if (is(xml, "Color"))
+			result = readArray(xml, "color", 3, g.color);
+		else if (is(xml, "ColorRGBA"))
+			result = readArray(xml, "color", 4, g.color);
+		else if (is(xml, "Normal"))
+			result = readArray(xml, "vector", 3, g.normal);
+		else if (is(xml, "TextureCoordinate"))
+			result = readArray(xml, "point", 2, g.texCoord);
+		else if (is(xml, "TextureCoordinateGenerator") || is(xml, "MultiTextureCoordinate"))
+			return E_UNSUPPORTED;
+		else
+			xml.skipCurrentElement();
+		if (result != E_NOERROR)
+			return result;
+	}
+	//per face colors and normals are left to the DOM importer
+	if ((g.color >= 0 && isFalse(attributes, "colorPerVertex")) || (g.normal >= 0 && isFalse(attributes, "normalPerVertex")))
+		return E_UNSUPPORTED;
+
+	index = int(geometries.size());
+	geometries.push_back(Geometry());
+	std::swap(geometries.back(), g);
+	define(attributes, tag, index);
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::readArray(QXmlStreamReader& xml, const char* field, int stride, int& index)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	const QString tag = xml.name().toString();
+	int result = E_NOERROR;
+	if (!use(attributes, tag, index, result))
+	{
+		index = int(arrays.size());
+		arrays.push_back(Array());
+		arrays.back().stride = stride;
+		parseNumbers(value(attributes, field), arrays.back().data);
+		define(attributes, tag, index);
+	}
+	xml.skipCurrentElement();
+	return result;
+}
+
+int X3DStreamImporter::readInline(QXmlStreamReader& xml, int parent)
+{
+	const QXmlStreamAttributes attributes = xml.attributes();
+	int index, result;
+	const bool used = use(attributes, "Inline", index, result);
+	xml.skipCurrentElement();
+	if (used)
+	{
+		if (index >= 0)
+			nodes[parent].inlines.push_back(index);
+		return result;
+	}
+	index = -1;
+	if (isTrue(attributes, "load"))
+	{
+		//the DOM importer reports the missing files and the loops
+		const QString path = existingFile(value(attributes, "url").toString());
+		if (path.isEmpty())
+			return E_INVALIDFILE;
+		const QFileInfo info(QDir(baseDir), path);
+		if (info.suffix().toLower() != "x3d")
+			return E_UNSUPPORTED;
+		const QString file = info.canonicalFilePath();
+		if (fileStack.contains(file))
+			return E_INVALIDFILE;
+		std::map<QString, int>::const_iterator it = inlineIndex.find(file);
+		if (it == inlineIndex.end())
+		{
+			index = int(inlineDocuments.size());
+			inlineDocuments.push_back(std::unique_ptr<X3DStreamImporter>(new X3DStreamImporter()));
+			inlineIndex[file] = index;
+		}
+		else
+			index = it->second;
+		nodes[parent].inlines.push_back(index);
+	}
+	define(attributes, "Inline", index);
+	return E_NOERROR;
+}
+
+bool X3DStreamImporter::use(const QXmlStreamAttributes& attributes, const QString& tag, int& index, int& result) const
+{
+	const QString name = value(attributes, "USE").toString();
+	if (name.isEmpty())
+		return false;
+	//as in the DOM importer, a USE without a previous DEF is an empty node
+	index = -1;
+	result = E_NOERROR;
+	std::map<QString, std::pair<QString, int> >::const_iterator it = defs.find(name);
+	if (it != defs.end())
+	{
+		if (it->second.first == tag)
+			index = it->second.second;
+		else
+			result = E_INVALIDFILE;
+	}
+	return true;
+}
+
+void X3DStreamImporter::define(const QXmlStreamAttributes& attributes, const QString& tag, int index)
+{
+	const QString name = value(attributes, "DEF").toString();
+	if (!name.isEmpty() && defs.find(name) == defs.end())
+		defs[name] = std::make_pair(tag, index);
+}
+
+QString X3DStreamImporter::existingFile(const QString& url) const
+{
+	const QStringList paths = url.split(" ", QString::SkipEmptyParts);
+	for (const QString& p : paths)
+	{
+		const QString path = p.trimmed().remove('"');
+		if (!path.isEmpty() && QFileInfo(QDir(baseDir), path).exists())
+			return path;
+	}
+	return QString();
+}
+
+int X3DStreamImporter::resolveGeometry(Geometry& g) const
+{
+	const Array& coord = arrays[g.coord];
+	const int coordNum = int(coord.count());
+	if (g.normal >= 0 && arrays[g.normal].count() == 0)
+		g.normal = -1;
+	if (g.color >= 0 && arrays[g.color].count() == 0)
+		g.color = -1;
+	if (g.texCoord >= 0 && arrays[g.texCoord].count() == 0)
+		g.texCoord = -1;
+	if (g.normal < 0)
+		g.normalIndex.clear();
+	if (g.color < 0)
+		g.colorIndex.clear();
+	if (g.texCoord < 0)
+		g.texCoordIndex.clear();
+
+	//the coordinates of the sets that are not indexed are taken in order
+	if (!g.indexed)
+	{
+		g.coordIndex.resize(size_t(coordNum));
+		for (int i = 0; i < coordNum; ++i)
+			g.coordIndex[i] = i;
+	}
+	const std::vector<int> raw = std::move(g.coordIndex);
+	g.coordIndex.clear();
+
+	//the other indices of a corner are at its position in coordIndex
+	std::vector<int>* other[] = { &g.normalIndex, &g.colorIndex, &g.texCoordIndex };
+	std::vector<int> otherRaw[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		if (other[a]->empty())
+			continue;
+		if (other[a]->size() < raw.size())
+			return E_UNSUPPORTED;
+		otherRaw[a] = std::move(*other[a]);
+		other[a]->clear();
+	}
+
+	g.first.clear();
+	g.faceNum = 0;
+	if (g.type == TRIANGLES || g.type == QUADS)
+	{
+		const size_t n = (g.type == TRIANGLES) ? 3 : 4;
+		const size_t corners = raw.size() - raw.size() % n;
+		g.coordIndex.assign(raw.begin(), raw.begin() + corners);
+		for (int a = 0; a < 3; ++a)
+			if (!otherRaw[a].empty())
+				other[a]->assign(otherRaw[a].begin(), otherRaw[a].begin() + corners);
+		g.faceNum = (corners / n) * (n - 2);
+	}
+	else
+	{
+		//polygons, fans and strips are separated by -1
+		size_t begin = 0;
+		for (size_t i = 0; i <= raw.size(); ++i)
+		{
+			if (i == raw.size() || raw[i] == -1)
+			{
+				const size_t n = g.coordIndex.size() - begin;
+				if (n == 0)
+					continue;
+				if (n < 3)
+					return E_INVALIDFILE;
+				//the DOM importer tessellates the non convex polygons
+				if (g.type == POLYGONS && n > 3 && !g.convex)
+					return E_UNSUPPORTED;
+				g.first.push_back(begin);
+				g.faceNum += n - 2;
+				begin = g.coordIndex.size();
+				continue;
+			}
+			g.coordIndex.push_back(raw[i]);
+			for (int a = 0; a < 3; ++a)
+				if (!otherRaw[a].empty())
+					other[a]->push_back(otherRaw[a][i]);
+		}
+		g.first.push_back(g.coordIndex.size());
+	}
+
+	//indices out of range would read outside the arrays
+	const int attributeArray[] = { g.normal, g.color, g.texCoord };
+	for (size_t c = 0; c < g.coordIndex.size(); ++c)
+	{
+		const int v = g.coordIndex[c];
+		if (v < 0 || v >= coordNum)
+			return E_INVALIDFILE;
+		for (int a = 0; a < 3; ++a)
+		{
+			if (attributeArray[a] < 0)
+				continue;
+			const int i = other[a]->empty() ? v : (*other[a])[c];
+			if (i < 0 || size_t(i) >= arrays[attributeArray[a]].count())
+				return E_INVALIDFILE;
+		}
+	}
+	return E_NOERROR;
+}
+
+void X3DStreamImporter::splitVertices(Geometry& g, int mask) const
+{
+	const bool loadNormal = (mask & vcg::tri::io::Mask::IOM_VERTNORMAL) != 0 && g.normal >= 0;
+	const bool loadColor = (mask & vcg::tri::io::Mask::IOM_VERTCOLOR) != 0 && g.color >= 0;
+	const size_t cn = arrays[g.coord].count();
+	//the vertex of each coordinate gets the attributes of its first corner; the corners
+	//with different attributes get a copy, the copies of a coordinate are chained in next
+	g.vertex.assign(cn, SplitVertex());
+	for (size_t i = 0; i < cn; ++i)
+		g.vertex[i].coord = int(i);
+	std::vector<char> assigned(cn, 0);
+	std::vector<int> next(cn, -1);
+	const size_t corners = g.coordIndex.size();
+	g.cornerVertex.resize(corners);
+	for (size_t c = 0; c < corners; ++c)
+	{
+		SplitVertex sv;
+		sv.coord = g.coordIndex[c];
+		if (loadNormal)
+			sv.normal = g.normalIndex.empty() ? sv.coord : g.normalIndex[c];
+		if (loadColor)
+			sv.color = g.colorIndex.empty() ? sv.coord : g.colorIndex[c];
+		int v = sv.coord;
+		if (!assigned[v])
+		{
+			assigned[v] = 1;
+			g.vertex[v] = sv;
+		}
+		else
+		{
+			while (!(g.vertex[v] == sv) && next[v] >= 0)
+				v = next[v];
+			if (!(g.vertex[v] == sv))
+			{
+				next[v] = int(g.vertex.size());
+				g.vertex.push_back(sv);
+				next.push_back(-1);
+				v = next[v];
+			}
+		}
+		g.cornerVertex[c] = v;
+	}
+}
+
+void X3DStreamImporter::documents(std::vector<X3DStreamImporter*>& list)
+{
+	list.push_back(this);
+	for (std::unique_ptr<X3DStreamImporter>& d : inlineDocuments)
+		d->documents(list);
+}
+
+int X3DStreamImporter::collectInstances(X3DStreamImporter& document, int node, const vcg::Matrix44d& parent, int depth)
+{
+	if (depth > MAX_NODE_DEPTH)
+		return E_INVALIDFILE;
+	const vcg::Matrix44d transform = parent * document.nodes[node].transform;
+	for (int s : document.nodes[node].shapes)
+	{
+		const Shape& shape = document.shapes[s];
+		if (shape.geometry < 0)
+			continue;
+		Geometry& g = document.geometries[shape.geometry];
+		Instance inst;
+		inst.document = &document;
+		inst.geometry = shape.geometry;
+		inst.transform = transform;
+		inst.texture = -1;
+		inst.repeatS = inst.repeatT = true;
+		inst.hasMaterial = false;
+		inst.color = vcg::Color4b(vcg::Color4b::White);
+		if (shape.appearance >= 0)
+		{
+			const Appearance& a = document.appearances[shape.appearance];
+			if (a.material >= 0)
+			{
+				inst.hasMaterial = true;
+				inst.color = document.materials[a.material];
+			}
+			if (a.texture >= 0 && !document.imageTextures[a.texture].file.isEmpty())
+			{
+				//without texture coordinates the DOM importer generates them
+				if (g.texCoord < 0)
+					return E_UNSUPPORTED;
+				const Texture& t = document.imageTextures[a.texture];
+				inst.texture = textureIndex(t.file);
+				inst.repeatS = t.repeatS;
+				inst.repeatT = t.repeatT;
+			}
+		}
+		g.placed = true;
+		instances.push_back(inst);
+	}
+	for (size_t i = 0; i < document.nodes[node].children.size(); ++i)
+	{
+		int result = collectInstances(document, document.nodes[node].children[i], transform, depth + 1);
+		if (result != E_NOERROR)
+			return result;
+	}
+	for (size_t i = 0; i < document.nodes[node].inlines.size(); ++i)
+	{
+		int result = collectInstances(*document.inlineDocuments[document.nodes[node].inlines[i]], 0, transform, depth + 1);
+		if (result != E_NOERROR)
+			return result;
+	}
+	return E_NOERROR;
+}
+
+int X3DStreamImporter::textureIndex(const QString& file)
+{
+	std::map<QString, int>::const_iterator it = textureIndexes.find(file);
+	if (it != textureIndexes.end())
+		return it->second;
+	const int index = int(textures.size());
+	textures.push_back(file.toStdString());
+	textureIndexes[file] = index;
+	return index;
+}
+
+void X3DStreamImporter::fill(CMeshO& m, vcg::CallBackPos* cb) const
+{
+	const int textureBase = int(m.textures.size());
+	m.textures.insert(m.textures.end(), textures.begin(), textures.end());
+	const size_t vertBase = m.vert.size();
+	const size_t faceBase = m.face.size();
+	vcg::tri::Allocator<CMeshO>::AddVertices(m, vertNum);
+	vcg::tri::Allocator<CMeshO>::AddFaces(m, faceNum);
+	if (cb)
+		cb(60, "Building mesh");
+
+	//each instance has its own vertices and faces
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(instances.size()); ++i)
+	{
+		Instance inst = instances[i];
+		inst.vertBase += vertBase;
+		inst.faceBase += faceBase;
+		fillInstance(m, inst, textureBase);
+	}
+	if (cb)
+		cb(90, "Building mesh");
+}
+
+void X3DStreamImporter::fillInstance(CMeshO& m, const Instance& inst, int textureBase) const
+{
+	const X3DStreamImporter& doc = *inst.document;
+	const Geometry& g = doc.geometries[inst.geometry];
+	const Array& coord = doc.arrays[g.coord];
+	const vcg::Matrix44d& tr = inst.transform;
+	//normals are transformed by the inverse transpose
+	vcg::Matrix44d nm = vcg::Inverse(tr);
+	nm.transposeInPlace();
+	const bool loadColor = (loadMask & vcg::tri::io::Mask::IOM_VERTCOLOR) != 0;
+	const size_t vn = g.vertex.size();
+	for (size_t i = 0; i < vn; ++i)
+	{
+		const SplitVertex& sv = g.vertex[i];
+		CVertexO& vert = m.vert[inst.vertBase + i];
+		const Scalarm* p = &coord.data[size_t(sv.coord) * 3];
+		vert.P() = Point3m::Construct(tr * vcg::Point3d(p[0], p[1], p[2]));
+		if (sv.normal >= 0)
+		{
+			const Scalarm* n = &doc.arrays[g.normal].data[size_t(sv.normal) * 3];
+			vcg::Point3d d(0, 0, 0);
+			for (int r = 0; r < 3; ++r)
+				d[r] = nm[r][0] * n[0] + nm[r][1] * n[1] + nm[r][2] * n[2];
+			vert.N() = Point3m::Construct(d.Normalize());
+		}
+		if (loadColor)
+		{
+			if (sv.color >= 0)
+			{
+				const Array& a = doc.arrays[g.color];
+				const Scalarm* c = &a.data[size_t(sv.color) * a.stride];
+				vert.C().Import(vcg::Color4f(c[0], c[1], c[2], (a.stride > 3) ? c[3] : 1.0f));
+			}
+			else
+				vert.C() = inst.color;
+		}
+	}
+
+	const bool loadTexCoord = (loadMask & vcg::tri::io::Mask::IOM_WEDGTEXCOORD) != 0;
+	const bool textured = (inst.texture >= 0);
+	size_t f = inst.faceBase;
+	auto corner = [&](CFaceO& face, int k, size_t c)
+	{
+		face.V(k) = &m.vert[inst.vertBase + g.cornerVertex[c]];
+		if (!loadTexCoord)
+			return;
+		face.WT(k) = vcg::TexCoord2<float>(0, 0);
+		face.WT(k).N() = -1;
+		if (textured)
+		{
+			const int i = g.texCoordIndex.empty() ? g.coordIndex[c] : g.texCoordIndex[c];
+			const Scalarm* t = &doc.arrays[g.texCoord].data[size_t(i) * 2];
+			float u = float(t[0]);
+			float v = float(t[1]);
+			//as the DOM importer, the coordinates of a clamped texture are clamped
+			if (!inst.repeatS)
+				u = std::min(std::max(u, 0.0f), 1.0f);
+			if (!inst.repeatT)
+				v = std::min(std::max(v, 0.0f), 1.0f);
+			face.WT(k).U() = u;
+			face.WT(k).V() = v;
+			face.WT(k).N() = textureBase + inst.texture;
+		}
+	};
+	auto triangle = [&](size_t a, size_t b, size_t c)
+	{
+		if (!g.ccw)
+			std::swap(a, c);
+		CFaceO& face = m.face[f++];
+		corner(face, 0, a);
+		corner(face, 1, b);
+		corner(face, 2, c);
+	};
+
+	if (g.type == TRIANGLES)
+	{
+		for (size_t t = 0; t < g.faceNum; ++t)
+			triangle(3 * t, 3 * t + 1, 3 * t + 2);
+		return;
+	}
+	if (g.type == QUADS)
+	{
+		for (size_t q = 0; q < g.faceNum / 2; ++q)
+		{
+			triangle(4 * q, 4 * q + 1, 4 * q + 2);
+			triangle(4 * q, 4 * q + 2, 4 * q + 3);
+		}
+		return;
+	}
+	for (size_t i = 0; i + 1 < g.first.size(); ++i)
+	{
+		const size_t b = g.first[i];
+		const size_t e = g.first[i + 1];
+		for (size_t j = b; j + 2 < e; ++j)
+		{
+			if (g.type == STRIPS)
+			{
+				//every other triangle of a strip is flipped to keep the orientation
+				if ((j - b) % 2 == 0)
+					triangle(j, j + 1, j + 2);
+				else
+					triangle(j + 1, j, j + 2);
+			}
+			else
+				triangle(b, j + 1, j + 2); // polygons and fans
+		}
+	}
+}
@@ -0,0 +1,220 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2020                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef IO_X3D_STREAM_IMPORTER_H
+#define IO_X3D_STREAM_IMPORTER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include <common/ml_document/cmesh.h>
+
+class QXmlStreamReader;
+class QXmlStreamAttributes;
+
+/*
+X3DStreamImporter
+Loads the geometry of an X3D document (XML encoding) with a pull parser (QXmlStreamReader),
+without building the DOM of the document.
+
+The numeric fields (point, color, vector, coordIndex, index...) are decoded from the
+attributes while they are read, directly in typed buffers. The .x3d files linked by
+Inline nodes are read concurrently, each one by its own importer with its own DEF names.
+Once every document has been read, the geometries are checked in parallel and the scene
+is flattened in a list of geometry instances; the final size of the mesh is then known,
+the mesh is allocated once and the instances are copied in parallel, each one in its own
+range of vertices and faces.
+
+Supported: IndexedFaceSet (convex polygons), IndexedTriangleSet, IndexedTriangleFanSet,
+IndexedTriangleStripSet, IndexedQuadSet, TriangleSet and QuadSet, with per vertex colors
+and normals and texture coordinates (per wedge, with the ImageTexture of the appearance).
+As in the COLLADA importer, a coordinate whose corners reference different normals or
+colors is split in one vertex per distinct (coordinate, normal, color) index tuple; the
+material diffuse color is used for the vertices without a color. Transform, Group, Switch,
+LOD (its first level, as the DOM importer), Inline and DEF/USE are supported.
+Documents using anything else that affects the geometry (prototypes, the other geometry
+nodes, per face colors or normals, texture coordinate generators, multitexturing, texture
+transforms, non convex polygons, VRML inlines) are reported as E_UNSUPPORTED, so that the
+caller can use the DOM importer instead.
+*/
+class X3DStreamImporter
+{
+public:
+	enum Error
+	{
+		E_NOERROR = 0,
+		E_CANTOPEN,
+		E_INVALIDXML,
+		E_INVALIDFILE,
+		E_UNSUPPORTED
+	};
+
+	X3DStreamImporter();
+
+	// reads the document and the linked ones and prepares the instances of the scene
+	int load(const QString& fileName, vcg::CallBackPos* cb = nullptr);
+
+	// the components of the mesh that fill() sets; they must be enabled before calling it
+	int mask() const { return loadMask; }
+
+	void fill(CMeshO& m, vcg::CallBackPos* cb = nullptr) const;
+
+	static QString errorMsg(int error);
+
+private:
+	// how the corners of a geometry form its faces
+	enum GeometryType { TRIANGLES, QUADS, POLYGONS, FANS, STRIPS };
+
+	struct Array
+	{
+		std::vector<Scalarm> data;
+		int stride;
+		Array() : stride(1) {}
+		size_t count() const { return data.size() / size_t(stride); }
+	};
+
+	// a vertex of the mesh: a coordinate with the normal and color of its corners (-1 if missing)
+	struct SplitVertex
+	{
+		int coord;
+		int normal;
+		int color;
+		SplitVertex() : coord(-1), normal(-1), color(-1) {}
+		bool operator==(const SplitVertex& o) const
+		{
+			return coord == o.coord && normal == o.normal && color == o.color;
+		}
+	};
+
+	struct Geometry
+	{
+		int type;
+		bool indexed;
+		bool ccw;
+		bool convex;
+		int coord, normal, color, texCoord; // arrays, -1 if missing
+		// as read, with the -1 separators; once resolved, the indices of each corner
+		// (the normal, color and texture coordinate ones are empty if they are the coordinate ones)
+		std::vector<int> coordIndex, normalIndex, colorIndex, texCoordIndex;
+		// corners of the polygon, fan or strip i: first[i] ... first[i+1]-1
+		std::vector<size_t> first;
+		size_t faceNum;
+		bool placed;
+		// the first ones are the coordinates, in order; the split copies follow
+		std::vector<SplitVertex> vertex;
+		std::vector<int> cornerVertex; // vertex of each corner
+		Geometry() : type(TRIANGLES), indexed(true), ccw(true), convex(true),
+			coord(-1), normal(-1), color(-1), texCoord(-1), faceNum(0), placed(false) {}
+	};
+
+	struct Texture
+	{
+		QString file; // empty if the url is empty
+		bool repeatS, repeatT;
+	};
+
+	struct Appearance
+	{
+		int texture;  // -1 if missing
+		int material; // -1 if missing or without a diffuse color
+		Appearance() : texture(-1), material(-1) {}
+	};
+
+	struct Shape
+	{
+		int geometry; // the first one with coordinates
+		int appearance;
+		Shape() : geometry(-1), appearance(-1) {}
+	};
+
+	struct Node
+	{
+		vcg::Matrix44d transform;
+		std::vector<int> children;
+		std::vector<int> shapes;
+		std::vector<int> inlines;
+	};
+
+	// a geometry placed in the scene
+	struct Instance
+	{
+		const X3DStreamImporter* document;
+		int geometry;
+		vcg::Matrix44d transform;
+		int texture;
+		bool repeatS, repeatT;
+		bool hasMaterial;
+		vcg::Color4b color; // of the vertices without a color
+		size_t vertBase;
+		size_t faceBase;
+	};
+
+	int readDocument(const QString& fileName, const QStringList& ancestors, vcg::CallBackPos* cb);
+	int readChild(QXmlStreamReader& xml, int parent);
+	int readGroup(QXmlStreamReader& xml, int parent);
+	int readShape(QXmlStreamReader& xml, int parent);
+	int readAppearance(QXmlStreamReader& xml, int& index);
+	int readGeometry(QXmlStreamReader& xml, int& index);
+	int readArray(QXmlStreamReader& xml, const char* field, int stride, int& index);
+	int readInline(QXmlStreamReader& xml, int parent);
+
+	bool use(const QXmlStreamAttributes& attributes, const QString& tag, int& index, int& result) const;
+	void define(const QXmlStreamAttributes& attributes, const QString& tag, int index);
+	QString existingFile(const QString& url) const;
+
+	int resolveGeometry(Geometry& geometry) const;
+	void splitVertices(Geometry& geometry, int mask) const;
+	void documents(std::vector<X3DStreamImporter*>& list);
+	int collectInstances(X3DStreamImporter& document, int node, const vcg::Matrix44d& parent, int depth);
+	int textureIndex(const QString& file);
+	void fillInstance(CMeshO& m, const Instance& instance, int textureBase) const;
+
+	QString baseDir; // relative urls are resolved from the directory of the main document
+	QStringList fileStack; // this document and the ones linking to it, to find the loops
+	vcg::CallBackPos* progress;
+
+	std::vector<Array> arrays;
+	std::vector<Geometry> geometries;
+	std::vector<Texture> imageTextures;
+	std::vector<vcg::Color4b> materials;
+	std::vector<Appearance> appearances;
+	std::vector<Shape> shapes;
+	std::vector<Node> nodes; // nodes[0] is the scene
+	std::map<QString, std::pair<QString, int> > defs; // DEF name -> element name, index
+	std::vector<std::unique_ptr<X3DStreamImporter> > inlineDocuments;
+	std::map<QString, int> inlineIndex; // file -> index in inlineDocuments
+
+	std::vector<Instance> instances;
+	std::vector<std::string> textures;
+	std::map<QString, int> textureIndexes;
+	size_t vertNum;
+	size_t faceNum;
+	int loadMask;
+};
+
+#endif // IO_X3D_STREAM_IMPORTER_H
@@ -27,6 +27,7 @@
 #include <common/pluginmanager.h>
 #include <common/filterscript.h>
 #include <common/meshlabdocumentxml.h>
+#include <common/meshlabdocumentpack.h>
 #include <common/meshlabdocumentbundler.h>
 #include <common/mlexception.h>
 #include <common/parameters/rich_parameter_list.h>
@@ -39,6 +40,9 @@
 #include <QFileInfo>
 #include <QElapsedTimer>
 #include <QSettings>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 
 class FilterData
@@ -227,6 +231,9 @@ public:
         }
 
         // optional saving parameters (like ascii/binary encoding)
+        // all the components of the mesh must be available to the exporter
+        mm->updateDataMask(mm->pendingDataMask());
+
         RichParameterList savePar;
         pCurrentIOPlugin->initSaveParameter(extension, *mm, savePar);
         if(savePar.hasParameter("Binary")){
@@ -412,7 +419,7 @@ public:
         QFileInfo fi(fileName);
         //lastUsedDirectory = fi.absoluteDir();
         //TODO: move this to main()
-        if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp")  && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower()!="out") && (fi.suffix().toLower()!="nvm"))
+        if((fi.suffix().toLower()!="aln") && (fi.suffix().toLower()!="mlp")  && (fi.suffix().toLower() != "mlb") && (fi.suffix().toLower() != "mlz") && (fi.suffix().toLower()!="out") && (fi.suffix().toLower()!="nvm"))
         {
             //QMessageBox::critical(this, tr("Meshlab Opening Error"), "Unknown project file extension");
             fprintf(fp, "Meshlab Opening Error: Unknown project file extension\n");
@@ -502,6 +509,18 @@ public:
     /////////////////////////////////////////////////////////
         }
 
+        if (QString(fi.suffix()).toLower() == "mlz")
+        {
+            std::map<int, MLRenderingData> rendOpt;
+            // the components that are not always needed are decoded when a filter or an exporter asks for them
+            const int lazyMask = MeshModel::MM_VERTQUALITY | MeshModel::MM_FACEQUALITY | MeshModel::MM_VERTRADIUS | MeshModel::MM_VERTTEXCOORD | MeshModel::MM_WEDGTEXCOORD;
+            if (!MeshDocumentFromPackFile(md, fileName, rendOpt, lazyMask))
+            {
+                fprintf(fp,"Meshlab Opening Error: Unable to open MeshLab Document Pack file\n");
+                return false;
+            }
+        }
+
         //////NVM
         if (QString(fi.suffix()).toLower() == "nvm"){
 
@@ -530,6 +549,10 @@ public:
         QFileInfo outprojinfo(filename);
         QString outdir = outprojinfo.absolutePath();
 
+        // the meshes are saved inside the pack
+        if (outprojinfo.suffix().toLower() == "mlz")
+            return MeshDocumentToPackFile(md, filename, false, false);
+
         QDir curDir = QDir::current();
         QDir::setCurrent(outprojinfo.absolutePath());
         foreach(MeshModel* m,md.meshList)
@@ -545,6 +568,7 @@ public:
                 m->setFileName(outfilename);
                 QFileInfo of(outfilename);
                 m->setLabel(of.fileName());
+                m->updateDataMask(m->pendingDataMask());
                 exportMesh(m,m->dataMask(),outfilename,true);
             }
         }
@@ -553,7 +577,80 @@ public:
         return MeshDocumentToXMLFile(md, filename, false, false, outprojinfo.suffix().toLower() == "mlb");
     }
 
-    bool script(MeshDocument &meshDocument,const QString& scriptfile,FILE* fp)
+    //QJsonValue::fromVariant does not know every numeric type (e.g. float) in all the Qt5 versions
+    static QJsonValue toJsonValue(const QVariant& v)
+    {
+        switch (v.userType())
+        {
+        case QMetaType::Bool:
+            return QJsonValue(v.toBool());
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Float:
+        case QMetaType::Double:
+            return QJsonValue(v.toDouble());
+        case QMetaType::QString:
+            return QJsonValue(v.toString());
+        case QMetaType::QVariantList:
+            {
+                QJsonArray arr;
+                foreach(const QVariant& e, v.toList())
+                    arr.append(toJsonValue(e));
+                return arr;
+            }
+        default:
+            return QJsonValue::fromVariant(v);
+        }
+    }
+
+    //one JSON object per line, flushed at once so that the file can be consumed while the script runs;
+    //a failed step also has an "error" field
+    static void writeFilterResults(FILE* resultsfp, const QString& scriptfile, int step, const QString& fname, bool ret, qint64 elapsed, const MeshDocument& meshDocument, const std::map<std::string, QVariant>& outputValues, const QString& error = QString())
+    {
+        if (resultsfp == NULL)
+            return;
+        QJsonObject res;
+        res["script"] = scriptfile;
+        res["step"] = step;
+        res["filter"] = fname;
+        res["success"] = ret;
+        res["time_ms"] = double(elapsed);
+        if (!ret)
+            res["error"] = error;
+
+        QJsonArray meshes;
+        foreach(const MeshModel* mm, meshDocument.meshList)
+        {
+            QJsonObject mesh;
+            mesh["id"] = mm->id();
+            mesh["label"] = mm->label();
+            mesh["vn"] = mm->cm.vn;
+            mesh["en"] = mm->cm.en;
+            mesh["fn"] = mm->cm.fn;
+            mesh["current"] = (mm == meshDocument.mm());
+            meshes.append(mesh);
+        }
+        res["meshes"] = meshes;
+
+        QJsonObject output;
+        for (const auto& p : outputValues)
+            output[QString::fromStdString(p.first)] = toJsonValue(p.second);
+        res["output"] = output;
+
+        QByteArray line = QJsonDocument(res).toJson(QJsonDocument::Compact);
+        fprintf(resultsfp, "%s\n", line.constData());
+        fflush(resultsfp);
+    }
+
+    //record of a step aborted before running the filter
+    static void writeFilterAbort(FILE* resultsfp, const QString& scriptfile, int step, const QString& fname, const MeshDocument& meshDocument, const QString& error)
+    {
+        writeFilterResults(resultsfp, scriptfile, step, fname, false, 0, meshDocument, std::map<std::string, QVariant>(), error);
+    }
+
+    bool script(MeshDocument &meshDocument,const QString& scriptfile,FILE* fp,FILE* resultsfp = NULL)
     {
         MeshModel* mm = meshDocument.mm();
 
@@ -569,10 +666,12 @@ public:
         if (!scriptPtr.open(scriptfile))
         {
             printf("File %s was not found.\n", qUtf8Printable(scriptfile));
+            writeFilterAbort(resultsfp, scriptfile, 0, QString(), meshDocument, "Script file not found");
             return false;
         }
         fprintf(fp,"Starting Script of %i actions",scriptPtr.size());
         GLLogStream log;
+        int step = 0;
         for (FilterNameParameterValuesPair& pair : scriptPtr)
         {
             bool ret = false;
@@ -583,6 +682,7 @@ public:
             if (action == NULL)
             {
                 fprintf(fp,"filter %s not found", qUtf8Printable(fname));
+                writeFilterAbort(resultsfp, scriptfile, step, fname, meshDocument, "Filter not found");
                 return false;
             }
 
@@ -591,6 +691,7 @@ public:
             int req = iFilter->getRequirements(action);
             if (mm != NULL)
                 mm->updateDataMask(req);
+            iFilter->decodePendingAttributes(action, meshDocument);
             //make sure the PARMESH parameters are initialized
 
             //A filter in the script file couldn't have all the required parameter not defined (a script file not generated by MeshLab).
@@ -604,6 +705,7 @@ public:
             if (required.size() < parameterSet.size())
             {
                 fprintf(fp,"The parameters in the script file are more than the filter %s requires.\n", qUtf8Printable(fname));
+                writeFilterAbort(resultsfp, scriptfile, step, fname, meshDocument, "The parameters in the script file are more than the filter requires");
                 return false;
             }
 
@@ -623,6 +725,7 @@ public:
 					else {
 						fprintf(fp,"Meshes loaded: %i, meshes asked for: %i \n", meshDocument.size(), md.meshindex );
 						fprintf(fp,"One of the filters in the script needs more meshes than you have loaded.\n");
+						writeFilterAbort(resultsfp, scriptfile, step, fname, meshDocument, "The filter needs more meshes than the ones loaded");
 						exit(-1);
 					}
 				}
@@ -630,6 +733,7 @@ public:
 			}
 
             QGLWidget* wid = NULL;
+            iFilter->glContext = NULL;
             if (shared != NULL)
             {
                 wid = new QGLWidget(NULL,shared);
@@ -637,9 +741,19 @@ public:
                 bool created = iFilter->glContext->create(wid->context());
                 if ((!created) || (!iFilter->glContext->isValid()))
                 {
-                    fprintf(fp, "A valid GLContext is required by the filter to work.\n");
-                    return false;
+                    delete iFilter->glContext;
+                    iFilter->glContext = NULL;
                 }
+            }
+            if ((iFilter->glContext == NULL) && iFilter->requiresGLContext(action))
+            {
+                delete wid;
+                fprintf(fp, "A valid GLContext is required by the filter to work.\n");
+                writeFilterAbort(resultsfp, scriptfile, step, fname, meshDocument, "A valid GLContext is required by the filter to work");
+                return false;
+            }
+            if (iFilter->glContext != NULL)
+            {
                 MLRenderingData dt;
                 MLRenderingData::RendAtts atts;
                 atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
@@ -684,10 +798,14 @@ public:
             meshDocument.setBusy(true);
             unsigned int postConditionMask = MeshModel::MM_UNKNOWN;
 			std::map<std::string, QVariant> outputValues;
+            QElapsedTimer filterTime;
+            filterTime.start();
             ret = iFilter->applyFilter( action, meshDocument, outputValues, postConditionMask, pair.second, filterCallBack);
+            qint64 elapsed = filterTime.elapsed();
             meshDocument.setBusy(false);
-            if (shared != NULL)
-                delete iFilter->glContext;
+            writeFilterResults(resultsfp, scriptfile, step++, fname, ret, elapsed, meshDocument, outputValues, iFilter->errorMsg());
+            delete iFilter->glContext;
+            iFilter->glContext = NULL;
             delete wid;
             QStringList logOutput;
             log.print(logOutput);
@@ -696,6 +814,8 @@ public:
             if(!ret)
             {
                 fprintf(fp,"Problem with filter: %s\n",qUtf8Printable(fname));
+                if (!iFilter->errorMsg().isEmpty())
+                    fprintf(fp,"%s\n",qUtf8Printable(iFilter->errorMsg()));
                 return false;
             }
         }
@@ -735,6 +855,7 @@ namespace commandline
     const char script('s');
     const char saveparam('s');
     const char ascii('a');
+    const char results('j');
 
     void usage()
     {
@@ -769,7 +890,7 @@ namespace commandline
     bool validateCommandLine(const QString& str)
     {
         QString logstring("(" + optionValueExpression(log) + "\\s+" +  optionValueExpression(dump) + "|" + optionValueExpression(dump) + "\\s+" +  optionValueExpression(log) + "|" +  optionValueExpression(dump) + "|" + optionValueExpression(log) + ")");
-        QString arg("(" + optionValueExpression(inproject) + "|" + optionValueExpression(inputmeshes) + "|" + optionValueExpression(outproject) + "(\\s+-" + overwrite + ")?" + "|" + optionValueExpression(script) + "|" + outputmeshExpression() + ")");
+        QString arg("(" + optionValueExpression(inproject) + "|" + optionValueExpression(inputmeshes) + "|" + optionValueExpression(outproject) + "(\\s+-" + overwrite + ")?" + "|" + optionValueExpression(script) + "|" + optionValueExpression(results) + "|" + outputmeshExpression() + ")");
         QString args("(" + arg + ")(\\s+" + arg + ")*");
         QString completecommandline("(" + logstring + "|" + logstring + "\\s+" + args + "|" + args + ")");
         QRegExp completecommandlineexp(completecommandline);
@@ -819,6 +940,7 @@ int main(int argc, char *argv[])
     GLExtensionsManager::init();
     FILE* logfp = stdout;
     FILE* dumpfp = NULL;
+    FILE* resultsfp = NULL;
     MeshLabApplication app(argc, argv);
     QStringList st = app.arguments();
     std::setlocale(LC_ALL, "C");
@@ -870,16 +992,18 @@ int main(int argc, char *argv[])
 	MeshDocument meshDocument;
 
 	MLSceneGLSharedDataContext shared(meshDocument, gpumeminfo, MeshLabScalarTest<MESHLAB_SCALAR>::doublePrecision(), 100000,100000);
-	shared.makeCurrent();
-	if (!GLExtensionsManager::initializeGLextensions_notThrowing())
+	//without a display (or a working OpenGL driver) only the filters that can run without a GL context are available
+	bool glavailable = shared.isValid();
+	if (glavailable)
 	{
-		printf("GLEW Init: failed!\n");
-		//system("pause");
-		exit(-1);
+		shared.makeCurrent();
+		glavailable = GLExtensionsManager::initializeGLextensions_notThrowing();
+		shared.doneCurrent();
 	}
-	shared.doneCurrent();
+	if (!glavailable)
+		printf("GLEW Init: failed! The filters requiring OpenGL will not be available.\n");
     printf("Loading Plugins:\n");
-	MeshLabServer server(&shared);
+	MeshLabServer server(glavailable ? &shared : NULL);
     server.loadPlugins();
 
     bool writebinary = true;
@@ -923,7 +1047,7 @@ int main(int argc, char *argv[])
                     OutProject pr;
                     pr.overwrite = false;
                     pr.filename = finfo.absoluteFilePath();
-                    if (finfo.completeSuffix().toLower() != "mlp")
+                    if ((finfo.completeSuffix().toLower() != "mlp") && (finfo.completeSuffix().toLower() != "mlz"))
                     {
                         fprintf(logfp,"Project %s is not a valid \'mlp\' file format. Output file will be renamed as %s.mlp .\n",qUtf8Printable(pr.filename),qUtf8Printable(pr.filename + ".mlp"));
                         pr.filename += ".mlp";
@@ -1095,6 +1219,16 @@ int main(int argc, char *argv[])
                 i += 2;
                 break;
             }
+        case commandline::results :
+            {
+                resultsfp = fopen(argv[i+1],"a");
+                if (resultsfp == NULL)
+                    fprintf(logfp,"Error occurred opening file %s. The results of the filters will not be saved\n",argv[i+1]);
+                else
+                    fprintf(logfp,"Results of the filters are saved in %s\n", argv[i+1]);
+                i += 2;
+                break;
+            }
         case commandline::dump :
             {
                 dumpfp = fopen(argv[i+1],"w");
@@ -1121,7 +1255,7 @@ int main(int argc, char *argv[])
     for(int ii = 0; ii < scriptfiles.size();++ii)
     {
         fprintf(logfp,"Apply FilterScript: '%s'\n",qUtf8Printable(scriptfiles[ii]));
-        bool returnValue = server.script(meshDocument, scriptfiles[ii],logfp);
+        bool returnValue = server.script(meshDocument, scriptfiles[ii],logfp,resultsfp);
         if(!returnValue)
         {
             fprintf(logfp,"Failed to apply script file %s\n",qUtf8Printable(scriptfiles[ii]));
@@ -1189,7 +1323,11 @@ int main(int argc, char *argv[])
 		fclose(logfp);
 	}
 
-	shared.deAllocateGPUSharedData();
+	if (resultsfp != NULL)
+		fclose(resultsfp);
+
+	if (glavailable)
+		shared.deAllocateGPUSharedData();
 	//system("pause");
 	return 0;
 }//int main()